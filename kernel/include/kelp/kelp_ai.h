@@ -29,20 +29,89 @@
 #define KELP_INFER_FLAG_BATCH      (1 << 1)
 #define KELP_INFER_FLAG_STREAM     (1 << 2)
 
+/* Accepted task priorities; submits outside this range fail with -EINVAL */
+#define KELP_INFER_PRIORITY_MIN    (-1000)
+#define KELP_INFER_PRIORITY_MAX    1000
+
 struct kelp_infer_task {
     uint64_t task_id;
-    int32_t  priority;          /* Higher = more urgent */
+    int32_t  priority;          /* Higher = more urgent, within the range above */
     uint32_t est_tokens;        /* Estimated token count */
     char     model_hint[KELP_INFER_MODEL_HINT_LEN];
     uint64_t submit_time_ns;    /* Filled by kernel on submit */
     uint32_t flags;
-    uint32_t _reserved;
+    uint32_t deadline_ms;       /* Due this long after submit, 0 = none */
 };
 
 /* ioctls 5-6: inference scheduler */
 #define KELP_IOC_SUBMIT_INFER   _IOW(KELP_IOC_MAGIC, 5, struct kelp_infer_task)
 #define KELP_IOC_POLL_INFER     _IOR(KELP_IOC_MAGIC, 6, struct kelp_infer_task)
 
+/*
+ * Vectored submit/poll: @tasks points to an array of @count tasks.
+ *
+ * SUBMIT_BATCH queues as many as fit and sets @count to that number
+ * (-ENOSPC if none did); ids and submit times are written back.  A task
+ * with a priority out of range fails the whole batch with -EINVAL.
+ * POLL_BATCH dequeues up to @count tasks in priority order and sets
+ * @count to the number returned.  If the queue is empty it waits up to
+ * @timeout_ms (0 = don't wait, -1 = forever) and then fails with
+ * -ETIMEDOUT, or -EAGAIN when not waiting.
+ */
+#define KELP_INFER_BATCH_MAX       256
+
+struct kelp_infer_batch {
+    uint64_t tasks;             /* user pointer to struct kelp_infer_task[] */
+    uint32_t count;             /* In: array length, Out: tasks transferred */
+    int32_t  timeout_ms;        /* POLL_BATCH only */
+};
+
+/* ioctls 17-18: batched inference scheduler */
+#define KELP_IOC_SUBMIT_BATCH   _IOWR(KELP_IOC_MAGIC, 17, struct kelp_infer_batch)
+#define KELP_IOC_POLL_BATCH     _IOWR(KELP_IOC_MAGIC, 18, struct kelp_infer_batch)
+
+/*
+ * Scheduling policies.  Each one orders the queue by a single key:
+ *
+ *   PRIORITY  priority, then FIFO.  With aging, a priority level is worth
+ *             aging_ms of waiting, so old low-priority tasks overtake new
+ *             high-priority ones instead of starving.
+ *   FAIR      weighted fair queuing (start-time tags) between submitting
+ *             uids: each uid receives service in proportion to its
+ *             weight, with est_tokens as the cost of a task.
+ *   EDF       earliest deadline first.  Tasks without deadline_ms get an
+ *             implicit one of KELP_SCHED_EDF_DEFAULT_MS, advanced by
+ *             aging_ms per priority level.
+ *
+ * With a batch window, POLL_BATCH fills a batch with queued tasks of the
+ * same model_hint submitted within batch_window_us of the task picked by
+ * the policy, so a model server can run them together.
+ */
+#define KELP_SCHED_PRIORITY        0
+#define KELP_SCHED_FAIR            1
+#define KELP_SCHED_EDF             2
+
+#define KELP_SCHED_WEIGHT_DEFAULT  100
+#define KELP_SCHED_WEIGHT_MAX      10000
+#define KELP_SCHED_EDF_DEFAULT_MS  1000
+
+struct kelp_sched_config {
+    uint32_t policy;            /* KELP_SCHED_* */
+    uint32_t aging_ms;          /* per priority level, 0 = strict priority */
+    uint32_t batch_window_us;   /* 0 = no model_hint batching */
+    uint32_t _reserved;
+};
+
+struct kelp_sched_weight {
+    uint32_t uid;
+    uint32_t weight;            /* 1..KELP_SCHED_WEIGHT_MAX */
+};
+
+/* ioctls 19-21: scheduling policy (setters need CAP_SYS_ADMIN) */
+#define KELP_IOC_SCHED_GET      _IOR(KELP_IOC_MAGIC, 19, struct kelp_sched_config)
+#define KELP_IOC_SCHED_SET      _IOW(KELP_IOC_MAGIC, 20, struct kelp_sched_config)
+#define KELP_IOC_SCHED_WEIGHT   _IOW(KELP_IOC_MAGIC, 21, struct kelp_sched_weight)
+
 /* ========================================================================
  * Semantic FS Events
  * ======================================================================== */
@@ -65,11 +134,17 @@ struct kelp_fs_event {
     char     path[KELP_SEMFS_PATH_MAX];
 };
 
+/*
+ * KELP_IOC_SEMFS_EVENTS consumes up to @count queued events, oldest first
+ * across all CPUs; event_id numbers events in delivery order.  Events that
+ * arrive while the module's per-CPU rings are full are dropped and
+ * counted in @dropped.
+ */
 #define KELP_SEMFS_BATCH_MAX    32
 
 struct kelp_semfs_batch {
     uint32_t count;             /* In: max events to read, Out: actual count */
-    uint32_t _reserved;
+    uint32_t dropped;           /* Out: events lost to full rings since last read */
     struct kelp_fs_event events[KELP_SEMFS_BATCH_MAX];
 };
 
@@ -77,9 +152,20 @@ struct kelp_semfs_batch {
 #define KELP_SEMFS_WATCH_ADD    1
 #define KELP_SEMFS_WATCH_REMOVE 2
 
+/* Event types a watch reports; a mask of 0 means all of them */
+#define KELP_SEMFS_MASK(type)   (1u << (type))
+#define KELP_SEMFS_MASK_ALL     (KELP_SEMFS_MASK(KELP_SEMFS_CREATE) | \
+                                 KELP_SEMFS_MASK(KELP_SEMFS_MODIFY) | \
+                                 KELP_SEMFS_MASK(KELP_SEMFS_DELETE) | \
+                                 KELP_SEMFS_MASK(KELP_SEMFS_RENAME))
+
+/*
+ * A watch covers its path and everything below it.  Adding a path that
+ * is already watched replaces its mask.
+ */
 struct kelp_semfs_watch {
     uint32_t action;            /* ADD or REMOVE */
-    uint32_t _reserved;
+    uint32_t mask;              /* KELP_SEMFS_MASK() bits, 0 = all */
     char     path[KELP_SEMFS_PATH_MAX];
 };
 
@@ -88,7 +174,20 @@ struct kelp_semfs_watch {
 #define KELP_IOC_SEMFS_WATCH    _IOW(KELP_IOC_MAGIC, 8, struct kelp_semfs_watch)
 
 /* ========================================================================
- * Accelerator Management (stubs)
+ * Accelerator Management
+ *
+ * Accelerator 0 is the host: pinned, zeroed kernel memory allocated in
+ * 2 MiB physically contiguous chunks where the page allocator has them
+ * (KELP_ACCEL_F_HUGE refuses smaller ones), up to the module's accel_mem_mb
+ * budget.  KELP_IOC_ACCEL_RESERVE returns a handle for the buffer, which
+ * any process of the same user may map with
+ *
+ *     mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+ *          KELP_ACCEL_MMAP_OFFSET(handle));
+ *
+ * so tensors pass between processes without a copy.  The handle stays
+ * valid until KELP_IOC_ACCEL_RELEASE or until the file that reserved it
+ * is closed; the memory is returned when the last mapping goes away.
  * ======================================================================== */
 
 #define KELP_ACCEL_NAME_LEN     64
@@ -98,6 +197,9 @@ struct kelp_semfs_watch {
 #define KELP_ACCEL_CUDA         1
 #define KELP_ACCEL_ROCM         2
 #define KELP_ACCEL_NPU          3
+#define KELP_ACCEL_HOST         4
+
+#define KELP_ACCEL_ID_HOST      0
 
 struct kelp_accel_info {
     uint32_t id;
@@ -113,15 +215,36 @@ struct kelp_accel_list {
     struct kelp_accel_info accels[KELP_ACCEL_MAX];
 };
 
+/* Reserve flags */
+#define KELP_ACCEL_F_HUGE       (1 << 0)    /* only 2 MiB chunks, or fail */
+
+/* Largest buffer, and the mmap offset of a buffer handle */
+#define KELP_ACCEL_BUF_MAX      (1ULL << 32)
+#define KELP_ACCEL_MMAP_OFFSET(handle)  ((uint64_t)(handle) << 32)
+
 struct kelp_accel_reserve {
     uint32_t accel_id;
+    uint32_t flags;             /* In: KELP_ACCEL_F_* */
+    uint64_t bytes;             /* In: size wanted, Out: rounded up to pages */
+    uint64_t handle;            /* Out: buffer handle, from 1 */
+    uint64_t mmap_offset;       /* Out: KELP_ACCEL_MMAP_OFFSET(handle) */
+};
+
+struct kelp_accel_buf {
+    uint64_t handle;            /* In */
+    uint64_t bytes;             /* Out */
+    uint64_t mmap_offset;       /* Out */
+    uint32_t accel_id;          /* Out */
+    uint32_t uid;               /* Out: owner; other users cannot map it */
+    uint32_t huge_chunks;       /* Out: 2 MiB chunks backing it */
     uint32_t _reserved;
-    uint64_t bytes;             /* Amount of memory to reserve */
 };
 
-/* ioctls 9-10: accelerator management */
+/* ioctls 9-10, 23-24: accelerator management */
 #define KELP_IOC_ACCEL_LIST     _IOR(KELP_IOC_MAGIC, 9, struct kelp_accel_list)
-#define KELP_IOC_ACCEL_RESERVE  _IOW(KELP_IOC_MAGIC, 10, struct kelp_accel_reserve)
+#define KELP_IOC_ACCEL_RESERVE  _IOWR(KELP_IOC_MAGIC, 10, struct kelp_accel_reserve)
+#define KELP_IOC_ACCEL_RELEASE  _IOW(KELP_IOC_MAGIC, 23, uint64_t)
+#define KELP_IOC_ACCEL_BUF_INFO _IOWR(KELP_IOC_MAGIC, 24, struct kelp_accel_buf)
 
 /* ========================================================================
  * Unified AI Status
@@ -153,6 +276,35 @@ struct kelp_ai_status {
 /* ioctl 11: unified AI status */
 #define KELP_IOC_AI_STATUS      _IOR(KELP_IOC_MAGIC, 11, struct kelp_ai_status)
 
+/* ========================================================================
+ * Stats page
+ *
+ * mmap(/dev/kelp) at KELP_STATS_MMAP_OFFSET maps one read-only page with
+ * every counter of KELP_IOC_GET_STATS and KELP_IOC_AI_STATUS, so that a
+ * dashboard can sample them without a system call.  While any mapping
+ * exists the module rewrites the page every stats_interval_ms.
+ *
+ * Updates are bracketed by seq: it is odd while the module writes.  A
+ * reader loads seq (acquire), retries while it is odd, copies the page,
+ * issues a read fence and accepts the copy if seq has not changed.
+ * ======================================================================== */
+
+#define KELP_STATS_MAGIC        0x4b535441u     /* "KSTA" */
+#define KELP_STATS_VERSION      1
+#define KELP_STATS_MMAP_OFFSET  0x40000000UL
+
+struct kelp_stats_page {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              /* sizeof(struct kelp_stats_page) */
+    uint32_t seq;               /* odd while an update is in progress */
+    uint64_t update_ns;         /* CLOCK_BOOTTIME of the last update */
+    uint32_t interval_ms;       /* refresh period */
+    uint32_t _reserved;
+    struct kelp_kstats    kstats;
+    struct kelp_ai_status ai;
+};
+
 /* Updated max ioctl number */
 #define KELP_IOC_AI_MAXNR       11
 
@@ -58,6 +58,194 @@ struct kelp_kstatus {
 /* Maximum message size through /dev/kelp */
 #define KELP_MAX_MSG_SIZE  (64 * 1024)
 
+/* ========================================================================
+ * Shared-memory message ring
+ *
+ * mmap(/dev/kelp) at offset 0 maps a ring of fixed-size slots that
+ * producers and consumers use directly, without read()/write().  Each
+ * open file has its own ring, freed when the file is released; processes
+ * share a ring by sharing the file (fork, SCM_RIGHTS).  KELP_IOC_RING_WAIT
+ * and KELP_IOC_RING_KICK act on the ring of the file they are issued on.
+ *
+ *   +0                    struct kelp_ring_hdr   (one page)
+ *   +desc_offset          struct kelp_ring_desc  [nslots]
+ *   +data_offset          slot payloads          [nslots][slot_size]
+ *
+ * Every descriptor carries a sequence number (bounded MPMC queue):
+ *   seq == pos              slot free for the producer claiming pos
+ *   seq == pos + 1          slot holds the message at pos
+ *   seq == pos + nslots     slot released by the consumer of pos
+ * Producers claim positions by compare-and-swap on head, consumers on
+ * tail; the payload is written and read in place.
+ *
+ * A side that finds the ring empty (or full) bumps cons_waiters (or
+ * prod_waiters) and sleeps in KELP_IOC_RING_WAIT.  The other side, after
+ * publishing, issues KELP_IOC_RING_KICK only if that counter is non-zero,
+ * so an uncontended ring needs no system calls at all.
+ * ======================================================================== */
+
+#define KELP_RING_MAGIC      0x4b524e47u     /* "KRNG" */
+#define KELP_RING_VERSION    1
+#define KELP_RING_SLOTS      256             /* power of two */
+#define KELP_RING_SLOT_SIZE  4096            /* max payload per message */
+#define KELP_RING_CACHELINE  64
+
+struct kelp_ring_hdr {
+    /* Read-only after setup */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;
+    uint32_t slot_size;
+    uint64_t desc_offset;
+    uint64_t data_offset;
+    uint64_t map_size;
+    uint8_t  _pad0[KELP_RING_CACHELINE - 40];
+
+    /* Producer line */
+    uint64_t head;
+    uint32_t prod_waiters;
+    uint8_t  _pad1[KELP_RING_CACHELINE - 12];
+
+    /* Consumer line */
+    uint64_t tail;
+    uint32_t cons_waiters;
+    uint8_t  _pad2[KELP_RING_CACHELINE - 12];
+};
+
+struct kelp_ring_desc {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t flags;
+};
+
+/* KELP_IOC_RING_WAIT events */
+#define KELP_RING_WAIT_DATA   1       /* until a message is ready */
+#define KELP_RING_WAIT_SPACE  2       /* until a slot is free */
+
+struct kelp_ring_wait {
+    uint32_t event;             /* KELP_RING_WAIT_DATA or _SPACE */
+    int32_t  timeout_ms;        /* < 0 waits forever */
+};
+
+/* ioctls 12-13: shared-memory ring wakeups */
+#define KELP_IOC_RING_WAIT      _IOW(KELP_IOC_MAGIC, 12, struct kelp_ring_wait)
+#define KELP_IOC_RING_KICK      _IOW(KELP_IOC_MAGIC, 13, uint32_t)
+
+/* ========================================================================
+ * Readiness notification
+ *
+ * /dev/kelp supports poll()/epoll: POLLIN when read() has a message,
+ * POLLOUT when write() has room.  Event loops that cannot watch the device
+ * directly may instead register an eventfd, which is signalled whenever a
+ * message is queued for this file to read().  Pass -1 to unregister.
+ * ======================================================================== */
+
+#define KELP_IOC_SET_EVENTFD    _IOW(KELP_IOC_MAGIC, 14, int32_t)
+
+/* ========================================================================
+ * Channels
+ *
+ * Every open file of /dev/kelp is a channel with its own id and inbox.
+ *
+ * A client (the default role) write()s requests; each one is tagged with
+ * the client's channel id and a new request id and put on the device's
+ * service queue.  read() returns the responses addressed to this channel
+ * only, as bare payloads, or prefixed with a struct kelp_msg_hdr when the
+ * channel is KELP_CHAN_F_FRAMED (for matching out-of-order responses).
+ * A client may have chan_requests (module parameter) requests waiting on
+ * the service queue; past that, write() blocks, or fails with EAGAIN
+ * under O_NONBLOCK, until a server takes one.
+ *
+ * A server (gateway worker) reads requests from the shared service queue,
+ * always framed: hdr.channel is the client, hdr.req_id its request id.
+ * It answers by writing a struct kelp_msg_hdr followed by the payload,
+ * with hdr.channel and hdr.req_id copied from the request.  Any number of
+ * servers may consume concurrently; responses to a client that has gone
+ * away are dropped.  Taking the server role needs CAP_SYS_ADMIN, and the
+ * role cannot change once the file has been polled (EBUSY).
+ *
+ * Batching: writev() takes one whole message (request, or header plus
+ * response) per iovec segment.  On a framed channel readv() returns one
+ * message per segment, header first, for as many as are queued; every
+ * segment but the last one filled counts whole in the return value.
+ * ======================================================================== */
+
+#define KELP_CHAN_CLIENT        0
+#define KELP_CHAN_SERVER        1
+
+#define KELP_CHAN_F_FRAMED      (1 << 0)
+
+#define KELP_CHAN_MAX_DEPTH     4096
+
+struct kelp_msg_hdr {
+    uint64_t channel;           /* client channel id */
+    uint64_t req_id;            /* per-channel request id, from 1 */
+    uint32_t len;               /* payload bytes following the header */
+    uint32_t flags;
+};
+
+struct kelp_chan_setup {
+    uint32_t role;              /* KELP_CHAN_CLIENT or KELP_CHAN_SERVER */
+    uint32_t flags;             /* KELP_CHAN_F_* */
+    uint32_t depth;             /* inbox depth, 0 keeps the current one */
+    uint32_t _reserved;
+};
+
+struct kelp_chan_info {
+    uint64_t channel;
+    uint64_t last_req_id;       /* id given to this channel's last write */
+    uint32_t role;
+    uint32_t flags;
+    uint32_t depth;
+    uint32_t queued;            /* messages waiting in the inbox */
+};
+
+/* ioctls 15-16: channels */
+#define KELP_IOC_CHAN_SETUP     _IOW(KELP_IOC_MAGIC, 15, struct kelp_chan_setup)
+#define KELP_IOC_CHAN_INFO      _IOR(KELP_IOC_MAGIC, 16, struct kelp_chan_info)
+
+/* ========================================================================
+ * Network flows
+ *
+ * The netfilter hook aggregates outbound IPv4 packets into flows keyed by
+ * the 5-tuple, in per-CPU tables.  KELP_IOC_NF_FLOWS exports them in
+ * batches: the first call of an interval takes a snapshot (the counting
+ * restarts from zero), that call and the following ones return up to
+ * count flows each, and KELP_NF_BATCH_MORE is set while the snapshot has
+ * flows left.  A flow seen on several CPUs is reported once per CPU.
+ * ======================================================================== */
+
+#define KELP_NF_BATCH_MAX       1024
+#define KELP_NF_BATCH_MORE      (1 << 0)
+
+struct kelp_nf_flow {
+    uint32_t saddr;             /* IPv4 address, network byte order */
+    uint32_t daddr;
+    uint16_t sport;             /* network byte order, 0 unless TCP/UDP */
+    uint16_t dport;
+    uint8_t  protocol;          /* IPPROTO_* */
+    uint8_t  _pad[3];
+    uint32_t cpu;               /* CPU whose table held the flow */
+    uint32_t _reserved;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t first_ns;          /* CLOCK_MONOTONIC */
+    uint64_t last_ns;
+};
+
+struct kelp_nf_flow_batch {
+    uint64_t flows;             /* user pointer to struct kelp_nf_flow[] */
+    uint32_t count;             /* in: capacity, out: flows returned */
+    uint32_t flags;             /* out: KELP_NF_BATCH_* */
+    uint64_t overflow;          /* out: packets not recorded, tables full */
+};
+
+/* ioctl 22: network flows */
+#define KELP_IOC_NF_FLOWS       _IOWR(KELP_IOC_MAGIC, 22, struct kelp_nf_flow_batch)
+
+/* Highest ioctl number understood by the module (see also kelp_ai.h) */
+#define KELP_IOC_NR_LAST        24
+
 /* Netfilter action codes */
 #define KELP_NF_LOG_ONLY   0
 #define KELP_NF_ANALYZE    1
@@ -1,8 +1,17 @@
 /*
- * kelp_accel.c — Accelerator management stubs
+ * kelp_accel.c — Accelerator management and host tensor buffers
  *
- * Phase 1 stub implementation. Returns empty accelerator list
- * and validates reserve requests without actual GPU/NPU interaction.
+ * The host is the one backend so far: accelerator 0 hands out pinned,
+ * zeroed kernel memory for tensors and embedding matrices.  A buffer is
+ * allocated in PMD-sized (2 MiB on x86-64) physically contiguous chunks
+ * when the page allocator has them, falling back to smaller orders for
+ * the rest unless the caller asked for KELP_ACCEL_F_HUGE.  Its handle is
+ * global, so any process of the owning user can mmap the same pages.
+ *
+ * Lifetime: the reserving file and every mapping hold a reference.  The
+ * handle is dropped on KELP_IOC_ACCEL_RELEASE or when the file closes;
+ * the pages (and their share of the accel_mem_mb budget) are returned
+ * when the last mapping is unmapped.
  */
 
 #include <linux/kernel.h>
@@ -11,20 +20,228 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/string.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/kref.h>
+#include <linux/xarray.h>
+#include <linux/cred.h>
+#include <linux/capability.h>
 
 #include "kelp_internal.h"
 #include "../include/kelp/kelp_ai.h"
 
+#ifndef MAX_PAGE_ORDER
+#define MAX_PAGE_ORDER  MAX_ORDER
+#endif
+
+#define ACCEL_HUGE_ORDER    min_t(unsigned int, PMD_SHIFT - PAGE_SHIFT, \
+                                  MAX_PAGE_ORDER)
+#define ACCEL_HUGE_SIZE     (PAGE_SIZE << ACCEL_HUGE_ORDER)
+#define ACCEL_HANDLE_SHIFT  (32 - PAGE_SHIFT)
+
+/*
+ * A buffer is a list of physically contiguous chunks, linked through
+ * page->lru of each chunk's head page (ours, never on an LRU).  Chunks of
+ * order > 0 are compound pages, so compound_order() gives every size.
+ */
+struct accel_buf {
+    struct kref          ref;
+    kuid_t               uid;
+    struct file         *owner;     /* reserving file, compared only */
+    uint64_t             bytes;
+    struct list_head     chunks;
+    uint32_t             nchunks;
+    uint32_t             huge_chunks;
+};
+
+/* Published buffers by handle */
+static DEFINE_XARRAY_ALLOC1(accel_xa);
+
+/* Bytes of the budget held by live buffers, published or not */
+static DEFINE_SPINLOCK(accel_lock);
+static uint64_t accel_reserved;
+
+static uint64_t accel_total(void)
+{
+    return (uint64_t)kelp_get_accel_mem_mb() << 20;
+}
+
+static bool accel_charge(uint64_t bytes)
+{
+    bool ok;
+
+    spin_lock(&accel_lock);
+    ok = accel_reserved + bytes <= accel_total();
+    if (ok)
+        accel_reserved += bytes;
+    spin_unlock(&accel_lock);
+    return ok;
+}
+
+static void accel_uncharge(uint64_t bytes)
+{
+    spin_lock(&accel_lock);
+    accel_reserved -= bytes;
+    spin_unlock(&accel_lock);
+}
+
+static uint64_t accel_free_bytes(void)
+{
+    uint64_t total = accel_total(), used = READ_ONCE(accel_reserved);
+
+    return used < total ? total - used : 0;
+}
+
+/* ---- Buffers ------------------------------------------------------------ */
+
+/* Atomic-safe: the last reference may be dropped under the xa_lock. */
+static void accel_buf_free(struct accel_buf *buf)
+{
+    struct page *page, *next;
+
+    list_for_each_entry_safe(page, next, &buf->chunks, lru) {
+        list_del(&page->lru);
+        __free_pages(page, compound_order(page));
+    }
+    accel_uncharge(buf->bytes);
+    kfree(buf);
+}
+
+static void accel_buf_release(struct kref *ref)
+{
+    accel_buf_free(container_of(ref, struct accel_buf, ref));
+}
+
+static void accel_buf_put(struct accel_buf *buf)
+{
+    kref_put(&buf->ref, accel_buf_release);
+}
+
+/*
+ * Allocate @bytes (a multiple of PAGE_SIZE) against the budget: largest
+ * chunks first, halving the order whenever the allocator has nothing that
+ * big.  With @huge_only, anything short of a full huge chunk fails.
+ */
+static struct accel_buf *accel_buf_alloc(uint64_t bytes, bool huge_only)
+{
+    const gfp_t gfp = GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN;
+    unsigned long left = bytes >> PAGE_SHIFT;
+    unsigned int order = ACCEL_HUGE_ORDER;
+    struct accel_buf *buf;
+
+    if (!accel_charge(bytes))
+        return ERR_PTR(-ENOMEM);
+
+    buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+    if (!buf) {
+        accel_uncharge(bytes);
+        return ERR_PTR(-ENOMEM);
+    }
+    kref_init(&buf->ref);
+    INIT_LIST_HEAD(&buf->chunks);
+    buf->uid = current_fsuid();
+    buf->bytes = bytes;
+
+    while (left) {
+        struct page *page;
+
+        while (order && (1UL << order) > left)
+            order--;
+        if (huge_only && order != ACCEL_HUGE_ORDER)
+            goto fail;
+
+        page = alloc_pages(gfp | (order ? __GFP_COMP | __GFP_NORETRY : 0),
+                           order);
+        if (!page) {
+            if (!order || huge_only)
+                goto fail;
+            order--;
+            continue;
+        }
+
+        list_add_tail(&page->lru, &buf->chunks);
+        buf->nchunks++;
+        if (order == ACCEL_HUGE_ORDER)
+            buf->huge_chunks++;
+        left -= 1UL << order;
+        cond_resched();
+    }
+    return buf;
+
+fail:
+    accel_buf_free(buf);
+    return ERR_PTR(-ENOMEM);
+}
+
+/* Take a reference on the published buffer @handle. */
+static struct accel_buf *accel_buf_get(uint64_t handle)
+{
+    struct accel_buf *buf;
+
+    if (!handle || handle > U32_MAX)
+        return NULL;
+
+    xa_lock(&accel_xa);
+    buf = xa_load(&accel_xa, handle);
+    if (buf)
+        kref_get(&buf->ref);
+    xa_unlock(&accel_xa);
+    return buf;
+}
+
+static bool accel_buf_may_map(const struct accel_buf *buf)
+{
+    return uid_eq(buf->uid, current_fsuid()) || capable(CAP_SYS_ADMIN);
+}
+
+/*
+ * Withdraw @handle if @owner (or any file, when NULL) published it.  The
+ * lookup and the owner check are made under the xa_lock, which keeps the
+ * buffer alive.
+ */
+static int accel_buf_unpublish(uint64_t handle, struct file *owner)
+{
+    struct accel_buf *buf;
+
+    if (!handle || handle > U32_MAX)
+        return -ENOENT;
+
+    xa_lock(&accel_xa);
+    buf = xa_load(&accel_xa, handle);
+    if (buf && owner && buf->owner != owner) {
+        xa_unlock(&accel_xa);
+        return -EPERM;
+    }
+    if (buf) {
+        __xa_erase(&accel_xa, handle);
+        accel_buf_put(buf);
+    }
+    xa_unlock(&accel_xa);
+
+    return buf ? 0 : -ENOENT;
+}
+
+/* ---- ioctls --------------------------------------------------------------- */
+
 /*
- * List accelerators (ioctl handler).
- * Phase 1: returns count=0 (no accelerators detected).
+ * List accelerators (ioctl handler).  The host is listed while the
+ * accel_mem_mb budget is non-zero.
  */
 int kelp_accel_list(unsigned long arg)
 {
     struct kelp_accel_list list;
 
     memset(&list, 0, sizeof(list));
-    list.count = 0;
+    if (accel_total()) {
+        struct kelp_accel_info *info = &list.accels[list.count++];
+
+        info->id           = KELP_ACCEL_ID_HOST;
+        info->type         = KELP_ACCEL_HOST;
+        info->memory_total = accel_total();
+        info->memory_free  = accel_free_bytes();
+        strscpy(info->name, "host", sizeof(info->name));
+    }
 
     if (copy_to_user((void __user *)arg, &list, sizeof(list)))
         return -EFAULT;
@@ -33,50 +250,235 @@ int kelp_accel_list(unsigned long arg)
 }
 
 /*
- * Reserve accelerator memory (ioctl handler).
- * Phase 1: validates input but always returns success (no-op).
+ * Reserve accelerator memory (ioctl handler): allocate a host buffer and
+ * publish its handle, owned by @file.
  */
-int kelp_accel_reserve(unsigned long arg)
+int kelp_accel_reserve(struct file *file, unsigned long arg)
 {
     struct kelp_accel_reserve req;
+    struct accel_buf *buf;
+    uint32_t handle;
+    int ret;
 
     if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
         return -EFAULT;
 
-    /* Validate: no accelerators exist in phase 1 */
     if (req.accel_id >= KELP_ACCEL_MAX)
         return -EINVAL;
+    if (req.accel_id != KELP_ACCEL_ID_HOST || !accel_total())
+        return -ENODEV;
+    if (req.bytes == 0 || req.bytes > KELP_ACCEL_BUF_MAX ||
+        (req.flags & ~KELP_ACCEL_F_HUGE))
+        return -EINVAL;
 
-    if (req.bytes == 0)
+    req.bytes = (req.flags & KELP_ACCEL_F_HUGE) ?
+                round_up(req.bytes, ACCEL_HUGE_SIZE) : PAGE_ALIGN(req.bytes);
+    if (req.bytes > KELP_ACCEL_BUF_MAX)
         return -EINVAL;
 
-    /* Stub: return success without actually reserving anything */
+    buf = accel_buf_alloc(req.bytes, req.flags & KELP_ACCEL_F_HUGE);
+    if (IS_ERR(buf))
+        return PTR_ERR(buf);
+    buf->owner = file;
+
     if (kelp_get_log_level() >= 2)
-        pr_info("kelp: accel reserve stub: id=%u bytes=%llu\n",
-                req.accel_id, req.bytes);
+        pr_info("kelp: accel buffer: %llu bytes, %u of %u chunks huge\n",
+                req.bytes, buf->huge_chunks, buf->nchunks);
+
+    ret = xa_alloc(&accel_xa, &handle, buf, XA_LIMIT(1, INT_MAX), GFP_KERNEL);
+    if (ret) {
+        accel_buf_put(buf);
+        return ret;
+    }
 
+    req.handle      = handle;
+    req.mmap_offset = KELP_ACCEL_MMAP_OFFSET(handle);
+    if (copy_to_user((void __user *)arg, &req, sizeof(req))) {
+        accel_buf_unpublish(handle, file);
+        return -EFAULT;
+    }
     return 0;
 }
 
+/* Drop a handle reserved through @file (ioctl handler). */
+int kelp_accel_release(struct file *file, unsigned long arg)
+{
+    uint64_t handle;
+
+    if (copy_from_user(&handle, (void __user *)arg, sizeof(handle)))
+        return -EFAULT;
+    return accel_buf_unpublish(handle, file);
+}
+
+/* Describe a published buffer, so another process can map it. */
+int kelp_accel_buf_info(unsigned long arg)
+{
+    struct kelp_accel_buf info;
+    struct accel_buf *buf;
+
+    if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
+        return -EFAULT;
+
+    buf = accel_buf_get(info.handle);
+    if (!buf)
+        return -ENOENT;
+
+    info.bytes       = buf->bytes;
+    info.mmap_offset = KELP_ACCEL_MMAP_OFFSET(info.handle);
+    info.accel_id    = KELP_ACCEL_ID_HOST;
+    info.uid         = from_kuid_munged(current_user_ns(), buf->uid);
+    info.huge_chunks = buf->huge_chunks;
+    info._reserved   = 0;
+    accel_buf_put(buf);
+
+    if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+        return -EFAULT;
+    return 0;
+}
+
+/* Called when a /dev/kelp file closes: its handles go away. */
+void kelp_accel_release_file(struct file *file)
+{
+    struct accel_buf *buf;
+    unsigned long handle;
+
+    xa_lock(&accel_xa);
+    xa_for_each(&accel_xa, handle, buf) {
+        if (buf->owner == file) {
+            __xa_erase(&accel_xa, handle);
+            accel_buf_put(buf);
+        }
+    }
+    xa_unlock(&accel_xa);
+}
+
+/* ---- mmap ----------------------------------------------------------------- */
+
+static void accel_vm_open(struct vm_area_struct *vma)
+{
+    struct accel_buf *buf = vma->vm_private_data;
+
+    kref_get(&buf->ref);
+}
+
+static void accel_vm_close(struct vm_area_struct *vma)
+{
+    accel_buf_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct accel_vm_ops = {
+    .open  = accel_vm_open,
+    .close = accel_vm_close,
+};
+
+/*
+ * Called by kelp_chardev_mmap() for offsets at or above
+ * KELP_ACCEL_MMAP_OFFSET(1): the high bits select the buffer, the low 32
+ * an offset into it.
+ */
+int kelp_accel_mmap(struct vm_area_struct *vma)
+{
+    uint64_t handle = vma->vm_pgoff >> ACCEL_HANDLE_SHIFT;
+    uint64_t off = (uint64_t)(vma->vm_pgoff & ((1UL << ACCEL_HANDLE_SHIFT) - 1))
+                   << PAGE_SHIFT;
+    unsigned long size = vma->vm_end - vma->vm_start;
+    unsigned long addr = vma->vm_start;
+    struct accel_buf *buf;
+    struct page *page;
+    uint64_t pos = 0;
+    int ret = 0;
+
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+
+    buf = accel_buf_get(handle);
+    if (!buf)
+        return -ENOENT;
+    if (!accel_buf_may_map(buf)) {
+        ret = -EACCES;
+        goto err;
+    }
+    if (off >= buf->bytes || size > buf->bytes - off) {
+        ret = -EINVAL;
+        goto err;
+    }
+
+    kelp_vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+
+    /* Map the part of each chunk that falls inside [off, off + size) */
+    list_for_each_entry(page, &buf->chunks, lru) {
+        uint64_t len = PAGE_SIZE << compound_order(page);
+        uint64_t skip, n;
+
+        if (addr >= vma->vm_end)
+            break;
+        if (pos + len <= off) {
+            pos += len;
+            continue;
+        }
+        skip = off > pos ? off - pos : 0;
+        n = min_t(uint64_t, len - skip, vma->vm_end - addr);
+        ret = remap_pfn_range(vma, addr, page_to_pfn(page) + (skip >> PAGE_SHIFT),
+                              n, vma->vm_page_prot);
+        if (ret)
+            goto err;
+        addr += n;
+        pos += len;
+    }
+
+    /* The reference taken above is the mapping's */
+    vma->vm_private_data = buf;
+    vma->vm_ops = &accel_vm_ops;
+    return 0;
+
+err:
+    accel_buf_put(buf);
+    return ret;
+}
+
 /* Stats accessor */
 uint32_t kelp_accel_get_count(void)
 {
-    return 0;  /* Phase 1: no accelerators */
+    return accel_total() ? 1 : 0;
 }
 
-/* /proc/kelp/accelerators */
+/* ---- /proc/kelp/accelerators -------------------------------------------- */
+
 static int accel_proc_show(struct seq_file *m, void *v)
 {
+    struct accel_buf *buf;
+    unsigned long handle;
+    uint32_t count = kelp_accel_get_count();
+
     seq_printf(m, "Kelp Accelerator Management\n");
     seq_printf(m, "===========================\n");
-    seq_printf(m, "Detected accelerators: 0\n");
+    seq_printf(m, "Detected accelerators: %u\n", count);
+    seq_printf(m, "count: %u\n", count);
     seq_printf(m, "\n");
-    seq_printf(m, "  (no accelerators detected — phase 1 stub)\n");
+    if (count) {
+        seq_printf(m, "  [%d] host  type=%d  total=%llu MiB  free=%llu MiB  chunk=%lu KiB\n",
+                   KELP_ACCEL_ID_HOST, KELP_ACCEL_HOST, accel_total() >> 20,
+                   accel_free_bytes() >> 20, ACCEL_HUGE_SIZE >> 10);
+        seq_printf(m, "\n");
+        seq_printf(m, "Buffers:\n");
+
+        xa_lock(&accel_xa);
+        xa_for_each(&accel_xa, handle, buf) {
+            seq_printf(m, "  %-8lu %12llu bytes  uid=%u  huge=%u/%u\n",
+                       handle, buf->bytes,
+                       from_kuid_munged(seq_user_ns(m), buf->uid),
+                       buf->huge_chunks, buf->nchunks);
+        }
+        xa_unlock(&accel_xa);
+    } else {
+        seq_printf(m, "  (host buffers disabled: accel_mem_mb=0)\n");
+    }
     seq_printf(m, "\n");
     seq_printf(m, "Supported types:\n");
     seq_printf(m, "  CUDA  (type=%d)\n", KELP_ACCEL_CUDA);
     seq_printf(m, "  ROCm  (type=%d)\n", KELP_ACCEL_ROCM);
     seq_printf(m, "  NPU   (type=%d)\n", KELP_ACCEL_NPU);
+    seq_printf(m, "  host  (type=%d)\n", KELP_ACCEL_HOST);
     return 0;
 }
 
@@ -103,12 +505,23 @@ int kelp_accel_init(struct proc_dir_entry *proc_dir)
         return -ENOMEM;
     }
 
-    pr_info("kelp: accelerator management initialized (phase 1 stub)\n");
+    pr_info("kelp: accelerator management initialized (host: %u MiB, %lu KiB chunks)\n",
+            kelp_get_accel_mem_mb(), ACCEL_HUGE_SIZE >> 10);
     return 0;
 }
 
+/*
+ * Called at module unload.  Every file is closed and every mapping gone
+ * by then (each holds the module), so no buffer is left.
+ */
 void kelp_accel_exit(void)
 {
     proc_remove(accel_proc_entry);
+    WARN_ON(!xa_empty(&accel_xa));
+    xa_destroy(&accel_xa);
     pr_info("kelp: accelerator management cleaned up\n");
 }
+
+#if IS_ENABLED(CONFIG_KELP_KUNIT_TEST)
+#include "tests/kelp_accel_test.c"
+#endif
@@ -3,7 +3,16 @@
  *
  * Implements a kernel-space priority queue (rbtree) for scheduling
  * AI inference tasks. Userspace submits tasks with priorities;
- * the scheduler dequeues in priority order.
+ * the scheduler dequeues them in the order of the active policy
+ * (see kelp_ai.h): priority with aging, weighted fair queuing between
+ * uids, or earliest deadline first.  Every policy reduces to a sort key
+ * computed once at submit, so the tree stays a plain ordered queue and
+ * changing policy re-keys the queued tasks.
+ *
+ * Workers can move up to KELP_INFER_BATCH_MAX tasks per ioctl in either
+ * direction, and sleep on sched_wq until work arrives instead of
+ * spinning on -EAGAIN.  Pollers wait exclusively, so a submit of n tasks
+ * wakes at most n of them.
  */
 
 #include <linux/kernel.h>
@@ -16,13 +25,45 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/sched/signal.h>
+#include <linux/jiffies.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/cred.h>
+#include <linux/capability.h>
 
 #include "kelp_internal.h"
 #include "../include/kelp/kelp_ai.h"
 
+/* Distinct uids tracked; the rest share one class */
+#define SCHED_MAX_CLASSES   64
+#define SCHED_OTHER_UID     ((uid_t)-1)
+
+/* Largest est_tokens charged to a class for one task */
+#define SCHED_MAX_COST      (1u << 20)
+
+/* Per-uid scheduling class: fair-share state and latency stats */
+struct sched_class {
+    struct list_head node;
+    uid_t       uid;
+    uint32_t    weight;
+    uint64_t    last_finish;    /* FAIR: finish tag of its newest task */
+    uint32_t    queued;
+    uint64_t    submitted;
+    uint64_t    dispatched;
+    uint64_t    wait_ns_total;
+    uint64_t    wait_ns_max;
+    uint64_t    deadline_missed;
+};
+
 /* Wrapper for rbtree node */
 struct sched_node {
-    struct rb_node  rb;
+    struct rb_node      rb;
+    struct hlist_node   hint_node;  /* sched_hints, for batching */
+    struct sched_class *cls;
+    int64_t             key;        /* policy order, lowest first */
+    uint32_t            hint_hash;
     struct kelp_infer_task task;
 };
 
@@ -32,10 +73,129 @@ static atomic_t             sched_depth = ATOMIC_INIT(0);
 static atomic_t             sched_total_submitted = ATOMIC_INIT(0);
 static atomic_t             sched_total_completed = ATOMIC_INIT(0);
 static uint64_t             sched_next_id = 1;
+static struct kmem_cache   *sched_cache;
+static DECLARE_WAIT_QUEUE_HEAD(sched_wq);
+
+/* Policy state, under sched_lock */
+static struct kelp_sched_config sched_cfg;
+static uint64_t             sched_vtime;    /* FAIR: start tag in service */
+static LIST_HEAD(sched_classes);
+static uint32_t             sched_nclasses;
+static struct sched_class   sched_other = {
+    .uid    = SCHED_OTHER_UID,
+    .weight = KELP_SCHED_WEIGHT_DEFAULT,
+};
+static DEFINE_HASHTABLE(sched_hints, 7);
+
+static const char *const sched_policy_names[] = {
+    [KELP_SCHED_PRIORITY] = "priority",
+    [KELP_SCHED_FAIR]     = "fair",
+    [KELP_SCHED_EDF]      = "edf",
+};
+
+/* ---- Classes ------------------------------------------------------------ */
+
+static struct sched_class *sched_class_find(uid_t uid)
+{
+    struct sched_class *cls;
+
+    list_for_each_entry(cls, &sched_classes, node) {
+        if (cls->uid == uid)
+            return cls;
+    }
+    return NULL;
+}
+
+/*
+ * Find or create the class of @uid.  Classes live until module unload,
+ * so the pointer stays valid without a reference.  Called unlocked.
+ */
+static struct sched_class *sched_class_get(uid_t uid)
+{
+    struct sched_class *cls, *fresh;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cls = sched_class_find(uid);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (cls)
+        return cls;
+
+    fresh = kzalloc(sizeof(*fresh), GFP_KERNEL);
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cls = sched_class_find(uid);
+    if (!cls && fresh && sched_nclasses < SCHED_MAX_CLASSES) {
+        fresh->uid = uid;
+        fresh->weight = KELP_SCHED_WEIGHT_DEFAULT;
+        fresh->last_finish = sched_vtime;
+        list_add_tail(&fresh->node, &sched_classes);
+        sched_nclasses++;
+        cls = fresh;
+        fresh = NULL;
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    kfree(fresh);
+    return cls ? cls : &sched_other;
+}
+
+static uid_t sched_current_uid(void)
+{
+    return from_kuid_munged(&init_user_ns, current_uid());
+}
+
+/* ---- Ordering ----------------------------------------------------------- */
 
 /*
- * Insert a task into the rbtree, ordered by priority (descending)
- * then by submit time (ascending) for FIFO within same priority.
+ * Submit keeps priority within KELP_INFER_PRIORITY_MIN..MAX, so even with
+ * aging_ms at U32_MAX the credit stays below 2^62 ns and cannot overflow.
+ */
+static int64_t sched_aging_credit(const struct sched_node *n)
+{
+    return (int64_t)n->task.priority * sched_cfg.aging_ms * NSEC_PER_MSEC;
+}
+
+/* Compute the sort key of @n under the current policy.  Locked. */
+static void sched_compute_key(struct sched_node *n)
+{
+    const struct kelp_infer_task *t = &n->task;
+    uint64_t cost, start;
+
+    switch (sched_cfg.policy) {
+    case KELP_SCHED_FAIR:
+        /* Start-time fair queuing: a class that was idle restarts at
+         * the current virtual time rather than banking credit. */
+        cost = clamp_t(uint64_t, t->est_tokens, 1, SCHED_MAX_COST);
+        start = max(sched_vtime, n->cls->last_finish);
+        n->cls->last_finish = start + div_u64(cost << 10, n->cls->weight);
+        n->key = (int64_t)start;
+        break;
+    case KELP_SCHED_EDF:
+        n->key = (int64_t)t->submit_time_ns +
+                 (int64_t)(t->deadline_ms ? t->deadline_ms
+                                          : KELP_SCHED_EDF_DEFAULT_MS) * NSEC_PER_MSEC;
+        if (!t->deadline_ms)
+            n->key -= sched_aging_credit(n);
+        break;
+    default:
+        if (sched_cfg.aging_ms)
+            n->key = (int64_t)t->submit_time_ns - sched_aging_credit(n);
+        else
+            n->key = -(int64_t)t->priority;     /* strict; FIFO by id */
+        break;
+    }
+}
+
+static bool sched_before(const struct sched_node *a, const struct sched_node *b)
+{
+    if (a->key != b->key)
+        return a->key < b->key;
+    return a->task.task_id < b->task.task_id;
+}
+
+/*
+ * Insert a task into the rbtree by key, then task id (submit order).
  */
 static void sched_insert(struct sched_node *new_node)
 {
@@ -47,26 +207,63 @@ static void sched_insert(struct sched_node *new_node)
         parent = *link;
         entry = rb_entry(parent, struct sched_node, rb);
 
-        /* Higher priority goes left (dequeued first) */
-        if (new_node->task.priority > entry->task.priority) {
+        /* Earlier key goes left (dequeued first) */
+        if (sched_before(new_node, entry))
             link = &parent->rb_left;
-        } else if (new_node->task.priority < entry->task.priority) {
+        else
             link = &parent->rb_right;
-        } else {
-            /* Same priority: earlier submit time goes left */
-            if (new_node->task.submit_time_ns <= entry->task.submit_time_ns)
-                link = &parent->rb_left;
-            else
-                link = &parent->rb_right;
-        }
     }
 
     rb_link_node(&new_node->rb, parent, link);
     rb_insert_color(&new_node->rb, &sched_tree);
 }
 
+/* Queue a task whose key is already computed.  Locked. */
+static void sched_link(struct sched_node *n)
+{
+    sched_insert(n);
+    hash_add(sched_hints, &n->hint_node, n->hint_hash);
+    n->cls->queued++;
+}
+
+static void sched_unlink(struct sched_node *n)
+{
+    rb_erase(&n->rb, &sched_tree);
+    hash_del(&n->hint_node);
+    n->cls->queued--;
+}
+
+/* Stamp, key and queue a new task.  Locked. */
+static void sched_enqueue(struct sched_node *n, uint64_t now)
+{
+    n->task.model_hint[KELP_INFER_MODEL_HINT_LEN - 1] = '\0';
+    n->task.submit_time_ns = now;
+    n->task.task_id = sched_next_id++;
+    n->hint_hash = jhash(n->task.model_hint,
+                         strlen(n->task.model_hint), 0);
+    sched_compute_key(n);
+    sched_link(n);
+    n->cls->submitted++;
+}
+
+/* Account the dispatch of @n for its class.  Locked. */
+static void sched_account(struct sched_node *n, uint64_t now)
+{
+    struct sched_class *cls = n->cls;
+    uint64_t wait = now - n->task.submit_time_ns;
+
+    cls->dispatched++;
+    cls->wait_ns_total += wait;
+    cls->wait_ns_max = max(cls->wait_ns_max, wait);
+    if (n->task.deadline_ms &&
+        wait > (uint64_t)n->task.deadline_ms * NSEC_PER_MSEC)
+        cls->deadline_missed++;
+    if (sched_cfg.policy == KELP_SCHED_FAIR)
+        sched_vtime = max(sched_vtime, (uint64_t)n->key);
+}
+
 /*
- * Dequeue the highest-priority task (leftmost node).
+ * Dequeue the first task in policy order (leftmost node).
  */
 static struct sched_node *sched_dequeue(void)
 {
@@ -77,53 +274,121 @@ static struct sched_node *sched_dequeue(void)
         return NULL;
 
     entry = rb_entry(node, struct sched_node, rb);
-    rb_erase(node, &sched_tree);
+    sched_unlink(entry);
+    sched_account(entry, ktime_get_ns());
     return entry;
 }
 
+/*
+ * Move queued tasks with @head's model_hint, submitted within the batch
+ * window of it, into @out (at most @room).  Returns the number moved.
+ */
+static uint32_t sched_take_batch(struct sched_node *head,
+                                 struct sched_node **out, uint32_t room)
+{
+    uint64_t window = (uint64_t)sched_cfg.batch_window_us * NSEC_PER_USEC;
+    struct sched_node *n;
+    struct hlist_node *tmp;
+    uint64_t now = ktime_get_ns();
+    uint32_t taken = 0;
+
+    if (!window || !head->task.model_hint[0])
+        return 0;
+
+    hash_for_each_possible_safe(sched_hints, n, tmp, hint_node, head->hint_hash) {
+        if (taken == room)
+            break;
+        if (n->hint_hash != head->hint_hash ||
+            strcmp(n->task.model_hint, head->task.model_hint) != 0)
+            continue;
+        if (abs_diff(n->task.submit_time_ns, head->task.submit_time_ns) > window)
+            continue;
+        sched_unlink(n);
+        sched_account(n, now);
+        out[taken++] = n;
+    }
+    return taken;
+}
+
+/* Re-key every queued task, after a policy or weight change.  Locked. */
+static void sched_rekey(void)
+{
+    struct rb_root old = sched_tree;
+    struct sched_class *cls;
+    struct rb_node *rb;
+
+    list_for_each_entry(cls, &sched_classes, node)
+        cls->last_finish = sched_vtime;
+    sched_other.last_finish = sched_vtime;
+
+    /* Walk the old tree in order so FAIR tags follow the current order. */
+    sched_tree = RB_ROOT;
+    while ((rb = rb_first(&old)) != NULL) {
+        struct sched_node *n = rb_entry(rb, struct sched_node, rb);
+
+        rb_erase(rb, &old);
+        sched_compute_key(n);
+        sched_insert(n);
+    }
+}
+
+static bool sched_task_valid(const struct kelp_infer_task *t)
+{
+    return t->priority >= KELP_INFER_PRIORITY_MIN &&
+           t->priority <= KELP_INFER_PRIORITY_MAX;
+}
+
 /*
  * Submit an inference task (ioctl handler).
  */
 int kelp_ai_sched_submit(unsigned long arg)
 {
     struct kelp_infer_task user_task;
+    struct sched_class *cls;
     struct sched_node *node;
     unsigned long flags;
 
     if (copy_from_user(&user_task, (void __user *)arg, sizeof(user_task)))
         return -EFAULT;
+    if (!sched_task_valid(&user_task))
+        return -EINVAL;
 
     if (atomic_read(&sched_depth) >= KELP_INFER_MAX_QUEUE)
         return -ENOSPC;
 
-    node = kzalloc(sizeof(*node), GFP_KERNEL);
+    if (!sched_cache)
+        return -ENODEV;
+
+    cls = sched_class_get(sched_current_uid());
+    node = kmem_cache_alloc(sched_cache, GFP_KERNEL);
     if (!node)
         return -ENOMEM;
 
     node->task = user_task;
-    node->task.submit_time_ns = ktime_get_ns();
+    node->cls = cls;
 
     spin_lock_irqsave(&sched_lock, flags);
-    node->task.task_id = sched_next_id++;
-    sched_insert(node);
+    sched_enqueue(node, ktime_get_ns());
+    atomic_inc(&sched_depth);
+    user_task = node->task;
     spin_unlock_irqrestore(&sched_lock, flags);
 
-    atomic_inc(&sched_depth);
     atomic_inc(&sched_total_submitted);
+    wake_up_interruptible(&sched_wq);
 
     /* Copy back with assigned task_id and submit_time */
-    if (copy_to_user((void __user *)arg, &node->task, sizeof(node->task)))
+    if (copy_to_user((void __user *)arg, &user_task, sizeof(user_task)))
         return -EFAULT;
 
     if (kelp_get_log_level() >= 2)
         pr_info("kelp: inference task %llu submitted (priority=%d)\n",
-                node->task.task_id, node->task.priority);
+                user_task.task_id, user_task.priority);
 
     return 0;
 }
 
 /*
- * Poll (dequeue) the next highest-priority inference task.
+ * Poll (dequeue) the next inference task in policy order.
  */
 int kelp_ai_sched_poll(unsigned long arg)
 {
@@ -132,6 +397,8 @@ int kelp_ai_sched_poll(unsigned long arg)
 
     spin_lock_irqsave(&sched_lock, flags);
     node = sched_dequeue();
+    if (node)
+        atomic_dec(&sched_depth);
     spin_unlock_irqrestore(&sched_lock, flags);
 
     if (!node)
@@ -140,18 +407,285 @@ int kelp_ai_sched_poll(unsigned long arg)
     if (copy_to_user((void __user *)arg, &node->task, sizeof(node->task))) {
         /* Re-insert on failure */
         spin_lock_irqsave(&sched_lock, flags);
-        sched_insert(node);
+        sched_link(node);
+        atomic_inc(&sched_depth);
         spin_unlock_irqrestore(&sched_lock, flags);
+        wake_up_interruptible(&sched_wq);
         return -EFAULT;
     }
 
-    atomic_dec(&sched_depth);
     atomic_inc(&sched_total_completed);
-    kfree(node);
+    kmem_cache_free(sched_cache, node);
 
     return 0;
 }
 
+/*
+ * Submit up to KELP_INFER_BATCH_MAX tasks under one lock acquisition.
+ */
+int kelp_ai_sched_submit_batch(unsigned long arg)
+{
+    struct kelp_infer_batch batch;
+    struct kelp_infer_task *tasks;
+    struct sched_node **nodes;
+    struct sched_class *cls;
+    unsigned long flags;
+    uint32_t i, n, space;
+    uint64_t now;
+    int ret = 0;
+
+    if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+        return -EFAULT;
+    if (batch.count == 0 || batch.count > KELP_INFER_BATCH_MAX)
+        return -EINVAL;
+    if (!sched_cache)
+        return -ENODEV;
+
+    tasks = kvmalloc_array(batch.count, sizeof(*tasks), GFP_KERNEL);
+    nodes = kmalloc_array(batch.count, sizeof(*nodes), GFP_KERNEL);
+    if (!tasks || !nodes) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    if (copy_from_user(tasks, u64_to_user_ptr(batch.tasks),
+                       array_size(batch.count, sizeof(*tasks)))) {
+        ret = -EFAULT;
+        goto out;
+    }
+    for (i = 0; i < batch.count; i++) {
+        if (!sched_task_valid(&tasks[i])) {
+            ret = -EINVAL;
+            goto out;
+        }
+    }
+
+    cls = sched_class_get(sched_current_uid());
+
+    /* Allocate outside the lock; a short allocation just submits fewer. */
+    for (n = 0; n < batch.count; n++) {
+        nodes[n] = kmem_cache_alloc(sched_cache, GFP_KERNEL);
+        if (!nodes[n])
+            break;
+    }
+    if (n == 0) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    now = ktime_get_ns();
+    spin_lock_irqsave(&sched_lock, flags);
+    space = KELP_INFER_MAX_QUEUE - min_t(uint32_t, atomic_read(&sched_depth),
+                                         KELP_INFER_MAX_QUEUE);
+    n = min(n, space);
+    for (i = 0; i < n; i++) {
+        nodes[i]->task = tasks[i];
+        nodes[i]->cls = cls;
+        sched_enqueue(nodes[i], now);
+        tasks[i] = nodes[i]->task;
+    }
+    atomic_add(n, &sched_depth);
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    /* Nodes beyond the queue limit were never inserted. */
+    for (i = n; i < batch.count && nodes[i]; i++)
+        kmem_cache_free(sched_cache, nodes[i]);
+
+    if (n == 0) {
+        ret = -ENOSPC;
+        goto out;
+    }
+
+    atomic_add(n, &sched_total_submitted);
+    wake_up_interruptible_nr(&sched_wq, n);
+
+    /* The tasks are queued whatever happens to the copy back. */
+    batch.count = n;
+    if (copy_to_user(u64_to_user_ptr(batch.tasks), tasks,
+                     array_size(n, sizeof(*tasks))) ||
+        copy_to_user((void __user *)arg, &batch, sizeof(batch)))
+        ret = -EFAULT;
+
+    if (kelp_get_log_level() >= 2)
+        pr_info("kelp: %u inference tasks submitted\n", n);
+out:
+    kfree(nodes);
+    kvfree(tasks);
+    return ret;
+}
+
+/*
+ * Sleep until the queue is non-empty.  *@timeout is in jiffies (or
+ * MAX_SCHEDULE_TIMEOUT) and is reduced by the time slept.  Returns 0 when
+ * there may be work, -ETIMEDOUT or -ERESTARTSYS otherwise.
+ */
+static int sched_wait(long *timeout)
+{
+    DEFINE_WAIT(wait);
+    int ret = 0;
+
+    for (;;) {
+        prepare_to_wait_exclusive(&sched_wq, &wait, TASK_INTERRUPTIBLE);
+        if (atomic_read(&sched_depth) > 0)
+            break;
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        if (*timeout == 0) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        *timeout = schedule_timeout(*timeout);
+    }
+    finish_wait(&sched_wq, &wait);
+
+    /* We may have consumed a wakeup meant for work we won't take. */
+    if (ret && atomic_read(&sched_depth) > 0)
+        wake_up_interruptible(&sched_wq);
+    return ret;
+}
+
+/*
+ * Dequeue up to KELP_INFER_BATCH_MAX tasks, waiting for the first one.
+ */
+int kelp_ai_sched_poll_batch(unsigned long arg)
+{
+    struct kelp_infer_batch batch;
+    struct kelp_infer_task *tasks;
+    struct sched_node **nodes;
+    unsigned long flags;
+    long timeout;
+    uint32_t i, n;
+    int ret = 0;
+
+    if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+        return -EFAULT;
+    if (batch.count == 0 || batch.count > KELP_INFER_BATCH_MAX)
+        return -EINVAL;
+
+    tasks = kvmalloc_array(batch.count, sizeof(*tasks), GFP_KERNEL);
+    nodes = kmalloc_array(batch.count, sizeof(*nodes), GFP_KERNEL);
+    if (!tasks || !nodes) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    timeout = batch.timeout_ms < 0 ? MAX_SCHEDULE_TIMEOUT
+                                   : (long)msecs_to_jiffies(batch.timeout_ms);
+    for (;;) {
+        spin_lock_irqsave(&sched_lock, flags);
+        for (n = 0; n < batch.count; ) {
+            struct sched_node *head = sched_dequeue();
+
+            if (!head)
+                break;
+            nodes[n++] = head;
+            n += sched_take_batch(head, nodes + n, batch.count - n);
+        }
+        atomic_sub(n, &sched_depth);
+        spin_unlock_irqrestore(&sched_lock, flags);
+
+        if (n > 0)
+            break;
+        if (batch.timeout_ms == 0) {
+            ret = -EAGAIN;
+            goto out;
+        }
+        /* Another poller may beat us to the work; wait out the rest. */
+        ret = sched_wait(&timeout);
+        if (ret)
+            goto out;
+    }
+
+    for (i = 0; i < n; i++)
+        tasks[i] = nodes[i]->task;
+
+    batch.count = n;
+    if (copy_to_user(u64_to_user_ptr(batch.tasks), tasks,
+                     array_size(n, sizeof(*tasks))) ||
+        copy_to_user((void __user *)arg, &batch, sizeof(batch))) {
+        /* Re-insert on failure */
+        spin_lock_irqsave(&sched_lock, flags);
+        for (i = 0; i < n; i++)
+            sched_link(nodes[i]);
+        atomic_add(n, &sched_depth);
+        spin_unlock_irqrestore(&sched_lock, flags);
+        wake_up_interruptible_nr(&sched_wq, n);
+        ret = -EFAULT;
+        goto out;
+    }
+
+    atomic_add(n, &sched_total_completed);
+    for (i = 0; i < n; i++)
+        kmem_cache_free(sched_cache, nodes[i]);
+out:
+    kfree(nodes);
+    kvfree(tasks);
+    return ret;
+}
+
+int kelp_ai_sched_get_config(unsigned long arg)
+{
+    struct kelp_sched_config cfg;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cfg = sched_cfg;
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    if (copy_to_user((void __user *)arg, &cfg, sizeof(cfg)))
+        return -EFAULT;
+    return 0;
+}
+
+int kelp_ai_sched_set_config(unsigned long arg)
+{
+    struct kelp_sched_config cfg;
+    unsigned long flags;
+
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+        return -EFAULT;
+    if (cfg.policy > KELP_SCHED_EDF)
+        return -EINVAL;
+    cfg._reserved = 0;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_cfg = cfg;
+    sched_rekey();
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    if (kelp_get_log_level() >= 1)
+        pr_info("kelp: scheduler policy %s (aging=%ums, batch window=%uus)\n",
+                sched_policy_names[cfg.policy], cfg.aging_ms,
+                cfg.batch_window_us);
+    return 0;
+}
+
+int kelp_ai_sched_set_weight(unsigned long arg)
+{
+    struct kelp_sched_weight req;
+    struct sched_class *cls;
+    unsigned long flags;
+
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (req.weight == 0 || req.weight > KELP_SCHED_WEIGHT_MAX)
+        return -EINVAL;
+
+    cls = sched_class_get((uid_t)req.uid);
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cls->weight = req.weight;
+    if (sched_cfg.policy == KELP_SCHED_FAIR)
+        sched_rekey();
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return 0;
+}
+
 /* Stats accessors for procfs / ai_status */
 uint32_t kelp_ai_sched_get_depth(void)
 {
@@ -169,13 +703,52 @@ uint32_t kelp_ai_sched_get_total_completed(void)
 }
 
 /* /proc/kelp/scheduler */
+static void sched_show_class(struct seq_file *m, const struct sched_class *cls)
+{
+    uint64_t avg = cls->dispatched ? div64_u64(cls->wait_ns_total, cls->dispatched) : 0;
+
+    if (cls->uid == SCHED_OTHER_UID)
+        seq_printf(m, "%-10s", "other");
+    else
+        seq_printf(m, "%-10u", cls->uid);
+    seq_printf(m, " %6u %6u %10llu %10llu %12llu %12llu %8llu\n",
+               cls->weight, cls->queued, cls->submitted, cls->dispatched,
+               div_u64(avg, NSEC_PER_USEC),
+               div_u64(cls->wait_ns_max, NSEC_PER_USEC),
+               cls->deadline_missed);
+}
+
 static int sched_proc_show(struct seq_file *m, void *v)
 {
+    struct kelp_sched_config cfg;
+    struct sched_class *cls;
+    unsigned long flags;
+
     seq_printf(m, "Kelp AI Inference Scheduler\n");
     seq_printf(m, "===========================\n");
     seq_printf(m, "Queue depth:       %u\n", kelp_ai_sched_get_depth());
     seq_printf(m, "Total submitted:   %u\n", kelp_ai_sched_get_total_submitted());
     seq_printf(m, "Total completed:   %u\n", kelp_ai_sched_get_total_completed());
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cfg = sched_cfg;
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    seq_printf(m, "Policy:            %s\n", sched_policy_names[cfg.policy]);
+    seq_printf(m, "Aging:             %u ms/priority level\n", cfg.aging_ms);
+    seq_printf(m, "Batch window:      %u us\n", cfg.batch_window_us);
+
+    /* Per-class dispatch latency (submit to poll) */
+    seq_printf(m, "\n%-10s %6s %6s %10s %10s %12s %12s %8s\n",
+               "uid", "weight", "queued", "submitted", "dispatched",
+               "avg_wait_us", "max_wait_us", "missed");
+
+    spin_lock_irqsave(&sched_lock, flags);
+    list_for_each_entry(cls, &sched_classes, node)
+        sched_show_class(m, cls);
+    if (sched_other.submitted)
+        sched_show_class(m, &sched_other);
+    spin_unlock_irqrestore(&sched_lock, flags);
     return 0;
 }
 
@@ -195,27 +768,52 @@ static struct proc_dir_entry *sched_proc_entry;
 
 int kelp_ai_sched_init(struct proc_dir_entry *proc_dir)
 {
+    sched_cfg.policy = min_t(uint32_t, kelp_get_sched_policy(), KELP_SCHED_EDF);
+    sched_cfg.aging_ms = kelp_get_sched_aging_ms();
+    sched_cfg.batch_window_us = kelp_get_sched_batch_window_us();
+
+    sched_cache = KMEM_CACHE(sched_node, 0);
+    if (!sched_cache) {
+        pr_err("kelp: failed to create sched_node cache\n");
+        return -ENOMEM;
+    }
+
     sched_proc_entry = proc_create("scheduler", 0444, proc_dir, &sched_proc_ops);
     if (!sched_proc_entry) {
         pr_err("kelp: failed to create /proc/kelp/scheduler\n");
+        kmem_cache_destroy(sched_cache);
+        sched_cache = NULL;
         return -ENOMEM;
     }
 
-    pr_info("kelp: AI inference scheduler initialized\n");
+    pr_info("kelp: AI inference scheduler initialized (policy=%s)\n",
+            sched_policy_names[sched_cfg.policy]);
     return 0;
 }
 
 void kelp_ai_sched_exit(void)
 {
+    struct sched_class *cls, *tmp;
     struct sched_node *node;
     unsigned long flags;
 
     /* Drain the queue */
     spin_lock_irqsave(&sched_lock, flags);
     while ((node = sched_dequeue()) != NULL)
-        kfree(node);
+        kmem_cache_free(sched_cache, node);
     spin_unlock_irqrestore(&sched_lock, flags);
 
+    list_for_each_entry_safe(cls, tmp, &sched_classes, node)
+        kfree(cls);
+    INIT_LIST_HEAD(&sched_classes);
+    sched_nclasses = 0;
+
+    kmem_cache_destroy(sched_cache);
+    sched_cache = NULL;
     proc_remove(sched_proc_entry);
     pr_info("kelp: AI inference scheduler cleaned up\n");
 }
+
+#if IS_ENABLED(CONFIG_KELP_KUNIT_TEST)
+#include "tests/kelp_ai_sched_test.c"
+#endif
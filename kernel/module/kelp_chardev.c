@@ -3,6 +3,15 @@
  *
  * Provides read/write/ioctl interface for userspace <-> kernel IPC.
  * Write a prompt -> read back the response (forwarded via gateway).
+ *
+ * Every open file is a channel (see kelp_kernel.h).  Client writes become
+ * requests on the shared service queue, tagged with the client's channel
+ * and request id; server files take requests from that queue and route
+ * each response to the inbox of the channel it names.  Each queue has its
+ * own lock, so unrelated clients never contend with each other, and a
+ * slow client can only ever fill its own inbox.  A client may have at
+ * most chan_requests requests on the service queue, so one busy client
+ * cannot take every slot from the others.
  */
 
 #include <linux/fs.h>
@@ -12,231 +21,760 @@
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/ktime.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/list.h>
+#include <linux/version.h>
+#include <linux/xarray.h>
+#include <linux/rcupdate.h>
+#include <linux/refcount.h>
+#include <linux/uio.h>
+#include <linux/capability.h>
 
 #include "kelp_internal.h"
 #include "../include/kelp/kelp_ai.h"
 
-/* Ring buffer parameters */
-#define RING_SIZE 64
 #define MSG_MAX_LEN KELP_MAX_MSG_SIZE
 
-/* Per-file private data */
-struct kelp_file_data {
-    char   *read_buf;     /* Pending read data */
-    size_t  read_len;
-    size_t  read_pos;
+/* A queued message; hdr.channel is the client it belongs to. */
+struct kelp_msg {
+    struct list_head    node;
+    struct kelp_chan   *src;        /* client owning a request slot, or NULL */
+    struct kelp_msg_hdr hdr;
+    char                data[];
+};
+
+/* Bounded FIFO of messages with its own lock and wait queues */
+struct kelp_queue {
+    spinlock_t         lock;
+    struct list_head   msgs;
+    uint32_t           count;
+    uint32_t           depth;
+    wait_queue_head_t  data_wq;     /* readers waiting for a message */
+    wait_queue_head_t  space_wq;    /* writers waiting for room */
 };
 
+/* Per-file private data: one channel per open file */
+struct kelp_chan {
+    uint32_t            id;
+    uint32_t            role;       /* KELP_CHAN_CLIENT / _SERVER */
+    uint32_t            flags;      /* KELP_CHAN_F_* */
+    bool                closed;
+    bool                polled;     /* on a wait queue chosen by role */
+    refcount_t          refs;       /* file, responders, queued requests */
+    atomic64_t          last_req_id;
+    atomic_t            requests;   /* ours on serve_q */
+    struct kelp_queue   inbox;
+
+    /* Message being read when the reader's buffer was too small */
+    struct mutex        read_lock;
+    struct kelp_msg    *cur;
+    size_t              cur_pos;
+
+    struct eventfd_ctx *evfd;       /* KELP_IOC_SET_EVENTFD, or NULL */
+    struct list_head    ev_node;    /* on evfd_list while evfd is set */
+    struct rcu_head     rcu;
+};
+
+/* Open channels by id, for routing responses */
+static DEFINE_XARRAY_ALLOC1(chan_xa);
+
+/* Requests from every client, consumed by every server */
+static struct kelp_queue serve_q;
+
+/* Files with a registered eventfd */
+static LIST_HEAD(evfd_list);
+static DEFINE_SPINLOCK(evfd_lock);
+
+/* ---- Queues ------------------------------------------------------------- */
+
+static void queue_init(struct kelp_queue *q, uint32_t depth)
+{
+    spin_lock_init(&q->lock);
+    INIT_LIST_HEAD(&q->msgs);
+    q->count = 0;
+    q->depth = depth;
+    init_waitqueue_head(&q->data_wq);
+    init_waitqueue_head(&q->space_wq);
+}
+
+static bool queue_has_data(struct kelp_queue *q)
+{
+    return READ_ONCE(q->count) != 0;
+}
+
+static bool queue_has_space(struct kelp_queue *q)
+{
+    return READ_ONCE(q->count) < READ_ONCE(q->depth);
+}
+
+static int queue_push(struct kelp_queue *q, struct kelp_msg *msg)
+{
+    spin_lock(&q->lock);
+    if (q->count >= q->depth) {
+        spin_unlock(&q->lock);
+        return -EAGAIN;
+    }
+    list_add_tail(&msg->node, &q->msgs);
+    WRITE_ONCE(q->count, q->count + 1);
+    spin_unlock(&q->lock);
+
+    wake_up_interruptible(&q->data_wq);
+    return 0;
+}
+
+static struct kelp_msg *queue_pop(struct kelp_queue *q)
+{
+    struct kelp_msg *msg;
+
+    spin_lock(&q->lock);
+    msg = list_first_entry_or_null(&q->msgs, struct kelp_msg, node);
+    if (msg) {
+        list_del(&msg->node);
+        WRITE_ONCE(q->count, q->count - 1);
+    }
+    spin_unlock(&q->lock);
+
+    if (msg)
+        wake_up_interruptible(&q->space_wq);
+    return msg;
+}
+
+static void queue_purge(struct kelp_queue *q)
+{
+    struct kelp_msg *msg;
+
+    while ((msg = queue_pop(q)) != NULL)
+        kfree(msg);
+}
+
+static struct kelp_msg *msg_alloc(size_t len)
+{
+    struct kelp_msg *msg = kmalloc(struct_size(msg, data, len + 1), GFP_KERNEL);
+
+    if (msg) {
+        msg->src = NULL;
+        memset(&msg->hdr, 0, sizeof(msg->hdr));
+        msg->hdr.len = (uint32_t)len;
+        msg->data[len] = '\0';
+    }
+    return msg;
+}
+
+/* ---- Channels ----------------------------------------------------------- */
+
+static struct kelp_chan *chan_get(uint64_t id)
+{
+    struct kelp_chan *ch;
+
+    if (id > U32_MAX)
+        return NULL;
+
+    rcu_read_lock();
+    ch = xa_load(&chan_xa, (unsigned long)id);
+    if (ch && !refcount_inc_not_zero(&ch->refs))
+        ch = NULL;
+    rcu_read_unlock();
+    return ch;
+}
+
+static void chan_put(struct kelp_chan *ch)
+{
+    if (!refcount_dec_and_test(&ch->refs))
+        return;
+
+    queue_purge(&ch->inbox);
+    kfree(ch->cur);
+    kfree_rcu(ch, rcu);
+}
+
+/* Pop from @q; a request hands its client's slot back. */
+static struct kelp_msg *queue_take(struct kelp_queue *q)
+{
+    struct kelp_msg *msg = queue_pop(q);
+    struct kelp_chan *src = msg ? msg->src : NULL;
+
+    if (src) {
+        msg->src = NULL;
+        atomic_dec(&src->requests);
+        wake_up_interruptible(&q->space_wq);
+        chan_put(src);
+    }
+    return msg;
+}
+
+/* Has @ch a free request slot? */
+static bool chan_has_slot(struct kelp_chan *ch)
+{
+    return atomic_read(&ch->requests) < (int)kelp_get_chan_requests();
+}
+
+/* May @ch queue another request on the service queue? */
+static bool chan_may_request(struct kelp_chan *ch)
+{
+    return chan_has_slot(ch) && queue_has_space(&serve_q);
+}
+
+static bool chan_framed(const struct kelp_chan *ch)
+{
+    return ch->role == KELP_CHAN_SERVER || (ch->flags & KELP_CHAN_F_FRAMED);
+}
+
+/* Servers read the service queue; clients read their own inbox. */
+static struct kelp_queue *chan_read_queue(struct kelp_chan *ch)
+{
+    return READ_ONCE(ch->role) == KELP_CHAN_SERVER ? &serve_q : &ch->inbox;
+}
+
+/* ---- Eventfd notification ----------------------------------------------- */
+
+static void evfd_signal(struct eventfd_ctx *ctx)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+    eventfd_signal(ctx);
+#else
+    eventfd_signal(ctx, 1);
+#endif
+}
+
+static void evfd_notify_chan(struct kelp_chan *ch)
+{
+    spin_lock(&evfd_lock);
+    if (ch->evfd)
+        evfd_signal(ch->evfd);
+    spin_unlock(&evfd_lock);
+}
+
+static void evfd_notify_servers(void)
+{
+    struct kelp_chan *ch;
+
+    spin_lock(&evfd_lock);
+    list_for_each_entry(ch, &evfd_list, ev_node) {
+        if (READ_ONCE(ch->role) == KELP_CHAN_SERVER)
+            evfd_signal(ch->evfd);
+    }
+    spin_unlock(&evfd_lock);
+}
+
+/* Replace the channel's eventfd; @ctx may be NULL to unregister. */
+static void evfd_set(struct kelp_chan *ch, struct eventfd_ctx *ctx)
+{
+    struct eventfd_ctx *old;
+
+    spin_lock(&evfd_lock);
+    old = ch->evfd;
+    if (old && !ctx)
+        list_del_init(&ch->ev_node);
+    else if (!old && ctx)
+        list_add_tail(&ch->ev_node, &evfd_list);
+    ch->evfd = ctx;
+    spin_unlock(&evfd_lock);
+
+    if (old)
+        eventfd_ctx_put(old);
+}
+
+/* ---- File operations ---------------------------------------------------- */
+
 int kelp_chardev_open(struct inode *inode, struct file *file)
 {
-    struct kelp_file_data *fdata;
+    struct kelp_chan *ch;
+    int ret;
 
-    fdata = kzalloc(sizeof(*fdata), GFP_KERNEL);
-    if (!fdata)
+    ch = kzalloc(sizeof(*ch), GFP_KERNEL);
+    if (!ch)
         return -ENOMEM;
 
-    file->private_data = fdata;
+    ch->role = KELP_CHAN_CLIENT;
+    refcount_set(&ch->refs, 1);
+    atomic64_set(&ch->last_req_id, 0);
+    atomic_set(&ch->requests, 0);
+    queue_init(&ch->inbox, kelp_get_chan_depth());
+    mutex_init(&ch->read_lock);
+    INIT_LIST_HEAD(&ch->ev_node);
+
+    ret = xa_alloc(&chan_xa, &ch->id, ch, xa_limit_32b, GFP_KERNEL);
+    if (ret) {
+        kfree(ch);
+        return ret;
+    }
+
+    file->private_data = ch;
     atomic_inc(kelp_get_open_count());
 
     if (kelp_get_log_level() >= 2)
-        pr_info("kelp: device opened (count=%d)\n",
-                atomic_read(kelp_get_open_count()));
+        pr_info("kelp: device opened (channel=%u, count=%d)\n",
+                ch->id, atomic_read(kelp_get_open_count()));
 
     return 0;
 }
 
 int kelp_chardev_release(struct inode *inode, struct file *file)
 {
-    struct kelp_file_data *fdata = file->private_data;
+    struct kelp_chan *ch = file->private_data;
 
-    if (fdata) {
-        kfree(fdata->read_buf);
-        kfree(fdata);
-    }
+    evfd_set(ch, NULL);
+    xa_erase(&chan_xa, ch->id);
+    kelp_accel_release_file(file);
+    kelp_ring_release_file(file);
 
-    atomic_dec(kelp_get_open_count());
+    /* Let servers blocked on our full inbox give up. */
+    WRITE_ONCE(ch->closed, true);
+    wake_up_all(&ch->inbox.space_wq);
 
     if (kelp_get_log_level() >= 2)
-        pr_info("kelp: device closed (count=%d)\n",
-                atomic_read(kelp_get_open_count()));
+        pr_info("kelp: device closed (channel=%u, count=%d)\n",
+                ch->id, atomic_read(kelp_get_open_count()) - 1);
 
+    chan_put(ch);
+    atomic_dec(kelp_get_open_count());
     return 0;
 }
 
 /*
- * Read from /dev/kelp — returns the next message from the ring buffer.
- * Blocks until data is available.
+ * Copy part of a message to user space.  A framed message is read as its
+ * header followed by the payload.  Returns bytes copied or -EFAULT.
+ */
+static ssize_t msg_copy_out(const struct kelp_msg *msg, bool framed,
+                            size_t pos, char __user *buf, size_t count)
+{
+    size_t hlen = framed ? sizeof(msg->hdr) : 0;
+    size_t total = hlen + msg->hdr.len;
+    size_t n = min(count, total - pos);
+    size_t done = 0;
+
+    if (pos < hlen) {
+        done = min(n, hlen - pos);
+        if (copy_to_user(buf, (const char *)&msg->hdr + pos, done))
+            return -EFAULT;
+    }
+    if (done < n &&
+        copy_to_user(buf + done, msg->data + (pos + done - hlen), n - done))
+        return -EFAULT;
+
+    return (ssize_t)n;
+}
+
+/* Bytes of @msg as this channel reads it (header included if framed). */
+static size_t msg_read_len(const struct kelp_chan *ch, const struct kelp_msg *msg)
+{
+    return (chan_framed(ch) ? sizeof(msg->hdr) : 0) + msg->hdr.len;
+}
+
+/* read() body; ch->read_lock held. */
+static ssize_t chan_read_locked(struct kelp_chan *ch, char __user *buf,
+                                size_t count, bool nonblock)
+{
+    struct kelp_queue *q = chan_read_queue(ch);
+    struct kelp_kstats *st = kelp_get_stats();
+    ssize_t ret;
+
+    while (!ch->cur) {
+        ch->cur = queue_take(q);
+        if (ch->cur) {
+            ch->cur_pos = 0;
+            st->messages_processed++;
+            break;
+        }
+        if (nonblock)
+            return -EAGAIN;
+        ret = wait_event_interruptible(q->data_wq, queue_has_data(q));
+        if (ret)
+            return ret;
+    }
+
+    ret = msg_copy_out(ch->cur, chan_framed(ch), ch->cur_pos, buf, count);
+    if (ret < 0)
+        return ret;
+
+    ch->cur_pos += ret;
+    if (ch->cur_pos >= msg_read_len(ch, ch->cur)) {
+        kfree(ch->cur);
+        ch->cur = NULL;
+    }
+    st->bytes_read += ret;
+    return ret;
+}
+
+/*
+ * Read from /dev/kelp — returns the next message for this channel:
+ * a response for a client, a request for a server.  Blocks until one is
+ * available unless O_NONBLOCK.  A message larger than the buffer is
+ * continued by the following reads.
  */
 ssize_t kelp_chardev_read(struct file *file, char __user *buf,
                             size_t count, loff_t *ppos)
 {
-    struct kelp_file_data *fdata = file->private_data;
-    struct ring_msg *ring = kelp_get_ring();
-    int *tail = kelp_get_ring_tail();
-    int *head = kelp_get_ring_head();
-    spinlock_t *lock = kelp_get_ring_lock();
-    wait_queue_head_t *rq = kelp_get_read_queue();
-    struct kelp_kstats *st = kelp_get_stats();
+    struct kelp_chan *ch = file->private_data;
     ssize_t ret;
-    unsigned long flags;
 
-    /* If we have leftover data from a previous partial read */
-    if (fdata->read_buf && fdata->read_pos < fdata->read_len) {
-        size_t remaining = fdata->read_len - fdata->read_pos;
-        size_t to_copy = min(count, remaining);
+    if (mutex_lock_interruptible(&ch->read_lock))
+        return -ERESTARTSYS;
+    ret = chan_read_locked(ch, buf, count, file->f_flags & O_NONBLOCK);
+    mutex_unlock(&ch->read_lock);
+    return ret;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 4, 0)
+/* Current segment of a user-backed iterator; uio.h has these from 6.4. */
+static void __user *iter_iov_addr(const struct iov_iter *i)
+{
+    if (iter_is_ubuf(i))
+        return i->ubuf + i->iov_offset;
+    return i->iov->iov_base + i->iov_offset;
+}
 
-        if (copy_to_user(buf, fdata->read_buf + fdata->read_pos, to_copy))
-            return -EFAULT;
+static size_t iter_iov_len(const struct iov_iter *i)
+{
+    if (iter_is_ubuf(i))
+        return i->count;
+    return i->iov->iov_len - i->iov_offset;
+}
+#endif
 
-        fdata->read_pos += to_copy;
-        if (fdata->read_pos >= fdata->read_len) {
-            kfree(fdata->read_buf);
-            fdata->read_buf = NULL;
-            fdata->read_len = 0;
-            fdata->read_pos = 0;
+/*
+ * readv() from /dev/kelp — many messages in one call on a framed
+ * channel: each iovec segment receives one whole message, header first,
+ * for as many segments as there are queued messages.  The first segment
+ * is filled exactly as read() would (waiting, or continuing a partly
+ * read message); a later message that does not fit its segment is kept
+ * for the next read.  Unframed channels get one message, as from read().
+ *
+ * Every segment before the last one filled counts whole towards the
+ * return value, so the caller finds message i at the start of segment i.
+ */
+ssize_t kelp_chardev_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct file *file = iocb->ki_filp;
+    struct kelp_chan *ch = file->private_data;
+    struct kelp_queue *q = chan_read_queue(ch);
+    struct kelp_kstats *st = kelp_get_stats();
+    bool nonblock = (file->f_flags & O_NONBLOCK) ||
+                    (iocb->ki_flags & IOCB_NOWAIT);
+    struct kelp_msg *msg;
+    size_t seg, next, len, last, done = 0;
+    ssize_t ret;
+
+    if (!user_backed_iter(to))
+        return -EINVAL;
+    if (!iov_iter_count(to))
+        return 0;
+
+    if (mutex_lock_interruptible(&ch->read_lock))
+        return -ERESTARTSYS;
+
+    seg = iter_iov_len(to);
+    ret = chan_read_locked(ch, iter_iov_addr(to), seg, nonblock);
+    if (ret <= 0 || ch->cur || !chan_framed(ch))
+        goto out;
+
+    last = (size_t)ret;
+    for (;;) {
+        iov_iter_advance(to, seg);
+        if (!iov_iter_count(to))
+            break;
+        next = iter_iov_len(to);
+
+        msg = queue_take(q);
+        if (!msg)
+            break;
+        st->messages_processed++;
+
+        len = msg_read_len(ch, msg);
+        if (len > next ||
+            msg_copy_out(msg, true, 0, iter_iov_addr(to), next) < 0) {
+            /* Left for the next read, which starts at its beginning */
+            ch->cur = msg;
+            ch->cur_pos = 0;
+            break;
         }
+        st->bytes_read += len;
+        kfree(msg);
 
-        st->bytes_read += to_copy;
-        return (ssize_t)to_copy;
+        done += seg;
+        seg = next;
+        last = len;
     }
+    ret = (ssize_t)(done + last);
+out:
+    mutex_unlock(&ch->read_lock);
+    return ret;
+}
 
-    /* Wait for data in ring buffer */
-    if (file->f_flags & O_NONBLOCK) {
-        spin_lock_irqsave(lock, flags);
-        if (*head == *tail) {
-            spin_unlock_irqrestore(lock, flags);
-            return -EAGAIN;
-        }
-        spin_unlock_irqrestore(lock, flags);
-    } else {
-        ret = wait_event_interruptible(*rq, *head != *tail);
+/* Queue @msg on @q, waiting for room unless O_NONBLOCK or @dst closes. */
+static int queue_push_wait(struct file *file, struct kelp_queue *q,
+                           struct kelp_msg *msg, struct kelp_chan *dst)
+{
+    int ret;
+
+    for (;;) {
+        if (dst && READ_ONCE(dst->closed))
+            return -EPIPE;
+        ret = queue_push(q, msg);
+        if (ret != -EAGAIN || (file->f_flags & O_NONBLOCK))
+            return ret;
+        ret = wait_event_interruptible(q->space_wq, queue_has_space(q) ||
+                                       (dst && READ_ONCE(dst->closed)));
         if (ret)
             return ret;
     }
+}
 
-    /* Dequeue message */
-    spin_lock_irqsave(lock, flags);
-    if (*head == *tail) {
-        spin_unlock_irqrestore(lock, flags);
-        return 0;
-    }
-
-    struct ring_msg *msg = &ring[*tail];
-    char *data = msg->data;
-    size_t data_len = msg->len;
-    msg->data = NULL;
-    msg->len = 0;
-    *tail = (*tail + 1) % RING_SIZE;
-    spin_unlock_irqrestore(lock, flags);
+/* Client write: one request onto the service queue. */
+static ssize_t chan_write_request(struct file *file, struct kelp_chan *ch,
+                                  const char __user *buf, size_t count)
+{
+    struct kelp_msg *msg;
+    uint64_t req_id;
+    int ret;
 
-    wake_up_interruptible(kelp_get_write_queue());
+    if (count > MSG_MAX_LEN)
+        count = MSG_MAX_LEN;
 
-    /* Copy to user */
-    size_t to_copy = min(count, data_len);
-    if (copy_to_user(buf, data, to_copy)) {
-        kfree(data);
+    msg = msg_alloc(count);
+    if (!msg)
+        return -ENOMEM;
+    if (copy_from_user(msg->data, buf, count)) {
+        kfree(msg);
         return -EFAULT;
     }
-
-    /* Save remainder for next read */
-    if (to_copy < data_len) {
-        fdata->read_buf = data;
-        fdata->read_len = data_len;
-        fdata->read_pos = to_copy;
-    } else {
-        kfree(data);
+    msg->hdr.channel = ch->id;
+
+    /* Claim one of this client's request slots, then a queue slot. */
+    for (;;) {
+        if (atomic_inc_return(&ch->requests) <= (int)kelp_get_chan_requests())
+            break;
+        atomic_dec(&ch->requests);
+        ret = -EAGAIN;
+        if (!(file->f_flags & O_NONBLOCK))
+            ret = wait_event_interruptible(serve_q.space_wq,
+                                           chan_has_slot(ch));
+        if (ret) {
+            kfree(msg);
+            return ret;
+        }
+    }
+    refcount_inc(&ch->refs);
+    msg->src = ch;
+    msg->hdr.req_id = req_id = atomic64_inc_return(&ch->last_req_id);
+
+    ret = queue_push_wait(file, &serve_q, msg, NULL);
+    if (ret) {
+        atomic_dec(&ch->requests);
+        chan_put(ch);
+        kfree(msg);
+        return ret;
     }
+    evfd_notify_servers();
 
-    st->bytes_read += to_copy;
-    st->messages_processed++;
-    return (ssize_t)to_copy;
+    if (kelp_get_log_level() >= 2)
+        pr_info("kelp: request %u/%llu queued (%zu bytes)\n",
+                ch->id, req_id, count);
+    return (ssize_t)count;
+}
+
+/* Server write: a header naming the client, then the response payload. */
+static ssize_t chan_write_response(struct file *file, const char __user *buf,
+                                   size_t count)
+{
+    struct kelp_msg_hdr hdr;
+    struct kelp_chan *dst;
+    struct kelp_msg *msg;
+    size_t len;
+    int ret;
+
+    if (count < sizeof(hdr))
+        return -EINVAL;
+    if (copy_from_user(&hdr, buf, sizeof(hdr)))
+        return -EFAULT;
+    len = count - sizeof(hdr);
+    if (len > MSG_MAX_LEN)
+        return -EMSGSIZE;
+
+    dst = chan_get(hdr.channel);
+    if (!dst)
+        goto dropped;
+
+    msg = msg_alloc(len);
+    if (!msg) {
+        chan_put(dst);
+        return -ENOMEM;
+    }
+    if (copy_from_user(msg->data, buf + sizeof(hdr), len)) {
+        kfree(msg);
+        chan_put(dst);
+        return -EFAULT;
+    }
+    msg->hdr.channel = hdr.channel;
+    msg->hdr.req_id = hdr.req_id;
+    msg->hdr.flags = hdr.flags;
+
+    ret = queue_push_wait(file, &dst->inbox, msg, dst);
+    if (ret == 0)
+        evfd_notify_chan(dst);
+    else
+        kfree(msg);
+    chan_put(dst);
+
+    if (ret == -EPIPE)
+        goto dropped;
+    return ret ? ret : (ssize_t)count;
+
+dropped:
+    /* The client has gone away; its response has nowhere to go. */
+    if (kelp_get_log_level() >= 2)
+        pr_info("kelp: response for closed channel %llu dropped\n",
+                hdr.channel);
+    return (ssize_t)count;
 }
 
 /*
- * Write to /dev/kelp — enqueue a message in the ring buffer.
- * The gateway daemon reads from this to process requests.
+ * Write to /dev/kelp — a request from a client, or a framed response
+ * from a server.
  */
 ssize_t kelp_chardev_write(struct file *file, const char __user *buf,
                               size_t count, loff_t *ppos)
 {
-    struct ring_msg *ring = kelp_get_ring();
-    int *head = kelp_get_ring_head();
-    int *tail = kelp_get_ring_tail();
-    spinlock_t *lock = kelp_get_ring_lock();
-    wait_queue_head_t *wq = kelp_get_write_queue();
+    struct kelp_chan *ch = file->private_data;
     struct kelp_kstats *st = kelp_get_stats();
-    unsigned long flags;
-    int next;
-    char *data;
+    ssize_t ret;
 
     if (count == 0)
         return 0;
 
-    if (count > MSG_MAX_LEN)
-        count = MSG_MAX_LEN;
+    if (READ_ONCE(ch->role) == KELP_CHAN_SERVER)
+        ret = chan_write_response(file, buf, count);
+    else
+        ret = chan_write_request(file, ch, buf, count);
 
-    /* Allocate buffer for the message */
-    data = kmalloc(count + 1, GFP_KERNEL);
-    if (!data)
-        return -ENOMEM;
+    if (ret > 0)
+        st->bytes_written += ret;
+    return ret;
+}
+
+/*
+ * poll/epoll support — readable when a message (or the rest of a partly
+ * read one) is waiting for this channel; writable while a client's
+ * requests have room on the service queue (servers always may write).
+ */
+__poll_t kelp_chardev_poll(struct file *file, struct poll_table_struct *wait)
+{
+    struct kelp_chan *ch = file->private_data;
+    struct kelp_queue *q = chan_read_queue(ch);
+    __poll_t mask = 0;
+
+    /* The queue depends on the role, so the role is now fixed. */
+    WRITE_ONCE(ch->polled, true);
+    poll_wait(file, &q->data_wq, wait);
+    if (q != &serve_q)
+        poll_wait(file, &serve_q.space_wq, wait);
+
+    if (READ_ONCE(ch->cur) || queue_has_data(q))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (q == &serve_q || chan_may_request(ch))
+        mask |= EPOLLOUT | EPOLLWRNORM;
+
+    return mask;
+}
 
-    if (copy_from_user(data, buf, count)) {
-        kfree(data);
+static int kelp_chardev_set_eventfd(struct file *file, unsigned long arg)
+{
+    struct kelp_chan *ch = file->private_data;
+    struct eventfd_ctx *ctx = NULL;
+    int32_t efd;
+
+    if (copy_from_user(&efd, (void __user *)arg, sizeof(efd)))
         return -EFAULT;
+
+    if (efd >= 0) {
+        ctx = eventfd_ctx_fdget(efd);
+        if (IS_ERR(ctx))
+            return PTR_ERR(ctx);
     }
-    data[count] = '\0';
+    evfd_set(ch, ctx);
+    return 0;
+}
 
-    /* Enqueue in ring buffer */
-    spin_lock_irqsave(lock, flags);
-    next = (*head + 1) % RING_SIZE;
+static int kelp_chardev_chan_setup(struct file *file, unsigned long arg)
+{
+    struct kelp_chan *ch = file->private_data;
+    struct kelp_chan_setup req;
+    int ret = 0;
 
-    if (next == *tail) {
-        /* Ring full */
-        spin_unlock_irqrestore(lock, flags);
-        if (file->f_flags & O_NONBLOCK) {
-            kfree(data);
-            return -EAGAIN;
-        }
-        /* Wait for space */
-        spin_unlock_irqrestore(lock, flags);
-        if (wait_event_interruptible(*wq, ((*head + 1) % RING_SIZE) != *tail)) {
-            kfree(data);
-            return -ERESTARTSYS;
-        }
-        spin_lock_irqsave(lock, flags);
-        next = (*head + 1) % RING_SIZE;
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (req.role > KELP_CHAN_SERVER || (req.flags & ~KELP_CHAN_F_FRAMED) ||
+        req.depth > KELP_CHAN_MAX_DEPTH)
+        return -EINVAL;
+
+    /* A server sees every client's requests and may answer any channel. */
+    if (req.role == KELP_CHAN_SERVER && !capable(CAP_SYS_ADMIN))
+        return -EPERM;
+
+    /*
+     * A half-read message must not change framing under the reader, and
+     * a poller must not be left waiting on the other role's queue.
+     */
+    mutex_lock(&ch->read_lock);
+    if ((ch->cur && (req.role != ch->role || req.flags != ch->flags)) ||
+        (READ_ONCE(ch->polled) && req.role != ch->role)) {
+        ret = -EBUSY;
+        goto out;
     }
+    WRITE_ONCE(ch->role, req.role);
+    ch->flags = req.flags;
+
+    if (req.depth) {
+        spin_lock(&ch->inbox.lock);
+        WRITE_ONCE(ch->inbox.depth, req.depth);
+        spin_unlock(&ch->inbox.lock);
+        wake_up_interruptible(&ch->inbox.space_wq);
+    }
+out:
+    mutex_unlock(&ch->read_lock);
+    return ret;
+}
 
-    /* Free any old message at this slot */
-    kfree(ring[*head].data);
-    ring[*head].data = data;
-    ring[*head].len = count;
-    *head = next;
-    spin_unlock_irqrestore(lock, flags);
-
-    wake_up_interruptible(kelp_get_read_queue());
+static int kelp_chardev_chan_info(struct file *file, unsigned long arg)
+{
+    struct kelp_chan *ch = file->private_data;
+    struct kelp_chan_info info = {
+        .channel     = ch->id,
+        .last_req_id = (uint64_t)atomic64_read(&ch->last_req_id),
+        .role        = READ_ONCE(ch->role),
+        .flags       = ch->flags,
+        .depth       = READ_ONCE(ch->inbox.depth),
+        .queued      = READ_ONCE(ch->inbox.count),
+    };
+
+    if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+        return -EFAULT;
+    return 0;
+}
 
-    st->bytes_written += count;
+void kelp_chardev_init(void)
+{
+    queue_init(&serve_q, kelp_get_serve_depth());
+}
 
-    if (kelp_get_log_level() >= 2)
-        pr_info("kelp: message written (%zu bytes)\n", count);
+/* Called at module unload; every channel is closed by then. */
+void kelp_chardev_exit(void)
+{
+    struct kelp_msg *msg;
 
-    return (ssize_t)count;
+    while ((msg = queue_take(&serve_q)) != NULL)
+        kfree(msg);
+    rcu_barrier();
+    xa_destroy(&chan_xa);
 }
 
-/*
- * ioctl handler for /dev/kelp
- */
 long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
                           unsigned long arg)
 {
-    struct kelp_kstats *st = kelp_get_stats();
-    ktime_t now;
-    s64 uptime_ns;
-
     if (_IOC_TYPE(cmd) != KELP_IOC_MAGIC)
         return -ENOTTY;
-    if (_IOC_NR(cmd) > KELP_IOC_AI_MAXNR)
+    if (_IOC_NR(cmd) > KELP_IOC_NR_LAST)
         return -ENOTTY;
 
     switch (cmd) {
@@ -253,12 +791,10 @@ long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
     }
 
     case KELP_IOC_GET_STATS: {
-        now = ktime_get_boottime();
-        uptime_ns = ktime_to_ns(ktime_sub(now, kelp_get_start_time()));
-        st->uptime_seconds = (uint64_t)(uptime_ns / NSEC_PER_SEC);
-        st->active_sessions = (uint64_t)atomic_read(kelp_get_open_count());
+        struct kelp_kstats kstats;
 
-        if (copy_to_user((void __user *)arg, st, sizeof(*st)))
+        kelp_stats_fill(&kstats);
+        if (copy_to_user((void __user *)arg, &kstats, sizeof(kstats)))
             return -EFAULT;
         return 0;
     }
@@ -283,7 +819,6 @@ long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
 
     case KELP_IOC_QUERY_STATUS: {
         struct kelp_kstatus status;
-        now = ktime_get_boottime();
 
         status.netfilter_enabled = kelp_get_netfilter_enabled();
         status.log_level = kelp_get_log_level();
@@ -302,6 +837,21 @@ long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
     case KELP_IOC_POLL_INFER:
         return kelp_ai_sched_poll(arg);
 
+    case KELP_IOC_SUBMIT_BATCH:
+        return kelp_ai_sched_submit_batch(arg);
+
+    case KELP_IOC_POLL_BATCH:
+        return kelp_ai_sched_poll_batch(arg);
+
+    case KELP_IOC_SCHED_GET:
+        return kelp_ai_sched_get_config(arg);
+
+    case KELP_IOC_SCHED_SET:
+        return kelp_ai_sched_set_config(arg);
+
+    case KELP_IOC_SCHED_WEIGHT:
+        return kelp_ai_sched_set_weight(arg);
+
     /* AI Primitives — semantic FS events */
     case KELP_IOC_SEMFS_EVENTS:
         return kelp_semfs_get_events(arg);
@@ -314,40 +864,51 @@ long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
         return kelp_accel_list(arg);
 
     case KELP_IOC_ACCEL_RESERVE:
-        return kelp_accel_reserve(arg);
+        return kelp_accel_reserve(file, arg);
+
+    case KELP_IOC_ACCEL_RELEASE:
+        return kelp_accel_release(file, arg);
+
+    case KELP_IOC_ACCEL_BUF_INFO:
+        return kelp_accel_buf_info(arg);
 
     /* AI Primitives — unified status */
     case KELP_IOC_AI_STATUS: {
         struct kelp_ai_status ai_status;
-        now = ktime_get_boottime();
 
-        memset(&ai_status, 0, sizeof(ai_status));
+        kelp_stats_fill_ai(&ai_status);
+        if (copy_to_user((void __user *)arg, &ai_status, sizeof(ai_status)))
+            return -EFAULT;
+        return 0;
+    }
 
-        /* Base status */
-        ai_status.netfilter_enabled = kelp_get_netfilter_enabled();
-        ai_status.log_level = kelp_get_log_level();
-        ai_status.chardev_open_count = atomic_read(kelp_get_open_count());
-        ai_status.start_time = (uint64_t)ktime_to_ns(kelp_get_start_time());
+    /* Shared-memory ring wakeups */
+    case KELP_IOC_RING_WAIT:
+        return kelp_ring_wait(file, arg);
 
-        /* Scheduler stats */
-        ai_status.sched_queue_depth = kelp_ai_sched_get_depth();
-        ai_status.sched_total_submitted = kelp_ai_sched_get_total_submitted();
-        ai_status.sched_total_completed = kelp_ai_sched_get_total_completed();
+    case KELP_IOC_RING_KICK:
+        return kelp_ring_kick(file, arg);
 
-        /* Semantic FS stats */
-        ai_status.semfs_total_events = kelp_semfs_get_total_events();
-        ai_status.semfs_active_watches = kelp_semfs_get_active_watches();
-        ai_status.semfs_buffer_used = kelp_semfs_get_buffer_used();
+    /* Readiness notification */
+    case KELP_IOC_SET_EVENTFD:
+        return kelp_chardev_set_eventfd(file, arg);
 
-        /* Accelerator stats */
-        ai_status.accel_count = kelp_accel_get_count();
+    /* Channels */
+    case KELP_IOC_CHAN_SETUP:
+        return kelp_chardev_chan_setup(file, arg);
 
-        if (copy_to_user((void __user *)arg, &ai_status, sizeof(ai_status)))
-            return -EFAULT;
-        return 0;
-    }
+    case KELP_IOC_CHAN_INFO:
+        return kelp_chardev_chan_info(file, arg);
+
+    /* Network flows */
+    case KELP_IOC_NF_FLOWS:
+        return kelp_nf_get_flows(arg);
 
     default:
         return -ENOTTY;
     }
 }
+
+#if IS_ENABLED(CONFIG_KELP_KUNIT_TEST)
+#include "tests/kelp_chardev_test.c"
+#endif
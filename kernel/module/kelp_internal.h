@@ -7,19 +7,41 @@
 #define _KELP_INTERNAL_H
 
 #include <linux/fs.h>
+#include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/ktime.h>
 #include <linux/spinlock.h>
+#include <linux/version.h>
 #include <linux/wait.h>
 #include <linux/atomic.h>
 
 #include "../include/kelp/kelp_kernel.h"
 
-/* Ring buffer message (shared struct) */
-struct ring_msg {
-    char   *data;
-    size_t  len;
-};
+/*
+ * Oldest kernel the module builds against: user_backed_iter() and
+ * ITER_UBUF arrived in 6.0.  Newer interfaces are wrapped below, or next
+ * to their single caller (class_create, iter_iov_addr/iter_iov_len).
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 0, 0)
+#error "kelp needs Linux 6.0 or newer"
+#endif
+
+/* vm_flags became read-only with vm_flags_set/_mod() in 6.3. */
+static inline void kelp_vm_flags_mod(struct vm_area_struct *vma,
+                                     vm_flags_t set, vm_flags_t clear)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_mod(vma, set, clear);
+#else
+    vma->vm_flags = (vma->vm_flags | set) & ~clear;
+#endif
+}
+
+static inline void kelp_vm_flags_set(struct vm_area_struct *vma,
+                                     vm_flags_t flags)
+{
+    kelp_vm_flags_mod(vma, flags, 0);
+}
 
 /* kelp_mod.c — global state accessors */
 struct kelp_kstats *kelp_get_stats(void);
@@ -28,22 +50,44 @@ int kelp_get_netfilter_enabled(void);
 ktime_t kelp_get_start_time(void);
 atomic_t *kelp_get_open_count(void);
 struct mutex *kelp_get_mutex(void);
-struct ring_msg *kelp_get_ring(void);
-int *kelp_get_ring_head(void);
-int *kelp_get_ring_tail(void);
-spinlock_t *kelp_get_ring_lock(void);
-wait_queue_head_t *kelp_get_read_queue(void);
-wait_queue_head_t *kelp_get_write_queue(void);
-
-/* kelp_chardev.c */
+uint32_t kelp_get_chan_depth(void);
+uint32_t kelp_get_serve_depth(void);
+uint32_t kelp_get_chan_requests(void);
+uint32_t kelp_get_sched_policy(void);
+uint32_t kelp_get_sched_aging_ms(void);
+uint32_t kelp_get_sched_batch_window_us(void);
+uint32_t kelp_get_semfs_ring_kb(void);
+uint32_t kelp_get_semfs_coalesce_ms(void);
+uint32_t kelp_get_nf_flow_slots(void);
+uint32_t kelp_get_stats_interval_ms(void);
+uint32_t kelp_get_accel_mem_mb(void);
+
+/* kelp_chardev.c — per-file message channels */
+void kelp_chardev_init(void);
+void kelp_chardev_exit(void);
 int kelp_chardev_open(struct inode *inode, struct file *file);
 int kelp_chardev_release(struct inode *inode, struct file *file);
 ssize_t kelp_chardev_read(struct file *file, char __user *buf,
                             size_t count, loff_t *ppos);
+ssize_t kelp_chardev_read_iter(struct kiocb *iocb, struct iov_iter *to);
 ssize_t kelp_chardev_write(struct file *file, const char __user *buf,
                               size_t count, loff_t *ppos);
 long kelp_chardev_ioctl(struct file *file, unsigned int cmd,
                           unsigned long arg);
+__poll_t kelp_chardev_poll(struct file *file, struct poll_table_struct *wait);
+
+/* kelp_ring.c — shared-memory message ring */
+int kelp_chardev_mmap(struct file *file, struct vm_area_struct *vma);
+int kelp_ring_wait(struct file *file, unsigned long arg);
+int kelp_ring_kick(struct file *file, unsigned long arg);
+void kelp_ring_release_file(struct file *file);
+
+/* kelp_stats.c — mmap'able stats page */
+struct kelp_ai_status;
+void kelp_stats_fill(struct kelp_kstats *ks);
+void kelp_stats_fill_ai(struct kelp_ai_status *ai);
+int kelp_stats_mmap(struct vm_area_struct *vma);
+void kelp_stats_exit(void);
 
 /* kelp_procfs.c */
 int kelp_procfs_init(void);
@@ -52,7 +96,10 @@ void kelp_procfs_exit(void);
 /* kelp_netfilter.c */
 int kelp_netfilter_init(void);
 void kelp_netfilter_exit(void);
-int kelp_nf_get_recent(char *buf, size_t buf_size);
+struct seq_file;
+uint64_t kelp_nf_get_packets(void);
+int kelp_nf_get_flows(unsigned long arg);
+void kelp_nf_show(struct seq_file *m);
 
 /* kelp_procfs.c — proc_dir accessor for AI subsystem registration */
 struct proc_dir_entry *kelp_procfs_get_dir(void);
@@ -62,6 +109,11 @@ int kelp_ai_sched_init(struct proc_dir_entry *proc_dir);
 void kelp_ai_sched_exit(void);
 int kelp_ai_sched_submit(unsigned long arg);
 int kelp_ai_sched_poll(unsigned long arg);
+int kelp_ai_sched_submit_batch(unsigned long arg);
+int kelp_ai_sched_poll_batch(unsigned long arg);
+int kelp_ai_sched_get_config(unsigned long arg);
+int kelp_ai_sched_set_config(unsigned long arg);
+int kelp_ai_sched_set_weight(unsigned long arg);
 uint32_t kelp_ai_sched_get_depth(void);
 uint32_t kelp_ai_sched_get_total_submitted(void);
 uint32_t kelp_ai_sched_get_total_completed(void);
@@ -71,6 +123,8 @@ int kelp_semfs_init(struct proc_dir_entry *proc_dir);
 void kelp_semfs_exit(void);
 int kelp_semfs_get_events(unsigned long arg);
 int kelp_semfs_watch(unsigned long arg);
+void kelp_semfs_notify(uint32_t type, uint32_t uid, dev_t dev,
+                       unsigned long ino, const char *path);
 uint64_t kelp_semfs_get_total_events(void);
 uint32_t kelp_semfs_get_active_watches(void);
 uint32_t kelp_semfs_get_buffer_used(void);
@@ -79,7 +133,11 @@ uint32_t kelp_semfs_get_buffer_used(void);
 int kelp_accel_init(struct proc_dir_entry *proc_dir);
 void kelp_accel_exit(void);
 int kelp_accel_list(unsigned long arg);
-int kelp_accel_reserve(unsigned long arg);
+int kelp_accel_reserve(struct file *file, unsigned long arg);
+int kelp_accel_release(struct file *file, unsigned long arg);
+int kelp_accel_buf_info(unsigned long arg);
+void kelp_accel_release_file(struct file *file);
+int kelp_accel_mmap(struct vm_area_struct *vma);
 uint32_t kelp_accel_get_count(void);
 
 #endif /* _KELP_INTERNAL_H */
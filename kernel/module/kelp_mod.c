@@ -22,6 +22,7 @@
 #include <linux/seq_file.h>
 #include <linux/time64.h>
 #include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter_ipv4.h>
 #include <linux/ip.h>
@@ -44,6 +45,50 @@ static int enable_netfilter = 1;
 module_param(enable_netfilter, int, 0644);
 MODULE_PARM_DESC(enable_netfilter, "Enable netfilter hooks (0=off, 1=on)");
 
+static unsigned int chan_depth = 64;
+module_param(chan_depth, uint, 0644);
+MODULE_PARM_DESC(chan_depth, "Responses queued per open file (default depth, 1-4096)");
+
+static unsigned int serve_depth = 256;
+module_param(serve_depth, uint, 0444);
+MODULE_PARM_DESC(serve_depth, "Requests queued for servers across all clients (1-4096)");
+
+static unsigned int chan_requests = 32;
+module_param(chan_requests, uint, 0644);
+MODULE_PARM_DESC(chan_requests, "Requests one client may have queued for servers (1-4096)");
+
+static unsigned int sched_policy;
+module_param(sched_policy, uint, 0444);
+MODULE_PARM_DESC(sched_policy, "Inference scheduling policy at load (0=priority, 1=fair, 2=edf)");
+
+static unsigned int sched_aging_ms = 500;
+module_param(sched_aging_ms, uint, 0444);
+MODULE_PARM_DESC(sched_aging_ms, "Waiting time worth one priority level (ms, 0=strict priority)");
+
+static unsigned int sched_batch_window_us;
+module_param(sched_batch_window_us, uint, 0444);
+MODULE_PARM_DESC(sched_batch_window_us, "Batch same-model tasks submitted within this window (us, 0=off)");
+
+static unsigned int semfs_ring_kb = 64;
+module_param(semfs_ring_kb, uint, 0444);
+MODULE_PARM_DESC(semfs_ring_kb, "Semantic FS event ring per CPU (KiB, power of two, 4-16384)");
+
+static unsigned int semfs_coalesce_ms = 100;
+module_param(semfs_coalesce_ms, uint, 0644);
+MODULE_PARM_DESC(semfs_coalesce_ms, "Drop repeated MODIFY events for an inode within this window (ms, 0=off)");
+
+static unsigned int nf_flow_slots = 1024;
+module_param(nf_flow_slots, uint, 0444);
+MODULE_PARM_DESC(nf_flow_slots, "Network flows tracked per CPU between exports (power of two, 64-65536)");
+
+static unsigned int stats_interval_ms = 10;
+module_param(stats_interval_ms, uint, 0644);
+MODULE_PARM_DESC(stats_interval_ms, "Refresh period of the mmap'd stats page while mapped (ms, 1-1000)");
+
+static unsigned int accel_mem_mb = 256;
+module_param(accel_mem_mb, uint, 0644);
+MODULE_PARM_DESC(accel_mem_mb, "Host memory for shared tensor buffers (MiB, 0=off)");
+
 /* Global state */
 static dev_t            kelp_dev;
 static struct cdev      kelp_cdev;
@@ -56,25 +101,17 @@ static struct kelp_kstats stats;
 static ktime_t module_start_time;
 static atomic_t open_count = ATOMIC_INIT(0);
 
-/* Message ring buffer for chardev IPC */
-#define RING_SIZE 64
-#define MSG_MAX_LEN KELP_MAX_MSG_SIZE
-
-static struct ring_msg ring_buf[RING_SIZE];
-static int ring_head;  /* Write position */
-static int ring_tail;  /* Read position */
-static DEFINE_SPINLOCK(ring_lock);
-static DECLARE_WAIT_QUEUE_HEAD(read_queue);
-static DECLARE_WAIT_QUEUE_HEAD(write_queue);
-
 /* File operations */
 static const struct file_operations kelp_fops = {
     .owner          = THIS_MODULE,
     .open           = kelp_chardev_open,
     .release        = kelp_chardev_release,
     .read           = kelp_chardev_read,
+    .read_iter      = kelp_chardev_read_iter,
     .write          = kelp_chardev_write,
     .unlocked_ioctl = kelp_chardev_ioctl,
+    .mmap           = kelp_chardev_mmap,
+    .poll           = kelp_chardev_poll,
 };
 
 /* Exported symbols for sub-modules */
@@ -84,14 +121,17 @@ int kelp_get_netfilter_enabled(void) { return enable_netfilter; }
 ktime_t kelp_get_start_time(void) { return module_start_time; }
 atomic_t *kelp_get_open_count(void) { return &open_count; }
 struct mutex *kelp_get_mutex(void) { return &kelp_mutex; }
-
-/* Ring buffer access */
-struct ring_msg *kelp_get_ring(void) { return ring_buf; }
-int *kelp_get_ring_head(void) { return &ring_head; }
-int *kelp_get_ring_tail(void) { return &ring_tail; }
-spinlock_t *kelp_get_ring_lock(void) { return &ring_lock; }
-wait_queue_head_t *kelp_get_read_queue(void) { return &read_queue; }
-wait_queue_head_t *kelp_get_write_queue(void) { return &write_queue; }
+uint32_t kelp_get_chan_depth(void) { return clamp_t(uint32_t, READ_ONCE(chan_depth), 1, KELP_CHAN_MAX_DEPTH); }
+uint32_t kelp_get_serve_depth(void) { return clamp_t(uint32_t, serve_depth, 1, KELP_CHAN_MAX_DEPTH); }
+uint32_t kelp_get_chan_requests(void) { return clamp_t(uint32_t, READ_ONCE(chan_requests), 1, KELP_CHAN_MAX_DEPTH); }
+uint32_t kelp_get_sched_policy(void) { return sched_policy; }
+uint32_t kelp_get_sched_aging_ms(void) { return sched_aging_ms; }
+uint32_t kelp_get_sched_batch_window_us(void) { return sched_batch_window_us; }
+uint32_t kelp_get_semfs_coalesce_ms(void) { return READ_ONCE(semfs_coalesce_ms); }
+uint32_t kelp_get_semfs_ring_kb(void) { return roundup_pow_of_two(clamp_t(uint32_t, semfs_ring_kb, 4, 16384)); }
+uint32_t kelp_get_nf_flow_slots(void) { return roundup_pow_of_two(clamp_t(uint32_t, nf_flow_slots, 64, 65536)); }
+uint32_t kelp_get_stats_interval_ms(void) { return clamp_t(uint32_t, READ_ONCE(stats_interval_ms), 1, 1000); }
+uint32_t kelp_get_accel_mem_mb(void) { return READ_ONCE(accel_mem_mb); }
 
 static int __init kelp_init(void)
 {
@@ -103,6 +143,9 @@ static int __init kelp_init(void)
     module_start_time = ktime_get_boottime();
     memset(&stats, 0, sizeof(stats));
 
+    /* Service queue must exist before the device can be opened */
+    kelp_chardev_init();
+
     /* Allocate chardev region */
     ret = alloc_chrdev_region(&kelp_dev, 0, 1, KELP_DEVICE_NAME);
     if (ret < 0) {
@@ -120,7 +163,11 @@ static int __init kelp_init(void)
     }
 
     /* Create device class */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
     kelp_class = class_create(KELP_CLASS_NAME);
+#else
+    kelp_class = class_create(THIS_MODULE, KELP_CLASS_NAME);
+#endif
     if (IS_ERR(kelp_class)) {
         ret = PTR_ERR(kelp_class);
         pr_err("kelp: failed to create class: %d\n", ret);
@@ -136,11 +183,6 @@ static int __init kelp_init(void)
         goto err_device;
     }
 
-    /* Initialize ring buffer */
-    memset(ring_buf, 0, sizeof(ring_buf));
-    ring_head = 0;
-    ring_tail = 0;
-
     /* Initialize procfs */
     ret = kelp_procfs_init();
     if (ret < 0) {
@@ -190,10 +232,11 @@ err_cdev:
 
 static void __exit kelp_exit(void)
 {
-    int i;
-
     pr_info("kelp: unloading module\n");
 
+    /* Stop the stats page refresh, which reads every subsystem */
+    kelp_stats_exit();
+
     /* Cleanup AI subsystems (reverse order) */
     kelp_accel_exit();
     kelp_semfs_exit();
@@ -207,18 +250,15 @@ static void __exit kelp_exit(void)
     /* Cleanup procfs */
     kelp_procfs_exit();
 
-    /* Free ring buffer messages */
-    for (i = 0; i < RING_SIZE; i++) {
-        kfree(ring_buf[i].data);
-        ring_buf[i].data = NULL;
-    }
-
     /* Destroy device */
     device_destroy(kelp_class, kelp_dev);
     class_destroy(kelp_class);
     cdev_del(&kelp_cdev);
     unregister_chrdev_region(kelp_dev, 1);
 
+    /* Drop requests nobody served */
+    kelp_chardev_exit();
+
     pr_info("kelp: module unloaded\n");
 }
 
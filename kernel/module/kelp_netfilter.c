@@ -1,59 +1,108 @@
 /*
  * kelp_netfilter.c — Netfilter hook for network-aware AI
  *
- * Hooks into the LOCAL_OUT chain to log/inspect outbound connections.
- * Events are made available to userspace via /proc/kelp/netfilter
- * and can be analyzed by the gateway daemon.
+ * Hooks into the LOCAL_OUT chain and aggregates outbound IPv4 packets
+ * into flows keyed by the 5-tuple (addresses, ports, protocol), each with
+ * packet/byte counters and first/last-seen times.  The gateway drains the
+ * flows in batches through KELP_IOC_NF_FLOWS; /proc/kelp/netfilter shows
+ * a summary.
+ *
+ * Every CPU owns two open-addressed flow tables.  The hook only touches
+ * the active table of the CPU it runs on, with bottom halves disabled, so
+ * the packet path takes no lock and shares no cache line with other CPUs.
+ * An export retires the active tables by flipping nf_active and waiting
+ * for an RCU grace period (hooks run under rcu_read_lock), after which the
+ * retired tables are private to the exporter and are copied out and
+ * cleared, possibly over several calls.  Only when they are empty again
+ * is the next flip allowed.
  */
 
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter_ipv4.h>
+#include <linux/netdevice.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
 #include <linux/udp.h>
 #include <linux/inet.h>
-#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/percpu.h>
+#include <linux/bottom_half.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
 #include "kelp_internal.h"
 
-/* Recent connection log — circular buffer of recent network events */
-#define NF_LOG_SIZE 256
+/* Slots probed for a flow before the packet is counted as overflow */
+#define NF_FLOW_PROBE   8
+
+/* Flows listed in /proc/kelp/netfilter */
+#define NF_SHOW_FLOWS   20
 
-struct nf_event {
-    __be32   src_ip;
-    __be32   dst_ip;
-    __be16   src_port;
-    __be16   dst_port;
-    uint8_t  protocol;   /* IPPROTO_TCP, IPPROTO_UDP */
-    uint64_t timestamp;  /* ktime in nanoseconds */
+struct nf_flow {
+    __be32   saddr;
+    __be32   daddr;
+    __be16   sport;
+    __be16   dport;
+    uint8_t  protocol;      /* IPPROTO_* */
+    uint8_t  used;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t first_ns;      /* ktime in nanoseconds */
+    uint64_t last_ns;
 };
 
-static struct nf_event nf_log[NF_LOG_SIZE];
-static int nf_log_pos;
-static DEFINE_SPINLOCK(nf_log_lock);
+struct nf_flow_cpu {
+    struct nf_flow *tab[2];
+    uint32_t        flows[2];   /* slots in use per table */
+    uint64_t        packets;    /* every IPv4 packet seen on this CPU */
+    uint64_t        overflow;   /* packets whose flow found no free slot */
+};
+
+static struct nf_flow_cpu __percpu *nf_cpu;
+static uint32_t nf_slots;       /* per table, power of two */
+static uint32_t nf_seed;
+static int nf_active;           /* table the hook writes to */
+
+/* Export cursor: the retired table is drained CPU by CPU */
+static DEFINE_MUTEX(nf_export_lock);
+static int nf_drain_idx;
+static unsigned int nf_drain_cpu = UINT_MAX;
+static uint32_t nf_drain_slot;
 
 /* Netfilter hook struct */
 static struct nf_hook_ops nf_hook_ops;
 
+static bool nf_flow_match(const struct nf_flow *f, const struct iphdr *iph,
+                          __be16 sport, __be16 dport)
+{
+    return f->saddr == iph->saddr && f->daddr == iph->daddr &&
+           f->sport == sport && f->dport == dport &&
+           f->protocol == iph->protocol;
+}
+
 /*
  * Netfilter hook callback — called for each outbound IPv4 packet.
  *
- * Currently logs TCP/UDP connections. In production, this would
- * feed events to the gateway daemon for AI-powered analysis.
+ * Accounts the packet to its flow in this CPU's active table.  A flow
+ * whose probe window is full is not recorded; the packet is counted in
+ * the per-CPU overflow counter instead.
  */
 static unsigned int kelp_nf_hook(void *priv,
                                    struct sk_buff *skb,
                                    const struct nf_hook_state *state)
 {
+    struct nf_flow_cpu *fc;
+    struct nf_flow *tab, *f;
     struct iphdr *iph;
-    struct tcphdr *tcph;
-    struct udphdr *udph;
-    struct kelp_kstats *st = kelp_get_stats();
-    struct nf_event *ev;
-    unsigned long flags;
+    __be16 sport = 0, dport = 0;
+    uint32_t hash, i;
+    uint64_t now;
+    int idx;
 
     if (!skb)
         return NF_ACCEPT;
@@ -62,98 +111,305 @@ static unsigned int kelp_nf_hook(void *priv,
     if (!iph)
         return NF_ACCEPT;
 
-    st->netfilter_packets++;
-
-    /* Only log TCP and UDP */
-    if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP)
-        return NF_ACCEPT;
+    if (iph->protocol == IPPROTO_TCP) {
+        struct tcphdr *tcph = tcp_hdr(skb);
 
-    spin_lock_irqsave(&nf_log_lock, flags);
-    ev = &nf_log[nf_log_pos];
-    ev->src_ip = iph->saddr;
-    ev->dst_ip = iph->daddr;
-    ev->protocol = iph->protocol;
-    ev->timestamp = ktime_get_ns();
+        sport = tcph->source;
+        dport = tcph->dest;
 
-    if (iph->protocol == IPPROTO_TCP) {
-        tcph = tcp_hdr(skb);
-        if (tcph) {
-            ev->src_port = tcph->source;
-            ev->dst_port = tcph->dest;
-
-            /* Log new connections (SYN packets) at debug level */
-            if (tcph->syn && !tcph->ack && kelp_get_log_level() >= 2) {
-                pr_info("kelp: TCP SYN %pI4:%d -> %pI4:%d\n",
-                        &iph->saddr, ntohs(tcph->source),
-                        &iph->daddr, ntohs(tcph->dest));
-            }
+        /* Log new connections (SYN packets) at debug level */
+        if (tcph->syn && !tcph->ack && kelp_get_log_level() >= 2) {
+            pr_info("kelp: TCP SYN %pI4:%d -> %pI4:%d\n",
+                    &iph->saddr, ntohs(tcph->source),
+                    &iph->daddr, ntohs(tcph->dest));
         }
     } else if (iph->protocol == IPPROTO_UDP) {
-        udph = udp_hdr(skb);
-        if (udph) {
-            ev->src_port = udph->source;
-            ev->dst_port = udph->dest;
+        struct udphdr *udph = udp_hdr(skb);
+
+        sport = udph->source;
+        dport = udph->dest;
+    }
+
+    hash = jhash_3words((__force u32)iph->saddr, (__force u32)iph->daddr,
+                        ((__force u32)sport << 16) | (__force u32)dport,
+                        nf_seed ^ iph->protocol);
+    now = ktime_get_ns();
+
+    /* Process-context senders can be interrupted by softirq ones */
+    local_bh_disable();
+    fc = this_cpu_ptr(nf_cpu);
+    fc->packets++;
+
+    idx = READ_ONCE(nf_active);
+    tab = fc->tab[idx];
+    for (i = 0; i < NF_FLOW_PROBE; i++) {
+        f = &tab[(hash + i) & (nf_slots - 1)];
+        if (!f->used) {
+            f->saddr    = iph->saddr;
+            f->daddr    = iph->daddr;
+            f->sport    = sport;
+            f->dport    = dport;
+            f->protocol = iph->protocol;
+            f->first_ns = now;
+            f->used     = 1;
+            fc->flows[idx]++;
+            goto account;
         }
+        if (nf_flow_match(f, iph, sport, dport))
+            goto account;
     }
+    fc->overflow++;
+    goto out;
 
-    nf_log_pos = (nf_log_pos + 1) % NF_LOG_SIZE;
-    spin_unlock_irqrestore(&nf_log_lock, flags);
+account:
+    f->packets++;
+    f->bytes += skb->len;
+    f->last_ns = now;
+out:
+    local_bh_enable();
 
     /* Always accept — we're monitoring, not filtering */
     return NF_ACCEPT;
 }
 
-/* Get netfilter log for procfs */
-int kelp_nf_get_recent(char *buf, size_t buf_size)
+/*
+ * Per-CPU counters are written only by their own CPU; readers sum them
+ * without synchronisation, which is exact enough for statistics.
+ */
+uint64_t kelp_nf_get_packets(void)
+{
+    uint64_t sum = 0;
+    int cpu;
+
+    if (!nf_cpu)
+        return 0;
+    for_each_possible_cpu(cpu)
+        sum += data_race(per_cpu_ptr(nf_cpu, cpu)->packets);
+    return sum;
+}
+
+static uint64_t nf_get_overflow(void)
+{
+    uint64_t sum = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        sum += data_race(per_cpu_ptr(nf_cpu, cpu)->overflow);
+    return sum;
+}
+
+/* Caller holds nf_export_lock and the retired tables are quiescent */
+static uint32_t nf_drain(struct kelp_nf_flow *out, uint32_t cap)
 {
-    unsigned long flags;
-    int pos = 0;
-    int i, idx;
+    uint32_t n = 0;
 
-    spin_lock_irqsave(&nf_log_lock, flags);
+    while (n < cap && nf_drain_cpu < nr_cpu_ids) {
+        struct nf_flow_cpu *fc = per_cpu_ptr(nf_cpu, nf_drain_cpu);
+        struct nf_flow *tab = fc->tab[nf_drain_idx];
 
-    /* Show last 20 events */
-    for (i = 0; i < 20 && i < NF_LOG_SIZE; i++) {
-        idx = (nf_log_pos - 1 - i + NF_LOG_SIZE) % NF_LOG_SIZE;
-        struct nf_event *ev = &nf_log[idx];
+        for (; nf_drain_slot < nf_slots && n < cap; nf_drain_slot++) {
+            struct nf_flow *f = &tab[nf_drain_slot];
+            struct kelp_nf_flow *o;
 
-        if (ev->timestamp == 0) continue; /* Empty slot */
+            if (!f->used)
+                continue;
 
-        pos += snprintf(buf + pos, buf_size - (size_t)pos,
-                        "  %pI4:%d -> %pI4:%d %s\n",
-                        &ev->src_ip, ntohs(ev->src_port),
-                        &ev->dst_ip, ntohs(ev->dst_port),
-                        ev->protocol == IPPROTO_TCP ? "TCP" : "UDP");
+            o = &out[n++];
+            memset(o, 0, sizeof(*o));
+            o->saddr    = (__force uint32_t)f->saddr;
+            o->daddr    = (__force uint32_t)f->daddr;
+            o->sport    = (__force uint16_t)f->sport;
+            o->dport    = (__force uint16_t)f->dport;
+            o->protocol = f->protocol;
+            o->cpu      = nf_drain_cpu;
+            o->packets  = f->packets;
+            o->bytes    = f->bytes;
+            o->first_ns = f->first_ns;
+            o->last_ns  = f->last_ns;
+
+            memset(f, 0, sizeof(*f));
+        }
 
-        if ((size_t)pos >= buf_size - 1) break;
+        if (nf_drain_slot < nf_slots)
+            break;
+
+        fc->flows[nf_drain_idx] = 0;
+        nf_drain_cpu = cpumask_next(nf_drain_cpu, cpu_possible_mask);
+        nf_drain_slot = 0;
     }
+    return n;
+}
+
+/*
+ * KELP_IOC_NF_FLOWS — export flows in batches.
+ *
+ * The first call of an interval retires the active tables; it and the
+ * following calls return their flows until KELP_NF_BATCH_MORE is clear.
+ * A flow carried by several CPUs is reported once per CPU.
+ */
+int kelp_nf_get_flows(unsigned long arg)
+{
+    struct kelp_nf_flow_batch req;
+    struct kelp_nf_flow *out;
+    uint32_t cap, n;
+
+    if (!nf_cpu)
+        return -ENODEV;
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (!req.flows || req.count == 0)
+        return -EINVAL;
+
+    cap = min_t(uint32_t, req.count, KELP_NF_BATCH_MAX);
+    out = kvmalloc_array(cap, sizeof(*out), GFP_KERNEL);
+    if (!out)
+        return -ENOMEM;
 
-    spin_unlock_irqrestore(&nf_log_lock, flags);
-    return pos;
+    mutex_lock(&nf_export_lock);
+    if (nf_drain_cpu >= nr_cpu_ids) {
+        /* Previous interval fully exported: retire the active tables */
+        nf_drain_idx = nf_active;
+        WRITE_ONCE(nf_active, !nf_drain_idx);
+        synchronize_net();
+        nf_drain_cpu = cpumask_first(cpu_possible_mask);
+        nf_drain_slot = 0;
+    }
+    n = nf_drain(out, cap);
+
+    req.count    = n;
+    req.flags    = nf_drain_cpu < nr_cpu_ids ? KELP_NF_BATCH_MORE : 0;
+    req.overflow = nf_get_overflow();
+    mutex_unlock(&nf_export_lock);
+
+    if (copy_to_user(u64_to_user_ptr(req.flows), out, n * sizeof(*out)) ||
+        copy_to_user((void __user *)arg, &req, sizeof(req))) {
+        kvfree(out);
+        return -EFAULT;
+    }
+    kvfree(out);
+    return 0;
+}
+
+/* /proc/kelp/netfilter — flow table summary and a sample of live flows */
+void kelp_nf_show(struct seq_file *m)
+{
+    int idx, cpu, shown = 0;
+    uint32_t i;
+
+    if (!nf_cpu) {
+        seq_printf(m, "  (flow tables not allocated)\n");
+        return;
+    }
+
+    idx = READ_ONCE(nf_active);
+    seq_printf(m, "Packets:   %llu\n", kelp_nf_get_packets());
+    seq_printf(m, "Overflow:  %llu\n", nf_get_overflow());
+    seq_printf(m, "Slots:     %u per CPU\n\n", nf_slots);
+
+    seq_printf(m, "%-5s %12s %8s %10s\n", "CPU", "PACKETS", "FLOWS", "OVERFLOW");
+    for_each_possible_cpu(cpu) {
+        struct nf_flow_cpu *fc = per_cpu_ptr(nf_cpu, cpu);
+
+        seq_printf(m, "%-5d %12llu %8u %10llu\n", cpu,
+                   data_race(fc->packets), data_race(fc->flows[idx]),
+                   data_race(fc->overflow));
+    }
+
+    /* Live tables are being written; counts shown are approximate */
+    seq_printf(m, "\nActive Flows\n");
+    for_each_possible_cpu(cpu) {
+        struct nf_flow *tab = per_cpu_ptr(nf_cpu, cpu)->tab[idx];
+
+        for (i = 0; i < nf_slots && shown < NF_SHOW_FLOWS; i++) {
+            struct nf_flow f = data_race(tab[i]);
+
+            if (!f.used)
+                continue;
+            seq_printf(m, "  %pI4:%d -> %pI4:%d %s  %llu pkts %llu bytes\n",
+                       &f.saddr, ntohs(f.sport), &f.daddr, ntohs(f.dport),
+                       f.protocol == IPPROTO_TCP ? "TCP" :
+                       f.protocol == IPPROTO_UDP ? "UDP" : "IP",
+                       f.packets, f.bytes);
+            shown++;
+        }
+    }
+    if (!shown)
+        seq_printf(m, "  (no flows)\n");
+}
+
+static void nf_free_tables(void)
+{
+    int cpu;
+
+    if (!nf_cpu)
+        return;
+    for_each_possible_cpu(cpu) {
+        struct nf_flow_cpu *fc = per_cpu_ptr(nf_cpu, cpu);
+
+        kvfree(fc->tab[0]);
+        kvfree(fc->tab[1]);
+    }
+    free_percpu(nf_cpu);
+    nf_cpu = NULL;
+}
+
+static int nf_alloc_tables(uint32_t slots)
+{
+    int cpu;
+
+    nf_cpu = alloc_percpu(struct nf_flow_cpu);
+    if (!nf_cpu)
+        return -ENOMEM;
+
+    for_each_possible_cpu(cpu) {
+        struct nf_flow_cpu *fc = per_cpu_ptr(nf_cpu, cpu);
+
+        fc->tab[0] = kvzalloc_node(slots * sizeof(struct nf_flow),
+                                   GFP_KERNEL, cpu_to_node(cpu));
+        fc->tab[1] = kvzalloc_node(slots * sizeof(struct nf_flow),
+                                   GFP_KERNEL, cpu_to_node(cpu));
+        if (!fc->tab[0] || !fc->tab[1]) {
+            nf_free_tables();
+            return -ENOMEM;
+        }
+    }
+    return 0;
 }
 
 int kelp_netfilter_init(void)
 {
-    memset(nf_log, 0, sizeof(nf_log));
-    nf_log_pos = 0;
+    int ret;
+
+    nf_slots = kelp_get_nf_flow_slots();
+    nf_seed = get_random_u32();
+    nf_active = 0;
+    nf_drain_cpu = UINT_MAX;
+
+    ret = nf_alloc_tables(nf_slots);
+    if (ret < 0)
+        return ret;
 
     nf_hook_ops.hook     = kelp_nf_hook;
     nf_hook_ops.pf       = PF_INET;
     nf_hook_ops.hooknum  = NF_INET_LOCAL_OUT;
     nf_hook_ops.priority = NF_IP_PRI_LAST;
 
-    int ret = nf_register_net_hook(&init_net, &nf_hook_ops);
+    ret = nf_register_net_hook(&init_net, &nf_hook_ops);
     if (ret < 0) {
         pr_err("kelp: failed to register netfilter hook: %d\n", ret);
+        nf_free_tables();
         return ret;
     }
 
-    pr_info("kelp: netfilter hook registered (LOCAL_OUT)\n");
+    pr_info("kelp: netfilter hook registered (LOCAL_OUT, %u flows/CPU)\n",
+            nf_slots);
     return 0;
 }
 
 void kelp_netfilter_exit(void)
 {
+    /* Waits for hooks in flight, so the tables can go right after */
     nf_unregister_net_hook(&init_net, &nf_hook_ops);
+    nf_free_tables();
     pr_info("kelp: netfilter hook unregistered\n");
 }
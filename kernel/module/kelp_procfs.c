@@ -41,7 +41,7 @@ static int stats_show(struct seq_file *m, void *v)
     seq_printf(m, "Active handles:      %d\n", atomic_read(kelp_get_open_count()));
     seq_printf(m, "Netfilter enabled:   %s\n",
                kelp_get_netfilter_enabled() ? "yes" : "no");
-    seq_printf(m, "Netfilter packets:   %llu\n", st->netfilter_packets);
+    seq_printf(m, "Netfilter packets:   %llu\n", kelp_nf_get_packets());
     seq_printf(m, "Netfilter blocked:   %llu\n", st->netfilter_blocked);
     seq_printf(m, "Log level:           %d\n", kelp_get_log_level());
 
@@ -61,34 +61,19 @@ static const struct proc_ops stats_proc_ops = {
 };
 
 /*
- * /proc/kelp/netfilter — show recent network events
+ * /proc/kelp/netfilter — show network flow tables
  */
 static int netfilter_show(struct seq_file *m, void *v)
 {
-    char *buf;
-    int len;
-
-    seq_printf(m, "Recent Network Events\n");
-    seq_printf(m, "=====================\n");
+    seq_printf(m, "Network Flows\n");
+    seq_printf(m, "=============\n");
 
     if (!kelp_get_netfilter_enabled()) {
         seq_printf(m, "  (netfilter hooks disabled)\n");
         return 0;
     }
 
-    buf = kmalloc(4096, GFP_KERNEL);
-    if (!buf)
-        return -ENOMEM;
-
-    len = kelp_nf_get_recent(buf, 4096);
-    if (len > 0) {
-        seq_printf(m, "%s", buf);
-    } else {
-        seq_printf(m, "  (no recent events)\n");
-    }
-
-    kfree(buf);
-
+    kelp_nf_show(m);
     return 0;
 }
 
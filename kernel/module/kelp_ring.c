@@ -0,0 +1,263 @@
+/*
+ * kelp_ring.c — mmap'able shared-memory message ring for /dev/kelp
+ *
+ * The read/write path copies every message twice (copy_from_user into a
+ * kmalloc'd buffer, copy_to_user out of it) and takes the ring spinlock
+ * for each one.  The shared ring lets user space exchange messages in
+ * place: the module only allocates the pages, maps them, and provides the
+ * sleep/wake side of the protocol described in kelp_kernel.h.
+ *
+ * Each open file has a ring of its own, allocated with vmalloc_user() on
+ * its first mmap and freed when the file is released; sharing a ring
+ * means sharing the file (fork, SCM_RIGHTS), so a ring is only ever
+ * visible to whoever holds that file.  Its contents are entirely
+ * user-controlled, so the kernel only ever reads indices from it to
+ * decide whether a waiter may proceed, and masks every index before
+ * using it.
+ */
+
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#include "kelp_internal.h"
+#include "../include/kelp/kelp_ai.h"
+
+#define RING_DESC_OFFSET  PAGE_SIZE
+#define RING_DATA_OFFSET  (RING_DESC_OFFSET + \
+                           PAGE_ALIGN(KELP_RING_SLOTS * sizeof(struct kelp_ring_desc)))
+#define RING_MAP_SIZE     (RING_DATA_OFFSET + \
+                           (size_t)KELP_RING_SLOTS * KELP_RING_SLOT_SIZE)
+
+struct kelp_ring {
+    void               *mem;
+    struct file        *owner;      /* mapping file, compared only */
+    struct list_head    node;       /* on ring_list */
+    wait_queue_head_t   data_wq;
+    wait_queue_head_t   space_wq;
+};
+
+/* Rings by owning file; a file has at most one */
+static LIST_HEAD(ring_list);
+static DEFINE_MUTEX(ring_lock);
+
+static struct kelp_ring_hdr *ring_hdr(struct kelp_ring *r)
+{
+    return r->mem;
+}
+
+static struct kelp_ring_desc *ring_desc(struct kelp_ring *r, uint64_t pos)
+{
+    struct kelp_ring_desc *d = r->mem + RING_DESC_OFFSET;
+
+    return &d[pos & (KELP_RING_SLOTS - 1)];
+}
+
+/* A message is ready at the consumer position. */
+static bool ring_has_data(struct kelp_ring *r)
+{
+    uint64_t tail = READ_ONCE(ring_hdr(r)->tail);
+
+    return READ_ONCE(ring_desc(r, tail)->seq) == tail + 1;
+}
+
+/* The slot at the producer position is free. */
+static bool ring_has_space(struct kelp_ring *r)
+{
+    uint64_t head = READ_ONCE(ring_hdr(r)->head);
+
+    return READ_ONCE(ring_desc(r, head)->seq) == head;
+}
+
+static struct kelp_ring *ring_new(struct file *owner)
+{
+    struct kelp_ring_hdr *hdr;
+    struct kelp_ring *r;
+    uint32_t i;
+
+    r = kzalloc(sizeof(*r), GFP_KERNEL);
+    if (!r)
+        return NULL;
+
+    r->mem = vmalloc_user(RING_MAP_SIZE);
+    if (!r->mem) {
+        kfree(r);
+        return NULL;
+    }
+    r->owner = owner;
+    INIT_LIST_HEAD(&r->node);
+    init_waitqueue_head(&r->data_wq);
+    init_waitqueue_head(&r->space_wq);
+
+    hdr = ring_hdr(r);
+    hdr->magic       = KELP_RING_MAGIC;
+    hdr->version     = KELP_RING_VERSION;
+    hdr->nslots      = KELP_RING_SLOTS;
+    hdr->slot_size   = KELP_RING_SLOT_SIZE;
+    hdr->desc_offset = RING_DESC_OFFSET;
+    hdr->data_offset = RING_DATA_OFFSET;
+    hdr->map_size    = RING_MAP_SIZE;
+
+    for (i = 0; i < KELP_RING_SLOTS; i++)
+        ring_desc(r, i)->seq = i;
+    return r;
+}
+
+static void ring_free(struct kelp_ring *r)
+{
+    vfree(r->mem);
+    kfree(r);
+}
+
+/* Caller holds ring_lock. */
+static struct kelp_ring *ring_find_locked(struct file *file)
+{
+    struct kelp_ring *r;
+
+    list_for_each_entry(r, &ring_list, node) {
+        if (r->owner == file)
+            return r;
+    }
+    return NULL;
+}
+
+/*
+ * The ring of @file, or NULL if it has never been mapped.  The caller is
+ * in a file operation on @file, so the ring cannot be released under it.
+ */
+static struct kelp_ring *ring_find(struct file *file)
+{
+    struct kelp_ring *r;
+
+    mutex_lock(&ring_lock);
+    r = ring_find_locked(file);
+    mutex_unlock(&ring_lock);
+    return r;
+}
+
+/* The ring of @file, allocated on first use. */
+static struct kelp_ring *ring_get(struct file *file)
+{
+    struct kelp_ring *r;
+
+    mutex_lock(&ring_lock);
+    r = ring_find_locked(file);
+    if (!r) {
+        r = ring_new(file);
+        if (r) {
+            list_add(&r->node, &ring_list);
+            if (kelp_get_log_level() >= 2)
+                pr_info("kelp: shared ring allocated (%u slots x %u bytes)\n",
+                        KELP_RING_SLOTS, KELP_RING_SLOT_SIZE);
+        }
+    }
+    mutex_unlock(&ring_lock);
+    return r;
+}
+
+int kelp_chardev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+    struct kelp_ring *r;
+
+    if (vma->vm_pgoff == KELP_STATS_MMAP_OFFSET >> PAGE_SHIFT)
+        return kelp_stats_mmap(vma);
+    if (vma->vm_pgoff >= KELP_ACCEL_MMAP_OFFSET(1) >> PAGE_SHIFT)
+        return kelp_accel_mmap(vma);
+
+    if (vma->vm_pgoff != 0 || size > RING_MAP_SIZE)
+        return -EINVAL;
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+
+    r = ring_get(file);
+    if (!r)
+        return -ENOMEM;
+
+    kelp_vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    return remap_vmalloc_range(vma, r->mem, 0);
+}
+
+int kelp_ring_wait(struct file *file, unsigned long arg)
+{
+    struct kelp_ring_wait req;
+    wait_queue_head_t *wq;
+    bool (*ready)(struct kelp_ring *r);
+    struct kelp_ring *r;
+    long ret;
+
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    r = ring_find(file);
+    if (!r)
+        return -ENXIO;
+
+    switch (req.event) {
+    case KELP_RING_WAIT_DATA:
+        wq = &r->data_wq;
+        ready = ring_has_data;
+        break;
+    case KELP_RING_WAIT_SPACE:
+        wq = &r->space_wq;
+        ready = ring_has_space;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if (req.timeout_ms < 0)
+        return wait_event_interruptible(*wq, ready(r));
+
+    ret = wait_event_interruptible_timeout(*wq, ready(r),
+                                           msecs_to_jiffies(req.timeout_ms));
+    if (ret < 0)
+        return ret;
+    return ret == 0 ? -ETIMEDOUT : 0;
+}
+
+int kelp_ring_kick(struct file *file, unsigned long arg)
+{
+    struct kelp_ring *r;
+    uint32_t events;
+
+    if (copy_from_user(&events, (void __user *)arg, sizeof(events)))
+        return -EFAULT;
+    r = ring_find(file);
+    if (!r)
+        return -ENXIO;
+
+    if (events & KELP_RING_WAIT_DATA)
+        wake_up_interruptible(&r->data_wq);
+    if (events & KELP_RING_WAIT_SPACE)
+        wake_up_interruptible(&r->space_wq);
+    return 0;
+}
+
+/*
+ * Called when a /dev/kelp file closes.  Every mapping of the ring holds a
+ * reference on the file, and so does every thread waiting in it, so by
+ * now nothing can reach the ring.
+ */
+void kelp_ring_release_file(struct file *file)
+{
+    struct kelp_ring *r;
+
+    mutex_lock(&ring_lock);
+    r = ring_find_locked(file);
+    if (r)
+        list_del(&r->node);
+    mutex_unlock(&ring_lock);
+
+    if (r)
+        ring_free(r);
+}
+
+#if IS_ENABLED(CONFIG_KELP_KUNIT_TEST)
+#include "tests/kelp_ring_test.c"
+#endif
@@ -1,8 +1,23 @@
 /*
  * kelp_semfs.c — Semantic filesystem event hooks
  *
- * Uses fsnotify to watch configurable paths and record filesystem events
- * in a circular buffer. Userspace can batch-read events and manage watches.
+ * Uses fsnotify to watch configurable paths and record filesystem events.
+ * Userspace can batch-read events and manage watches.
+ *
+ * Events are recorded into per-CPU byte rings (semfs_ring_kb each) as
+ * variable-length records, so a producer only ever touches its own CPU's
+ * ring and a short path costs a few dozen bytes instead of a full
+ * struct kelp_fs_event.  A full ring drops the new event and counts it;
+ * nothing already queued is overwritten.  KELP_IOC_SEMFS_EVENTS consumes
+ * the rings, merging them by timestamp, and numbers events in delivery
+ * order.
+ *
+ * Before an event is recorded it must pass the watches: watch paths form
+ * a prefix trie of path components, walked under RCU, and an event is
+ * kept if a watch on it or any parent directory includes its type in its
+ * mask.  Repeated MODIFY events for one inode are coalesced on each CPU:
+ * after one is recorded, further ones within semfs_coalesce_ms are
+ * counted and dropped.
  */
 
 #include <linux/kernel.h>
@@ -17,158 +32,542 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/mm.h>
+#include <linux/rculist.h>
+#include <linux/hash.h>
 
 #include "kelp_internal.h"
 #include "../include/kelp/kelp_ai.h"
 
-/* Circular event buffer */
-static struct kelp_fs_event event_buf[KELP_SEMFS_MAX_EVENTS];
-static int event_head;   /* Next write position */
-static int event_count;  /* Number of valid events in buffer */
-static DEFINE_SPINLOCK(event_lock);
+/* Ring record: header followed by the NUL-terminated path, 8-byte aligned */
+struct semfs_rec {
+    uint64_t timestamp_ns;
+    uint32_t type;              /* KELP_SEMFS_*, or SEMFS_REC_PAD */
+    uint32_t uid;
+    uint32_t size;              /* whole record, aligned */
+    uint32_t path_len;          /* excluding the NUL */
+    char     path[];
+};
+
+#define SEMFS_REC_PAD   0       /* filler up to the end of the ring */
+#define SEMFS_REC_ALIGN 8
+
+/* Last MODIFY seen for an inode, per CPU (direct-mapped) */
+#define SEMFS_RECENT_BITS   6
+
+struct semfs_recent {
+    dev_t           dev;
+    unsigned long   ino;
+    uint64_t        last_ns;
+};
+
+/* Per-CPU event ring; the lock is only contended by the reader. */
+struct semfs_ring {
+    spinlock_t  lock;
+    char       *buf;
+    uint32_t    size;           /* bytes, power of two */
+    uint32_t    records;        /* queued */
+    uint64_t    head;           /* producer byte position */
+    uint64_t    tail;           /* consumer byte position */
+    uint64_t    written;
+    uint64_t    dropped;
+
+    /* Filtering, touched only by this CPU with IRQs off */
+    uint64_t    unwatched;      /* no watch, or masked out */
+    uint64_t    coalesced;
+    struct semfs_recent recent[1 << SEMFS_RECENT_BITS];
+};
+
+static struct semfs_ring __percpu *semfs_rings;
+
+/* Reader state, under read_lock */
+static DEFINE_MUTEX(read_lock);
 static uint64_t event_next_id = 1;
-static atomic64_t total_events = ATOMIC64_INIT(0);
+static uint64_t dropped_reported;
 
-/* Watch tracking */
-struct semfs_watch {
-    char     path[KELP_SEMFS_PATH_MAX];
-    bool     active;
+/*
+ * Watch trie: one node per path component.  A node with a mask is a
+ * watch point; other nodes only lead to one.  Readers walk it under RCU,
+ * changes are made under watch_lock.
+ */
+struct semfs_node {
+    struct hlist_node   sibling;
+    struct hlist_head   children;
+    struct semfs_node  *parent;
+    uint32_t            mask;       /* KELP_SEMFS_MASK() bits, 0 = no watch */
+    char               *watch_path; /* as given, for /proc */
+    struct rcu_head     rcu;
+    uint16_t            len;
+    char                name[];
 };
 
-static struct semfs_watch watches[KELP_SEMFS_MAX_WATCHES];
+static struct semfs_node __rcu *watch_root;    /* "/" */
 static int watch_count;
-static DEFINE_SPINLOCK(watch_lock);
+static DEFINE_MUTEX(watch_lock);
+
+static struct semfs_node *watch_root_locked(void)
+{
+    return rcu_dereference_protected(watch_root, lockdep_is_held(&watch_lock));
+}
+
+/* ---- Per-CPU rings ------------------------------------------------------ */
+
+static struct semfs_rec *ring_rec(struct semfs_ring *r, uint64_t pos)
+{
+    return (struct semfs_rec *)(r->buf + (pos & (r->size - 1)));
+}
+
+/*
+ * Skip the dead space at the end of the buffer, if the tail is in it.
+ * Ring lock held.  Returns false when the ring is empty.
+ */
+static bool ring_settle_tail(struct semfs_ring *r)
+{
+    uint32_t left;
+
+    while (r->tail != r->head) {
+        left = r->size - (uint32_t)(r->tail & (r->size - 1));
+        if (left < sizeof(struct semfs_rec)) {
+            r->tail += left;
+            continue;
+        }
+        if (ring_rec(r, r->tail)->type != SEMFS_REC_PAD)
+            return true;
+        r->tail += ring_rec(r, r->tail)->size;
+    }
+    return false;
+}
+
+/* Reserve @size contiguous bytes at the head.  Ring lock held. */
+static struct semfs_rec *ring_reserve(struct semfs_ring *r, uint32_t size)
+{
+    uint32_t left = r->size - (uint32_t)(r->head & (r->size - 1));
+    uint32_t pad = left < size ? left : 0;
+    struct semfs_rec *rec;
+
+    if (r->head + pad + size - r->tail > r->size)
+        return NULL;
+
+    if (pad) {
+        /* Too little room to hold even a header is skipped implicitly. */
+        if (pad >= sizeof(struct semfs_rec)) {
+            rec = ring_rec(r, r->head);
+            rec->type = SEMFS_REC_PAD;
+            rec->size = pad;
+        }
+        r->head += pad;
+    }
+
+    rec = ring_rec(r, r->head);
+    r->head += size;
+    return rec;
+}
+
+/* Record an event into this CPU's ring @r.  IRQs off. */
+static void ring_record(struct semfs_ring *r, uint32_t type, uint32_t uid,
+                        const char *path)
+{
+    size_t len = strnlen(path, KELP_SEMFS_PATH_MAX - 1);
+    uint32_t size = ALIGN(sizeof(struct semfs_rec) + len + 1, SEMFS_REC_ALIGN);
+    struct semfs_rec *rec;
+
+    spin_lock(&r->lock);
+
+    rec = ring_reserve(r, size);
+    if (rec) {
+        rec->timestamp_ns = ktime_get_ns();
+        rec->type = type;
+        rec->uid = uid;
+        rec->size = size;
+        rec->path_len = (uint32_t)len;
+        memcpy(rec->path, path, len);
+        rec->path[len] = '\0';
+        r->records++;
+        r->written++;
+    } else {
+        r->dropped++;
+    }
+
+    spin_unlock(&r->lock);
+}
+
+/* ---- Watch matching ----------------------------------------------------- */
+
+/* Next component of @p (skipping slashes); sets *@len, NULL at the end. */
+static const char *path_next(const char *p, size_t *len)
+{
+    while (*p == '/')
+        p++;
+    if (!*p)
+        return NULL;
+    *len = strcspn(p, "/");
+    return p;
+}
+
+static struct semfs_node *trie_child(struct semfs_node *node,
+                                     const char *name, size_t len)
+{
+    struct semfs_node *child;
+
+    hlist_for_each_entry_rcu(child, &node->children, sibling) {
+        if (child->len == len && memcmp(child->name, name, len) == 0)
+            return child;
+    }
+    return NULL;
+}
 
 /*
- * Record an event into the circular buffer.
+ * Union of the masks of every watch on @path or one of its parents.
+ * Caller holds rcu_read_lock() or watch_lock.
  */
-static void semfs_record_event(uint32_t type, uint32_t uid, const char *path)
+static uint32_t trie_match(const char *path)
 {
-    struct kelp_fs_event *ev;
+    struct semfs_node *node = rcu_dereference_check(watch_root,
+                                                    lockdep_is_held(&watch_lock));
+    const char *comp = path;
+    uint32_t mask;
+    size_t len;
+
+    if (!node || path[0] != '/')
+        return 0;
+
+    mask = node->mask;
+    while (node && (comp = path_next(comp, &len)) != NULL) {
+        node = trie_child(node, comp, len);
+        if (node)
+            mask |= node->mask;
+        comp += len;
+    }
+    return mask;
+}
+
+/*
+ * True if a MODIFY of @dev/@ino was recorded on this CPU within the
+ * coalescing window; otherwise remember this one.  IRQs off.
+ */
+static bool semfs_coalesce(struct semfs_ring *r, uint32_t type,
+                           dev_t dev, unsigned long ino, uint64_t now)
+{
+    uint64_t window = (uint64_t)kelp_get_semfs_coalesce_ms() * NSEC_PER_MSEC;
+    struct semfs_recent *rc;
+
+    if (!ino)
+        return false;
+
+    rc = &r->recent[hash_long(ino ^ ((unsigned long)dev << 20), SEMFS_RECENT_BITS)];
+    if (type != KELP_SEMFS_MODIFY) {
+        /* Create/delete/rename end the run of writes. */
+        if (rc->ino == ino && rc->dev == dev)
+            rc->ino = 0;
+        return false;
+    }
+
+    if (window && rc->ino == ino && rc->dev == dev &&
+        now - rc->last_ns < window)
+        return true;
+
+    rc->dev = dev;
+    rc->ino = ino;
+    rc->last_ns = now;
+    return false;
+}
+
+/*
+ * Filter and record a filesystem event.  Safe from any context; this is
+ * what the fsnotify hooks call.  @ino may be 0 when unknown, which
+ * disables coalescing for the event.
+ */
+void kelp_semfs_notify(uint32_t type, uint32_t uid, dev_t dev,
+                       unsigned long ino, const char *path)
+{
+    struct semfs_ring *r;
     unsigned long flags;
+    uint32_t mask;
+
+    if (!semfs_rings)
+        return;
 
-    spin_lock_irqsave(&event_lock, flags);
+    rcu_read_lock();
+    mask = trie_match(path);
+    rcu_read_unlock();
 
-    ev = &event_buf[event_head];
-    ev->event_id = event_next_id++;
-    ev->type = type;
-    ev->uid = uid;
-    ev->timestamp_ns = ktime_get_ns();
-    strscpy(ev->path, path, KELP_SEMFS_PATH_MAX);
+    local_irq_save(flags);
+    r = this_cpu_ptr(semfs_rings);
 
-    event_head = (event_head + 1) % KELP_SEMFS_MAX_EVENTS;
-    if (event_count < KELP_SEMFS_MAX_EVENTS)
-        event_count++;
+    if (!(mask & KELP_SEMFS_MASK(type)))
+        r->unwatched++;
+    else if (semfs_coalesce(r, type, dev, ino, ktime_get_ns()))
+        r->coalesced++;
+    else
+        ring_record(r, type, uid, path);
 
-    spin_unlock_irqrestore(&event_lock, flags);
+    local_irq_restore(flags);
+}
 
-    atomic64_inc(&total_events);
+/* Timestamp of the oldest queued event of @r, or U64_MAX if none. */
+static uint64_t ring_peek_ts(struct semfs_ring *r)
+{
+    unsigned long flags;
+    uint64_t ts = U64_MAX;
+
+    spin_lock_irqsave(&r->lock, flags);
+    if (ring_settle_tail(r))
+        ts = ring_rec(r, r->tail)->timestamp_ns;
+    spin_unlock_irqrestore(&r->lock, flags);
+    return ts;
+}
+
+/* Move the oldest event of @r into @ev.  Returns false if none. */
+static bool ring_pop(struct semfs_ring *r, struct kelp_fs_event *ev)
+{
+    struct semfs_rec *rec;
+    unsigned long flags;
+    bool ok = false;
+
+    spin_lock_irqsave(&r->lock, flags);
+    if (ring_settle_tail(r)) {
+        rec = ring_rec(r, r->tail);
+        ev->type = rec->type;
+        ev->uid = rec->uid;
+        ev->timestamp_ns = rec->timestamp_ns;
+        memcpy(ev->path, rec->path, rec->path_len + 1);
+        r->tail += rec->size;
+        r->records--;
+        ok = true;
+    }
+    spin_unlock_irqrestore(&r->lock, flags);
+    return ok;
+}
+
+static uint64_t semfs_total_dropped(void)
+{
+    uint64_t sum = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu_ptr(semfs_rings, cpu)->dropped);
+    return sum;
 }
 
 /*
  * Batch-read events (ioctl handler).
- * Reads up to batch->count events from the buffer.
+ * Consumes up to batch->count events, oldest first across all CPUs, and
+ * reports in batch->dropped how many were lost since the previous read.
  */
 int kelp_semfs_get_events(unsigned long arg)
 {
-    struct kelp_semfs_batch batch;
-    unsigned long flags;
-    int i, start, to_read;
-
-    if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+    struct kelp_semfs_batch *batch;
+    uint64_t *next_ts;
+    uint64_t dropped;
+    uint32_t want, n = 0;
+    int cpu, best;
+    int ret = 0;
+
+    if (!semfs_rings)
+        return -ENODEV;
+    if (get_user(want, (uint32_t __user *)arg))
         return -EFAULT;
+    want = min_t(uint32_t, want, KELP_SEMFS_BATCH_MAX);
 
-    if (batch.count > KELP_SEMFS_BATCH_MAX)
-        batch.count = KELP_SEMFS_BATCH_MAX;
+    batch = kvzalloc(sizeof(*batch), GFP_KERNEL);
+    next_ts = kmalloc_array(nr_cpu_ids, sizeof(*next_ts), GFP_KERNEL);
+    if (!batch || !next_ts) {
+        ret = -ENOMEM;
+        goto out;
+    }
 
-    spin_lock_irqsave(&event_lock, flags);
+    mutex_lock(&read_lock);
 
-    to_read = min((int)batch.count, event_count);
+    for_each_possible_cpu(cpu)
+        next_ts[cpu] = ring_peek_ts(per_cpu_ptr(semfs_rings, cpu));
 
-    /* Read from oldest to newest */
-    if (event_count >= KELP_SEMFS_MAX_EVENTS) {
-        start = event_head;  /* Buffer is full, head points to oldest */
-    } else {
-        start = 0;
+    /* Merge: only the ring just consumed from needs a fresh peek. */
+    while (n < want) {
+        best = -1;
+        for_each_possible_cpu(cpu) {
+            if (next_ts[cpu] != U64_MAX &&
+                (best < 0 || next_ts[cpu] < next_ts[best]))
+                best = cpu;
+        }
+        if (best < 0 ||
+            !ring_pop(per_cpu_ptr(semfs_rings, best), &batch->events[n]))
+            break;
+        batch->events[n].event_id = event_next_id++;
+        next_ts[best] = ring_peek_ts(per_cpu_ptr(semfs_rings, best));
+        n++;
     }
 
-    for (i = 0; i < to_read; i++) {
-        int idx = (start + event_count - to_read + i) % KELP_SEMFS_MAX_EVENTS;
-        batch.events[i] = event_buf[idx];
+    dropped = semfs_total_dropped();
+    batch->dropped = (uint32_t)min_t(uint64_t, dropped - dropped_reported, U32_MAX);
+    dropped_reported = dropped;
+
+    mutex_unlock(&read_lock);
+
+    batch->count = n;
+    if (copy_to_user((void __user *)arg, batch,
+                     offsetof(struct kelp_semfs_batch, events) +
+                     n * sizeof(batch->events[0])))
+        ret = -EFAULT;
+out:
+    kfree(next_ts);
+    kvfree(batch);
+    return ret;
+}
+
+/* Find (or with @create, build) the trie node for @path.  watch_lock held. */
+static struct semfs_node *trie_lookup(const char *path, bool create)
+{
+    struct semfs_node *node = watch_root_locked(), *child;
+    const char *comp = path;
+    size_t len;
+
+    while ((comp = path_next(comp, &len)) != NULL) {
+        child = trie_child(node, comp, len);
+        if (!child) {
+            if (!create)
+                return NULL;
+            child = kzalloc(struct_size(child, name, len), GFP_KERNEL);
+            if (!child)
+                return NULL;
+            INIT_HLIST_HEAD(&child->children);
+            child->parent = node;
+            child->len = (uint16_t)len;
+            memcpy(child->name, comp, len);
+            hlist_add_head_rcu(&child->sibling, &node->children);
+        }
+        node = child;
+        comp += len;
     }
+    return node;
+}
 
-    batch.count = (uint32_t)to_read;
-    spin_unlock_irqrestore(&event_lock, flags);
+/* Free @node and any parents left without watches or children. */
+static void trie_prune(struct semfs_node *node)
+{
+    struct semfs_node *parent;
 
-    if (copy_to_user((void __user *)arg, &batch, sizeof(batch)))
-        return -EFAULT;
+    while (node != watch_root_locked() && !node->mask && hlist_empty(&node->children)) {
+        parent = node->parent;
+        hlist_del_rcu(&node->sibling);
+        kfree_rcu(node, rcu);
+        node = parent;
+    }
+}
 
-    return 0;
+/* Watch paths are absolute, without "." or ".." components. */
+static bool watch_path_valid(const char *path)
+{
+    const char *comp = path;
+    size_t len;
+
+    if (path[0] != '/')
+        return false;
+    while ((comp = path_next(comp, &len)) != NULL) {
+        if ((len == 1 && comp[0] == '.') ||
+            (len == 2 && comp[0] == '.' && comp[1] == '.'))
+            return false;
+        comp += len;
+    }
+    return true;
+}
+
+/* Add a watch on @path, or replace the mask of an existing one. */
+static int semfs_watch_add(const char *path, uint32_t mask)
+{
+    struct semfs_node *node;
+    int ret = 0;
+
+    mutex_lock(&watch_lock);
+    if (!watch_root_locked()) {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    node = trie_lookup(path, false);
+    if (node && node->mask) {
+        WRITE_ONCE(node->mask, mask);
+        goto out;
+    }
+    if (watch_count >= KELP_SEMFS_MAX_WATCHES) {
+        ret = -ENOSPC;  /* No free watch slots */
+        goto out;
+    }
+    node = trie_lookup(path, true);
+    if (node)
+        node->watch_path = kstrdup(path, GFP_KERNEL);
+    if (!node || !node->watch_path) {
+        if (node)
+            trie_prune(node);
+        ret = -ENOMEM;
+        goto out;
+    }
+    WRITE_ONCE(node->mask, mask);
+    watch_count++;
+
+    if (kelp_get_log_level() >= 1)
+        pr_info("kelp: semfs watch added: %s (mask=%#x)\n", path, mask);
+out:
+    mutex_unlock(&watch_lock);
+    return ret;
+}
+
+/* Remove the watch on @path and prune the branch it leaves unused. */
+static int semfs_watch_remove(const char *path)
+{
+    struct semfs_node *node;
+    int ret = 0;
+
+    mutex_lock(&watch_lock);
+    if (!watch_root_locked()) {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    node = trie_lookup(path, false);
+    if (!node || !node->mask) {
+        ret = -ENOENT;  /* Watch not found */
+        goto out;
+    }
+    WRITE_ONCE(node->mask, 0);
+    kfree(node->watch_path);
+    node->watch_path = NULL;
+    watch_count--;
+    trie_prune(node);
+
+    if (kelp_get_log_level() >= 1)
+        pr_info("kelp: semfs watch removed: %s\n", path);
+out:
+    mutex_unlock(&watch_lock);
+    return ret;
 }
 
 /*
- * Add or remove a watch path (ioctl handler).
+ * Add or remove a watch path (ioctl handler).  Adding an existing watch
+ * replaces its mask.
  */
 int kelp_semfs_watch(unsigned long arg)
 {
     struct kelp_semfs_watch req;
-    unsigned long flags;
-    int i;
+    uint32_t mask;
 
     if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
         return -EFAULT;
 
     req.path[KELP_SEMFS_PATH_MAX - 1] = '\0';
+    if (!watch_path_valid(req.path))
+        return -EINVAL;
+    mask = req.mask ? req.mask & KELP_SEMFS_MASK_ALL : KELP_SEMFS_MASK_ALL;
+    if (!mask)
+        return -EINVAL;
 
-    spin_lock_irqsave(&watch_lock, flags);
-
-    if (req.action == KELP_SEMFS_WATCH_ADD) {
-        /* Check for duplicate */
-        for (i = 0; i < KELP_SEMFS_MAX_WATCHES; i++) {
-            if (watches[i].active &&
-                strncmp(watches[i].path, req.path, KELP_SEMFS_PATH_MAX) == 0) {
-                spin_unlock_irqrestore(&watch_lock, flags);
-                return 0;  /* Already watched */
-            }
-        }
-
-        /* Find free slot */
-        for (i = 0; i < KELP_SEMFS_MAX_WATCHES; i++) {
-            if (!watches[i].active) {
-                strscpy(watches[i].path, req.path, KELP_SEMFS_PATH_MAX);
-                watches[i].active = true;
-                watch_count++;
-                spin_unlock_irqrestore(&watch_lock, flags);
-
-                if (kelp_get_log_level() >= 1)
-                    pr_info("kelp: semfs watch added: %s\n", req.path);
-                return 0;
-            }
-        }
-
-        spin_unlock_irqrestore(&watch_lock, flags);
-        return -ENOSPC;  /* No free watch slots */
-
-    } else if (req.action == KELP_SEMFS_WATCH_REMOVE) {
-        for (i = 0; i < KELP_SEMFS_MAX_WATCHES; i++) {
-            if (watches[i].active &&
-                strncmp(watches[i].path, req.path, KELP_SEMFS_PATH_MAX) == 0) {
-                watches[i].active = false;
-                memset(watches[i].path, 0, KELP_SEMFS_PATH_MAX);
-                watch_count--;
-                spin_unlock_irqrestore(&watch_lock, flags);
-
-                if (kelp_get_log_level() >= 1)
-                    pr_info("kelp: semfs watch removed: %s\n", req.path);
-                return 0;
-            }
-        }
-
-        spin_unlock_irqrestore(&watch_lock, flags);
-        return -ENOENT;  /* Watch not found */
-
-    } else {
-        spin_unlock_irqrestore(&watch_lock, flags);
+    switch (req.action) {
+    case KELP_SEMFS_WATCH_ADD:
+        return semfs_watch_add(req.path, mask);
+    case KELP_SEMFS_WATCH_REMOVE:
+        return semfs_watch_remove(req.path);
+    default:
         return -EINVAL;
     }
 }
@@ -176,7 +575,14 @@ int kelp_semfs_watch(unsigned long arg)
 /* Stats accessors */
 uint64_t kelp_semfs_get_total_events(void)
 {
-    return (uint64_t)atomic64_read(&total_events);
+    uint64_t sum = 0;
+    int cpu;
+
+    if (!semfs_rings)
+        return 0;
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu_ptr(semfs_rings, cpu)->written);
+    return sum;
 }
 
 uint32_t kelp_semfs_get_active_watches(void)
@@ -186,30 +592,61 @@ uint32_t kelp_semfs_get_active_watches(void)
 
 uint32_t kelp_semfs_get_buffer_used(void)
 {
-    return (uint32_t)event_count;
+    uint32_t sum = 0;
+    int cpu;
+
+    if (!semfs_rings)
+        return 0;
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu_ptr(semfs_rings, cpu)->records);
+    return sum;
 }
 
 /* /proc/kelp/semfs */
+static void semfs_show_watches(struct seq_file *m, struct semfs_node *node)
+{
+    struct semfs_node *child;
+
+    if (node->mask)
+        seq_printf(m, "  %-40s mask=%#x\n", node->watch_path, node->mask);
+    hlist_for_each_entry(child, &node->children, sibling)
+        semfs_show_watches(m, child);
+}
+
 static int semfs_proc_show(struct seq_file *m, void *v)
 {
     unsigned long flags;
-    int i;
+    int cpu;
 
     seq_printf(m, "Kelp Semantic FS Events\n");
     seq_printf(m, "=======================\n");
     seq_printf(m, "Total events:      %llu\n", kelp_semfs_get_total_events());
-    seq_printf(m, "Buffer used:       %u / %u\n",
-               kelp_semfs_get_buffer_used(), KELP_SEMFS_MAX_EVENTS);
+    seq_printf(m, "Events queued:     %u\n", kelp_semfs_get_buffer_used());
     seq_printf(m, "Active watches:    %u / %u\n",
                kelp_semfs_get_active_watches(), KELP_SEMFS_MAX_WATCHES);
 
-    seq_printf(m, "\nWatched paths:\n");
-    spin_lock_irqsave(&watch_lock, flags);
-    for (i = 0; i < KELP_SEMFS_MAX_WATCHES; i++) {
-        if (watches[i].active)
-            seq_printf(m, "  %s\n", watches[i].path);
+    if (semfs_rings) {
+        seq_printf(m, "Coalesce window:   %u ms\n", kelp_get_semfs_coalesce_ms());
+        seq_printf(m, "\n%-5s %10s %10s %12s %10s %12s %12s\n",
+                   "cpu", "queued", "used_kb", "written", "dropped",
+                   "unwatched", "coalesced");
+        for_each_possible_cpu(cpu) {
+            struct semfs_ring *r = per_cpu_ptr(semfs_rings, cpu);
+
+            spin_lock_irqsave(&r->lock, flags);
+            seq_printf(m, "%-5d %10u %4llu/%-5u %12llu %10llu %12llu %12llu\n",
+                       cpu, r->records, (r->head - r->tail) >> 10,
+                       r->size >> 10, r->written, r->dropped,
+                       READ_ONCE(r->unwatched), READ_ONCE(r->coalesced));
+            spin_unlock_irqrestore(&r->lock, flags);
+        }
     }
-    spin_unlock_irqrestore(&watch_lock, flags);
+
+    seq_printf(m, "\nWatched paths:\n");
+    mutex_lock(&watch_lock);
+    if (watch_root_locked())
+        semfs_show_watches(m, watch_root_locked());
+    mutex_unlock(&watch_lock);
 
     return 0;
 }
@@ -228,26 +665,98 @@ static const struct proc_ops semfs_proc_ops = {
 
 static struct proc_dir_entry *semfs_proc_entry;
 
+static void semfs_free_rings(void)
+{
+    int cpu;
+
+    if (!semfs_rings)
+        return;
+    for_each_possible_cpu(cpu)
+        kvfree(per_cpu_ptr(semfs_rings, cpu)->buf);
+    free_percpu(semfs_rings);
+    semfs_rings = NULL;
+}
+
+static int semfs_alloc_rings(uint32_t size)
+{
+    int cpu;
+
+    semfs_rings = alloc_percpu(struct semfs_ring);
+    if (!semfs_rings)
+        return -ENOMEM;
+
+    for_each_possible_cpu(cpu) {
+        struct semfs_ring *r = per_cpu_ptr(semfs_rings, cpu);
+
+        spin_lock_init(&r->lock);
+        r->size = size;
+        r->buf = kvmalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
+        if (!r->buf) {
+            semfs_free_rings();
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+/* Free the whole trie.  Only at unload, when no reader can be inside. */
+static void trie_free(struct semfs_node *node)
+{
+    struct semfs_node *child;
+    struct hlist_node *tmp;
+
+    hlist_for_each_entry_safe(child, tmp, &node->children, sibling)
+        trie_free(child);
+    kfree(node->watch_path);
+    kfree(node);
+}
+
 int kelp_semfs_init(struct proc_dir_entry *proc_dir)
 {
-    memset(event_buf, 0, sizeof(event_buf));
-    memset(watches, 0, sizeof(watches));
-    event_head = 0;
-    event_count = 0;
+    uint32_t size = kelp_get_semfs_ring_kb() * 1024;
+    struct semfs_node *root;
+    int ret;
+
     watch_count = 0;
 
+    root = kzalloc(sizeof(*root), GFP_KERNEL);
+    if (!root)
+        return -ENOMEM;
+    INIT_HLIST_HEAD(&root->children);
+    rcu_assign_pointer(watch_root, root);
+
+    ret = semfs_alloc_rings(size);
+    if (ret) {
+        pr_err("kelp: failed to allocate semfs rings\n");
+        return ret;
+    }
+
     semfs_proc_entry = proc_create("semfs", 0444, proc_dir, &semfs_proc_ops);
     if (!semfs_proc_entry) {
         pr_err("kelp: failed to create /proc/kelp/semfs\n");
+        semfs_free_rings();
         return -ENOMEM;
     }
 
-    pr_info("kelp: semantic FS event system initialized\n");
+    pr_info("kelp: semantic FS event system initialized (%u KiB/cpu)\n",
+            size >> 10);
     return 0;
 }
 
 void kelp_semfs_exit(void)
 {
+    struct semfs_node *root = rcu_dereference_protected(watch_root, 1);
+
     proc_remove(semfs_proc_entry);
+    semfs_free_rings();
+
+    RCU_INIT_POINTER(watch_root, NULL);
+    synchronize_rcu();
+    if (root)
+        trie_free(root);
     pr_info("kelp: semantic FS event system cleaned up\n");
 }
+
+#if IS_ENABLED(CONFIG_KELP_KUNIT_TEST)
+#include "tests/kelp_semfs_test.c"
+#endif
@@ -0,0 +1,180 @@
+/*
+ * kelp_stats.c — mmap'able stats page for /dev/kelp
+ *
+ * Dashboards used to parse /proc/kelp/* text or issue two ioctls per
+ * refresh.  The stats page (layout in kelp_ai.h) holds the same counters
+ * as KELP_IOC_GET_STATS and KELP_IOC_AI_STATUS in one struct that user
+ * space maps read-only and samples without a system call.
+ *
+ * The page is allocated on the first mmap.  A delayed work item rewrites
+ * it every stats_interval_ms, and only while at least one mapping exists,
+ * so an unwatched module does no periodic work.  The work item is the
+ * only writer (workqueues never run one item concurrently with itself),
+ * which is all the user-visible sequence count needs.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/timekeeping.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "kelp_internal.h"
+#include "../include/kelp/kelp_ai.h"
+
+static struct kelp_stats_page *stats_page;
+static DEFINE_MUTEX(stats_alloc_lock);
+static atomic_t stats_maps = ATOMIC_INIT(0);
+
+static void stats_refresh(struct work_struct *work);
+static DECLARE_DELAYED_WORK(stats_work, stats_refresh);
+
+/* Counters reported by KELP_IOC_GET_STATS */
+void kelp_stats_fill(struct kelp_kstats *ks)
+{
+    s64 uptime_ns = ktime_to_ns(ktime_sub(ktime_get_boottime(),
+                                          kelp_get_start_time()));
+
+    *ks = *kelp_get_stats();
+    ks->uptime_seconds = (uint64_t)(uptime_ns / NSEC_PER_SEC);
+    ks->active_sessions = (uint64_t)atomic_read(kelp_get_open_count());
+    ks->netfilter_packets = kelp_nf_get_packets();
+}
+
+/* Counters reported by KELP_IOC_AI_STATUS */
+void kelp_stats_fill_ai(struct kelp_ai_status *ai)
+{
+    memset(ai, 0, sizeof(*ai));
+
+    /* Base status */
+    ai->netfilter_enabled = kelp_get_netfilter_enabled();
+    ai->log_level = kelp_get_log_level();
+    ai->chardev_open_count = atomic_read(kelp_get_open_count());
+    ai->start_time = (uint64_t)ktime_to_ns(kelp_get_start_time());
+
+    /* Scheduler stats */
+    ai->sched_queue_depth = kelp_ai_sched_get_depth();
+    ai->sched_total_submitted = kelp_ai_sched_get_total_submitted();
+    ai->sched_total_completed = kelp_ai_sched_get_total_completed();
+
+    /* Semantic FS stats */
+    ai->semfs_total_events = kelp_semfs_get_total_events();
+    ai->semfs_active_watches = kelp_semfs_get_active_watches();
+    ai->semfs_buffer_used = kelp_semfs_get_buffer_used();
+
+    /* Accelerator stats */
+    ai->accel_count = kelp_accel_get_count();
+}
+
+/* Single writer: the work item, or stats_alloc() before any mapping */
+static void stats_publish(void)
+{
+    struct kelp_stats_page *p = stats_page;
+    struct kelp_kstats ks;
+    struct kelp_ai_status ai;
+    uint32_t seq;
+
+    /* Gather first, so the odd window only spans the copy */
+    kelp_stats_fill(&ks);
+    kelp_stats_fill_ai(&ai);
+
+    seq = p->seq;
+    WRITE_ONCE(p->seq, seq + 1);
+    smp_wmb();
+
+    p->update_ns = ktime_get_boottime_ns();
+    p->interval_ms = kelp_get_stats_interval_ms();
+    p->kstats = ks;
+    p->ai = ai;
+
+    smp_wmb();
+    WRITE_ONCE(p->seq, seq + 2);
+}
+
+static void stats_refresh(struct work_struct *work)
+{
+    if (!atomic_read(&stats_maps))
+        return;
+
+    stats_publish();
+    schedule_delayed_work(&stats_work,
+                          msecs_to_jiffies(kelp_get_stats_interval_ms()));
+}
+
+static int stats_alloc(void)
+{
+    int ret = 0;
+
+    BUILD_BUG_ON(sizeof(struct kelp_stats_page) > PAGE_SIZE);
+
+    mutex_lock(&stats_alloc_lock);
+    if (stats_page)
+        goto out;
+
+    stats_page = vmalloc_user(PAGE_SIZE);
+    if (!stats_page) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    stats_page->magic   = KELP_STATS_MAGIC;
+    stats_page->version = KELP_STATS_VERSION;
+    stats_page->size    = sizeof(struct kelp_stats_page);
+    stats_publish();
+out:
+    mutex_unlock(&stats_alloc_lock);
+    return ret;
+}
+
+static void stats_vm_open(struct vm_area_struct *vma)
+{
+    /* First mapping restarts the refresh */
+    if (atomic_inc_return(&stats_maps) == 1)
+        mod_delayed_work(system_wq, &stats_work, 0);
+}
+
+static void stats_vm_close(struct vm_area_struct *vma)
+{
+    atomic_dec(&stats_maps);
+}
+
+static const struct vm_operations_struct stats_vm_ops = {
+    .open  = stats_vm_open,
+    .close = stats_vm_close,
+};
+
+/* Called by kelp_chardev_mmap() for KELP_STATS_MMAP_OFFSET */
+int kelp_stats_mmap(struct vm_area_struct *vma)
+{
+    int ret;
+
+    if (vma->vm_end - vma->vm_start != PAGE_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    ret = stats_alloc();
+    if (ret)
+        return ret;
+
+    ret = remap_vmalloc_range(vma, stats_page, 0);
+    if (ret)
+        return ret;
+
+    kelp_vm_flags_mod(vma, VM_DONTEXPAND | VM_DONTDUMP, VM_MAYWRITE);
+    vma->vm_ops = &stats_vm_ops;
+    stats_vm_open(vma);
+    return 0;
+}
+
+/*
+ * Called at module unload, before the subsystems whose counters the work
+ * item reads.  No mapping is left by then (each holds the module).
+ */
+void kelp_stats_exit(void)
+{
+    cancel_delayed_work_sync(&stats_work);
+    vfree(stats_page);
+    stats_page = NULL;
+}
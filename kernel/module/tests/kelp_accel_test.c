@@ -0,0 +1,163 @@
+/*
+ * kelp_accel_test.c — KUnit tests for the host tensor buffers
+ *
+ * Included at the end of kelp_accel.c (CONFIG_KELP_KUNIT_TEST).  The
+ * cases allocate and publish buffers the way KELP_IOC_ACCEL_RESERVE does,
+ * owned by a cookie instead of a file, so they need no device, no GPU and
+ * no user mapping.  They skip when the accel_mem_mb budget is too small.
+ */
+
+#include <kunit/test.h>
+#include <linux/highmem.h>
+
+#define ACCEL_TEST_BYTES    (ACCEL_HUGE_SIZE + 3 * PAGE_SIZE)
+
+static int accel_test_init(struct kunit *test)
+{
+    if (accel_free_bytes() < 2 * ACCEL_TEST_BYTES)
+        kunit_skip(test, "accel_mem_mb budget too small");
+    return 0;
+}
+
+/* Publish @buf under a handle owned by the test. */
+static uint32_t accel_test_publish(struct kunit *test, struct accel_buf *buf)
+{
+    uint32_t handle;
+
+    buf->owner = (struct file *)test;
+    KUNIT_ASSERT_EQ(test, xa_alloc(&accel_xa, &handle, buf,
+                                   XA_LIMIT(1, INT_MAX), GFP_KERNEL), 0);
+    return handle;
+}
+
+/* Chunks cover the buffer exactly, come zeroed and are charged for. */
+static void accel_test_alloc(struct kunit *test)
+{
+    uint64_t before = accel_free_bytes(), total = 0;
+    struct accel_buf *buf;
+    struct page *page;
+    uint32_t n = 0;
+
+    buf = accel_buf_alloc(ACCEL_TEST_BYTES, false);
+    KUNIT_ASSERT_FALSE(test, IS_ERR(buf));
+    KUNIT_EXPECT_EQ(test, accel_free_bytes(), before - ACCEL_TEST_BYTES);
+
+    list_for_each_entry(page, &buf->chunks, lru) {
+        uint8_t *p = kmap_local_page(page);
+
+        KUNIT_EXPECT_EQ(test, p[0], 0);
+        KUNIT_EXPECT_EQ(test, p[PAGE_SIZE - 1], 0);
+        kunmap_local(p);
+        total += PAGE_SIZE << compound_order(page);
+        n++;
+    }
+    KUNIT_EXPECT_EQ(test, total, (uint64_t)ACCEL_TEST_BYTES);
+    KUNIT_EXPECT_EQ(test, n, buf->nchunks);
+    KUNIT_EXPECT_LE(test, buf->huge_chunks, 1u);
+
+    accel_buf_put(buf);
+    KUNIT_EXPECT_EQ(test, accel_free_bytes(), before);
+}
+
+/* The budget is a hard limit, and a refused buffer leaves no charge. */
+static void accel_test_budget(struct kunit *test)
+{
+    uint64_t before = accel_free_bytes();
+    struct accel_buf *buf;
+
+    buf = accel_buf_alloc(PAGE_ALIGN(before + 1), false);
+    KUNIT_EXPECT_EQ(test, PTR_ERR_OR_ZERO(buf), -ENOMEM);
+    KUNIT_EXPECT_EQ(test, accel_free_bytes(), before);
+}
+
+static void accel_test_huge_only(struct kunit *test)
+{
+    struct accel_buf *buf = accel_buf_alloc(ACCEL_HUGE_SIZE, true);
+
+    if (IS_ERR(buf))
+        kunit_skip(test, "no free %lu KiB block", ACCEL_HUGE_SIZE >> 10);
+    KUNIT_EXPECT_EQ(test, buf->nchunks, 1u);
+    KUNIT_EXPECT_EQ(test, buf->huge_chunks, 1u);
+    KUNIT_EXPECT_EQ(test, (unsigned int)compound_order(
+                        list_first_entry(&buf->chunks, struct page, lru)),
+                    ACCEL_HUGE_ORDER);
+    accel_buf_put(buf);
+}
+
+/*
+ * A handle is found by anyone, withdrawn only by its owner, and the pages
+ * outlive it while a reference (a mapping) is held.
+ */
+static void accel_test_handles(struct kunit *test)
+{
+    uint64_t before = accel_free_bytes();
+    struct accel_buf *buf, *found;
+    uint32_t handle;
+
+    buf = accel_buf_alloc(ACCEL_TEST_BYTES, false);
+    KUNIT_ASSERT_FALSE(test, IS_ERR(buf));
+    handle = accel_test_publish(test, buf);
+
+    found = accel_buf_get(handle);
+    KUNIT_ASSERT_PTR_EQ(test, found, buf);
+    KUNIT_EXPECT_TRUE(test, accel_buf_may_map(found));
+    KUNIT_EXPECT_NULL(test, accel_buf_get(handle + 1));
+    KUNIT_EXPECT_NULL(test, accel_buf_get(0));
+
+    KUNIT_EXPECT_EQ(test, accel_buf_unpublish(handle, (struct file *)&before),
+                    -EPERM);
+    kelp_accel_release_file((struct file *)test);
+    KUNIT_EXPECT_NULL(test, accel_buf_get(handle));
+    KUNIT_EXPECT_EQ(test, accel_buf_unpublish(handle, NULL), -ENOENT);
+
+    /* Still charged until the last reference goes */
+    KUNIT_EXPECT_EQ(test, accel_free_bytes(), before - ACCEL_TEST_BYTES);
+    accel_buf_put(found);
+    KUNIT_EXPECT_EQ(test, accel_free_bytes(), before);
+}
+
+/* Reserve + release cost per buffer size, with zeroing. */
+static void accel_bench_alloc(struct kunit *test)
+{
+    static const uint64_t sizes[] = { SZ_64K, SZ_2M, SZ_16M };
+    const uint32_t rounds = 64;
+    struct accel_buf *buf;
+    uint64_t t, ns;
+    uint32_t i, r;
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        uint32_t huge = 0;
+
+        if (sizes[i] > accel_free_bytes())
+            continue;
+        ns = 0;
+        for (r = 0; r < rounds; r++) {
+            t = ktime_get_ns();
+            buf = accel_buf_alloc(sizes[i], false);
+            KUNIT_ASSERT_FALSE(test, IS_ERR(buf));
+            huge = buf->huge_chunks;
+            accel_buf_put(buf);
+            ns += ktime_get_ns() - t;
+            cond_resched();
+        }
+        kunit_info(test, "%llu KiB: alloc+free %llu ns  (%u huge chunks)\n",
+                   sizes[i] >> 10, div_u64(ns, rounds), huge);
+    }
+}
+
+static struct kunit_case accel_test_cases[] = {
+    KUNIT_CASE(accel_test_alloc),
+    KUNIT_CASE(accel_test_budget),
+    KUNIT_CASE(accel_test_huge_only),
+    KUNIT_CASE(accel_test_handles),
+    KUNIT_CASE_SLOW(accel_bench_alloc),
+    {}
+};
+
+static struct kunit_suite accel_test_suite = {
+    .name       = "kelp_accel",
+    .init       = accel_test_init,
+    .test_cases = accel_test_cases,
+};
+
+kunit_test_suite(accel_test_suite);
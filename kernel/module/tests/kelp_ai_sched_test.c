@@ -0,0 +1,375 @@
+/*
+ * kelp_ai_sched_test.c — KUnit tests for the inference scheduler
+ *
+ * Included at the end of kelp_ai_sched.c (CONFIG_KELP_KUNIT_TEST), so
+ * the cases drive the static queue directly: they submit and poll
+ * through sched_enqueue()/sched_dequeue() under sched_lock, exactly as
+ * the ioctl handlers do, minus the copies.  The queue itself is shared,
+ * so each case needs it empty and puts the policy back afterwards.
+ *
+ * Tasks are charged to classes local to the test, never linked into
+ * sched_classes, so /proc/kelp/scheduler is left untouched.
+ */
+
+#include <kunit/test.h>
+#include <linux/random.h>
+
+#define SCHED_TEST_TASKS    64
+#define SCHED_BENCH_TASKS   4096
+
+struct sched_test_ctx {
+    struct kelp_sched_config cfg;
+    uint64_t                 vtime;
+};
+
+static void sched_test_set_policy(uint32_t policy, uint32_t aging_ms)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_cfg.policy = policy;
+    sched_cfg.aging_ms = aging_ms;
+    sched_cfg.batch_window_us = 0;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+static struct sched_class *sched_test_class(struct kunit *test, uint32_t weight)
+{
+    struct sched_class *cls = kunit_kzalloc(test, sizeof(*cls), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, cls);
+    INIT_LIST_HEAD(&cls->node);
+    cls->uid = SCHED_OTHER_UID;
+    cls->weight = weight;
+    cls->last_finish = sched_vtime;
+    return cls;
+}
+
+static struct sched_node *sched_test_node(struct kunit *test,
+                                          struct sched_class *cls,
+                                          int32_t priority, uint32_t tokens,
+                                          uint32_t deadline_ms)
+{
+    struct sched_node *n = kmem_cache_zalloc(sched_cache, GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, n);
+    n->cls = cls;
+    n->task.priority = priority;
+    n->task.est_tokens = tokens;
+    n->task.deadline_ms = deadline_ms;
+    return n;
+}
+
+/* Submit @n as if at @now (the ioctl passes ktime_get_ns()) */
+static void sched_test_submit(struct sched_node *n, uint64_t now)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_enqueue(n, now);
+    atomic_inc(&sched_depth);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+static struct sched_node *sched_test_poll(void)
+{
+    struct sched_node *n;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    n = sched_dequeue();
+    if (n)
+        atomic_dec(&sched_depth);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return n;
+}
+
+static int sched_test_init(struct kunit *test)
+{
+    struct sched_test_ctx *ctx;
+    unsigned long flags;
+    bool busy;
+
+    if (!sched_cache)
+        kunit_skip(test, "scheduler not initialised");
+
+    spin_lock_irqsave(&sched_lock, flags);
+    busy = !RB_EMPTY_ROOT(&sched_tree);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (busy)
+        kunit_skip(test, "inference queue in use");
+
+    ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    if (!ctx)
+        return -ENOMEM;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    ctx->cfg = sched_cfg;
+    ctx->vtime = sched_vtime;
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    test->priv = ctx;
+    return 0;
+}
+
+static void sched_test_exit(struct kunit *test)
+{
+    struct sched_test_ctx *ctx = test->priv;
+    struct sched_node *n;
+    unsigned long flags;
+
+    if (!ctx)
+        return;
+
+    /* Drop whatever a failed case left queued; the queue was empty before. */
+    while ((n = sched_test_poll()) != NULL)
+        kmem_cache_free(sched_cache, n);
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_cfg = ctx->cfg;
+    sched_vtime = ctx->vtime;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* Strict priority: highest first, FIFO within a level. */
+static void sched_test_priority_order(struct kunit *test)
+{
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    int32_t last_prio = INT_MAX;
+    uint64_t last_id = 0;
+    int i;
+
+    sched_test_set_policy(KELP_SCHED_PRIORITY, 0);
+    for (i = 0; i < SCHED_TEST_TASKS; i++)
+        sched_test_submit(sched_test_node(test, cls, (i * 7) % 8, 1, 0), i);
+
+    for (i = 0; i < SCHED_TEST_TASKS; i++) {
+        struct sched_node *n = sched_test_poll();
+
+        KUNIT_ASSERT_NOT_NULL(test, n);
+        KUNIT_EXPECT_LE(test, n->task.priority, last_prio);
+        if (n->task.priority == last_prio)
+            KUNIT_EXPECT_GT(test, n->task.task_id, last_id);
+        last_prio = n->task.priority;
+        last_id = n->task.task_id;
+        kmem_cache_free(sched_cache, n);
+    }
+    KUNIT_EXPECT_NULL(test, sched_test_poll());
+    KUNIT_EXPECT_EQ(test, cls->queued, 0u);
+    KUNIT_EXPECT_EQ(test, cls->dispatched, (uint64_t)SCHED_TEST_TASKS);
+}
+
+/* Aging: each priority level is worth aging_ms of waiting. */
+static void sched_test_aging(struct kunit *test)
+{
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    const uint64_t step = 500 * NSEC_PER_MSEC;
+    const uint64_t t0 = 10 * NSEC_PER_SEC;
+    struct sched_node *old, *urgent, *n;
+
+    sched_test_set_policy(KELP_SCHED_PRIORITY, 500);
+
+    /* Waited three levels' worth: beats a newer task two levels up */
+    old = sched_test_node(test, cls, 0, 1, 0);
+    urgent = sched_test_node(test, cls, 2, 1, 0);
+    sched_test_submit(old, t0);
+    sched_test_submit(urgent, t0 + 3 * step);
+
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, old);
+    kmem_cache_free(sched_cache, n);
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, urgent);
+    kmem_cache_free(sched_cache, n);
+
+    /* ...but not a newer task four levels up */
+    old = sched_test_node(test, cls, 0, 1, 0);
+    urgent = sched_test_node(test, cls, 4, 1, 0);
+    sched_test_submit(old, t0);
+    sched_test_submit(urgent, t0 + 3 * step);
+
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, urgent);
+    kmem_cache_free(sched_cache, n);
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, old);
+    kmem_cache_free(sched_cache, n);
+}
+
+/* Only the documented priority range is accepted, and within it the
+ * aging credit cannot overflow even at the largest aging_ms. */
+static void sched_test_priority_range(struct kunit *test)
+{
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    struct kelp_infer_task t = {};
+    struct sched_node *low, *high, *n;
+
+    t.priority = KELP_INFER_PRIORITY_MIN;
+    KUNIT_EXPECT_TRUE(test, sched_task_valid(&t));
+    t.priority = KELP_INFER_PRIORITY_MAX;
+    KUNIT_EXPECT_TRUE(test, sched_task_valid(&t));
+    t.priority = KELP_INFER_PRIORITY_MIN - 1;
+    KUNIT_EXPECT_FALSE(test, sched_task_valid(&t));
+    t.priority = KELP_INFER_PRIORITY_MAX + 1;
+    KUNIT_EXPECT_FALSE(test, sched_task_valid(&t));
+    t.priority = S32_MIN;
+    KUNIT_EXPECT_FALSE(test, sched_task_valid(&t));
+
+    sched_test_set_policy(KELP_SCHED_PRIORITY, U32_MAX);
+    low = sched_test_node(test, cls, KELP_INFER_PRIORITY_MIN, 1, 0);
+    high = sched_test_node(test, cls, KELP_INFER_PRIORITY_MAX, 1, 0);
+    sched_test_submit(low, 10 * NSEC_PER_SEC);
+    sched_test_submit(high, 20 * NSEC_PER_SEC);
+    KUNIT_EXPECT_LT(test, high->key, low->key);
+
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, high);
+    kmem_cache_free(sched_cache, n);
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, low);
+    kmem_cache_free(sched_cache, n);
+}
+
+/* EDF: absolute deadline order; no deadline means the default one. */
+static void sched_test_edf(struct kunit *test)
+{
+    static const uint32_t deadlines[] = { 300, 0, 100, 200, 50 };
+    static const uint32_t expect[] = { 50, 100, 200, 300, 0 };
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    const uint64_t t0 = 10 * NSEC_PER_SEC;
+    int i;
+
+    sched_test_set_policy(KELP_SCHED_EDF, 0);
+    for (i = 0; i < ARRAY_SIZE(deadlines); i++)
+        sched_test_submit(sched_test_node(test, cls, 0, 1, deadlines[i]), t0);
+
+    for (i = 0; i < ARRAY_SIZE(expect); i++) {
+        struct sched_node *n = sched_test_poll();
+
+        KUNIT_ASSERT_NOT_NULL(test, n);
+        KUNIT_EXPECT_EQ(test, n->task.deadline_ms, expect[i]);
+        kmem_cache_free(sched_cache, n);
+    }
+}
+
+/* FAIR: two backlogged classes are served in proportion to weight. */
+static void sched_test_fair_share(struct kunit *test)
+{
+    struct sched_class *light = sched_test_class(test, 100);
+    struct sched_class *heavy = sched_test_class(test, 300);
+    uint32_t heavy_first = 0;
+    int i;
+
+    sched_test_set_policy(KELP_SCHED_FAIR, 0);
+    for (i = 0; i < SCHED_TEST_TASKS; i++) {
+        sched_test_submit(sched_test_node(test, light, 0, 100, 0), 2 * i);
+        sched_test_submit(sched_test_node(test, heavy, 0, 100, 0), 2 * i + 1);
+    }
+
+    /* While both are backlogged, heavy gets about 3 of every 4 slots. */
+    for (i = 0; i < SCHED_TEST_TASKS; i++) {
+        struct sched_node *n = sched_test_poll();
+
+        KUNIT_ASSERT_NOT_NULL(test, n);
+        heavy_first += n->cls == heavy;
+        kmem_cache_free(sched_cache, n);
+    }
+    KUNIT_EXPECT_GE(test, heavy_first, SCHED_TEST_TASKS * 3 / 4 - 2);
+    KUNIT_EXPECT_LE(test, heavy_first, SCHED_TEST_TASKS * 3 / 4 + 2);
+}
+
+/* Switching policy re-keys what is already queued. */
+static void sched_test_rekey(struct kunit *test)
+{
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    struct sched_node *lax, *tight, *n;
+    unsigned long flags;
+
+    sched_test_set_policy(KELP_SCHED_PRIORITY, 0);
+    lax = sched_test_node(test, cls, 9, 1, 900);
+    tight = sched_test_node(test, cls, 1, 1, 10);
+    sched_test_submit(lax, 0);
+    sched_test_submit(tight, 0);
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_cfg.policy = KELP_SCHED_EDF;
+    sched_rekey();
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, tight);
+    kmem_cache_free(sched_cache, n);
+    n = sched_test_poll();
+    KUNIT_EXPECT_PTR_EQ(test, n, lax);
+    kmem_cache_free(sched_cache, n);
+}
+
+/*
+ * Submit/poll cost with SCHED_BENCH_TASKS queued, per policy: every
+ * task is submitted, then all are polled, so the tree is at full depth
+ * for most operations.  Node allocation is outside the timed loops.
+ */
+static void sched_bench_policy(struct kunit *test, uint32_t policy)
+{
+    struct sched_class *cls = sched_test_class(test, KELP_SCHED_WEIGHT_DEFAULT);
+    struct sched_node **nodes;
+    uint64_t t0, submit_ns, poll_ns;
+    int i;
+
+    nodes = kunit_kmalloc_array(test, SCHED_BENCH_TASKS, sizeof(*nodes),
+                                GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, nodes);
+    for (i = 0; i < SCHED_BENCH_TASKS; i++)
+        nodes[i] = sched_test_node(test, cls, (int32_t)(get_random_u32() % 16),
+                                   1 + get_random_u32() % 512,
+                                   get_random_u32() % 1000);
+
+    sched_test_set_policy(policy, policy == KELP_SCHED_PRIORITY ? 100 : 0);
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < SCHED_BENCH_TASKS; i++)
+        sched_test_submit(nodes[i], ktime_get_ns());
+    submit_ns = ktime_get_ns() - t0;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < SCHED_BENCH_TASKS; i++) {
+        nodes[i] = sched_test_poll();
+        KUNIT_ASSERT_NOT_NULL(test, nodes[i]);
+    }
+    poll_ns = ktime_get_ns() - t0;
+
+    for (i = 0; i < SCHED_BENCH_TASKS; i++)
+        kmem_cache_free(sched_cache, nodes[i]);
+
+    kunit_info(test, "%-8s submit %5llu ns/op  poll %5llu ns/op  (%d queued)\n",
+               sched_policy_names[policy],
+               div_u64(submit_ns, SCHED_BENCH_TASKS),
+               div_u64(poll_ns, SCHED_BENCH_TASKS), SCHED_BENCH_TASKS);
+}
+
+static void sched_bench_submit_poll(struct kunit *test)
+{
+    sched_bench_policy(test, KELP_SCHED_PRIORITY);
+    sched_bench_policy(test, KELP_SCHED_FAIR);
+    sched_bench_policy(test, KELP_SCHED_EDF);
+}
+
+static struct kunit_case sched_test_cases[] = {
+    KUNIT_CASE(sched_test_priority_order),
+    KUNIT_CASE(sched_test_aging),
+    KUNIT_CASE(sched_test_priority_range),
+    KUNIT_CASE(sched_test_edf),
+    KUNIT_CASE(sched_test_fair_share),
+    KUNIT_CASE(sched_test_rekey),
+    KUNIT_CASE_SLOW(sched_bench_submit_poll),
+    {}
+};
+
+static struct kunit_suite sched_test_suite = {
+    .name       = "kelp_sched",
+    .init       = sched_test_init,
+    .exit       = sched_test_exit,
+    .test_cases = sched_test_cases,
+};
+
+kunit_test_suite(sched_test_suite);
@@ -0,0 +1,143 @@
+/*
+ * kelp_chardev_test.c — KUnit tests for the /dev/kelp message queues
+ *
+ * Included at the end of kelp_chardev.c (CONFIG_KELP_KUNIT_TEST).  The
+ * cases use a private struct kelp_queue, so they run alongside open
+ * channels without touching serve_q or any inbox.
+ */
+
+#include <kunit/test.h>
+
+#define QUEUE_TEST_DEPTH    8
+#define QUEUE_BENCH_MSGS    256
+
+static struct kelp_msg *queue_test_msg(struct kunit *test, uint64_t req_id)
+{
+    struct kelp_msg *msg = msg_alloc(16);
+
+    KUNIT_ASSERT_NOT_NULL(test, msg);
+    msg->hdr.req_id = req_id;
+    return msg;
+}
+
+static int queue_test_init(struct kunit *test)
+{
+    struct kelp_queue *q = kunit_kzalloc(test, sizeof(*q), GFP_KERNEL);
+
+    if (!q)
+        return -ENOMEM;
+    queue_init(q, QUEUE_TEST_DEPTH);
+    test->priv = q;
+    return 0;
+}
+
+static void queue_test_exit(struct kunit *test)
+{
+    queue_purge(test->priv);
+}
+
+/* A full queue refuses with -EAGAIN (what makes writers block). */
+static void queue_test_backpressure(struct kunit *test)
+{
+    struct kelp_queue *q = test->priv;
+    struct kelp_msg *msg, *extra;
+    uint64_t i;
+
+    KUNIT_EXPECT_FALSE(test, queue_has_data(q));
+    for (i = 0; i < QUEUE_TEST_DEPTH; i++) {
+        KUNIT_EXPECT_TRUE(test, queue_has_space(q));
+        KUNIT_ASSERT_EQ(test, queue_push(q, queue_test_msg(test, i)), 0);
+    }
+    KUNIT_EXPECT_FALSE(test, queue_has_space(q));
+
+    extra = queue_test_msg(test, QUEUE_TEST_DEPTH);
+    KUNIT_EXPECT_EQ(test, queue_push(q, extra), -EAGAIN);
+
+    /* One pop makes room for exactly one more, and order is FIFO */
+    msg = queue_pop(q);
+    KUNIT_ASSERT_NOT_NULL(test, msg);
+    KUNIT_EXPECT_EQ(test, msg->hdr.req_id, 0ull);
+    kfree(msg);
+    KUNIT_EXPECT_TRUE(test, queue_has_space(q));
+    KUNIT_ASSERT_EQ(test, queue_push(q, extra), 0);
+    KUNIT_EXPECT_FALSE(test, queue_has_space(q));
+
+    for (i = 1; i <= QUEUE_TEST_DEPTH; i++) {
+        msg = queue_pop(q);
+        KUNIT_ASSERT_NOT_NULL(test, msg);
+        KUNIT_EXPECT_EQ(test, msg->hdr.req_id, i);
+        kfree(msg);
+    }
+    KUNIT_EXPECT_FALSE(test, queue_has_data(q));
+    KUNIT_EXPECT_NULL(test, queue_pop(q));
+}
+
+/*
+ * Push/pop cost of the copy path's queue, with and without the per
+ * message allocation that write() does.
+ */
+static void queue_bench_push_pop(struct kunit *test)
+{
+    const uint32_t rounds = 1024;
+    struct kelp_queue *q = test->priv;
+    struct kelp_msg **msgs, *msg;
+    uint64_t t, push_ns = 0, pop_ns = 0, alloc_ns = 0;
+    uint32_t r, i;
+
+    msgs = kunit_kcalloc(test, QUEUE_BENCH_MSGS, sizeof(*msgs), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, msgs);
+    q->depth = QUEUE_BENCH_MSGS;
+    for (i = 0; i < QUEUE_BENCH_MSGS; i++)
+        msgs[i] = queue_test_msg(test, i);
+
+    for (r = 0; r < rounds; r++) {
+        t = ktime_get_ns();
+        for (i = 0; i < QUEUE_BENCH_MSGS; i++)
+            queue_push(q, msgs[i]);
+        push_ns += ktime_get_ns() - t;
+
+        t = ktime_get_ns();
+        for (i = 0; i < QUEUE_BENCH_MSGS; i++)
+            msgs[i] = queue_pop(q);
+        pop_ns += ktime_get_ns() - t;
+        cond_resched();
+    }
+    for (i = 0; i < QUEUE_BENCH_MSGS; i++) {
+        KUNIT_EXPECT_NOT_NULL(test, msgs[i]);
+        kfree(msgs[i]);
+    }
+
+    /* msg_alloc + push + pop + kfree, as one write() and read() pair */
+    t = ktime_get_ns();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < QUEUE_BENCH_MSGS; i++) {
+            msg = msg_alloc(64);
+            KUNIT_ASSERT_NOT_NULL(test, msg);
+            queue_push(q, msg);
+        }
+        for (i = 0; i < QUEUE_BENCH_MSGS; i++)
+            kfree(queue_pop(q));
+        cond_resched();
+    }
+    alloc_ns = ktime_get_ns() - t;
+
+    kunit_info(test, "push %llu ns/op  pop %llu ns/op  alloc+push+pop+free %llu ns/op\n",
+               div_u64(push_ns, rounds * QUEUE_BENCH_MSGS),
+               div_u64(pop_ns, rounds * QUEUE_BENCH_MSGS),
+               div_u64(alloc_ns, rounds * QUEUE_BENCH_MSGS));
+}
+
+static struct kunit_case queue_test_cases[] = {
+    KUNIT_CASE(queue_test_backpressure),
+    KUNIT_CASE_SLOW(queue_bench_push_pop),
+    {}
+};
+
+static struct kunit_suite queue_test_suite = {
+    .name       = "kelp_chardev_queue",
+    .init       = queue_test_init,
+    .exit       = queue_test_exit,
+    .test_cases = queue_test_cases,
+};
+
+kunit_test_suite(queue_test_suite);
@@ -0,0 +1,250 @@
+/*
+ * kelp_ring_test.c — KUnit tests for the shared message ring
+ *
+ * Included at the end of kelp_ring.c (CONFIG_KELP_KUNIT_TEST).  Each
+ * case allocates a ring the way a file's first mmap does, without an
+ * owner, and then plays both user-space sides of the slot protocol from
+ * kelp_kernel.h against it, checking what the kernel's wait conditions
+ * (ring_has_data and ring_has_space) see.
+ */
+
+#include <kunit/test.h>
+#include <linux/log2.h>
+
+static struct kelp_ring *test_ring;
+
+static uint8_t *ring_test_slot(uint64_t pos)
+{
+    return (uint8_t *)test_ring->mem + RING_DATA_OFFSET +
+           (pos & (KELP_RING_SLOTS - 1)) * KELP_RING_SLOT_SIZE;
+}
+
+/* Producer side: publish @v in the slot at head, if it is free. */
+static bool ring_test_push(uint64_t v)
+{
+    struct kelp_ring_hdr *h = ring_hdr(test_ring);
+    uint64_t pos = h->head;
+    struct kelp_ring_desc *d = ring_desc(test_ring, pos);
+
+    if (smp_load_acquire(&d->seq) != pos)
+        return false;
+    memcpy(ring_test_slot(pos), &v, sizeof(v));
+    d->len = sizeof(v);
+    smp_store_release(&d->seq, pos + 1);
+    WRITE_ONCE(h->head, pos + 1);
+    return true;
+}
+
+/* Consumer side: take the message at tail, if one is ready. */
+static bool ring_test_pop(uint64_t *v)
+{
+    struct kelp_ring_hdr *h = ring_hdr(test_ring);
+    uint64_t pos = h->tail;
+    struct kelp_ring_desc *d = ring_desc(test_ring, pos);
+
+    if (smp_load_acquire(&d->seq) != pos + 1)
+        return false;
+    memcpy(v, ring_test_slot(pos), sizeof(*v));
+    smp_store_release(&d->seq, pos + KELP_RING_SLOTS);
+    WRITE_ONCE(h->tail, pos + 1);
+    return true;
+}
+
+/* Restart the protocol at @pos, as if that many messages had passed. */
+static void ring_test_reset(uint64_t pos)
+{
+    uint32_t i;
+
+    ring_hdr(test_ring)->head = pos;
+    ring_hdr(test_ring)->tail = pos;
+    for (i = 0; i < KELP_RING_SLOTS; i++)
+        ring_desc(test_ring, pos + i)->seq = pos + i;
+}
+
+static int ring_test_init(struct kunit *test)
+{
+    test_ring = ring_new(NULL);
+    return test_ring ? 0 : -ENOMEM;
+}
+
+static void ring_test_exit(struct kunit *test)
+{
+    ring_free(test_ring);
+    test_ring = NULL;
+}
+
+static void ring_test_layout(struct kunit *test)
+{
+    struct kelp_ring_hdr *h = ring_hdr(test_ring);
+
+    KUNIT_EXPECT_EQ(test, h->magic, (uint32_t)KELP_RING_MAGIC);
+    KUNIT_EXPECT_EQ(test, h->nslots, (uint32_t)KELP_RING_SLOTS);
+    KUNIT_EXPECT_TRUE(test, is_power_of_2(h->nslots));
+    KUNIT_EXPECT_EQ(test, h->desc_offset % PAGE_SIZE, 0);
+    KUNIT_EXPECT_EQ(test, h->data_offset % PAGE_SIZE, 0);
+    KUNIT_EXPECT_GE(test, h->data_offset,
+                    h->desc_offset + h->nslots * sizeof(struct kelp_ring_desc));
+    KUNIT_EXPECT_EQ(test, h->map_size,
+                    h->data_offset + (uint64_t)h->nslots * h->slot_size);
+}
+
+/* A full ring reports no space until the consumer frees a slot. */
+static void ring_test_backpressure(struct kunit *test)
+{
+    uint64_t v;
+    uint32_t i;
+
+    KUNIT_EXPECT_FALSE(test, ring_has_data(test_ring));
+    KUNIT_EXPECT_TRUE(test, ring_has_space(test_ring));
+
+    for (i = 0; i < KELP_RING_SLOTS; i++)
+        KUNIT_ASSERT_TRUE(test, ring_test_push(i));
+
+    KUNIT_EXPECT_FALSE(test, ring_has_space(test_ring));
+    KUNIT_EXPECT_TRUE(test, ring_has_data(test_ring));
+    KUNIT_EXPECT_FALSE(test, ring_test_push(~0ull));
+
+    KUNIT_ASSERT_TRUE(test, ring_test_pop(&v));
+    KUNIT_EXPECT_EQ(test, v, 0ull);
+    KUNIT_EXPECT_TRUE(test, ring_has_space(test_ring));
+    KUNIT_EXPECT_TRUE(test, ring_test_push(KELP_RING_SLOTS));
+    KUNIT_EXPECT_FALSE(test, ring_has_space(test_ring));
+
+    for (i = 1; i <= KELP_RING_SLOTS; i++) {
+        KUNIT_ASSERT_TRUE(test, ring_test_pop(&v));
+        KUNIT_EXPECT_EQ(test, v, (uint64_t)i);
+    }
+    KUNIT_EXPECT_FALSE(test, ring_has_data(test_ring));
+    KUNIT_EXPECT_FALSE(test, ring_test_pop(&v));
+}
+
+/* Messages stay in order across many laps of the slot array. */
+static void ring_test_wrap_laps(struct kunit *test)
+{
+    uint64_t in = 0, out = 0, v;
+    uint32_t i;
+
+    /* Fill the ring up while lapping it several times */
+    for (i = 0; i < 8 * KELP_RING_SLOTS; i++) {
+        KUNIT_ASSERT_TRUE(test, ring_test_push(in++));
+        if (i % 2 == 0 && ring_test_push(in))
+            in++;
+        KUNIT_ASSERT_TRUE(test, ring_test_pop(&v));
+        KUNIT_ASSERT_EQ(test, v, out++);
+    }
+    while (ring_test_pop(&v))
+        KUNIT_ASSERT_EQ(test, v, out++);
+    KUNIT_EXPECT_EQ(test, in, out);
+}
+
+/* The 64-bit positions themselves wrap without a hiccup. */
+static void ring_test_wrap_u64(struct kunit *test)
+{
+    uint64_t start = U64_MAX - KELP_RING_SLOTS / 2;
+    uint64_t v;
+    uint32_t i;
+
+    ring_test_reset(start);
+
+    for (i = 0; i < KELP_RING_SLOTS; i++)
+        KUNIT_ASSERT_TRUE(test, ring_test_push(i));
+    KUNIT_EXPECT_FALSE(test, ring_has_space(test_ring));
+    KUNIT_EXPECT_LT(test, ring_hdr(test_ring)->head, start);
+
+    for (i = 0; i < KELP_RING_SLOTS; i++) {
+        KUNIT_EXPECT_TRUE(test, ring_has_data(test_ring));
+        KUNIT_ASSERT_TRUE(test, ring_test_pop(&v));
+        KUNIT_EXPECT_EQ(test, v, (uint64_t)i);
+        KUNIT_ASSERT_TRUE(test, ring_test_push(KELP_RING_SLOTS + i));
+    }
+    for (i = 0; i < KELP_RING_SLOTS; i++) {
+        KUNIT_ASSERT_TRUE(test, ring_test_pop(&v));
+        KUNIT_EXPECT_EQ(test, v, (uint64_t)KELP_RING_SLOTS + i);
+    }
+    KUNIT_EXPECT_FALSE(test, ring_has_data(test_ring));
+    KUNIT_EXPECT_TRUE(test, ring_has_space(test_ring));
+}
+
+/* Each file maps a ring of its own, which goes away with the file. */
+static void ring_test_per_file(struct kunit *test)
+{
+    struct file *a = kunit_kzalloc(test, sizeof(*a), GFP_KERNEL);
+    struct file *b = kunit_kzalloc(test, sizeof(*b), GFP_KERNEL);
+    struct kelp_ring *ra, *rb;
+
+    KUNIT_ASSERT_NOT_NULL(test, a);
+    KUNIT_ASSERT_NOT_NULL(test, b);
+
+    ra = ring_get(a);
+    KUNIT_ASSERT_NOT_NULL(test, ra);
+    KUNIT_EXPECT_PTR_EQ(test, ring_get(a), ra);
+    KUNIT_EXPECT_NULL(test, ring_find(b));
+
+    rb = ring_get(b);
+    KUNIT_ASSERT_NOT_NULL(test, rb);
+    KUNIT_EXPECT_PTR_NE(test, rb, ra);
+    KUNIT_EXPECT_PTR_NE(test, rb->mem, ra->mem);
+
+    kelp_ring_release_file(a);
+    KUNIT_EXPECT_NULL(test, ring_find(a));
+    KUNIT_EXPECT_PTR_EQ(test, ring_find(b), rb);
+    kelp_ring_release_file(b);
+    KUNIT_EXPECT_NULL(test, ring_find(b));
+}
+
+/*
+ * Enqueue/dequeue cost of the in-place protocol, in bursts of a full
+ * ring, with the wait conditions checked the way a sleeping peer would.
+ */
+static void ring_bench_enqueue_dequeue(struct kunit *test)
+{
+    const uint32_t laps = 4096;
+    uint64_t t, push_ns = 0, pop_ns = 0, sum = 0, v;
+    uint32_t lap, i;
+
+    for (lap = 0; lap < laps; lap++) {
+        t = ktime_get_ns();
+        for (i = 0; i < KELP_RING_SLOTS; i++) {
+            KUNIT_ASSERT_TRUE_MSG(test, ring_has_space(test_ring) &&
+                                        ring_test_push(i),
+                                  "ring full at %u", i);
+        }
+        push_ns += ktime_get_ns() - t;
+
+        t = ktime_get_ns();
+        for (i = 0; i < KELP_RING_SLOTS; i++) {
+            KUNIT_ASSERT_TRUE_MSG(test, ring_has_data(test_ring) &&
+                                        ring_test_pop(&v),
+                                  "ring empty at %u", i);
+            sum += v;
+        }
+        pop_ns += ktime_get_ns() - t;
+        cond_resched();
+    }
+    KUNIT_EXPECT_EQ(test, sum, (uint64_t)laps * KELP_RING_SLOTS *
+                               (KELP_RING_SLOTS - 1) / 2);
+
+    kunit_info(test, "enqueue %llu ns/op  dequeue %llu ns/op  (%u messages)\n",
+               div_u64(push_ns, laps * KELP_RING_SLOTS),
+               div_u64(pop_ns, laps * KELP_RING_SLOTS),
+               laps * KELP_RING_SLOTS);
+}
+
+static struct kunit_case ring_test_cases[] = {
+    KUNIT_CASE(ring_test_layout),
+    KUNIT_CASE(ring_test_backpressure),
+    KUNIT_CASE(ring_test_wrap_laps),
+    KUNIT_CASE(ring_test_wrap_u64),
+    KUNIT_CASE(ring_test_per_file),
+    KUNIT_CASE_SLOW(ring_bench_enqueue_dequeue),
+    {}
+};
+
+static struct kunit_suite ring_test_suite = {
+    .name       = "kelp_ring",
+    .init       = ring_test_init,
+    .exit       = ring_test_exit,
+    .test_cases = ring_test_cases,
+};
+
+kunit_test_suite(ring_test_suite);
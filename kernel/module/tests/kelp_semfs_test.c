@@ -0,0 +1,296 @@
+/*
+ * kelp_semfs_test.c — KUnit tests for semantic FS event recording
+ *
+ * Included at the end of kelp_semfs.c (CONFIG_KELP_KUNIT_TEST).  Ring
+ * cases run on small private rings, so they can overflow and wrap in a
+ * few records without disturbing the per-CPU ones.  Watch cases use the
+ * live trie under a "/kunit-kelp" prefix nobody else watches, and remove
+ * what they added.
+ */
+
+#include <kunit/test.h>
+
+#define SEMFS_TEST_PREFIX   "/kunit-kelp"
+#define SEMFS_BENCH_EVENTS  256
+
+static struct semfs_ring *semfs_test_ring(struct kunit *test, uint32_t size)
+{
+    struct semfs_ring *r = kunit_kzalloc(test, sizeof(*r), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, r);
+    r->buf = kunit_kzalloc(test, size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, r->buf);
+    spin_lock_init(&r->lock);
+    r->size = size;
+    return r;
+}
+
+/* Deterministic path for event @seq, 1 to 120 bytes past the prefix */
+static void semfs_test_path(char *buf, size_t size, uint32_t seq)
+{
+    int n = scnprintf(buf, size, "/r/%u/", seq);
+
+    memset(buf + n, 'x', seq % 120);
+    buf[n + seq % 120] = '\0';
+}
+
+/* A full ring drops new events and keeps the queued ones intact. */
+static void semfs_test_overflow(struct kunit *test)
+{
+    const uint32_t attempts = 64;
+    struct semfs_ring *r = semfs_test_ring(test, 512);
+    struct kelp_fs_event ev;
+    char path[32];
+    uint32_t i, kept;
+
+    for (i = 0; i < attempts; i++) {
+        snprintf(path, sizeof(path), "/kunit/f%02u", i);
+        ring_record(r, KELP_SEMFS_CREATE, 1000, path);
+    }
+
+    kept = r->records;
+    KUNIT_EXPECT_GT(test, kept, 0u);
+    KUNIT_EXPECT_GT(test, r->dropped, 0ull);
+    KUNIT_EXPECT_EQ(test, r->written + r->dropped, (uint64_t)attempts);
+    KUNIT_EXPECT_LE(test, r->head - r->tail, (uint64_t)r->size);
+
+    /* The oldest events survive, in order */
+    for (i = 0; i < kept; i++) {
+        snprintf(path, sizeof(path), "/kunit/f%02u", i);
+        KUNIT_ASSERT_TRUE(test, ring_pop(r, &ev));
+        KUNIT_EXPECT_STREQ(test, ev.path, path);
+        KUNIT_EXPECT_EQ(test, ev.type, (uint32_t)KELP_SEMFS_CREATE);
+        KUNIT_EXPECT_EQ(test, ev.uid, 1000u);
+    }
+    KUNIT_EXPECT_FALSE(test, ring_pop(r, &ev));
+    KUNIT_EXPECT_EQ(test, r->records, 0u);
+
+    /* Draining makes room again */
+    ring_record(r, KELP_SEMFS_DELETE, 0, "/kunit/again");
+    KUNIT_EXPECT_TRUE(test, ring_pop(r, &ev));
+    KUNIT_EXPECT_STREQ(test, ev.path, "/kunit/again");
+}
+
+/*
+ * Variable-length records across many laps: every record that does not
+ * fit before the end of the buffer is preceded by padding the reader
+ * must skip, whatever room was left there.
+ */
+static void semfs_test_wraparound(struct kunit *test)
+{
+    struct semfs_ring *r = semfs_test_ring(test, 1024);
+    struct kelp_fs_event ev;
+    char want[KELP_SEMFS_PATH_MAX];
+    uint32_t in = 0, out = 0;
+    uint64_t last_ts = 0;
+
+    while (r->head < 32 * (uint64_t)r->size) {
+        semfs_test_path(want, sizeof(want), in++);
+        ring_record(r, KELP_SEMFS_MODIFY, 0, want);
+
+        /* Keep two or three records queued so the tail trails the head */
+        while (r->records > 2) {
+            KUNIT_ASSERT_TRUE(test, ring_pop(r, &ev));
+            semfs_test_path(want, sizeof(want), out++);
+            KUNIT_ASSERT_STREQ(test, ev.path, want);
+            KUNIT_EXPECT_GE(test, ev.timestamp_ns, last_ts);
+            last_ts = ev.timestamp_ns;
+        }
+    }
+    while (ring_pop(r, &ev)) {
+        semfs_test_path(want, sizeof(want), out++);
+        KUNIT_ASSERT_STREQ(test, ev.path, want);
+    }
+
+    KUNIT_EXPECT_EQ(test, r->dropped, 0ull);
+    KUNIT_EXPECT_EQ(test, in, out);
+    KUNIT_EXPECT_EQ(test, r->head, r->tail);
+    KUNIT_EXPECT_EQ(test, ring_peek_ts(r), U64_MAX);
+}
+
+/* Repeated MODIFYs of one inode collapse within the window. */
+static void semfs_test_coalesce(struct kunit *test)
+{
+    uint64_t window = (uint64_t)kelp_get_semfs_coalesce_ms() * NSEC_PER_MSEC;
+    struct semfs_ring *r = semfs_test_ring(test, 512);
+    const uint64_t t = 10 * NSEC_PER_SEC;
+    const dev_t dev = MKDEV(8, 1);
+
+    if (!window)
+        kunit_skip(test, "semfs_coalesce_ms is 0");
+
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 42, t));
+    KUNIT_EXPECT_TRUE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 42, t + 1));
+    KUNIT_EXPECT_TRUE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 42,
+                                           t + window - 1));
+    /* The window runs from the last recorded write, not the last seen */
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 42,
+                                            t + window));
+
+    /* Other inodes, other devices and unknown inodes are independent */
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 43,
+                                            t + window));
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, MKDEV(8, 2), 42,
+                                            t + window));
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 0, t + window));
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 0, t + window));
+
+    /* A non-MODIFY event ends the run */
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 44, t));
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_RENAME, dev, 44, t + 1));
+    KUNIT_EXPECT_FALSE(test, semfs_coalesce(r, KELP_SEMFS_MODIFY, dev, 44, t + 2));
+}
+
+static uint32_t semfs_test_match(const char *path)
+{
+    uint32_t mask;
+
+    rcu_read_lock();
+    mask = trie_match(path);
+    rcu_read_unlock();
+    return mask;
+}
+
+static int semfs_watch_test_init(struct kunit *test)
+{
+    bool ready;
+
+    mutex_lock(&watch_lock);
+    ready = watch_root_locked() && watch_count + 2 <= KELP_SEMFS_MAX_WATCHES;
+    mutex_unlock(&watch_lock);
+
+    if (!ready)
+        kunit_skip(test, "no free watch slots");
+    if (semfs_test_match(SEMFS_TEST_PREFIX "/a/b/c/d"))
+        kunit_skip(test, SEMFS_TEST_PREFIX " is already watched");
+    return 0;
+}
+
+static void semfs_watch_test_exit(struct kunit *test)
+{
+    semfs_watch_remove(SEMFS_TEST_PREFIX "/a/b/c");
+    semfs_watch_remove(SEMFS_TEST_PREFIX "/a");
+}
+
+/* A path matches the union of its own and its parents' watches. */
+static void semfs_test_watch_match(struct kunit *test)
+{
+    const uint32_t create = KELP_SEMFS_MASK(KELP_SEMFS_CREATE);
+    const uint32_t modify = KELP_SEMFS_MASK(KELP_SEMFS_MODIFY);
+    const uint32_t delete = KELP_SEMFS_MASK(KELP_SEMFS_DELETE);
+    struct semfs_node *node;
+    int before = watch_count;
+
+    KUNIT_ASSERT_EQ(test, semfs_watch_add(SEMFS_TEST_PREFIX "/a", create), 0);
+    KUNIT_ASSERT_EQ(test, semfs_watch_add(SEMFS_TEST_PREFIX "/a/b/c", modify), 0);
+    KUNIT_EXPECT_EQ(test, watch_count, before + 2);
+
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a"), create);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/x"), create);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b"), create);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b/c"),
+                    create | modify);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b/c/d/e"),
+                    create | modify);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "//a///b/c/"),
+                    create | modify);
+
+    /* Whole components only, absolute paths only */
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/ab"), 0u);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b/cd"), create);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX), 0u);
+    KUNIT_EXPECT_EQ(test, semfs_test_match("kunit-kelp/a"), 0u);
+
+    /* Adding an existing watch replaces its mask */
+    KUNIT_ASSERT_EQ(test, semfs_watch_add(SEMFS_TEST_PREFIX "/a", delete), 0);
+    KUNIT_EXPECT_EQ(test, watch_count, before + 2);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/x"), delete);
+
+    /* Removing the inner watch leaves the outer one */
+    KUNIT_EXPECT_EQ(test, semfs_watch_remove(SEMFS_TEST_PREFIX "/a/b/c"), 0);
+    KUNIT_EXPECT_EQ(test, semfs_watch_remove(SEMFS_TEST_PREFIX "/a/b/c"), -ENOENT);
+    KUNIT_EXPECT_EQ(test, semfs_watch_remove(SEMFS_TEST_PREFIX "/a/b"), -ENOENT);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b/c/d"), delete);
+
+    /* ...and removing that one prunes the whole branch */
+    KUNIT_EXPECT_EQ(test, semfs_watch_remove(SEMFS_TEST_PREFIX "/a"), 0);
+    KUNIT_EXPECT_EQ(test, semfs_test_match(SEMFS_TEST_PREFIX "/a/b/c/d"), 0u);
+    KUNIT_EXPECT_EQ(test, watch_count, before);
+
+    mutex_lock(&watch_lock);
+    node = trie_lookup(SEMFS_TEST_PREFIX, false);
+    mutex_unlock(&watch_lock);
+    KUNIT_EXPECT_NULL(test, node);
+}
+
+/*
+ * Record/pop cost on one ring (what an fsnotify hook and the reader
+ * pay per event), and trie match cost for a path under a watch.
+ */
+static void semfs_bench_record_pop(struct kunit *test)
+{
+    const uint32_t rounds = 1024;
+    const char *path = "/home/user/project/src/kelp/semfs/main.c";
+    struct semfs_ring *r = semfs_test_ring(test, 64 * 1024);
+    struct kelp_fs_event *ev;
+    uint64_t t, record_ns = 0, pop_ns = 0, match_ns;
+    uint32_t i, round, popped = 0, mask = 0;
+
+    ev = kunit_kzalloc(test, sizeof(*ev), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, ev);
+
+    for (round = 0; round < rounds; round++) {
+        t = ktime_get_ns();
+        for (i = 0; i < SEMFS_BENCH_EVENTS; i++)
+            ring_record(r, KELP_SEMFS_MODIFY, 0, path);
+        record_ns += ktime_get_ns() - t;
+
+        t = ktime_get_ns();
+        while (ring_pop(r, ev))
+            popped++;
+        pop_ns += ktime_get_ns() - t;
+        cond_resched();
+    }
+    KUNIT_EXPECT_EQ(test, r->dropped, 0ull);
+    KUNIT_EXPECT_EQ(test, popped, rounds * SEMFS_BENCH_EVENTS);
+
+    KUNIT_ASSERT_EQ(test, semfs_watch_add(SEMFS_TEST_PREFIX "/a",
+                                          KELP_SEMFS_MASK_ALL), 0);
+    t = ktime_get_ns();
+    for (i = 0; i < rounds * SEMFS_BENCH_EVENTS; i++)
+        mask |= semfs_test_match(SEMFS_TEST_PREFIX "/a/project/src/kelp/main.c");
+    match_ns = ktime_get_ns() - t;
+    semfs_watch_remove(SEMFS_TEST_PREFIX "/a");
+    KUNIT_EXPECT_EQ(test, mask, (uint32_t)KELP_SEMFS_MASK_ALL);
+
+    kunit_info(test, "record %llu ns/op  pop %llu ns/op  match %llu ns/op  (%u events)\n",
+               div_u64(record_ns, popped), div_u64(pop_ns, popped),
+               div_u64(match_ns, rounds * SEMFS_BENCH_EVENTS), popped);
+}
+
+static struct kunit_case semfs_ring_test_cases[] = {
+    KUNIT_CASE(semfs_test_overflow),
+    KUNIT_CASE(semfs_test_wraparound),
+    KUNIT_CASE(semfs_test_coalesce),
+    {}
+};
+
+static struct kunit_suite semfs_ring_test_suite = {
+    .name       = "kelp_semfs_ring",
+    .test_cases = semfs_ring_test_cases,
+};
+
+static struct kunit_case semfs_watch_test_cases[] = {
+    KUNIT_CASE(semfs_test_watch_match),
+    KUNIT_CASE_SLOW(semfs_bench_record_pop),
+    {}
+};
+
+static struct kunit_suite semfs_watch_test_suite = {
+    .name       = "kelp_semfs_watch",
+    .init       = semfs_watch_test_init,
+    .exit       = semfs_watch_test_exit,
+    .test_cases = semfs_watch_test_cases,
+};
+
+kunit_test_suites(&semfs_ring_test_suite, &semfs_watch_test_suite);
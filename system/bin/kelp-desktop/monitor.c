@@ -1,6 +1,7 @@
 /*
  * kelp-desktop :: monitor.c
- * System monitor: /proc/kelp/* metrics, animated bar/line charts.
+ * System monitor: /dev/kelp stats page (or /proc/kelp/* text when the
+ * page cannot be mapped), animated bar/line charts.
  *
  * SPDX-License-Identifier: MIT
  */
@@ -10,6 +11,8 @@
 #include "render.h"
 #include "theme.h"
 
+#include <kelp/kernel.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +48,10 @@ typedef struct {
 
     bool  kelp_available;
     uint32_t last_update_ms;
+
+    /* Mapped stats page; NULL falls back to /proc/kelp. */
+    kelp_kernel_stats_t  *kstats;
+    struct kelp_stats_page kpage;
 } monitor_state_t;
 
 static monitor_state_t g_mon;
@@ -70,11 +77,38 @@ static long proc_val(const char *buf, const char *key)
     return strtol(p, NULL, 10);
 }
 
-static void refresh_metrics(void)
+/*
+ * Kernel counters from the stats page: a memory copy, cheap enough for
+ * every frame.  Returns true when a counter changed.
+ */
+static bool refresh_kelp_page(void)
+{
+    struct kelp_stats_page page;
+
+    if (!g_mon.kstats || kelp_kernel_stats_read(g_mon.kstats, &page) != 0)
+        return false;
+    if (g_mon.kelp_available &&
+        memcmp(&page.kstats, &g_mon.kpage.kstats, sizeof(page.kstats)) == 0 &&
+        memcmp(&page.ai, &g_mon.kpage.ai, sizeof(page.ai)) == 0)
+        return false;
+
+    g_mon.kpage = page;
+    g_mon.kelp_available = true;
+    g_mon.messages_processed = (long)page.kstats.messages_processed;
+    g_mon.bytes_read = (long)page.kstats.bytes_read;
+    g_mon.bytes_written = (long)page.kstats.bytes_written;
+    g_mon.active_sessions = (int)page.kstats.active_sessions;
+    g_mon.uptime_sec = (long)page.kstats.uptime_seconds;
+    g_mon.queue_depth = (int)page.ai.sched_queue_depth;
+    g_mon.total_submitted = (long)page.ai.sched_total_submitted;
+    g_mon.total_completed = (long)page.ai.sched_total_completed;
+    return true;
+}
+
+static void refresh_kelp_proc(void)
 {
     char buf[2048];
 
-    /* Kelp kernel module. */
     read_proc("/proc/kelp/stats", buf, sizeof(buf));
     if (buf[0]) {
         g_mon.kelp_available = true;
@@ -91,6 +125,15 @@ static void refresh_metrics(void)
         g_mon.total_submitted = proc_val(buf, "total_submitted");
         g_mon.total_completed = proc_val(buf, "total_completed");
     }
+}
+
+static void refresh_metrics(void)
+{
+    char buf[2048];
+
+    /* Kelp kernel module, when the stats page is not mapped. */
+    if (!g_mon.kstats)
+        refresh_kelp_proc();
 
     /* System memory. */
     read_proc("/proc/meminfo", buf, sizeof(buf));
@@ -125,18 +168,32 @@ void kd_monitor_init(kd_desktop_t *d)
 {
     (void)d;
     memset(&g_mon, 0, sizeof(g_mon));
+
+    /* The mapping outlives the descriptor. */
+    int fd = kelp_kernel_open();
+    if (fd >= 0) {
+        g_mon.kstats = kelp_kernel_stats_map(fd);
+        kelp_kernel_close(fd);
+    }
+
+    refresh_kelp_page();
     refresh_metrics();
 }
 
 void kd_monitor_shutdown(kd_desktop_t *d)
 {
     (void)d;
+    kelp_kernel_stats_unmap(g_mon.kstats);
+    g_mon.kstats = NULL;
 }
 
 /* ---- Update ------------------------------------------------------------- */
 
 void kd_monitor_update(kd_desktop_t *d, uint32_t now_ms)
 {
+    if (refresh_kelp_page())
+        d->needs_redraw = true;
+
     if (now_ms - g_mon.last_update_ms < 1000) return;
     g_mon.last_update_ms = now_ms;
     refresh_metrics();
@@ -16,6 +16,7 @@
 
 #include <kelp/kelp.h>
 #include <kelp/config.h>
+#include <kelp/config_snapshot.h>
 #include <kelp/paths.h>
 #include <kelp/http.h>
 #include <kelp/signals.h>
@@ -38,6 +39,7 @@
 #include <netinet/in.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -51,6 +53,7 @@
 
 #ifdef __linux__
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #elif defined(__APPLE__) || defined(__FreeBSD__)
 #include <sys/event.h>
 #endif
@@ -77,6 +80,7 @@
 #define MAX_POST_DATA         (16 * 1024 * 1024) /* 16 MiB */
 #define UNIX_BACKLOG          16
 #define UNIX_BUF_SIZE         65536
+#define UNIX_MAX_INFLIGHT     16     /* request threads per connection */
 #define THREAD_POOL_SIZE      8
 
 /* ---- WebSocket constants ------------------------------------------------ */
@@ -109,8 +113,8 @@ static int                   g_ws_port       = 0;
 
 #ifdef __linux__
 static int                   g_kernel_fd     = -1;
-static pthread_t             g_kernel_thread;
-static bool                  g_kernel_thread_running = false;
+static int                   g_kernel_efd    = -1;  /* eventfd fallback */
+static atomic_int            g_kernel_inflight;
 #endif
 
 #ifdef HAVE_AGENTS
@@ -118,6 +122,51 @@ static kelp_provider_t     *g_provider      = NULL;
 static kelp_tool_ctx_t     *g_tools         = NULL;
 #endif
 
+/* ---- Live configuration ------------------------------------------------- */
+
+/*
+ * g_cfg holds the configuration as loaded at startup and is only used for
+ * settings that cannot change without a restart (listen address, socket,
+ * logging).  Everything a request reads goes through the published
+ * snapshot, which the config watcher replaces when kelp.yaml changes.
+ */
+
+static bool cfg_bool(const char *key, bool def)
+{
+    kelp_config_guard_t g;
+    bool v = kelp_config_snapshot_get_bool(kelp_config_read_begin(&g), key, def);
+    kelp_config_read_end(&g);
+    return v;
+}
+
+/** Copy a string setting into @p buf; returns @p def if it is unset. */
+static const char *cfg_str(const char *key, char *buf, size_t len,
+                           const char *def)
+{
+    kelp_config_guard_t g;
+    const char *v = kelp_config_snapshot_get_string(kelp_config_read_begin(&g), key);
+    if (v)
+        snprintf(buf, len, "%s", v);
+    kelp_config_read_end(&g);
+    return v ? buf : def;
+}
+
+static void on_config_reload(const kelp_config_snapshot_t *snap, void *userdata)
+{
+    (void)userdata;
+    if (!snap) {
+        KELP_WARN("config reload failed; keeping previous configuration");
+        return;
+    }
+    KELP_INFO("config reloaded (generation %llu): model=%s sandbox=%s",
+               (unsigned long long)kelp_config_snapshot_generation(snap),
+               kelp_config_snapshot_get_string(snap, "model.default_model")
+                   ? kelp_config_snapshot_get_string(snap, "model.default_model")
+                   : "(unset)",
+               kelp_config_snapshot_get_bool(snap, "security.sandbox_enabled", true)
+                   ? "on" : "off");
+}
+
 /* ---- Session tracking (with conversation history) ----------------------- */
 
 #define MAX_HISTORY_MESSAGES  50   /* per session */
@@ -178,49 +227,38 @@ static void session_add_message(gateway_session_t *s,
     s->last_active = time(NULL);
 }
 
-static gateway_session_t *session_find(const char *channel_id,
-                                        const char *user_id)
-{
-    if (!channel_id) return NULL;
-    const char *uid = user_id ? user_id : "";
-
-    pthread_mutex_lock(&g_sessions_lock);
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (g_sessions[i].active &&
-            strcmp(g_sessions[i].channel_id, channel_id) == 0 &&
-            strcmp(g_sessions[i].user_id, uid) == 0) {
-            pthread_mutex_unlock(&g_sessions_lock);
-            return &g_sessions[i];
-        }
-    }
-    pthread_mutex_unlock(&g_sessions_lock);
-    return NULL;
-}
+/*
+ * Turns in flight on each slot, under g_sessions_lock.  A pinned session
+ * is never evicted, so its agent cannot be freed under a running turn.
+ * Kept beside the session table so session resets (memset) leave it alone.
+ */
+static int g_session_pins[MAX_SESSIONS];
 
-static gateway_session_t *session_find_or_create(const char *channel_id,
-                                                   const char *user_id)
+/* Find or create a session, evicting only unpinned ones; g_sessions_lock held. */
+static gateway_session_t *session_lookup_locked(const char *channel_id,
+                                                const char *uid)
 {
-    gateway_session_t *s = session_find(channel_id, user_id);
-    if (s) return s;
-
-    const char *uid = user_id ? user_id : "";
-
-    pthread_mutex_lock(&g_sessions_lock);
-    /* Find oldest inactive, or evict LRU if full */
     int slot = -1;
     time_t oldest = 0;
-    int oldest_slot = 0;
+    int oldest_slot = -1;
     for (int i = 0; i < MAX_SESSIONS; i++) {
         if (!g_sessions[i].active) {
-            slot = i;
-            break;
+            if (slot < 0)
+                slot = i;
+            continue;
         }
-        if (oldest == 0 || g_sessions[i].last_active < oldest) {
+        if (strcmp(g_sessions[i].channel_id, channel_id) == 0 &&
+            strcmp(g_sessions[i].user_id, uid) == 0)
+            return &g_sessions[i];
+        if (g_session_pins[i] == 0 &&
+            (oldest_slot < 0 || g_sessions[i].last_active < oldest)) {
             oldest = g_sessions[i].last_active;
             oldest_slot = i;
         }
     }
     if (slot < 0) {
+        if (oldest_slot < 0)
+            return NULL;    /* every session has a turn running */
         /* Evict LRU session */
         session_clear_history(&g_sessions[oldest_slot]);
         slot = oldest_slot;
@@ -233,13 +271,66 @@ static gateway_session_t *session_find_or_create(const char *channel_id,
     ns->last_active = ns->created;
     snprintf(ns->id, sizeof(ns->id), "sess_%08x%08x",
              (unsigned)ns->created, (unsigned)slot);
-    snprintf(ns->channel_id, sizeof(ns->channel_id), "%s",
-             channel_id ? channel_id : "");
+    snprintf(ns->channel_id, sizeof(ns->channel_id), "%s", channel_id);
     snprintf(ns->user_id, sizeof(ns->user_id), "%s", uid);
-    pthread_mutex_unlock(&g_sessions_lock);
     return ns;
 }
 
+static gateway_session_t *session_find_or_create(const char *channel_id,
+                                                   const char *user_id)
+{
+    pthread_mutex_lock(&g_sessions_lock);
+    gateway_session_t *s = session_lookup_locked(channel_id ? channel_id : "",
+                                                 user_id ? user_id : "");
+    pthread_mutex_unlock(&g_sessions_lock);
+    return s;
+}
+
+/**
+ * Like session_find_or_create(), but pins the session until
+ * session_release(), for a turn that uses its agent.
+ */
+static gateway_session_t *session_acquire(const char *channel_id,
+                                          const char *user_id)
+{
+    pthread_mutex_lock(&g_sessions_lock);
+    gateway_session_t *s = session_lookup_locked(channel_id ? channel_id : "",
+                                                 user_id ? user_id : "");
+    if (s) {
+        g_session_pins[s - g_sessions]++;
+        s->last_active = time(NULL);
+    }
+    pthread_mutex_unlock(&g_sessions_lock);
+    return s;
+}
+
+static void session_release(gateway_session_t *s)
+{
+    pthread_mutex_lock(&g_sessions_lock);
+    g_session_pins[s - g_sessions]--;
+    pthread_mutex_unlock(&g_sessions_lock);
+}
+
+/*
+ * One conversation turn at a time per session: a bridge may now have
+ * several requests in flight for the same chat, and an agent's history is
+ * not safe to share.  Taken only while the session is pinned.
+ */
+static pthread_mutex_t g_session_turns[MAX_SESSIONS];
+static pthread_once_t  g_session_turns_once = PTHREAD_ONCE_INIT;
+
+static void session_turns_init(void)
+{
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        pthread_mutex_init(&g_session_turns[i], NULL);
+}
+
+static pthread_mutex_t *session_turn_lock(const gateway_session_t *s)
+{
+    pthread_once(&g_session_turns_once, session_turns_init);
+    return &g_session_turns[s - g_sessions];
+}
+
 static gateway_session_t *session_create(void)
 {
     return session_find_or_create("_anonymous_", "_anonymous_");
@@ -537,7 +628,7 @@ static char *gateway_agent_chat_full(
         .system_prompt   = system_prompt ? system_prompt
                                : "You are a helpful AI assistant.",
         .max_turns       = 10,
-        .sandbox_tools   = g_cfg.security.sandbox_enabled,
+        .sandbox_tools   = cfg_bool("security.sandbox_enabled", true),
         .model           = model,
         .max_tokens      = max_tokens,
         .on_stream       = on_stream,
@@ -624,10 +715,10 @@ static enum MHD_Result handle_chat_completions(
 
     gateway_session_t *sess = session_create();
 
+    char default_model[128];
     const char *effective_model = model ? model
-        : (g_cfg.model.default_model
-               ? g_cfg.model.default_model
-               : "claude-sonnet-4-20250514");
+        : cfg_str("model.default_model", default_model, sizeof(default_model),
+                  "claude-sonnet-4-20250514");
 
 #ifdef HAVE_AGENTS
     /* Extract last user message and build history from prior messages */
@@ -824,9 +915,10 @@ static enum MHD_Result handle_messages(
                stream ? "true" : "false");
 
     gateway_session_t *sess = session_create();
+    char default_model[128];
     const char *effective_model = model ? model
-        : (g_cfg.model.default_model ? g_cfg.model.default_model
-               : "claude-sonnet-4-20250514");
+        : cfg_str("model.default_model", default_model, sizeof(default_model),
+                  "claude-sonnet-4-20250514");
 
 #ifdef HAVE_AGENTS
     /* Extract last user message and build history from prior messages */
@@ -1046,6 +1138,10 @@ static enum MHD_Result handle_config(struct MHD_Connection *conn)
 {
     cJSON *obj = cJSON_CreateObject();
 
+    kelp_config_guard_t guard;
+    const kelp_config_t *cfg =
+        kelp_config_snapshot_config(kelp_config_read_begin(&guard));
+
     cJSON *gw = cJSON_AddObjectToObject(obj, "gateway");
     cJSON_AddStringToObject(gw, "host",
                             g_cfg.gateway.host ? g_cfg.gateway.host : g_listen_addr);
@@ -1054,16 +1150,18 @@ static enum MHD_Result handle_config(struct MHD_Connection *conn)
 
     cJSON *mdl = cJSON_AddObjectToObject(obj, "model");
     cJSON_AddStringToObject(mdl, "default_provider",
-                            g_cfg.model.default_provider
-                                ? g_cfg.model.default_provider : "anthropic");
+                            cfg->model.default_provider
+                                ? cfg->model.default_provider : "anthropic");
     cJSON_AddStringToObject(mdl, "default_model",
-                            g_cfg.model.default_model
-                                ? g_cfg.model.default_model : "(unset)");
-    cJSON_AddNumberToObject(mdl, "max_tokens", g_cfg.model.max_tokens);
-    cJSON_AddNumberToObject(mdl, "temperature", (double)g_cfg.model.temperature);
+                            cfg->model.default_model
+                                ? cfg->model.default_model : "(unset)");
+    cJSON_AddNumberToObject(mdl, "max_tokens", cfg->model.max_tokens);
+    cJSON_AddNumberToObject(mdl, "temperature", (double)cfg->model.temperature);
 
     cJSON *sec = cJSON_AddObjectToObject(obj, "security");
-    cJSON_AddBoolToObject(sec, "sandbox_enabled", g_cfg.security.sandbox_enabled);
+    cJSON_AddBoolToObject(sec, "sandbox_enabled", cfg->security.sandbox_enabled);
+
+    kelp_config_read_end(&guard);
 
     struct MHD_Response *resp = json_success_response(obj);
     cJSON_Delete(obj);
@@ -1330,11 +1428,54 @@ static int unix_socket_create(const char *path)
     return fd;
 }
 
+/*
+ * Sends one notification line to the client a request came from, for
+ * transports that can carry more than the response (the Unix socket).
+ */
+typedef void (*jsonrpc_emit_fn)(const char *json, void *ctx);
+
+#ifdef HAVE_AGENTS
+typedef struct {
+    int              rpc_id;
+    jsonrpc_emit_fn  emit;
+    void            *ctx;
+} chat_delta_ctx_t;
+
+/* Forward streamed text as {"method":"chat.delta","params":{id,text}}. */
+static int chat_delta_callback(const kelp_stream_event_t *event,
+                               void *userdata)
+{
+    chat_delta_ctx_t *d = userdata;
+
+    if (strcmp(event->type, "text") != 0 || !event->text || !*event->text)
+        return 0;
+
+    cJSON *note = cJSON_CreateObject();
+    cJSON_AddStringToObject(note, "jsonrpc", "2.0");
+    cJSON_AddStringToObject(note, "method", "chat.delta");
+    cJSON *params = cJSON_AddObjectToObject(note, "params");
+    cJSON_AddNumberToObject(params, "id", d->rpc_id);
+    cJSON_AddStringToObject(params, "text", event->text);
+
+    char *json = cJSON_PrintUnformatted(note);
+    cJSON_Delete(note);
+    if (json) {
+        d->emit(json, d->ctx);
+        free(json);
+    }
+    return 0;
+}
+#endif /* HAVE_AGENTS */
+
 /**
  * Dispatch a JSON-RPC request and return a malloc'd JSON response string.
  * Caller must free the returned string. Returns NULL on allocation failure.
+ *
+ * If `emit` is set, chat.send with "stream": true sends its partial text
+ * through it as chat.delta notifications before the response.
  */
-static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
+static char *jsonrpc_dispatch(const char *request_data, size_t request_len,
+                              jsonrpc_emit_fn emit, void *emit_ctx)
 {
     (void)request_len;
 
@@ -1376,14 +1517,21 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
 #ifdef HAVE_AGENTS
             /* Find or create session for this channel+user */
             gateway_session_t *sess = channel_id
-                ? session_find_or_create(channel_id, user_id)
-                : session_create();
+                ? session_acquire(channel_id, user_id)
+                : session_acquire("_anonymous_", "_anonymous_");
+            if (sess)
+                pthread_mutex_lock(session_turn_lock(sess));
 
             /* Lazily initialize agent with tools for this session */
             if (sess && !sess->agent) {
+                /* Provider and agent copy what they keep, so the snapshot
+                 * is only needed while they are being built. */
+                kelp_config_guard_t guard;
+                const kelp_config_t *cfg =
+                    kelp_config_snapshot_config(kelp_config_read_begin(&guard));
                 kelp_provider_type_t ptype = resolve_provider_type(
-                    g_cfg.model.default_provider);
-                sess->provider = kelp_provider_new(ptype, g_cfg.model.api_key);
+                    cfg->model.default_provider);
+                sess->provider = kelp_provider_new(ptype, cfg->model.api_key);
                 if (sess->provider) {
                     sess->tools = kelp_tool_ctx_new("/tmp/kelp-workspace");
                     if (sess->tools)
@@ -1392,12 +1540,12 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
                     kelp_agent_opts_t agent_opts = {
                         .provider       = sess->provider,
                         .tools          = sess->tools,
-                        .system_prompt  = g_cfg.model.system_prompt,
+                        .system_prompt  = cfg->model.system_prompt,
                         .max_turns      = 10,
-                        .sandbox_tools  = g_cfg.security.sandbox_enabled,
+                        .sandbox_tools  = cfg->security.sandbox_enabled,
                         .on_stream      = NULL,
                         .stream_userdata = NULL,
-                        .model          = g_cfg.model.default_model,
+                        .model          = cfg->model.default_model,
                         .max_tokens     = 0,
                     };
                     sess->agent = kelp_agent_new(&agent_opts);
@@ -1405,18 +1553,28 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
                         KELP_INFO("chat.send: created agent for session %s",
                                    sess->id);
                 }
+                kelp_config_read_end(&guard);
             }
 
             /* Run the agent loop (handles history + tool use internally) */
             char *agent_response = NULL;
             if (sess && sess->agent) {
-                int rc = kelp_agent_chat(sess->agent, message,
-                                          &agent_response);
+                chat_delta_ctx_t delta = { rpc_id, emit, emit_ctx };
+                bool stream = emit &&
+                              kelp_json_get_bool(params, "stream", false);
+                int rc = kelp_agent_chat_stream(
+                    sess->agent, message,
+                    stream ? chat_delta_callback : NULL, &delta,
+                    &agent_response);
                 if (rc != 0)
                     KELP_ERROR("chat.send: agent chat failed (rc=%d)", rc);
             } else {
                 KELP_ERROR("chat.send: no agent available for session");
             }
+            if (sess) {
+                pthread_mutex_unlock(session_turn_lock(sess));
+                session_release(sess);
+            }
 
             cJSON *result = cJSON_AddObjectToObject(resp, "result");
             cJSON_AddStringToObject(result, "content",
@@ -1449,12 +1607,15 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
             cJSON_AddNumberToObject(err, "code", -32602);
             cJSON_AddStringToObject(err, "message", "missing 'key' parameter");
         } else {
-            const char *val = kelp_config_get_string(&g_cfg, key);
+            kelp_config_guard_t guard;
+            const char *val = kelp_config_snapshot_get_string(
+                kelp_config_read_begin(&guard), key);
             cJSON *result = cJSON_AddObjectToObject(resp, "result");
             if (val)
                 cJSON_AddStringToObject(result, "value", val);
             else
                 cJSON_AddNullToObject(result, "value");
+            kelp_config_read_end(&guard);
         }
     } else if (strcmp(method, "sessions.list") == 0) {
         cJSON *result = cJSON_AddObjectToObject(resp, "result");
@@ -1497,6 +1658,61 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
         cJSON_AddBoolToObject(result, "connected", false);
         cJSON_AddStringToObject(result, "error",
                                 "kernel module only available on Linux");
+#endif
+    } else if (strcmp(method, "kernel.flows") == 0) {
+        cJSON *result = cJSON_AddObjectToObject(resp, "result");
+#ifdef __linux__
+        struct kelp_nf_flow *flows = NULL;
+        bool more = true;
+        uint64_t overflow = 0;
+        int total = 0;
+
+        if (g_kernel_fd >= 0)
+            flows = calloc(KELP_NF_BATCH_MAX, sizeof(*flows));
+        if (flows) {
+            /* One export interval; flows are listed per CPU that saw them */
+            cJSON *arr = cJSON_AddArrayToObject(result, "flows");
+            while (more) {
+                int n = kelp_kernel_get_flows(g_kernel_fd, flows,
+                                              KELP_NF_BATCH_MAX,
+                                              &more, &overflow);
+                if (n < 0) {
+                    cJSON_AddStringToObject(result, "error", strerror(errno));
+                    break;
+                }
+                for (int i = 0; i < n; i++) {
+                    const struct kelp_nf_flow *f = &flows[i];
+                    char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+                    cJSON *fo = cJSON_CreateObject();
+
+                    inet_ntop(AF_INET, &f->saddr, src, sizeof(src));
+                    inet_ntop(AF_INET, &f->daddr, dst, sizeof(dst));
+                    cJSON_AddStringToObject(fo, "src", src);
+                    cJSON_AddNumberToObject(fo, "sport", ntohs(f->sport));
+                    cJSON_AddStringToObject(fo, "dst", dst);
+                    cJSON_AddNumberToObject(fo, "dport", ntohs(f->dport));
+                    cJSON_AddNumberToObject(fo, "protocol", f->protocol);
+                    cJSON_AddNumberToObject(fo, "cpu", f->cpu);
+                    cJSON_AddNumberToObject(fo, "packets", (double)f->packets);
+                    cJSON_AddNumberToObject(fo, "bytes", (double)f->bytes);
+                    cJSON_AddNumberToObject(fo, "first_ns", (double)f->first_ns);
+                    cJSON_AddNumberToObject(fo, "last_ns", (double)f->last_ns);
+                    cJSON_AddItemToArray(arr, fo);
+                }
+                total += n;
+            }
+            cJSON_AddBoolToObject(result, "connected", true);
+            cJSON_AddNumberToObject(result, "count", total);
+            cJSON_AddNumberToObject(result, "overflow", (double)overflow);
+            free(flows);
+        } else {
+            cJSON_AddBoolToObject(result, "connected", false);
+            cJSON_AddStringToObject(result, "error", "not available");
+        }
+#else
+        cJSON_AddBoolToObject(result, "connected", false);
+        cJSON_AddStringToObject(result, "error",
+                                "kernel module only available on Linux");
 #endif
     } else if (strncmp(method, "desktop.", 8) == 0) {
         /*
@@ -1579,59 +1795,168 @@ static char *jsonrpc_dispatch(const char *request_data, size_t request_len)
     return resp_str;
 }
 
-/**
- * Handle a single JSON-RPC request on a Unix domain socket client connection.
+/*
+ * A Unix socket connection carries any number of newline-delimited
+ * requests, and a bridge keeps one open for its lifetime.  Each request
+ * runs on its own thread so a long model call does not hold up the ones
+ * behind it; responses go back in completion order, matched by id.  At
+ * most UNIX_MAX_INFLIGHT run at once; past that the reader stops reading
+ * until one finishes.  The last request thread (or the reader, if none
+ * are left) closes the fd.
  */
-static void unix_client_handle(int client_fd)
+typedef struct {
+    int              fd;
+    pthread_mutex_t  wlock;     /* one line at a time */
+    atomic_int       refs;      /* reader + running requests */
+    pthread_mutex_t  slots_lock;
+    pthread_cond_t   slot_free;
+    int              running;   /* request threads, under slots_lock */
+} unix_conn_t;
+
+typedef struct {
+    unix_conn_t     *conn;
+    size_t           len;
+    char             data[];
+} unix_request_t;
+
+static void unix_conn_put(unix_conn_t *conn)
 {
-    char buf[UNIX_BUF_SIZE];
-    kelp_str_t request = kelp_str_new();
+    if (atomic_fetch_sub(&conn->refs, 1) != 1)
+        return;
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->wlock);
+    pthread_mutex_destroy(&conn->slots_lock);
+    pthread_cond_destroy(&conn->slot_free);
+    free(conn);
+}
 
-    /* Read until newline or EOF. */
-    for (;;) {
-        ssize_t n = read(client_fd, buf, sizeof(buf) - 1);
+/* Write `json` and its newline delimiter as one unit. */
+static void unix_conn_send(const char *json, void *ctx)
+{
+    unix_conn_t *conn = ctx;
+    size_t rlen = strlen(json);
+    char *sendbuf = malloc(rlen + 1);
+
+    if (!sendbuf)
+        return;
+    memcpy(sendbuf, json, rlen);
+    sendbuf[rlen] = '\n';
+
+    pthread_mutex_lock(&conn->wlock);
+    size_t written = 0;
+    while (written < rlen + 1) {
+        ssize_t n = send(conn->fd, sendbuf + written, rlen + 1 - written,
+                         MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
         if (n <= 0)
             break;
-        buf[n] = '\0';
-        kelp_str_append(&request, buf, (size_t)n);
-        if (request.len > 0 && request.data[request.len - 1] == '\n')
-            break;
-        if (request.len > MAX_POST_DATA)
-            break;
+        written += (size_t)n;
+    }
+    pthread_mutex_unlock(&conn->wlock);
+    free(sendbuf);
+}
+
+static void *unix_request_thread(void *arg)
+{
+    unix_request_t *req = arg;
+
+    char *resp_str = jsonrpc_dispatch(req->data, req->len,
+                                      unix_conn_send, req->conn);
+    if (resp_str) {
+        unix_conn_send(resp_str, req->conn);
+        free(resp_str);
     }
 
-    if (request.len == 0) {
-        kelp_str_free(&request);
+    pthread_mutex_lock(&req->conn->slots_lock);
+    req->conn->running--;
+    pthread_cond_signal(&req->conn->slot_free);
+    pthread_mutex_unlock(&req->conn->slots_lock);
+
+    unix_conn_put(req->conn);
+    free(req);
+    return NULL;
+}
+
+/* Start a request thread for one line (without its newline). */
+static void unix_request_dispatch(unix_conn_t *conn, const char *line,
+                                  size_t len)
+{
+    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' '))
+        len--;
+    if (len == 0)
+        return;
+
+    unix_request_t *req = malloc(sizeof(*req) + len + 1);
+    pthread_t tid;
+
+    if (!req)
         return;
+    req->conn = conn;
+    req->len  = len;
+    memcpy(req->data, line, len);
+    req->data[len] = '\0';
+
+    pthread_mutex_lock(&conn->slots_lock);
+    while (conn->running >= UNIX_MAX_INFLIGHT)
+        pthread_cond_wait(&conn->slot_free, &conn->slots_lock);
+    conn->running++;
+    pthread_mutex_unlock(&conn->slots_lock);
+
+    atomic_fetch_add(&conn->refs, 1);
+    if (pthread_create(&tid, NULL, unix_request_thread, req) == 0) {
+        pthread_detach(tid);
+    } else {
+        KELP_WARN("failed to start Unix socket request thread");
+        atomic_fetch_sub(&conn->refs, 1);
+        pthread_mutex_lock(&conn->slots_lock);
+        conn->running--;
+        pthread_mutex_unlock(&conn->slots_lock);
+        free(req);
     }
+}
 
-    kelp_str_trim(&request);
+/**
+ * Read requests from a Unix domain socket client until it hangs up.
+ * A final request without a trailing newline is still answered.
+ */
+static void unix_client_handle(unix_conn_t *conn)
+{
+    char buf[UNIX_BUF_SIZE];
+    kelp_str_t pending = kelp_str_new();
 
-    char *resp_str = jsonrpc_dispatch(request.data, request.len);
-    kelp_str_free(&request);
+    for (;;) {
+        ssize_t n = read(conn->fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        if (kelp_str_append(&pending, buf, (size_t)n) != 0)
+            break;
 
-    if (resp_str) {
-        size_t rlen = strlen(resp_str);
-        /* Append newline delimiter. */
-        char *sendbuf = malloc(rlen + 2);
-        if (sendbuf) {
-            memcpy(sendbuf, resp_str, rlen);
-            sendbuf[rlen]     = '\n';
-            sendbuf[rlen + 1] = '\0';
-
-            ssize_t written = 0;
-            ssize_t total = (ssize_t)(rlen + 1);
-            while (written < total) {
-                ssize_t n = write(client_fd, sendbuf + written,
-                                  (size_t)(total - written));
-                if (n <= 0)
-                    break;
-                written += n;
-            }
-            free(sendbuf);
+        size_t start = 0;
+        char *nl;
+        while ((nl = memchr(pending.data + start, '\n',
+                            pending.len - start))) {
+            unix_request_dispatch(conn, pending.data + start,
+                                  (size_t)(nl - pending.data) - start);
+            start = (size_t)(nl - pending.data) + 1;
+        }
+        if (start > 0) {
+            memmove(pending.data, pending.data + start,
+                    pending.len - start + 1);
+            pending.len -= start;
+        }
+        if (pending.len > MAX_POST_DATA) {
+            KELP_WARN("Unix socket request too large, closing connection");
+            pending.len = 0;
+            break;
         }
-        free(resp_str);
     }
+
+    /* One-shot clients may shut down their write side without a newline. */
+    unix_request_dispatch(conn, pending.data, pending.len);
+    kelp_str_free(&pending);
 }
 
 /**
@@ -1640,41 +1965,171 @@ static void unix_client_handle(int client_fd)
 static void *unix_client_thread(void *arg)
 {
     int client_fd = (int)(intptr_t)arg;
-    unix_client_handle(client_fd);
-    close(client_fd);
+    unix_conn_t *conn = calloc(1, sizeof(*conn));
+
+    if (!conn) {
+        close(client_fd);
+        return NULL;
+    }
+    conn->fd = client_fd;
+    pthread_mutex_init(&conn->wlock, NULL);
+    pthread_mutex_init(&conn->slots_lock, NULL);
+    pthread_cond_init(&conn->slot_free, NULL);
+    atomic_init(&conn->refs, 1);
+
+    unix_client_handle(conn);
+    unix_conn_put(conn);
     return NULL;
 }
 
-/* ---- Kernel reader thread ----------------------------------------------- */
+/* ---- Kernel channel ----------------------------------------------------- */
 
 #ifdef __linux__
-static void *kernel_reader_thread(void *arg)
-{
-    (void)arg;
-    KELP_INFO("kernel reader thread started");
+/* How long a response may wait for room in the client's inbox. */
+#define KERNEL_SEND_TIMEOUT_MS  5000
 
-    while (!g_shutdown) {
-        size_t len = 0;
-        char *msg = kelp_kernel_recv(g_kernel_fd, &len);
-        if (!msg) {
-            /* EAGAIN or error — brief sleep and retry */
-            usleep(10000); /* 10ms */
-            continue;
+typedef struct {
+    struct kelp_msg_hdr  hdr;   /* client channel and request id */
+    size_t               len;
+    char                 msg[];
+} kernel_request_t;
+
+static void kernel_send_response(const struct kelp_msg_hdr *hdr,
+                                 const char *response)
+{
+    size_t len = strlen(response);
+
+    /* A server fd always polls writable, so back off while the client's
+     * inbox is full rather than spinning on POLLOUT. */
+    for (int waited = 0;
+         kelp_kernel_chan_send(g_kernel_fd, hdr, response, len) != 0;
+         waited += 10) {
+        if (errno != EAGAIN || waited >= KERNEL_SEND_TIMEOUT_MS) {
+            KELP_WARN("dropping kernel response for channel %llu/%llu: %s",
+                      (unsigned long long)hdr->channel,
+                      (unsigned long long)hdr->req_id,
+                      errno == EAGAIN ? "inbox full" : strerror(errno));
+            return;
         }
+        struct timespec ts = { 0, 10 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+}
 
-        /* Dispatch and send response */
-        char *response = jsonrpc_dispatch(msg, len);
-        free(msg);
+/*
+ * Requests can take as long as a model call, so each runs on its own
+ * thread, the way Unix socket clients do.
+ */
+static void *kernel_request_thread(void *arg)
+{
+    kernel_request_t *req = arg;
 
-        if (response) {
-            kelp_kernel_send(g_kernel_fd, response, strlen(response));
-            free(response);
-        }
+    char *response = jsonrpc_dispatch(req->msg, req->len, NULL, NULL);
+    if (response) {
+        kernel_send_response(&req->hdr, response);
+        free(response);
     }
 
-    KELP_INFO("kernel reader thread exited");
+    free(req);
+    atomic_fetch_sub(&g_kernel_inflight, 1);
     return NULL;
 }
+
+/* Copy a request out of the receive buffers and start its thread. */
+static void kernel_dispatch(const kelp_kernel_msg_t *m)
+{
+    kernel_request_t *req = malloc(sizeof(*req) + m->len + 1);
+    pthread_t tid;
+
+    if (!req)
+        return;
+    req->hdr = m->hdr;
+    req->len = m->len;
+    memcpy(req->msg, m->data, m->len + 1);
+
+    atomic_fetch_add(&g_kernel_inflight, 1);
+    if (pthread_create(&tid, NULL, kernel_request_thread, req) == 0) {
+        pthread_detach(tid);
+    } else {
+        KELP_WARN("failed to start kernel request thread");
+        atomic_fetch_sub(&g_kernel_inflight, 1);
+        free(req);
+    }
+}
+
+/*
+ * Read every queued message from the (non-blocking) device and dispatch
+ * it, a batch of them per system call.
+ */
+static void kernel_drain(void)
+{
+    kelp_kernel_msg_t batch[KELP_KERNEL_BATCH_MAX];
+
+    if (g_kernel_efd >= 0) {
+        uint64_t n;
+        ssize_t r = read(g_kernel_efd, &n, sizeof(n));
+        (void)r;
+    }
+
+    for (;;) {
+        int n = kelp_kernel_chan_recv_batch(g_kernel_fd, batch,
+                                            KELP_KERNEL_BATCH_MAX);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                KELP_WARN("/dev/kelp read: %s", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            kernel_dispatch(&batch[i]);
+    }
+}
+
+/*
+ * Add the kernel channel to the event loop: the device itself when the
+ * module supports poll, otherwise an eventfd it signals.
+ */
+static int kernel_watch(int epfd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = g_kernel_fd };
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, g_kernel_fd, &ev) == 0)
+        return 0;
+
+    g_kernel_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_kernel_efd < 0)
+        return -1;
+
+    ev.data.fd = g_kernel_efd;
+    if (kelp_kernel_set_eventfd(g_kernel_fd, g_kernel_efd) != 0 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, g_kernel_efd, &ev) != 0) {
+        close(g_kernel_efd);
+        g_kernel_efd = -1;
+        return -1;
+    }
+    KELP_INFO("kernel channel: device not pollable, using eventfd");
+    return 0;
+}
+
+static void kernel_close(void)
+{
+    /* Let in-flight requests finish sending their responses. */
+    for (int i = 0; i < KERNEL_SEND_TIMEOUT_MS / 10 &&
+                    atomic_load(&g_kernel_inflight) > 0; i++)
+        usleep(10000);
+    if (atomic_load(&g_kernel_inflight) > 0) {
+        KELP_WARN("kernel channel: %d requests still running at shutdown",
+                  atomic_load(&g_kernel_inflight));
+        return;
+    }
+
+    if (g_kernel_efd >= 0) {
+        kelp_kernel_set_eventfd(g_kernel_fd, -1);
+        close(g_kernel_efd);
+        g_kernel_efd = -1;
+    }
+    kelp_kernel_close(g_kernel_fd);
+    g_kernel_fd = -1;
+}
 #endif
 
 /* ---- PID file ----------------------------------------------------------- */
@@ -1767,6 +2222,18 @@ static void event_loop(void)
         epoll_ctl(epfd, EPOLL_CTL_ADD, g_unix_fd, &ev);
     }
 
+    if (g_kernel_fd >= 0) {
+        if (kernel_watch(epfd) == 0) {
+            /* Pick up anything queued before we were watching. */
+            kernel_drain();
+        } else {
+            KELP_WARN("kernel channel: cannot watch /dev/kelp (%s), disabled",
+                      strerror(errno));
+            kelp_kernel_close(g_kernel_fd);
+            g_kernel_fd = -1;
+        }
+    }
+
     while (!g_shutdown) {
         struct epoll_event events[16];
         int nfds = epoll_wait(epfd, events, 16, 500);
@@ -1778,7 +2245,10 @@ static void event_loop(void)
         }
 
         for (int i = 0; i < nfds; i++) {
-            if (events[i].data.fd == g_unix_fd) {
+            if (g_kernel_fd >= 0 && (events[i].data.fd == g_kernel_fd ||
+                                     events[i].data.fd == g_kernel_efd)) {
+                kernel_drain();
+            } else if (events[i].data.fd == g_unix_fd) {
                 /* Accept new Unix socket connection. */
                 struct sockaddr_un peer;
                 socklen_t peer_len = sizeof(peer);
@@ -1894,16 +2364,12 @@ static void shutdown_gateway(void)
 {
     KELP_INFO("shutting down gateway");
 
+    kelp_config_watch_stop();
+
 #ifdef __linux__
-    /* Stop kernel reader thread. */
-    if (g_kernel_thread_running) {
-        pthread_join(g_kernel_thread, NULL);
-        g_kernel_thread_running = false;
-    }
-    if (g_kernel_fd >= 0) {
-        kelp_kernel_close(g_kernel_fd);
-        g_kernel_fd = -1;
-    }
+    /* Close the kernel channel. */
+    if (g_kernel_fd >= 0)
+        kernel_close();
 #endif
 
     /* Stop HTTP server. */
@@ -1935,7 +2401,11 @@ static void shutdown_gateway(void)
     /* Shutdown audit. */
     kelp_audit_shutdown();
 
+    /* Retire the published config. */
+    kelp_config_publish(NULL);
+
     KELP_INFO("gateway shutdown complete");
+    kelp_log_stop_async();
 }
 
 /* ---- Usage -------------------------------------------------------------- */
@@ -1967,6 +2437,7 @@ static void usage(void)
         "  config.get             Get a configuration value\n"
         "  sessions.list          List active sessions\n"
         "  kernel.status          Kernel module statistics (Linux only)\n"
+        "  kernel.flows           Export network flows since last call (Linux only)\n"
         "  desktop.move_cursor    Move AI cursor to (x, y)\n"
         "  desktop.click          Click at (x, y)\n"
         "  desktop.type           Type text into focused panel\n"
@@ -2042,6 +2513,16 @@ int main(int argc, char **argv)
     }
     kelp_config_merge_env(&g_cfg);
 
+    /* Publish the loaded config for request handlers. */
+    {
+        kelp_config_snapshot_t *snap = kelp_config_snapshot_new(&g_cfg);
+        if (!snap) {
+            fprintf(stderr, "kelp-gateway: out of memory\n");
+            return 1;
+        }
+        kelp_config_publish(snap);
+    }
+
     /* Apply config defaults if not overridden by CLI. */
     if (g_cfg.gateway.host && strcmp(g_listen_addr, "127.0.0.1") == 0)
         g_listen_addr = g_cfg.gateway.host;
@@ -2076,17 +2557,6 @@ int main(int argc, char **argv)
     /* Initialize HTTP subsystem (curl). */
     kelp_http_init();
 
-    /* Initialize audit logging. */
-    {
-        char *data_dir = kelp_paths_data_dir();
-        if (data_dir) {
-            char audit_path[512];
-            snprintf(audit_path, sizeof(audit_path), "%s/audit.jsonl", data_dir);
-            kelp_audit_init(audit_path);
-            free(data_dir);
-        }
-    }
-
     /* Ensure directories exist. */
     kelp_paths_ensure_dirs();
 
@@ -2098,6 +2568,33 @@ int main(int argc, char **argv)
         }
     }
 
+    /*
+     * Background threads start only now: they would not survive the fork
+     * in daemonize_process().
+     */
+    if (kelp_log_start_async(0) != 0)
+        KELP_WARN("async logging unavailable, writing synchronously");
+
+    /* Initialize audit logging (asynchronous writer). */
+    {
+        char *data_dir = kelp_paths_data_dir();
+        if (data_dir) {
+            bool segments = g_cfg.security.audit_segments;
+            char audit_path[512];
+            snprintf(audit_path, sizeof(audit_path), "%s/%s", data_dir,
+                     segments ? "audit.seg" : "audit.jsonl");
+            kelp_audit_async_opts_t aopts = {
+                .fsync_policy = KELP_AUDIT_FSYNC_INTERVAL,
+                .rotate_bytes = 64u * 1024 * 1024,
+                .rotate_keep  = 4,
+                .format       = segments ? KELP_AUDIT_FORMAT_SEGMENT
+                                         : KELP_AUDIT_FORMAT_JSONL,
+            };
+            kelp_audit_init_async(audit_path, &aopts);
+            free(data_dir);
+        }
+    }
+
     /* Write PID file. */
     {
         char *runtime_dir = kelp_paths_runtime_dir();
@@ -2134,6 +2631,18 @@ int main(int argc, char **argv)
     KELP_INFO("HTTP: %s:%d", g_listen_addr, g_port);
     KELP_INFO("Unix socket: %s", g_socket_path ? g_socket_path : "(none)");
 
+    /* Hot-reload model and security settings when the config file changes. */
+    {
+        char watch_path[4096];
+        const char *path = config_path;
+        if (!path && kelp_config_default_path(watch_path, sizeof(watch_path)) == 0)
+            path = watch_path;
+        if (path && kelp_config_watch_start(path, on_config_reload, NULL) == 0)
+            KELP_INFO("watching %s for changes", path);
+        else if (path)
+            KELP_WARN("cannot watch %s; config changes need a restart", path);
+    }
+
 #ifdef HAVE_AGENTS
     /* Initialize global provider and tools */
     {
@@ -2192,14 +2701,16 @@ int main(int argc, char **argv)
     if (kelp_kernel_available()) {
         g_kernel_fd = kelp_kernel_open();
         if (g_kernel_fd >= 0) {
-            if (pthread_create(&g_kernel_thread, NULL,
-                               kernel_reader_thread, NULL) == 0) {
-                g_kernel_thread_running = true;
-                KELP_INFO("kernel channel connected (/dev/kelp)");
-            } else {
-                KELP_WARN("failed to create kernel reader thread");
+            /* Served from the event loop, so reads must not block. */
+            int fl = fcntl(g_kernel_fd, F_GETFL);
+            fcntl(g_kernel_fd, F_SETFL, fl | O_NONBLOCK);
+            if (kelp_kernel_chan_setup(g_kernel_fd, KELP_CHAN_SERVER, 0, 0) != 0) {
+                KELP_WARN("kernel channel: cannot serve /dev/kelp (%s)",
+                          strerror(errno));
                 kelp_kernel_close(g_kernel_fd);
                 g_kernel_fd = -1;
+            } else {
+                KELP_INFO("kernel channel connected (/dev/kelp)");
             }
         } else {
             KELP_WARN("kernel module loaded but /dev/kelp not accessible");
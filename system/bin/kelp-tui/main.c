@@ -11,6 +11,7 @@
 #include <kelp/config.h>
 #include <kelp/paths.h>
 #include <kelp/ansi.h>
+#include <kelp/kernel.h>
 
 #include <cjson/cJSON.h>
 
@@ -155,6 +156,8 @@ typedef struct {
     /* Metrics. */
     kelp_metrics_t metrics;
     time_t         metrics_last_update;
+    kelp_kernel_stats_t   *kstats;      /* NULL: parse /proc/kelp */
+    struct kelp_stats_page kpage;
 
     /* Control. */
     bool   running;
@@ -213,13 +216,38 @@ static long parse_proc_value(const char *buf, const char *key)
     return strtol(p, NULL, 10);
 }
 
-static void tui_update_metrics(void)
+/*
+ * Kernel counters from the mmap'd stats page, on every loop iteration:
+ * reading it costs no system call.  Returns true when a counter changed.
+ */
+static bool tui_update_kernel_page(void)
 {
-    time_t now = time(NULL);
-    if (now - g_tui.metrics_last_update < 1)
-        return;
-    g_tui.metrics_last_update = now;
+    kelp_metrics_t *m = &g_tui.metrics;
+    struct kelp_stats_page page;
+
+    if (!g_tui.kstats || kelp_kernel_stats_read(g_tui.kstats, &page) != 0)
+        return false;
+    if (m->available &&
+        memcmp(&page.kstats, &g_tui.kpage.kstats, sizeof(page.kstats)) == 0 &&
+        memcmp(&page.ai, &g_tui.kpage.ai, sizeof(page.ai)) == 0)
+        return false;
+
+    g_tui.kpage = page;
+    m->available = true;
+    m->messages_processed = (long)page.kstats.messages_processed;
+    m->bytes_read = (long)page.kstats.bytes_read;
+    m->bytes_written = (long)page.kstats.bytes_written;
+    m->active_sessions = (int)page.kstats.active_sessions;
+    m->uptime_sec = (long)page.kstats.uptime_seconds;
+    m->queue_depth = (int)page.ai.sched_queue_depth;
+    m->total_submitted = (long)page.ai.sched_total_submitted;
+    m->total_completed = (long)page.ai.sched_total_completed;
+    m->accel_count = (int)page.ai.accel_count;
+    return true;
+}
 
+static void tui_update_kernel_proc(void)
+{
     kelp_metrics_t *m = &g_tui.metrics;
     char buf[2048];
 
@@ -245,6 +273,23 @@ static void tui_update_metrics(void)
     /* Accelerator stats. */
     read_proc_file("/proc/kelp/accelerators", buf, sizeof(buf));
     m->accel_count = (int)parse_proc_value(buf, "count");
+}
+
+static void tui_update_metrics(void)
+{
+    if (tui_update_kernel_page())
+        g_tui.needs_redraw = true;
+
+    time_t now = time(NULL);
+    if (now - g_tui.metrics_last_update < 1)
+        return;
+    g_tui.metrics_last_update = now;
+
+    kelp_metrics_t *m = &g_tui.metrics;
+    char buf[2048];
+
+    if (!g_tui.kstats)
+        tui_update_kernel_proc();
 
     /* System memory. */
     read_proc_file("/proc/meminfo", buf, sizeof(buf));
@@ -715,6 +760,13 @@ static void tui_init(void)
                                            : "claude-sonnet-4-20250514");
 
     memset(&g_tui.metrics, 0, sizeof(g_tui.metrics));
+
+    /* The stats page mapping outlives the descriptor. */
+    int kfd = kelp_kernel_open();
+    if (kfd >= 0) {
+        g_tui.kstats = kelp_kernel_stats_map(kfd);
+        kelp_kernel_close(kfd);
+    }
 }
 
 static void tui_destroy(void)
@@ -734,6 +786,7 @@ static void tui_destroy(void)
     endwin();
 
     if (g_tui.gateway_fd >= 0) close(g_tui.gateway_fd);
+    kelp_kernel_stats_unmap(g_tui.kstats);
 }
 
 /* ---- Resize ------------------------------------------------------------- */
@@ -10,6 +10,7 @@
  *   config    - Configuration management (show, set, get, edit)
  *   daemon    - Daemon management (install, start, stop, status)
  *   kernel    - Kernel module management (status, stats, load, unload)
+ *   audit     - Audit log tools (query, convert, info)
  *   version   - Show version information
  *   help      - Show help
  *
@@ -30,6 +31,7 @@
 #include <kelp/paths.h>
 #include <kelp/ansi.h>
 #include <kelp/kernel.h>
+#include <kelp/audit_segment.h>
 
 #include <errno.h>
 #include <getopt.h>
@@ -82,6 +84,7 @@ static int  cmd_gateway(int argc, char **argv);
 static int  cmd_config(int argc, char **argv);
 static int  cmd_daemon(int argc, char **argv);
 static int  cmd_kernel(int argc, char **argv);
+static int  cmd_audit(int argc, char **argv);
 static int  cmd_version(int argc, char **argv);
 static int  cmd_help(int argc, char **argv);
 
@@ -1492,6 +1495,254 @@ static int cmd_kernel(int argc, char **argv)
     return 1;
 }
 
+/* ---- Subcommand: audit -------------------------------------------------- */
+
+#define AUDIT_MAX_SEGMENTS 64
+
+static const char *audit_level_name(kelp_audit_level_t level)
+{
+    switch (level) {
+    case KELP_AUDIT_INFO:      return "info";
+    case KELP_AUDIT_WARN:      return "warn";
+    case KELP_AUDIT_ALERT:     return "alert";
+    case KELP_AUDIT_VIOLATION: return "violation";
+    default:                   return "unknown";
+    }
+}
+
+typedef struct {
+    bool json;
+    long limit;
+    long printed;
+} audit_print_ctx_t;
+
+static int audit_print_event(const kelp_audit_event_t *ev, void *userdata)
+{
+    audit_print_ctx_t *ctx = userdata;
+
+    char ts[32];
+    struct tm tm;
+    gmtime_r(&ev->timestamp, &tm);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    if (ctx->json) {
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "timestamp", ts);
+        cJSON_AddStringToObject(obj, "level", audit_level_name(ev->level));
+        cJSON_AddStringToObject(obj, "category", ev->category ? ev->category : "");
+        cJSON_AddStringToObject(obj, "action", ev->action ? ev->action : "");
+        cJSON_AddStringToObject(obj, "subject", ev->subject ? ev->subject : "");
+        cJSON_AddStringToObject(obj, "object", ev->object ? ev->object : "");
+        cJSON_AddStringToObject(obj, "detail", ev->detail ? ev->detail : "");
+        cJSON_AddBoolToObject(obj, "allowed", ev->allowed);
+        char *line = cJSON_PrintUnformatted(obj);
+        if (line) {
+            printf("%s\n", line);
+            free(line);
+        }
+        cJSON_Delete(obj);
+    } else {
+        printf("%s  %-9s  %s/%s  %s  %s  %s%s%s\n",
+               ts, audit_level_name(ev->level),
+               ev->category ? ev->category : "-",
+               ev->action ? ev->action : "-",
+               ev->subject ? ev->subject : "-",
+               ev->object ? ev->object : "-",
+               ev->allowed ? "allowed" : "DENIED",
+               ev->detail ? "  " : "",
+               ev->detail ? ev->detail : "");
+    }
+
+    ctx->printed++;
+    return ctx->limit > 0 && ctx->printed >= ctx->limit;
+}
+
+/**
+ * Default segment list: data_dir/audit.seg and its rotations, oldest
+ * first so output is roughly chronological.
+ */
+static int audit_default_segments(char **paths, int max)
+{
+    char *data_dir = kelp_paths_data_dir();
+    if (!data_dir)
+        return 0;
+
+    int n = 0;
+    for (int i = max - 1; i >= 0 && n < max; i--) {
+        char path[4096];
+        if (i == 0)
+            snprintf(path, sizeof(path), "%s/audit.seg", data_dir);
+        else
+            snprintf(path, sizeof(path), "%s/audit.seg.%d", data_dir, i);
+        if (access(path, R_OK) == 0)
+            paths[n++] = strdup(path);
+    }
+
+    free(data_dir);
+    return n;
+}
+
+static int cmd_audit(int argc, char **argv)
+{
+    static const char *usage =
+        "Usage: kelp audit query [--since T] [--until T] [--subject S]\n"
+        "                        [--category C] [--allowed|--denied]\n"
+        "                        [--level L] [--limit N] [--json] [SEGMENT...]\n"
+        "       kelp audit convert <audit.jsonl> <audit.seg>\n"
+        "       kelp audit info <SEGMENT...>\n"
+        "\n"
+        "T is seconds since the epoch or YYYY-MM-DD[THH:MM:SSZ] (UTC).\n"
+        "Without SEGMENT arguments, query reads audit.seg* in the data dir;\n"
+        "the gateway writes them when security.audit_segments is true.\n";
+
+    if (argc < 1) {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+
+    const char *subcmd = argv[0];
+
+    if (strcmp(subcmd, "convert") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+        size_t converted = 0, skipped = 0;
+        if (kelp_audit_jsonl_to_segment(argv[1], argv[2],
+                                        &converted, &skipped) != 0) {
+            fprintf(stderr, "kelp: conversion failed: %s -> %s\n",
+                    argv[1], argv[2]);
+            return 1;
+        }
+        printf("Converted %zu events (%zu lines skipped) into %s\n",
+               converted, skipped, argv[2]);
+        return 0;
+    }
+
+    if (strcmp(subcmd, "info") == 0) {
+        if (argc < 2) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+        int rc = 0;
+        for (int i = 1; i < argc; i++) {
+            kelp_audit_segment_t *seg = kelp_audit_segment_open(argv[i]);
+            if (!seg) {
+                fprintf(stderr, "kelp: %s: not an audit segment\n", argv[i]);
+                rc = 1;
+                continue;
+            }
+            kelp_audit_segment_info_t info;
+            kelp_audit_segment_info(seg, &info);
+            printf("%s\n", argv[i]);
+            printf("  Events:   %llu\n", (unsigned long long)info.events);
+            printf("  Time:     %lld .. %lld\n",
+                   (long long)info.min_time, (long long)info.max_time);
+            printf("  Strings:  %zu\n", info.strings);
+            printf("  Blocks:   %zu\n", info.blocks);
+            printf("  Indexed:  %s\n", info.indexed ? "yes" : "no (unclosed)");
+            kelp_audit_segment_free(seg);
+        }
+        return rc;
+    }
+
+    if (strcmp(subcmd, "query") != 0) {
+        fprintf(stderr, "kelp: unknown audit command '%s'\n", subcmd);
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+
+    kelp_audit_query_t q = { .allowed = -1 };
+    audit_print_ctx_t ctx = { 0 };
+    char *paths[AUDIT_MAX_SEGMENTS];
+    int npaths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+
+        if (strcmp(a, "--since") == 0 || strcmp(a, "--until") == 0) {
+            time_t t;
+            if (!val || kelp_audit_parse_time(val, &t) != 0) {
+                fprintf(stderr, "kelp: %s: invalid time '%s'\n",
+                        a, val ? val : "");
+                goto fail;
+            }
+            if (a[2] == 's')
+                q.since = t;
+            else
+                q.until = t;
+        } else if (strcmp(a, "--subject") == 0 && val) {
+            q.subject = val;
+        } else if (strcmp(a, "--category") == 0 && val) {
+            q.category = val;
+        } else if (strcmp(a, "--level") == 0 && val) {
+            if (strcmp(val, "warn") == 0)           q.min_level = KELP_AUDIT_WARN;
+            else if (strcmp(val, "alert") == 0)     q.min_level = KELP_AUDIT_ALERT;
+            else if (strcmp(val, "violation") == 0) q.min_level = KELP_AUDIT_VIOLATION;
+            else if (strcmp(val, "info") == 0)      q.min_level = KELP_AUDIT_INFO;
+            else {
+                fprintf(stderr, "kelp: --level: unknown level '%s'\n", val);
+                goto fail;
+            }
+        } else if (strcmp(a, "--limit") == 0 && val) {
+            ctx.limit = strtol(val, NULL, 10);
+        } else {
+            takes_value = false;
+            if (strcmp(a, "--allowed") == 0) {
+                q.allowed = 1;
+            } else if (strcmp(a, "--denied") == 0) {
+                q.allowed = 0;
+            } else if (strcmp(a, "--json") == 0) {
+                ctx.json = true;
+            } else if (a[0] == '-') {
+                fprintf(stderr, "kelp: unknown or incomplete option '%s'\n", a);
+                goto fail;
+            } else if (npaths < AUDIT_MAX_SEGMENTS) {
+                paths[npaths++] = strdup(a);
+            }
+        }
+        if (takes_value)
+            i++;
+    }
+
+    if (npaths == 0)
+        npaths = audit_default_segments(paths, AUDIT_MAX_SEGMENTS);
+    if (npaths == 0) {
+        fprintf(stderr, "kelp: no audit segments found (set "
+                "security.audit_segments, or convert audit.jsonl)\n");
+        return 1;
+    }
+
+    int rc = 0;
+    for (int i = 0; i < npaths; i++) {
+        if (ctx.limit > 0 && ctx.printed >= ctx.limit)
+            break;
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(paths[i]);
+        if (!seg) {
+            fprintf(stderr, "kelp: %s: not an audit segment\n", paths[i]);
+            rc = 1;
+            continue;
+        }
+        if (kelp_audit_segment_query(seg, &q, audit_print_event, &ctx) < 0) {
+            fprintf(stderr, "kelp: %s: segment is corrupt\n", paths[i]);
+            rc = 1;
+        }
+        kelp_audit_segment_free(seg);
+    }
+
+    for (int i = 0; i < npaths; i++)
+        free(paths[i]);
+    return rc;
+
+fail:
+    for (int i = 0; i < npaths; i++)
+        free(paths[i]);
+    return 1;
+}
+
 /* ---- Subcommand: version ------------------------------------------------ */
 
 static int cmd_version(int argc, char **argv)
@@ -1545,6 +1796,7 @@ static int cmd_help(int argc, char **argv)
         "  config <show|set|get|edit> Configuration management\n"
         "  daemon <cmd>               Daemon management (install, start, stop, etc.)\n"
         "  kernel <cmd>               Kernel module management (status, stats, load, unload)\n"
+        "  audit <query|convert|info> Search and convert binary audit segments\n"
         "  version                    Show version information\n"
         "  help                       Show this help\n"
         "\n"
@@ -1692,6 +1944,8 @@ int main(int argc, char **argv)
         ret = cmd_daemon(sub_argc, sub_argv);
     } else if (strcmp(command, "kernel") == 0) {
         ret = cmd_kernel(sub_argc, sub_argv);
+    } else if (strcmp(command, "audit") == 0) {
+        ret = cmd_audit(sub_argc, sub_argv);
     } else if (strcmp(command, "version") == 0) {
         ret = cmd_version(sub_argc, sub_argv);
     } else if (strcmp(command, "help") == 0) {
@@ -4,8 +4,9 @@
  *
  * Connects to the Discord Gateway (WebSocket API v10), listens for
  * MESSAGE_CREATE events, forwards user messages to kelp-gateway over
- * a Unix domain socket (JSON-RPC), and posts the assistant response
- * back to the originating Discord channel via the REST API.
+ * a Unix domain socket (JSON-RPC), and streams the assistant response
+ * back to the originating Discord channel via the REST API: posted when
+ * the first text arrives, then grown in place by editing the message.
  *
  * Usage: kelp-channel-discord [options]
  * Options:
@@ -20,7 +21,9 @@
 
 #include <kelp/kelp.h>
 #include <kelp/config.h>
+#include <kelp/gateway.h>
 #include <kelp/http.h>
+#include <kelp/live_reply.h>
 
 #include <cjson/cJSON.h>
 
@@ -40,7 +43,6 @@
 #include <unistd.h>
 
 #include <sys/socket.h>
-#include <sys/un.h>
 
 #include <openssl/bio.h>
 #include <openssl/err.h>
@@ -85,7 +87,9 @@
 
 /* Limits */
 #define WS_MAX_PAYLOAD  (1 * 1024 * 1024)
-#define RPC_BUF_SIZE    65536
+#define DISCORD_MESSAGE_MAX 1990        /* bytes; the limit is 2000 chars */
+#define DISCORD_EDIT_MIN_MS 1000        /* 5 message calls per 5 s/channel */
+#define DISCORD_EDIT_MAX_MS 15000
 #define MAX_BOT_PREFIX  "!"
 
 /* ---- Global state ------------------------------------------------------- */
@@ -93,6 +97,7 @@
 static kelp_config_t        g_cfg;
 static const char           *g_bot_token      = NULL;
 static const char           *g_socket_path    = NULL;
+static kelp_gateway_t       *g_gateway        = NULL;
 static const char           *g_bot_prefix     = "!kelp";
 static int                   g_verbose        = 0;
 static volatile sig_atomic_t g_shutdown       = 0;
@@ -535,151 +540,19 @@ static void heartbeat_stop(void)
     pthread_join(g_heartbeat_tid, NULL);
 }
 
-/* ---- Gateway Unix socket (JSON-RPC to kelp-gateway) -------------------- */
-
-static int gateway_connect_unix(const char *path)
-{
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0) {
-        KELP_ERROR("socket(AF_UNIX): %s", strerror(errno));
-        return -1;
-    }
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
-
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        KELP_ERROR("connect(%s): %s", path, strerror(errno));
-        close(fd);
-        return -1;
-    }
-
-    return fd;
-}
-
-/**
- * Send a chat message to kelp-gateway via JSON-RPC and return the response.
- * Caller must free the returned string.
- */
-static char *gateway_chat(const char *message,
-                           const char *channel_id,
-                           const char *user_id)
-{
-    int fd = gateway_connect_unix(g_socket_path);
-    if (fd < 0)
-        return NULL;
-
-    static volatile int rpc_id = 1;
-
-    cJSON *params = cJSON_CreateObject();
-    cJSON_AddStringToObject(params, "message", message);
-    if (channel_id)
-        cJSON_AddStringToObject(params, "channel_id", channel_id);
-    if (user_id)
-        cJSON_AddStringToObject(params, "user_id", user_id);
-
-    cJSON *req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "jsonrpc", "2.0");
-    cJSON_AddNumberToObject(req, "id", rpc_id++);
-    cJSON_AddStringToObject(req, "method", "chat.send");
-    cJSON_AddItemToObject(req, "params", params);
-
-    char *payload = cJSON_PrintUnformatted(req);
-    cJSON_Delete(req);
-    if (!payload) {
-        close(fd);
-        return NULL;
-    }
-
-    /* Send with newline delimiter */
-    size_t plen = strlen(payload);
-    char *sendbuf = malloc(plen + 2);
-    if (!sendbuf) {
-        free(payload);
-        close(fd);
-        return NULL;
-    }
-    memcpy(sendbuf, payload, plen);
-    sendbuf[plen]     = '\n';
-    sendbuf[plen + 1] = '\0';
-    free(payload);
-
-    ssize_t total = (ssize_t)(plen + 1);
-    ssize_t sent = 0;
-    while (sent < total) {
-        ssize_t n = write(fd, sendbuf + sent, (size_t)(total - sent));
-        if (n <= 0) {
-            free(sendbuf);
-            close(fd);
-            return NULL;
-        }
-        sent += n;
-    }
-    free(sendbuf);
-
-    /* Read response (with 120s timeout for tool-use round trips) */
-    struct timeval tv = { .tv_sec = 120, .tv_usec = 0 };
-    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    kelp_str_t resp = kelp_str_new();
-    char buf[RPC_BUF_SIZE];
-    for (;;) {
-        ssize_t n = read(fd, buf, sizeof(buf) - 1);
-        if (n <= 0)
-            break;
-        buf[n] = '\0';
-        kelp_str_append(&resp, buf, (size_t)n);
-        if (resp.len > 0 && resp.data[resp.len - 1] == '\n')
-            break;
-    }
-    close(fd);
-
-    if (resp.len == 0) {
-        kelp_str_free(&resp);
-        return NULL;
-    }
-    kelp_str_trim(&resp);
-
-    /* Parse JSON-RPC response and extract the content */
-    cJSON *rpc_resp = cJSON_Parse(resp.data);
-    kelp_str_free(&resp);
-    if (!rpc_resp)
-        return NULL;
-
-    const char *content = NULL;
-    cJSON *result = kelp_json_get_object(rpc_resp, "result");
-    if (result) {
-        content = kelp_json_get_string(result, "content");
-    } else {
-        /* Try extracting from error */
-        cJSON *error = kelp_json_get_object(rpc_resp, "error");
-        if (error)
-            content = kelp_json_get_string(error, "message");
-    }
-
-    char *out = content ? strdup(content) : NULL;
-    cJSON_Delete(rpc_resp);
-    return out;
-}
-
 /* ---- Discord REST API --------------------------------------------------- */
 
 /**
- * Send a message to a Discord channel via REST API.
+ * Make a Discord REST call with an optional JSON body.
+ * On success returns 0 and, if `result` is not NULL, the parsed response.
+ * On failure returns -1; if Discord rate-limited the call and
+ * `retry_after_ms` is not NULL, it receives the delay Discord asked for.
  */
-static int discord_send_message(const char *channel_id, const char *content)
+static int discord_rest(const char *method, const char *url,
+                        cJSON *body, cJSON **result, int *retry_after_ms)
 {
-    char url[256];
-    snprintf(url, sizeof(url), "%s/channels/%s/messages",
-             DISCORD_API_BASE, channel_id);
-
-    cJSON *body = cJSON_CreateObject();
-    cJSON_AddStringToObject(body, "content", content);
-    char *body_str = cJSON_PrintUnformatted(body);
-    cJSON_Delete(body);
-    if (!body_str)
+    char *body_str = body ? cJSON_PrintUnformatted(body) : NULL;
+    if (body && !body_str)
         return -1;
 
     kelp_http_header_t *headers = NULL;
@@ -687,15 +560,16 @@ static int discord_send_message(const char *channel_id, const char *content)
     char auth_header[512];
     snprintf(auth_header, sizeof(auth_header), "Bot %s", g_bot_token);
     kelp_http_header_add(&headers, "Authorization", auth_header);
-    kelp_http_header_add(&headers, "Content-Type", "application/json");
+    if (body_str)
+        kelp_http_header_add(&headers, "Content-Type", "application/json");
     kelp_http_header_add(&headers, "User-Agent", "kelp-channel-discord/0.1.0");
 
     kelp_http_request_t req = {
-        .method           = "POST",
+        .method           = method,
         .url              = url,
         .headers          = headers,
         .body             = body_str,
-        .body_len         = strlen(body_str),
+        .body_len         = body_str ? strlen(body_str) : 0,
         .timeout_ms       = 10000,
         .follow_redirects = true,
         .ca_bundle        = NULL
@@ -704,23 +578,38 @@ static int discord_send_message(const char *channel_id, const char *content)
     kelp_http_response_t resp;
     memset(&resp, 0, sizeof(resp));
     int ret = kelp_http_request(&req, &resp);
+    int rc = -1;
 
     if (ret != KELP_OK) {
-        KELP_ERROR("discord REST: HTTP request failed");
+        KELP_ERROR("discord REST: %s failed", method);
+    } else if (resp.status_code == 429) {
+        /* The body's retry_after is in (fractional) seconds */
+        cJSON *err = cJSON_ParseWithLength((const char *)resp.body,
+                                           resp.body_len);
+        cJSON *ra = err ? cJSON_GetObjectItemCaseSensitive(err, "retry_after")
+                        : NULL;
+        int delay_ms = cJSON_IsNumber(ra) ? (int)(ra->valuedouble * 1000) : 0;
+        cJSON_Delete(err);
+        KELP_WARN("discord REST: %s rate limited, retry after %d ms",
+                  method, delay_ms);
+        if (retry_after_ms)
+            *retry_after_ms = delay_ms;
     } else if (resp.status_code < 200 || resp.status_code >= 300) {
-        KELP_ERROR("discord REST: HTTP %d: %.*s",
+        KELP_ERROR("discord REST: %s HTTP %d: %.*s", method,
                     resp.status_code,
                     (int)(resp.body_len > 200 ? 200 : resp.body_len),
                     resp.body);
     } else {
-        KELP_DEBUG("discord REST: message sent to channel %s", channel_id);
+        rc = 0;
+        if (result)
+            *result = cJSON_ParseWithLength((const char *)resp.body,
+                                            resp.body_len);
     }
 
     kelp_http_response_free(&resp);
     kelp_http_header_free(headers);
     free(body_str);
-    return (ret == KELP_OK && resp.status_code >= 200 && resp.status_code < 300)
-               ? 0 : -1;
+    return rc;
 }
 
 /**
@@ -759,6 +648,45 @@ static int discord_send_typing(const char *channel_id)
     return ret;
 }
 
+/* ---- Live replies (kelp_live_reply hooks; userdata is the channel id) --- */
+
+static char *discord_reply_post(void *userdata, const char *text)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "%s/channels/%s/messages",
+             DISCORD_API_BASE, (const char *)userdata);
+
+    cJSON *body = cJSON_CreateObject();
+    cJSON_AddStringToObject(body, "content", text);
+
+    cJSON *result = NULL;
+    discord_rest("POST", url, body, &result, NULL);
+    cJSON_Delete(body);
+
+    const char *id = result ? kelp_json_get_string(result, "id") : NULL;
+    char *msg_id = id ? strdup(id) : NULL;
+    cJSON_Delete(result);
+    if (msg_id)
+        KELP_DEBUG("discord REST: message %s sent to channel %s",
+                   msg_id, (const char *)userdata);
+    return msg_id;
+}
+
+static int discord_reply_edit(void *userdata, const char *id,
+                              const char *text, int *retry_after_ms)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "%s/channels/%s/messages/%s",
+             DISCORD_API_BASE, (const char *)userdata, id);
+
+    cJSON *body = cJSON_CreateObject();
+    cJSON_AddStringToObject(body, "content", text);
+
+    int rc = discord_rest("PATCH", url, body, NULL, retry_after_ms);
+    cJSON_Delete(body);
+    return rc;
+}
+
 /* ---- Async message handling --------------------------------------------- */
 
 typedef struct {
@@ -781,30 +709,33 @@ static void *async_message_handler(void *arg)
     /* Send typing indicator */
     discord_send_typing(ctx->channel_id);
 
-    /* Call gateway (this is the slow part - may take 10-120s with tool use) */
-    char *response = gateway_chat(ctx->message, ctx->channel_id, ctx->author_id);
-
-    if (response && *response) {
-        /* Discord messages have a 2000 char limit; split if needed */
-        size_t resp_len = strlen(response);
-        size_t offset = 0;
-
-        while (offset < resp_len) {
-            size_t chunk_len = resp_len - offset;
-            if (chunk_len > 1990)
-                chunk_len = 1990;
-
-            char saved = response[offset + chunk_len];
-            response[offset + chunk_len] = '\0';
-            discord_send_message(ctx->channel_id, response + offset);
-            response[offset + chunk_len] = saved;
-
-            offset += chunk_len;
-        }
+    /*
+     * Call gateway (this is the slow part - may take 10-120s with tool use).
+     * The reply is posted as soon as text arrives and edited as it grows.
+     */
+    kelp_live_reply_opts_t opts = {
+        .post            = discord_reply_post,
+        .edit            = discord_reply_edit,
+        .userdata        = ctx->channel_id,
+        .max_len         = DISCORD_MESSAGE_MAX,
+        .min_interval_ms = DISCORD_EDIT_MIN_MS,
+        .max_interval_ms = DISCORD_EDIT_MAX_MS,
+    };
+    kelp_live_reply_t *reply = kelp_live_reply_new(&opts);
+    char *response = NULL;
+
+    if (reply) {
+        response = kelp_gateway_chat(g_gateway, ctx->message,
+                                     ctx->channel_id, ctx->author_id,
+                                     kelp_live_reply_feed, reply);
+        if (kelp_live_reply_finish(reply, (response && *response) ? response :
+                "I'm having trouble connecting to the gateway. "
+                "Please try again later.") != 0)
+            KELP_ERROR("channel %s: reply not fully delivered",
+                       ctx->channel_id);
+        kelp_live_reply_free(reply);
     } else {
-        discord_send_message(ctx->channel_id,
-            "I'm having trouble connecting to the gateway. "
-            "Please try again later.");
+        KELP_ERROR("channel %s: out of memory", ctx->channel_id);
     }
 
     free(response);
@@ -1187,6 +1118,12 @@ int main(int argc, char *argv[])
         g_socket_path = "/run/kelp/gateway.sock";
     }
 
+    g_gateway = kelp_gateway_new(g_socket_path);
+    if (!g_gateway) {
+        kelp_config_free(&g_cfg);
+        return 1;
+    }
+
     /* Signal handling */
     signal(SIGINT,  on_signal);
     signal(SIGTERM, on_signal);
@@ -1197,6 +1134,7 @@ int main(int argc, char *argv[])
 
     /* Init TLS */
     if (tls_init() < 0) {
+        kelp_gateway_free(g_gateway);
         kelp_http_cleanup();
         kelp_config_free(&g_cfg);
         return 1;
@@ -1236,7 +1174,8 @@ int main(int argc, char *argv[])
             break;
     }
 
-    /* Cleanup */
+    /* Cleanup.  g_gateway is left to process exit: detached message
+     * handlers may still be waiting on it. */
     tls_cleanup();
     kelp_http_cleanup();
     kelp_config_free(&g_cfg);
@@ -26,6 +26,7 @@
 
 #include <kelp/kelp.h>
 #include <kelp/config.h>
+#include <kelp/gateway.h>
 
 #include <cjson/cJSON.h>
 
@@ -41,7 +42,6 @@
 #include <unistd.h>
 
 #include <sys/socket.h>
-#include <sys/un.h>
 #include <netinet/in.h>
 
 /* ---- Version ------------------------------------------------------------ */
@@ -61,6 +61,7 @@ static const char           *g_account       = NULL;
 static const char           *g_signal_host   = SIGNAL_CLI_HOST;
 static int                   g_signal_port   = SIGNAL_CLI_PORT;
 static const char           *g_socket_path   = NULL;
+static kelp_gateway_t       *g_gateway       = NULL;
 static int                   g_verbose       = 0;
 static volatile sig_atomic_t g_shutdown      = 0;
 
@@ -177,106 +178,6 @@ static int signal_send_message(const char *recipient, const char *text)
     return ret;
 }
 
-/* ---- Gateway Unix socket (JSON-RPC) ------------------------------------- */
-
-static char *gateway_chat(const char *message, const char *channel_id,
-                          const char *user_id)
-{
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0)
-        return NULL;
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", g_socket_path);
-
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        close(fd);
-        return NULL;
-    }
-
-    static int rpc_id = 1;
-
-    cJSON *params = cJSON_CreateObject();
-    cJSON_AddStringToObject(params, "message", message);
-    if (channel_id)
-        cJSON_AddStringToObject(params, "channel_id", channel_id);
-    if (user_id)
-        cJSON_AddStringToObject(params, "user_id", user_id);
-
-    cJSON *req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "jsonrpc", "2.0");
-    cJSON_AddNumberToObject(req, "id", rpc_id++);
-    cJSON_AddStringToObject(req, "method", "chat.send");
-    cJSON_AddItemToObject(req, "params", params);
-
-    char *payload = cJSON_PrintUnformatted(req);
-    cJSON_Delete(req);
-    if (!payload) {
-        close(fd);
-        return NULL;
-    }
-
-    size_t plen = strlen(payload);
-    char *sendbuf = malloc(plen + 2);
-    if (!sendbuf) {
-        free(payload);
-        close(fd);
-        return NULL;
-    }
-    memcpy(sendbuf, payload, plen);
-    sendbuf[plen]     = '\n';
-    sendbuf[plen + 1] = '\0';
-    free(payload);
-
-    ssize_t total = (ssize_t)(plen + 1);
-    ssize_t sent = 0;
-    while (sent < total) {
-        ssize_t n = write(fd, sendbuf + sent, (size_t)(total - sent));
-        if (n <= 0) {
-            free(sendbuf);
-            close(fd);
-            return NULL;
-        }
-        sent += n;
-    }
-    free(sendbuf);
-
-    kelp_str_t resp = kelp_str_new();
-    char buf[RPC_BUF_SIZE];
-    for (;;) {
-        ssize_t n = read(fd, buf, sizeof(buf) - 1);
-        if (n <= 0)
-            break;
-        buf[n] = '\0';
-        kelp_str_append(&resp, buf, (size_t)n);
-        if (resp.len > 0 && resp.data[resp.len - 1] == '\n')
-            break;
-    }
-    close(fd);
-
-    if (resp.len == 0) {
-        kelp_str_free(&resp);
-        return NULL;
-    }
-    kelp_str_trim(&resp);
-
-    cJSON *rpc_resp = cJSON_Parse(resp.data);
-    kelp_str_free(&resp);
-    if (!rpc_resp)
-        return NULL;
-
-    const char *content = NULL;
-    cJSON *result = kelp_json_get_object(rpc_resp, "result");
-    if (result)
-        content = kelp_json_get_string(result, "content");
-
-    char *out = content ? strdup(content) : NULL;
-    cJSON_Delete(rpc_resp);
-    return out;
-}
-
 /* ---- Message handling --------------------------------------------------- */
 
 static void handle_signal_message(cJSON *msg)
@@ -331,7 +232,8 @@ static void handle_signal_message(cJSON *msg)
                text, strlen(text) > 80 ? "..." : "");
 
     /* Forward to gateway */
-    char *response = gateway_chat(text, reply_to, source);
+    char *response = kelp_gateway_chat(g_gateway, text, reply_to, source,
+                                       NULL, NULL);
 
     if (response && *response) {
         signal_send_message(reply_to, response);
@@ -521,6 +423,12 @@ int main(int argc, char *argv[])
     if (!g_socket_path)
         g_socket_path = "/run/kelp/gateway.sock";
 
+    g_gateway = kelp_gateway_new(g_socket_path);
+    if (!g_gateway) {
+        kelp_config_free(&g_cfg);
+        return 1;
+    }
+
     /* Signal handling */
     signal(SIGINT,  on_signal_handler);
     signal(SIGTERM, on_signal_handler);
@@ -560,6 +468,7 @@ int main(int argc, char *argv[])
     /* Cleanup */
     if (g_signal_fd >= 0)
         close(g_signal_fd);
+    kelp_gateway_free(g_gateway);
     kelp_config_free(&g_cfg);
 
     KELP_INFO("kelp-channel-signal exited cleanly");
@@ -4,8 +4,10 @@
  *
  * Connects to Slack via Socket Mode (WebSocket) for receiving events and
  * uses the Slack Web API for sending messages.  Forwards user messages to
- * kelp-gateway over a Unix domain socket (JSON-RPC), and posts the
- * assistant response back to the originating Slack channel.
+ * kelp-gateway over a Unix domain socket (JSON-RPC), and streams the
+ * assistant response back to the originating Slack channel: posted with
+ * chat.postMessage when the first text arrives, then grown in place with
+ * chat.update.
  *
  * Usage: kelp-channel-slack [options]
  * Options:
@@ -21,7 +23,9 @@
 
 #include <kelp/kelp.h>
 #include <kelp/config.h>
+#include <kelp/gateway.h>
 #include <kelp/http.h>
+#include <kelp/live_reply.h>
 
 #include <cjson/cJSON.h>
 
@@ -38,7 +42,6 @@
 #include <unistd.h>
 
 #include <sys/socket.h>
-#include <sys/un.h>
 
 #include <openssl/bio.h>
 #include <openssl/ssl.h>
@@ -51,7 +54,9 @@
 
 #define SLACK_API_BASE      "https://slack.com/api"
 #define SLACK_WS_PORT       443
-#define RPC_BUF_SIZE        65536
+#define SLACK_MESSAGE_MAX   3900    /* bytes; Slack advises 4000 chars */
+#define SLACK_EDIT_MIN_MS   1200    /* chat.update is Tier 3, ~50/min */
+#define SLACK_EDIT_MAX_MS   20000
 
 /* WebSocket frame opcodes */
 #define WS_OP_TEXT      0x1
@@ -67,6 +72,7 @@ static kelp_config_t        g_cfg;
 static const char           *g_app_token    = NULL;
 static const char           *g_bot_token    = NULL;
 static const char           *g_socket_path  = NULL;
+static kelp_gateway_t       *g_gateway      = NULL;
 static int                   g_verbose      = 0;
 static volatile sig_atomic_t g_shutdown     = 0;
 static char                  g_bot_user_id[64] = {0};
@@ -349,108 +355,15 @@ static int ws_handshake(const char *host, const char *path)
     return 0;
 }
 
-/* ---- Gateway Unix socket (JSON-RPC) ------------------------------------- */
-
-static char *gateway_chat(const char *message, const char *channel_id, const char *user_id)
-{
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0)
-        return NULL;
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", g_socket_path);
-
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        close(fd);
-        return NULL;
-    }
-
-    static int rpc_id = 1;
-
-    cJSON *params = cJSON_CreateObject();
-    cJSON_AddStringToObject(params, "message", message);
-    if (channel_id)
-        cJSON_AddStringToObject(params, "channel_id", channel_id);
-    if (user_id)
-        cJSON_AddStringToObject(params, "user_id", user_id);
-
-    cJSON *req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "jsonrpc", "2.0");
-    cJSON_AddNumberToObject(req, "id", rpc_id++);
-    cJSON_AddStringToObject(req, "method", "chat.send");
-    cJSON_AddItemToObject(req, "params", params);
-
-    char *payload = cJSON_PrintUnformatted(req);
-    cJSON_Delete(req);
-    if (!payload) {
-        close(fd);
-        return NULL;
-    }
-
-    size_t plen = strlen(payload);
-    char *sendbuf = malloc(plen + 2);
-    if (!sendbuf) {
-        free(payload);
-        close(fd);
-        return NULL;
-    }
-    memcpy(sendbuf, payload, plen);
-    sendbuf[plen]     = '\n';
-    sendbuf[plen + 1] = '\0';
-    free(payload);
-
-    ssize_t total = (ssize_t)(plen + 1);
-    ssize_t sent = 0;
-    while (sent < total) {
-        ssize_t n = write(fd, sendbuf + sent, (size_t)(total - sent));
-        if (n <= 0) {
-            free(sendbuf);
-            close(fd);
-            return NULL;
-        }
-        sent += n;
-    }
-    free(sendbuf);
-
-    kelp_str_t resp = kelp_str_new();
-    char buf[RPC_BUF_SIZE];
-    for (;;) {
-        ssize_t n = read(fd, buf, sizeof(buf) - 1);
-        if (n <= 0)
-            break;
-        buf[n] = '\0';
-        kelp_str_append(&resp, buf, (size_t)n);
-        if (resp.len > 0 && resp.data[resp.len - 1] == '\n')
-            break;
-    }
-    close(fd);
-
-    if (resp.len == 0) {
-        kelp_str_free(&resp);
-        return NULL;
-    }
-    kelp_str_trim(&resp);
-
-    cJSON *rpc_resp = cJSON_Parse(resp.data);
-    kelp_str_free(&resp);
-    if (!rpc_resp)
-        return NULL;
-
-    const char *content = NULL;
-    cJSON *result = kelp_json_get_object(rpc_resp, "result");
-    if (result)
-        content = kelp_json_get_string(result, "content");
-
-    char *out = content ? strdup(content) : NULL;
-    cJSON_Delete(rpc_resp);
-    return out;
-}
-
 /* ---- Slack Web API ------------------------------------------------------ */
 
-static cJSON *slack_api_call(const char *method, cJSON *body)
+/**
+ * Call a Slack Web API method.  Returns the parsed response, or NULL on
+ * error; if Slack rate-limited the call and `retry_after_ms` is not NULL,
+ * it receives the Retry-After delay.
+ */
+static cJSON *slack_api_request(const char *method, cJSON *body,
+                                int *retry_after_ms)
 {
     char url[256];
     snprintf(url, sizeof(url), "%s/%s", SLACK_API_BASE, method);
@@ -492,6 +405,17 @@ static cJSON *slack_api_call(const char *method, cJSON *body)
         return NULL;
     }
 
+    if (resp.status_code == 429) {
+        const char *ra = kelp_http_header_get(resp.headers, "Retry-After");
+        int delay_ms = ra ? atoi(ra) * 1000 : 0;
+        KELP_WARN("slack_api_call(%s): rate limited, retry after %d ms",
+                  method, delay_ms);
+        if (retry_after_ms)
+            *retry_after_ms = delay_ms;
+        kelp_http_response_free(&resp);
+        return NULL;
+    }
+
     cJSON *root = cJSON_ParseWithLength((const char *)resp.body, resp.body_len);
     kelp_http_response_free(&resp);
 
@@ -509,15 +433,39 @@ static cJSON *slack_api_call(const char *method, cJSON *body)
     return root;
 }
 
-static int slack_send_message(const char *channel, const char *text)
+static cJSON *slack_api_call(const char *method, cJSON *body)
+{
+    return slack_api_request(method, body, NULL);
+}
+
+/* ---- Live replies (kelp_live_reply hooks; userdata is the channel) ------ */
+
+static char *slack_reply_post(void *userdata, const char *text)
 {
     cJSON *body = cJSON_CreateObject();
-    cJSON_AddStringToObject(body, "channel", channel);
+    cJSON_AddStringToObject(body, "channel", (const char *)userdata);
     cJSON_AddStringToObject(body, "text", text);
 
     cJSON *result = slack_api_call("chat.postMessage", body);
     cJSON_Delete(body);
 
+    const char *ts = result ? kelp_json_get_string(result, "ts") : NULL;
+    char *id = ts ? strdup(ts) : NULL;
+    cJSON_Delete(result);
+    return id;
+}
+
+static int slack_reply_edit(void *userdata, const char *id, const char *text,
+                            int *retry_after_ms)
+{
+    cJSON *body = cJSON_CreateObject();
+    cJSON_AddStringToObject(body, "channel", (const char *)userdata);
+    cJSON_AddStringToObject(body, "ts", id);
+    cJSON_AddStringToObject(body, "text", text);
+
+    cJSON *result = slack_api_request("chat.update", body, retry_after_ms);
+    cJSON_Delete(body);
+
     if (result) {
         cJSON_Delete(result);
         return 0;
@@ -525,6 +473,36 @@ static int slack_send_message(const char *channel, const char *text)
     return -1;
 }
 
+/* Forward `msg` to the gateway and stream the answer into `channel`. */
+static void slack_reply(const char *channel, const char *user,
+                        const char *msg)
+{
+    kelp_live_reply_opts_t opts = {
+        .post            = slack_reply_post,
+        .edit            = slack_reply_edit,
+        .userdata        = (void *)channel,
+        .max_len         = SLACK_MESSAGE_MAX,
+        .min_interval_ms = SLACK_EDIT_MIN_MS,
+        .max_interval_ms = SLACK_EDIT_MAX_MS,
+    };
+    kelp_live_reply_t *reply = kelp_live_reply_new(&opts);
+    if (!reply) {
+        KELP_ERROR("channel %s: out of memory", channel);
+        return;
+    }
+
+    char *response = kelp_gateway_chat(g_gateway, msg, channel, user,
+                                       kelp_live_reply_feed, reply);
+
+    if (kelp_live_reply_finish(reply, (response && *response) ? response :
+            "I'm having trouble connecting to the gateway. "
+            "Please try again later.") != 0)
+        KELP_ERROR("channel %s: reply not fully delivered", channel);
+
+    kelp_live_reply_free(reply);
+    free(response);
+}
+
 /* ---- Slack Socket Mode -------------------------------------------------- */
 
 /**
@@ -712,17 +690,8 @@ static void handle_slack_event(cJSON *envelope)
             KELP_INFO("message from %s in %s: %.80s%s",
                        user, channel, p, strlen(p) > 80 ? "..." : "");
 
-            char *response = gateway_chat(p, channel, user);
+            slack_reply(channel, user, p);
             free(cleaned);
-
-            if (response && *response) {
-                slack_send_message(channel, response);
-            } else {
-                slack_send_message(channel,
-                    "I'm having trouble connecting to the gateway. "
-                    "Please try again later.");
-            }
-            free(response);
             return;
         }
     }
@@ -730,16 +699,7 @@ static void handle_slack_event(cJSON *envelope)
     KELP_INFO("message from %s in %s: %.80s%s",
                user, channel, msg, strlen(msg) > 80 ? "..." : "");
 
-    char *response = gateway_chat(msg, channel, user);
-
-    if (response && *response) {
-        slack_send_message(channel, response);
-    } else {
-        slack_send_message(channel,
-            "I'm having trouble connecting to the gateway. "
-            "Please try again later.");
-    }
-    free(response);
+    slack_reply(channel, user, msg);
 }
 
 /* ---- Socket Mode receive loop ------------------------------------------- */
@@ -877,6 +837,12 @@ int main(int argc, char *argv[])
     if (!g_socket_path)
         g_socket_path = "/run/kelp/gateway.sock";
 
+    g_gateway = kelp_gateway_new(g_socket_path);
+    if (!g_gateway) {
+        kelp_config_free(&g_cfg);
+        return 1;
+    }
+
     /* Signal handling */
     signal(SIGINT,  on_signal);
     signal(SIGTERM, on_signal);
@@ -899,6 +865,7 @@ int main(int argc, char *argv[])
         cJSON_Delete(auth);
     } else {
         KELP_ERROR("auth.test failed - check your bot token");
+        kelp_gateway_free(g_gateway);
         kelp_http_cleanup();
         kelp_config_free(&g_cfg);
         return 1;
@@ -970,6 +937,7 @@ int main(int argc, char *argv[])
 
     /* Cleanup */
     tls_cleanup();
+    kelp_gateway_free(g_gateway);
     kelp_http_cleanup();
     kelp_config_free(&g_cfg);
 
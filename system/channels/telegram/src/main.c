@@ -4,13 +4,23 @@
  *
  * Connects to the Telegram Bot API via HTTP long-polling (getUpdates),
  * forwards user messages to kelp-gateway over a Unix domain socket
- * (JSON-RPC), and posts the assistant response back via sendMessage.
+ * (JSON-RPC), and streams the assistant response back: the first text is
+ * posted with sendMessage as soon as it arrives, and the message then
+ * grows in place through editMessageText.
+ *
+ * The polling thread only queues updates, one queue per chat, and goes
+ * straight back to getUpdates.  A pool of workers drains the queues: a
+ * chat's messages are answered in order, different chats in parallel.
+ * On SIGINT/SIGTERM polling stops and the queued updates are still
+ * answered, within a bounded time, before the bridge exits.
  *
  * Usage: kelp-channel-telegram [options]
  * Options:
  *   -c, --config <path>   Config file
  *   -t, --token <token>   Bot token (overrides $TELEGRAM_BOT_TOKEN)
  *   -s, --socket <path>   Gateway Unix socket path
+ *   -w, --workers <n>     Concurrent conversations (default 8)
+ *   -a, --api-base <url>  Bot API base URL (overrides $TELEGRAM_API_BASE)
  *   -v, --verbose         Increase verbosity
  *   -h, --help            Help
  *
@@ -19,22 +29,23 @@
 
 #include <kelp/kelp.h>
 #include <kelp/config.h>
+#include <kelp/gateway.h>
 #include <kelp/http.h>
+#include <kelp/live_reply.h>
 
 #include <cjson/cJSON.h>
 
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-#include <sys/socket.h>
-#include <sys/un.h>
-
 /* ---- Version ------------------------------------------------------------ */
 
 #define TELEGRAM_CHANNEL_VERSION "0.1.0"
@@ -43,14 +54,28 @@
 
 #define TELEGRAM_API_BASE "https://api.telegram.org/bot"
 #define POLL_TIMEOUT_SEC  30
-#define RPC_BUF_SIZE      65536
+#define TG_MESSAGE_MAX    4000      /* bytes; the limit is 4096 UTF-16 units */
+#define TG_EDIT_MIN_MS    1000      /* about one message per second per chat */
+#define TG_EDIT_MAX_MS    15000
+
+/* ---- Update dispatch ---------------------------------------------------- */
+
+#define WORKERS_DEFAULT   8
+#define WORKERS_MAX       64
+#define QUEUE_MAX         256       /* queued updates before polling pauses */
+#define DRAIN_TIMEOUT_SEC 30        /* answering the queue on shutdown */
+#define BACKOFF_BASE_MS   500       /* first retry after a failed poll */
+#define BACKOFF_MAX_MS    60000
 
 /* ---- Global state ------------------------------------------------------- */
 
 static kelp_config_t        g_cfg;
 static const char           *g_bot_token    = NULL;
+static const char           *g_api_base     = NULL;
 static const char           *g_socket_path  = NULL;
+static kelp_gateway_t       *g_gateway      = NULL;
 static int                   g_verbose      = 0;
+static int                   g_workers      = WORKERS_DEFAULT;
 static volatile sig_atomic_t g_shutdown     = 0;
 static int64_t               g_update_offset = 0;
 static char                  g_bot_username[128] = {0};
@@ -67,21 +92,43 @@ static void on_signal(int signo)
 
 static char *tg_api_url(const char *method)
 {
-    size_t len = strlen(TELEGRAM_API_BASE) + strlen(g_bot_token) +
+    size_t len = strlen(g_api_base) + strlen(g_bot_token) +
                  1 + strlen(method) + 1;
     char *url = malloc(len);
     if (url)
-        snprintf(url, len, "%s%s/%s", TELEGRAM_API_BASE, g_bot_token, method);
+        snprintf(url, len, "%s%s/%s", g_api_base, g_bot_token, method);
     return url;
 }
 
+/* Telegram ids can exceed 32 bits (supergroups are -100xxxxxxxxxx). */
+static int64_t tg_get_id(const cJSON *obj, const char *key)
+{
+    const cJSON *item = obj ? cJSON_GetObjectItemCaseSensitive(obj, key)
+                            : NULL;
+    return cJSON_IsNumber(item) ? (int64_t)item->valuedouble : 0;
+}
+
+/* Why a Bot API call failed; error_code is 0 if Telegram never answered. */
+typedef struct {
+    int  error_code;
+    int  retry_after_ms;        /* set with error_code 429 */
+    char description[128];
+} tg_error_t;
+
 /**
  * Make a Telegram Bot API call with a JSON body.
- * Returns the parsed "result" field from the response, or NULL on error.
+ * Returns the parsed "result" field from the response, or NULL on error
+ * with the reason in `*err` (if not NULL).
  * Caller must cJSON_Delete the returned object.
  */
-static cJSON *tg_api_call(const char *method, cJSON *params)
+static cJSON *tg_api_request(const char *method, cJSON *params,
+                             tg_error_t *err)
 {
+    tg_error_t dummy;
+    if (!err)
+        err = &dummy;
+    memset(err, 0, sizeof(*err));
+
     char *url = tg_api_url(method);
     if (!url)
         return NULL;
@@ -119,24 +166,34 @@ static cJSON *tg_api_call(const char *method, cJSON *params)
         return NULL;
     }
 
-    if (resp.status_code < 200 || resp.status_code >= 300) {
-        KELP_ERROR("tg_api_call(%s): HTTP %d", method, resp.status_code);
-        kelp_http_response_free(&resp);
-        return NULL;
-    }
-
+    /* Errors carry a JSON body too; a 429 says how long to back off. */
+    int status = resp.status_code;
     cJSON *root = cJSON_ParseWithLength((const char *)resp.body, resp.body_len);
     kelp_http_response_free(&resp);
 
     if (!root) {
-        KELP_ERROR("tg_api_call(%s): invalid JSON response", method);
+        KELP_ERROR("tg_api_call(%s): HTTP %d, invalid JSON response",
+                   method, status);
+        err->error_code = status;
         return NULL;
     }
 
     bool ok = kelp_json_get_bool(root, "ok", false);
-    if (!ok) {
+    if (!ok || status < 200 || status >= 300) {
         const char *desc = kelp_json_get_string(root, "description");
-        KELP_ERROR("tg_api_call(%s): error: %s", method, desc ? desc : "?");
+        cJSON *rp = kelp_json_get_object(root, "parameters");
+
+        err->error_code = kelp_json_get_int(root, "error_code", status);
+        err->retry_after_ms = rp ? kelp_json_get_int(rp, "retry_after", 0)
+                                   * 1000 : 0;
+        snprintf(err->description, sizeof(err->description), "%s",
+                 desc ? desc : "?");
+        if (err->error_code == 429)
+            KELP_WARN("tg_api_call(%s): rate limited, retry after %d ms",
+                      method, err->retry_after_ms);
+        else
+            KELP_ERROR("tg_api_call(%s): error %d: %s", method,
+                       err->error_code, err->description);
         cJSON_Delete(root);
         return NULL;
     }
@@ -147,133 +204,58 @@ static cJSON *tg_api_call(const char *method, cJSON *params)
     return result;
 }
 
-/* ---- Gateway Unix socket (JSON-RPC) ------------------------------------- */
-
-static char *gateway_chat(const char *message, const char *channel_id,
-                          const char *user_id)
+static cJSON *tg_api_call(const char *method, cJSON *params)
 {
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0) {
-        KELP_ERROR("socket(AF_UNIX): %s", strerror(errno));
-        return NULL;
-    }
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", g_socket_path);
-
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        KELP_ERROR("connect(%s): %s", g_socket_path, strerror(errno));
-        close(fd);
-        return NULL;
-    }
+    return tg_api_request(method, params, NULL);
+}
 
-    static int rpc_id = 1;
+/* ---- Live replies (kelp_live_reply hooks; userdata is the chat id) ------ */
 
+static char *tg_reply_post(void *userdata, const char *text)
+{
     cJSON *params = cJSON_CreateObject();
-    cJSON_AddStringToObject(params, "message", message);
-    if (channel_id)
-        cJSON_AddStringToObject(params, "channel_id", channel_id);
-    if (user_id)
-        cJSON_AddStringToObject(params, "user_id", user_id);
-
-    cJSON *req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "jsonrpc", "2.0");
-    cJSON_AddNumberToObject(req, "id", rpc_id++);
-    cJSON_AddStringToObject(req, "method", "chat.send");
-    cJSON_AddItemToObject(req, "params", params);
-
-    char *payload = cJSON_PrintUnformatted(req);
-    cJSON_Delete(req);
-    if (!payload) {
-        close(fd);
-        return NULL;
-    }
-
-    size_t plen = strlen(payload);
-    char *sendbuf = malloc(plen + 2);
-    if (!sendbuf) {
-        free(payload);
-        close(fd);
-        return NULL;
-    }
-    memcpy(sendbuf, payload, plen);
-    sendbuf[plen]     = '\n';
-    sendbuf[plen + 1] = '\0';
-    free(payload);
-
-    ssize_t total = (ssize_t)(plen + 1);
-    ssize_t sent = 0;
-    while (sent < total) {
-        ssize_t n = write(fd, sendbuf + sent, (size_t)(total - sent));
-        if (n <= 0) {
-            free(sendbuf);
-            close(fd);
-            return NULL;
-        }
-        sent += n;
-    }
-    free(sendbuf);
-
-    /* Read response */
-    kelp_str_t resp = kelp_str_new();
-    char buf[RPC_BUF_SIZE];
-    for (;;) {
-        ssize_t n = read(fd, buf, sizeof(buf) - 1);
-        if (n <= 0)
-            break;
-        buf[n] = '\0';
-        kelp_str_append(&resp, buf, (size_t)n);
-        if (resp.len > 0 && resp.data[resp.len - 1] == '\n')
-            break;
-    }
-    close(fd);
+    cJSON_AddNumberToObject(params, "chat_id", (double)*(int64_t *)userdata);
+    cJSON_AddStringToObject(params, "text", text);
 
-    if (resp.len == 0) {
-        kelp_str_free(&resp);
-        return NULL;
-    }
-    kelp_str_trim(&resp);
+    cJSON *result = tg_api_call("sendMessage", params);
+    cJSON_Delete(params);
 
-    cJSON *rpc_resp = cJSON_Parse(resp.data);
-    kelp_str_free(&resp);
-    if (!rpc_resp)
+    int64_t message_id = tg_get_id(result, "message_id");
+    cJSON_Delete(result);
+    if (message_id == 0)
         return NULL;
 
-    const char *content = NULL;
-    cJSON *result = kelp_json_get_object(rpc_resp, "result");
-    if (result)
-        content = kelp_json_get_string(result, "content");
-    else {
-        cJSON *error = kelp_json_get_object(rpc_resp, "error");
-        if (error)
-            content = kelp_json_get_string(error, "message");
-    }
-
-    char *out = content ? strdup(content) : NULL;
-    cJSON_Delete(rpc_resp);
-    return out;
+    char id[32];
+    snprintf(id, sizeof(id), "%lld", (long long)message_id);
+    return strdup(id);
 }
 
-/* ---- Telegram message handling ------------------------------------------ */
-
-static int tg_send_message(int64_t chat_id, const char *text)
+static int tg_reply_edit(void *userdata, const char *id, const char *text,
+                         int *retry_after_ms)
 {
     cJSON *params = cJSON_CreateObject();
-    cJSON_AddNumberToObject(params, "chat_id", (double)chat_id);
+    cJSON_AddNumberToObject(params, "chat_id", (double)*(int64_t *)userdata);
+    cJSON_AddNumberToObject(params, "message_id",
+                            (double)strtoll(id, NULL, 10));
     cJSON_AddStringToObject(params, "text", text);
 
-    cJSON *result = tg_api_call("sendMessage", params);
+    tg_error_t err;
+    cJSON *result = tg_api_request("editMessageText", params, &err);
     cJSON_Delete(params);
 
     if (result) {
         cJSON_Delete(result);
         return 0;
     }
+    /* Telegram trims whitespace, so a grown reply can look unchanged. */
+    if (err.error_code == 400 && strstr(err.description, "not modified"))
+        return 0;
+    *retry_after_ms = err.retry_after_ms;
     return -1;
 }
 
+/* ---- Telegram message handling ------------------------------------------ */
+
 static int tg_send_chat_action(int64_t chat_id, const char *action)
 {
     cJSON *params = cJSON_CreateObject();
@@ -290,13 +272,9 @@ static int tg_send_chat_action(int64_t chat_id, const char *action)
     return -1;
 }
 
+/* Answer one update.  Runs on a worker; one at a time per chat. */
 static void handle_update(cJSON *update)
 {
-    /* Track offset for next getUpdates call */
-    int64_t update_id = (int64_t)kelp_json_get_int(update, "update_id", 0);
-    if (update_id >= g_update_offset)
-        g_update_offset = update_id + 1;
-
     cJSON *message = kelp_json_get_object(update, "message");
     if (!message)
         return;
@@ -309,7 +287,7 @@ static void handle_update(cJSON *update)
     if (!chat)
         return;
 
-    int64_t chat_id = (int64_t)kelp_json_get_int(chat, "id", 0);
+    int64_t chat_id = tg_get_id(chat, "id");
     if (chat_id == 0)
         return;
 
@@ -380,49 +358,290 @@ static void handle_update(cJSON *update)
     char user_id_str[32];
     const char *user_id_ptr = NULL;
     if (from) {
-        int64_t from_id = (int64_t)kelp_json_get_int(from, "id", 0);
+        int64_t from_id = tg_get_id(from, "id");
         if (from_id != 0) {
             snprintf(user_id_str, sizeof(user_id_str), "%lld", (long long)from_id);
             user_id_ptr = user_id_str;
         }
     }
 
-    /* Forward to gateway */
-    char *response = gateway_chat(msg, chat_id_str, user_id_ptr);
+    /* Forward to gateway, streaming the reply into the chat as it grows */
+    kelp_live_reply_opts_t opts = {
+        .post            = tg_reply_post,
+        .edit            = tg_reply_edit,
+        .userdata        = &chat_id,
+        .max_len         = TG_MESSAGE_MAX,
+        .min_interval_ms = TG_EDIT_MIN_MS,
+        .max_interval_ms = TG_EDIT_MAX_MS,
+    };
+    kelp_live_reply_t *reply = kelp_live_reply_new(&opts);
+    if (!reply) {
+        KELP_ERROR("chat %lld: out of memory", (long long)chat_id);
+        return;
+    }
 
-    if (response && *response) {
-        /* Telegram has a 4096 char limit per message */
-        size_t resp_len = strlen(response);
-        size_t offset = 0;
+    char *response = kelp_gateway_chat(g_gateway, msg, chat_id_str,
+                                       user_id_ptr, kelp_live_reply_feed,
+                                       reply);
 
-        while (offset < resp_len) {
-            size_t chunk_len = resp_len - offset;
-            if (chunk_len > 4000)
-                chunk_len = 4000;
+    if (kelp_live_reply_finish(reply, (response && *response) ? response :
+            "I'm having trouble connecting to the gateway. "
+            "Please try again later.") != 0)
+        KELP_ERROR("chat %lld: reply not fully delivered", (long long)chat_id);
 
-            char saved = response[offset + chunk_len];
-            response[offset + chunk_len] = '\0';
-            tg_send_message(chat_id, response + offset);
-            response[offset + chunk_len] = saved;
+    kelp_live_reply_free(reply);
+    free(response);
+}
+
+/* ---- Per-chat queues and worker pool ----------------------------------- */
 
-            offset += chunk_len;
+typedef struct tg_job {
+    struct tg_job  *next;
+    cJSON          *update;
+} tg_job_t;
+
+/*
+ * A chat's queued updates.  A chat sits on the ready list while it has
+ * updates and no worker; a worker takes one update at a time, so a chat
+ * is never answered out of order, and puts the chat back at the tail so
+ * a busy chat cannot starve the others.  Idle chats are freed.
+ */
+typedef struct tg_chat {
+    struct tg_chat *next;           /* g_chats */
+    struct tg_chat *ready_next;     /* g_ready_head */
+    int64_t         id;
+    bool            busy;           /* a worker is answering it */
+    tg_job_t       *head;
+    tg_job_t       *tail;
+} tg_chat_t;
+
+static pthread_mutex_t g_queue_lock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_queue_work  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  g_queue_room  = PTHREAD_COND_INITIALIZER;
+static tg_chat_t      *g_chats       = NULL;
+static tg_chat_t      *g_ready_head  = NULL;
+static tg_chat_t      *g_ready_tail  = NULL;
+static int             g_queued      = 0;
+static bool            g_stopping    = false;
+static struct timespec g_drain_until;   /* CLOCK_MONOTONIC, once stopping */
+static pthread_t       g_worker_tids[WORKERS_MAX];
+
+/* Caller holds g_queue_lock. */
+static void ready_push(tg_chat_t *c)
+{
+    c->ready_next = NULL;
+    if (g_ready_tail)
+        g_ready_tail->ready_next = c;
+    else
+        g_ready_head = c;
+    g_ready_tail = c;
+    pthread_cond_signal(&g_queue_work);
+}
+
+/* Queue `update` (ownership passes) behind the chat's earlier ones. */
+static void dispatch_update(int64_t chat_id, cJSON *update)
+{
+    tg_job_t *job = malloc(sizeof(*job));
+    if (!job) {
+        cJSON_Delete(update);
+        return;
+    }
+    job->next   = NULL;
+    job->update = update;
+
+    pthread_mutex_lock(&g_queue_lock);
+    tg_chat_t *c = g_chats;
+    while (c && c->id != chat_id)
+        c = c->next;
+    if (!c) {
+        c = calloc(1, sizeof(*c));
+        if (!c) {
+            pthread_mutex_unlock(&g_queue_lock);
+            cJSON_Delete(update);
+            free(job);
+            return;
         }
-    } else {
-        tg_send_message(chat_id,
-            "I'm having trouble connecting to the gateway. "
-            "Please try again later.");
+        c->id   = chat_id;
+        c->next = g_chats;
+        g_chats = c;
     }
 
-    free(response);
+    bool was_idle = !c->head && !c->busy;
+    if (c->tail)
+        c->tail->next = job;
+    else
+        c->head = job;
+    c->tail = job;
+    g_queued++;
+    if (was_idle)
+        ready_push(c);
+    pthread_mutex_unlock(&g_queue_lock);
+}
+
+/* Caller holds g_queue_lock. */
+static bool drain_expired(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > g_drain_until.tv_sec ||
+           (now.tv_sec == g_drain_until.tv_sec &&
+            now.tv_nsec >= g_drain_until.tv_nsec);
+}
+
+/*
+ * Once stopping, a worker keeps answering until nothing is ready or the
+ * drain deadline has passed; a chat another worker is on goes back on
+ * the ready list when that worker is done with it.
+ */
+static void *worker_thread(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&g_queue_lock);
+    for (;;) {
+        while (!g_ready_head && !g_stopping)
+            pthread_cond_wait(&g_queue_work, &g_queue_lock);
+        if (!g_ready_head || (g_stopping && drain_expired()))
+            break;
+
+        tg_chat_t *c = g_ready_head;
+        g_ready_head = c->ready_next;
+        if (!g_ready_head)
+            g_ready_tail = NULL;
+
+        tg_job_t *job = c->head;
+        c->head = job->next;
+        if (!c->head)
+            c->tail = NULL;
+        c->busy = true;
+        pthread_mutex_unlock(&g_queue_lock);
+
+        handle_update(job->update);
+        cJSON_Delete(job->update);
+        free(job);
+
+        pthread_mutex_lock(&g_queue_lock);
+        c->busy = false;
+        g_queued--;
+        pthread_cond_signal(&g_queue_room);
+        if (c->head) {
+            ready_push(c);
+        } else {
+            tg_chat_t **pp = &g_chats;
+            while (*pp != c)
+                pp = &(*pp)->next;
+            *pp = c->next;
+            free(c);
+        }
+    }
+    pthread_mutex_unlock(&g_queue_lock);
+    return NULL;
+}
+
+static int workers_start(void)
+{
+    for (int i = 0; i < g_workers; i++) {
+        if (pthread_create(&g_worker_tids[i], NULL, worker_thread, NULL) != 0) {
+            KELP_ERROR("failed to start worker %d: %s", i, strerror(errno));
+            g_workers = i;
+            return i > 0 ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The offset has already moved past every queued update, so Telegram will
+ * not hand them out again: answer them first, for up to DRAIN_TIMEOUT_SEC,
+ * and only then drop what is left.
+ */
+static void workers_stop(void)
+{
+    pthread_mutex_lock(&g_queue_lock);
+    if (g_queued > 0)
+        KELP_INFO("answering %d queued update(s) before exiting", g_queued);
+    clock_gettime(CLOCK_MONOTONIC, &g_drain_until);
+    g_drain_until.tv_sec += DRAIN_TIMEOUT_SEC;
+    g_stopping = true;
+    pthread_cond_broadcast(&g_queue_work);
+    pthread_mutex_unlock(&g_queue_lock);
+
+    for (int i = 0; i < g_workers; i++)
+        pthread_join(g_worker_tids[i], NULL);
+
+    if (g_queued > 0)
+        KELP_WARN("dropping %d unanswered update(s) after %ds",
+                  g_queued, DRAIN_TIMEOUT_SEC);
+    while (g_chats) {
+        tg_chat_t *c = g_chats;
+        g_chats = c->next;
+        while (c->head) {
+            tg_job_t *job = c->head;
+            c->head = job->next;
+            cJSON_Delete(job->update);
+            free(job);
+        }
+        free(c);
+    }
+    g_ready_head = g_ready_tail = NULL;
+    g_queued = 0;
+}
+
+/* Hold off polling while the workers are this far behind. */
+static void wait_for_room(void)
+{
+    pthread_mutex_lock(&g_queue_lock);
+    while (g_queued >= QUEUE_MAX && !g_shutdown) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_cond_timedwait(&g_queue_room, &g_queue_lock, &ts);
+    }
+    pthread_mutex_unlock(&g_queue_lock);
 }
 
 /* ---- Long-polling loop -------------------------------------------------- */
 
+/*
+ * Sleep before retry number `failures` (1-based): exponential from
+ * BACKOFF_BASE_MS up to BACKOFF_MAX_MS, with the upper half jittered so
+ * bridges that lost the API together do not retry in lockstep.
+ */
+static void backoff_sleep(int failures)
+{
+    int shift = failures - 1 < 16 ? failures - 1 : 16;
+    long delay = (long)BACKOFF_BASE_MS << shift;
+    if (delay > BACKOFF_MAX_MS)
+        delay = BACKOFF_MAX_MS;
+    delay = delay / 2 + rand() % (delay / 2 + 1);
+
+    KELP_WARN("getUpdates failed (%d in a row), retrying in %ld ms",
+              failures, delay);
+    for (long slept = 0; slept < delay && !g_shutdown; slept += 100) {
+        long step = delay - slept < 100 ? delay - slept : 100;
+        struct timespec ts = { 0, step * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*
+ * Fetch updates and queue them.  The next long-poll goes out as soon as
+ * a batch is queued, while the workers are still answering it; the offset
+ * moves past every update that was fetched, and workers_stop() answers
+ * the queue before the bridge exits.
+ */
 static int poll_loop(void)
 {
-    KELP_INFO("starting long-poll loop (timeout=%ds)", POLL_TIMEOUT_SEC);
+    int failures = 0;
+
+    KELP_INFO("starting long-poll loop (timeout=%ds, %d workers)",
+               POLL_TIMEOUT_SEC, g_workers);
 
     while (!g_shutdown) {
+        wait_for_room();
+        if (g_shutdown)
+            break;
+
         cJSON *params = cJSON_CreateObject();
         cJSON_AddNumberToObject(params, "offset", (double)g_update_offset);
         cJSON_AddNumberToObject(params, "timeout", POLL_TIMEOUT_SEC);
@@ -435,18 +654,28 @@ static int poll_loop(void)
         if (!updates) {
             if (g_shutdown)
                 break;
-            KELP_WARN("getUpdates failed, retrying in 5s...");
-            sleep(5);
+            backoff_sleep(++failures);
             continue;
         }
+        failures = 0;
 
         int count = cJSON_GetArraySize(updates);
         if (count > 0)
             KELP_DEBUG("received %d update(s)", count);
 
-        cJSON *update = NULL;
-        cJSON_ArrayForEach(update, updates) {
-            handle_update(update);
+        cJSON *update;
+        while ((update = cJSON_DetachItemFromArray(updates, 0)) != NULL) {
+            int64_t update_id = tg_get_id(update, "update_id");
+            if (update_id >= g_update_offset)
+                g_update_offset = update_id + 1;
+
+            cJSON *chat = kelp_json_get_object(
+                kelp_json_get_object(update, "message"), "chat");
+            int64_t chat_id = tg_get_id(chat, "id");
+            if (chat_id != 0)
+                dispatch_update(chat_id, update);
+            else
+                cJSON_Delete(update);
         }
 
         cJSON_Delete(updates);
@@ -467,9 +696,11 @@ static void print_usage(void)
         "  -c, --config <path>   Config file\n"
         "  -t, --token <token>   Bot token (or set $TELEGRAM_BOT_TOKEN)\n"
         "  -s, --socket <path>   Gateway Unix socket path\n"
+        "  -w, --workers <n>     Concurrent conversations (default %d)\n"
+        "  -a, --api-base <url>  Bot API base URL (or set $TELEGRAM_API_BASE)\n"
         "  -v, --verbose         Increase verbosity\n"
         "  -h, --help            Help\n",
-        TELEGRAM_CHANNEL_VERSION);
+        TELEGRAM_CHANNEL_VERSION, WORKERS_DEFAULT);
 }
 
 int main(int argc, char *argv[])
@@ -478,6 +709,8 @@ int main(int argc, char *argv[])
         {"config",  required_argument, 0, 'c'},
         {"token",   required_argument, 0, 't'},
         {"socket",  required_argument, 0, 's'},
+        {"workers", required_argument, 0, 'w'},
+        {"api-base", required_argument, 0, 'a'},
         {"verbose", no_argument,       0, 'v'},
         {"help",    no_argument,       0, 'h'},
         {0, 0, 0, 0}
@@ -486,11 +719,13 @@ int main(int argc, char *argv[])
     const char *config_path = NULL;
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "c:t:s:vh", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:t:s:w:a:vh", long_opts, NULL)) != -1) {
         switch (opt) {
         case 'c': config_path   = optarg; break;
         case 't': g_bot_token   = optarg; break;
         case 's': g_socket_path = optarg; break;
+        case 'w': g_workers     = atoi(optarg); break;
+        case 'a': g_api_base    = optarg; break;
         case 'v': g_verbose++;            break;
         case 'h': print_usage(); return 0;
         default:  print_usage(); return 1;
@@ -525,12 +760,29 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /* Resolve Bot API endpoint (a local Bot API server, or a test mock) */
+    if (!g_api_base)
+        g_api_base = getenv("TELEGRAM_API_BASE");
+    if (!g_api_base || *g_api_base == '\0')
+        g_api_base = TELEGRAM_API_BASE;
+
+    if (g_workers < 1)
+        g_workers = 1;
+    if (g_workers > WORKERS_MAX)
+        g_workers = WORKERS_MAX;
+
     /* Resolve gateway socket path */
     if (!g_socket_path)
         g_socket_path = g_cfg.gateway.socket_path;
     if (!g_socket_path)
         g_socket_path = "/run/kelp/gateway.sock";
 
+    g_gateway = kelp_gateway_new(g_socket_path);
+    if (!g_gateway) {
+        kelp_config_free(&g_cfg);
+        return 1;
+    }
+
     /* Signal handling */
     signal(SIGINT,  on_signal);
     signal(SIGTERM, on_signal);
@@ -539,6 +791,8 @@ int main(int argc, char *argv[])
     /* Init HTTP client */
     kelp_http_init();
 
+    srand((unsigned)time(NULL) ^ (unsigned)getpid());
+
     KELP_INFO("kelp-channel-telegram %s starting", TELEGRAM_CHANNEL_VERSION);
     KELP_INFO("gateway socket: %s", g_socket_path);
 
@@ -554,15 +808,24 @@ int main(int argc, char *argv[])
         cJSON_Delete(me);
     } else {
         KELP_ERROR("getMe failed - check your bot token");
+        kelp_gateway_free(g_gateway);
         kelp_http_cleanup();
         kelp_config_free(&g_cfg);
         return 1;
     }
 
     /* Main loop */
+    if (workers_start() != 0) {
+        kelp_gateway_free(g_gateway);
+        kelp_http_cleanup();
+        kelp_config_free(&g_cfg);
+        return 1;
+    }
     poll_loop();
+    workers_stop();
 
     /* Cleanup */
+    kelp_gateway_free(g_gateway);
     kelp_http_cleanup();
     kelp_config_free(&g_cfg);
 
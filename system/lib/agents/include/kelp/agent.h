@@ -72,6 +72,19 @@ void kelp_agent_free(kelp_agent_t *a);
  */
 int kelp_agent_chat(kelp_agent_t *a, const char *user_message, char **response);
 
+/**
+ * Like kelp_agent_chat(), but stream this exchange to `on_stream` instead
+ * of the callback given at creation.  Lets one agent (a session) serve
+ * callers that each want their own partial output.
+ *
+ * @param on_stream        Stream callback, or NULL for a blocking call.
+ * @param stream_userdata  Passed through to `on_stream`.
+ * @return 0 on success, -1 on error.
+ */
+int kelp_agent_chat_stream(kelp_agent_t *a, const char *user_message,
+                            kelp_stream_cb on_stream, void *stream_userdata,
+                            char **response);
+
 /**
  * Reset the agent's conversation history.
  *
@@ -132,6 +132,15 @@ int kelp_agent_set_history(kelp_agent_t *a, const kelp_message_t *msgs)
 /* ---- Agent chat loop ---------------------------------------------------- */
 
 int kelp_agent_chat(kelp_agent_t *a, const char *user_message, char **response)
+{
+    if (!a) return -1;
+    return kelp_agent_chat_stream(a, user_message, a->on_stream,
+                                   a->stream_userdata, response);
+}
+
+int kelp_agent_chat_stream(kelp_agent_t *a, const char *user_message,
+                            kelp_stream_cb on_stream, void *stream_userdata,
+                            char **response)
 {
     if (!a || !user_message || !response) return -1;
 
@@ -163,10 +172,10 @@ int kelp_agent_chat(kelp_agent_t *a, const char *user_message, char **response)
         opts.tools_json    = tools_json;
         opts.temperature   = 0.0f;  /* default: deterministic */
 
-        if (a->on_stream) {
+        if (on_stream) {
             opts.stream          = true;
-            opts.stream_cb       = a->on_stream;
-            opts.stream_userdata = a->stream_userdata;
+            opts.stream_cb       = on_stream;
+            opts.stream_userdata = stream_userdata;
         }
 
         /* Step 2: Call the provider */
@@ -10,6 +10,7 @@
 #include <kelp/str.h>
 #include <kelp/map.h>
 #include <kelp/log.h>
+#include <kelp/schema.h>
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -21,6 +22,7 @@ typedef struct tool_entry {
     char               *name;
     char               *description;
     char               *params_json;
+    kelp_schema_prog_t *params_prog;     /* compiled params_json, or NULL */
     kelp_tool_exec_fn  exec;
     bool                requires_sandbox;
     bool                requires_confirmation;
@@ -136,6 +138,7 @@ static void free_tool_entry(tool_entry_t *entry)
     free(entry->name);
     free(entry->description);
     free(entry->params_json);
+    kelp_schema_prog_free(entry->params_prog);
     free(entry);
 }
 
@@ -186,6 +189,16 @@ int kelp_tool_register(kelp_tool_ctx_t *ctx, const kelp_tool_def_t *def)
         return -1;
     }
 
+    /* Compile the parameter schema once; every call is checked against it. */
+    cJSON *schema = cJSON_Parse(entry->params_json);
+    if (schema) {
+        entry->params_prog = kelp_schema_compile_json(schema);
+        cJSON_Delete(schema);
+    }
+    if (!entry->params_prog)
+        KELP_WARN("tool: '%s' has no usable parameter schema; "
+                  "arguments will not be validated", def->name);
+
     if (kelp_map_set(ctx->tools, entry->name, entry) != 0) {
         free_tool_entry(entry);
         return -1;
@@ -216,9 +229,35 @@ int kelp_tool_execute(kelp_tool_ctx_t *ctx, const char *name,
         return -1;
     }
 
+    /* Streaming providers send an empty string for a tool without input. */
+    if (!args_json || !args_json[0])
+        args_json = "{}";
+
+    if (entry->params_prog) {
+        char err[256];
+        cJSON *args = cJSON_Parse(args_json);
+        bool parsed = args != NULL;
+        int vrc = parsed ? kelp_schema_prog_validate(entry->params_prog, args,
+                                                     err, sizeof(err))
+                         : -1;
+        cJSON_Delete(args);
+        if (vrc != 0) {
+            kelp_str_t msg = kelp_str_new();
+            kelp_str_printf(&msg, "error: invalid arguments for tool '%s': %s",
+                            name, parsed ? err : "not valid JSON");
+            result->output    = msg.data ? strdup(msg.data)
+                                         : strdup("error: invalid arguments");
+            result->is_error  = true;
+            result->exit_code = -1;
+            kelp_str_free(&msg);
+            KELP_DEBUG("tool: rejected call to '%s': %s", name, result->output);
+            return -1;
+        }
+    }
+
     KELP_DEBUG("tool: executing '%s'", name);
 
-    int rc = entry->exec(ctx, args_json ? args_json : "{}", result);
+    int rc = entry->exec(ctx, args_json, result);
     return rc;
 }
 
@@ -7,6 +7,7 @@
 
 #include <kelp/tool.h>
 #include <kelp/http.h>
+#include <kelp/err.h>
 #include <kelp/json.h>
 #include <kelp/str.h>
 #include <kelp/log.h>
@@ -68,11 +69,16 @@ static int web_fetch_exec(kelp_tool_ctx_t *ctx, const char *args_json,
     req.headers = headers;
     req.timeout_ms = timeout_ms;
     req.follow_redirects = true;
+    req.ssrf_protect = true;
 
     kelp_http_response_t resp = {0};
     int rc = kelp_http_request(&req, &resp);
 
-    if (rc != 0) {
+    if (rc == KELP_ERR_INVALID) {
+        result->output   = strdup("error: URL refused (private or blocked address)");
+        result->is_error = true;
+        result->exit_code = 1;
+    } else if (rc != 0) {
         result->output   = strdup("error: HTTP request failed");
         result->is_error = true;
         result->exit_code = 1;
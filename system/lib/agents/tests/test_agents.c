@@ -255,6 +255,56 @@ static void test_tool_execute_not_found(void)
     printf("  PASS: tool_execute not found\n");
 }
 
+static int exec_count;
+
+static int counting_tool_exec(kelp_tool_ctx_t *ctx, const char *args,
+                              kelp_tool_result_t *result)
+{
+    (void)ctx;
+    (void)args;
+    exec_count++;
+    result->output = strdup("ok");
+    return 0;
+}
+
+static void test_tool_execute_validates_args(void)
+{
+    kelp_tool_ctx_t *ctx = kelp_tool_ctx_new("/tmp");
+
+    kelp_tool_def_t def = {
+        .name = "point", .description = "Takes a point",
+        .params_json = "{\"type\":\"object\",\"properties\":{"
+                       "\"x\":{\"type\":\"number\"},"
+                       "\"y\":{\"type\":\"number\"}"
+                       "},\"required\":[\"x\",\"y\"]}",
+        .exec = counting_tool_exec
+    };
+    kelp_tool_register(ctx, &def);
+    exec_count = 0;
+
+    kelp_tool_result_t result = {0};
+    int rc = kelp_tool_execute(ctx, "point", "{\"x\":1,\"y\":2}", &result);
+    assert(rc == 0);
+    assert(exec_count == 1);
+    kelp_tool_result_free(&result);
+
+    /* Missing, mistyped, and malformed arguments never reach the tool. */
+    const char *bad[] = {
+        "{\"x\":1}", "{\"x\":1,\"y\":\"2\"}", "{\"x\":", "[1,2]", "",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        rc = kelp_tool_execute(ctx, "point", bad[i], &result);
+        assert(rc == -1);
+        assert(result.is_error == true);
+        assert(strstr(result.output, "invalid arguments") != NULL);
+        kelp_tool_result_free(&result);
+    }
+    assert(exec_count == 1);
+
+    kelp_tool_ctx_free(ctx);
+    printf("  PASS: tool_execute validates args\n");
+}
+
 static void test_tool_definitions_json(void)
 {
     kelp_tool_ctx_t *ctx = kelp_tool_ctx_new("/tmp");
@@ -505,6 +555,7 @@ int main(void)
     test_tool_execute();
     test_tool_execute_error();
     test_tool_execute_not_found();
+    test_tool_execute_validates_args();
     test_tool_definitions_json();
     test_tool_definitions_empty();
     test_tool_result_free();
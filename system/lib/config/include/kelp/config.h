@@ -64,6 +64,7 @@ typedef struct kelp_config {
         int    sandbox_memory_mb;
         int    sandbox_cpu_cores;
         int    sandbox_max_pids;
+        bool   audit_segments;     /* audit log as binary segments */
         char **allowed_paths;
         int    allowed_paths_count;
     } security;
@@ -82,6 +83,11 @@ typedef struct kelp_config {
  * YAML).  Environment variable substitution (${VAR} / ${VAR:-default}) is
  * performed on every string value.
  *
+ * Parsed files are cached in binary form under kelp_paths_cache_dir() and
+ * reused while their size and timestamps are unchanged; substitution still
+ * runs against the current environment.  Set KELP_CONFIG_CACHE=0 to
+ * always parse.
+ *
  * @param path  Absolute or relative path to the configuration file.
  * @param cfg   Output struct (zeroed first, then populated).
  * @return 0 on success, -1 on error.
@@ -102,6 +108,15 @@ int kelp_config_load(const char *path, kelp_config_t *cfg);
  */
 int kelp_config_load_default(kelp_config_t *cfg);
 
+/**
+ * Find the file kelp_config_load_default() would load.
+ *
+ * @param out      Receives the path.
+ * @param out_len  Size of @p out.
+ * @return 0 if a readable config file exists, -1 otherwise.
+ */
+int kelp_config_default_path(char *out, size_t out_len);
+
 /**
  * Free all heap memory owned by @p cfg and zero the struct.
  */
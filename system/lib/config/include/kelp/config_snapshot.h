@@ -0,0 +1,150 @@
+/*
+ * kelp-linux :: libkelp-config
+ * config_snapshot.h - Immutable config snapshots, lock-free publication,
+ *                     and inotify-driven hot reload
+ *
+ * A snapshot is a frozen, reference-counted deep copy of a kelp_config_t.
+ * One snapshot at a time is "current"; kelp_config_publish() swaps in a new
+ * one with an atomic pointer exchange and retires the old one once every
+ * reader that could still see it has left its read section.
+ *
+ * Readers never take a lock:
+ *
+ *     kelp_config_guard_t g;
+ *     const kelp_config_snapshot_t *snap = kelp_config_read_begin(&g);
+ *     int max = kelp_config_snapshot_get_int(snap, "model.max_tokens", 4096);
+ *     kelp_config_read_end(&g);
+ *
+ * Pointers obtained from a snapshot stay valid until the matching
+ * kelp_config_read_end() (or kelp_config_snapshot_unref() for callers that
+ * hold a reference from kelp_config_current()).
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_CONFIG_SNAPSHOT_H
+#define KELP_CONFIG_SNAPSHOT_H
+
+#include "kelp/config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kelp_config_snapshot kelp_config_snapshot_t;
+
+/* ---- Snapshots ---------------------------------------------------------- */
+
+/**
+ * Freeze a deep copy of @p cfg into a new snapshot (reference count 1).
+ *
+ * @return The snapshot, or NULL on allocation failure.
+ */
+kelp_config_snapshot_t *kelp_config_snapshot_new(const kelp_config_t *cfg);
+
+/** Take an additional reference.  Returns @p snap. */
+kelp_config_snapshot_t *kelp_config_snapshot_ref(kelp_config_snapshot_t *snap);
+
+/** Drop a reference; the snapshot is freed when the last one goes. */
+void kelp_config_snapshot_unref(kelp_config_snapshot_t *snap);
+
+/** The frozen configuration.  Must not be modified or freed. */
+const kelp_config_t *kelp_config_snapshot_config(const kelp_config_snapshot_t *snap);
+
+/**
+ * Publication generation: 0 until published, then 1, 2, ... in publish
+ * order.
+ */
+uint64_t kelp_config_snapshot_generation(const kelp_config_snapshot_t *snap);
+
+/**
+ * Keyed lookups, same keys and semantics as kelp_config_get_*().  A key of
+ * the wrong type returns NULL / @p def.  _get_double() also accepts
+ * "model.temperature".
+ */
+const char *kelp_config_snapshot_get_string(const kelp_config_snapshot_t *snap,
+                                            const char *key);
+int    kelp_config_snapshot_get_int(const kelp_config_snapshot_t *snap,
+                                    const char *key, int def);
+bool   kelp_config_snapshot_get_bool(const kelp_config_snapshot_t *snap,
+                                     const char *key, bool def);
+double kelp_config_snapshot_get_double(const kelp_config_snapshot_t *snap,
+                                       const char *key, double def);
+
+/* ---- Publication -------------------------------------------------------- */
+
+/** Read-side state; lives on the reader's stack. */
+typedef struct kelp_config_guard {
+    const kelp_config_snapshot_t *snap;
+    unsigned                      epoch;
+} kelp_config_guard_t;
+
+/**
+ * Enter a read section and return the current snapshot (NULL if nothing
+ * has been published).  Wait-free apart from a retry when it races a
+ * publish.  Sections may not nest.
+ */
+const kelp_config_snapshot_t *kelp_config_read_begin(kelp_config_guard_t *guard);
+
+/** Leave a read section started by kelp_config_read_begin(). */
+void kelp_config_read_end(kelp_config_guard_t *guard);
+
+/**
+ * Return a new reference to the current snapshot, for callers that need
+ * it beyond a single read section.  NULL if nothing has been published.
+ */
+kelp_config_snapshot_t *kelp_config_current(void);
+
+/**
+ * Make @p snap current, taking ownership of the caller's reference.
+ *
+ * Returns once no reader can still see the previous snapshot, which is
+ * then released.  Publishers are serialised.  Passing NULL retires the
+ * current snapshot (use at shutdown).
+ *
+ * @return 0 on success, -1 if called from inside a read section (the
+ *         caller then keeps its reference).
+ */
+int kelp_config_publish(kelp_config_snapshot_t *snap);
+
+/* ---- Hot reload --------------------------------------------------------- */
+
+/**
+ * Load @p path, apply environment overrides, validate, and publish the
+ * result.  On any failure the current snapshot stays in place.
+ *
+ * @return 0 on success, -1 on load or validation failure.
+ */
+int kelp_config_reload(const char *path);
+
+/**
+ * Called on the watcher thread after each reload attempt.  @p snap is the
+ * newly published snapshot, or NULL if the file failed to load or validate
+ * (the previous snapshot then stays current).
+ */
+typedef void (*kelp_config_reload_cb)(const kelp_config_snapshot_t *snap,
+                                      void *userdata);
+
+/**
+ * Watch @p path (and the profiles/ directory next to it) with inotify and
+ * call kelp_config_reload() whenever it changes.  Bursts of events (editors
+ * writing a temp file and renaming it) are coalesced into one reload.
+ *
+ * Only one watcher runs per process.
+ *
+ * @return 0 on success, -1 on error or if a watcher is already running.
+ */
+int kelp_config_watch_start(const char *path, kelp_config_reload_cb cb,
+                            void *userdata);
+
+/** Stop the watcher thread, if any, and wait for it to exit. */
+void kelp_config_watch_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KELP_CONFIG_SNAPSHOT_H */
@@ -36,6 +36,18 @@ char *kelp_paths_config_dir(void);
  */
 char *kelp_paths_data_dir(void);
 
+/**
+ * Return the cache directory.  Its contents can be deleted at any time.
+ *
+ * Resolution order:
+ *   1. $KELP_CACHE_DIR
+ *   2. $XDG_CACHE_HOME/kelp
+ *   3. ~/.cache/kelp
+ *
+ * @return Newly allocated string.  Caller must free().
+ */
+char *kelp_paths_cache_dir(void);
+
 /**
  * Return the runtime directory.
  *
@@ -53,6 +53,9 @@ typedef struct {
 /**
  * Validate a cJSON object tree against @p schema.
  *
+ * Compiles @p schema for a single use; callers that validate repeatedly
+ * should keep a kelp_schema_prog_t instead.
+ *
  * On success returns 0.  On failure returns -1 and writes a human-readable
  * error description into @p err_buf (up to @p err_len - 1 characters).
  */
@@ -61,6 +64,53 @@ int kelp_schema_validate(const kelp_schema_t *schema,
                            char                 *err_buf,
                            size_t                err_len);
 
+/**
+ * A schema compiled into a flat validation program.
+ *
+ * Compilation resolves every dotted name once into a tree of nodes with
+ * per-node member lookup tables.  Validating a document then walks it a
+ * single time, so the cost follows the size of the document rather than
+ * the number of rules times their path depth.  A program is immutable and
+ * may be shared between threads.
+ */
+typedef struct kelp_schema_prog kelp_schema_prog_t;
+
+/**
+ * Compile @p schema.  The program does not reference @p schema afterwards.
+ *
+ * @return The program, or NULL on allocation failure.
+ */
+kelp_schema_prog_t *kelp_schema_compile(const kelp_schema_t *schema);
+
+/**
+ * Compile a JSON Schema object, as used for tool parameters.
+ *
+ * Understands "type" (string, integer, number, boolean, array, object),
+ * nested "properties", "required", and the minLength/maxLength,
+ * minimum/maximum and minItems/maxItems limits.  A limit applies whenever
+ * it is given, 0 and fractional bounds included, and "integer" accepts
+ * only whole numbers.  Other keywords are ignored, as is "type" when it
+ * is not a single known name.  A root "type": "object" requires the
+ * document itself to be an object.
+ *
+ * @return The program, or NULL if @p json_schema is not an object or on
+ *         allocation failure.
+ */
+kelp_schema_prog_t *kelp_schema_compile_json(const struct cJSON *json_schema);
+
+/**
+ * Validate @p data with a compiled program.  Same result and error text as
+ * kelp_schema_validate() on the source schema; when several rules fail,
+ * the one listed first in the schema is reported.
+ */
+int kelp_schema_prog_validate(const kelp_schema_prog_t *prog,
+                              const struct cJSON       *data,
+                              char                     *err_buf,
+                              size_t                    err_len);
+
+/** Free a compiled program.  NULL is a no-op. */
+void kelp_schema_prog_free(kelp_schema_prog_t *prog);
+
 /**
  * Return the built-in schema that describes the top-level kelp configuration.
  *
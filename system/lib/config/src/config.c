@@ -5,11 +5,13 @@
  * Supports YAML (via libyaml) and JSON (via cJSON) config files.
  * Performs ${ENV_VAR} and ${ENV_VAR:-default} substitution on all strings.
  * Supports profile overlays: profiles/<name>.yaml merged on top of base.
+ * Parsed documents are reused across runs through config_cache.c.
  *
  * SPDX-License-Identifier: MIT
  */
 
 #include "kelp/config.h"
+#include "config_internal.h"
 #include "kelp/paths.h"
 #include "kelp/schema.h"
 
@@ -67,6 +69,17 @@ env_subst(const char *input)
 /* Default values                                                           */
 /* ======================================================================== */
 
+/**
+ * Zero @p cfg and set the defaults that cannot be told apart from "unset"
+ * once a file has been applied (booleans that default to true).
+ */
+static void
+config_init(kelp_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->security.sandbox_enabled = true;
+}
+
 static void
 apply_defaults(kelp_config_t *cfg)
 {
@@ -98,11 +111,8 @@ apply_defaults(kelp_config_t *cfg)
         cfg->model.temperature = 0.7f;
 
     /* security */
-    /* sandbox_enabled defaults to true; we detect "never set" via a
-       separate flag (0 is a valid port), but for booleans we rely on
-       the struct being zeroed and consider false as default. We choose
-       to default to enabled for security. */
-    cfg->security.sandbox_enabled = true;
+    /* sandbox_enabled defaults to true: config_init() sets it before the
+       file is read, so only an explicit "false" turns it off. */
     if (cfg->security.sandbox_memory_mb == 0)
         cfg->security.sandbox_memory_mb = 512;
     if (cfg->security.sandbox_cpu_cores == 0)
@@ -347,6 +357,10 @@ populate_from_json(kelp_config_t *cfg, const cJSON *root)
         v = json_get_int(sec, "sandbox_max_pids", 0);
         if (v > 0) cfg->security.sandbox_max_pids = v;
 
+        const cJSON *as = cJSON_GetObjectItemCaseSensitive(sec, "audit_segments");
+        if (as && cJSON_IsBool(as))
+            cfg->security.audit_segments = cJSON_IsTrue(as);
+
         /* allowed_paths array */
         const cJSON *ap = cJSON_GetObjectItemCaseSensitive(sec, "allowed_paths");
         if (ap && cJSON_IsArray(ap)) {
@@ -457,6 +471,45 @@ parse_file(const char *path, const char *text, size_t len)
     return parse_yaml(text, len);
 }
 
+/**
+ * Load the parsed (unsubstituted) document for @p path, from @p cache when
+ * the file is unchanged since it was cached, otherwise by parsing it.
+ *
+ * Returns NULL if the file is missing or does not parse.  A missing file
+ * is remembered in the cache only when it is @p optional.
+ */
+static cJSON *
+load_doc(config_cache_t *cache, const char *path, bool optional)
+{
+    cJSON *root = NULL;
+
+    switch (config_cache_get(cache, path, &root)) {
+    case CONFIG_CACHE_HIT:    return root;
+    case CONFIG_CACHE_ABSENT: return NULL;
+    case CONFIG_CACHE_MISS:   break;
+    }
+
+    /* Stat before reading: if the file changes in between, the recorded
+     * stat is the older one and the next load simply parses again. */
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        if (optional && errno == ENOENT)
+            config_cache_put(cache, path, NULL, NULL);
+        return NULL;
+    }
+
+    size_t len = 0;
+    char *text = read_file(path, &len);
+    if (!text)
+        return NULL;
+
+    root = parse_file(path, text, len);
+    free(text);
+
+    config_cache_put(cache, path, &st, root);
+    return root;
+}
+
 /* ======================================================================== */
 /* Profile overlay                                                          */
 /* ======================================================================== */
@@ -469,7 +522,8 @@ parse_file(const char *path, const char *text, size_t len)
  * look for /etc/kelp/profiles/dev.yaml.
  */
 static void
-load_profile_overlay(kelp_config_t *cfg, const char *base_path)
+load_profile_overlay(kelp_config_t *cfg, const char *base_path,
+                     config_cache_t *cache)
 {
     if (!cfg->profile || strcmp(cfg->profile, "default") == 0)
         return;
@@ -486,14 +540,8 @@ load_profile_overlay(kelp_config_t *cfg, const char *base_path)
         snprintf(overlay_path, sizeof(overlay_path),
                  "profiles/%s.yaml", cfg->profile);
 
-    size_t len = 0;
-    char *text = read_file(overlay_path, &len);
-    if (!text)
-        return; /* profile file missing is not an error */
-
-    cJSON *root = parse_file(overlay_path, text, len);
-    free(text);
-
+    /* profile file missing is not an error */
+    cJSON *root = load_doc(cache, overlay_path, true);
     if (root) {
         populate_from_json(cfg, root);
         cJSON_Delete(root);
@@ -510,24 +558,22 @@ kelp_config_load(const char *path, kelp_config_t *cfg)
     if (!path || !cfg)
         return -1;
 
-    memset(cfg, 0, sizeof(*cfg));
+    config_init(cfg);
 
-    size_t len = 0;
-    char *text = read_file(path, &len);
-    if (!text)
-        return -1;
+    config_cache_t *cache = config_cache_open(path);
 
-    cJSON *root = parse_file(path, text, len);
-    free(text);
-
-    if (!root)
+    cJSON *root = load_doc(cache, path, false);
+    if (!root) {
+        config_cache_close(cache);
         return -1;
+    }
 
     populate_from_json(cfg, root);
     cJSON_Delete(root);
 
     /* Profile overlay */
-    load_profile_overlay(cfg, path);
+    load_profile_overlay(cfg, path, cache);
+    config_cache_close(cache);
 
     /* Fill in anything the file didn't set */
     apply_defaults(cfg);
@@ -536,13 +582,11 @@ kelp_config_load(const char *path, kelp_config_t *cfg)
 }
 
 int
-kelp_config_load_default(kelp_config_t *cfg)
+kelp_config_default_path(char *out, size_t out_len)
 {
-    if (!cfg)
+    if (!out || out_len == 0)
         return -1;
 
-    memset(cfg, 0, sizeof(*cfg));
-
     /* Build candidate paths */
     const char *candidates[3] = { NULL, NULL, NULL };
     char path_env[4096]  = {0};
@@ -573,13 +617,30 @@ kelp_config_load_default(kelp_config_t *cfg)
         if (!candidates[i])
             continue;
         if (access(candidates[i], R_OK) == 0) {
-            int rc = kelp_config_load(candidates[i], cfg);
-            /* config_load already applied defaults */
-            return rc;
+            if (strlen(candidates[i]) >= out_len)
+                return -1;
+            strcpy(out, candidates[i]);
+            return 0;
         }
     }
 
+    return -1;
+}
+
+int
+kelp_config_load_default(kelp_config_t *cfg)
+{
+    if (!cfg)
+        return -1;
+
+    char path[4096];
+    if (kelp_config_default_path(path, sizeof(path)) == 0) {
+        /* config_load applies defaults */
+        return kelp_config_load(path, cfg);
+    }
+
     /* No file found -- apply defaults only */
+    config_init(cfg);
     apply_defaults(cfg);
     return 0;
 }
@@ -624,27 +685,10 @@ kelp_config_get_string(const kelp_config_t *cfg, const char *key)
     if (!cfg || !key)
         return NULL;
 
-    /* Top-level */
-    if (strcmp(key, "config_dir")  == 0) return cfg->config_dir;
-    if (strcmp(key, "data_dir")    == 0) return cfg->data_dir;
-    if (strcmp(key, "runtime_dir") == 0) return cfg->runtime_dir;
-    if (strcmp(key, "profile")     == 0) return cfg->profile;
-
-    /* gateway.* */
-    if (strcmp(key, "gateway.host")        == 0) return cfg->gateway.host;
-    if (strcmp(key, "gateway.socket_path") == 0) return cfg->gateway.socket_path;
-    if (strcmp(key, "gateway.tls_cert")    == 0) return cfg->gateway.tls_cert;
-    if (strcmp(key, "gateway.tls_key")     == 0) return cfg->gateway.tls_key;
-
-    /* model.* */
-    if (strcmp(key, "model.default_provider") == 0) return cfg->model.default_provider;
-    if (strcmp(key, "model.default_model")    == 0) return cfg->model.default_model;
-    if (strcmp(key, "model.api_key")          == 0) return cfg->model.api_key;
-
-    /* logging.* */
-    if (strcmp(key, "logging.file") == 0) return cfg->logging.file;
-
-    return NULL;
+    const config_key_t *k = config_key_find(key);
+    if (!k || k->type != CONFIG_KEY_STR)
+        return NULL;
+    return *(char *const *)config_key_field(cfg, k);
 }
 
 int
@@ -653,14 +697,10 @@ kelp_config_get_int(const kelp_config_t *cfg, const char *key, int def)
     if (!cfg || !key)
         return def;
 
-    if (strcmp(key, "gateway.port")              == 0) return cfg->gateway.port;
-    if (strcmp(key, "model.max_tokens")          == 0) return cfg->model.max_tokens;
-    if (strcmp(key, "security.sandbox_memory_mb") == 0) return cfg->security.sandbox_memory_mb;
-    if (strcmp(key, "security.sandbox_cpu_cores") == 0) return cfg->security.sandbox_cpu_cores;
-    if (strcmp(key, "security.sandbox_max_pids")  == 0) return cfg->security.sandbox_max_pids;
-    if (strcmp(key, "logging.level")              == 0) return cfg->logging.level;
-
-    return def;
+    const config_key_t *k = config_key_find(key);
+    if (!k || k->type != CONFIG_KEY_INT)
+        return def;
+    return *(const int *)config_key_field(cfg, k);
 }
 
 bool
@@ -669,10 +709,62 @@ kelp_config_get_bool(const kelp_config_t *cfg, const char *key, bool def)
     if (!cfg || !key)
         return def;
 
-    if (strcmp(key, "gateway.tls_enabled")      == 0) return cfg->gateway.tls_enabled;
-    if (strcmp(key, "security.sandbox_enabled")  == 0) return cfg->security.sandbox_enabled;
+    const config_key_t *k = config_key_find(key);
+    if (!k || k->type != CONFIG_KEY_BOOL)
+        return def;
+    return *(const bool *)config_key_field(cfg, k);
+}
 
-    return def;
+/* ======================================================================== */
+/* Copying                                                                  */
+/* ======================================================================== */
+
+int
+config_copy(kelp_config_t *dst, const kelp_config_t *src)
+{
+    *dst = *src;
+
+    /* Re-point every string at a private copy; bail out on the first miss. */
+    char **strs[] = {
+        &dst->config_dir, &dst->data_dir, &dst->runtime_dir, &dst->profile,
+        &dst->gateway.host, &dst->gateway.socket_path,
+        &dst->gateway.tls_cert, &dst->gateway.tls_key,
+        &dst->model.default_provider, &dst->model.default_model,
+        &dst->model.api_key, &dst->model.system_prompt,
+        &dst->logging.file,
+    };
+    size_t nstrs = sizeof(strs) / sizeof(strs[0]);
+
+    for (size_t i = 0; i < nstrs; i++)
+        *strs[i] = NULL;
+    dst->security.allowed_paths       = NULL;
+    dst->security.allowed_paths_count = 0;
+
+    for (size_t i = 0; i < nstrs; i++) {
+        const char *orig = *(char *const *)((const char *)src +
+                                            ((char *)strs[i] - (char *)dst));
+        if (orig && !(*strs[i] = strdup(orig)))
+            goto fail;
+    }
+
+    if (src->security.allowed_paths_count > 0) {
+        dst->security.allowed_paths =
+            calloc((size_t)src->security.allowed_paths_count, sizeof(char *));
+        if (!dst->security.allowed_paths)
+            goto fail;
+        for (int i = 0; i < src->security.allowed_paths_count; i++) {
+            dst->security.allowed_paths_count = i + 1;
+            dst->security.allowed_paths[i] =
+                safe_strdup(src->security.allowed_paths[i]);
+            if (src->security.allowed_paths[i] && !dst->security.allowed_paths[i])
+                goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    kelp_config_free(dst);
+    return -1;
 }
 
 /* ======================================================================== */
@@ -0,0 +1,619 @@
+/*
+ * kelp-linux :: libkelp-config
+ * config_cache.c - Binary cache of parsed config documents
+ *
+ * Parsing YAML through libyaml dominates kelp_config_load(), and every CLI
+ * invocation and channel bridge pays for it at startup.  The cache keeps
+ * the parsed documents (the base file and any profile overlay) in a compact
+ * binary tree, one cache file per source path, and maps it on the next
+ * load instead of parsing.
+ *
+ * What is cached is the document *before* ${ENV} substitution: values are
+ * still resolved against the live environment by populate_from_json(), so
+ * secrets pulled in from the environment never reach the disk, and a
+ * changed variable never serves a stale value.
+ *
+ * A document is reused only while its file's device, inode, size, mtime
+ * and ctime are unchanged.  Files modified within CACHE_RACY_SEC of being
+ * cached are not recorded, since a same-size rewrite inside one mtime tick
+ * would otherwise go unnoticed.  The whole cache is also keyed by the
+ * environment that selects which config file is read (uid, HOME,
+ * KELP_CONFIG_DIR, XDG_CONFIG_HOME) and guarded by a checksum.
+ *
+ * Layout (native byte order; the version changes with the layout):
+ *
+ *   header   magic[8] version:u32 nentries:u32 env_hash:u64
+ *            payload_len:u64 payload_hash:u64
+ *   payload  source:str
+ *            nentries x { path:str present:u8 dev:u64 ino:u64
+ *                         size:u64 mtime_s:i64 mtime_ns:i64 ctime_s:i64
+ *                         ctime_ns:i64 doc_len:u32 doc[] }
+ *
+ *   doc      'n' | 'f' | 't' | 'd' double | 's' str
+ *            | 'a' count:u32 doc... | 'o' count:u32 { key:str doc }...
+ *   str      len:u32 bytes[len] '\0'  (used in place when decoding)
+ *
+ * Setting KELP_CONFIG_CACHE=0 disables the cache.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config_internal.h"
+#include "kelp/paths.h"
+
+#include <kelp/buf.h>
+
+#include <cjson/cJSON.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC      "KCFGCACH"
+#define CACHE_VERSION    1
+#define CACHE_MAX_ENTRIES 4
+#define CACHE_MAX_DEPTH  64
+#define CACHE_RACY_SEC   2
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nentries;
+    uint64_t env_hash;
+    uint64_t payload_len;
+    uint64_t payload_hash;
+} cache_header_t;
+
+typedef struct {
+    uint8_t  present;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_s;
+    int64_t  mtime_ns;
+    int64_t  ctime_s;
+    int64_t  ctime_ns;
+} cache_stat_t;
+
+/* One document, either found in the mapped cache or parsed this time. */
+typedef struct {
+    char         *path;
+    cache_stat_t  st;
+    kelp_buf_t    doc;      /* encoded tree; empty when !st.present */
+    bool          racy;     /* too fresh to trust next time */
+} cache_entry_t;
+
+struct config_cache {
+    char           file[PATH_MAX];
+    char          *source;
+    uint64_t       env_hash;
+
+    const uint8_t *map;     /* validated mapping of the existing cache */
+    size_t         map_len;
+
+    cache_entry_t  entries[CACHE_MAX_ENTRIES];
+    int            nentries;
+    bool           dirty;   /* something was parsed: rewrite on close */
+};
+
+/* ======================================================================== */
+/* Hashing and keys                                                         */
+/* ======================================================================== */
+
+static uint64_t
+fnv64(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#define FNV64_INIT 0xcbf29ce484222325ULL
+
+/** Hash of the environment that decides which config file gets loaded. */
+static uint64_t
+env_hash(void)
+{
+    static const char *const vars[] = {
+        "HOME", "KELP_CONFIG_DIR", "XDG_CONFIG_HOME",
+    };
+    uid_t uid = getuid();
+    uint64_t h = fnv64(FNV64_INIT, &uid, sizeof(uid));
+
+    for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+        const char *v = getenv(vars[i]);
+        h = fnv64(h, vars[i], strlen(vars[i]) + 1);
+        if (v)
+            h = fnv64(h, v, strlen(v) + 1);
+        else
+            h = fnv64(h, "", 0);
+    }
+    return h;
+}
+
+static void
+stat_key(const struct stat *st, cache_stat_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!st)
+        return;
+    out->present  = 1;
+    out->dev      = (uint64_t)st->st_dev;
+    out->ino      = (uint64_t)st->st_ino;
+    out->size     = (uint64_t)st->st_size;
+    out->mtime_s  = (int64_t)st->st_mtim.tv_sec;
+    out->mtime_ns = (int64_t)st->st_mtim.tv_nsec;
+    out->ctime_s  = (int64_t)st->st_ctim.tv_sec;
+    out->ctime_ns = (int64_t)st->st_ctim.tv_nsec;
+}
+
+static bool
+stat_equal(const cache_stat_t *a, const cache_stat_t *b)
+{
+    return a->present == b->present && a->dev == b->dev && a->ino == b->ino &&
+           a->size == b->size &&
+           a->mtime_s == b->mtime_s && a->mtime_ns == b->mtime_ns &&
+           a->ctime_s == b->ctime_s && a->ctime_ns == b->ctime_ns;
+}
+
+/* ======================================================================== */
+/* Document encoding                                                        */
+/* ======================================================================== */
+
+static int
+put_u32(kelp_buf_t *b, uint32_t v)
+{
+    return kelp_buf_write(b, &v, sizeof(v));
+}
+
+/* Strings are stored with their NUL so they can be used in place. */
+static int
+put_str(kelp_buf_t *b, const char *s)
+{
+    size_t len = strlen(s);
+    if (len >= UINT32_MAX || put_u32(b, (uint32_t)len) != 0)
+        return -1;
+    return kelp_buf_write(b, s, len + 1);
+}
+
+static int
+encode_doc(kelp_buf_t *b, const cJSON *item, int depth)
+{
+    char tag;
+
+    if (depth > CACHE_MAX_DEPTH)
+        return -1;
+
+    if (cJSON_IsFalse(item)) {
+        tag = 'f';
+        return kelp_buf_write(b, &tag, 1);
+    }
+    if (cJSON_IsTrue(item)) {
+        tag = 't';
+        return kelp_buf_write(b, &tag, 1);
+    }
+    if (cJSON_IsNumber(item)) {
+        tag = 'd';
+        double v = item->valuedouble;
+        if (kelp_buf_write(b, &tag, 1) != 0)
+            return -1;
+        return kelp_buf_write(b, &v, sizeof(v));
+    }
+    if (cJSON_IsString(item)) {
+        tag = 's';
+        if (kelp_buf_write(b, &tag, 1) != 0)
+            return -1;
+        return put_str(b, item->valuestring);
+    }
+    if (cJSON_IsArray(item) || cJSON_IsObject(item)) {
+        bool obj = cJSON_IsObject(item);
+        tag = obj ? 'o' : 'a';
+        if (kelp_buf_write(b, &tag, 1) != 0 ||
+            put_u32(b, (uint32_t)cJSON_GetArraySize(item)) != 0)
+            return -1;
+        const cJSON *child;
+        cJSON_ArrayForEach(child, item) {
+            if (obj && put_str(b, child->string ? child->string : "") != 0)
+                return -1;
+            if (encode_doc(b, child, depth + 1) != 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    tag = 'n';
+    return kelp_buf_write(b, &tag, 1);
+}
+
+/* Bounds-checked reader over a mapped region. */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} reader_t;
+
+static bool
+get_bytes(reader_t *r, void *out, size_t len)
+{
+    if ((size_t)(r->end - r->p) < len)
+        return false;
+    memcpy(out, r->p, len);
+    r->p += len;
+    return true;
+}
+
+static bool
+get_u32(reader_t *r, uint32_t *v)
+{
+    return get_bytes(r, v, sizeof(*v));
+}
+
+/** Borrow a string written by put_str(), checking its terminator. */
+static bool
+get_str(reader_t *r, const char **s, uint32_t *len)
+{
+    if (!get_u32(r, len) || (size_t)(r->end - r->p) <= *len ||
+        r->p[*len] != '\0')
+        return false;
+    *s = (const char *)r->p;
+    r->p += (size_t)*len + 1;
+    return true;
+}
+
+/** Borrow a length-prefixed blob. */
+static bool
+get_span(reader_t *r, const uint8_t **p, uint32_t *len)
+{
+    if (!get_u32(r, len) || (size_t)(r->end - r->p) < *len)
+        return false;
+    *p = r->p;
+    r->p += *len;
+    return true;
+}
+
+static cJSON *
+decode_doc(reader_t *r, int depth)
+{
+    uint8_t tag;
+    if (depth > CACHE_MAX_DEPTH || !get_bytes(r, &tag, 1))
+        return NULL;
+
+    switch (tag) {
+    case 'n': return cJSON_CreateNull();
+    case 'f': return cJSON_CreateFalse();
+    case 't': return cJSON_CreateTrue();
+    case 'd': {
+        double v;
+        return get_bytes(r, &v, sizeof(v)) ? cJSON_CreateNumber(v) : NULL;
+    }
+    case 's': {
+        const char *s;
+        uint32_t len;
+        return get_str(r, &s, &len) ? cJSON_CreateString(s) : NULL;
+    }
+    case 'a':
+    case 'o': {
+        uint32_t count;
+        if (!get_u32(r, &count))
+            return NULL;
+        cJSON *item = tag == 'o' ? cJSON_CreateObject() : cJSON_CreateArray();
+        if (!item)
+            return NULL;
+        for (uint32_t i = 0; i < count; i++) {
+            const char *key = NULL;
+            uint32_t klen;
+            cJSON *child = NULL;
+            if ((tag == 'a' || get_str(r, &key, &klen)) &&
+                (child = decode_doc(r, depth + 1)) != NULL) {
+                if (key)
+                    cJSON_AddItemToObject(item, key, child);
+                else
+                    cJSON_AddItemToArray(item, child);
+                continue;
+            }
+            cJSON_Delete(item);
+            return NULL;
+        }
+        return item;
+    }
+    default:
+        return NULL;
+    }
+}
+
+/* ======================================================================== */
+/* Opening and validating                                                   */
+/* ======================================================================== */
+
+static bool
+cache_enabled(void)
+{
+    const char *v = getenv("KELP_CONFIG_CACHE");
+    return !(v && strcmp(v, "0") == 0);
+}
+
+/** Map the existing cache file if its header, key and checksum hold. */
+static void
+cache_map(config_cache_t *c)
+{
+    int fd = open(c->file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cache_header_t) ||
+        st.st_uid != getuid()) {
+        close(fd);
+        return;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+
+    cache_header_t h;
+    memcpy(&h, map, sizeof(h));
+    const uint8_t *payload = (const uint8_t *)map + sizeof(h);
+
+    if (memcmp(h.magic, CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != CACHE_VERSION || h.env_hash != c->env_hash ||
+        h.nentries > CACHE_MAX_ENTRIES ||
+        h.payload_len != len - sizeof(h) ||
+        h.payload_hash != fnv64(FNV64_INIT, payload, (size_t)h.payload_len)) {
+        munmap(map, len);
+        return;
+    }
+
+    /* The payload starts with the source path this cache was built for. */
+    reader_t r = { payload, payload + h.payload_len };
+    const char *src;
+    uint32_t slen;
+    if (!get_str(&r, &src, &slen) || strcmp(src, c->source) != 0) {
+        munmap(map, len);
+        return;
+    }
+
+    c->map     = map;
+    c->map_len = len;
+}
+
+config_cache_t *
+config_cache_open(const char *source)
+{
+    if (!source || !cache_enabled())
+        return NULL;
+
+    char *dir = kelp_paths_cache_dir();
+    if (!dir)
+        return NULL;
+
+    config_cache_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        free(dir);
+        return NULL;
+    }
+
+    uint64_t key = fnv64(FNV64_INIT, source, strlen(source));
+    int n = snprintf(c->file, sizeof(c->file), "%s/config-%016llx.bin",
+                     dir, (unsigned long long)key);
+    free(dir);
+    c->source = strdup(source);
+    if (n < 0 || (size_t)n >= sizeof(c->file) || !c->source) {
+        free(c->source);
+        free(c);
+        return NULL;
+    }
+
+    c->env_hash = env_hash();
+    cache_map(c);
+    return c;
+}
+
+/* ======================================================================== */
+/* Lookup and recording                                                     */
+/* ======================================================================== */
+
+static cache_entry_t *
+entry_add(config_cache_t *c, const char *path)
+{
+    if (c->nentries == CACHE_MAX_ENTRIES)
+        return NULL;
+    cache_entry_t *e = &c->entries[c->nentries];
+    memset(e, 0, sizeof(*e));
+    e->path = strdup(path);
+    if (!e->path)
+        return NULL;
+    e->doc = kelp_buf_new(256);
+    c->nentries++;
+    return e;
+}
+
+config_cache_result_t
+config_cache_get(config_cache_t *c, const char *path, cJSON **doc)
+{
+    *doc = NULL;
+    if (!c || !c->map)
+        return CONFIG_CACHE_MISS;
+
+    cache_header_t h;
+    memcpy(&h, c->map, sizeof(h));
+    reader_t r = { c->map + sizeof(h), c->map + c->map_len };
+    const char *s;
+    uint32_t slen;
+    if (!get_str(&r, &s, &slen))
+        return CONFIG_CACHE_MISS;
+
+    for (uint32_t i = 0; i < h.nentries; i++) {
+        cache_stat_t key;
+        const uint8_t *doc_bytes;
+        uint32_t doc_len;
+        if (!get_str(&r, &s, &slen) || !get_bytes(&r, &key.present, 1) ||
+            !get_bytes(&r, &key.dev, sizeof(key.dev)) ||
+            !get_bytes(&r, &key.ino, sizeof(key.ino)) ||
+            !get_bytes(&r, &key.size, sizeof(key.size)) ||
+            !get_bytes(&r, &key.mtime_s, sizeof(key.mtime_s)) ||
+            !get_bytes(&r, &key.mtime_ns, sizeof(key.mtime_ns)) ||
+            !get_bytes(&r, &key.ctime_s, sizeof(key.ctime_s)) ||
+            !get_bytes(&r, &key.ctime_ns, sizeof(key.ctime_ns)) ||
+            !get_span(&r, &doc_bytes, &doc_len))
+            return CONFIG_CACHE_MISS;
+
+        if (strcmp(s, path) != 0)
+            continue;
+
+        struct stat st;
+        cache_stat_t now;
+        stat_key(stat(path, &st) == 0 ? &st : NULL, &now);
+        if (!stat_equal(&key, &now))
+            return CONFIG_CACHE_MISS;
+
+        if (!key.present) {
+            cache_entry_t *e = entry_add(c, path);
+            if (e)
+                e->st = key;
+            return CONFIG_CACHE_ABSENT;
+        }
+
+        reader_t dr = { doc_bytes, doc_bytes + doc_len };
+        *doc = decode_doc(&dr, 0);
+        if (!*doc)
+            return CONFIG_CACHE_MISS;
+
+        /* Carry the entry over in case the cache gets rewritten. */
+        cache_entry_t *e = entry_add(c, path);
+        if (e) {
+            e->st = key;
+            kelp_buf_write(&e->doc, doc_bytes, doc_len);
+        }
+        return CONFIG_CACHE_HIT;
+    }
+    return CONFIG_CACHE_MISS;
+}
+
+void
+config_cache_put(config_cache_t *c, const char *path, const struct stat *st,
+                 const cJSON *doc)
+{
+    if (!c)
+        return;
+    c->dirty = true;
+
+    /* Parse errors are not cached; a missing file is. */
+    if (st && !doc)
+        return;
+
+    cache_entry_t *e = entry_add(c, path);
+    if (!e)
+        return;
+    stat_key(st, &e->st);
+
+    if (st) {
+        e->racy = st->st_mtim.tv_sec + CACHE_RACY_SEC >= time(NULL);
+        if (encode_doc(&e->doc, doc, 0) != 0)
+            e->racy = true;
+    }
+}
+
+/* ======================================================================== */
+/* Writing                                                                  */
+/* ======================================================================== */
+
+static int
+cache_write(config_cache_t *c)
+{
+    kelp_buf_t payload = kelp_buf_new(1024);
+    uint32_t nentries = 0;
+    int rc = -1;
+
+    if (put_str(&payload, c->source) != 0)
+        goto out;
+
+    for (int i = 0; i < c->nentries; i++) {
+        const cache_entry_t *e = &c->entries[i];
+        if (e->racy)
+            continue;
+        const cache_stat_t *k = &e->st;
+        if (put_str(&payload, e->path) != 0 ||
+            kelp_buf_write(&payload, &k->present, 1) != 0 ||
+            kelp_buf_write(&payload, &k->dev, sizeof(k->dev)) != 0 ||
+            kelp_buf_write(&payload, &k->ino, sizeof(k->ino)) != 0 ||
+            kelp_buf_write(&payload, &k->size, sizeof(k->size)) != 0 ||
+            kelp_buf_write(&payload, &k->mtime_s, sizeof(k->mtime_s)) != 0 ||
+            kelp_buf_write(&payload, &k->mtime_ns, sizeof(k->mtime_ns)) != 0 ||
+            kelp_buf_write(&payload, &k->ctime_s, sizeof(k->ctime_s)) != 0 ||
+            kelp_buf_write(&payload, &k->ctime_ns, sizeof(k->ctime_ns)) != 0 ||
+            put_u32(&payload, (uint32_t)e->doc.len) != 0 ||
+            kelp_buf_write(&payload, e->doc.data, e->doc.len) != 0)
+            goto out;
+        nentries++;
+    }
+    if (nentries == 0)
+        goto out;
+
+    cache_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.version      = CACHE_VERSION;
+    h.nentries     = nentries;
+    h.env_hash     = c->env_hash;
+    h.payload_len  = payload.len;
+    h.payload_hash = fnv64(FNV64_INIT, payload.data, payload.len);
+
+    /* The cache directory is private: cached documents may hold secrets
+     * written literally in the config file. */
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", c->file);
+    char *slash = strrchr(dir, '/');
+    if (!slash)
+        goto out;
+    *slash = '\0';
+    if (config_mkdirp(dir, 0700) != 0)
+        goto out;
+
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", c->file);
+    int fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0)
+        goto out;
+
+    bool ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+              write(fd, payload.data, payload.len) == (ssize_t)payload.len;
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(tmp, c->file) == 0)
+        rc = 0;
+    else
+        unlink(tmp);
+
+out:
+    kelp_buf_free(&payload);
+    return rc;
+}
+
+void
+config_cache_close(config_cache_t *c)
+{
+    if (!c)
+        return;
+
+    if (c->dirty)
+        cache_write(c);
+
+    if (c->map)
+        munmap((void *)c->map, c->map_len);
+    for (int i = 0; i < c->nentries; i++) {
+        free(c->entries[i].path);
+        kelp_buf_free(&c->entries[i].doc);
+    }
+    free(c->source);
+    free(c);
+}
@@ -0,0 +1,97 @@
+/*
+ * kelp-linux :: libkelp-config
+ * config_internal.h - Shared internals of libkelp-config
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_CONFIG_INTERNAL_H
+#define KELP_CONFIG_INTERNAL_H
+
+#include "kelp/config.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+struct cJSON;
+struct stat;
+
+/** Storage type of a keyed config field. */
+typedef enum {
+    CONFIG_KEY_STR,     /* char *  */
+    CONFIG_KEY_INT,     /* int     */
+    CONFIG_KEY_BOOL,    /* bool    */
+    CONFIG_KEY_FLOAT    /* float   */
+} config_key_type_t;
+
+/** One dotted key and where its value lives inside kelp_config_t. */
+typedef struct {
+    const char        *key;
+    config_key_type_t  type;
+    size_t             offset;
+} config_key_t;
+
+/**
+ * Look up a dotted key (e.g. "gateway.port") in the compiled key table.
+ *
+ * The table is a minimal perfect hash built once on first use, so a
+ * lookup costs one hash and one string compare.
+ *
+ * @return The key descriptor, or NULL if the key is not recognised.
+ */
+const config_key_t *config_key_find(const char *key);
+
+/** Address of the field described by @p k inside @p cfg. */
+static inline const void *
+config_key_field(const kelp_config_t *cfg, const config_key_t *k)
+{
+    return (const char *)cfg + k->offset;
+}
+
+/**
+ * Deep-copy @p src into @p dst (which is overwritten, not freed).
+ *
+ * @return 0 on success, -1 on allocation failure (dst is left zeroed).
+ */
+int config_copy(kelp_config_t *dst, const kelp_config_t *src);
+
+/** `mkdir -p` @p path, creating missing components with @p mode. */
+int config_mkdirp(const char *path, mode_t mode);
+
+/* ---- Binary document cache (config_cache.c) ----------------------------- */
+
+typedef struct config_cache config_cache_t;
+
+typedef enum {
+    CONFIG_CACHE_MISS,      /* not cached or stale: parse the file      */
+    CONFIG_CACHE_HIT,       /* cached document returned                 */
+    CONFIG_CACHE_ABSENT     /* file is known not to exist               */
+} config_cache_result_t;
+
+/**
+ * Open the cache for a load of @p source (the base config path).
+ *
+ * @return The cache, or NULL when caching is disabled or unavailable;
+ *         every function below accepts NULL and then behaves as a miss.
+ */
+config_cache_t *config_cache_open(const char *source);
+
+/**
+ * Look up the parsed, unsubstituted document for @p path.  On a hit,
+ * *doc receives a new tree the caller must cJSON_Delete().
+ */
+config_cache_result_t config_cache_get(config_cache_t *cache, const char *path,
+                                       struct cJSON **doc);
+
+/**
+ * Record the document just parsed from @p path, which had stat @p st.
+ * A NULL @p st records that the file does not exist; a NULL @p doc with
+ * a non-NULL @p st (parse failure) records nothing.
+ */
+void config_cache_put(config_cache_t *cache, const char *path,
+                      const struct stat *st, const struct cJSON *doc);
+
+/** Write the cache back if anything was parsed, then free it. */
+void config_cache_close(config_cache_t *cache);
+
+#endif /* KELP_CONFIG_INTERNAL_H */
@@ -0,0 +1,190 @@
+/*
+ * kelp-linux :: libkelp-config
+ * config_keys.c - Compiled dotted-key table for kelp_config_t
+ *
+ * Every keyed accessor (kelp_config_get_* and the snapshot getters) goes
+ * through config_key_find().  The key set is fixed at compile time, so a
+ * minimal perfect hash is built over it once (hash-and-displace: keys are
+ * grouped into buckets, and each bucket gets the smallest displacement
+ * that sends all of its keys to free slots).  A lookup is then one FNV-1a
+ * hash, one table probe and one strcmp to reject unknown keys.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config_internal.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* ======================================================================== */
+/* Key table                                                                */
+/* ======================================================================== */
+
+#define KEY(name, type, field) { name, CONFIG_KEY_##type, offsetof(kelp_config_t, field) }
+
+static const config_key_t key_defs[] = {
+    KEY("config_dir",                 STR,   config_dir),
+    KEY("data_dir",                   STR,   data_dir),
+    KEY("runtime_dir",                STR,   runtime_dir),
+    KEY("profile",                    STR,   profile),
+
+    KEY("gateway.host",               STR,   gateway.host),
+    KEY("gateway.port",               INT,   gateway.port),
+    KEY("gateway.socket_path",        STR,   gateway.socket_path),
+    KEY("gateway.tls_enabled",        BOOL,  gateway.tls_enabled),
+    KEY("gateway.tls_cert",           STR,   gateway.tls_cert),
+    KEY("gateway.tls_key",            STR,   gateway.tls_key),
+
+    KEY("model.default_provider",     STR,   model.default_provider),
+    KEY("model.default_model",        STR,   model.default_model),
+    KEY("model.api_key",              STR,   model.api_key),
+    KEY("model.system_prompt",        STR,   model.system_prompt),
+    KEY("model.max_tokens",           INT,   model.max_tokens),
+    KEY("model.temperature",          FLOAT, model.temperature),
+
+    KEY("security.sandbox_enabled",   BOOL,  security.sandbox_enabled),
+    KEY("security.sandbox_memory_mb", INT,   security.sandbox_memory_mb),
+    KEY("security.sandbox_cpu_cores", INT,   security.sandbox_cpu_cores),
+    KEY("security.sandbox_max_pids",  INT,   security.sandbox_max_pids),
+    KEY("security.audit_segments",    BOOL,  security.audit_segments),
+
+    KEY("logging.level",              INT,   logging.level),
+    KEY("logging.file",               STR,   logging.file),
+};
+
+#undef KEY
+
+#define KEY_COUNT   (sizeof(key_defs) / sizeof(key_defs[0]))
+#define KEY_SLOTS   32      /* power of two >= KEY_COUNT */
+#define KEY_BUCKETS 8
+#define MAX_DISP    65535
+
+_Static_assert(KEY_COUNT <= KEY_SLOTS, "grow KEY_SLOTS");
+
+static uint8_t        slot_key[KEY_SLOTS];        /* key index + 1, 0 = empty */
+static uint16_t       bucket_disp[KEY_BUCKETS];
+static bool           table_ready;
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+/* ======================================================================== */
+/* Hashing                                                                  */
+/* ======================================================================== */
+
+static uint64_t
+fnv1a(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static unsigned
+bucket_of(uint64_t h)
+{
+    return (unsigned)(h >> 32) % KEY_BUCKETS;
+}
+
+/** Slot for hash @p h under displacement @p d (splitmix64 finaliser). */
+static unsigned
+slot_of(uint64_t h, unsigned d)
+{
+    uint64_t x = h ^ ((uint64_t)d * 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (unsigned)(x & (KEY_SLOTS - 1));
+}
+
+/* ======================================================================== */
+/* Construction                                                             */
+/* ======================================================================== */
+
+static void
+build_table(void)
+{
+    uint64_t hashes[KEY_COUNT];
+    uint8_t  members[KEY_BUCKETS][KEY_COUNT];
+    unsigned sizes[KEY_BUCKETS] = {0};
+    unsigned order[KEY_BUCKETS];
+
+    for (unsigned i = 0; i < KEY_COUNT; i++) {
+        hashes[i] = fnv1a(key_defs[i].key);
+        unsigned b = bucket_of(hashes[i]);
+        members[b][sizes[b]++] = (uint8_t)i;
+    }
+
+    /* Place the largest buckets first while the table is still empty. */
+    for (unsigned b = 0; b < KEY_BUCKETS; b++)
+        order[b] = b;
+    for (unsigned i = 1; i < KEY_BUCKETS; i++) {
+        unsigned b = order[i], j = i;
+        while (j > 0 && sizes[order[j - 1]] < sizes[b]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = b;
+    }
+
+    for (unsigned o = 0; o < KEY_BUCKETS; o++) {
+        unsigned b = order[o];
+        if (sizes[b] == 0)
+            break;
+
+        unsigned d;
+        for (d = 0; d <= MAX_DISP; d++) {
+            unsigned slots[KEY_COUNT];
+            bool ok = true;
+            for (unsigned m = 0; m < sizes[b] && ok; m++) {
+                slots[m] = slot_of(hashes[members[b][m]], d);
+                if (slot_key[slots[m]])
+                    ok = false;
+                for (unsigned p = 0; p < m && ok; p++)
+                    if (slots[p] == slots[m])
+                        ok = false;
+            }
+            if (!ok)
+                continue;
+
+            for (unsigned m = 0; m < sizes[b]; m++)
+                slot_key[slots[m]] = (uint8_t)(members[b][m] + 1);
+            bucket_disp[b] = (uint16_t)d;
+            break;
+        }
+        if (d > MAX_DISP)
+            return; /* table_ready stays false: fall back to a linear scan */
+    }
+
+    table_ready = true;
+}
+
+/* ======================================================================== */
+/* Lookup                                                                   */
+/* ======================================================================== */
+
+const config_key_t *
+config_key_find(const char *key)
+{
+    if (!key)
+        return NULL;
+
+    pthread_once(&table_once, build_table);
+
+    if (!table_ready) {
+        for (size_t i = 0; i < KEY_COUNT; i++)
+            if (strcmp(key_defs[i].key, key) == 0)
+                return &key_defs[i];
+        return NULL;
+    }
+
+    uint64_t h = fnv1a(key);
+    unsigned idx = slot_key[slot_of(h, bucket_disp[bucket_of(h)])];
+    if (idx == 0 || strcmp(key_defs[idx - 1].key, key) != 0)
+        return NULL;
+    return &key_defs[idx - 1];
+}
@@ -0,0 +1,420 @@
+/*
+ * kelp-linux :: libkelp-config
+ * config_snapshot.c - Immutable config snapshots, lock-free publication,
+ *                     and inotify-driven hot reload
+ *
+ * Publication follows the sleepable-RCU pattern with two reader counters.
+ * A reader picks the counter selected by the current epoch, increments it,
+ * and re-checks the epoch so it never counts itself in a phase the writer
+ * has already moved past.  A publisher exchanges the current pointer, flips
+ * the epoch, and waits for the old phase's counter to drain; after that no
+ * reader can still hold the previous snapshot, so its reference is dropped.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kelp/config_snapshot.h"
+#include "config_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct kelp_config_snapshot {
+    atomic_uint   refs;
+    uint64_t      generation;
+    kelp_config_t cfg;
+};
+
+/* ======================================================================== */
+/* Snapshots                                                                */
+/* ======================================================================== */
+
+kelp_config_snapshot_t *
+kelp_config_snapshot_new(const kelp_config_t *cfg)
+{
+    if (!cfg)
+        return NULL;
+
+    kelp_config_snapshot_t *snap = calloc(1, sizeof(*snap));
+    if (!snap)
+        return NULL;
+
+    if (config_copy(&snap->cfg, cfg) != 0) {
+        free(snap);
+        return NULL;
+    }
+    atomic_init(&snap->refs, 1);
+    return snap;
+}
+
+kelp_config_snapshot_t *
+kelp_config_snapshot_ref(kelp_config_snapshot_t *snap)
+{
+    if (snap)
+        atomic_fetch_add_explicit(&snap->refs, 1, memory_order_relaxed);
+    return snap;
+}
+
+void
+kelp_config_snapshot_unref(kelp_config_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+    if (atomic_fetch_sub_explicit(&snap->refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+    kelp_config_free(&snap->cfg);
+    free(snap);
+}
+
+const kelp_config_t *
+kelp_config_snapshot_config(const kelp_config_snapshot_t *snap)
+{
+    return snap ? &snap->cfg : NULL;
+}
+
+uint64_t
+kelp_config_snapshot_generation(const kelp_config_snapshot_t *snap)
+{
+    return snap ? snap->generation : 0;
+}
+
+const char *
+kelp_config_snapshot_get_string(const kelp_config_snapshot_t *snap,
+                                const char *key)
+{
+    return snap ? kelp_config_get_string(&snap->cfg, key) : NULL;
+}
+
+int
+kelp_config_snapshot_get_int(const kelp_config_snapshot_t *snap,
+                             const char *key, int def)
+{
+    return snap ? kelp_config_get_int(&snap->cfg, key, def) : def;
+}
+
+bool
+kelp_config_snapshot_get_bool(const kelp_config_snapshot_t *snap,
+                              const char *key, bool def)
+{
+    return snap ? kelp_config_get_bool(&snap->cfg, key, def) : def;
+}
+
+double
+kelp_config_snapshot_get_double(const kelp_config_snapshot_t *snap,
+                                const char *key, double def)
+{
+    if (!snap || !key)
+        return def;
+
+    const config_key_t *k = config_key_find(key);
+    if (!k)
+        return def;
+
+    switch (k->type) {
+    case CONFIG_KEY_FLOAT: return *(const float *)config_key_field(&snap->cfg, k);
+    case CONFIG_KEY_INT:   return *(const int *)config_key_field(&snap->cfg, k);
+    default:               return def;
+    }
+}
+
+/* ======================================================================== */
+/* Publication                                                              */
+/* ======================================================================== */
+
+static _Atomic(kelp_config_snapshot_t *) g_current;
+static atomic_uint                       g_epoch;
+static atomic_long                       g_readers[2];
+static atomic_uint_fast64_t              g_generation;
+static pthread_mutex_t                   g_publish_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Publishing from inside a read section would wait on itself. */
+static _Thread_local int tls_read_depth;
+
+const kelp_config_snapshot_t *
+kelp_config_read_begin(kelp_config_guard_t *guard)
+{
+    unsigned e;
+
+    for (;;) {
+        e = atomic_load(&g_epoch);
+        atomic_fetch_add(&g_readers[e & 1], 1);
+        if (atomic_load(&g_epoch) == e)
+            break;
+        /* A publish flipped the epoch under us; count in the new phase. */
+        atomic_fetch_sub(&g_readers[e & 1], 1);
+    }
+
+    tls_read_depth++;
+    guard->epoch = e;
+    guard->snap  = atomic_load(&g_current);
+    return guard->snap;
+}
+
+void
+kelp_config_read_end(kelp_config_guard_t *guard)
+{
+    tls_read_depth--;
+    atomic_fetch_sub_explicit(&g_readers[guard->epoch & 1], 1,
+                              memory_order_release);
+    guard->snap = NULL;
+}
+
+kelp_config_snapshot_t *
+kelp_config_current(void)
+{
+    kelp_config_guard_t g;
+    kelp_config_snapshot_t *snap =
+        (kelp_config_snapshot_t *)kelp_config_read_begin(&g);
+    kelp_config_snapshot_ref(snap);
+    kelp_config_read_end(&g);
+    return snap;
+}
+
+int
+kelp_config_publish(kelp_config_snapshot_t *snap)
+{
+    if (tls_read_depth > 0)
+        return -1;
+
+    pthread_mutex_lock(&g_publish_lock);
+
+    if (snap)
+        snap->generation = atomic_fetch_add(&g_generation, 1) + 1;
+    kelp_config_snapshot_t *old = atomic_exchange(&g_current, snap);
+
+    /* Readers that entered before the flip are counted in the old phase. */
+    unsigned e = atomic_fetch_add(&g_epoch, 1);
+    for (unsigned spins = 0; atomic_load(&g_readers[e & 1]) != 0; spins++) {
+        if (spins < 64)
+            sched_yield();
+        else
+            usleep(50);
+    }
+
+    pthread_mutex_unlock(&g_publish_lock);
+
+    kelp_config_snapshot_unref(old);
+    return 0;
+}
+
+/* ======================================================================== */
+/* Hot reload                                                               */
+/* ======================================================================== */
+
+int
+kelp_config_reload(const char *path)
+{
+    kelp_config_t cfg;
+
+    if (kelp_config_load(path, &cfg) != 0)
+        return -1;
+    kelp_config_merge_env(&cfg);
+    if (kelp_config_validate(&cfg) != 0) {
+        kelp_config_free(&cfg);
+        return -1;
+    }
+
+    kelp_config_snapshot_t *snap = kelp_config_snapshot_new(&cfg);
+    kelp_config_free(&cfg);
+    if (!snap)
+        return -1;
+
+    /* Publishing fails inside a read section; the snapshot is still ours. */
+    if (kelp_config_publish(snap) != 0) {
+        kelp_config_snapshot_unref(snap);
+        return -1;
+    }
+    return 0;
+}
+
+/* How long the directory must stay quiet before a burst is acted on. */
+#define WATCH_DEBOUNCE_MS 100
+
+typedef struct {
+    pthread_t              thread;
+    int                    ifd;
+    int                    stop_pipe[2];
+    int                    dir_wd;
+    int                    profiles_wd;
+    char                   path[PATH_MAX];
+    char                   base[NAME_MAX + 1];
+    kelp_config_reload_cb  cb;
+    void                  *userdata;
+} config_watch_t;
+
+static config_watch_t  *g_watch;
+static pthread_mutex_t  g_watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Drain pending inotify events; return true if any concern the config. */
+static bool
+watch_drain(config_watch_t *w)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool relevant = false;
+
+    for (;;) {
+        ssize_t n = read(w->ifd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->wd == w->profiles_wd)
+                relevant = true;
+            else if (ev->wd == w->dir_wd && ev->len > 0 &&
+                     strcmp(ev->name, w->base) == 0)
+                relevant = true;
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    return relevant;
+}
+
+static void *
+watch_thread(void *arg)
+{
+    config_watch_t *w = arg;
+    bool pending = false;
+
+    for (;;) {
+        struct pollfd pfd[2] = {
+            { .fd = w->ifd,          .events = POLLIN },
+            { .fd = w->stop_pipe[0], .events = POLLIN },
+        };
+        int rc = poll(pfd, 2, pending ? WATCH_DEBOUNCE_MS : -1);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (pfd[1].revents)
+            break;
+
+        if (rc > 0) {
+            if (watch_drain(w))
+                pending = true;
+            continue;
+        }
+
+        /* Quiet for a full debounce interval: reload once. */
+        pending = false;
+        int reloaded = kelp_config_reload(w->path);
+        if (!w->cb)
+            continue;
+
+        kelp_config_snapshot_t *snap = reloaded == 0 ? kelp_config_current() : NULL;
+        w->cb(snap, w->userdata);
+        kelp_config_snapshot_unref(snap);
+    }
+    return NULL;
+}
+
+static void
+watch_free(config_watch_t *w)
+{
+    if (w->ifd >= 0)
+        close(w->ifd);
+    if (w->stop_pipe[0] >= 0)
+        close(w->stop_pipe[0]);
+    if (w->stop_pipe[1] >= 0)
+        close(w->stop_pipe[1]);
+    free(w);
+}
+
+int
+kelp_config_watch_start(const char *path, kelp_config_reload_cb cb,
+                        void *userdata)
+{
+    if (!path || strlen(path) >= PATH_MAX)
+        return -1;
+
+    pthread_mutex_lock(&g_watch_lock);
+    if (g_watch) {
+        pthread_mutex_unlock(&g_watch_lock);
+        return -1;
+    }
+
+    config_watch_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        pthread_mutex_unlock(&g_watch_lock);
+        return -1;
+    }
+    w->ifd          = -1;
+    w->stop_pipe[0] = w->stop_pipe[1] = -1;
+    w->profiles_wd  = -1;
+    w->cb           = cb;
+    w->userdata     = userdata;
+    strcpy(w->path, path);
+
+    /* Split into directory and file name.  Editors usually replace the
+     * file by renaming a temp file over it, so the directory is watched
+     * rather than the file's inode. */
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    if (slash) {
+        size_t dlen = slash == path ? 1 : (size_t)(slash - path);
+        memcpy(dir, path, dlen);
+        dir[dlen] = '\0';
+        snprintf(w->base, sizeof(w->base), "%s", slash + 1);
+    } else {
+        strcpy(dir, ".");
+        snprintf(w->base, sizeof(w->base), "%s", path);
+    }
+
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+    w->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->ifd < 0 || pipe2(w->stop_pipe, O_CLOEXEC) != 0)
+        goto fail;
+
+    w->dir_wd = inotify_add_watch(w->ifd, dir, mask);
+    if (w->dir_wd < 0)
+        goto fail;
+
+    /* Profile overlays live in <dir>/profiles/; watch it if present. */
+    char profiles[PATH_MAX + 16];
+    struct stat st;
+    snprintf(profiles, sizeof(profiles), "%s/profiles", dir);
+    if (stat(profiles, &st) == 0 && S_ISDIR(st.st_mode))
+        w->profiles_wd = inotify_add_watch(w->ifd, profiles, mask);
+
+    if (pthread_create(&w->thread, NULL, watch_thread, w) != 0)
+        goto fail;
+
+    g_watch = w;
+    pthread_mutex_unlock(&g_watch_lock);
+    return 0;
+
+fail:
+    watch_free(w);
+    pthread_mutex_unlock(&g_watch_lock);
+    return -1;
+}
+
+void
+kelp_config_watch_stop(void)
+{
+    pthread_mutex_lock(&g_watch_lock);
+    config_watch_t *w = g_watch;
+    g_watch = NULL;
+    pthread_mutex_unlock(&g_watch_lock);
+
+    if (!w)
+        return;
+
+    ssize_t n = write(w->stop_pipe[1], "x", 1);
+    (void)n;
+    pthread_join(w->thread, NULL);
+    watch_free(w);
+}
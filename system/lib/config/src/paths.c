@@ -6,6 +6,7 @@
  */
 
 #include "kelp/paths.h"
+#include "config_internal.h"
 
 #include <errno.h>
 #include <pwd.h>
@@ -67,8 +68,8 @@ join_path(const char *base, const char *tail)
  * Recursive mkdir (equivalent to `mkdir -p`).
  * Returns 0 on success, -1 on error.
  */
-static int
-mkdirp(const char *path, mode_t mode)
+int
+config_mkdirp(const char *path, mode_t mode)
 {
     if (!path || !path[0])
         return -1;
@@ -147,6 +148,27 @@ kelp_paths_data_dir(void)
     return data;
 }
 
+char *
+kelp_paths_cache_dir(void)
+{
+    const char *env;
+
+    env = getenv("KELP_CACHE_DIR");
+    if (env && env[0])
+        return strdup(env);
+
+    env = getenv("XDG_CACHE_HOME");
+    if (env && env[0])
+        return join_path(env, "kelp");
+
+    char *home = get_home();
+    if (!home)
+        return NULL;
+    char *cache = join_path(home, ".cache/kelp");
+    free(home);
+    return cache;
+}
+
 char *
 kelp_paths_runtime_dir(void)
 {
@@ -188,9 +210,9 @@ kelp_paths_ensure_dirs(void)
         goto out;
     }
 
-    if (mkdirp(cfg,  0755) != 0) { rc = -1; goto out; }
-    if (mkdirp(data, 0755) != 0) { rc = -1; goto out; }
-    if (mkdirp(run,  0700) != 0) { rc = -1; goto out; }
+    if (config_mkdirp(cfg,  0755) != 0) { rc = -1; goto out; }
+    if (config_mkdirp(data, 0755) != 0) { rc = -1; goto out; }
+    if (config_mkdirp(run,  0700) != 0) { rc = -1; goto out; }
 
 out:
     free(cfg);
@@ -8,42 +8,448 @@
 #include "kelp/schema.h"
 
 #include <cjson/cJSON.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* ------------------------------------------------------------------------ */
-/* Internal helpers                                                         */
+/* Compiled program                                                         */
 /* ------------------------------------------------------------------------ */
 
-/**
- * Resolve a dotted key path (e.g. "gateway.port") within a cJSON tree.
- *
- * Returns NULL if the path does not exist.
+/*
+ * A compiled schema is the tree of dotted names flattened into one array.
+ * The children of a node are contiguous, and each node with children owns
+ * a small open-addressed table (a slice of prog->slots) mapping a member
+ * name to its child.  Validation walks the document once, looks every
+ * member up in its parent's table, and checks the rule attached to the
+ * node it lands on.  Nothing is split or re-resolved per rule.
  */
-static const cJSON *
-resolve_path(const cJSON *root, const char *dotted)
+
+typedef struct {
+    const char          *name;         /* member name at this level          */
+    const char          *path;         /* dotted path, for error messages    */
+    uint32_t             hash;
+    int                  rule;         /* rule order in the schema, -1: none */
+    bool                 typed;        /* false: any type is accepted        */
+    kelp_schema_type_t   type;
+    bool                 required;
+    bool                 has_min;
+    bool                 has_max;
+    double               min;
+    double               max;
+    int                  parent;       /* index into nodes[], -1 for root    */
+    int                  first_child;  /* index into nodes[]                 */
+    int                  child_count;
+    int                  slot_base;    /* index into slots[]                 */
+    unsigned             slot_mask;
+} schema_node_t;
+
+struct kelp_schema_prog {
+    schema_node_t *nodes;        /* nodes[0] is the document root */
+    int            node_count;
+    int           *slots;
+    int            slot_count;
+    char          *strings;      /* names and paths of all nodes  */
+    bool           root_object;  /* the document must be an object */
+    bool           scoped;       /* "required" only inside a present parent */
+};
+
+/* Seen-state of a node during one validation run. */
+enum { NODE_ABSENT = 0, NODE_NULL = 1, NODE_PRESENT = 2 };
+
+/* ---- Build tree --------------------------------------------------------- */
+
+typedef struct build_node {
+    char                *name;
+    char                *path;
+    int                  rule;
+    bool                 typed;
+    kelp_schema_type_t   type;
+    bool                 required;
+    bool                 has_min;
+    bool                 has_max;
+    double               min;
+    double               max;
+    struct build_node  **kids;
+    int                  nkids;
+    int                  cap;
+} build_node_t;
+
+typedef struct {
+    build_node_t  root;
+    int           node_count;
+    size_t        string_bytes;
+    int           next_rule;
+    bool          oom;
+} builder_t;
+
+static uint32_t
+name_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static unsigned
+slots_for(int nkids)
+{
+    unsigned n = 4;
+    while (n < (unsigned)nkids * 2)
+        n <<= 1;
+    return n;
+}
+
+static void
+build_node_free(build_node_t *n)
+{
+    for (int i = 0; i < n->nkids; i++) {
+        build_node_free(n->kids[i]);
+        free(n->kids[i]);
+    }
+    free(n->kids);
+    free(n->name);
+    free(n->path);
+}
+
+/** Find or create the child of @p parent called @p name. */
+static build_node_t *
+builder_child(builder_t *b, build_node_t *parent, const char *name)
 {
-    if (!root || !dotted)
+    for (int i = 0; i < parent->nkids; i++)
+        if (strcmp(parent->kids[i]->name, name) == 0)
+            return parent->kids[i];
+
+    if (parent->nkids == parent->cap) {
+        int cap = parent->cap ? parent->cap * 2 : 4;
+        build_node_t **kids = realloc(parent->kids, (size_t)cap * sizeof(*kids));
+        if (!kids)
+            goto oom;
+        parent->kids = kids;
+        parent->cap  = cap;
+    }
+
+    build_node_t *n = calloc(1, sizeof(*n));
+    if (!n)
+        goto oom;
+    n->rule = -1;
+    n->name = strdup(name);
+    if (parent->path) {
+        size_t len = strlen(parent->path) + 1 + strlen(name) + 1;
+        n->path = malloc(len);
+        if (n->path)
+            snprintf(n->path, len, "%s.%s", parent->path, name);
+    } else {
+        n->path = strdup(name);
+    }
+    if (!n->name || !n->path) {
+        build_node_free(n);
+        free(n);
+        goto oom;
+    }
+
+    parent->kids[parent->nkids++] = n;
+    b->node_count++;
+    b->string_bytes += strlen(n->name) + 1 + strlen(n->path) + 1;
+    return n;
+
+oom:
+    b->oom = true;
+    return NULL;
+}
+
+/** Numeric or length bounds of a rule; a bound applies only if present. */
+typedef struct {
+    bool    has_min;
+    bool    has_max;
+    double  min;
+    double  max;
+} limits_t;
+
+/** Attach a rule to @p n.  The first rule for a path wins. */
+static void
+builder_rule(builder_t *b, build_node_t *n, bool typed, kelp_schema_type_t type,
+             bool required, const limits_t *lim)
+{
+    if (!n || n->rule >= 0)
+        return;
+    n->rule     = b->next_rule++;
+    n->typed    = typed;
+    n->type     = type;
+    n->required = required;
+    n->has_min  = lim->has_min;
+    n->has_max  = lim->has_max;
+    n->min      = lim->min;
+    n->max      = lim->max;
+}
+
+/** Flatten the build tree breadth-first so siblings are contiguous. */
+static kelp_schema_prog_t *
+builder_finish(builder_t *b)
+{
+    kelp_schema_prog_t *prog = NULL;
+    build_node_t **queue = NULL;
+
+    if (b->oom)
+        goto out;
+
+    prog = calloc(1, sizeof(*prog));
+    queue = malloc((size_t)b->node_count * sizeof(*queue));
+    if (!prog || !queue)
+        goto fail;
+
+    /* Breadth-first order: node i's children follow all of level i-1. */
+    int tail = 0, nslots_total = 0;
+    queue[tail++] = &b->root;
+    for (int head = 0; head < tail; head++) {
+        for (int i = 0; i < queue[head]->nkids; i++)
+            queue[tail++] = queue[head]->kids[i];
+        if (queue[head]->nkids > 0)
+            nslots_total += (int)slots_for(queue[head]->nkids);
+    }
+
+    prog->node_count = b->node_count;
+    prog->slot_count = nslots_total;
+    prog->nodes   = calloc((size_t)b->node_count, sizeof(*prog->nodes));
+    prog->slots   = malloc(((size_t)nslots_total + 1) * sizeof(*prog->slots));
+    prog->strings = malloc(b->string_bytes + 1);
+    if (!prog->nodes || !prog->slots || !prog->strings)
+        goto fail;
+
+    char *sp = prog->strings;
+    int next = 1, slot = 0;
+    prog->nodes[0].parent = -1;
+
+    for (int head = 0; head < tail; head++) {
+        build_node_t *bn = queue[head];
+        schema_node_t *n = &prog->nodes[head];
+
+        if (bn != &b->root) {
+            size_t nl = strlen(bn->name) + 1, pl = strlen(bn->path) + 1;
+            n->name = memcpy(sp, bn->name, nl);
+            sp += nl;
+            n->path = memcpy(sp, bn->path, pl);
+            sp += pl;
+            n->hash = name_hash(bn->name);
+        } else {
+            n->name = n->path = "";
+        }
+        n->rule     = bn->rule;
+        n->typed    = bn->typed;
+        n->type     = bn->type;
+        n->required = bn->required;
+        n->has_min  = bn->has_min;
+        n->has_max  = bn->has_max;
+        n->min      = bn->min;
+        n->max      = bn->max;
+
+        n->first_child = next;
+        n->child_count = bn->nkids;
+        for (int i = 0; i < bn->nkids; i++)
+            prog->nodes[next + i].parent = head;
+        next += bn->nkids;
+
+        if (bn->nkids > 0) {
+            unsigned nslots = slots_for(bn->nkids);
+            n->slot_base = slot;
+            n->slot_mask = nslots - 1;
+            for (unsigned i = 0; i < nslots; i++)
+                prog->slots[slot + (int)i] = -1;
+            for (int i = 0; i < bn->nkids; i++) {
+                int child = n->first_child + i;
+                unsigned h = name_hash(bn->kids[i]->name) & n->slot_mask;
+                while (prog->slots[slot + (int)h] >= 0)
+                    h = (h + 1) & n->slot_mask;
+                prog->slots[slot + (int)h] = child;
+            }
+            slot += (int)nslots;
+        }
+    }
+    goto out;
+
+fail:
+    kelp_schema_prog_free(prog);
+    prog = NULL;
+out:
+    free(queue);
+    build_node_free(&b->root);
+    return prog;
+}
+
+static void
+builder_init(builder_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->root.rule = -1;
+    b->node_count = 1;
+}
+
+/* ---- Front ends --------------------------------------------------------- */
+
+kelp_schema_prog_t *
+kelp_schema_compile(const kelp_schema_t *schema)
+{
+    if (!schema)
         return NULL;
 
-    /* Work on a mutable copy of the key. */
-    char tmp[256];
-    size_t len = strlen(dotted);
-    if (len >= sizeof(tmp))
+    builder_t b;
+    builder_init(&b);
+
+    for (int i = 0; i < schema->field_count && !b.oom; i++) {
+        const kelp_schema_field_t *f = &schema->fields[i];
+        char tmp[256];
+        size_t len = f->name ? strlen(f->name) : 0;
+        if (len == 0 || len >= sizeof(tmp)) {
+            b.next_rule++;  /* never matches, like an unresolvable path */
+            continue;
+        }
+        memcpy(tmp, f->name, len + 1);
+
+        build_node_t *n = &b.root;
+        char *save = NULL;
+        for (char *tok = strtok_r(tmp, ".", &save); tok && n;
+             tok = strtok_r(NULL, ".", &save))
+            n = builder_child(&b, n, tok);
+        /* In a field table, 0 means "no limit". */
+        limits_t lim = {
+            .has_min = f->min != 0, .min = f->min,
+            .has_max = f->max != 0, .max = f->max,
+        };
+        builder_rule(&b, n, true, f->type, f->required, &lim);
+    }
+
+    return builder_finish(&b);
+}
+
+/** Map a JSON Schema "type" keyword; false if it is absent or not simple. */
+static bool
+json_type(const cJSON *node, kelp_schema_type_t *out)
+{
+    const cJSON *t = cJSON_GetObjectItemCaseSensitive(node, "type");
+    if (!cJSON_IsString(t))
+        return false;
+
+    static const struct { const char *name; kelp_schema_type_t type; } map[] = {
+        { "string",  SCHEMA_STRING }, { "integer", SCHEMA_INT    },
+        { "number",  SCHEMA_FLOAT  }, { "boolean", SCHEMA_BOOL   },
+        { "array",   SCHEMA_ARRAY  }, { "object",  SCHEMA_OBJECT },
+    };
+    for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); i++) {
+        if (strcmp(t->valuestring, map[i].name) == 0) {
+            *out = map[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Read the bounds named @p min_key and @p max_key, where present. */
+static void
+json_limits(const cJSON *node, const char *min_key, const char *max_key,
+            limits_t *out)
+{
+    const cJSON *lo = cJSON_GetObjectItemCaseSensitive(node, min_key);
+    const cJSON *hi = cJSON_GetObjectItemCaseSensitive(node, max_key);
+
+    out->has_min = cJSON_IsNumber(lo);
+    out->min     = out->has_min ? lo->valuedouble : 0;
+    out->has_max = cJSON_IsNumber(hi);
+    out->max     = out->has_max ? hi->valuedouble : 0;
+}
+
+static void
+compile_json_object(builder_t *b, build_node_t *parent, const cJSON *schema)
+{
+    const cJSON *props = cJSON_GetObjectItemCaseSensitive(schema, "properties");
+    const cJSON *req   = cJSON_GetObjectItemCaseSensitive(schema, "required");
+    const cJSON *prop;
+
+    cJSON_ArrayForEach(prop, props) {
+        if (!prop->string || !cJSON_IsObject(prop))
+            continue;
+
+        bool required = false;
+        const cJSON *r;
+        cJSON_ArrayForEach(r, req) {
+            if (cJSON_IsString(r) && strcmp(r->valuestring, prop->string) == 0)
+                required = true;
+        }
+
+        kelp_schema_type_t type = SCHEMA_STRING;
+        bool typed = json_type(prop, &type);
+        limits_t lim = {0};
+        switch (type) {
+        case SCHEMA_STRING:
+            json_limits(prop, "minLength", "maxLength", &lim);
+            break;
+        case SCHEMA_INT:
+        case SCHEMA_FLOAT:
+            json_limits(prop, "minimum", "maximum", &lim);
+            break;
+        case SCHEMA_ARRAY:
+            json_limits(prop, "minItems", "maxItems", &lim);
+            break;
+        default:
+            break;
+        }
+
+        build_node_t *n = builder_child(b, parent, prop->string);
+        if (!n)
+            return;
+        builder_rule(b, n, typed, type, required, &lim);
+        if (typed && type == SCHEMA_OBJECT)
+            compile_json_object(b, n, prop);
+    }
+}
+
+kelp_schema_prog_t *
+kelp_schema_compile_json(const cJSON *json_schema)
+{
+    if (!cJSON_IsObject(json_schema))
         return NULL;
-    memcpy(tmp, dotted, len + 1);
 
-    const cJSON *cur = root;
-    char *save = NULL;
-    char *tok  = strtok_r(tmp, ".", &save);
-    while (tok) {
-        cur = cJSON_GetObjectItemCaseSensitive(cur, tok);
-        if (!cur)
-            return NULL;
-        tok = strtok_r(NULL, ".", &save);
+    builder_t b;
+    builder_init(&b);
+    compile_json_object(&b, &b.root, json_schema);
+
+    kelp_schema_type_t type;
+    bool root_object = json_type(json_schema, &type) && type == SCHEMA_OBJECT;
+
+    kelp_schema_prog_t *prog = builder_finish(&b);
+    if (prog) {
+        prog->root_object = root_object;
+        prog->scoped      = true;
     }
-    return cur;
+    return prog;
+}
+
+void
+kelp_schema_prog_free(kelp_schema_prog_t *prog)
+{
+    if (!prog)
+        return;
+    free(prog->nodes);
+    free(prog->slots);
+    free(prog->strings);
+    free(prog);
+}
+
+/* ---- Execution ---------------------------------------------------------- */
+
+/** True if @p v has no fractional part (every double past 2^53 is whole). */
+static bool
+is_whole(double v)
+{
+    if (v != v)
+        return false;
+    if (v <= -9007199254740992.0 || v >= 9007199254740992.0)
+        return true;
+    return (double)(long long)v == v;
 }
 
 /**
@@ -56,7 +462,7 @@ check_type(const cJSON *item, kelp_schema_type_t type)
     case SCHEMA_STRING:
         return cJSON_IsString(item) ? 0 : -1;
     case SCHEMA_INT:
-        return cJSON_IsNumber(item) ? 0 : -1;
+        return cJSON_IsNumber(item) && is_whole(item->valuedouble) ? 0 : -1;
     case SCHEMA_FLOAT:
         return cJSON_IsNumber(item) ? 0 : -1;
     case SCHEMA_BOOL:
@@ -86,105 +492,210 @@ type_name(kelp_schema_type_t type)
     return "unknown";
 }
 
-/* ------------------------------------------------------------------------ */
-/* Public API                                                                */
-/* ------------------------------------------------------------------------ */
+/*
+ * Members are visited in document order, but the error reported is the one
+ * for the earliest rule in the schema, so the message does not depend on
+ * how the document happens to be ordered.
+ */
+typedef struct {
+    const kelp_schema_prog_t *prog;
+    unsigned char            *seen;
+    int                       best_rule;
+    char                     *err_buf;
+    size_t                    err_len;
+} run_t;
+
+static void
+run_fail(run_t *r, int rule, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void
+run_fail(run_t *r, int rule, const char *fmt, ...)
+{
+    if (r->best_rule >= 0 && rule >= r->best_rule)
+        return;
+    r->best_rule = rule;
+    if (r->err_buf && r->err_len > 0) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(r->err_buf, r->err_len, fmt, ap);
+        va_end(ap);
+    }
+}
+
+static int
+find_child(const kelp_schema_prog_t *prog, const schema_node_t *parent,
+           const char *name)
+{
+    if (parent->child_count == 0 || !name)
+        return -1;
+
+    uint32_t h = name_hash(name);
+    const int *slots = prog->slots + parent->slot_base;
+    for (unsigned i = h & parent->slot_mask; ; i = (i + 1) & parent->slot_mask) {
+        int idx = slots[i];
+        if (idx < 0)
+            return -1;
+        if (prog->nodes[idx].hash == h && strcmp(prog->nodes[idx].name, name) == 0)
+            return idx;
+    }
+}
+
+static void
+check_limits(run_t *r, const schema_node_t *f, const cJSON *item)
+{
+    if (f->type == SCHEMA_INT || f->type == SCHEMA_FLOAT) {
+        double v = item->valuedouble;
+        if (f->has_min && v < f->min)
+            run_fail(r, f->rule, "field \"%s\": value %.15g < min %.15g",
+                     f->path, v, f->min);
+        else if (f->has_max && v > f->max)
+            run_fail(r, f->rule, "field \"%s\": value %.15g > max %.15g",
+                     f->path, v, f->max);
+    } else if (f->type == SCHEMA_STRING) {
+        size_t slen = strlen(item->valuestring);
+        if (f->has_min && (double)slen < f->min)
+            run_fail(r, f->rule,
+                     "field \"%s\": string length %zu < min %.15g",
+                     f->path, slen, f->min);
+        else if (f->has_max && (double)slen > f->max)
+            run_fail(r, f->rule,
+                     "field \"%s\": string length %zu > max %.15g",
+                     f->path, slen, f->max);
+    } else if (f->type == SCHEMA_ARRAY) {
+        int count = cJSON_GetArraySize(item);
+        if (f->has_min && count < f->min)
+            run_fail(r, f->rule, "field \"%s\": array length %d < min %.15g",
+                     f->path, count, f->min);
+        else if (f->has_max && count > f->max)
+            run_fail(r, f->rule, "field \"%s\": array length %d > max %.15g",
+                     f->path, count, f->max);
+    }
+}
+
+static void
+run_object(run_t *r, int node, const cJSON *obj)
+{
+    const schema_node_t *parent = &r->prog->nodes[node];
+    const cJSON *item;
+
+    cJSON_ArrayForEach(item, obj) {
+        int idx = find_child(r->prog, parent, item->string);
+        if (idx < 0 || r->seen[idx] != NODE_ABSENT)
+            continue;   /* unknown member, or a duplicate key */
+
+        const schema_node_t *n = &r->prog->nodes[idx];
+        if (cJSON_IsNull(item)) {
+            r->seen[idx] = NODE_NULL;
+            continue;
+        }
+        r->seen[idx] = NODE_PRESENT;
+
+        if (n->rule >= 0 && n->typed) {
+            if (check_type(item, n->type) != 0)
+                run_fail(r, n->rule, "field \"%s\": expected type %s",
+                         n->path, type_name(n->type));
+            else
+                check_limits(r, n, item);
+        }
+
+        if (n->child_count > 0 && cJSON_IsObject(item))
+            run_object(r, idx, item);
+    }
+}
 
 int
-kelp_schema_validate(const kelp_schema_t *schema,
-                       const cJSON          *data,
-                       char                 *err_buf,
-                       size_t                err_len)
+kelp_schema_prog_validate(const kelp_schema_prog_t *prog,
+                          const cJSON              *data,
+                          char                     *err_buf,
+                          size_t                    err_len)
 {
-    if (!schema || !data) {
+    if (!prog || !data) {
         if (err_buf && err_len > 0)
             snprintf(err_buf, err_len, "schema or data is NULL");
         return -1;
     }
 
-    for (int i = 0; i < schema->field_count; i++) {
-        const kelp_schema_field_t *f = &schema->fields[i];
-        const cJSON *item = resolve_path(data, f->name);
-
-        /* --- required check --- */
-        if (!item || cJSON_IsNull(item)) {
-            if (f->required) {
-                if (err_buf && err_len > 0)
-                    snprintf(err_buf, err_len,
-                             "missing required field \"%s\"", f->name);
-                return -1;
-            }
-            continue; /* optional and absent -- ok */
-        }
+    if (prog->root_object && !cJSON_IsObject(data)) {
+        if (err_buf && err_len > 0)
+            snprintf(err_buf, err_len, "expected a JSON object");
+        return -1;
+    }
 
-        /* --- type check --- */
-        if (check_type(item, f->type) != 0) {
+    unsigned char stack_seen[256];
+    unsigned char *seen = stack_seen;
+    if ((size_t)prog->node_count > sizeof(stack_seen)) {
+        seen = calloc((size_t)prog->node_count, 1);
+        if (!seen) {
             if (err_buf && err_len > 0)
-                snprintf(err_buf, err_len,
-                         "field \"%s\": expected type %s",
-                         f->name, type_name(f->type));
+                snprintf(err_buf, err_len, "out of memory");
             return -1;
         }
+    } else {
+        memset(seen, 0, (size_t)prog->node_count);
+    }
 
-        /* --- range / length check (only for numbers and strings) --- */
-        if (f->type == SCHEMA_INT || f->type == SCHEMA_FLOAT) {
-            double v = item->valuedouble;
-            if (f->min != 0 || f->max != 0) {
-                if (f->min != 0 && v < (double)f->min) {
-                    if (err_buf && err_len > 0)
-                        snprintf(err_buf, err_len,
-                                 "field \"%s\": value %g < min %d",
-                                 f->name, v, f->min);
-                    return -1;
-                }
-                if (f->max != 0 && v > (double)f->max) {
-                    if (err_buf && err_len > 0)
-                        snprintf(err_buf, err_len,
-                                 "field \"%s\": value %g > max %d",
-                                 f->name, v, f->max);
-                    return -1;
-                }
-            }
-        } else if (f->type == SCHEMA_STRING && cJSON_IsString(item)) {
-            size_t slen = strlen(item->valuestring);
-            if (f->min != 0 && (int)slen < f->min) {
-                if (err_buf && err_len > 0)
-                    snprintf(err_buf, err_len,
-                             "field \"%s\": string length %zu < min %d",
-                             f->name, slen, f->min);
-                return -1;
-            }
-            if (f->max != 0 && (int)slen > f->max) {
-                if (err_buf && err_len > 0)
-                    snprintf(err_buf, err_len,
-                             "field \"%s\": string length %zu > max %d",
-                             f->name, slen, f->max);
-                return -1;
-            }
-        } else if (f->type == SCHEMA_ARRAY && cJSON_IsArray(item)) {
-            int count = cJSON_GetArraySize(item);
-            if (f->min != 0 && count < f->min) {
-                if (err_buf && err_len > 0)
-                    snprintf(err_buf, err_len,
-                             "field \"%s\": array length %d < min %d",
-                             f->name, count, f->min);
-                return -1;
-            }
-            if (f->max != 0 && count > f->max) {
-                if (err_buf && err_len > 0)
-                    snprintf(err_buf, err_len,
-                             "field \"%s\": array length %d > max %d",
-                             f->name, count, f->max);
-                return -1;
-            }
-        }
+    run_t r = {
+        .prog      = prog,
+        .seen      = seen,
+        .best_rule = -1,
+        .err_buf   = err_buf,
+        .err_len   = err_len,
+    };
+
+    if (cJSON_IsObject(data))
+        run_object(&r, 0, data);
+
+    /* Required fields that were never seen (or were null).  A dotted
+     * schema requires the full path; JSON Schema only requires a member
+     * of an object that is itself there. */
+    for (int i = 1; i < prog->node_count; i++) {
+        const schema_node_t *n = &prog->nodes[i];
+        if (n->rule < 0 || !n->required || seen[i] == NODE_PRESENT)
+            continue;
+        if (prog->scoped && n->parent > 0 && seen[n->parent] != NODE_PRESENT)
+            continue;
+        run_fail(&r, n->rule, "missing required field \"%s\"", n->path);
     }
 
+    if (seen != stack_seen)
+        free(seen);
+
+    if (r.best_rule >= 0)
+        return -1;
     if (err_buf && err_len > 0)
         err_buf[0] = '\0';
     return 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------ */
+
+int
+kelp_schema_validate(const kelp_schema_t *schema,
+                       const cJSON          *data,
+                       char                 *err_buf,
+                       size_t                err_len)
+{
+    if (!schema || !data) {
+        if (err_buf && err_len > 0)
+            snprintf(err_buf, err_len, "schema or data is NULL");
+        return -1;
+    }
+
+    kelp_schema_prog_t *prog = kelp_schema_compile(schema);
+    if (!prog) {
+        if (err_buf && err_len > 0)
+            snprintf(err_buf, err_len, "out of memory");
+        return -1;
+    }
+
+    int rc = kelp_schema_prog_validate(prog, data, err_buf, err_len);
+    kelp_schema_prog_free(prog);
+    return rc;
+}
+
 /* ------------------------------------------------------------------------ */
 /* Built-in config schema                                                    */
 /* ------------------------------------------------------------------------ */
@@ -216,6 +727,7 @@ static const kelp_schema_field_t config_fields[] = {
     { "security.sandbox_memory_mb",  SCHEMA_INT,     false, "512",         1, 65536},
     { "security.sandbox_cpu_cores",  SCHEMA_INT,     false, "2",           1,  256 },
     { "security.sandbox_max_pids",   SCHEMA_INT,     false, "64",          1, 32768},
+    { "security.audit_segments",     SCHEMA_BOOL,    false, "false",       0,    0 },
     { "security.allowed_paths",      SCHEMA_ARRAY,   false, NULL,          0,    0 },
 
     /* logging */
@@ -0,0 +1,232 @@
+/*
+ * kelp-linux :: libkelp-config
+ * bench_config_load.c - config load and CLI startup with and without the
+ *                       binary config cache
+ *
+ * Writes a realistic config (every section, ${ENV} references, a system
+ * prompt, a profile overlay) into a temp directory and times:
+ *
+ *   parse     kelp_config_load() with KELP_CONFIG_CACHE=0
+ *   cached    kelp_config_load() against a warm cache
+ *
+ * If a command follows "--" it is also started repeatedly with
+ * KELP_CONFIG_DIR pointing at the temp config, first with the cache
+ * disabled and then warm, to measure end-to-end startup:
+ *
+ *   bench_config_load 2000 -- kelp version
+ *
+ * Usage: bench_config_load [iterations] [-- command args...]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/config.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *bench_yaml =
+    "profile: work\n"
+    "\n"
+    "gateway:\n"
+    "  host: 127.0.0.1\n"
+    "  port: 8080\n"
+    "  socket_path: ${XDG_RUNTIME_DIR:-/run}/kelp/kelp.sock\n"
+    "  tls_enabled: false\n"
+    "  tls_cert: /etc/kelp/tls/cert.pem\n"
+    "  tls_key: /etc/kelp/tls/key.pem\n"
+    "\n"
+    "model:\n"
+    "  default_provider: anthropic\n"
+    "  default_model: claude-sonnet-4-20250514\n"
+    "  api_key: ${ANTHROPIC_API_KEY:-sk-placeholder}\n"
+    "  max_tokens: 8192\n"
+    "  temperature: 0.7\n"
+    "  system_prompt: |\n"
+    "    You are Kelp, an assistant integrated into a Linux workstation.\n"
+    "    You can read files, run sandboxed commands and manage services.\n"
+    "    Prefer short answers.  Ask before changing system state.  When a\n"
+    "    command fails, show the relevant part of its output and suggest a\n"
+    "    fix.  Never print secrets from the environment or config files.\n"
+    "\n"
+    "security:\n"
+    "  sandbox_enabled: true\n"
+    "  sandbox_memory_mb: 2048\n"
+    "  sandbox_cpu_cores: 4\n"
+    "  sandbox_max_pids: 256\n"
+    "  allowed_paths:\n"
+    "    - ${HOME}/projects\n"
+    "    - ${HOME}/Documents\n"
+    "    - ${HOME}/Downloads\n"
+    "    - /tmp\n"
+    "    - /var/tmp\n"
+    "    - /srv/shared\n"
+    "\n"
+    "logging:\n"
+    "  level: info\n"
+    "  file: ${XDG_STATE_HOME:-/var/log}/kelp/kelp.log\n"
+    "\n"
+    "channels:\n"
+    "  telegram:\n"
+    "    enabled: true\n"
+    "    token: ${TELEGRAM_TOKEN:-}\n"
+    "    allowed_users: [1001, 1002, 1003]\n"
+    "  discord:\n"
+    "    enabled: false\n"
+    "    token: ${DISCORD_TOKEN:-}\n"
+    "  slack:\n"
+    "    enabled: false\n"
+    "    token: ${SLACK_TOKEN:-}\n";
+
+static const char *bench_overlay =
+    "model:\n"
+    "  default_model: claude-opus-4-20250514\n"
+    "  max_tokens: 16384\n"
+    "logging:\n"
+    "  level: debug\n";
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Write @p text and date it an hour back so the cache accepts it. */
+static int write_file(const char *path, const char *text)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+    fputs(text, fp);
+    fclose(fp);
+
+    time_t t = time(NULL) - 3600;
+    struct timeval tv[2] = { { t, 0 }, { t, 0 } };
+    return utimes(path, tv);
+}
+
+static double time_loads(const char *path, int iters)
+{
+    kelp_config_t cfg;
+
+    /* One untimed load warms the page cache (and the config cache). */
+    if (kelp_config_load(path, &cfg) != 0)
+        return -1;
+    kelp_config_free(&cfg);
+
+    double t0 = now_sec();
+    for (int i = 0; i < iters; i++) {
+        if (kelp_config_load(path, &cfg) != 0)
+            return -1;
+        kelp_config_free(&cfg);
+    }
+    return now_sec() - t0;
+}
+
+static double time_command(char **argv, int runs)
+{
+    fflush(stdout);
+
+    double t0 = now_sec();
+    for (int i = 0; i < runs; i++) {
+        pid_t pid = fork();
+        if (pid < 0)
+            return -1;
+        if (pid == 0) {
+            if (!freopen("/dev/null", "w", stdout))
+                _exit(127);
+            execvp(argv[0], argv);
+            _exit(127);
+        }
+        int status;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) == 127)
+            return -1;
+    }
+    return now_sec() - t0;
+}
+
+int main(int argc, char **argv)
+{
+    int iters = 2000;
+    char **cmd = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            cmd = &argv[i + 1];
+            break;
+        }
+        iters = atoi(argv[i]);
+    }
+    if (iters <= 0)
+        iters = 2000;
+
+    char dir[] = "/tmp/kelp_bench_cfg_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    char path[PATH_MAX], profiles[PATH_MAX], overlay[PATH_MAX], cache[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/kelp.yaml", dir);
+    snprintf(profiles, sizeof(profiles), "%s/profiles", dir);
+    snprintf(overlay, sizeof(overlay), "%s/work.yaml", profiles);
+    snprintf(cache, sizeof(cache), "%s/cache", dir);
+
+    if (mkdir(profiles, 0755) != 0 || write_file(path, bench_yaml) != 0 ||
+        write_file(overlay, bench_overlay) != 0) {
+        perror("write config");
+        return 1;
+    }
+    setenv("KELP_CACHE_DIR", cache, 1);
+    setenv("KELP_CONFIG_DIR", dir, 1);
+
+    setenv("KELP_CONFIG_CACHE", "0", 1);
+    double parse = time_loads(path, iters);
+    unsetenv("KELP_CONFIG_CACHE");
+    double cached = time_loads(path, iters);
+    if (parse < 0 || cached < 0) {
+        fprintf(stderr, "kelp_config_load failed\n");
+        return 1;
+    }
+
+    printf("kelp_config_load x %d (%zu-byte config + overlay)\n",
+           iters, strlen(bench_yaml));
+    printf("  parse    %8.2f us/load\n", parse / iters * 1e6);
+    printf("  cached   %8.2f us/load  (%.1fx)\n", cached / iters * 1e6,
+           parse / cached);
+
+    if (cmd && cmd[0]) {
+        int runs = iters / 10 > 0 ? iters / 10 : 1;
+
+        setenv("KELP_CONFIG_CACHE", "0", 1);
+        time_command(cmd, 1);
+        double cold = time_command(cmd, runs);
+        unsetenv("KELP_CONFIG_CACHE");
+        time_command(cmd, 1);
+        double warm = time_command(cmd, runs);
+        if (cold < 0 || warm < 0) {
+            fprintf(stderr, "failed to run %s\n", cmd[0]);
+            return 1;
+        }
+
+        printf("\n%s startup x %d\n", cmd[0], runs);
+        printf("  parse    %8.2f ms/run\n", cold / runs * 1e3);
+        printf("  cached   %8.2f ms/run  (%.2fx)\n", warm / runs * 1e3,
+               cold / warm);
+    }
+
+    char cmdline[PATH_MAX + 16];
+    snprintf(cmdline, sizeof(cmdline), "rm -rf '%s'", dir);
+    if (system(cmdline) != 0)
+        fprintf(stderr, "could not remove %s\n", dir);
+    return 0;
+}
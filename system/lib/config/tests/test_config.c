@@ -6,16 +6,23 @@
  */
 
 #include "kelp/config.h"
+#include "kelp/config_snapshot.h"
 #include "kelp/paths.h"
 #include "kelp/schema.h"
 
 #include <cjson/cJSON.h>
 
 #include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 /* ======================================================================== */
@@ -99,6 +106,7 @@ static const char *sample_yaml =
     "  sandbox_memory_mb: 1024\n"
     "  sandbox_cpu_cores: 4\n"
     "  sandbox_max_pids: 128\n"
+    "  audit_segments: true\n"
     "  allowed_paths:\n"
     "    - /home\n"
     "    - /tmp\n"
@@ -153,6 +161,7 @@ test_load_yaml(void)
     ASSERT_EQ_INT(cfg.security.sandbox_memory_mb, 1024);
     ASSERT_EQ_INT(cfg.security.sandbox_cpu_cores, 4);
     ASSERT_EQ_INT(cfg.security.sandbox_max_pids, 128);
+    ASSERT_TRUE(cfg.security.audit_segments);
     ASSERT_EQ_INT(cfg.security.allowed_paths_count, 2);
     ASSERT_EQ_STR(cfg.security.allowed_paths[0], "/home");
     ASSERT_EQ_STR(cfg.security.allowed_paths[1], "/tmp");
@@ -446,6 +455,104 @@ test_schema_validate_bad_range(void)
     cJSON_Delete(root);
 }
 
+static void
+test_schema_prog_matches_validate(void)
+{
+    /* Two failures, listed in the document in reverse schema order. */
+    cJSON *root = cJSON_Parse(
+        "{ \"logging\": { \"level\": 42 },"
+        "  \"gateway\": { \"port\": \"http\", \"host\": 7 } }");
+    ASSERT_NOT_NULL(root);
+
+    kelp_schema_prog_t *prog = kelp_schema_compile(kelp_schema_config());
+    ASSERT_NOT_NULL(prog);
+
+    char err_a[256] = {0}, err_b[256] = {0};
+    ASSERT_EQ_INT(kelp_schema_validate(kelp_schema_config(), root,
+                                       err_a, sizeof(err_a)), -1);
+    ASSERT_EQ_INT(kelp_schema_prog_validate(prog, root, err_b, sizeof(err_b)), -1);
+    ASSERT_EQ_STR(err_b, err_a);
+    ASSERT_EQ_STR(err_b, "field \"gateway.host\": expected type string");
+
+    /* The program is reusable. */
+    cJSON_Delete(root);
+    root = cJSON_Parse("{ \"gateway\": { \"port\": 8080 }, \"profile\": null }");
+    ASSERT_EQ_INT(kelp_schema_prog_validate(prog, root, err_b, sizeof(err_b)), 0);
+    ASSERT_EQ_STR(err_b, "");
+
+    cJSON_Delete(root);
+    kelp_schema_prog_free(prog);
+}
+
+static void
+test_schema_compile_json(void)
+{
+    cJSON *schema = cJSON_Parse(
+        "{\"type\":\"object\",\"properties\":{"
+        "  \"command\":{\"type\":\"string\",\"minLength\":1},"
+        "  \"timeout\":{\"type\":\"integer\",\"maximum\":60000},"
+        "  \"offset\":{\"type\":\"integer\",\"minimum\":0,\"maximum\":0},"
+        "  \"ratio\":{\"type\":\"number\",\"minimum\":0.5,"
+        "              \"maximum\":3000000000},"
+        "  \"tags\":{\"type\":\"array\",\"maxItems\":0},"
+        "  \"env\":{\"type\":\"object\",\"properties\":{"
+        "     \"PATH\":{\"type\":\"string\"}},\"required\":[\"PATH\"]},"
+        "  \"any\":{\"description\":\"untyped\"}"
+        "},\"required\":[\"command\"]}");
+    ASSERT_NOT_NULL(schema);
+
+    kelp_schema_prog_t *prog = kelp_schema_compile_json(schema);
+    cJSON_Delete(schema);
+    ASSERT_NOT_NULL(prog);
+
+    static const struct { const char *doc; const char *err; } cases[] = {
+        { "{\"command\":\"ls\",\"any\":[1]}",       NULL },
+        { "{\"command\":\"ls\",\"env\":{\"PATH\":\"/bin\"}}", NULL },
+        { "{}",                    "missing required field \"command\"" },
+        { "{\"command\":null}",    "missing required field \"command\"" },
+        { "{\"command\":\"\"}",    "field \"command\": string length 0 < min 1" },
+        { "{\"command\":\"ls\",\"timeout\":\"5\"}",
+                                   "field \"timeout\": expected type int" },
+        { "{\"command\":\"ls\",\"timeout\":90000}",
+                                   "field \"timeout\": value 90000 > max 60000" },
+        { "{\"command\":\"ls\",\"env\":{}}",
+                                   "missing required field \"env.PATH\"" },
+        { "{\"command\":\"ls\",\"timeout\":1.5}",
+                                   "field \"timeout\": expected type int" },
+        { "{\"command\":\"ls\",\"timeout\":2e3,\"offset\":0,\"tags\":[]}",
+                                   NULL },
+        { "{\"command\":\"ls\",\"offset\":-1}",
+                                   "field \"offset\": value -1 < min 0" },
+        { "{\"command\":\"ls\",\"offset\":1}",
+                                   "field \"offset\": value 1 > max 0" },
+        { "{\"command\":\"ls\",\"ratio\":0.25}",
+                                   "field \"ratio\": value 0.25 < min 0.5" },
+        { "{\"command\":\"ls\",\"ratio\":2999999999.5}", NULL },
+        { "{\"command\":\"ls\",\"ratio\":3000000001}",
+                                   "field \"ratio\": value 3000000001 > max 3000000000" },
+        { "{\"command\":\"ls\",\"tags\":[1]}",
+                                   "field \"tags\": array length 1 > max 0" },
+        { "[\"ls\"]",              "expected a JSON object" },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        cJSON *doc = cJSON_Parse(cases[i].doc);
+        ASSERT_NOT_NULL(doc);
+        char err[256] = {0};
+        int rc = kelp_schema_prog_validate(prog, doc, err, sizeof(err));
+        if (cases[i].err) {
+            ASSERT_EQ_INT(rc, -1);
+            ASSERT_EQ_STR(err, cases[i].err);
+        } else {
+            ASSERT_EQ_INT(rc, 0);
+        }
+        cJSON_Delete(doc);
+    }
+
+    kelp_schema_prog_free(prog);
+    ASSERT_TRUE(kelp_schema_compile_json(NULL) == NULL);
+}
+
 /* ======================================================================== */
 /* Tests: path resolution                                                    */
 /* ======================================================================== */
@@ -622,6 +729,439 @@ test_free_null(void)
     kelp_config_free(NULL);
 }
 
+/* ======================================================================== */
+/* Tests: snapshots and hot reload                                           */
+/* ======================================================================== */
+
+static void
+test_snapshot_lookup(void)
+{
+    kelp_config_t cfg;
+    ASSERT_EQ_INT(kelp_config_load(tmp_yaml_path, &cfg), 0);
+
+    kelp_config_snapshot_t *snap = kelp_config_snapshot_new(&cfg);
+    ASSERT_NOT_NULL(snap);
+
+    /* The snapshot is a deep copy: it must outlive the source. */
+    kelp_config_free(&cfg);
+
+    ASSERT_EQ_STR(kelp_config_snapshot_get_string(snap, "gateway.host"), "0.0.0.0");
+    ASSERT_EQ_STR(kelp_config_snapshot_get_string(snap, "model.default_provider"),
+                  "anthropic");
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(snap, "gateway.port", 0), 9090);
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(snap, "model.max_tokens", 0), 8192);
+    ASSERT_TRUE(kelp_config_snapshot_get_bool(snap, "security.sandbox_enabled", false));
+    ASSERT_TRUE(kelp_config_snapshot_get_double(snap, "model.temperature", 0.0) == 0.5);
+
+    const kelp_config_t *frozen = kelp_config_snapshot_config(snap);
+    ASSERT_EQ_INT(frozen->security.allowed_paths_count, 2);
+    ASSERT_EQ_STR(frozen->security.allowed_paths[1], "/tmp");
+
+    /* Unknown keys and type mismatches fall back like the plain getters. */
+    ASSERT_TRUE(kelp_config_snapshot_get_string(snap, "gateway.port") == NULL);
+    ASSERT_TRUE(kelp_config_snapshot_get_string(snap, "gateway.hos") == NULL);
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(snap, "gateway.host", -7), -7);
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(snap, "", -7), -7);
+    ASSERT_TRUE(kelp_config_snapshot_get_bool(snap, "no.such.key", true));
+
+    ASSERT_EQ_INT((int)kelp_config_snapshot_generation(snap), 0);
+    kelp_config_snapshot_unref(snap);
+}
+
+static void
+test_snapshot_publish(void)
+{
+    kelp_config_t cfg;
+    ASSERT_EQ_INT(kelp_config_load(tmp_yaml_path, &cfg), 0);
+
+    kelp_config_snapshot_t *a = kelp_config_snapshot_new(&cfg);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ_INT(kelp_config_publish(a), 0);
+
+    kelp_config_guard_t g;
+    const kelp_config_snapshot_t *cur = kelp_config_read_begin(&g);
+    ASSERT_TRUE(cur == a);
+    /* Publishing from inside a read section would deadlock. */
+    ASSERT_EQ_INT(kelp_config_publish(NULL), -1);
+    kelp_config_read_end(&g);
+
+    /* A held reference keeps the old snapshot alive across a swap. */
+    kelp_config_snapshot_t *held = kelp_config_current();
+    ASSERT_TRUE(held == a);
+
+    cfg.gateway.port = 9191;
+    kelp_config_snapshot_t *b = kelp_config_snapshot_new(&cfg);
+    ASSERT_NOT_NULL(b);
+    ASSERT_EQ_INT(kelp_config_publish(b), 0);
+    ASSERT_TRUE(kelp_config_snapshot_generation(b) >
+                kelp_config_snapshot_generation(held));
+
+    cur = kelp_config_read_begin(&g);
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(cur, "gateway.port", 0), 9191);
+    kelp_config_read_end(&g);
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(held, "gateway.port", 0), 9090);
+    kelp_config_snapshot_unref(held);
+
+    ASSERT_EQ_INT(kelp_config_publish(NULL), 0);
+    ASSERT_TRUE(kelp_config_current() == NULL);
+    kelp_config_free(&cfg);
+}
+
+static atomic_bool snapshot_readers_stop;
+
+static void *
+snapshot_reader(void *arg)
+{
+    atomic_long *reads = arg;
+    while (!atomic_load(&snapshot_readers_stop)) {
+        kelp_config_guard_t g;
+        const kelp_config_snapshot_t *snap = kelp_config_read_begin(&g);
+        /* Every published snapshot has port == 10000 + max_tokens. */
+        int port = kelp_config_snapshot_get_int(snap, "gateway.port", 0);
+        int max  = kelp_config_snapshot_get_int(snap, "model.max_tokens", 0);
+        const char *host = kelp_config_snapshot_get_string(snap, "gateway.host");
+        ASSERT_EQ_INT(port, 10000 + max);
+        ASSERT_EQ_STR(host, "0.0.0.0");
+        kelp_config_read_end(&g);
+        atomic_fetch_add(reads, 1);
+    }
+    return NULL;
+}
+
+static bool
+readers_all_ran(atomic_long *reads, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (atomic_load(&reads[i]) < 100)
+            return false;
+    return true;
+}
+
+static void
+test_snapshot_concurrent_readers(void)
+{
+    kelp_config_t cfg;
+    ASSERT_EQ_INT(kelp_config_load(tmp_yaml_path, &cfg), 0);
+
+    cfg.model.max_tokens = 1;
+    cfg.gateway.port     = 10001;
+    ASSERT_EQ_INT(kelp_config_publish(kelp_config_snapshot_new(&cfg)), 0);
+
+    enum { NREADERS = 4 };
+    pthread_t threads[NREADERS];
+    atomic_long reads[NREADERS];
+    atomic_store(&snapshot_readers_stop, false);
+    for (int i = 0; i < NREADERS; i++)
+        atomic_init(&reads[i], 0);
+    for (int i = 0; i < NREADERS; i++)
+        ASSERT_EQ_INT(pthread_create(&threads[i], NULL, snapshot_reader, &reads[i]), 0);
+
+    /* Keep swapping until every reader has overlapped some publishes. */
+    for (int i = 2; i <= 2000 || !readers_all_ran(reads, NREADERS); i++) {
+        cfg.model.max_tokens = i;
+        cfg.gateway.port     = 10000 + i;
+        ASSERT_EQ_INT(kelp_config_publish(kelp_config_snapshot_new(&cfg)), 0);
+    }
+
+    atomic_store(&snapshot_readers_stop, true);
+    for (int i = 0; i < NREADERS; i++)
+        pthread_join(threads[i], NULL);
+
+    kelp_config_publish(NULL);
+    kelp_config_free(&cfg);
+}
+
+static atomic_int watch_reloads;
+
+static void
+on_reload(const kelp_config_snapshot_t *snap, void *userdata)
+{
+    (void)userdata;
+    if (snap)
+        atomic_fetch_add(&watch_reloads, 1);
+}
+
+static void
+test_snapshot_watch_reload(void)
+{
+    char dir[] = "/tmp/kelp_watch_XXXXXX";
+    ASSERT_NOT_NULL(mkdtemp(dir));
+
+    char path[512], tmp[512];
+    snprintf(path, sizeof(path), "%s/kelp.yaml", dir);
+    snprintf(tmp, sizeof(tmp), "%s/kelp.yaml.tmp", dir);
+
+    FILE *fp = fopen(path, "w");
+    ASSERT_NOT_NULL(fp);
+    fputs(sample_yaml, fp);
+    fclose(fp);
+
+    ASSERT_EQ_INT(kelp_config_reload(path), 0);
+
+    /* Reloading inside a read section fails without swapping anything. */
+    kelp_config_guard_t rg;
+    const kelp_config_snapshot_t *before = kelp_config_read_begin(&rg);
+    ASSERT_EQ_INT(kelp_config_reload(path), -1);
+    kelp_config_snapshot_t *now = kelp_config_current();
+    ASSERT_TRUE(now == before);
+    kelp_config_snapshot_unref(now);
+    kelp_config_read_end(&rg);
+
+    ASSERT_EQ_INT(kelp_config_watch_start(path, on_reload, NULL), 0);
+    ASSERT_EQ_INT(kelp_config_watch_start(path, on_reload, NULL), -1);
+
+    /* Replace the file the way editors do: write a temp file, rename it. */
+    fp = fopen(tmp, "w");
+    ASSERT_NOT_NULL(fp);
+    const char *flag = strstr(sample_yaml, "sandbox_enabled: true");
+    ASSERT_NOT_NULL(flag);
+    fprintf(fp, "%.*ssandbox_enabled: false%s", (int)(flag - sample_yaml),
+            sample_yaml, flag + strlen("sandbox_enabled: true"));
+    fclose(fp);
+    ASSERT_EQ_INT(rename(tmp, path), 0);
+
+    bool sandbox = true;
+    for (int i = 0; i < 200 && sandbox; i++) {
+        struct timespec ts = { 0, 10 * 1000 * 1000 };
+        nanosleep(&ts, NULL);
+        kelp_config_guard_t g;
+        const kelp_config_snapshot_t *snap = kelp_config_read_begin(&g);
+        sandbox = kelp_config_snapshot_get_bool(snap, "security.sandbox_enabled", true);
+        kelp_config_read_end(&g);
+    }
+    ASSERT_TRUE(!sandbox);
+
+    /* An invalid file is rejected and the last good snapshot stays. */
+    fp = fopen(path, "w");
+    ASSERT_NOT_NULL(fp);
+    fputs("gateway:\n  port: 99999\n", fp);
+    fclose(fp);
+    ASSERT_EQ_INT(kelp_config_reload(path), -1);
+
+    kelp_config_watch_stop();
+    ASSERT_TRUE(atomic_load(&watch_reloads) >= 1);
+
+    kelp_config_snapshot_t *snap = kelp_config_current();
+    ASSERT_EQ_INT(kelp_config_snapshot_get_int(snap, "gateway.port", 0), 9090);
+    kelp_config_snapshot_unref(snap);
+    kelp_config_publish(NULL);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+/* ======================================================================== */
+/* Tests: binary config cache                                               */
+/* ======================================================================== */
+
+static char cache_root[64];
+
+/** Point KELP_CACHE_DIR at an empty directory under cache_root. */
+static void
+cache_use_dir(const char *name, char *out, size_t len)
+{
+    snprintf(out, len, "%s/%s", cache_root, name);
+    ASSERT_EQ_INT(mkdir(out, 0700), 0);
+    setenv("KELP_CACHE_DIR", out, 1);
+}
+
+/** Path of the single cache file in @p dir, or "" if there is none. */
+static void
+cache_find_file(const char *dir, char *out, size_t len)
+{
+    out[0] = '\0';
+    DIR *d = opendir(dir);
+    ASSERT_NOT_NULL(d);
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, "config-", 7) == 0)
+            snprintf(out, len, "%s/%s", dir, de->d_name);
+    }
+    closedir(d);
+}
+
+/** Write @p text to @p path and backdate it past the racy-clean window. */
+static void
+cache_write_config(const char *path, const char *text, time_t mtime)
+{
+    FILE *fp = fopen(path, "w");
+    ASSERT_NOT_NULL(fp);
+    fputs(text, fp);
+    fclose(fp);
+    struct timeval tv[2] = { { mtime, 0 }, { mtime, 0 } };
+    ASSERT_EQ_INT(utimes(path, tv), 0);
+}
+
+static bool
+file_contains(const char *path, const char *needle)
+{
+    FILE *fp = fopen(path, "rb");
+    ASSERT_NOT_NULL(fp);
+    char buf[16384];
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    return memmem(buf, n, needle, strlen(needle)) != NULL;
+}
+
+static void
+cache_remove_dir(const char *dir)
+{
+    char file[512];
+    for (cache_find_file(dir, file, sizeof(file)); file[0];
+         cache_find_file(dir, file, sizeof(file)))
+        unlink(file);
+    rmdir(dir);
+}
+
+static void
+test_cache_hit_matches_parse(void)
+{
+    char dir[128], cfg_dir[] = "/tmp/kelp_cfgc_XXXXXX", path[512], file[512];
+    cache_use_dir("hit", dir, sizeof(dir));
+    ASSERT_NOT_NULL(mkdtemp(cfg_dir));
+    snprintf(path, sizeof(path), "%s/kelp.yaml", cfg_dir);
+    cache_write_config(path, sample_yaml, time(NULL) - 60);
+
+    /* The sample selects profile "testing"; give it an overlay. */
+    char profiles[512], overlay[600];
+    snprintf(profiles, sizeof(profiles), "%s/profiles", cfg_dir);
+    ASSERT_EQ_INT(mkdir(profiles, 0755), 0);
+    snprintf(overlay, sizeof(overlay), "%s/testing.yaml", profiles);
+    cache_write_config(overlay, "model:\n  max_tokens: 1234\n", time(NULL) - 60);
+
+    setenv("TEST_API_KEY", "sk-secret-from-env", 1);
+
+    kelp_config_t parsed, cached;
+    setenv("KELP_CONFIG_CACHE", "0", 1);
+    ASSERT_EQ_INT(kelp_config_load(path, &parsed), 0);
+    cache_find_file(dir, file, sizeof(file));
+    ASSERT_EQ_STR(file, "");
+    unsetenv("KELP_CONFIG_CACHE");
+
+    ASSERT_EQ_INT(kelp_config_load(path, &cached), 0);   /* fills the cache */
+    kelp_config_free(&cached);
+    cache_find_file(dir, file, sizeof(file));
+    ASSERT_TRUE(file[0] != '\0');
+    struct stat st;
+    ASSERT_EQ_INT(stat(file, &st), 0);
+    ASSERT_EQ_INT((int)(st.st_mode & 0777), 0600);
+
+    /* Documents are cached before substitution. */
+    ASSERT_TRUE(!file_contains(file, "sk-secret-from-env"));
+    ASSERT_TRUE(file_contains(file, "TEST_API_KEY"));
+
+    ASSERT_EQ_INT(kelp_config_load(path, &cached), 0);   /* served from it */
+    ASSERT_EQ_INT(cached.model.max_tokens, 1234);
+    ASSERT_EQ_STR(cached.model.api_key, "sk-secret-from-env");
+    const char *keys[] = {
+        "profile", "gateway.host", "gateway.socket_path", "model.default_model",
+        "model.api_key", "logging.file",
+    };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        ASSERT_EQ_STR(kelp_config_get_string(&cached, keys[i]),
+                      kelp_config_get_string(&parsed, keys[i]));
+    ASSERT_EQ_INT(cached.gateway.port, parsed.gateway.port);
+    ASSERT_EQ_INT(cached.model.max_tokens, parsed.model.max_tokens);
+    ASSERT_TRUE(cached.model.temperature == parsed.model.temperature);
+    ASSERT_EQ_INT(cached.security.allowed_paths_count,
+                  parsed.security.allowed_paths_count);
+    ASSERT_EQ_STR(cached.security.allowed_paths[1], parsed.security.allowed_paths[1]);
+    ASSERT_EQ_INT(cached.logging.level, parsed.logging.level);
+
+    /* The environment is still read on every load. */
+    setenv("TEST_API_KEY", "sk-rotated", 1);
+    kelp_config_free(&cached);
+    ASSERT_EQ_INT(kelp_config_load(path, &cached), 0);
+    ASSERT_EQ_STR(cached.model.api_key, "sk-rotated");
+
+    unsetenv("TEST_API_KEY");
+    kelp_config_free(&cached);
+    kelp_config_free(&parsed);
+    unlink(overlay);
+    rmdir(profiles);
+    unlink(path);
+    rmdir(cfg_dir);
+    cache_remove_dir(dir);
+}
+
+static void
+test_cache_invalidated_by_change(void)
+{
+    char dir[128], path[512];
+    cache_use_dir("stale", dir, sizeof(dir));
+    snprintf(path, sizeof(path), "%s/kelp.yaml", dir);
+
+    time_t t = time(NULL) - 60;
+    cache_write_config(path, "gateway:\n  port: 1111\n", t);
+
+    kelp_config_t cfg;
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.gateway.port, 1111);
+    kelp_config_free(&cfg);
+
+    /* Same size, later mtime. */
+    cache_write_config(path, "gateway:\n  port: 2222\n", t + 1);
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.gateway.port, 2222);
+    kelp_config_free(&cfg);
+
+    /* Same size and even the same mtime: the ctime still moves. */
+    cache_write_config(path, "gateway:\n  port: 3333\n", t + 1);
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.gateway.port, 3333);
+    kelp_config_free(&cfg);
+
+    /* A file that has just been written is parsed but not cached. */
+    cache_write_config(path, "gateway:\n  port: 4444\n", time(NULL));
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.gateway.port, 4444);
+    kelp_config_free(&cfg);
+
+    unlink(path);
+    cache_remove_dir(dir);
+}
+
+static void
+test_cache_corrupt_falls_back(void)
+{
+    char dir[128], path[512], file[512];
+    cache_use_dir("corrupt", dir, sizeof(dir));
+    snprintf(path, sizeof(path), "%s/kelp.yaml", dir);
+    cache_write_config(path, sample_yaml, time(NULL) - 60);
+
+    kelp_config_t cfg;
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    kelp_config_free(&cfg);
+    cache_find_file(dir, file, sizeof(file));
+    ASSERT_TRUE(file[0] != '\0');
+
+    struct stat st;
+    ASSERT_EQ_INT(stat(file, &st), 0);
+
+    /* Flip a byte in the middle of the payload. */
+    int fd = open(file, O_RDWR);
+    ASSERT_TRUE(fd >= 0);
+    char c;
+    ASSERT_EQ_INT((int)pread(fd, &c, 1, st.st_size / 2), 1);
+    c ^= 0x5a;
+    ASSERT_EQ_INT((int)pwrite(fd, &c, 1, st.st_size / 2), 1);
+    close(fd);
+
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.gateway.port, 9090);
+    ASSERT_EQ_STR(cfg.logging.file, "/var/log/kelp/test.log");
+    kelp_config_free(&cfg);
+
+    /* Truncated to less than a header. */
+    ASSERT_EQ_INT(truncate(file, 5), 0);
+    ASSERT_EQ_INT(kelp_config_load(path, &cfg), 0);
+    ASSERT_EQ_INT(cfg.security.sandbox_max_pids, 128);
+    kelp_config_free(&cfg);
+
+    unlink(path);
+    cache_remove_dir(dir);
+}
+
 /* ======================================================================== */
 /* Main                                                                      */
 /* ======================================================================== */
@@ -635,6 +1175,11 @@ main(void)
     /* Set up temp files */
     write_temp_yaml();
 
+    /* Keep config caches out of the user's cache directory. */
+    snprintf(cache_root, sizeof(cache_root), "/tmp/kelp_cache_XXXXXX");
+    ASSERT_NOT_NULL(mkdtemp(cache_root));
+    setenv("KELP_CACHE_DIR", cache_root, 1);
+
     /* Config loading */
     printf("Config loading:\n");
     RUN_TEST(test_load_yaml);
@@ -666,6 +1211,22 @@ main(void)
     RUN_TEST(test_schema_validate_good);
     RUN_TEST(test_schema_validate_bad_type);
     RUN_TEST(test_schema_validate_bad_range);
+    RUN_TEST(test_schema_prog_matches_validate);
+    RUN_TEST(test_schema_compile_json);
+
+    /* Snapshots */
+    printf("\nSnapshots and hot reload:\n");
+    RUN_TEST(test_snapshot_lookup);
+    RUN_TEST(test_snapshot_publish);
+    RUN_TEST(test_snapshot_concurrent_readers);
+    RUN_TEST(test_snapshot_watch_reload);
+
+    /* Binary cache */
+    printf("\nBinary config cache:\n");
+    RUN_TEST(test_cache_hit_matches_parse);
+    RUN_TEST(test_cache_invalidated_by_change);
+    RUN_TEST(test_cache_corrupt_falls_back);
+    setenv("KELP_CACHE_DIR", cache_root, 1);
 
     /* Path resolution */
     printf("\nPath resolution:\n");
@@ -683,6 +1244,7 @@ main(void)
 
     /* Cleanup */
     cleanup_temp();
+    cache_remove_dir(cache_root);
 
     printf("\n==========================\n");
     printf("Results: %d/%d passed\n", tests_passed, tests_run);
@@ -2,12 +2,20 @@
  * kelp-linux :: libkelp-core
  * log.h - Thread-safe logging
  *
+ * The KELP_* macros never take a lock: filtered levels cost one atomic
+ * load, and emitted lines are formatted in a per-thread buffer.  By default
+ * each line is written straight to the output stream; after
+ * kelp_log_start_async() lines are queued to a background flusher instead.
+ *
  * SPDX-License-Identifier: MIT
  */
 
 #ifndef KELP_LOG_H
 #define KELP_LOG_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -41,6 +49,73 @@ void kelp_log_set_level(int level);
  */
 void kelp_log_set_file(FILE *fp);
 
+/** Current minimum severity. */
+int kelp_log_get_level(void);
+
+/** Would a message at `level` be emitted? */
+bool kelp_log_enabled(int level);
+
+/** Output formats for kelp_log_set_format(). */
+enum {
+    KELP_LOG_FORMAT_TEXT = 0,   /* [ts] [LEVEL] [file:line] message       */
+    KELP_LOG_FORMAT_JSON        /* one JSON object per line               */
+};
+
+/** Select the line format (KELP_LOG_FORMAT_TEXT by default). */
+void kelp_log_set_format(int format);
+
+/**
+ * Start the background flusher.
+ *
+ * From now on the macros copy each formatted line into a lock-free ring of
+ * `ring_size` slots (0 = 1024) and return; a flusher thread writes the
+ * queued lines in batches.  If the ring is full the line is dropped and
+ * counted.  FATAL messages wait until they have been written.
+ *
+ * Call after any fork()/daemonisation -- the thread does not survive it.
+ *
+ * @return 0 on success, -1 on error (logging stays synchronous).
+ */
+int kelp_log_start_async(size_t ring_size);
+
+/** Write out everything queued and go back to synchronous writes. */
+void kelp_log_stop_async(void);
+
+/** Wait until every line logged before this call has been written. */
+void kelp_log_flush(void);
+
+/** Logger counters. */
+typedef struct {
+    uint64_t written;      /* lines written to the stream              */
+    uint64_t dropped;      /* lines lost to a full async ring          */
+    uint64_t truncated;    /* lines cut at the line-length limit       */
+    uint64_t suppressed;   /* lines withheld by a rate limiter         */
+    uint64_t batches;      /* flusher write batches                    */
+} kelp_log_stats_t;
+
+/** Read the logger counters. */
+void kelp_log_get_stats(kelp_log_stats_t *out);
+
+/**
+ * Per-call-site rate limiter state; zero-initialise.  Updated atomically
+ * by kelp_log_ratelimit().
+ */
+typedef struct {
+    uint64_t window;       /* second the current window started        */
+    unsigned count;        /* messages seen in this window             */
+    unsigned suppressed;   /* messages withheld since the last report  */
+} kelp_log_ratelimit_t;
+
+/**
+ * Allow at most `per_sec` messages per second through `rl`.  When a new
+ * window opens after messages were withheld, a summary line is logged at
+ * `level` on behalf of `file`:`line`.  Prefer KELP_LOG_RATELIMITED().
+ *
+ * @return true if the caller should log.
+ */
+bool kelp_log_ratelimit(kelp_log_ratelimit_t *rl, unsigned per_sec,
+                        int level, const char *file, int line);
+
 /**
  * Low-level write function -- prefer the macros below.
  */
@@ -68,6 +143,20 @@ void kelp_log_write(int level, const char *file, int line,
 #define KELP_FATAL(fmt, ...) \
     kelp_log_write(KELP_LOG_FATAL, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
 
+/**
+ * Log at `level`, but at most `per_sec` times per second from this call
+ * site, e.g. KELP_LOG_RATELIMITED(KELP_LOG_WARN, 5, "queue full").
+ */
+#define KELP_LOG_RATELIMITED(level, per_sec, fmt, ...) \
+    do { \
+        static kelp_log_ratelimit_t kelp_rl_; \
+        if (kelp_log_enabled(level) && \
+            kelp_log_ratelimit(&kelp_rl_, (per_sec), (level), \
+                               __FILE__, __LINE__)) \
+            kelp_log_write((level), __FILE__, __LINE__, fmt, \
+                           ##__VA_ARGS__); \
+    } while (0)
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,33 +2,92 @@
  * kelp-linux :: libkelp-core
  * log.c - Thread-safe logging
  *
+ * The hot path takes no lock.  The level is an atomic checked before
+ * anything else, each thread formats into its own buffer (with a cached
+ * per-second timestamp), and the finished line is either written with a
+ * single fwrite() (synchronous mode, the default) or copied into a slot of
+ * a bounded lock-free MPSC ring that a background flusher drains in
+ * batches (asynchronous mode, see kelp_log_start_async()).
+ *
  * SPDX-License-Identifier: MIT
  */
 
 #include <kelp/log.h>
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+/* ---- limits ------------------------------------------------------------- */
+
+#define LOG_LINE_MAX          2048   /* longer lines are truncated          */
+#define LOG_DEFAULT_RING      1024
+#define LOG_FLUSH_INTERVAL_MS 100
+#define LOG_TRUNC_MARK        "...\n"
+
+/* ---- internal types ----------------------------------------------------- */
+
+typedef struct {
+    _Atomic size_t seq;
+    size_t         len;
+    char           line[LOG_LINE_MAX];
+} ring_cell_t;
+
 /* ---- module state ------------------------------------------------------- */
 
 static struct {
-    pthread_mutex_t mutex;
-    FILE           *fp;
-    const char     *name;
-    int             level;
-    int             initialised;
+    pthread_mutex_t  mutex;        /* configuration changes only          */
+    _Atomic(FILE *)  fp;           /* NULL => stderr                      */
+    _Atomic(const char *) name;
+    _Atomic int      level;
+    _Atomic int      format;
+    int              initialised;
+
+    /* async flusher */
+    _Atomic int      async;
+    _Atomic int      producers;    /* writers inside the async path       */
+    ring_cell_t     *ring;
+    size_t           ring_mask;
+    _Atomic size_t   tail;
+    size_t           head;         /* flusher thread only                 */
+    pthread_t        flusher;
+    pthread_mutex_t  wake_mutex;
+    pthread_cond_t   wake_cond;
+    pthread_cond_t   idle_cond;
+    _Atomic int      flusher_sleeping;
+    int              stopping;     /* under wake_mutex */
+    uint64_t         flush_req;    /* under wake_mutex */
+    uint64_t         flush_done;   /* under wake_mutex */
+
+    /* counters */
+    _Atomic uint64_t written;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t truncated;
+    _Atomic uint64_t suppressed;
+    _Atomic uint64_t batches;
 } g_log = {
     .mutex       = PTHREAD_MUTEX_INITIALIZER,
-    .fp          = NULL,   /* NULL => stderr */
+    .fp          = NULL,
     .name        = "kelp",
     .level       = KELP_LOG_INFO,
+    .format      = KELP_LOG_FORMAT_TEXT,
     .initialised = 0,
+    .wake_mutex  = PTHREAD_MUTEX_INITIALIZER,
+    .wake_cond   = PTHREAD_COND_INITIALIZER,
+    .idle_cond   = PTHREAD_COND_INITIALIZER,
 };
 
+/* Per-thread formatting state. */
+static _Thread_local char   tls_line[LOG_LINE_MAX];
+static _Thread_local char   tls_ts[32];
+static _Thread_local time_t tls_ts_sec = (time_t)-1;
+
 /* ---- helpers ------------------------------------------------------------ */
 
 static const char *level_label(int level)
@@ -44,12 +103,288 @@ static const char *level_label(int level)
     }
 }
 
-static void timestamp(char *buf, size_t cap)
+static const char *level_name(int level)
+{
+    switch (level) {
+    case KELP_LOG_TRACE: return "trace";
+    case KELP_LOG_DEBUG: return "debug";
+    case KELP_LOG_INFO:  return "info";
+    case KELP_LOG_WARN:  return "warn";
+    case KELP_LOG_ERROR: return "error";
+    case KELP_LOG_FATAL: return "fatal";
+    default:              return "unknown";
+    }
+}
+
+/** Thread-local timestamp, reformatted at most once per second. */
+static const char *timestamp(void)
 {
     time_t now = time(NULL);
-    struct tm tm;
-    localtime_r(&now, &tm);
-    strftime(buf, cap, "%Y-%m-%d %H:%M:%S", &tm);
+    if (now != tls_ts_sec) {
+        struct tm tm;
+        localtime_r(&now, &tm);
+        strftime(tls_ts, sizeof(tls_ts), "%Y-%m-%d %H:%M:%S", &tm);
+        tls_ts_sec = now;
+    }
+    return tls_ts;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/**
+ * Escape tls_line[from..len) in place as a JSON string body.  Works from
+ * the end so no scratch buffer is needed; stops growing at the line limit.
+ */
+static size_t json_escape_tail(size_t from, size_t len, size_t cap)
+{
+    size_t extra = 0;
+    for (size_t i = from; i < len; i++) {
+        unsigned char c = (unsigned char)tls_line[i];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\t' || c == '\r')
+            extra += 1;
+        else if (c < 0x20)
+            extra += 5;
+    }
+
+    /* Drop trailing message bytes until the escaped form fits. */
+    while (len > from && len + extra > cap) {
+        unsigned char c = (unsigned char)tls_line[--len];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\t' || c == '\r')
+            extra -= 1;
+        else if (c < 0x20)
+            extra -= 5;
+    }
+
+    size_t dst = len + extra;
+    for (size_t i = len; i-- > from; ) {
+        unsigned char c = (unsigned char)tls_line[i];
+        const char *esc = NULL;
+        char hex[7];
+
+        switch (c) {
+        case '"':  esc = "\\\""; break;
+        case '\\': esc = "\\\\"; break;
+        case '\n': esc = "\\n";  break;
+        case '\t': esc = "\\t";  break;
+        case '\r': esc = "\\r";  break;
+        default:
+            if (c < 0x20) {
+                snprintf(hex, sizeof(hex), "\\u%04x", c);
+                esc = hex;
+            }
+            break;
+        }
+
+        if (esc) {
+            size_t n = strlen(esc);
+            dst -= n;
+            memcpy(tls_line + dst, esc, n);
+        } else {
+            tls_line[--dst] = (char)c;
+        }
+    }
+    return len + extra;
+}
+
+/**
+ * Format one record into tls_line.
+ *
+ * @return Length of the line, including the trailing newline.
+ */
+static size_t format_line(int level, const char *file, int line,
+                          const char *fmt, va_list ap)
+{
+    /* Shorten the file path to just the basename for readability. */
+    const char *base = file ? file : "?";
+    const char *slash = file ? strrchr(file, '/') : NULL;
+    if (slash)
+        base = slash + 1;
+
+    const size_t cap = sizeof(tls_line) - 1;   /* room for '\n' */
+    bool json = atomic_load_explicit(&g_log.format, memory_order_relaxed) ==
+                KELP_LOG_FORMAT_JSON;
+    int n;
+
+    if (json) {
+        n = snprintf(tls_line, cap,
+                     "{\"ts\":\"%s\",\"level\":\"%s\",\"name\":\"%s\","
+                     "\"file\":\"%s\",\"line\":%d,\"msg\":\"",
+                     timestamp(), level_name(level),
+                     atomic_load_explicit(&g_log.name, memory_order_relaxed),
+                     base, line);
+    } else {
+        n = snprintf(tls_line, cap, "[%s] [%s] [%s:%d] ",
+                     timestamp(), level_label(level), base, line);
+    }
+    size_t len = n < 0 ? 0 : ((size_t)n < cap ? (size_t)n : cap - 1);
+    size_t msg_start = len;
+
+    n = vsnprintf(tls_line + len, cap - len, fmt, ap);
+    bool trunc = n < 0 || (size_t)n >= cap - len;
+    len += trunc ? (n < 0 ? 0 : cap - len - 1) : (size_t)n;
+
+    if (json) {
+        len = json_escape_tail(msg_start, len, cap - 2);
+        memcpy(tls_line + len, "\"}", 2);
+        len += 2;
+    }
+
+    if (trunc) {
+        atomic_fetch_add_explicit(&g_log.truncated, 1, memory_order_relaxed);
+        if (!json) {
+            size_t mark = sizeof(LOG_TRUNC_MARK) - 1;
+            memcpy(tls_line + cap + 1 - mark, LOG_TRUNC_MARK, mark);
+            return cap + 1;
+        }
+    }
+
+    tls_line[len++] = '\n';
+    return len;
+}
+
+static void write_sync(const char *line, size_t len)
+{
+    FILE *out = atomic_load_explicit(&g_log.fp, memory_order_acquire);
+    if (!out)
+        out = stderr;
+
+    /* One fwrite per line: stdio's own stream lock keeps lines whole. */
+    flockfile(out);
+    fwrite_unlocked(line, 1, len, out);
+    fflush_unlocked(out);
+    funlockfile(out);
+
+    atomic_fetch_add_explicit(&g_log.written, 1, memory_order_relaxed);
+}
+
+/* ---- async: ring -------------------------------------------------------- */
+
+static bool ring_push(const char *line, size_t len)
+{
+    size_t pos = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+
+    for (;;) {
+        ring_cell_t *cell = &g_log.ring[pos & g_log.ring_mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_log.tail, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy(cell->line, line, len);
+                cell->len = len;
+                atomic_store_explicit(&cell->seq, pos + 1,
+                                      memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;   /* full */
+        } else {
+            pos = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+        }
+    }
+}
+
+/** Flusher thread only. */
+static ring_cell_t *ring_peek(void)
+{
+    ring_cell_t *cell = &g_log.ring[g_log.head & g_log.ring_mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    return seq == g_log.head + 1 ? cell : NULL;
+}
+
+/** Flusher thread only: hand the slot back to producers. */
+static void ring_release(ring_cell_t *cell)
+{
+    atomic_store_explicit(&cell->seq, g_log.head + g_log.ring_mask + 1,
+                          memory_order_release);
+    g_log.head++;
+}
+
+static void wake_flusher(void)
+{
+    /* Pairs with the fence in flusher_main(). */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_log.flusher_sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&g_log.wake_mutex);
+        pthread_cond_signal(&g_log.wake_cond);
+        pthread_mutex_unlock(&g_log.wake_mutex);
+    }
+}
+
+/* ---- async: flusher thread ---------------------------------------------- */
+
+/** Write every queued line; returns the number written. */
+static size_t drain(void)
+{
+    FILE *out = atomic_load_explicit(&g_log.fp, memory_order_acquire);
+    if (!out)
+        out = stderr;
+
+    size_t n = 0;
+    ring_cell_t *cell;
+
+    flockfile(out);
+    while ((cell = ring_peek()) != NULL) {
+        fwrite_unlocked(cell->line, 1, cell->len, out);
+        ring_release(cell);
+        n++;
+    }
+    if (n)
+        fflush_unlocked(out);
+    funlockfile(out);
+
+    if (n) {
+        atomic_fetch_add_explicit(&g_log.written, n, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_log.batches, 1, memory_order_relaxed);
+    }
+    return n;
+}
+
+static void *flusher_main(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        drain();
+
+        pthread_mutex_lock(&g_log.wake_mutex);
+
+        atomic_store(&g_log.flusher_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!ring_peek()) {
+            if (g_log.flush_done != g_log.flush_req) {
+                g_log.flush_done = g_log.flush_req;
+                pthread_cond_broadcast(&g_log.idle_cond);
+            }
+            if (g_log.stopping) {
+                atomic_store(&g_log.flusher_sleeping, 0);
+                pthread_mutex_unlock(&g_log.wake_mutex);
+                break;
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&g_log.wake_cond, &g_log.wake_mutex, &ts);
+        }
+        atomic_store(&g_log.flusher_sleeping, 0);
+
+        pthread_mutex_unlock(&g_log.wake_mutex);
+    }
+
+    return NULL;
 }
 
 /* ---- public API --------------------------------------------------------- */
@@ -58,58 +393,199 @@ void kelp_log_init(const char *name, int level)
 {
     pthread_mutex_lock(&g_log.mutex);
     if (name)
-        g_log.name = name;
-    g_log.level       = level;
+        atomic_store(&g_log.name, name);
+    atomic_store(&g_log.level, level);
     g_log.initialised = 1;
     pthread_mutex_unlock(&g_log.mutex);
 }
 
 void kelp_log_set_level(int level)
 {
-    pthread_mutex_lock(&g_log.mutex);
-    g_log.level = level;
-    pthread_mutex_unlock(&g_log.mutex);
+    atomic_store_explicit(&g_log.level, level, memory_order_relaxed);
+}
+
+int kelp_log_get_level(void)
+{
+    return atomic_load_explicit(&g_log.level, memory_order_relaxed);
 }
 
 void kelp_log_set_file(FILE *fp)
 {
-    pthread_mutex_lock(&g_log.mutex);
-    g_log.fp = fp;
-    pthread_mutex_unlock(&g_log.mutex);
+    /* Queued lines belong to the old stream. */
+    kelp_log_flush();
+    atomic_store_explicit(&g_log.fp, fp, memory_order_release);
+}
+
+void kelp_log_set_format(int format)
+{
+    atomic_store_explicit(&g_log.format, format, memory_order_relaxed);
+}
+
+bool kelp_log_enabled(int level)
+{
+    return level >= atomic_load_explicit(&g_log.level, memory_order_relaxed);
 }
 
 void kelp_log_write(int level, const char *file, int line,
                      const char *fmt, ...)
 {
+    if (level < atomic_load_explicit(&g_log.level, memory_order_relaxed))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    size_t len = format_line(level, file, line, fmt, ap);
+    va_end(ap);
+
+    atomic_fetch_add(&g_log.producers, 1);
+    if (atomic_load(&g_log.async)) {
+        bool queued = ring_push(tls_line, len);
+        atomic_fetch_sub(&g_log.producers, 1);
+
+        if (!queued)
+            atomic_fetch_add_explicit(&g_log.dropped, 1,
+                                      memory_order_relaxed);
+        wake_flusher();
+
+        /* Don't lose the last words before an abort. */
+        if (level >= KELP_LOG_FATAL)
+            kelp_log_flush();
+        return;
+    }
+    atomic_fetch_sub(&g_log.producers, 1);
+
+    write_sync(tls_line, len);
+}
+
+int kelp_log_start_async(size_t ring_size)
+{
+    if (ring_size == 0)
+        ring_size = LOG_DEFAULT_RING;
+
+    size_t cap = 2;
+    while (cap < ring_size)
+        cap <<= 1;
+
     pthread_mutex_lock(&g_log.mutex);
 
-    if (level < g_log.level) {
+    if (atomic_load(&g_log.async)) {
         pthread_mutex_unlock(&g_log.mutex);
-        return;
+        return 0;
     }
 
-    FILE *out = g_log.fp ? g_log.fp : stderr;
+    g_log.ring = calloc(cap, sizeof(ring_cell_t));
+    if (!g_log.ring) {
+        pthread_mutex_unlock(&g_log.mutex);
+        return -1;
+    }
+    for (size_t i = 0; i < cap; i++)
+        atomic_init(&g_log.ring[i].seq, i);
+    g_log.ring_mask = cap - 1;
+    atomic_store(&g_log.tail, 0);
+    g_log.head = 0;
 
-    /* Shorten the file path to just the basename for readability. */
-    const char *base = file;
-    if (file) {
-        const char *slash = strrchr(file, '/');
-        if (slash)
-            base = slash + 1;
+    pthread_mutex_lock(&g_log.wake_mutex);
+    g_log.stopping   = 0;
+    g_log.flush_req  = 0;
+    g_log.flush_done = 0;
+    pthread_mutex_unlock(&g_log.wake_mutex);
+
+    if (pthread_create(&g_log.flusher, NULL, flusher_main, NULL) != 0) {
+        free(g_log.ring);
+        g_log.ring = NULL;
+        pthread_mutex_unlock(&g_log.mutex);
+        return -1;
     }
 
-    char ts[32];
-    timestamp(ts, sizeof(ts));
+    atomic_store(&g_log.async, 1);
 
-    fprintf(out, "[%s] [%s] [%s:%d] ", ts, level_label(level), base, line);
+    pthread_mutex_unlock(&g_log.mutex);
+    return 0;
+}
 
-    va_list ap;
-    va_start(ap, fmt);
-    vfprintf(out, fmt, ap);
-    va_end(ap);
+void kelp_log_stop_async(void)
+{
+    pthread_mutex_lock(&g_log.mutex);
+
+    if (!atomic_load(&g_log.async)) {
+        pthread_mutex_unlock(&g_log.mutex);
+        return;
+    }
+
+    /* New writers go synchronous; wait out the ones already queueing. */
+    atomic_store(&g_log.async, 0);
+    while (atomic_load(&g_log.producers) > 0)
+        sched_yield();
+
+    pthread_mutex_lock(&g_log.wake_mutex);
+    g_log.stopping = 1;
+    pthread_cond_signal(&g_log.wake_cond);
+    pthread_mutex_unlock(&g_log.wake_mutex);
+    pthread_join(g_log.flusher, NULL);
+
+    free(g_log.ring);
+    g_log.ring = NULL;
 
-    fputc('\n', out);
-    fflush(out);
+    /* Release any kelp_log_flush() that raced the shutdown. */
+    pthread_mutex_lock(&g_log.wake_mutex);
+    g_log.flush_done = g_log.flush_req;
+    pthread_cond_broadcast(&g_log.idle_cond);
+    pthread_mutex_unlock(&g_log.wake_mutex);
 
     pthread_mutex_unlock(&g_log.mutex);
 }
+
+void kelp_log_flush(void)
+{
+    pthread_mutex_lock(&g_log.wake_mutex);
+    if (!atomic_load(&g_log.async) || g_log.stopping) {
+        pthread_mutex_unlock(&g_log.wake_mutex);
+        FILE *out = atomic_load(&g_log.fp);
+        fflush(out ? out : stderr);
+        return;
+    }
+
+    uint64_t ticket = ++g_log.flush_req;
+    pthread_cond_signal(&g_log.wake_cond);
+    while (g_log.flush_done < ticket)
+        pthread_cond_wait(&g_log.idle_cond, &g_log.wake_mutex);
+    pthread_mutex_unlock(&g_log.wake_mutex);
+}
+
+bool kelp_log_ratelimit(kelp_log_ratelimit_t *rl, unsigned per_sec,
+                        int level, const char *file, int line)
+{
+    uint64_t sec = now_ms() / 1000;
+    uint64_t window = __atomic_load_n(&rl->window, __ATOMIC_RELAXED);
+
+    if (window != sec &&
+        __atomic_compare_exchange_n(&rl->window, &window, sec, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* We opened a new one-second window. */
+        __atomic_store_n(&rl->count, 0, __ATOMIC_RELAXED);
+        unsigned missed = __atomic_exchange_n(&rl->suppressed, 0,
+                                              __ATOMIC_RELAXED);
+        if (missed)
+            kelp_log_write(level, file, line,
+                           "(%u similar messages suppressed)", missed);
+    }
+
+    if (__atomic_add_fetch(&rl->count, 1, __ATOMIC_RELAXED) <= per_sec)
+        return true;
+
+    __atomic_add_fetch(&rl->suppressed, 1, __ATOMIC_RELAXED);
+    atomic_fetch_add_explicit(&g_log.suppressed, 1, memory_order_relaxed);
+    return false;
+}
+
+void kelp_log_get_stats(kelp_log_stats_t *out)
+{
+    if (!out)
+        return;
+
+    out->written    = atomic_load_explicit(&g_log.written, memory_order_relaxed);
+    out->dropped    = atomic_load_explicit(&g_log.dropped, memory_order_relaxed);
+    out->truncated  = atomic_load_explicit(&g_log.truncated, memory_order_relaxed);
+    out->suppressed = atomic_load_explicit(&g_log.suppressed, memory_order_relaxed);
+    out->batches    = atomic_load_explicit(&g_log.batches, memory_order_relaxed);
+}
@@ -12,6 +12,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -447,6 +448,14 @@ static void test_json(void)
 /* log                                                                       */
 /* ======================================================================== */
 
+static void *log_worker(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < 500; i++)
+        KELP_DEBUG("worker line %d", i);
+    return NULL;
+}
+
 static void test_log(void)
 {
     printf("--- log ---\n");
@@ -517,6 +526,156 @@ static void test_log(void)
         unlink(path);
     }
     PASS();
+
+    TEST(log_async_flusher);
+    {
+        char path[] = "/tmp/kelp_test_log3_XXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        FILE *fp = fopen(path, "w");
+        assert(fp != NULL);
+        kelp_log_set_file(fp);
+        kelp_log_set_level(KELP_LOG_DEBUG);
+
+        kelp_log_stats_t before, after;
+        kelp_log_get_stats(&before);
+
+        assert(kelp_log_start_async(4096) == 0);
+        pthread_t th[4];
+        for (int i = 0; i < 4; i++)
+            pthread_create(&th[i], NULL, log_worker, NULL);
+        for (int i = 0; i < 4; i++)
+            pthread_join(th[i], NULL);
+        KELP_TRACE("filtered");
+        kelp_log_flush();
+        kelp_log_stop_async();
+
+        kelp_log_get_stats(&after);
+        fclose(fp);
+
+        fp = fopen(path, "r");
+        char line[512];
+        int lines = 0, bad = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            lines++;
+            if (line[0] != '[' || !strstr(line, "worker line"))
+                bad++;
+        }
+        fclose(fp);
+
+        uint64_t dropped = after.dropped - before.dropped;
+        assert(bad == 0);
+        assert((uint64_t)lines + dropped == 4 * 500);
+        assert(after.written - before.written == (uint64_t)lines);
+
+        kelp_log_set_file(NULL);
+        kelp_log_set_level(KELP_LOG_INFO);
+        unlink(path);
+    }
+    PASS();
+
+    TEST(log_json_format);
+    {
+        char path[] = "/tmp/kelp_test_log4_XXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        FILE *fp = fopen(path, "w");
+        kelp_log_set_file(fp);
+        kelp_log_set_format(KELP_LOG_FORMAT_JSON);
+
+        KELP_WARN("quote \" slash \\ nl \n end");
+
+        kelp_log_set_format(KELP_LOG_FORMAT_TEXT);
+        fclose(fp);
+
+        fp = fopen(path, "r");
+        char line[512] = {0};
+        char *got = fgets(line, sizeof(line), fp);
+        fclose(fp);
+
+        assert(got != NULL);
+        assert(strncmp(line, "{\"ts\":\"", 7) == 0);
+        assert(strstr(line, "\"level\":\"warn\"") != NULL);
+        assert(strstr(line, "\"file\":\"test_core.c\"") != NULL);
+        assert(strstr(line, "\"msg\":\"quote \\\" slash \\\\ nl \\n end\"}\n")
+               != NULL);
+
+        kelp_log_set_file(NULL);
+        unlink(path);
+    }
+    PASS();
+
+    TEST(log_long_line_truncated);
+    {
+        char path[] = "/tmp/kelp_test_log5_XXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        FILE *fp = fopen(path, "w");
+        kelp_log_set_file(fp);
+
+        char big[5000];
+        memset(big, 'x', sizeof(big) - 1);
+        big[sizeof(big) - 1] = '\0';
+        KELP_INFO("%s", big);
+        KELP_INFO("next");
+        fclose(fp);
+
+        fp = fopen(path, "r");
+        static char line[8192];
+        int lines = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            lines++;
+            if (lines == 1)
+                assert(strstr(line, "xxx...\n") != NULL);
+        }
+        fclose(fp);
+        assert(lines == 2);
+
+        kelp_log_set_file(NULL);
+        unlink(path);
+    }
+    PASS();
+
+    TEST(log_ratelimited);
+    {
+        char path[] = "/tmp/kelp_test_log6_XXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        FILE *fp = fopen(path, "w");
+        kelp_log_set_file(fp);
+
+        kelp_log_ratelimit_t rl = {0};
+        int allowed = 0;
+        for (int i = 0; i < 100; i++) {
+            if (kelp_log_ratelimit(&rl, 5, KELP_LOG_WARN, __FILE__, __LINE__))
+                allowed++;
+        }
+        /* The loop may straddle a second boundary. */
+        assert(allowed >= 5 && allowed <= 10);
+
+        for (int i = 0; i < 100; i++)
+            KELP_LOG_RATELIMITED(KELP_LOG_WARN, 3, "noisy %d", i);
+        fclose(fp);
+
+        fp = fopen(path, "r");
+        char line[512];
+        int lines = 0;
+        while (fgets(line, sizeof(line), fp)) lines++;
+        fclose(fp);
+        assert(lines >= 3 && lines <= 8);
+
+        kelp_log_set_file(NULL);
+        unlink(path);
+    }
+    PASS();
 }
 
 /* ======================================================================== */
@@ -13,6 +13,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,15 +69,17 @@ struct kelp_kstatus {
 #define KELP_INFER_FLAG_URGENT     (1 << 0)
 #define KELP_INFER_FLAG_BATCH      (1 << 1)
 #define KELP_INFER_FLAG_STREAM     (1 << 2)
+#define KELP_INFER_PRIORITY_MIN    (-1000)
+#define KELP_INFER_PRIORITY_MAX    1000
 
 struct kelp_infer_task {
     uint64_t task_id;
-    int32_t  priority;
+    int32_t  priority;          /* KELP_INFER_PRIORITY_MIN..MAX */
     uint32_t est_tokens;
     char     model_hint[KELP_INFER_MODEL_HINT_LEN];
     uint64_t submit_time_ns;
     uint32_t flags;
-    uint32_t _reserved;
+    uint32_t deadline_ms;       /* due this long after submit, 0 = none */
 };
 
 #define KELP_SEMFS_PATH_MAX     256
@@ -97,13 +101,16 @@ struct kelp_fs_event {
 
 struct kelp_semfs_batch {
     uint32_t count;
-    uint32_t _reserved;
+    uint32_t dropped;
     struct kelp_fs_event events[KELP_SEMFS_BATCH_MAX];
 };
 
+#define KELP_SEMFS_MASK(type)   (1u << (type))
+#define KELP_SEMFS_MASK_ALL     0x1eu
+
 struct kelp_semfs_watch {
     uint32_t action;
-    uint32_t _reserved;
+    uint32_t mask;              /* KELP_SEMFS_MASK() bits, 0 = all */
     char     path[KELP_SEMFS_PATH_MAX];
 };
 
@@ -128,10 +135,255 @@ struct kelp_ai_status {
 #define KELP_IOC_POLL_INFER     _IOR(KELP_IOC_MAGIC, 6, struct kelp_infer_task)
 #define KELP_IOC_SEMFS_EVENTS   _IOWR(KELP_IOC_MAGIC, 7, struct kelp_semfs_batch)
 #define KELP_IOC_SEMFS_WATCH    _IOW(KELP_IOC_MAGIC, 8, struct kelp_semfs_watch)
-#define KELP_IOC_ACCEL_LIST     _IOR(KELP_IOC_MAGIC, 9, struct kelp_ai_status)
-#define KELP_IOC_ACCEL_RESERVE  _IOW(KELP_IOC_MAGIC, 10, struct kelp_ai_status)
 #define KELP_IOC_AI_STATUS      _IOR(KELP_IOC_MAGIC, 11, struct kelp_ai_status)
 
+/* Stats page (must match kernel/kelp_ai.h) */
+/*
+ * A read-only page, mapped at KELP_STATS_MMAP_OFFSET, holding every
+ * counter of kelp_kstats and kelp_ai_status.  The module rewrites it
+ * periodically while mapped; seq is odd during an update.  Use
+ * kelp_kernel_stats_read() for a consistent copy.
+ */
+#define KELP_STATS_MAGIC        0x4b535441u     /* "KSTA" */
+#define KELP_STATS_VERSION      1
+#define KELP_STATS_MMAP_OFFSET  0x40000000UL
+
+struct kelp_stats_page {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              /* sizeof(struct kelp_stats_page) */
+    uint32_t seq;               /* odd while an update is in progress */
+    uint64_t update_ns;         /* CLOCK_BOOTTIME of the last update */
+    uint32_t interval_ms;       /* refresh period */
+    uint32_t _reserved;
+    struct kelp_kstats    kstats;
+    struct kelp_ai_status ai;
+};
+
+/* Batched inference scheduler (must match kernel/kelp_ai.h) */
+#define KELP_INFER_BATCH_MAX       256
+
+struct kelp_infer_batch {
+    uint64_t tasks;             /* pointer to struct kelp_infer_task[] */
+    uint32_t count;             /* In: array length, Out: tasks transferred */
+    int32_t  timeout_ms;        /* POLL_BATCH: 0 = don't wait, -1 = forever */
+};
+
+#define KELP_IOC_SUBMIT_BATCH   _IOWR(KELP_IOC_MAGIC, 17, struct kelp_infer_batch)
+#define KELP_IOC_POLL_BATCH     _IOWR(KELP_IOC_MAGIC, 18, struct kelp_infer_batch)
+
+/* Scheduling policy (must match kernel/kelp_ai.h) */
+#define KELP_SCHED_PRIORITY        0   /* priority + aging */
+#define KELP_SCHED_FAIR            1   /* weighted fair queuing per uid */
+#define KELP_SCHED_EDF             2   /* earliest deadline first */
+
+#define KELP_SCHED_WEIGHT_DEFAULT  100
+#define KELP_SCHED_WEIGHT_MAX      10000
+#define KELP_SCHED_EDF_DEFAULT_MS  1000
+
+struct kelp_sched_config {
+    uint32_t policy;            /* KELP_SCHED_* */
+    uint32_t aging_ms;          /* per priority level, 0 = strict priority */
+    uint32_t batch_window_us;   /* 0 = no model_hint batching */
+    uint32_t _reserved;
+};
+
+struct kelp_sched_weight {
+    uint32_t uid;
+    uint32_t weight;
+};
+
+#define KELP_IOC_SCHED_GET      _IOR(KELP_IOC_MAGIC, 19, struct kelp_sched_config)
+#define KELP_IOC_SCHED_SET      _IOW(KELP_IOC_MAGIC, 20, struct kelp_sched_config)
+#define KELP_IOC_SCHED_WEIGHT   _IOW(KELP_IOC_MAGIC, 21, struct kelp_sched_weight)
+
+/* ---- Shared-memory ring (must match kernel/kelp_kernel.h) -------------- */
+
+#define KELP_RING_MAGIC      0x4b524e47u
+#define KELP_RING_VERSION    1
+#define KELP_RING_CACHELINE  64
+
+struct kelp_ring_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;
+    uint32_t slot_size;
+    uint64_t desc_offset;
+    uint64_t data_offset;
+    uint64_t map_size;
+    uint8_t  _pad0[KELP_RING_CACHELINE - 40];
+    uint64_t head;
+    uint32_t prod_waiters;
+    uint8_t  _pad1[KELP_RING_CACHELINE - 12];
+    uint64_t tail;
+    uint32_t cons_waiters;
+    uint8_t  _pad2[KELP_RING_CACHELINE - 12];
+};
+
+struct kelp_ring_desc {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t flags;
+};
+
+#define KELP_RING_WAIT_DATA   1
+#define KELP_RING_WAIT_SPACE  2
+
+struct kelp_ring_wait {
+    uint32_t event;
+    int32_t  timeout_ms;
+};
+
+#define KELP_IOC_RING_WAIT      _IOW(KELP_IOC_MAGIC, 12, struct kelp_ring_wait)
+#define KELP_IOC_RING_KICK      _IOW(KELP_IOC_MAGIC, 13, uint32_t)
+
+/* ---- Readiness notification (must match kernel/kelp_kernel.h) ---------- */
+
+#define KELP_IOC_SET_EVENTFD    _IOW(KELP_IOC_MAGIC, 14, int32_t)
+
+/* ---- Channels (must match kernel/kelp_kernel.h) ------------------------- */
+/*
+ * Every open fd is a channel.  A client's writes are requests, tagged by
+ * the module with its channel id and a request id; its reads return only
+ * the responses addressed to it.  A server (the gateway) reads requests
+ * from all clients, framed by struct kelp_msg_hdr, and answers each one
+ * with the same header followed by the response.  The server role needs
+ * CAP_SYS_ADMIN; a client's writes block (or fail with EAGAIN) while it
+ * already has the module's per-client limit of requests waiting.
+ *
+ * writev() moves one whole message per iovec segment; on a framed
+ * channel readv() returns one message per segment, header first, for as
+ * many as are queued (see the *_batch calls below).
+ */
+
+#define KELP_CHAN_CLIENT        0
+#define KELP_CHAN_SERVER        1
+
+#define KELP_CHAN_F_FRAMED      (1 << 0)
+
+#define KELP_CHAN_MAX_DEPTH     4096
+
+/* Maximum message size through /dev/kelp */
+#define KELP_MAX_MSG_SIZE       (64 * 1024)
+
+struct kelp_msg_hdr {
+    uint64_t channel;           /* client channel id */
+    uint64_t req_id;            /* per-channel request id, from 1 */
+    uint32_t len;               /* payload bytes following the header */
+    uint32_t flags;
+};
+
+struct kelp_chan_setup {
+    uint32_t role;              /* KELP_CHAN_CLIENT or KELP_CHAN_SERVER */
+    uint32_t flags;             /* KELP_CHAN_F_* */
+    uint32_t depth;             /* inbox depth, 0 keeps the current one */
+    uint32_t _reserved;
+};
+
+struct kelp_chan_info {
+    uint64_t channel;
+    uint64_t last_req_id;       /* id given to this channel's last write */
+    uint32_t role;
+    uint32_t flags;
+    uint32_t depth;
+    uint32_t queued;            /* messages waiting in the inbox */
+};
+
+#define KELP_IOC_CHAN_SETUP     _IOW(KELP_IOC_MAGIC, 15, struct kelp_chan_setup)
+#define KELP_IOC_CHAN_INFO      _IOR(KELP_IOC_MAGIC, 16, struct kelp_chan_info)
+
+/* ---- Network flows (must match kernel/kelp_kernel.h) -------------------- */
+/*
+ * Outbound IPv4 traffic aggregated per 5-tuple.  Each export interval
+ * starts with a snapshot of the flow tables and is read in batches until
+ * KELP_NF_BATCH_MORE is clear; a flow may appear once per CPU.
+ */
+
+#define KELP_NF_BATCH_MAX       1024
+#define KELP_NF_BATCH_MORE      (1 << 0)
+
+struct kelp_nf_flow {
+    uint32_t saddr;             /* IPv4 address, network byte order */
+    uint32_t daddr;
+    uint16_t sport;             /* network byte order, 0 unless TCP/UDP */
+    uint16_t dport;
+    uint8_t  protocol;          /* IPPROTO_* */
+    uint8_t  _pad[3];
+    uint32_t cpu;               /* CPU whose table held the flow */
+    uint32_t _reserved;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t first_ns;          /* CLOCK_MONOTONIC */
+    uint64_t last_ns;
+};
+
+struct kelp_nf_flow_batch {
+    uint64_t flows;             /* user pointer to struct kelp_nf_flow[] */
+    uint32_t count;             /* in: capacity, out: flows returned */
+    uint32_t flags;             /* out: KELP_NF_BATCH_* */
+    uint64_t overflow;          /* out: packets not recorded, tables full */
+};
+
+#define KELP_IOC_NF_FLOWS       _IOWR(KELP_IOC_MAGIC, 22, struct kelp_nf_flow_batch)
+
+/* ---- Accelerators (must match kernel/kelp_ai.h) ------------------------ */
+/*
+ * Accelerator 0 is the host: pinned memory in 2 MiB chunks where
+ * available, shared between processes of one user by buffer handle.
+ */
+
+#define KELP_ACCEL_NAME_LEN     64
+#define KELP_ACCEL_MAX          16
+
+#define KELP_ACCEL_CUDA         1
+#define KELP_ACCEL_ROCM         2
+#define KELP_ACCEL_NPU          3
+#define KELP_ACCEL_HOST         4
+
+#define KELP_ACCEL_ID_HOST      0
+
+#define KELP_ACCEL_F_HUGE       (1 << 0)    /* only 2 MiB chunks, or fail */
+
+#define KELP_ACCEL_BUF_MAX      (1ULL << 32)
+#define KELP_ACCEL_MMAP_OFFSET(handle)  ((uint64_t)(handle) << 32)
+
+struct kelp_accel_info {
+    uint32_t id;
+    uint32_t type;              /* KELP_ACCEL_* */
+    uint64_t memory_total;      /* bytes */
+    uint64_t memory_free;       /* bytes */
+    char     name[KELP_ACCEL_NAME_LEN];
+};
+
+struct kelp_accel_list {
+    uint32_t count;
+    uint32_t _reserved;
+    struct kelp_accel_info accels[KELP_ACCEL_MAX];
+};
+
+struct kelp_accel_reserve {
+    uint32_t accel_id;
+    uint32_t flags;             /* KELP_ACCEL_F_* */
+    uint64_t bytes;             /* in: size wanted, out: rounded up to pages */
+    uint64_t handle;            /* out */
+    uint64_t mmap_offset;       /* out: KELP_ACCEL_MMAP_OFFSET(handle) */
+};
+
+struct kelp_accel_buf {
+    uint64_t handle;            /* in */
+    uint64_t bytes;
+    uint64_t mmap_offset;
+    uint32_t accel_id;
+    uint32_t uid;               /* owner; other users cannot map it */
+    uint32_t huge_chunks;       /* 2 MiB chunks backing it */
+    uint32_t _reserved;
+};
+
+#define KELP_IOC_ACCEL_LIST     _IOR(KELP_IOC_MAGIC, 9, struct kelp_accel_list)
+#define KELP_IOC_ACCEL_RESERVE  _IOWR(KELP_IOC_MAGIC, 10, struct kelp_accel_reserve)
+#define KELP_IOC_ACCEL_RELEASE  _IOW(KELP_IOC_MAGIC, 23, uint64_t)
+#define KELP_IOC_ACCEL_BUF_INFO _IOWR(KELP_IOC_MAGIC, 24, struct kelp_accel_buf)
+
 /* ---- Userspace API ------------------------------------------------------ */
 
 /**
@@ -159,6 +411,14 @@ int kelp_kernel_send(int fd, const char *msg, size_t len);
  */
 char *kelp_kernel_recv(int fd, size_t *len);
 
+/**
+ * Receive a message into the caller's buffer: at most @p cap - 1 bytes,
+ * NUL-terminated.  Nothing is allocated; a longer message is continued
+ * by the following reads.
+ * Returns the number of bytes stored, -1 on error (errno set).
+ */
+ssize_t kelp_kernel_recv_into(int fd, char *buf, size_t cap);
+
 /**
  * Query kernel module statistics via ioctl.
  * Returns 0 on success, -1 on error.
@@ -177,6 +437,119 @@ int kelp_kernel_get_version(int fd, struct kelp_kversion *ver);
  */
 int kelp_kernel_get_status(int fd, struct kelp_kstatus *status);
 
+/**
+ * Register an eventfd to be signalled whenever a message is queued for
+ * this fd to read(), for event loops that cannot poll the device itself.
+ * Pass @p efd = -1 to unregister.  The device fd also supports poll(),
+ * select() and epoll directly.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_set_eventfd(int fd, int efd);
+
+/**
+ * Set the role, flags (KELP_CHAN_F_*) and inbox depth of the channel
+ * behind @p fd.  A @p depth of 0 keeps the current depth.  The server
+ * role needs CAP_SYS_ADMIN (EPERM), and the role cannot change after the
+ * fd has been polled (EBUSY).
+ * Returns 0 on success, -1 on error (errno set).
+ */
+int kelp_kernel_chan_setup(int fd, uint32_t role, uint32_t flags,
+                           uint32_t depth);
+
+/**
+ * Query the channel behind @p fd.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_chan_info(int fd, struct kelp_chan_info *info);
+
+/**
+ * Read one framed message (a request on a server, a response on a
+ * KELP_CHAN_F_FRAMED client) into @p hdr and up to @p cap bytes of
+ * @p buf.  The whole message is always consumed: if its payload is
+ * longer than @p cap, it is dropped, @p hdr still describes it, and the
+ * call fails with EMSGSIZE.
+ * Returns the number of payload bytes stored, -1 on error (errno set).
+ */
+ssize_t kelp_kernel_chan_recv(int fd, struct kelp_msg_hdr *hdr,
+                              void *buf, size_t cap);
+
+/**
+ * Write a framed message: @p hdr (channel and req_id from the request
+ * being answered) followed by @p len bytes of @p msg.
+ * Returns 0 on success, -1 on error (errno set).
+ */
+int kelp_kernel_chan_send(int fd, const struct kelp_msg_hdr *hdr,
+                          const void *msg, size_t len);
+
+/* ---- Batched channel I/O ------------------------------------------------ */
+
+/*
+ * One system call moves up to KELP_KERNEL_BATCH_MAX messages.  Frames are
+ * built and received in buffers owned by the calling thread, which its
+ * later calls reuse and which are freed when it exits, so neither these
+ * calls nor kelp_kernel_chan_recv()/kelp_kernel_chan_send() allocate once
+ * the thread has made its first one.
+ *
+ * A SOCK_SEQPACKET socket carrying one framed message per datagram, such
+ * as one end of a socketpair(), can stand in for a server's /dev/kelp fd:
+ * the batched calls use recvmmsg()/sendmmsg() on it.  Tests and
+ * benchmarks use that to run without the module.
+ */
+
+#define KELP_KERNEL_BATCH_MAX   64
+
+/*
+ * Payload room of each receive slot after the first, which holds up to
+ * KELP_MAX_MSG_SIZE.  A longer message waits for the next call's first
+ * slot on /dev/kelp (a socket's slots are all full size).
+ */
+#define KELP_KERNEL_BATCH_SLOT  4096
+
+/** One framed message of a batched call. */
+typedef struct {
+    struct kelp_msg_hdr  hdr;   /* send: channel, req_id, flags (len is set) */
+    const char          *data;  /* recv: NUL-terminated, in the thread's buffers */
+    size_t               len;
+} kelp_kernel_msg_t;
+
+/**
+ * Receive up to @p max framed messages (on a server, or a
+ * KELP_CHAN_F_FRAMED client) with one readv().  Waits for the first
+ * unless the fd is non-blocking.  msgs[i].data stays valid until the
+ * thread's next receive on any channel.
+ * Returns the number of messages stored, -1 on error (errno set; EAGAIN
+ * when nothing is queued on a non-blocking fd).
+ */
+int kelp_kernel_chan_recv_batch(int fd, kelp_kernel_msg_t *msgs, size_t max);
+
+/**
+ * Send up to @p count framed messages (server responses) with one
+ * writev().
+ * Returns the number sent, fewer than @p count when a non-blocking write
+ * ran out of room (errno EAGAIN), or -1 if none was sent.
+ */
+int kelp_kernel_chan_send_batch(int fd, const kelp_kernel_msg_t *msgs,
+                                size_t count);
+
+/**
+ * Send up to @p count client requests, one per iovec, with one writev().
+ * Returns as kelp_kernel_chan_send_batch().
+ */
+int kelp_kernel_sendv(int fd, const struct iovec *msgs, size_t count);
+
+/** Free the calling thread's frame buffers now rather than at its exit. */
+void kelp_kernel_pool_release(void);
+
+/**
+ * Export up to @p cap (at most KELP_NF_BATCH_MAX) network flows.  Call
+ * again while @p more is set to finish the interval; the next call after
+ * that starts a new one.  @p more and @p overflow may be NULL.
+ * Returns the number of flows stored, -1 on error (ENODEV when the
+ * netfilter hook is disabled).
+ */
+int kelp_kernel_get_flows(int fd, struct kelp_nf_flow *flows, size_t cap,
+                          bool *more, uint64_t *overflow);
+
 /**
  * Check if the kelp kernel module is loaded and /dev/kelp is available.
  * Returns true if the device exists and can be opened.
@@ -199,14 +572,57 @@ int kelp_kernel_submit_infer(int fd, struct kelp_infer_task *task);
 int kelp_kernel_poll_infer(int fd, struct kelp_infer_task *task);
 
 /**
- * Batch-read recent semantic FS events.
- * Set batch->count to max events desired; on return it holds actual count.
+ * Submit up to KELP_INFER_BATCH_MAX tasks in one call.  Ids and submit
+ * times are filled in for the tasks that were queued, which are always
+ * the first ones of the array.
+ * Returns the number queued (fewer than @p count when the scheduler
+ * queue fills up), -1 on error (ENOSPC if none fit).
+ */
+int kelp_kernel_submit_infer_batch(int fd, struct kelp_infer_task *tasks,
+                                   size_t count);
+
+/**
+ * Dequeue up to @p cap (at most KELP_INFER_BATCH_MAX) tasks in priority
+ * order.  If none are queued, wait up to @p timeout_ms for one: 0 does
+ * not wait, -1 waits indefinitely.
+ * Returns the number of tasks stored, -1 on error (EAGAIN when empty and
+ * not waiting, ETIMEDOUT when the wait expired).
+ */
+int kelp_kernel_poll_infer_batch(int fd, struct kelp_infer_task *tasks,
+                                 size_t cap, int timeout_ms);
+
+/**
+ * Read the scheduler's policy, aging and model batching window.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_sched_get(int fd, struct kelp_sched_config *cfg);
+
+/**
+ * Change the scheduler's policy; queued tasks are reordered under the new
+ * one.  Needs CAP_SYS_ADMIN.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_sched_set(int fd, const struct kelp_sched_config *cfg);
+
+/**
+ * Set the fair-share weight of tasks submitted by @p uid (default
+ * KELP_SCHED_WEIGHT_DEFAULT).  Needs CAP_SYS_ADMIN.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_sched_set_weight(int fd, uint32_t uid, uint32_t weight);
+
+/**
+ * Batch-read (and consume) queued semantic FS events, oldest first.
+ * Set batch->count to max events desired; on return it holds actual count
+ * and batch->dropped the number of events lost since the previous read.
  * Returns 0 on success, -1 on error.
  */
 int kelp_kernel_get_semfs_events(int fd, struct kelp_semfs_batch *batch);
 
 /**
- * Add or remove a semantic FS watch path.
+ * Add or remove a semantic FS watch path.  A watch covers the (absolute)
+ * path and everything below it, for the event types in watch->mask (0 for
+ * all); adding a watched path again replaces its mask.
  * Returns 0 on success, -1 on error.
  */
 int kelp_kernel_semfs_watch(int fd, struct kelp_semfs_watch *watch);
@@ -217,6 +633,173 @@ int kelp_kernel_semfs_watch(int fd, struct kelp_semfs_watch *watch);
  */
 int kelp_kernel_get_ai_status(int fd, struct kelp_ai_status *status);
 
+/* ---- Shared-memory ring API ---------------------------------------------- */
+
+/*
+ * The ring is a queue of fixed-size slots belonging to one open /dev/kelp
+ * file: every kelp_kernel_ring_map() of that file (in this process, or in
+ * one it was passed to by fork() or SCM_RIGHTS) maps the same ring, and
+ * other opens of the device get rings of their own.  Any number of
+ * threads and processes sharing the file may produce and consume
+ * concurrently.  Messages go straight
+ * into and out of the shared slots; a system call is only made to sleep
+ * on an empty or full ring, or to wake a peer that is sleeping.
+ *
+ * The ring is separate from the read()/write() queue: both ends of a
+ * conversation must use the same transport.
+ *
+ * Timeouts are in milliseconds: 0 fails at once with EAGAIN, a negative
+ * value waits forever, and expiry fails with ETIMEDOUT.
+ */
+
+typedef struct kelp_kernel_ring kelp_kernel_ring_t;
+
+/** A claimed slot: filled by reserve/peek, consumed by commit/release. */
+typedef struct {
+    uint64_t  pos;
+    void     *data;
+    size_t    len;
+} kelp_kernel_ring_slot_t;
+
+/**
+ * Map the shared ring of an open /dev/kelp descriptor.  @p fd must stay
+ * open while the ring is in use.
+ * Returns the ring, or NULL on error (errno set).
+ */
+kelp_kernel_ring_t *kelp_kernel_ring_map(int fd);
+
+/** Unmap a ring.  NULL is a no-op. */
+void kelp_kernel_ring_unmap(kelp_kernel_ring_t *ring);
+
+/** Largest message a slot can hold. */
+size_t kelp_kernel_ring_max_msg(const kelp_kernel_ring_t *ring);
+
+/**
+ * Claim a free slot to write a message into.  slot->data points at
+ * kelp_kernel_ring_max_msg() bytes of shared memory.
+ * Returns 0 on success, -1 on error (errno set).
+ */
+int kelp_kernel_ring_reserve(kelp_kernel_ring_t *ring,
+                             kelp_kernel_ring_slot_t *slot, int timeout_ms);
+
+/** Publish @p len bytes written into a reserved slot. */
+void kelp_kernel_ring_commit(kelp_kernel_ring_t *ring,
+                             kelp_kernel_ring_slot_t *slot, size_t len);
+
+/**
+ * Claim the next message.  slot->data and slot->len describe it in place
+ * until kelp_kernel_ring_release().
+ * Returns 0 on success, -1 on error (errno set).
+ */
+int kelp_kernel_ring_peek(kelp_kernel_ring_t *ring,
+                          kelp_kernel_ring_slot_t *slot, int timeout_ms);
+
+/** Hand a consumed slot back to producers. */
+void kelp_kernel_ring_release(kelp_kernel_ring_t *ring,
+                              kelp_kernel_ring_slot_t *slot);
+
+/**
+ * Copy @p len bytes into the ring as one message (reserve + commit).
+ * Returns 0 on success, -1 on error (errno set; EMSGSIZE if @p len is
+ * larger than kelp_kernel_ring_max_msg()).
+ */
+int kelp_kernel_ring_send(kelp_kernel_ring_t *ring, const void *msg,
+                          size_t len, int timeout_ms);
+
+/**
+ * Copy the next message into @p buf (peek + release).  A message longer
+ * than @p cap is truncated.
+ * Returns the message length, or -1 on error (errno set).
+ */
+ssize_t kelp_kernel_ring_recv(kelp_kernel_ring_t *ring, void *buf,
+                              size_t cap, int timeout_ms);
+
+/* ---- Stats page API ----------------------------------------------------- */
+
+/*
+ * A read-only mapping of the module's counters, refreshed by the module
+ * every few milliseconds while mapped.  Reading a snapshot takes no
+ * system call, so dashboards can sample it at frame rate.
+ */
+
+typedef struct kelp_kernel_stats kelp_kernel_stats_t;
+
+/**
+ * Map the stats page of an open /dev/kelp descriptor.  The mapping stays
+ * valid after @p fd is closed.
+ * Returns the handle, or NULL on error (errno set; EPROTO on a layout
+ * mismatch with the module).
+ */
+kelp_kernel_stats_t *kelp_kernel_stats_map(int fd);
+
+/** Unmap the stats page.  NULL is a no-op. */
+void kelp_kernel_stats_unmap(kelp_kernel_stats_t *stats);
+
+/**
+ * Copy a consistent snapshot of the stats page into @p out.
+ * Returns 0 on success, -1 on error (EAGAIN if the page kept changing).
+ */
+int kelp_kernel_stats_read(const kelp_kernel_stats_t *stats,
+                           struct kelp_stats_page *out);
+
+/* ---- Tensor buffer API -------------------------------------------------- */
+
+/*
+ * Shared tensor memory from the host accelerator.  One process reserves
+ * a buffer and passes its handle (an integer) to others, for instance in
+ * a channel message; each maps the same pages, so tensors and embedding
+ * matrices change hands without a copy.  Only processes of the same user
+ * (or CAP_SYS_ADMIN) can map a handle.
+ *
+ * The handle is valid until kelp_kernel_buf_release() or until the fd
+ * that reserved it is closed.  The memory stays until the last mapping is
+ * unmapped, so holders of a mapping are never cut off.
+ */
+
+typedef struct kelp_kernel_buf kelp_kernel_buf_t;
+
+/**
+ * List accelerators with their total and free memory.
+ * Returns 0 on success, -1 on error.
+ */
+int kelp_kernel_accel_list(int fd, struct kelp_accel_list *list);
+
+/**
+ * Reserve a zeroed host buffer of at least @p bytes (rounded up to pages,
+ * or to 2 MiB with KELP_ACCEL_F_HUGE) and map it read-write.
+ * Returns the buffer, or NULL on error (errno set; ENOMEM when the
+ * module's budget or the 2 MiB blocks ran out, ENODEV when host buffers
+ * are disabled).
+ */
+kelp_kernel_buf_t *kelp_kernel_buf_alloc(int fd, size_t bytes, uint32_t flags);
+
+/**
+ * Map the buffer another process reserved, by handle.  @p fd may be any
+ * /dev/kelp descriptor and may be closed once this returns.
+ * Returns the buffer, or NULL on error (errno set; ENOENT for an unknown
+ * or released handle, EACCES for another user's buffer).
+ */
+kelp_kernel_buf_t *kelp_kernel_buf_open(int fd, uint64_t handle);
+
+/** Unmap a buffer (the handle stays valid).  NULL is a no-op. */
+void kelp_kernel_buf_unmap(kelp_kernel_buf_t *buf);
+
+/**
+ * Withdraw a handle reserved through @p fd.  Existing mappings keep the
+ * memory until they are unmapped.
+ * Returns 0 on success, -1 on error (EPERM if @p fd did not reserve it).
+ */
+int kelp_kernel_buf_release(int fd, uint64_t handle);
+
+/** Start of the mapped buffer. */
+void *kelp_kernel_buf_data(const kelp_kernel_buf_t *buf);
+
+/** Size of the buffer in bytes. */
+size_t kelp_kernel_buf_size(const kelp_kernel_buf_t *buf);
+
+/** Handle to pass to kelp_kernel_buf_open() in another process. */
+uint64_t kelp_kernel_buf_handle(const kelp_kernel_buf_t *buf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,117 @@
+/*
+ * accel.c — Shared tensor buffers from the /dev/kelp host accelerator
+ *
+ * A buffer is reserved with KELP_IOC_ACCEL_RESERVE and mapped at the
+ * offset that encodes its handle; another process looks the handle up
+ * with KELP_IOC_ACCEL_BUF_INFO and maps the same offset.  The mapping
+ * holds the pages (and the device file) by itself, so nothing here needs
+ * the descriptor once mmap() has returned.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+struct kelp_kernel_buf {
+    void     *data;
+    size_t    size;
+    uint64_t  handle;
+};
+
+static kelp_kernel_buf_t *buf_map(int fd, uint64_t handle, uint64_t bytes,
+                                  uint64_t offset)
+{
+    if (bytes > SIZE_MAX) {
+        errno = EFBIG;
+        return NULL;
+    }
+
+    kelp_kernel_buf_t *buf = calloc(1, sizeof(*buf));
+    if (!buf)
+        return NULL;
+
+    buf->data = mmap(NULL, (size_t)bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, (off_t)offset);
+    if (buf->data == MAP_FAILED) {
+        free(buf);
+        return NULL;
+    }
+    buf->size   = (size_t)bytes;
+    buf->handle = handle;
+    return buf;
+}
+
+int kelp_kernel_accel_list(int fd, struct kelp_accel_list *list)
+{
+    if (!list) {
+        errno = EINVAL;
+        return -1;
+    }
+    return ioctl(fd, KELP_IOC_ACCEL_LIST, list);
+}
+
+kelp_kernel_buf_t *kelp_kernel_buf_alloc(int fd, size_t bytes, uint32_t flags)
+{
+    if (bytes == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct kelp_accel_reserve req = {
+        .accel_id = KELP_ACCEL_ID_HOST,
+        .flags    = flags,
+        .bytes    = bytes,
+    };
+    if (ioctl(fd, KELP_IOC_ACCEL_RESERVE, &req) != 0)
+        return NULL;
+
+    kelp_kernel_buf_t *buf = buf_map(fd, req.handle, req.bytes,
+                                     req.mmap_offset);
+    if (!buf) {
+        int err = errno;
+        kelp_kernel_buf_release(fd, req.handle);
+        errno = err;
+    }
+    return buf;
+}
+
+kelp_kernel_buf_t *kelp_kernel_buf_open(int fd, uint64_t handle)
+{
+    struct kelp_accel_buf info = { .handle = handle };
+
+    if (ioctl(fd, KELP_IOC_ACCEL_BUF_INFO, &info) != 0)
+        return NULL;
+    return buf_map(fd, handle, info.bytes, info.mmap_offset);
+}
+
+void kelp_kernel_buf_unmap(kelp_kernel_buf_t *buf)
+{
+    if (!buf)
+        return;
+    munmap(buf->data, buf->size);
+    free(buf);
+}
+
+int kelp_kernel_buf_release(int fd, uint64_t handle)
+{
+    return ioctl(fd, KELP_IOC_ACCEL_RELEASE, &handle);
+}
+
+void *kelp_kernel_buf_data(const kelp_kernel_buf_t *buf)
+{
+    return buf ? buf->data : NULL;
+}
+
+size_t kelp_kernel_buf_size(const kelp_kernel_buf_t *buf)
+{
+    return buf ? buf->size : 0;
+}
+
+uint64_t kelp_kernel_buf_handle(const kelp_kernel_buf_t *buf)
+{
+    return buf ? buf->handle : 0;
+}
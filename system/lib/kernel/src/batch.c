@@ -0,0 +1,298 @@
+/*
+ * batch.c — Batched channel I/O on /dev/kelp, and per-thread frame buffers
+ *
+ * The module takes one whole message per writev() segment and, on a
+ * framed channel, returns one message per readv() segment, so a batch is
+ * a single system call in each direction.  Frames live in buffers owned
+ * by the calling thread: grown on first use, reused by every later call
+ * and freed at thread exit through a pthread key destructor, so steady
+ * state costs no allocation per message.
+ *
+ * A SOCK_SEQPACKET socket with one frame per datagram gets the same
+ * batching from recvmmsg()/sendmmsg(), which lets a socketpair stand in
+ * for the device in tests and benchmarks.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include "kernel_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/* Receive slot strides: the header, the payload room and a NUL, aligned */
+#define SLOT_ALIGN(n)   (((n) + 7) & ~(size_t)7)
+#define SLOT0_CAP       KELP_MAX_MSG_SIZE
+#define SLOT_CAP        KELP_KERNEL_BATCH_SLOT
+#define SLOT0_STRIDE    SLOT_ALIGN(sizeof(struct kelp_msg_hdr) + SLOT0_CAP + 1)
+#define SLOT_STRIDE     SLOT_ALIGN(sizeof(struct kelp_msg_hdr) + SLOT_CAP + 1)
+
+/* ---- Per-thread frame buffers ------------------------------------------- */
+
+typedef struct {
+    char   *rx;
+    size_t  rx_cap;
+    char   *tx;
+    size_t  tx_cap;
+    bool    registered;     /* destructor armed for this thread */
+} frame_pool_t;
+
+static _Thread_local frame_pool_t tls_pool;
+static pthread_key_t  pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_free(void *arg)
+{
+    frame_pool_t *pool = arg;
+
+    free(pool->rx);
+    free(pool->tx);
+    *pool = (frame_pool_t){0};
+}
+
+static void pool_key_init(void)
+{
+    pthread_key_create(&pool_key, pool_free);
+}
+
+static char *pool_grow(char **buf, size_t *cap, size_t size)
+{
+    if (size <= *cap)
+        return *buf;
+
+    if (!tls_pool.registered) {
+        pthread_once(&pool_once, pool_key_init);
+        if (pthread_setspecific(pool_key, &tls_pool) != 0) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        tls_pool.registered = true;
+    }
+
+    /* Old contents are not needed: free first to keep the peak down. */
+    free(*buf);
+    *cap = 0;
+    *buf = malloc(size);
+    if (!*buf)
+        return NULL;
+    *cap = size;
+    return *buf;
+}
+
+char *kernel_frame_rx(size_t size)
+{
+    return pool_grow(&tls_pool.rx, &tls_pool.rx_cap, size);
+}
+
+char *kernel_frame_tx(size_t size)
+{
+    return pool_grow(&tls_pool.tx, &tls_pool.tx_cap, size);
+}
+
+void kelp_kernel_pool_release(void)
+{
+    if (tls_pool.registered)
+        pthread_setspecific(pool_key, NULL);
+    pool_free(&tls_pool);
+}
+
+/* ---- Helpers ------------------------------------------------------------ */
+
+static bool fd_is_socket(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+/* Messages wholly covered by @n bytes of @iov[0..count) */
+static int iov_done(const struct iovec *iov, size_t count, ssize_t n)
+{
+    size_t left = (size_t)n;
+    int done = 0;
+
+    for (size_t i = 0; i < count && iov[i].iov_len <= left; i++) {
+        left -= iov[i].iov_len;
+        done++;
+    }
+    return done;
+}
+
+/* Parse the frame of @n bytes at @slot into @m. */
+static int frame_parse(char *slot, size_t n, kelp_kernel_msg_t *m)
+{
+    if (n < sizeof(m->hdr)) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy(&m->hdr, slot, sizeof(m->hdr));
+    m->len = n - sizeof(m->hdr);
+    m->data = slot + sizeof(m->hdr);
+    slot[n] = '\0';
+    return 0;
+}
+
+/* Send @count segments of one message each; returns messages sent */
+static int send_segments(int fd, struct iovec *iov, size_t count)
+{
+    if (fd_is_socket(fd)) {
+        struct mmsghdr mm[KELP_KERNEL_BATCH_MAX];
+        for (size_t i = 0; i < count; i++) {
+            mm[i] = (struct mmsghdr){
+                .msg_hdr = { .msg_iov = &iov[i], .msg_iovlen = 1 },
+            };
+        }
+        return sendmmsg(fd, mm, (unsigned int)count, MSG_NOSIGNAL);
+    }
+
+    ssize_t n = writev(fd, iov, (int)count);
+    if (n < 0)
+        return -1;
+    int done = iov_done(iov, count, n);
+    if ((size_t)done < count)
+        errno = EAGAIN;
+    return done;
+}
+
+/* ---- Batched calls ------------------------------------------------------ */
+
+int kelp_kernel_chan_recv_batch(int fd, kelp_kernel_msg_t *msgs, size_t max)
+{
+    if (!msgs || max == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (max > KELP_KERNEL_BATCH_MAX)
+        max = KELP_KERNEL_BATCH_MAX;
+
+    /*
+     * Slot 0 takes any message, so a batch always makes progress.  A
+     * datagram longer than its slot would be cut short, so on a socket
+     * every slot is full size; pages never written are never touched.
+     */
+    bool sock = fd_is_socket(fd);
+    size_t cap = sock ? SLOT0_CAP : SLOT_CAP;
+    size_t stride = sock ? SLOT0_STRIDE : SLOT_STRIDE;
+
+    char *rx = kernel_frame_rx(SLOT0_STRIDE + (max - 1) * stride);
+    if (!rx)
+        return -1;
+
+    struct iovec iov[KELP_KERNEL_BATCH_MAX];
+    iov[0] = (struct iovec){ rx, sizeof(struct kelp_msg_hdr) + SLOT0_CAP };
+    for (size_t i = 1; i < max; i++) {
+        iov[i] = (struct iovec){
+            rx + SLOT0_STRIDE + (i - 1) * stride,
+            sizeof(struct kelp_msg_hdr) + cap,
+        };
+    }
+
+    if (sock) {
+        struct mmsghdr mm[KELP_KERNEL_BATCH_MAX];
+        for (size_t i = 0; i < max; i++)
+            mm[i] = (struct mmsghdr){
+                .msg_hdr = { .msg_iov = &iov[i], .msg_iovlen = 1 },
+            };
+
+        int got = recvmmsg(fd, mm, (unsigned int)max, MSG_WAITFORONE, NULL);
+        if (got <= 0) {
+            if (got == 0)
+                errno = EAGAIN;
+            return -1;
+        }
+        for (int i = 0; i < got; i++) {
+            if (frame_parse(iov[i].iov_base, mm[i].msg_len, &msgs[i]) != 0)
+                return i > 0 ? i : -1;
+        }
+        return got;
+    }
+
+    ssize_t n = readv(fd, iov, (int)max);
+    if (n <= 0) {
+        if (n == 0)
+            errno = EAGAIN;
+        return -1;
+    }
+
+    /* Every segment before the last one filled counts whole. */
+    size_t left = (size_t)n;
+    int got = 0;
+    for (size_t i = 0; i < max && left > 0; i++) {
+        size_t len = left;
+        if (left > iov[i].iov_len) {
+            struct kelp_msg_hdr h;
+            memcpy(&h, iov[i].iov_base, sizeof(h));
+            len = sizeof(h) + h.len;
+            left -= iov[i].iov_len;
+        } else {
+            left = 0;
+        }
+        if (len > iov[i].iov_len ||
+            frame_parse(iov[i].iov_base, len, &msgs[got]) != 0) {
+            errno = EPROTO;
+            return got > 0 ? got : -1;
+        }
+        got++;
+    }
+    return got;
+}
+
+int kelp_kernel_chan_send_batch(int fd, const kelp_kernel_msg_t *msgs,
+                                size_t count)
+{
+    if (!msgs || count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count > KELP_KERNEL_BATCH_MAX)
+        count = KELP_KERNEL_BATCH_MAX;
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((!msgs[i].data && msgs[i].len) || msgs[i].len > KELP_MAX_MSG_SIZE) {
+            errno = msgs[i].len > KELP_MAX_MSG_SIZE ? EMSGSIZE : EINVAL;
+            return -1;
+        }
+        total += sizeof(struct kelp_msg_hdr) + msgs[i].len;
+    }
+
+    /* Header and payload of a message share one segment on the device,
+     * so they are copied into one frame each. */
+    char *tx = kernel_frame_tx(total);
+    if (!tx)
+        return -1;
+
+    struct iovec iov[KELP_KERNEL_BATCH_MAX];
+    char *p = tx;
+    for (size_t i = 0; i < count; i++) {
+        struct kelp_msg_hdr h = msgs[i].hdr;
+        h.len = (uint32_t)msgs[i].len;
+        memcpy(p, &h, sizeof(h));
+        if (msgs[i].len)
+            memcpy(p + sizeof(h), msgs[i].data, msgs[i].len);
+        iov[i] = (struct iovec){ p, sizeof(h) + msgs[i].len };
+        p += iov[i].iov_len;
+    }
+    return send_segments(fd, iov, count);
+}
+
+int kelp_kernel_sendv(int fd, const struct iovec *msgs, size_t count)
+{
+    if (!msgs || count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count > KELP_KERNEL_BATCH_MAX)
+        count = KELP_KERNEL_BATCH_MAX;
+
+    /* Requests are bare payloads: the caller's iovecs go out as they are. */
+    struct iovec iov[KELP_KERNEL_BATCH_MAX];
+    memcpy(iov, msgs, count * sizeof(*iov));
+    return send_segments(fd, iov, count);
+}
@@ -8,6 +8,8 @@
 
 #include <kelp/kernel.h>
 
+#include "kernel_internal.h"
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -46,20 +48,33 @@ char *kelp_kernel_recv(int fd, size_t *len)
     if (!buf)
         return NULL;
 
-    ssize_t n = read(fd, buf, RECV_BUF_SIZE - 1);
+    ssize_t n = kelp_kernel_recv_into(fd, buf, RECV_BUF_SIZE);
     if (n < 0) {
         free(buf);
         return NULL;
     }
 
-    buf[n] = '\0';
-
     if (len)
         *len = (size_t)n;
 
     return buf;
 }
 
+ssize_t kelp_kernel_recv_into(int fd, char *buf, size_t cap)
+{
+    if (!buf || cap == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t n = read(fd, buf, cap - 1);
+    if (n < 0)
+        return -1;
+
+    buf[n] = '\0';
+    return n;
+}
+
 int kelp_kernel_get_stats(int fd, struct kelp_kstats *stats)
 {
     if (!stats)
@@ -81,6 +96,110 @@ int kelp_kernel_get_status(int fd, struct kelp_kstatus *status)
     return ioctl(fd, KELP_IOC_QUERY_STATUS, status);
 }
 
+int kelp_kernel_set_eventfd(int fd, int efd)
+{
+    int32_t v = efd;
+    return ioctl(fd, KELP_IOC_SET_EVENTFD, &v);
+}
+
+int kelp_kernel_chan_setup(int fd, uint32_t role, uint32_t flags,
+                           uint32_t depth)
+{
+    struct kelp_chan_setup req = {
+        .role  = role,
+        .flags = flags,
+        .depth = depth,
+    };
+    return ioctl(fd, KELP_IOC_CHAN_SETUP, &req);
+}
+
+int kelp_kernel_chan_info(int fd, struct kelp_chan_info *info)
+{
+    if (!info)
+        return -1;
+    return ioctl(fd, KELP_IOC_CHAN_INFO, info);
+}
+
+ssize_t kelp_kernel_chan_recv(int fd, struct kelp_msg_hdr *hdr,
+                              void *buf, size_t cap)
+{
+    if (!hdr || (!buf && cap)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* One read() for header and payload: the fd may be shared between
+     * threads, and a zero-length message must not run into the next.
+     * Read the whole frame whatever @cap is, so a long payload is never
+     * left behind to be taken for the next header. */
+    char *frame = kernel_frame_rx(sizeof(*hdr) + KELP_MAX_MSG_SIZE);
+    if (!frame)
+        return -1;
+
+    ssize_t n = read(fd, frame, sizeof(*hdr) + KELP_MAX_MSG_SIZE);
+    if (n < 0)
+        return -1;
+    if ((size_t)n < sizeof(*hdr)) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    memcpy(hdr, frame, sizeof(*hdr));
+    n -= (ssize_t)sizeof(*hdr);
+    if ((size_t)n > cap) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (n > 0)
+        memcpy(buf, frame + sizeof(*hdr), (size_t)n);
+    return n;
+}
+
+int kelp_kernel_chan_send(int fd, const struct kelp_msg_hdr *hdr,
+                          const void *msg, size_t len)
+{
+    if (!hdr || (!msg && len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Header and payload must arrive in a single write(): the module
+     * takes each writev() segment as a message of its own. */
+    char *frame = kernel_frame_tx(sizeof(*hdr) + len);
+    if (!frame)
+        return -1;
+
+    struct kelp_msg_hdr h = *hdr;
+    h.len = (uint32_t)len;
+    memcpy(frame, &h, sizeof(h));
+    if (len)
+        memcpy(frame + sizeof(h), msg, len);
+
+    ssize_t n = write(fd, frame, sizeof(h) + len);
+    return n < 0 ? -1 : 0;
+}
+
+int kelp_kernel_get_flows(int fd, struct kelp_nf_flow *flows, size_t cap,
+                          bool *more, uint64_t *overflow)
+{
+    if (!flows || cap == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct kelp_nf_flow_batch batch = {
+        .flows = (uint64_t)(uintptr_t)flows,
+        .count = (uint32_t)(cap < KELP_NF_BATCH_MAX ? cap : KELP_NF_BATCH_MAX),
+    };
+    if (ioctl(fd, KELP_IOC_NF_FLOWS, &batch) != 0)
+        return -1;
+    if (more)
+        *more = (batch.flags & KELP_NF_BATCH_MORE) != 0;
+    if (overflow)
+        *overflow = batch.overflow;
+    return (int)batch.count;
+}
+
 bool kelp_kernel_available(void)
 {
     struct stat st;
@@ -111,6 +230,61 @@ int kelp_kernel_poll_infer(int fd, struct kelp_infer_task *task)
     return ioctl(fd, KELP_IOC_POLL_INFER, task);
 }
 
+int kelp_kernel_submit_infer_batch(int fd, struct kelp_infer_task *tasks,
+                                   size_t count)
+{
+    if (!tasks || count == 0 || count > KELP_INFER_BATCH_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct kelp_infer_batch batch = {
+        .tasks = (uint64_t)(uintptr_t)tasks,
+        .count = (uint32_t)count,
+    };
+    if (ioctl(fd, KELP_IOC_SUBMIT_BATCH, &batch) != 0)
+        return -1;
+    return (int)batch.count;
+}
+
+int kelp_kernel_poll_infer_batch(int fd, struct kelp_infer_task *tasks,
+                                 size_t cap, int timeout_ms)
+{
+    if (!tasks || cap == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct kelp_infer_batch batch = {
+        .tasks      = (uint64_t)(uintptr_t)tasks,
+        .count      = (uint32_t)(cap < KELP_INFER_BATCH_MAX ? cap : KELP_INFER_BATCH_MAX),
+        .timeout_ms = timeout_ms < 0 ? -1 : timeout_ms,
+    };
+    if (ioctl(fd, KELP_IOC_POLL_BATCH, &batch) != 0)
+        return -1;
+    return (int)batch.count;
+}
+
+int kelp_kernel_sched_get(int fd, struct kelp_sched_config *cfg)
+{
+    if (!cfg)
+        return -1;
+    return ioctl(fd, KELP_IOC_SCHED_GET, cfg);
+}
+
+int kelp_kernel_sched_set(int fd, const struct kelp_sched_config *cfg)
+{
+    if (!cfg)
+        return -1;
+    return ioctl(fd, KELP_IOC_SCHED_SET, cfg);
+}
+
+int kelp_kernel_sched_set_weight(int fd, uint32_t uid, uint32_t weight)
+{
+    struct kelp_sched_weight req = { .uid = uid, .weight = weight };
+    return ioctl(fd, KELP_IOC_SCHED_WEIGHT, &req);
+}
+
 int kelp_kernel_get_semfs_events(int fd, struct kelp_semfs_batch *batch)
 {
     if (!batch)
@@ -0,0 +1,23 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * kernel_internal.h - Shared internals of libkelp-kernel
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_KERNEL_INTERNAL_H
+#define KELP_KERNEL_INTERNAL_H
+
+#include <stddef.h>
+
+/**
+ * The calling thread's receive (or send) frame buffer, grown to at least
+ * @p size bytes.  The buffer is reused by every later call on the thread
+ * and freed when it exits; growing it invalidates earlier contents.
+ *
+ * @return The buffer, or NULL on allocation failure (errno set).
+ */
+char *kernel_frame_rx(size_t size);
+char *kernel_frame_tx(size_t size);
+
+#endif /* KELP_KERNEL_INTERNAL_H */
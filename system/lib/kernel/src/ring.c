@@ -0,0 +1,314 @@
+/*
+ * ring.c — Shared-memory message ring on /dev/kelp
+ *
+ * Bounded MPMC queue over the pages the kernel module maps (see the
+ * layout in kelp/kernel.h).  Each slot's sequence number tells producers
+ * and consumers whether it is free, full, or still owned by a peer, so
+ * both sides only need a compare-and-swap on their own index.
+ *
+ * Sleeping uses a waiter count in the shared header: a side about to
+ * sleep increments it, issues a full fence, re-checks the ring and then
+ * sleeps in KELP_IOC_RING_WAIT, whose wake condition the kernel evaluates
+ * against the same shared indices.  The other side publishes, fences, and
+ * kicks only when it sees a waiter, so no wakeup is lost and none is paid
+ * for when nobody sleeps.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Re-checks of the ring before going to sleep in the kernel. */
+#define RING_SPIN  256
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()  __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax()  __asm__ __volatile__("yield")
+#else
+#define cpu_relax()  do { } while (0)
+#endif
+
+struct kelp_kernel_ring {
+    int                    fd;
+    struct kelp_ring_hdr  *hdr;
+    struct kelp_ring_desc *desc;
+    uint8_t               *data;
+    size_t                 map_size;
+    uint32_t               nslots;
+    uint32_t               slot_size;
+};
+
+kelp_kernel_ring_t *kelp_kernel_ring_map(int fd)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    struct kelp_ring_hdr *hdr;
+    struct kelp_ring_hdr h;
+
+    /* Map the header first to learn the full size. */
+    hdr = mmap(NULL, (size_t)page, PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED)
+        return NULL;
+    memcpy(&h, hdr, sizeof(h));
+    munmap(hdr, (size_t)page);
+
+    if (h.magic != KELP_RING_MAGIC || h.version != KELP_RING_VERSION ||
+        h.nslots == 0 || (h.nslots & (h.nslots - 1)) != 0 ||
+        h.slot_size == 0 ||
+        h.desc_offset < sizeof(h) ||
+        h.desc_offset + (uint64_t)h.nslots * sizeof(struct kelp_ring_desc) > h.data_offset ||
+        h.data_offset + (uint64_t)h.nslots * h.slot_size > h.map_size) {
+        errno = EPROTO;
+        return NULL;
+    }
+
+    kelp_kernel_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return NULL;
+
+    void *mem = mmap(NULL, (size_t)h.map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->fd        = fd;
+    ring->hdr       = mem;
+    ring->desc      = (struct kelp_ring_desc *)((uint8_t *)mem + h.desc_offset);
+    ring->data      = (uint8_t *)mem + h.data_offset;
+    ring->map_size  = (size_t)h.map_size;
+    ring->nslots    = h.nslots;
+    ring->slot_size = h.slot_size;
+    return ring;
+}
+
+void kelp_kernel_ring_unmap(kelp_kernel_ring_t *ring)
+{
+    if (!ring)
+        return;
+    munmap(ring->hdr, ring->map_size);
+    free(ring);
+}
+
+size_t kelp_kernel_ring_max_msg(const kelp_kernel_ring_t *ring)
+{
+    return ring ? ring->slot_size : 0;
+}
+
+/* ---- Waiting ------------------------------------------------------------ */
+
+static struct kelp_ring_desc *slot_desc(kelp_kernel_ring_t *ring, uint64_t pos)
+{
+    return &ring->desc[pos & (ring->nslots - 1)];
+}
+
+static bool ring_ready(kelp_kernel_ring_t *ring, uint32_t event)
+{
+    if (event == KELP_RING_WAIT_DATA) {
+        uint64_t tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_RELAXED);
+        return __atomic_load_n(&slot_desc(ring, tail)->seq, __ATOMIC_ACQUIRE) == tail + 1;
+    }
+    uint64_t head = __atomic_load_n(&ring->hdr->head, __ATOMIC_RELAXED);
+    return __atomic_load_n(&slot_desc(ring, head)->seq, __ATOMIC_ACQUIRE) == head;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Wait until the ring may have data (or space).  Returns 0 to retry the
+ * operation, -1 with errno set on timeout or error.  *deadline is set on
+ * the first call.
+ */
+static int ring_wait(kelp_kernel_ring_t *ring, uint32_t event, int timeout_ms,
+                     int64_t *deadline, unsigned *spins)
+{
+    if (timeout_ms == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (*spins < RING_SPIN) {
+        (*spins)++;
+        cpu_relax();
+        return 0;
+    }
+
+    int32_t remaining = -1;
+    if (timeout_ms > 0) {
+        if (*deadline == 0)
+            *deadline = now_ms() + timeout_ms;
+        int64_t left = *deadline - now_ms();
+        if (left <= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        remaining = (int32_t)left;
+    }
+
+    uint32_t *waiters = event == KELP_RING_WAIT_DATA ? &ring->hdr->cons_waiters
+                                                     : &ring->hdr->prod_waiters;
+    __atomic_fetch_add(waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int rc = 0;
+    if (!ring_ready(ring, event)) {
+        struct kelp_ring_wait w = { .event = event, .timeout_ms = remaining };
+        if (ioctl(ring->fd, KELP_IOC_RING_WAIT, &w) != 0) {
+            if (errno == ENOTTY) {
+                /* Not backed by the module (e.g. a plain shared file):
+                 * fall back to a short sleep. */
+                struct timespec ts = { 0, 100 * 1000 };
+                nanosleep(&ts, NULL);
+            } else if (errno != EINTR) {
+                rc = -1;
+            }
+        }
+    }
+
+    int saved = errno;
+    __atomic_fetch_sub(waiters, 1, __ATOMIC_SEQ_CST);
+    errno = saved;
+    return rc;
+}
+
+static void ring_kick(kelp_kernel_ring_t *ring, uint32_t event)
+{
+    const uint32_t *waiters = event == KELP_RING_WAIT_DATA ? &ring->hdr->cons_waiters
+                                                           : &ring->hdr->prod_waiters;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiters, __ATOMIC_RELAXED) != 0)
+        ioctl(ring->fd, KELP_IOC_RING_KICK, &event);
+}
+
+/* ---- Producing ---------------------------------------------------------- */
+
+int kelp_kernel_ring_reserve(kelp_kernel_ring_t *ring,
+                             kelp_kernel_ring_slot_t *slot, int timeout_ms)
+{
+    int64_t deadline = 0;
+    unsigned spins = 0;
+
+    if (!ring || !slot) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        uint64_t pos = __atomic_load_n(&ring->hdr->head, __ATOMIC_RELAXED);
+        uint64_t seq = __atomic_load_n(&slot_desc(ring, pos)->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->hdr->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->pos  = pos;
+                slot->data = ring->data + (size_t)(pos & (ring->nslots - 1)) * ring->slot_size;
+                slot->len  = ring->slot_size;
+                return 0;
+            }
+        } else if (diff < 0) {
+            /* Full: the consumer of this slot has not released it. */
+            if (ring_wait(ring, KELP_RING_WAIT_SPACE, timeout_ms, &deadline, &spins) != 0)
+                return -1;
+        }
+        /* diff > 0: another producer took pos; reload head. */
+    }
+}
+
+void kelp_kernel_ring_commit(kelp_kernel_ring_t *ring,
+                             kelp_kernel_ring_slot_t *slot, size_t len)
+{
+    struct kelp_ring_desc *d = slot_desc(ring, slot->pos);
+
+    d->len = (uint32_t)(len < ring->slot_size ? len : ring->slot_size);
+    __atomic_store_n(&d->seq, slot->pos + 1, __ATOMIC_RELEASE);
+    ring_kick(ring, KELP_RING_WAIT_DATA);
+}
+
+int kelp_kernel_ring_send(kelp_kernel_ring_t *ring, const void *msg,
+                          size_t len, int timeout_ms)
+{
+    kelp_kernel_ring_slot_t slot;
+
+    if (ring && len > ring->slot_size) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (kelp_kernel_ring_reserve(ring, &slot, timeout_ms) != 0)
+        return -1;
+    memcpy(slot.data, msg, len);
+    kelp_kernel_ring_commit(ring, &slot, len);
+    return 0;
+}
+
+/* ---- Consuming ---------------------------------------------------------- */
+
+int kelp_kernel_ring_peek(kelp_kernel_ring_t *ring,
+                          kelp_kernel_ring_slot_t *slot, int timeout_ms)
+{
+    int64_t deadline = 0;
+    unsigned spins = 0;
+
+    if (!ring || !slot) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        uint64_t pos = __atomic_load_n(&ring->hdr->tail, __ATOMIC_RELAXED);
+        struct kelp_ring_desc *d = slot_desc(ring, pos);
+        uint64_t seq = __atomic_load_n(&d->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->hdr->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                /* The length is peer-controlled; never trust it past the slot. */
+                uint32_t len = d->len;
+                slot->pos  = pos;
+                slot->data = ring->data + (size_t)(pos & (ring->nslots - 1)) * ring->slot_size;
+                slot->len  = len < ring->slot_size ? len : ring->slot_size;
+                return 0;
+            }
+        } else if (diff < 0) {
+            if (ring_wait(ring, KELP_RING_WAIT_DATA, timeout_ms, &deadline, &spins) != 0)
+                return -1;
+        }
+    }
+}
+
+void kelp_kernel_ring_release(kelp_kernel_ring_t *ring,
+                              kelp_kernel_ring_slot_t *slot)
+{
+    __atomic_store_n(&slot_desc(ring, slot->pos)->seq, slot->pos + ring->nslots,
+                     __ATOMIC_RELEASE);
+    ring_kick(ring, KELP_RING_WAIT_SPACE);
+}
+
+ssize_t kelp_kernel_ring_recv(kelp_kernel_ring_t *ring, void *buf,
+                              size_t cap, int timeout_ms)
+{
+    kelp_kernel_ring_slot_t slot;
+
+    if (kelp_kernel_ring_peek(ring, &slot, timeout_ms) != 0)
+        return -1;
+
+    size_t n = slot.len < cap ? slot.len : cap;
+    memcpy(buf, slot.data, n);
+    kelp_kernel_ring_release(ring, &slot);
+    return (ssize_t)slot.len;
+}
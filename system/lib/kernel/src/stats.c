@@ -0,0 +1,93 @@
+/*
+ * stats.c — Read-only stats page on /dev/kelp
+ *
+ * The module keeps every counter of KELP_IOC_GET_STATS and
+ * KELP_IOC_AI_STATUS in one mmap'able page (layout in kelp/kernel.h),
+ * rewritten periodically under a sequence count.  A reader copies the
+ * page between two identical even reads of the count, so a snapshot is
+ * consistent and costs no system call.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Attempts before giving up on a page that keeps changing under us. */
+#define STATS_RETRIES  64
+
+struct kelp_kernel_stats {
+    const struct kelp_stats_page *page;
+    size_t                        map_size;
+};
+
+kelp_kernel_stats_t *kelp_kernel_stats_map(int fd)
+{
+    size_t size = (size_t)sysconf(_SC_PAGESIZE);
+
+    const struct kelp_stats_page *page =
+        mmap(NULL, size, PROT_READ, MAP_SHARED, fd,
+             (off_t)KELP_STATS_MMAP_OFFSET);
+    if (page == MAP_FAILED)
+        return NULL;
+
+    if (page->magic != KELP_STATS_MAGIC ||
+        page->version != KELP_STATS_VERSION ||
+        page->size < sizeof(*page)) {
+        munmap((void *)page, size);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    kelp_kernel_stats_t *stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        munmap((void *)page, size);
+        return NULL;
+    }
+    stats->page     = page;
+    stats->map_size = size;
+    return stats;
+}
+
+void kelp_kernel_stats_unmap(kelp_kernel_stats_t *stats)
+{
+    if (!stats)
+        return;
+    munmap((void *)stats->page, stats->map_size);
+    free(stats);
+}
+
+int kelp_kernel_stats_read(const kelp_kernel_stats_t *stats,
+                           struct kelp_stats_page *out)
+{
+    if (!stats || !out) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const struct kelp_stats_page *p = stats->page;
+    for (int i = 0; i < STATS_RETRIES; i++) {
+        uint32_t seq = __atomic_load_n(&p->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            sched_yield();  /* update in progress */
+            continue;
+        }
+
+        memcpy(out, (const void *)p, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&p->seq, __ATOMIC_RELAXED) == seq) {
+            out->seq = seq;
+            return 0;
+        }
+    }
+
+    errno = EAGAIN;
+    return -1;
+}
@@ -0,0 +1,213 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * bench_chan_batch.c - channel message overhead: per-message vs batched
+ *
+ * One producer thread sends N messages to one consumer thread, which
+ * receives them the way a server does, three ways:
+ *
+ *   malloc+recv  a 64 KiB malloc() per message and one read() each, as
+ *                the gateway's kernel channel did
+ *   recv         kelp_kernel_chan_recv() into the caller's buffer, one
+ *                system call per message in each direction
+ *   batch        kelp_kernel_chan_send_batch() (kelp_kernel_sendv() on a
+ *                device client) and kelp_kernel_chan_recv_batch(), up to
+ *                KELP_KERNEL_BATCH_MAX messages per system call
+ *
+ * By default a SOCK_SEQPACKET socketpair stands in for the device, which
+ * measures the library's side of the protocol plus the socket's cost per
+ * datagram.  With --device, a client and a server descriptor on /dev/kelp
+ * are used instead.
+ *
+ * Usage: bench_chan_batch [--device] [messages]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum { MODE_MALLOC, MODE_RECV, MODE_BATCH } bench_mode_t;
+
+typedef struct {
+    bench_mode_t  mode;
+    bool          device;   /* producer is a /dev/kelp client */
+    int           fd;
+    size_t        size;
+    long          count;
+    long          bad;
+    long          calls;    /* receive system calls */
+} bench_arg_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int send_one(bench_arg_t *a, const char *msg, long i)
+{
+    struct kelp_msg_hdr hdr = { .channel = 1, .req_id = (uint64_t)i };
+
+    if (a->device)
+        return kelp_kernel_send(a->fd, msg, a->size);
+    return kelp_kernel_chan_send(a->fd, &hdr, msg, a->size);
+}
+
+static void *producer(void *p)
+{
+    bench_arg_t *a = p;
+    char *payload = malloc((size_t)KELP_KERNEL_BATCH_MAX * a->size);
+    kelp_kernel_msg_t msgs[KELP_KERNEL_BATCH_MAX];
+    struct iovec iov[KELP_KERNEL_BATCH_MAX];
+
+    for (long i = 0; i < a->count;) {
+        if (a->mode != MODE_BATCH) {
+            memset(payload, (int)(i & 0x7f), a->size);
+            if (send_one(a, payload, i) != 0)
+                a->bad++;
+            i++;
+            continue;
+        }
+
+        size_t n = 0;
+        for (; n < KELP_KERNEL_BATCH_MAX && i + (long)n < a->count; n++) {
+            char *m = payload + n * a->size;
+            memset(m, (int)((i + (long)n) & 0x7f), a->size);
+            msgs[n] = (kelp_kernel_msg_t){
+                .hdr  = { .channel = 1, .req_id = (uint64_t)(i + (long)n) },
+                .data = m,
+                .len  = a->size,
+            };
+            iov[n] = (struct iovec){ m, a->size };
+        }
+        int sent = a->device ? kelp_kernel_sendv(a->fd, iov, n)
+                             : kelp_kernel_chan_send_batch(a->fd, msgs, n);
+        if (sent <= 0) {
+            if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+                a->bad += a->count - i;
+                break;
+            }
+            continue;
+        }
+        i += sent;
+    }
+    free(payload);
+    return NULL;
+}
+
+static bool check(const bench_arg_t *a, const char *data, ssize_t n, long i)
+{
+    return n == (ssize_t)a->size && data[0] == (char)(i & 0x7f) &&
+           data[n - 1] == (char)(i & 0x7f);
+}
+
+static void *consumer(void *p)
+{
+    bench_arg_t *a = p;
+    char buf[KELP_MAX_MSG_SIZE];
+    kelp_kernel_msg_t msgs[KELP_KERNEL_BATCH_MAX];
+    struct kelp_msg_hdr hdr;
+
+    for (long i = 0; i < a->count;) {
+        if (a->mode == MODE_BATCH) {
+            int n = kelp_kernel_chan_recv_batch(a->fd, msgs,
+                                                KELP_KERNEL_BATCH_MAX);
+            a->calls++;
+            if (n <= 0) {
+                a->bad++;
+                break;
+            }
+            for (int k = 0; k < n; k++, i++) {
+                if (!check(a, msgs[k].data, (ssize_t)msgs[k].len, i))
+                    a->bad++;
+            }
+            continue;
+        }
+
+        char *dst = a->mode == MODE_MALLOC ? malloc(KELP_MAX_MSG_SIZE + 1) : buf;
+        ssize_t n = kelp_kernel_chan_recv(a->fd, &hdr, dst, KELP_MAX_MSG_SIZE);
+        a->calls++;
+        if (!check(a, dst, n, i))
+            a->bad++;
+        if (a->mode == MODE_MALLOC)
+            free(dst);
+        i++;
+    }
+    kelp_kernel_pool_release();
+    return NULL;
+}
+
+static int run(const char *label, bench_mode_t mode, bool device,
+               int wfd, int rfd, size_t size, long count)
+{
+    bench_arg_t pa = { mode, device, wfd, size, count, 0, 0 };
+    bench_arg_t ca = { mode, device, rfd, size, count, 0, 0 };
+    pthread_t pt, ct;
+
+    double t0 = now_sec();
+    pthread_create(&ct, NULL, consumer, &ca);
+    pthread_create(&pt, NULL, producer, &pa);
+    pthread_join(pt, NULL);
+    pthread_join(ct, NULL);
+    double dt = now_sec() - t0;
+
+    printf("  %-12s %6zu B  %10.0f msg/s  %7.1f ns/msg  %5.1f msg/call%s\n",
+           label, size, count / dt, dt / (double)count * 1e9,
+           ca.calls ? (double)count / (double)ca.calls : 0.0,
+           pa.bad + ca.bad ? "  (ERRORS)" : "");
+    return pa.bad + ca.bad ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 64, 1024, 4096 };
+    bool device = false;
+    long count = 200000;
+    int fds[2];
+    int rc = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--device") == 0)
+            device = true;
+        else if (atol(argv[i]) > 0)
+            count = atol(argv[i]);
+    }
+
+    if (device) {
+        fds[0] = kelp_kernel_open();
+        fds[1] = fds[0] >= 0 ? kelp_kernel_open() : -1;
+        if (fds[1] < 0 ||
+            kelp_kernel_chan_setup(fds[1], KELP_CHAN_SERVER, 0, 0) != 0) {
+            printf("/dev/kelp unavailable (%s): skipped\n", strerror(errno));
+            return 0;
+        }
+        printf("%ld messages, /dev/kelp client -> server\n", count);
+    } else {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+            perror("socketpair");
+            return 1;
+        }
+        printf("%ld messages, socketpair shim\n", count);
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        rc |= run("malloc+recv", MODE_MALLOC, device, fds[0], fds[1],
+                  sizes[i], count);
+        rc |= run("recv", MODE_RECV, device, fds[0], fds[1], sizes[i], count);
+        rc |= run("batch", MODE_BATCH, device, fds[0], fds[1], sizes[i], count);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    return rc ? 1 : 0;
+}
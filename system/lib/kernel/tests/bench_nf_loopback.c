@@ -0,0 +1,251 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * bench_nf_loopback.c - loopback TCP throughput under the netfilter hook
+ *
+ * An iperf-style sender/receiver pair over 127.0.0.1: each stream is a
+ * connected socket pair with one thread writing and one draining, for a
+ * fixed time, at a small and a large write size (the small one is the
+ * per-packet cost, the large one the bulk rate).  Run it with the kelp
+ * module unloaded and loaded to see what the LOCAL_OUT hook costs.
+ *
+ * When /dev/kelp is available the flow tables are exported after each
+ * run (KELP_IOC_NF_FLOWS) and the loopback flows are summed, as a check
+ * that every packet was accounted and to time the export itself.
+ *
+ * Usage: bench_nf_loopback [seconds] [streams]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_STREAMS  64
+
+typedef struct {
+    int          fd;
+    size_t       size;
+    atomic_bool *stop;
+    uint64_t     bytes;
+} stream_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *sender(void *p)
+{
+    stream_t *s = p;
+    char *buf = calloc(1, s->size);
+
+    while (buf && !atomic_load(s->stop)) {
+        ssize_t n = send(s->fd, buf, s->size, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        s->bytes += (uint64_t)n;
+    }
+    shutdown(s->fd, SHUT_WR);
+    free(buf);
+    return NULL;
+}
+
+static void *receiver(void *p)
+{
+    stream_t *s = p;
+    char buf[64 * 1024];
+
+    for (;;) {
+        ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        s->bytes += (uint64_t)n;
+    }
+    return NULL;
+}
+
+/* Connected loopback pair; returns 0 with the client and server ends */
+static int tcp_pair(int lfd, const struct sockaddr_in *addr, int *cfd, int *sfd)
+{
+    int one = 1;
+
+    *cfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*cfd < 0)
+        return -1;
+    setsockopt(*cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(*cfd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+        close(*cfd);
+        return -1;
+    }
+    *sfd = accept(lfd, NULL, NULL);
+    if (*sfd < 0) {
+        close(*cfd);
+        return -1;
+    }
+    return 0;
+}
+
+/* Sum the exported flows on loopback; -1 if flows are unavailable */
+static int drain_flows(int kfd, uint64_t *packets, uint64_t *bytes,
+                       uint64_t *overflow, double *ms)
+{
+    struct kelp_nf_flow *flows = calloc(KELP_NF_BATCH_MAX, sizeof(*flows));
+    bool more = true;
+    int total = 0;
+
+    *packets = *bytes = 0;
+    if (!flows)
+        return -1;
+
+    double t0 = now_sec();
+    while (more) {
+        int n = kelp_kernel_get_flows(kfd, flows, KELP_NF_BATCH_MAX,
+                                      &more, overflow);
+        if (n < 0) {
+            free(flows);
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (flows[i].daddr != htonl(INADDR_LOOPBACK))
+                continue;
+            *packets += flows[i].packets;
+            *bytes += flows[i].bytes;
+        }
+        total += n;
+    }
+    *ms = (now_sec() - t0) * 1e3;
+    free(flows);
+    return total;
+}
+
+static int run(int lfd, const struct sockaddr_in *addr, int kfd,
+               size_t size, int streams, double seconds)
+{
+    stream_t tx[BENCH_MAX_STREAMS], rx[BENCH_MAX_STREAMS];
+    pthread_t tt[BENCH_MAX_STREAMS], rt[BENCH_MAX_STREAMS];
+    atomic_bool stop = false;
+    uint64_t fp, fb, overflow = 0;
+    double export_ms;
+
+    memset(tx, 0, sizeof(tx));
+    memset(rx, 0, sizeof(rx));
+
+    /* Start the interval from empty tables */
+    if (kfd >= 0)
+        drain_flows(kfd, &fp, &fb, &overflow, &export_ms);
+
+    for (int i = 0; i < streams; i++) {
+        int cfd, sfd;
+        if (tcp_pair(lfd, addr, &cfd, &sfd) != 0) {
+            perror("loopback connect");
+            return -1;
+        }
+        tx[i] = (stream_t){ .fd = cfd, .size = size, .stop = &stop };
+        rx[i] = (stream_t){ .fd = sfd, .size = size, .stop = &stop };
+    }
+
+    double t0 = now_sec();
+    for (int i = 0; i < streams; i++) {
+        pthread_create(&rt[i], NULL, receiver, &rx[i]);
+        pthread_create(&tt[i], NULL, sender, &tx[i]);
+    }
+    struct timespec ts = {
+        .tv_sec  = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (double)(time_t)seconds) * 1e9),
+    };
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, true);
+
+    uint64_t received = 0;
+    for (int i = 0; i < streams; i++) {
+        pthread_join(tt[i], NULL);
+        pthread_join(rt[i], NULL);
+        received += rx[i].bytes;
+        close(tx[i].fd);
+        close(rx[i].fd);
+    }
+    double dt = now_sec() - t0;
+
+    printf("  %6zu B writes  %9.2f Gbit/s  %10.0f writes/s",
+           size, (double)received * 8 / dt / 1e9,
+           (double)received / (double)size / dt);
+
+    if (kfd >= 0) {
+        int n = drain_flows(kfd, &fp, &fb, &overflow, &export_ms);
+        if (n >= 0)
+            printf("  | %d flows, %llu pkts, export %.2f ms, overflow %llu",
+                   n, (unsigned long long)fp, export_ms,
+                   (unsigned long long)overflow);
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    int streams    = argc > 2 ? atoi(argv[2]) : 4;
+    int one = 1;
+
+    if (seconds <= 0)
+        seconds = 3.0;
+    if (streams <= 0 || streams > BENCH_MAX_STREAMS)
+        streams = 4;
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t alen = sizeof(addr);
+
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (lfd < 0 ||
+        bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(lfd, BENCH_MAX_STREAMS) != 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &alen) != 0) {
+        perror("loopback listen");
+        return 1;
+    }
+
+    /* Flow export is optional: without the module only throughput shows */
+    int kfd = kelp_kernel_available() ? kelp_kernel_open() : -1;
+    if (kfd >= 0) {
+        struct kelp_nf_flow probe;
+        if (kelp_kernel_get_flows(kfd, &probe, 1, NULL, NULL) < 0) {
+            kelp_kernel_close(kfd);
+            kfd = -1;
+        }
+    }
+
+    printf("loopback TCP, %d streams, %.1f s per size, flow export %s\n",
+           streams, seconds, kfd >= 0 ? "on" : "unavailable");
+
+    int rc = 0;
+    rc |= run(lfd, &addr, kfd, 64, streams, seconds);
+    rc |= run(lfd, &addr, kfd, 64 * 1024, streams, seconds);
+
+    if (kfd >= 0)
+        kelp_kernel_close(kfd);
+    close(lfd);
+    return rc ? 1 : 0;
+}
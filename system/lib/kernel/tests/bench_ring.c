@@ -0,0 +1,228 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * bench_ring.c - /dev/kelp throughput: shared ring vs read()/write()
+ *
+ * One producer thread sends N messages and one consumer thread receives
+ * them, for several message sizes, through:
+ *
+ *   write/read   kelp_kernel_send() on a client descriptor and
+ *                kelp_kernel_chan_recv() on a server one
+ *   ring         kelp_kernel_ring_send() / kelp_kernel_ring_recv()
+ *   ring (0cp)   kelp_kernel_ring_reserve/commit and peek/release, filling
+ *                and checking the payload in place
+ *
+ * Without the kelp module loaded, the ring runs over a memfd laid out the
+ * way the module lays out its pages, which measures the user-space side of
+ * the protocol only (waits fall back to short sleeps); the read()/write()
+ * rows are skipped.
+ *
+ * Usage: bench_ring [messages]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MEMFD_SLOTS      256
+#define MEMFD_SLOT_SIZE  4096
+#define RECV_BUF_SIZE    (64 * 1024)
+
+typedef enum { MODE_RW, MODE_RING, MODE_RING_INPLACE } bench_mode_t;
+
+typedef struct {
+    bench_mode_t        mode;
+    kelp_kernel_ring_t *ring;
+    int                 fd;
+    size_t              size;
+    long                count;
+    long                bad;
+} bench_arg_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *producer(void *p)
+{
+    bench_arg_t *a = p;
+    char *msg = malloc(a->size);
+
+    for (long i = 0; i < a->count; i++) {
+        switch (a->mode) {
+        case MODE_RW:
+            memset(msg, (int)(i & 0x7f), a->size);
+            if (kelp_kernel_send(a->fd, msg, a->size) != 0)
+                a->bad++;
+            break;
+        case MODE_RING:
+            memset(msg, (int)(i & 0x7f), a->size);
+            if (kelp_kernel_ring_send(a->ring, msg, a->size, -1) != 0)
+                a->bad++;
+            break;
+        case MODE_RING_INPLACE: {
+            kelp_kernel_ring_slot_t slot;
+            if (kelp_kernel_ring_reserve(a->ring, &slot, -1) != 0) {
+                a->bad++;
+                break;
+            }
+            memset(slot.data, (int)(i & 0x7f), a->size);
+            kelp_kernel_ring_commit(a->ring, &slot, a->size);
+            break;
+        }
+        }
+    }
+    free(msg);
+    return NULL;
+}
+
+static void *consumer(void *p)
+{
+    bench_arg_t *a = p;
+    char *buf = malloc(RECV_BUF_SIZE);
+
+    for (long i = 0; i < a->count; i++) {
+        const char *data = buf;
+        ssize_t n;
+        kelp_kernel_ring_slot_t slot;
+        struct kelp_msg_hdr hdr;
+
+        switch (a->mode) {
+        case MODE_RW:
+            n = kelp_kernel_chan_recv(a->fd, &hdr, buf, RECV_BUF_SIZE);
+            break;
+        case MODE_RING:
+            n = kelp_kernel_ring_recv(a->ring, buf, RECV_BUF_SIZE, -1);
+            break;
+        default:
+            if (kelp_kernel_ring_peek(a->ring, &slot, -1) != 0) {
+                n = -1;
+                break;
+            }
+            data = slot.data;
+            n = (ssize_t)slot.len;
+            break;
+        }
+
+        if (n != (ssize_t)a->size || data[0] != (char)(i & 0x7f) ||
+            data[n - 1] != (char)(i & 0x7f))
+            a->bad++;
+        if (a->mode == MODE_RING_INPLACE && n >= 0)
+            kelp_kernel_ring_release(a->ring, &slot);
+    }
+    free(buf);
+    return NULL;
+}
+
+static int run(const char *label, bench_mode_t mode, kelp_kernel_ring_t *ring,
+               int wfd, int rfd, size_t size, long count)
+{
+    bench_arg_t pa = { mode, ring, wfd, size, count, 0 };
+    bench_arg_t ca = { mode, ring, rfd, size, count, 0 };
+    pthread_t pt, ct;
+
+    double t0 = now_sec();
+    pthread_create(&ct, NULL, consumer, &ca);
+    pthread_create(&pt, NULL, producer, &pa);
+    pthread_join(pt, NULL);
+    pthread_join(ct, NULL);
+    double dt = now_sec() - t0;
+
+    printf("  %-12s %6zu B  %10.0f msg/s  %8.1f MB/s%s\n", label, size,
+           count / dt, (double)count * size / dt / 1e6,
+           pa.bad + ca.bad ? "  (ERRORS)" : "");
+    return pa.bad + ca.bad ? -1 : 0;
+}
+
+/* Lay out a ring in a memfd the way kelp_ring.c does. */
+static int memfd_ring(void)
+{
+    size_t desc_off = 4096;
+    size_t data_off = desc_off + MEMFD_SLOTS * sizeof(struct kelp_ring_desc);
+    size_t size = data_off + (size_t)MEMFD_SLOTS * MEMFD_SLOT_SIZE;
+
+    int fd = memfd_create("kelp-ring-bench", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0)
+        return -1;
+
+    uint8_t *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+        return -1;
+
+    struct kelp_ring_hdr *hdr = (struct kelp_ring_hdr *)mem;
+    hdr->magic       = KELP_RING_MAGIC;
+    hdr->version     = KELP_RING_VERSION;
+    hdr->nslots      = MEMFD_SLOTS;
+    hdr->slot_size   = MEMFD_SLOT_SIZE;
+    hdr->desc_offset = desc_off;
+    hdr->data_offset = data_off;
+    hdr->map_size    = size;
+
+    struct kelp_ring_desc *desc = (struct kelp_ring_desc *)(mem + desc_off);
+    for (uint32_t i = 0; i < MEMFD_SLOTS; i++)
+        desc[i].seq = i;
+
+    munmap(mem, size);
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 64, 512, 4096 };
+    long count = argc > 1 ? atol(argv[1]) : 200000;
+    int rc = 0;
+
+    if (count <= 0)
+        count = 200000;
+
+    int wfd = kelp_kernel_open();
+    int rfd = wfd >= 0 ? kelp_kernel_open() : -1;
+    int ring_fd = wfd;
+    bool device = wfd >= 0 && rfd >= 0 &&
+                  kelp_kernel_chan_setup(rfd, KELP_CHAN_SERVER, 0, 0) == 0;
+
+    if (!device) {
+        printf("/dev/kelp unavailable (%s): ring over a memfd only\n\n",
+               strerror(errno));
+        ring_fd = memfd_ring();
+        if (ring_fd < 0) {
+            perror("memfd");
+            return 1;
+        }
+    }
+
+    kelp_kernel_ring_t *ring = kelp_kernel_ring_map(ring_fd);
+    if (!ring) {
+        perror("kelp_kernel_ring_map");
+        return 1;
+    }
+
+    printf("%ld messages, 1 producer -> 1 consumer\n", count);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (device)
+            rc |= run("write/read", MODE_RW, NULL, wfd, rfd, sizes[i], count);
+        rc |= run("ring", MODE_RING, ring, -1, -1, sizes[i], count);
+        rc |= run("ring (0cp)", MODE_RING_INPLACE, ring, -1, -1, sizes[i], count);
+    }
+
+    kelp_kernel_ring_unmap(ring);
+    if (device) {
+        kelp_kernel_close(wfd);
+        kelp_kernel_close(rfd);
+    } else {
+        close(ring_fd);
+    }
+    return rc ? 1 : 0;
+}
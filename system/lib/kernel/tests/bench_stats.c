@@ -0,0 +1,85 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * bench_stats.c - counter snapshot cost: ioctls vs the mmap'd stats page
+ *
+ * Takes N snapshots of every module counter two ways:
+ *
+ *   ioctl   KELP_IOC_GET_STATS + KELP_IOC_AI_STATUS (two system calls)
+ *   page    kelp_kernel_stats_read() on the read-only stats page
+ *
+ * and reports the time per snapshot, plus how often the page changed
+ * between reads and how often a read had to retry past an update.  Needs
+ * the kelp module loaded; without it the benchmark is skipped.
+ *
+ * Usage: bench_stats [snapshots]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+
+    if (n <= 0)
+        n = 1000000;
+
+    if (!kelp_kernel_available()) {
+        printf("/dev/kelp unavailable: skipped\n");
+        return 0;
+    }
+
+    int fd = kelp_kernel_open();
+    kelp_kernel_stats_t *stats = fd >= 0 ? kelp_kernel_stats_map(fd) : NULL;
+    if (!stats) {
+        perror("kelp_kernel_stats_map");
+        return 1;
+    }
+
+    struct kelp_kstats ks;
+    struct kelp_ai_status ai;
+    double t0 = now_sec();
+    for (long i = 0; i < n; i++) {
+        if (kelp_kernel_get_stats(fd, &ks) != 0 ||
+            kelp_kernel_get_ai_status(fd, &ai) != 0) {
+            perror("ioctl");
+            return 1;
+        }
+    }
+    double dt_ioctl = now_sec() - t0;
+
+    struct kelp_stats_page page = {0};
+    uint32_t last_seq = 0;
+    long changes = 0, failures = 0;
+    t0 = now_sec();
+    for (long i = 0; i < n; i++) {
+        if (kelp_kernel_stats_read(stats, &page) != 0) {
+            failures++;
+            continue;
+        }
+        changes += page.seq != last_seq;
+        last_seq = page.seq;
+    }
+    double dt_page = now_sec() - t0;
+
+    printf("%ld snapshots, page refreshed every %u ms\n", n, page.interval_ms);
+    printf("  ioctl  %8.1f ns/snapshot\n", dt_ioctl / (double)n * 1e9);
+    printf("  page   %8.1f ns/snapshot  (%ld updates seen, %ld reads gave up)\n",
+           dt_page / (double)n * 1e9, changes, failures);
+
+    kelp_kernel_stats_unmap(stats);
+    kelp_kernel_close(fd);
+    return failures ? 1 : 0;
+}
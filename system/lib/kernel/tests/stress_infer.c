@@ -0,0 +1,240 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * stress_infer.c - inference scheduler stress test: single vs batched ioctls
+ *
+ * Producer threads submit N tasks (mixed priorities) and consumer threads
+ * drain them, each thread on its own /dev/kelp descriptor, in two rounds:
+ *
+ *   single   one task per KELP_IOC_SUBMIT_INFER / KELP_IOC_POLL_INFER,
+ *            consumers retrying on EAGAIN (the pre-batch protocol)
+ *   batch    KELP_IOC_SUBMIT_BATCH / KELP_IOC_POLL_BATCH, consumers
+ *            sleeping in the kernel until work arrives
+ *
+ * Every task must come out exactly once; the run fails on a lost or
+ * duplicated task.  Tasks that are not ours (another user of the
+ * scheduler) are counted and ignored.  Needs the kelp module loaded;
+ * without it the test is skipped.
+ *
+ * Usage: stress_infer [tasks] [producers] [consumers] [batch]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STRESS_HINT  "kelp-stress"
+
+typedef struct {
+    bool                 batched;
+    long                 total;
+    int                  producers;
+    int                  batch;
+    atomic_long          received;
+    atomic_long          foreign;
+    atomic_long          syscalls;
+    atomic_long          errors;
+    atomic_uchar        *seen;
+} stress_t;
+
+typedef struct {
+    stress_t *s;
+    int       index;
+} worker_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void make_task(struct kelp_infer_task *t, long seq)
+{
+    memset(t, 0, sizeof(*t));
+    t->priority   = (int32_t)(seq % 8);
+    t->est_tokens = (uint32_t)seq;
+    snprintf(t->model_hint, sizeof(t->model_hint), "%s", STRESS_HINT);
+}
+
+static void take_task(stress_t *s, const struct kelp_infer_task *t)
+{
+    if (strcmp(t->model_hint, STRESS_HINT) != 0 || t->est_tokens >= s->total) {
+        atomic_fetch_add(&s->foreign, 1);
+        return;
+    }
+    if (atomic_exchange(&s->seen[t->est_tokens], 1) != 0)
+        atomic_fetch_add(&s->errors, 1);  /* duplicate */
+    atomic_fetch_add(&s->received, 1);
+}
+
+static void *producer(void *p)
+{
+    worker_t *w = p;
+    stress_t *s = w->s;
+    struct kelp_infer_task *tasks = calloc((size_t)s->batch, sizeof(*tasks));
+    int fd = kelp_kernel_open();
+
+    if (fd < 0 || !tasks) {
+        atomic_fetch_add(&s->errors, 1);
+        goto out;
+    }
+
+    /* Producer i owns sequence numbers i, i + producers, ... */
+    long seq = w->index;
+    while (seq < s->total) {
+        int n = 0;
+        for (long q = seq; n < s->batch && q < s->total; q += s->producers)
+            make_task(&tasks[n++], q);
+
+        int done;
+        if (s->batched) {
+            done = kelp_kernel_submit_infer_batch(fd, tasks, (size_t)n);
+        } else {
+            done = kelp_kernel_submit_infer(fd, &tasks[0]) == 0 ? 1 : -1;
+        }
+        atomic_fetch_add(&s->syscalls, 1);
+
+        if (done < 0) {
+            if (errno != ENOSPC) {
+                atomic_fetch_add(&s->errors, 1);
+                break;
+            }
+            sched_yield();  /* queue full: let consumers catch up */
+            continue;
+        }
+        seq += (long)done * s->producers;
+    }
+
+out:
+    if (fd >= 0)
+        kelp_kernel_close(fd);
+    free(tasks);
+    return NULL;
+}
+
+static void *consumer(void *p)
+{
+    worker_t *w = p;
+    stress_t *s = w->s;
+    struct kelp_infer_task *tasks = calloc((size_t)s->batch, sizeof(*tasks));
+    int fd = kelp_kernel_open();
+
+    if (fd < 0 || !tasks) {
+        atomic_fetch_add(&s->errors, 1);
+        goto out;
+    }
+
+    while (atomic_load(&s->received) < s->total &&
+           atomic_load(&s->errors) == 0) {
+        int n;
+        if (s->batched) {
+            n = kelp_kernel_poll_infer_batch(fd, tasks, (size_t)s->batch, 100);
+        } else {
+            n = kelp_kernel_poll_infer(fd, &tasks[0]) == 0 ? 1 : -1;
+        }
+        atomic_fetch_add(&s->syscalls, 1);
+
+        if (n < 0) {
+            if (errno != EAGAIN && errno != ETIMEDOUT && errno != EINTR) {
+                atomic_fetch_add(&s->errors, 1);
+                break;
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+            take_task(s, &tasks[i]);
+    }
+
+out:
+    if (fd >= 0)
+        kelp_kernel_close(fd);
+    free(tasks);
+    return NULL;
+}
+
+static int run(const char *label, bool batched, long total, int producers,
+               int consumers, int batch)
+{
+    stress_t s = {
+        .batched   = batched,
+        .total     = total,
+        .producers = producers,
+        .batch     = batched ? batch : 1,
+    };
+    s.seen = calloc((size_t)total, sizeof(*s.seen));
+
+    worker_t *w = calloc((size_t)(producers + consumers), sizeof(*w));
+    pthread_t *t = calloc((size_t)(producers + consumers), sizeof(*t));
+    if (!s.seen || !w || !t) {
+        perror("calloc");
+        return -1;
+    }
+
+    double t0 = now_sec();
+    for (int i = 0; i < producers + consumers; i++) {
+        w[i].s = &s;
+        w[i].index = i < producers ? i : i - producers;
+        pthread_create(&t[i], NULL, i < producers ? producer : consumer, &w[i]);
+    }
+    for (int i = 0; i < producers + consumers; i++)
+        pthread_join(t[i], NULL);
+    double dt = now_sec() - t0;
+
+    long missing = 0;
+    for (long i = 0; i < total; i++)
+        missing += s.seen[i] == 0;
+
+    printf("  %-7s %10.0f tasks/s  %8.2f tasks/syscall%s",
+           label, total / dt, (double)total * 2 / atomic_load(&s.syscalls),
+           atomic_load(&s.foreign) ? "  (foreign tasks seen)" : "");
+    if (missing || atomic_load(&s.errors))
+        printf("  FAILED: %ld missing, %ld errors", missing,
+               atomic_load(&s.errors));
+    printf("\n");
+
+    int rc = missing || atomic_load(&s.errors) ? -1 : 0;
+    free(s.seen);
+    free(w);
+    free(t);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    long total    = argc > 1 ? atol(argv[1]) : 200000;
+    int producers = argc > 2 ? atoi(argv[2]) : 4;
+    int consumers = argc > 3 ? atoi(argv[3]) : 4;
+    int batch     = argc > 4 ? atoi(argv[4]) : 64;
+
+    if (total <= 0 || total > UINT32_MAX)
+        total = 200000;
+    if (producers <= 0)
+        producers = 4;
+    if (consumers <= 0)
+        consumers = 4;
+    if (batch <= 0 || batch > KELP_INFER_BATCH_MAX)
+        batch = 64;
+
+    if (!kelp_kernel_available()) {
+        printf("/dev/kelp unavailable: skipped\n");
+        return 0;
+    }
+
+    printf("%ld tasks, %d producers -> %d consumers, batch %d\n",
+           total, producers, consumers, batch);
+
+    int rc = 0;
+    rc |= run("single", false, total, producers, consumers, batch);
+    rc |= run("batch", true, total, producers, consumers, batch);
+    return rc ? 1 : 0;
+}
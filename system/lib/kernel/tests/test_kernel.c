@@ -0,0 +1,456 @@
+/*
+ * kelp-linux :: libkelp-kernel
+ * test_kernel.c - Unit tests for the /dev/kelp channel library
+ *
+ * Tests the caller-buffer and batched channel calls, and the tensor
+ * buffer API.  A SOCK_SEQPACKET socketpair stands in for the device, so
+ * no module is needed; with the module loaded, buffers are also shared
+ * between two descriptors for real (no GPU needed: it is host memory).
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/kernel.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int tests_run    = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        tests_run++; \
+        printf("  %-50s ", #name); \
+        fflush(stdout); \
+    } while (0)
+
+#define PASS() \
+    do { \
+        tests_passed++; \
+        printf("[PASS]\n"); \
+    } while (0)
+
+#define FAIL(msg) \
+    do { \
+        printf("[FAIL] %s\n", (msg)); \
+    } while (0)
+
+#define ASSERT_TRUE(expr) \
+    do { \
+        if (!(expr)) { FAIL(#expr " is false"); goto out; } \
+    } while (0)
+
+#define ASSERT_EQ_INT(a, b) \
+    do { \
+        if ((long)(a) != (long)(b)) { \
+            char _buf[128]; \
+            snprintf(_buf, sizeof(_buf), "%s == %ld, expected %ld", \
+                     #a, (long)(a), (long)(b)); \
+            FAIL(_buf); goto out; \
+        } \
+    } while (0)
+
+#define ASSERT_EQ_STR(a, b) \
+    do { \
+        if (strcmp((a), (b)) != 0) { \
+            char _buf[256]; \
+            snprintf(_buf, sizeof(_buf), "%s == \"%s\", expected \"%s\"", \
+                     #a, (a), (b)); \
+            FAIL(_buf); goto out; \
+        } \
+    } while (0)
+
+/* A non-blocking device stand-in: sv[0] plays the module, sv[1] the server */
+static bool chan_pair(int sv[2])
+{
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0)
+        return false;
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+static void chan_close(int sv[2])
+{
+    close(sv[0]);
+    close(sv[1]);
+}
+
+/* Queue one framed message on @fd, as the module would for a server. */
+static bool chan_put(int fd, uint32_t channel, uint64_t req_id,
+                     const char *data, size_t len)
+{
+    struct kelp_msg_hdr h = { .channel = channel, .req_id = req_id,
+                              .len = (uint32_t)len };
+    struct iovec iov[2] = {
+        { &h, sizeof(h) },
+        { (void *)data, len },
+    };
+    struct msghdr mh = { .msg_iov = iov, .msg_iovlen = 2 };
+    return sendmsg(fd, &mh, 0) == (ssize_t)(sizeof(h) + len);
+}
+
+/* ======================================================================== */
+/* Caller-buffer receive                                                    */
+/* ======================================================================== */
+
+static void test_recv_into(void)
+{
+    int sv[2] = { -1, -1 };
+    char buf[8];
+
+    TEST(recv_into);
+    ASSERT_TRUE(chan_pair(sv));
+    ASSERT_EQ_INT(write(sv[0], "hello", 5), 5);
+    ASSERT_EQ_INT(kelp_kernel_recv_into(sv[1], buf, sizeof(buf)), 5);
+    ASSERT_EQ_STR(buf, "hello");
+
+    /* One byte is kept for the terminator */
+    ASSERT_EQ_INT(write(sv[0], "truncated", 9), 9);
+    ASSERT_EQ_INT(kelp_kernel_recv_into(sv[1], buf, sizeof(buf)), 7);
+    ASSERT_EQ_STR(buf, "truncat");
+
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_recv_into(sv[1], buf, 0), -1);
+    ASSERT_EQ_INT(errno, EINVAL);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_chan_recv_short(void)
+{
+    int sv[2] = { -1, -1 };
+    struct kelp_msg_hdr hdr;
+    char buf[4];
+
+    TEST(chan_recv_short);
+    ASSERT_TRUE(chan_pair(sv));
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    ASSERT_TRUE(chan_put(sv[0], 3, 100, "too long", 8));
+    ASSERT_TRUE(chan_put(sv[0], 4, 101, "ok", 2));
+
+    /* The long message is consumed whole, not split into a fake header */
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[1], &hdr, buf, sizeof(buf)), -1);
+    ASSERT_EQ_INT(errno, EMSGSIZE);
+    ASSERT_EQ_INT(hdr.req_id, 100);
+    ASSERT_EQ_INT(hdr.len, 8);
+
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[1], &hdr, buf, sizeof(buf)), 2);
+    ASSERT_EQ_INT(hdr.channel, 4);
+    ASSERT_EQ_INT(hdr.req_id, 101);
+    ASSERT_TRUE(memcmp(buf, "ok", 2) == 0);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+/* ======================================================================== */
+/* Batched channel I/O                                                      */
+/* ======================================================================== */
+
+static void test_recv_batch(void)
+{
+    int sv[2] = { -1, -1 };
+    kelp_kernel_msg_t msgs[KELP_KERNEL_BATCH_MAX];
+    char big[KELP_KERNEL_BATCH_SLOT * 2];
+
+    TEST(recv_batch);
+    ASSERT_TRUE(chan_pair(sv));
+    memset(big, 'x', sizeof(big));
+
+    ASSERT_TRUE(chan_put(sv[0], 3, 100, "first", 5));
+    ASSERT_TRUE(chan_put(sv[0], 4, 101, "", 0));
+    ASSERT_TRUE(chan_put(sv[0], 5, 102, big, sizeof(big)));
+
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs,
+                                              KELP_KERNEL_BATCH_MAX), 3);
+    ASSERT_EQ_INT(msgs[0].hdr.channel, 3);
+    ASSERT_EQ_INT(msgs[0].hdr.req_id, 100);
+    ASSERT_EQ_INT(msgs[0].len, 5);
+    ASSERT_EQ_STR(msgs[0].data, "first");
+    ASSERT_EQ_INT(msgs[1].hdr.req_id, 101);
+    ASSERT_EQ_INT(msgs[1].len, 0);
+    ASSERT_EQ_STR(msgs[1].data, "");
+
+    /* Past the first slot, a long message still arrives whole */
+    ASSERT_EQ_INT(msgs[2].len, sizeof(big));
+    ASSERT_TRUE(memcmp(msgs[2].data, big, sizeof(big)) == 0);
+    ASSERT_EQ_INT(msgs[2].data[sizeof(big)], '\0');
+
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs, 4), -1);
+    ASSERT_EQ_INT(errno, EAGAIN);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_recv_batch_max(void)
+{
+    int sv[2] = { -1, -1 };
+    kelp_kernel_msg_t msgs[4];
+
+    TEST(recv_batch_max);
+    ASSERT_TRUE(chan_pair(sv));
+    for (uint64_t i = 0; i < 6; i++)
+        ASSERT_TRUE(chan_put(sv[0], 1, i, "m", 1));
+
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs, 4), 4);
+    ASSERT_EQ_INT(msgs[3].hdr.req_id, 3);
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs, 4), 2);
+    ASSERT_EQ_INT(msgs[0].hdr.req_id, 4);
+    ASSERT_EQ_INT(msgs[1].hdr.req_id, 5);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_send_batch(void)
+{
+    int sv[2] = { -1, -1 };
+    struct kelp_msg_hdr hdr;
+    char buf[64];
+    kelp_kernel_msg_t out[3] = {
+        { .hdr = { .channel = 7, .req_id = 1 }, .data = "alpha", .len = 5 },
+        { .hdr = { .channel = 8, .req_id = 2, .len = 999 }, .data = NULL },
+        { .hdr = { .channel = 9, .req_id = 3 }, .data = "gamma", .len = 5 },
+    };
+
+    TEST(send_batch);
+    ASSERT_TRUE(chan_pair(sv));
+    ASSERT_EQ_INT(kelp_kernel_chan_send_batch(sv[1], out, 3), 3);
+
+    /* One frame per message, with hdr.len taken from the payload */
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[0], &hdr, buf, sizeof(buf)), 5);
+    ASSERT_EQ_INT(hdr.channel, 7);
+    ASSERT_EQ_INT(hdr.len, 5);
+    ASSERT_TRUE(memcmp(buf, "alpha", 5) == 0);
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[0], &hdr, buf, sizeof(buf)), 0);
+    ASSERT_EQ_INT(hdr.req_id, 2);
+    ASSERT_EQ_INT(hdr.len, 0);
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[0], &hdr, buf, sizeof(buf)), 5);
+    ASSERT_EQ_INT(hdr.channel, 9);
+    ASSERT_EQ_INT(kelp_kernel_chan_recv(sv[0], &hdr, buf, sizeof(buf)), -1);
+    ASSERT_EQ_INT(errno, EAGAIN);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_send_batch_invalid(void)
+{
+    int sv[2] = { -1, -1 };
+    kelp_kernel_msg_t m = { .data = NULL, .len = 4 };
+
+    TEST(send_batch_invalid);
+    ASSERT_TRUE(chan_pair(sv));
+
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_send_batch(sv[1], &m, 1), -1);
+    ASSERT_EQ_INT(errno, EINVAL);
+
+    m.data = "";
+    m.len = KELP_MAX_MSG_SIZE + 1;
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_send_batch(sv[1], &m, 1), -1);
+    ASSERT_EQ_INT(errno, EMSGSIZE);
+
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_send_batch(sv[1], &m, 0), -1);
+    ASSERT_EQ_INT(errno, EINVAL);
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], NULL, 4), -1);
+    ASSERT_EQ_INT(errno, EINVAL);
+    errno = 0;
+    ASSERT_EQ_INT(kelp_kernel_sendv(sv[1], NULL, 1), -1);
+    ASSERT_EQ_INT(errno, EINVAL);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_sendv(void)
+{
+    int sv[2] = { -1, -1 };
+    char buf[16];
+    struct iovec reqs[2] = {
+        { "one", 3 },
+        { "three", 5 },
+    };
+
+    TEST(sendv);
+    ASSERT_TRUE(chan_pair(sv));
+    ASSERT_EQ_INT(kelp_kernel_sendv(sv[1], reqs, 2), 2);
+
+    /* Requests go out as bare payloads, one per segment */
+    ASSERT_EQ_INT(kelp_kernel_recv_into(sv[0], buf, sizeof(buf)), 3);
+    ASSERT_EQ_STR(buf, "one");
+    ASSERT_EQ_INT(kelp_kernel_recv_into(sv[0], buf, sizeof(buf)), 5);
+    ASSERT_EQ_STR(buf, "three");
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static void test_pool_release(void)
+{
+    int sv[2] = { -1, -1 };
+    kelp_kernel_msg_t msgs[2];
+
+    TEST(pool_release);
+    ASSERT_TRUE(chan_pair(sv));
+
+    /* Releasing twice, or before any use, is harmless */
+    kelp_kernel_pool_release();
+    ASSERT_TRUE(chan_put(sv[0], 1, 1, "before", 6));
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs, 2), 1);
+    ASSERT_EQ_STR(msgs[0].data, "before");
+    kelp_kernel_pool_release();
+    kelp_kernel_pool_release();
+
+    ASSERT_TRUE(chan_put(sv[0], 1, 2, "after", 5));
+    ASSERT_EQ_INT(kelp_kernel_chan_recv_batch(sv[1], msgs, 2), 1);
+    ASSERT_EQ_STR(msgs[0].data, "after");
+    PASS();
+out:
+    chan_close(sv);
+}
+
+/* ======================================================================== */
+/* Tensor buffers                                                           */
+/* ======================================================================== */
+
+static void test_buf_invalid(void)
+{
+    int sv[2] = { -1, -1 };
+
+    TEST(buf_invalid);
+    ASSERT_TRUE(chan_pair(sv));
+
+    errno = 0;
+    ASSERT_TRUE(kelp_kernel_buf_alloc(sv[1], 0, 0) == NULL);
+    ASSERT_EQ_INT(errno, EINVAL);
+
+    /* Not the device: the ioctls are refused */
+    ASSERT_TRUE(kelp_kernel_buf_alloc(sv[1], 4096, 0) == NULL);
+    ASSERT_TRUE(kelp_kernel_buf_open(sv[1], 1) == NULL);
+    ASSERT_EQ_INT(kelp_kernel_buf_release(sv[1], 1), -1);
+
+    ASSERT_TRUE(kelp_kernel_buf_data(NULL) == NULL);
+    ASSERT_EQ_INT(kelp_kernel_buf_size(NULL), 0);
+    ASSERT_EQ_INT(kelp_kernel_buf_handle(NULL), 0);
+    kelp_kernel_buf_unmap(NULL);
+    PASS();
+out:
+    chan_close(sv);
+}
+
+static bool host_free(int fd, uint64_t *bytes)
+{
+    struct kelp_accel_list list;
+
+    if (kelp_kernel_accel_list(fd, &list) != 0 || list.count == 0 ||
+        list.accels[0].type != KELP_ACCEL_HOST)
+        return false;
+    *bytes = list.accels[0].memory_free;
+    return true;
+}
+
+static void test_buf_shared(void)
+{
+    int a = -1, b = -1;
+    kelp_kernel_buf_t *buf = NULL, *peer = NULL;
+    uint64_t before, during, after;
+
+    TEST(buf_shared);
+    a = kelp_kernel_open();
+    b = a >= 0 ? kelp_kernel_open() : -1;
+    if (b < 0 || !host_free(a, &before)) {
+        printf("[SKIP] no host accelerator\n");
+        tests_run--;
+        goto out;
+    }
+
+    buf = kelp_kernel_buf_alloc(a, 3 * 4096 + 1, 0);
+    ASSERT_TRUE(buf != NULL);
+    ASSERT_EQ_INT(kelp_kernel_buf_size(buf), 4 * 4096);
+    ASSERT_TRUE(host_free(a, &during));
+    ASSERT_EQ_INT(before - during, 4 * 4096);
+
+    uint8_t *p = kelp_kernel_buf_data(buf);
+    ASSERT_EQ_INT(p[0], 0);
+    p[0] = 0x5a;
+    p[4 * 4096 - 1] = 0xa5;
+
+    /* Same pages through the handle, from another descriptor */
+    peer = kelp_kernel_buf_open(b, kelp_kernel_buf_handle(buf));
+    ASSERT_TRUE(peer != NULL);
+    uint8_t *q = kelp_kernel_buf_data(peer);
+    ASSERT_EQ_INT(q[0], 0x5a);
+    ASSERT_EQ_INT(q[4 * 4096 - 1], 0xa5);
+
+    /* Only the reserving descriptor may withdraw the handle */
+    ASSERT_EQ_INT(kelp_kernel_buf_release(b, kelp_kernel_buf_handle(buf)), -1);
+    ASSERT_EQ_INT(errno, EPERM);
+    ASSERT_EQ_INT(kelp_kernel_buf_release(a, kelp_kernel_buf_handle(buf)), 0);
+    ASSERT_TRUE(kelp_kernel_buf_open(b, kelp_kernel_buf_handle(buf)) == NULL);
+    ASSERT_EQ_INT(errno, ENOENT);
+
+    /* Mappings keep the memory until the last one goes */
+    q[1] = 0x11;
+    ASSERT_EQ_INT(p[1], 0x11);
+    kelp_kernel_buf_unmap(buf);
+    buf = NULL;
+    kelp_kernel_buf_unmap(peer);
+    peer = NULL;
+    ASSERT_TRUE(host_free(a, &after));
+    ASSERT_EQ_INT(after, before);
+    PASS();
+out:
+    kelp_kernel_buf_unmap(buf);
+    kelp_kernel_buf_unmap(peer);
+    if (a >= 0)
+        close(a);
+    if (b >= 0)
+        close(b);
+}
+
+/* ======================================================================== */
+/* Main                                                                     */
+/* ======================================================================== */
+
+int main(void)
+{
+    printf("libkelp-kernel tests\n");
+    printf("====================\n");
+
+    printf("\n[Caller Buffers]\n");
+    test_recv_into();
+    test_chan_recv_short();
+
+    printf("\n[Batched Channel I/O]\n");
+    test_recv_batch();
+    test_recv_batch_max();
+    test_send_batch();
+    test_send_batch_invalid();
+    test_sendv();
+    test_pool_release();
+
+    printf("\n[Tensor Buffers]\n");
+    test_buf_invalid();
+    test_buf_shared();
+
+    printf("\n--------------------------------------------------\n");
+    printf("Results: %d/%d passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+/*
+ * kelp-linux :: libkelp-net
+ * gateway.h - Persistent, multiplexed JSON-RPC client for kelp-gateway
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_GATEWAY_H
+#define KELP_GATEWAY_H
+
+#include <cjson/cJSON.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest a call waits for the gateway to come back before failing. */
+#define KELP_GATEWAY_CONNECT_WAIT_MS  5000
+
+/** Reconnect backoff: first retry delay and the cap it doubles up to. */
+#define KELP_GATEWAY_BACKOFF_MIN_MS   100
+#define KELP_GATEWAY_BACKOFF_MAX_MS   5000
+
+/**
+ * Gateway client handle (opaque).
+ *
+ * Holds one connection to the gateway's Unix socket, shared by every
+ * thread of the process.  Requests are newline-delimited JSON-RPC; each
+ * gets a fresh id and any number of them may be outstanding at once.  A
+ * reader thread matches responses to callers by id, so a slow request
+ * does not hold up the ones behind it.
+ *
+ * The connection is opened on first use.  When it drops, the calls in
+ * flight fail (they are not resent: chat.send is not idempotent) and the
+ * next call reconnects, waiting out an exponential backoff between
+ * failed attempts.
+ */
+typedef struct kelp_gateway kelp_gateway_t;
+
+/**
+ * Partial-response callback.
+ *
+ * Called on the calling thread with text the gateway has produced so far
+ * for this request and not yet delivered; deltas that arrive while the
+ * callback runs are coalesced into the next call.  Return non-zero to
+ * stop receiving partials (the call itself still completes).
+ */
+typedef int (*kelp_gateway_partial_cb)(const char *text, void *userdata);
+
+/**
+ * Create a client for the gateway listening on `socket_path`.
+ * Does not connect yet.  Returns NULL on error.
+ */
+kelp_gateway_t *kelp_gateway_new(const char *socket_path);
+
+/**
+ * Close the connection and free the client.  No call may be in progress.
+ */
+void kelp_gateway_free(kelp_gateway_t *gw);
+
+/**
+ * Make a JSON-RPC call and wait for its response.
+ *
+ * If `on_partial` is set, "stream": true is added to `params` and
+ * "chat.delta" notifications for this call are passed to it.
+ *
+ * @param gw          Client handle.
+ * @param method      Method name, e.g. "chat.send".
+ * @param params      Parameters object, or NULL.  Not consumed.
+ * @param on_partial  Partial-response callback, or NULL.
+ * @param userdata    Passed through to `on_partial`.
+ * @param timeout_ms  Give up after this long (0 = wait for the response
+ *                    or a disconnect).
+ * @param result      Output: the response's "result" member (caller
+ *                    frees with cJSON_Delete), or its "error" member
+ *                    when the gateway returned one.
+ * @return 0 on success, -1 on error with errno set: EREMOTEIO for an
+ *         error response (see `*result`), ETIMEDOUT, ECONNRESET when the
+ *         connection dropped, or the reason the connect failed.
+ */
+int kelp_gateway_call(kelp_gateway_t *gw, const char *method,
+                      const cJSON *params,
+                      kelp_gateway_partial_cb on_partial, void *userdata,
+                      int timeout_ms, cJSON **result);
+
+/**
+ * Send a chat message and return the assistant's reply.
+ *
+ * @param channel_id  Conversation key (channel, chat or DM), or NULL.
+ * @param user_id     Sender, or NULL.
+ * @param on_partial  Optional partial-response callback (see above).
+ * @return A malloc'd string with the reply, or with the gateway's error
+ *         message if it returned one; NULL if the gateway could not be
+ *         reached.  The caller must free it.
+ */
+char *kelp_gateway_chat(kelp_gateway_t *gw, const char *message,
+                        const char *channel_id, const char *user_id,
+                        kelp_gateway_partial_cb on_partial, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KELP_GATEWAY_H */
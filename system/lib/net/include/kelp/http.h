@@ -45,6 +45,10 @@ typedef struct kelp_http_request {
     int                  timeout_ms;
     bool                 follow_redirects;
     const char          *ca_bundle;       /* optional custom CA bundle path */
+    bool                 ssrf_protect;    /* refuse private/blocked targets,
+                                             pin the checked address (see
+                                             kelp/ssrf.h); KELP_ERR_INVALID
+                                             if the URL is refused */
 } kelp_http_request_t;
 
 /* ---- Streaming callback ------------------------------------------------- */
@@ -111,6 +115,13 @@ int kelp_http_header_add(kelp_http_header_t **list,
 /** Free an entire header linked list. */
 void kelp_http_header_free(kelp_http_header_t *list);
 
+/**
+ * Find a header by name (case-insensitive).
+ * Returns its value, owned by the list, or NULL if absent.
+ */
+const char *kelp_http_header_get(const kelp_http_header_t *list,
+                                  const char *name);
+
 /**
  * URL-encode a string.
  * Returns a malloc'd NUL-terminated string.  The caller must free it.
@@ -0,0 +1,97 @@
+/*
+ * kelp-linux :: libkelp-net
+ * live_reply.h - Stream a reply into a chat message by editing it in place
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_LIVE_REPLY_H
+#define KELP_LIVE_REPLY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Attempts at each step of kelp_live_reply_finish() before giving up. */
+#define KELP_LIVE_REPLY_RETRIES  5
+
+/**
+ * Live reply handle (opaque).
+ *
+ * Turns a stream of partial text into chat messages: the first text is
+ * posted as soon as it arrives, and the message is then edited to show
+ * the text so far.  Edits go through an adaptive rate limiter: the gap
+ * between them starts at `min_interval_ms`, doubles (or jumps to the
+ * platform's retry-after) when an edit is refused, and shrinks back
+ * towards the minimum while edits succeed.  Text beyond `max_len` freezes
+ * the current message and continues in a new one.
+ *
+ * A handle is used by one thread at a time.
+ */
+typedef struct kelp_live_reply kelp_live_reply_t;
+
+/** Platform hooks and limits for a live reply. */
+typedef struct kelp_live_reply_opts {
+    /**
+     * Post `text` as a new message.  Returns a malloc'd id the platform
+     * can edit it by, or NULL on failure.
+     */
+    char *(*post)(void *userdata, const char *text);
+
+    /**
+     * Replace the text of message `id`.  Returns 0 on success, -1 on
+     * failure; when the platform rate-limited the call, also sets
+     * `*retry_after_ms` to how long it asked to wait.
+     */
+    int (*edit)(void *userdata, const char *id, const char *text,
+                int *retry_after_ms);
+
+    void   *userdata;
+    size_t  max_len;            /* bytes per message */
+    int     min_interval_ms;    /* shortest gap between edits */
+    int     max_interval_ms;    /* longest gap the limiter backs off to */
+} kelp_live_reply_opts_t;
+
+/**
+ * Create a live reply.  Nothing is posted until text arrives.
+ * Returns NULL on error (missing hooks or limits).
+ */
+kelp_live_reply_t *kelp_live_reply_new(const kelp_live_reply_opts_t *opts);
+
+/** Free the handle.  Messages already posted are left as they are. */
+void kelp_live_reply_free(kelp_live_reply_t *lr);
+
+/**
+ * Append streamed text and update the chat if the rate limiter allows.
+ * Never sleeps.  Has the kelp_gateway_partial_cb signature, so it can be
+ * passed straight to kelp_gateway_chat() with the handle as userdata.
+ *
+ * @return 0 to keep streaming, non-zero once the first post has failed
+ *         (the rest is then left to kelp_live_reply_finish()).
+ */
+int kelp_live_reply_feed(const char *text, void *lr);
+
+/**
+ * Deliver the complete reply.
+ *
+ * Edits the current message to its final text, waiting out the rate
+ * limiter and retrying refused edits, and posts whatever did not fit as
+ * further messages.  If `text` does not continue what was streamed (an
+ * error message, say), the open message is rewritten with it.  Falls back
+ * to posting the rest as new messages when an edit keeps failing.
+ *
+ * @return 0 if all of `text` is now visible, -1 otherwise.
+ */
+int kelp_live_reply_finish(kelp_live_reply_t *lr, const char *text);
+
+/** True once a message has been posted. */
+bool kelp_live_reply_started(const kelp_live_reply_t *lr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KELP_LIVE_REPLY_H */
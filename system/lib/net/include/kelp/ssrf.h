@@ -14,6 +14,11 @@
  *   fc00::/7          (IPv6 unique-local)
  *   fe80::/10         (IPv6 link-local)
  *
+ * Custom CIDR ranges can be allowed (overriding the built-in ranges) or
+ * blocked.  Hostnames are resolved through a small TTL cache; the checked
+ * address is returned by kelp_ssrf_resolve() so the caller can connect to
+ * exactly that address instead of resolving the name a second time.
+ *
  * SPDX-License-Identifier: MIT
  */
 
@@ -21,11 +26,33 @@
 #define KELP_SSRF_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct sockaddr;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** A URL that passed the SSRF check, with the address it was checked at. */
+typedef struct {
+    char host[256];       /* host from the URL (IPv6 brackets stripped)   */
+    int  port;            /* explicit or scheme default port, 0 = unknown */
+    char addr[46];        /* numeric address that was checked, "" if none */
+    int  family;          /* AF_INET or AF_INET6 (0 if addr is empty)     */
+    bool literal;         /* host was already a numeric address           */
+    bool allow_listed;    /* host is on the allow list                    */
+} kelp_ssrf_target_t;
+
+/** DNS cache counters. */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t negative_hits;   /* hits on a cached lookup failure */
+    size_t   entries;
+} kelp_ssrf_dns_stats_t;
+
 /**
  * Check whether a URL is safe to request.
  *
@@ -37,6 +64,27 @@ extern "C" {
  */
 int kelp_ssrf_check(const char *url);
 
+/**
+ * Like kelp_ssrf_check(), and report the address the host was checked at.
+ *
+ * All of a hostname's addresses must pass; `out->addr` is the first one.
+ * Pin the connection to it (e.g. CURLOPT_RESOLVE) so a DNS answer that
+ * changes between the check and the connect cannot redirect the request.
+ *
+ * @param url  The full URL to check.
+ * @param out  Receives the target (may be NULL).
+ * @return 0 if the URL is safe, -1 if the request should be blocked.
+ */
+int kelp_ssrf_resolve(const char *url, kelp_ssrf_target_t *out);
+
+/**
+ * Check a socket address about to be connected to against the block and
+ * allow CIDRs and the private ranges.  Host lists do not apply.
+ *
+ * @return 0 if the address may be used, -1 if not.
+ */
+int kelp_ssrf_check_addr(const struct sockaddr *sa);
+
 /**
  * Test whether a hostname or IP string resolves to a private address.
  */
@@ -56,10 +104,38 @@ void kelp_ssrf_allow_list_add(const char *host);
 void kelp_ssrf_block_list_add(const char *host);
 
 /**
- * Reset both the allow and block lists (useful for testing).
+ * Allow an address range ("10.1.0.0/16", "fd00:1::/32", or a single
+ * address), overriding the built-in private ranges.
+ *
+ * @return 0 on success, -1 if `cidr` cannot be parsed.
+ */
+int kelp_ssrf_allow_cidr_add(const char *cidr);
+
+/**
+ * Block an address range.  Blocked ranges win over allowed ranges and
+ * over allow-listed hosts.
+ *
+ * @return 0 on success, -1 if `cidr` cannot be parsed.
+ */
+int kelp_ssrf_block_cidr_add(const char *cidr);
+
+/**
+ * Reset the host lists and CIDR ranges (useful for testing).
  */
 void kelp_ssrf_lists_reset(void);
 
+/**
+ * Set how long resolved names (default 60 s) and failed lookups
+ * (default 5 s) are cached.  0 disables caching of that kind.
+ */
+void kelp_ssrf_dns_cache_set_ttl(unsigned ttl_sec, unsigned negative_ttl_sec);
+
+/** Drop every cached DNS answer. */
+void kelp_ssrf_dns_cache_clear(void);
+
+/** Read the DNS cache counters. */
+void kelp_ssrf_dns_cache_stats(kelp_ssrf_dns_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,503 @@
+/*
+ * kelp-linux :: libkelp-net
+ * gateway.c - Persistent, multiplexed JSON-RPC client for kelp-gateway
+ *
+ * One Unix socket connection carries every call the process makes.  A
+ * caller registers a pending call under a fresh id, writes its request
+ * and sleeps on its own condition variable; the reader thread parses each
+ * newline-delimited message and hands responses and "chat.delta"
+ * notifications to the call with the matching id.  Partial text is queued
+ * on the call and delivered on the caller's thread, so a slow callback
+ * never stalls the reader.
+ *
+ * Lock order: wlock, then lock.  The reader takes both to tear a
+ * connection down, so a writer holding wlock always has a live fd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/gateway.h>
+#include <kelp/json.h>
+#include <kelp/log.h>
+#include <kelp/str.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GW_READ_SIZE    65536
+#define GW_LINE_MAX     (16 * 1024 * 1024)  /* the gateway's request limit */
+
+typedef struct gw_call {
+    struct gw_call  *next;
+    int              id;
+    bool             done;
+    int              err;           /* errno when done without a response */
+    cJSON           *response;      /* whole response message */
+    bool             want_partial;
+    kelp_str_t       partial;       /* delta text not yet delivered */
+    pthread_cond_t   cond;
+} gw_call_t;
+
+struct kelp_gateway {
+    char            *path;
+    pthread_mutex_t  lock;          /* protects everything below */
+    pthread_cond_t   cond;          /* backoff waits */
+    pthread_mutex_t  wlock;         /* serialises writes to fd */
+    int              fd;            /* -1 while disconnected */
+    pthread_t        reader;
+    bool             reader_live;   /* started and not yet joined */
+    gw_call_t       *calls;         /* pending calls */
+    int              next_id;
+    int              backoff_ms;    /* 0 after a successful connect */
+    int              last_err;      /* errno of the last failed connect */
+    struct timespec  retry_at;      /* no connect attempt before this */
+};
+
+/* ---- Time helpers (CLOCK_MONOTONIC) ------------------------------------- */
+
+static struct timespec mono_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+static struct timespec ts_add_ms(struct timespec ts, int ms)
+{
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static bool ts_before(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec < b->tv_sec ||
+           (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void cond_init_mono(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* ---- Reader thread ------------------------------------------------------ */
+
+/* Caller holds gw->lock. */
+static gw_call_t *call_find(kelp_gateway_t *gw, int id)
+{
+    for (gw_call_t *c = gw->calls; c; c = c->next) {
+        if (c->id == id && !c->done)
+            return c;
+    }
+    return NULL;
+}
+
+static void handle_message(kelp_gateway_t *gw, const char *line)
+{
+    cJSON *msg = cJSON_Parse(line);
+    if (!msg)
+        return;
+
+    const char *method = kelp_json_get_string(msg, "method");
+    if (method) {
+        cJSON *params = kelp_json_get_object(msg, "params");
+        const char *text = kelp_json_get_string(params, "text");
+
+        if (strcmp(method, "chat.delta") == 0 && text) {
+            pthread_mutex_lock(&gw->lock);
+            gw_call_t *c = call_find(gw, kelp_json_get_int(params, "id", 0));
+            if (c && c->want_partial) {
+                kelp_str_append(&c->partial, text, strlen(text));
+                pthread_cond_signal(&c->cond);
+            }
+            pthread_mutex_unlock(&gw->lock);
+        }
+        cJSON_Delete(msg);
+        return;
+    }
+
+    const cJSON *id = cJSON_GetObjectItemCaseSensitive(msg, "id");
+    if (cJSON_IsNumber(id)) {
+        pthread_mutex_lock(&gw->lock);
+        gw_call_t *c = call_find(gw, id->valueint);
+        if (c) {
+            c->response = msg;
+            c->done = true;
+            msg = NULL;
+            pthread_cond_signal(&c->cond);
+        }
+        pthread_mutex_unlock(&gw->lock);
+    }
+    cJSON_Delete(msg);
+}
+
+static void *reader_thread(void *arg)
+{
+    kelp_gateway_t *gw = arg;
+    int fd = gw->fd;    /* set before this thread was created */
+    kelp_str_t in = kelp_str_new();
+    char *chunk = malloc(GW_READ_SIZE);
+
+    while (chunk) {
+        ssize_t n = read(fd, chunk, GW_READ_SIZE);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || kelp_str_append(&in, chunk, (size_t)n) != 0)
+            break;
+
+        size_t start = 0;
+        char *nl;
+        while ((nl = memchr(in.data + start, '\n', in.len - start))) {
+            *nl = '\0';
+            handle_message(gw, in.data + start);
+            start = (size_t)(nl - in.data) + 1;
+        }
+        if (start > 0) {
+            memmove(in.data, in.data + start, in.len - start + 1);
+            in.len -= start;
+        }
+        if (in.len > GW_LINE_MAX) {
+            KELP_WARN("gateway: oversized message from %s, dropping connection",
+                      gw->path);
+            break;
+        }
+    }
+    free(chunk);
+    kelp_str_free(&in);
+
+    /* Fail whatever is still waiting; the calls unlink themselves. */
+    pthread_mutex_lock(&gw->wlock);
+    pthread_mutex_lock(&gw->lock);
+    gw->fd = -1;
+    for (gw_call_t *c = gw->calls; c; c = c->next) {
+        if (!c->done) {
+            c->done = true;
+            c->err  = ECONNRESET;
+            pthread_cond_signal(&c->cond);
+        }
+    }
+    pthread_mutex_unlock(&gw->lock);
+    close(fd);
+    pthread_mutex_unlock(&gw->wlock);
+
+    KELP_DEBUG("gateway: disconnected from %s", gw->path);
+    return NULL;
+}
+
+/* ---- Connection management ---------------------------------------------- */
+
+static int dial(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Make sure there is a connection, dialling (and waiting out the backoff
+ * after failed attempts) until `limit`.  Caller holds gw->lock.
+ */
+static int ensure_connected(kelp_gateway_t *gw, const struct timespec *limit)
+{
+    while (gw->fd < 0) {
+        struct timespec now = mono_now();
+
+        if (ts_before(&now, &gw->retry_at)) {
+            if (ts_before(limit, &gw->retry_at)) {
+                errno = gw->last_err ? gw->last_err : ECONNREFUSED;
+                return -1;
+            }
+            pthread_cond_timedwait(&gw->cond, &gw->lock, &gw->retry_at);
+            continue;
+        }
+
+        /* The previous reader has finished with the lock once fd is -1. */
+        if (gw->reader_live) {
+            pthread_join(gw->reader, NULL);
+            gw->reader_live = false;
+        }
+
+        int fd = dial(gw->path);
+        if (fd < 0) {
+            gw->last_err   = errno;
+            gw->backoff_ms = gw->backoff_ms ? gw->backoff_ms * 2
+                                            : KELP_GATEWAY_BACKOFF_MIN_MS;
+            if (gw->backoff_ms > KELP_GATEWAY_BACKOFF_MAX_MS)
+                gw->backoff_ms = KELP_GATEWAY_BACKOFF_MAX_MS;
+            gw->retry_at = ts_add_ms(now, gw->backoff_ms);
+            KELP_WARN("gateway: connect(%s): %s (retry in %d ms)",
+                      gw->path, strerror(gw->last_err), gw->backoff_ms);
+            continue;
+        }
+
+        gw->fd = fd;
+        if (pthread_create(&gw->reader, NULL, reader_thread, gw) != 0) {
+            gw->fd = -1;
+            close(fd);
+            errno = EAGAIN;
+            return -1;
+        }
+        gw->reader_live = true;
+        gw->backoff_ms  = 0;
+        gw->last_err    = 0;
+        KELP_DEBUG("gateway: connected to %s", gw->path);
+    }
+    return 0;
+}
+
+/* Write one request line unless the connection it was made on is gone. */
+static void send_request(kelp_gateway_t *gw, gw_call_t *call,
+                         const char *data, size_t len)
+{
+    pthread_mutex_lock(&gw->wlock);
+    pthread_mutex_lock(&gw->lock);
+    int fd = call->done ? -1 : gw->fd;
+    pthread_mutex_unlock(&gw->lock);
+
+    while (fd >= 0 && len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            /* Let the reader tear the connection down and fail the calls. */
+            shutdown(fd, SHUT_RDWR);
+            break;
+        }
+        data += n;
+        len  -= (size_t)n;
+    }
+    pthread_mutex_unlock(&gw->wlock);
+}
+
+/* ---- Public API --------------------------------------------------------- */
+
+kelp_gateway_t *kelp_gateway_new(const char *socket_path)
+{
+    if (!socket_path) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    kelp_gateway_t *gw = calloc(1, sizeof(*gw));
+    if (!gw)
+        return NULL;
+    gw->path = strdup(socket_path);
+    if (!gw->path) {
+        free(gw);
+        return NULL;
+    }
+    gw->fd      = -1;
+    gw->next_id = 1;
+    pthread_mutex_init(&gw->lock, NULL);
+    pthread_mutex_init(&gw->wlock, NULL);
+    cond_init_mono(&gw->cond);
+    return gw;
+}
+
+void kelp_gateway_free(kelp_gateway_t *gw)
+{
+    if (!gw)
+        return;
+
+    pthread_mutex_lock(&gw->lock);
+    if (gw->fd >= 0)
+        shutdown(gw->fd, SHUT_RDWR);
+    bool live = gw->reader_live;
+    pthread_mutex_unlock(&gw->lock);
+    if (live)
+        pthread_join(gw->reader, NULL);
+
+    pthread_mutex_destroy(&gw->lock);
+    pthread_mutex_destroy(&gw->wlock);
+    pthread_cond_destroy(&gw->cond);
+    free(gw->path);
+    free(gw);
+}
+
+int kelp_gateway_call(kelp_gateway_t *gw, const char *method,
+                      const cJSON *params,
+                      kelp_gateway_partial_cb on_partial, void *userdata,
+                      int timeout_ms, cJSON **result)
+{
+    if (!gw || !method || !result) {
+        errno = EINVAL;
+        return -1;
+    }
+    *result = NULL;
+
+    struct timespec now = mono_now();
+    struct timespec deadline = ts_add_ms(now, timeout_ms);
+    struct timespec limit = ts_add_ms(now, KELP_GATEWAY_CONNECT_WAIT_MS);
+    if (timeout_ms > 0 && ts_before(&deadline, &limit))
+        limit = deadline;
+
+    gw_call_t call = { .want_partial = on_partial != NULL };
+    if (on_partial) {
+        call.partial = kelp_str_new();
+        if (!call.partial.data)
+            return -1;
+    }
+    cond_init_mono(&call.cond);
+
+    /* Register under a fresh id on a live connection. */
+    pthread_mutex_lock(&gw->lock);
+    if (ensure_connected(gw, &limit) != 0) {
+        int err = errno;
+        pthread_mutex_unlock(&gw->lock);
+        pthread_cond_destroy(&call.cond);
+        kelp_str_free(&call.partial);
+        errno = err;
+        return -1;
+    }
+    call.id = gw->next_id;
+    gw->next_id = gw->next_id == INT_MAX ? 1 : gw->next_id + 1;
+    call.next = gw->calls;
+    gw->calls = &call;
+    pthread_mutex_unlock(&gw->lock);
+
+    /* Build and send the request. */
+    cJSON *req = cJSON_CreateObject();
+    cJSON *p = params ? cJSON_Duplicate(params, true) : cJSON_CreateObject();
+    char *line = NULL;
+    if (req && p) {
+        if (on_partial)
+            cJSON_AddBoolToObject(p, "stream", true);
+        cJSON_AddStringToObject(req, "jsonrpc", "2.0");
+        cJSON_AddNumberToObject(req, "id", call.id);
+        cJSON_AddStringToObject(req, "method", method);
+        cJSON_AddItemToObject(req, "params", p);
+        p = NULL;
+        line = cJSON_PrintUnformatted(req);
+    }
+    cJSON_Delete(p);
+    cJSON_Delete(req);
+
+    kelp_str_t out = kelp_str_from(line);
+    free(line);
+    if (out.len > 0 && kelp_str_append(&out, "\n", 1) == 0) {
+        send_request(gw, &call, out.data, out.len);
+    } else {
+        pthread_mutex_lock(&gw->lock);
+        call.done = true;
+        call.err  = ENOMEM;
+        pthread_mutex_unlock(&gw->lock);
+    }
+    kelp_str_free(&out);
+
+    /* Wait, handing partial text to the callback as it arrives. */
+    pthread_mutex_lock(&gw->lock);
+    for (;;) {
+        if (call.want_partial && call.partial.len > 0) {
+            char *text = strdup(call.partial.data);
+            call.partial.len = 0;
+            call.partial.data[0] = '\0';
+            pthread_mutex_unlock(&gw->lock);
+            int stop = text ? on_partial(text, userdata) : 0;
+            free(text);
+            pthread_mutex_lock(&gw->lock);
+            if (stop)
+                call.want_partial = false;
+            continue;
+        }
+        if (call.done)
+            break;
+        if (timeout_ms <= 0) {
+            pthread_cond_wait(&call.cond, &gw->lock);
+        } else if (pthread_cond_timedwait(&call.cond, &gw->lock,
+                                          &deadline) == ETIMEDOUT &&
+                   !call.done) {
+            call.err = ETIMEDOUT;
+            break;
+        }
+    }
+    for (gw_call_t **pp = &gw->calls; *pp; pp = &(*pp)->next) {
+        if (*pp == &call) {
+            *pp = call.next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gw->lock);
+    pthread_cond_destroy(&call.cond);
+    kelp_str_free(&call.partial);
+
+    if (!call.response) {
+        errno = call.err;
+        return -1;
+    }
+
+    int rc = 0;
+    *result = cJSON_DetachItemFromObjectCaseSensitive(call.response, "result");
+    if (!*result) {
+        *result = cJSON_DetachItemFromObjectCaseSensitive(call.response,
+                                                          "error");
+        errno = *result ? EREMOTEIO : EPROTO;
+        rc = -1;
+    }
+    cJSON_Delete(call.response);
+    return rc;
+}
+
+char *kelp_gateway_chat(kelp_gateway_t *gw, const char *message,
+                        const char *channel_id, const char *user_id,
+                        kelp_gateway_partial_cb on_partial, void *userdata)
+{
+    if (!message) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cJSON *params = cJSON_CreateObject();
+    if (!params)
+        return NULL;
+    cJSON_AddStringToObject(params, "message", message);
+    if (channel_id)
+        cJSON_AddStringToObject(params, "channel_id", channel_id);
+    if (user_id)
+        cJSON_AddStringToObject(params, "user_id", user_id);
+
+    cJSON *result = NULL;
+    int rc = kelp_gateway_call(gw, "chat.send", params, on_partial, userdata,
+                               0, &result);
+    int err = errno;
+    cJSON_Delete(params);
+
+    const char *text = kelp_json_get_string(result,
+                                            rc == 0 ? "content" : "message");
+    char *out = text ? strdup(text) : NULL;
+    if (!result)
+        KELP_ERROR("gateway: chat.send failed: %s", strerror(err));
+    cJSON_Delete(result);
+    return out;
+}
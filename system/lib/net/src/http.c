@@ -8,13 +8,17 @@
 #include <kelp/http.h>
 #include <kelp/err.h>
 #include <kelp/log.h>
+#include <kelp/ssrf.h>
 
 #include <curl/curl.h>
+#include <arpa/inet.h>
 #include <ctype.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #define KELP_USER_AGENT "kelp-linux/0.1.0"
 
@@ -387,6 +391,90 @@ static size_t sse_write_cb(char *ptr, size_t size, size_t nmemb, void *ud)
     return bytes;
 }
 
+/* ---- SSRF protection ---------------------------------------------------- */
+
+/**
+ * Per-request SSRF state.  The URL is checked (through the resolver
+ * cache) before the transfer starts and its host is pinned to the checked
+ * address with CURLOPT_RESOLVE, so curl never resolves it again.  Every
+ * connection -- including redirects to other hosts -- also passes through
+ * an open-socket callback that refuses blocked addresses.
+ */
+typedef struct {
+    bool                active;
+    bool                refused;      /* a connection was vetoed */
+    kelp_ssrf_target_t  target;
+    struct curl_slist  *resolve;
+} ssrf_guard_t;
+
+static curl_socket_t ssrf_opensocket_cb(void *ud, curlsocktype purpose,
+                                        struct curl_sockaddr *addr)
+{
+    ssrf_guard_t *g = ud;
+
+    if (purpose == CURLSOCKTYPE_IPCXN &&
+        kelp_ssrf_check_addr(&addr->addr) != 0) {
+        /* An allow-listed host may use the private address it was
+         * checked (and pinned) at, but nothing else. */
+        bool pinned = false;
+        if (g->target.allow_listed && g->target.addr[0]) {
+            char ip[INET6_ADDRSTRLEN] = "";
+            const void *src = addr->family == AF_INET6
+                ? (const void *)&((struct sockaddr_in6 *)&addr->addr)->sin6_addr
+                : (const void *)&((struct sockaddr_in *)&addr->addr)->sin_addr;
+            inet_ntop(addr->family, src, ip, sizeof(ip));
+            pinned = strcmp(ip, g->target.addr) == 0;
+        }
+        if (!pinned) {
+            KELP_WARN("SSRF: refused connection for %s", g->target.host);
+            g->refused = true;
+            return CURL_SOCKET_BAD;
+        }
+    }
+    return socket(addr->family, addr->socktype, addr->protocol);
+}
+
+/**
+ * Check the URL and install the pinning/guard options.
+ * Returns KELP_OK, or KELP_ERR_INVALID if the URL is refused.
+ */
+static int ssrf_guard_apply(CURL *curl, const kelp_http_request_t *req,
+                            ssrf_guard_t *g)
+{
+    memset(g, 0, sizeof(*g));
+    if (!req->ssrf_protect)
+        return KELP_OK;
+
+    if (kelp_ssrf_resolve(req->url, &g->target) != 0)
+        return KELP_ERR_INVALID;
+    g->active = true;
+
+    if (!g->target.literal && g->target.addr[0] && g->target.port > 0) {
+        char entry[sizeof(g->target.host) + sizeof(g->target.addr) + 16];
+        snprintf(entry, sizeof(entry),
+                 g->target.family == AF_INET6 ? "%s:%d:[%s]" : "%s:%d:%s",
+                 g->target.host, g->target.port, g->target.addr);
+        g->resolve = curl_slist_append(NULL, entry);
+        if (g->resolve)
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, g->resolve);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_OPENSOCKETFUNCTION, ssrf_opensocket_cb);
+    curl_easy_setopt(curl, CURLOPT_OPENSOCKETDATA, g);
+
+    /* A proxy would make the checked address meaningless; go direct. */
+    curl_easy_setopt(curl, CURLOPT_PROXY, "");
+    curl_easy_setopt(curl, CURLOPT_PROTOCOLS_STR, "http,https");
+    curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+    return KELP_OK;
+}
+
+static void ssrf_guard_free(ssrf_guard_t *g)
+{
+    curl_slist_free_all(g->resolve);
+    g->resolve = NULL;
+}
+
 /* ---- Public API --------------------------------------------------------- */
 
 int kelp_http_init(void)
@@ -434,11 +522,20 @@ int kelp_http_request(const kelp_http_request_t *req,
 
     apply_common_opts(curl, req, slist);
 
+    ssrf_guard_t guard;
+    int result = ssrf_guard_apply(curl, req, &guard);
+    if (result != KELP_OK) {
+        curl_slist_free_all(slist);
+        curl_easy_cleanup(curl);
+        return result;
+    }
+
     CURLcode rc = curl_easy_perform(curl);
 
-    int result = KELP_OK;
     if (rc != CURLE_OK) {
-        if (rc == CURLE_OPERATION_TIMEDOUT) {
+        if (guard.refused) {
+            result = KELP_ERR_INVALID;
+        } else if (rc == CURLE_OPERATION_TIMEDOUT) {
             KELP_WARN("HTTP request timed out: %s", req->url);
             result = KELP_ERR_TIMEOUT;
         } else {
@@ -456,6 +553,7 @@ int kelp_http_request(const kelp_http_request_t *req,
         resp->content_type = hctx.content_type;
     }
 
+    ssrf_guard_free(&guard);
     curl_slist_free_all(slist);
     curl_easy_cleanup(curl);
     return result;
@@ -479,18 +577,28 @@ int kelp_http_stream(const kelp_http_request_t *req,
 
     apply_common_opts(curl, req, slist);
 
+    ssrf_guard_t guard;
+    int result = ssrf_guard_apply(curl, req, &guard);
+    if (result != KELP_OK) {
+        curl_slist_free_all(slist);
+        curl_easy_cleanup(curl);
+        return result;
+    }
+
     CURLcode rc = curl_easy_perform(curl);
 
-    int result = KELP_OK;
     if (sctx.aborted) {
         result = KELP_OK; /* user-initiated abort is not an error */
     } else if (rc != CURLE_OK) {
-        if (rc == CURLE_OPERATION_TIMEDOUT)
+        if (guard.refused)
+            result = KELP_ERR_INVALID;
+        else if (rc == CURLE_OPERATION_TIMEDOUT)
             result = KELP_ERR_TIMEOUT;
         else
             result = KELP_ERR_NET;
     }
 
+    ssrf_guard_free(&guard);
     curl_slist_free_all(slist);
     curl_easy_cleanup(curl);
     return result;
@@ -527,23 +635,34 @@ int kelp_http_sse(const kelp_http_request_t *req,
 
     apply_common_opts(curl, req, slist);
 
+    ssrf_guard_t guard;
+    int result = ssrf_guard_apply(curl, req, &guard);
+    if (result != KELP_OK) {
+        sse_ctx_free(&sctx);
+        curl_slist_free_all(slist);
+        curl_easy_cleanup(curl);
+        return result;
+    }
+
     CURLcode rc = curl_easy_perform(curl);
 
     /* Flush any pending event at end of stream */
     if (!sctx.aborted && sctx.data_buf && sctx.data_len > 0)
         sse_dispatch(&sctx);
 
-    int result = KELP_OK;
     if (sctx.aborted) {
         result = KELP_OK;
     } else if (rc != CURLE_OK && rc != CURLE_WRITE_ERROR) {
-        if (rc == CURLE_OPERATION_TIMEDOUT)
+        if (guard.refused)
+            result = KELP_ERR_INVALID;
+        else if (rc == CURLE_OPERATION_TIMEDOUT)
             result = KELP_ERR_TIMEOUT;
         else
             result = KELP_ERR_NET;
     }
 
     sse_ctx_free(&sctx);
+    ssrf_guard_free(&guard);
     curl_slist_free_all(slist);
     curl_easy_cleanup(curl);
     return result;
@@ -594,6 +713,18 @@ void kelp_http_header_free(kelp_http_header_t *list)
     }
 }
 
+const char *kelp_http_header_get(const kelp_http_header_t *list,
+                                  const char *name)
+{
+    if (!name)
+        return NULL;
+    for (; list; list = list->next) {
+        if (strcasecmp(list->name, name) == 0)
+            return list->value;
+    }
+    return NULL;
+}
+
 char *kelp_http_url_encode(const char *s)
 {
     if (!s)
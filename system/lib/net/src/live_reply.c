@@ -0,0 +1,322 @@
+/*
+ * kelp-linux :: libkelp-net
+ * live_reply.c - Stream a reply into a chat message by editing it in place
+ *
+ * The handle keeps the whole reply in one buffer.  `base` is where the
+ * open message starts and `shown` how many bytes of it the chat displays;
+ * everything before `base` sits in frozen messages.  Each step makes the
+ * chat one call closer to the buffer: post the open message, edit it, or
+ * freeze it once full so the next step posts a new one.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/live_reply.h>
+#include <kelp/log.h>
+#include <kelp/str.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SHOWN_STALE ((size_t)-1)    /* open message no longer matches */
+
+struct kelp_live_reply {
+    kelp_live_reply_opts_t opts;
+    kelp_str_t       text;          /* reply so far */
+    size_t           base;          /* start of the open message */
+    size_t           shown;         /* bytes the open message displays */
+    char            *id;            /* open message, NULL if none */
+    bool             called;        /* any platform call made */
+    bool             posted;        /* any message posted */
+    bool             failed;        /* first post failed */
+    int              interval_ms;   /* current gap between calls */
+    struct timespec  next_at;       /* no call before this */
+};
+
+/* ---- Time helpers (CLOCK_MONOTONIC) ------------------------------------- */
+
+static struct timespec mono_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+static struct timespec ts_add_ms(struct timespec ts, int ms)
+{
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/* Milliseconds until `t`, rounded up so a wait never ends early. */
+static long ms_until(const struct timespec *t)
+{
+    struct timespec now = mono_now();
+    long long ns = (long long)(t->tv_sec - now.tv_sec) * 1000000000LL +
+                   (t->tv_nsec - now.tv_nsec);
+    return ns > 0 ? (long)((ns + 999999) / 1000000) : 0;
+}
+
+/* ---- Text helpers ------------------------------------------------------- */
+
+/* Length of `s[0..len)` without a trailing, incomplete UTF-8 sequence. */
+static size_t utf8_complete(const char *s, size_t len)
+{
+    size_t i = len;
+    while (i > 0 && len - i < 3 && ((unsigned char)s[i - 1] & 0xC0) == 0x80)
+        i--;
+    if (i == 0)
+        return len;
+
+    unsigned char lead = (unsigned char)s[i - 1];
+    size_t need = lead < 0x80           ? 1
+                : (lead & 0xE0) == 0xC0 ? 2
+                : (lead & 0xF0) == 0xE0 ? 3
+                : (lead & 0xF8) == 0xF0 ? 4 : 1;
+    return len - (i - 1) < need ? i - 1 : len;
+}
+
+/* Bytes of `s[0..len)` that fit in one message, cut between characters. */
+static size_t chunk_len(const char *s, size_t len, size_t max)
+{
+    if (len <= max)
+        return utf8_complete(s, len);
+
+    size_t cut = max;
+    while (cut > 0 && ((unsigned char)s[cut] & 0xC0) == 0x80)
+        cut--;
+    return cut > 0 ? cut : max;
+}
+
+static bool is_blank(const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (!isspace((unsigned char)s[i]))
+            return false;
+    }
+    return true;
+}
+
+/* ---- Rate limiter ------------------------------------------------------- */
+
+/*
+ * May a platform call go out now?  The very first one always may; later
+ * ones wait for the limiter, sleeping if `block` is set.
+ */
+static bool call_turn(kelp_live_reply_t *lr, bool block)
+{
+    long wait = lr->called ? ms_until(&lr->next_at) : 0;
+    if (wait <= 0)
+        return true;
+    if (!block)
+        return false;
+
+    struct timespec ts = { wait / 1000, (wait % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+    return true;
+}
+
+static void call_succeeded(kelp_live_reply_t *lr)
+{
+    lr->called = true;
+    lr->interval_ms -= lr->interval_ms / 4;
+    if (lr->interval_ms < lr->opts.min_interval_ms)
+        lr->interval_ms = lr->opts.min_interval_ms;
+    lr->next_at = ts_add_ms(mono_now(), lr->interval_ms);
+}
+
+static void call_refused(kelp_live_reply_t *lr, int retry_after_ms)
+{
+    int wait;
+
+    lr->called = true;
+    lr->interval_ms *= 2;
+    if (lr->interval_ms < retry_after_ms)
+        lr->interval_ms = retry_after_ms;
+    if (lr->interval_ms > lr->opts.max_interval_ms)
+        lr->interval_ms = lr->opts.max_interval_ms;
+
+    /* The platform's retry-after is binding even above the cap. */
+    wait = lr->interval_ms > retry_after_ms ? lr->interval_ms : retry_after_ms;
+    lr->next_at = ts_add_ms(mono_now(), wait);
+}
+
+/* ---- Steps -------------------------------------------------------------- */
+
+/*
+ * Move the chat one call (or one freeze) closer to the buffer, waiting
+ * for the rate limiter if `block` is set.  Returns 1 if something
+ * changed, 0 if there is nothing to do (or it is not yet time), -1 if
+ * the platform call failed.
+ */
+static int step(kelp_live_reply_t *lr, bool block)
+{
+    char  *open    = lr->text.data + lr->base;
+    size_t pending = lr->text.len - lr->base;
+    size_t avail   = chunk_len(open, pending, lr->opts.max_len);
+    int    retry_after = 0;
+    int    rc;
+
+    if (!lr->id) {
+        if (avail == 0 || is_blank(open, avail) || !call_turn(lr, block))
+            return 0;
+
+        char saved = open[avail];
+        open[avail] = '\0';
+        lr->id = lr->opts.post(lr->opts.userdata, open);
+        open[avail] = saved;
+
+        if (!lr->id) {
+            call_refused(lr, 0);
+            return -1;
+        }
+        lr->posted = true;
+        lr->shown  = avail;
+        call_succeeded(lr);
+        return 1;
+    }
+
+    if (avail != lr->shown) {
+        if (avail == 0 || is_blank(open, avail) || !call_turn(lr, block))
+            return 0;
+
+        char saved = open[avail];
+        open[avail] = '\0';
+        rc = lr->opts.edit(lr->opts.userdata, lr->id, open, &retry_after);
+        open[avail] = saved;
+
+        if (rc != 0) {
+            call_refused(lr, retry_after);
+            return -1;
+        }
+        lr->shown = avail;
+        call_succeeded(lr);
+        return 1;
+    }
+
+    if (pending > lr->opts.max_len) {
+        lr->base += lr->shown;
+        lr->shown = 0;
+        free(lr->id);
+        lr->id = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Public API --------------------------------------------------------- */
+
+kelp_live_reply_t *kelp_live_reply_new(const kelp_live_reply_opts_t *opts)
+{
+    if (!opts || !opts->post || !opts->edit || opts->max_len < 4 ||
+        opts->min_interval_ms < 1 ||
+        opts->max_interval_ms < opts->min_interval_ms)
+        return NULL;
+
+    kelp_live_reply_t *lr = calloc(1, sizeof(*lr));
+    if (!lr)
+        return NULL;
+
+    lr->opts        = *opts;
+    lr->text        = kelp_str_new();
+    lr->interval_ms = opts->min_interval_ms;
+    return lr;
+}
+
+void kelp_live_reply_free(kelp_live_reply_t *lr)
+{
+    if (!lr)
+        return;
+    kelp_str_free(&lr->text);
+    free(lr->id);
+    free(lr);
+}
+
+int kelp_live_reply_feed(const char *text, void *userdata)
+{
+    kelp_live_reply_t *lr = userdata;
+
+    if (!lr || lr->failed)
+        return 1;
+    if (text && *text && kelp_str_append_cstr(&lr->text, text) != 0)
+        return 0;
+
+    for (;;) {
+        int rc = step(lr, false);
+        if (rc < 0 && !lr->posted) {
+            KELP_WARN("live reply: first post failed (%zu bytes), "
+                      "not streaming", lr->text.len);
+            lr->failed = true;
+            return 1;
+        }
+        if (rc <= 0)
+            break;
+    }
+    return 0;
+}
+
+int kelp_live_reply_finish(kelp_live_reply_t *lr, const char *text)
+{
+    if (!lr || !text)
+        return -1;
+
+    /*
+     * The final text usually extends what was streamed.  When it does not
+     * even keep the frozen messages, rewrite the open message from the
+     * start of the reply; when it only changes the open message, edit it.
+     */
+    size_t len = strlen(text);
+    size_t keep = lr->base + (lr->shown == SHOWN_STALE ? 0 : lr->shown);
+    if (len < lr->base || memcmp(text, lr->text.data, lr->base) != 0) {
+        lr->base  = 0;
+        lr->shown = SHOWN_STALE;
+    } else if (len < keep || memcmp(text, lr->text.data, keep) != 0) {
+        lr->shown = SHOWN_STALE;
+    }
+    if (!lr->id)
+        lr->shown = 0;
+
+    lr->text.len = 0;
+    if (kelp_str_append(&lr->text, text, len) != 0)
+        return -1;
+
+    int failures = 0;
+    for (;;) {
+        int rc = step(lr, true);
+        if (rc == 0)
+            return lr->posted ? 0 : -1;
+        if (rc > 0) {
+            failures = 0;
+            continue;
+        }
+        if (++failures < KELP_LIVE_REPLY_RETRIES)
+            continue;
+        if (!lr->id) {
+            KELP_ERROR("live reply: could not post (%zu of %zu bytes "
+                       "undelivered)", lr->text.len - lr->base, lr->text.len);
+            return -1;
+        }
+
+        /* The open message cannot be edited: post the rest after it. */
+        KELP_WARN("live reply: edits to %s keep failing, posting the rest",
+                  lr->id);
+        if (lr->shown != SHOWN_STALE)
+            lr->base += lr->shown;
+        lr->shown = 0;
+        free(lr->id);
+        lr->id = NULL;
+        failures = 0;
+    }
+}
+
+bool kelp_live_reply_started(const kelp_live_reply_t *lr)
+{
+    return lr && lr->posted;
+}
@@ -5,112 +5,228 @@
  * Resolves hostnames and checks whether the resulting IPs fall into
  * private/reserved ranges before allowing outbound requests.
  *
+ * Address ranges (the built-in private ranges plus any user allow/block
+ * CIDRs) live in one path-compressed binary trie over 128-bit keys; IPv4
+ * addresses are stored as IPv4-mapped IPv6 (::ffff:a.b.c.d), so a single
+ * lookup answers both families.  Exact host allow/block entries live in
+ * hash sets.  Name resolution goes through a small TTL cache so repeated
+ * checks of the same host cost a hash lookup instead of a DNS round trip,
+ * and the checked address is handed back so the HTTP client can pin it.
+ *
  * SPDX-License-Identifier: MIT
  */
 
 #include <kelp/ssrf.h>
 #include <kelp/err.h>
 #include <kelp/log.h>
+#include <kelp/map.h>
 
 #include <stdint.h>
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 
-/* ---- Allow/block lists -------------------------------------------------- */
+/* ---- Addresses ---------------------------------------------------------- */
 
-#define MAX_LIST_ENTRIES 256
+/** A 128-bit trie key: IPv6 as-is, IPv4 as ::ffff:a.b.c.d. */
+typedef struct {
+    uint8_t b[16];
+} ssrf_key_t;
 
-static struct {
-    pthread_mutex_t lock;
-    char           *allow[MAX_LIST_ENTRIES];
-    int             allow_count;
-    char           *block[MAX_LIST_ENTRIES];
-    int             block_count;
-} ssrf_lists = {
-    .lock        = PTHREAD_MUTEX_INITIALIZER,
-    .allow_count = 0,
-    .block_count = 0
-};
+#define V4_MAPPED_PREFIX 96
 
-void kelp_ssrf_allow_list_add(const char *host)
+static void key_from_v4(ssrf_key_t *k, const struct in_addr *a)
 {
-    if (!host)
-        return;
-    pthread_mutex_lock(&ssrf_lists.lock);
-    if (ssrf_lists.allow_count < MAX_LIST_ENTRIES) {
-        ssrf_lists.allow[ssrf_lists.allow_count++] = strdup(host);
-    }
-    pthread_mutex_unlock(&ssrf_lists.lock);
+    memset(k->b, 0, 10);
+    k->b[10] = 0xFF;
+    k->b[11] = 0xFF;
+    memcpy(&k->b[12], &a->s_addr, 4);
 }
 
-void kelp_ssrf_block_list_add(const char *host)
+static void key_from_v6(ssrf_key_t *k, const struct in6_addr *a)
 {
-    if (!host)
-        return;
-    pthread_mutex_lock(&ssrf_lists.lock);
-    if (ssrf_lists.block_count < MAX_LIST_ENTRIES) {
-        ssrf_lists.block[ssrf_lists.block_count++] = strdup(host);
+    memcpy(k->b, a->s6_addr, 16);
+}
+
+static bool key_is_v4(const ssrf_key_t *k)
+{
+    static const uint8_t mapped[12] = {
+        0,0,0,0, 0,0,0,0, 0,0,0xFF,0xFF
+    };
+    return memcmp(k->b, mapped, 12) == 0;
+}
+
+static int key_bit(const ssrf_key_t *k, unsigned i)
+{
+    return (k->b[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+/** Clear every bit past the first `plen`. */
+static void key_mask(ssrf_key_t *k, unsigned plen)
+{
+    for (unsigned i = plen; i < 128; i++)
+        k->b[i >> 3] &= (uint8_t)~(0x80u >> (i & 7));
+}
+
+/** Length of the common prefix of `a` and `b`, capped at `max`. */
+static unsigned key_common(const ssrf_key_t *a, const ssrf_key_t *b,
+                           unsigned max)
+{
+    unsigned n = 0;
+    for (unsigned i = 0; i < 16 && n < max; i++) {
+        uint8_t x = a->b[i] ^ b->b[i];
+        if (x) {
+            n += (unsigned)__builtin_clz((unsigned)x) - 24;
+            break;
+        }
+        n += 8;
     }
-    pthread_mutex_unlock(&ssrf_lists.lock);
+    return n < max ? n : max;
 }
 
-void kelp_ssrf_lists_reset(void)
+/** Parse a numeric IPv4/IPv6 address into a key. */
+static bool key_parse(const char *s, ssrf_key_t *k)
 {
-    pthread_mutex_lock(&ssrf_lists.lock);
-    for (int i = 0; i < ssrf_lists.allow_count; i++) {
-        free(ssrf_lists.allow[i]);
-        ssrf_lists.allow[i] = NULL;
+    struct in_addr  a4;
+    struct in6_addr a6;
+
+    if (inet_pton(AF_INET, s, &a4) == 1) {
+        key_from_v4(k, &a4);
+        return true;
     }
-    ssrf_lists.allow_count = 0;
-    for (int i = 0; i < ssrf_lists.block_count; i++) {
-        free(ssrf_lists.block[i]);
-        ssrf_lists.block[i] = NULL;
+    if (inet_pton(AF_INET6, s, &a6) == 1) {
+        key_from_v6(k, &a6);
+        return true;
     }
-    ssrf_lists.block_count = 0;
-    pthread_mutex_unlock(&ssrf_lists.lock);
+    return false;
 }
 
-static bool is_in_allow_list(const char *host)
+static void key_format(const ssrf_key_t *k, char *out, size_t len)
 {
-    bool found = false;
-    pthread_mutex_lock(&ssrf_lists.lock);
-    for (int i = 0; i < ssrf_lists.allow_count; i++) {
-        if (strcasecmp(ssrf_lists.allow[i], host) == 0) {
-            found = true;
-            break;
+    if (key_is_v4(k))
+        inet_ntop(AF_INET, &k->b[12], out, (socklen_t)len);
+    else
+        inet_ntop(AF_INET6, k->b, out, (socklen_t)len);
+}
+
+/* ---- CIDR trie ---------------------------------------------------------- */
+
+enum {
+    RANGE_PRIVATE = 1 << 0,     /* built-in private/reserved range     */
+    RANGE_ALLOW   = 1 << 1,     /* kelp_ssrf_allow_cidr_add()          */
+    RANGE_BLOCK   = 1 << 2      /* kelp_ssrf_block_cidr_add()          */
+};
+
+/**
+ * Path-compressed trie node.  `key` holds `plen` significant bits; a node
+ * with no flags only exists to branch.  Every node's children extend its
+ * prefix, so a lookup walks at most one node per distinct prefix length
+ * on the way down.
+ */
+typedef struct cidr_node {
+    ssrf_key_t        key;
+    uint8_t           plen;
+    uint8_t           flags;
+    struct cidr_node *child[2];
+} cidr_node_t;
+
+static cidr_node_t *cidr_node_new(const ssrf_key_t *key, unsigned plen,
+                                  uint8_t flags)
+{
+    cidr_node_t *n = calloc(1, sizeof(*n));
+    if (!n)
+        return NULL;
+    n->key = *key;
+    key_mask(&n->key, plen);
+    n->plen  = (uint8_t)plen;
+    n->flags = flags;
+    return n;
+}
+
+static void cidr_free(cidr_node_t *n)
+{
+    if (!n)
+        return;
+    cidr_free(n->child[0]);
+    cidr_free(n->child[1]);
+    free(n);
+}
+
+static int cidr_insert(cidr_node_t **root, const ssrf_key_t *key,
+                       unsigned plen, uint8_t flags)
+{
+    cidr_node_t **pp = root;
+
+    while (*pp) {
+        cidr_node_t *n = *pp;
+        unsigned common = key_common(key, &n->key,
+                                     plen < n->plen ? plen : n->plen);
+
+        if (common == n->plen) {
+            if (n->plen == plen) {
+                n->flags |= flags;
+                return 0;
+            }
+            pp = &n->child[key_bit(key, n->plen)];
+            continue;
         }
+
+        /* The new prefix diverges inside this node's prefix: split. */
+        cidr_node_t *leaf = cidr_node_new(key, plen, flags);
+        if (!leaf)
+            return -1;
+
+        if (common == plen) {
+            /* New prefix is an ancestor of n. */
+            leaf->child[key_bit(&n->key, plen)] = n;
+            *pp = leaf;
+            return 0;
+        }
+
+        cidr_node_t *fork = cidr_node_new(key, common, 0);
+        if (!fork) {
+            free(leaf);
+            return -1;
+        }
+        fork->child[key_bit(&n->key, common)] = n;
+        fork->child[key_bit(key, common)]     = leaf;
+        *pp = fork;
+        return 0;
     }
-    pthread_mutex_unlock(&ssrf_lists.lock);
-    return found;
+
+    *pp = cidr_node_new(key, plen, flags);
+    return *pp ? 0 : -1;
 }
 
-static bool is_in_block_list(const char *host)
+/** OR together the flags of every prefix that contains `key`. */
+static uint8_t cidr_lookup(const cidr_node_t *n, const ssrf_key_t *key)
 {
-    bool found = false;
-    pthread_mutex_lock(&ssrf_lists.lock);
-    for (int i = 0; i < ssrf_lists.block_count; i++) {
-        if (strcasecmp(ssrf_lists.block[i], host) == 0) {
-            found = true;
+    uint8_t flags = 0;
+
+    while (n) {
+        if (key_common(key, &n->key, n->plen) < n->plen)
             break;
-        }
+        flags |= n->flags;
+        if (n->plen >= 128)
+            break;
+        n = n->child[key_bit(key, n->plen)];
     }
-    pthread_mutex_unlock(&ssrf_lists.lock);
-    return found;
+    return flags;
 }
 
-/* ---- Private IP checks -------------------------------------------------- */
-
 /**
- * Check whether an IPv4 address (in network byte order) is in a private range.
+ * Built-in blocked ranges.
  *
- * Blocked ranges:
  *   127.0.0.0/8     - loopback
  *   10.0.0.0/8      - RFC 1918 class A
  *   172.16.0.0/12   - RFC 1918 class B
@@ -124,130 +240,471 @@ static bool is_in_block_list(const char *host)
  *   203.0.113.0/24  - TEST-NET-3
  *   224.0.0.0/4     - multicast
  *   240.0.0.0/4     - reserved
+ *   ::/128          - unspecified
+ *   ::1/128         - loopback
+ *   fc00::/7        - unique local addresses
+ *   fe80::/10       - link-local
+ *
+ * IPv4 ranges also cover their IPv4-mapped IPv6 form.
+ */
+static const char *const builtin_ranges[] = {
+    "127.0.0.0/8",
+    "10.0.0.0/8",
+    "172.16.0.0/12",
+    "192.168.0.0/16",
+    "169.254.0.0/16",
+    "0.0.0.0/8",
+    "100.64.0.0/10",
+    "192.0.0.0/24",
+    "192.0.2.0/24",
+    "198.51.100.0/24",
+    "203.0.113.0/24",
+    "224.0.0.0/4",
+    "240.0.0.0/4",
+    "::/128",
+    "::1/128",
+    "fc00::/7",
+    "fe80::/10",
+};
+
+/**
+ * Parse "addr/len" (or a bare address, meaning a single host) into a
+ * trie key and prefix length.  IPv4 lengths are rebased onto the mapped
+ * range.
  */
-static bool is_private_ipv4(const struct in_addr *addr)
+static int cidr_parse(const char *cidr, ssrf_key_t *key, unsigned *plen)
 {
-    uint32_t ip = ntohl(addr->s_addr);
+    char buf[64];
+    size_t len = strlen(cidr);
+    if (len == 0 || len >= sizeof(buf))
+        return -1;
+    memcpy(buf, cidr, len + 1);
+
+    long bits = -1;
+    char *slash = strchr(buf, '/');
+    if (slash) {
+        *slash = '\0';
+        char *end = NULL;
+        bits = strtol(slash + 1, &end, 10);
+        if (end == slash + 1 || *end != '\0' || bits < 0)
+            return -1;
+    }
 
-    /* 127.0.0.0/8 -- loopback */
-    if ((ip & 0xFF000000) == 0x7F000000)
-        return true;
+    struct in_addr  a4;
+    struct in6_addr a6;
+    if (inet_pton(AF_INET, buf, &a4) == 1) {
+        if (bits > 32)
+            return -1;
+        key_from_v4(key, &a4);
+        *plen = V4_MAPPED_PREFIX + (unsigned)(bits < 0 ? 32 : bits);
+    } else if (inet_pton(AF_INET6, buf, &a6) == 1) {
+        if (bits > 128)
+            return -1;
+        key_from_v6(key, &a6);
+        *plen = (unsigned)(bits < 0 ? 128 : bits);
+    } else {
+        return -1;
+    }
+    return 0;
+}
 
-    /* 10.0.0.0/8 */
-    if ((ip & 0xFF000000) == 0x0A000000)
-        return true;
+/* ---- Allow/block lists -------------------------------------------------- */
 
-    /* 172.16.0.0/12 */
-    if ((ip & 0xFFF00000) == 0xAC100000)
-        return true;
+static struct {
+    pthread_rwlock_t lock;
+    bool             ready;
+    cidr_node_t     *ranges;
+    kelp_map_t      *allow;      /* lower-cased host -> (void *)1 */
+    kelp_map_t      *block;
+} ssrf_lists = {
+    .lock = PTHREAD_RWLOCK_INITIALIZER
+};
 
-    /* 192.168.0.0/16 */
-    if ((ip & 0xFFFF0000) == 0xC0A80000)
-        return true;
+/** Build the trie with the built-in ranges.  Caller holds the write lock. */
+static void lists_build_locked(void)
+{
+    for (size_t i = 0; i < sizeof(builtin_ranges) / sizeof(builtin_ranges[0]); i++) {
+        ssrf_key_t key;
+        unsigned   plen;
+        if (cidr_parse(builtin_ranges[i], &key, &plen) != 0 ||
+            cidr_insert(&ssrf_lists.ranges, &key, plen, RANGE_PRIVATE) != 0)
+            KELP_ERROR("SSRF: failed to add built-in range %s",
+                       builtin_ranges[i]);
+    }
+    ssrf_lists.allow = kelp_map_new();
+    ssrf_lists.block = kelp_map_new();
+    ssrf_lists.ready = true;
+}
 
-    /* 169.254.0.0/16 -- link-local, metadata endpoint */
-    if ((ip & 0xFFFF0000) == 0xA9FE0000)
-        return true;
+/** Take the read lock, building the lists on first use. */
+static void lists_rdlock(void)
+{
+    pthread_rwlock_rdlock(&ssrf_lists.lock);
+    if (ssrf_lists.ready)
+        return;
 
-    /* 0.0.0.0/8 */
-    if ((ip & 0xFF000000) == 0x00000000)
-        return true;
+    pthread_rwlock_unlock(&ssrf_lists.lock);
+    pthread_rwlock_wrlock(&ssrf_lists.lock);
+    if (!ssrf_lists.ready)
+        lists_build_locked();
+    pthread_rwlock_unlock(&ssrf_lists.lock);
+    pthread_rwlock_rdlock(&ssrf_lists.lock);
+}
 
-    /* 100.64.0.0/10 -- CGNAT */
-    if ((ip & 0xFFC00000) == 0x64400000)
-        return true;
+static void lists_wrlock(void)
+{
+    pthread_rwlock_wrlock(&ssrf_lists.lock);
+    if (!ssrf_lists.ready)
+        lists_build_locked();
+}
 
-    /* 192.0.0.0/24 */
-    if ((ip & 0xFFFFFF00) == 0xC0000000)
-        return true;
+static void lists_unlock(void)
+{
+    pthread_rwlock_unlock(&ssrf_lists.lock);
+}
 
-    /* 192.0.2.0/24 -- TEST-NET-1 */
-    if ((ip & 0xFFFFFF00) == 0xC0000200)
-        return true;
+/** Lower-case `host` into `out`.  Returns false if it does not fit. */
+static bool host_fold(const char *host, char *out, size_t len)
+{
+    size_t i = 0;
+    for (; host[i]; i++) {
+        if (i + 1 >= len)
+            return false;
+        out[i] = (char)tolower((unsigned char)host[i]);
+    }
+    out[i] = '\0';
+    return true;
+}
 
-    /* 198.51.100.0/24 -- TEST-NET-2 */
-    if ((ip & 0xFFFFFF00) == 0xC6336400)
-        return true;
+static void host_set_add(kelp_map_t **set, const char *host)
+{
+    char folded[256];
+    if (!host_fold(host, folded, sizeof(folded))) {
+        KELP_WARN("SSRF: host too long for list: %.64s...", host);
+        return;
+    }
+    lists_wrlock();
+    if (!*set || kelp_map_set(*set, folded, (void *)1) != 0)
+        KELP_ERROR("SSRF: failed to add '%s' to list", folded);
+    lists_unlock();
+}
 
-    /* 203.0.113.0/24 -- TEST-NET-3 */
-    if ((ip & 0xFFFFFF00) == 0xCB007100)
-        return true;
+void kelp_ssrf_allow_list_add(const char *host)
+{
+    if (host)
+        host_set_add(&ssrf_lists.allow, host);
+}
 
-    /* 224.0.0.0/4 -- multicast */
-    if ((ip & 0xF0000000) == 0xE0000000)
-        return true;
+void kelp_ssrf_block_list_add(const char *host)
+{
+    if (host)
+        host_set_add(&ssrf_lists.block, host);
+}
 
-    /* 240.0.0.0/4 -- reserved */
-    if ((ip & 0xF0000000) == 0xF0000000)
+static int cidr_add(const char *cidr, uint8_t flag)
+{
+    ssrf_key_t key;
+    unsigned   plen;
+
+    if (!cidr || cidr_parse(cidr, &key, &plen) != 0) {
+        KELP_WARN("SSRF: invalid CIDR '%s'", cidr ? cidr : "(null)");
+        return -1;
+    }
+    lists_wrlock();
+    int rc = cidr_insert(&ssrf_lists.ranges, &key, plen, flag);
+    lists_unlock();
+    return rc;
+}
+
+int kelp_ssrf_allow_cidr_add(const char *cidr)
+{
+    return cidr_add(cidr, RANGE_ALLOW);
+}
+
+int kelp_ssrf_block_cidr_add(const char *cidr)
+{
+    return cidr_add(cidr, RANGE_BLOCK);
+}
+
+void kelp_ssrf_lists_reset(void)
+{
+    pthread_rwlock_wrlock(&ssrf_lists.lock);
+    cidr_free(ssrf_lists.ranges);
+    kelp_map_free(ssrf_lists.allow);
+    kelp_map_free(ssrf_lists.block);
+    ssrf_lists.ranges = NULL;
+    ssrf_lists.allow  = NULL;
+    ssrf_lists.block  = NULL;
+    lists_build_locked();
+    pthread_rwlock_unlock(&ssrf_lists.lock);
+}
+
+enum host_list { HOST_UNLISTED, HOST_ALLOWED, HOST_BLOCKED };
+
+/** Block list first: a host on both lists is blocked. */
+static enum host_list host_lookup(const char *host)
+{
+    char folded[256];
+    if (!host_fold(host, folded, sizeof(folded)))
+        return HOST_UNLISTED;
+
+    enum host_list r = HOST_UNLISTED;
+    lists_rdlock();
+    if (ssrf_lists.block && kelp_map_has(ssrf_lists.block, folded))
+        r = HOST_BLOCKED;
+    else if (ssrf_lists.allow && kelp_map_has(ssrf_lists.allow, folded))
+        r = HOST_ALLOWED;
+    lists_unlock();
+    return r;
+}
+
+static uint8_t range_flags(const ssrf_key_t *key)
+{
+    lists_rdlock();
+    uint8_t flags = cidr_lookup(ssrf_lists.ranges, key);
+    lists_unlock();
+    return flags;
+}
+
+/**
+ * Decide an address: a block CIDR always wins, an allow CIDR overrides
+ * the built-in private ranges, anything else outside them is allowed.
+ * `allow_private` (allow-listed host) skips the private-range check only.
+ */
+static bool addr_blocked(const ssrf_key_t *key, bool allow_private)
+{
+    uint8_t flags = range_flags(key);
+    if (flags & RANGE_BLOCK)
         return true;
+    if (flags & RANGE_ALLOW)
+        return false;
+    return (flags & RANGE_PRIVATE) && !allow_private;
+}
 
-    return false;
+/* ---- DNS cache ---------------------------------------------------------- */
+
+#define DNS_CACHE_MAX      1024
+#define DNS_MAX_ADDRS      8
+#define DNS_DEFAULT_TTL    60
+#define DNS_DEFAULT_NEGTTL 5
+
+typedef struct {
+    uint64_t   expires;              /* monotonic seconds */
+    int        naddr;                /* 0 = negative entry (lookup failed) */
+    ssrf_key_t addr[DNS_MAX_ADDRS];
+} dns_entry_t;
+
+static struct {
+    pthread_mutex_t lock;
+    kelp_map_t     *map;             /* lower-cased host -> dns_entry_t* */
+    unsigned        ttl;
+    unsigned        neg_ttl;
+    uint64_t        hits;
+    uint64_t        misses;
+    uint64_t        negative_hits;
+} dns_cache = {
+    .lock    = PTHREAD_MUTEX_INITIALIZER,
+    .ttl     = DNS_DEFAULT_TTL,
+    .neg_ttl = DNS_DEFAULT_NEGTTL
+};
+
+static uint64_t mono_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+/** Drop every entry, or only expired ones.  Caller holds the lock. */
+static void dns_cache_prune_locked(bool all, uint64_t now)
+{
+    if (!dns_cache.map)
+        return;
+
+    size_t n = kelp_map_size(dns_cache.map);
+    char **dead = calloc(n ? n : 1, sizeof(*dead));
+    size_t ndead = 0;
+    kelp_map_iter_t it = {0};
+
+    while (kelp_map_iter(dns_cache.map, &it)) {
+        dns_entry_t *e = it.value;
+        if (all || e->expires <= now) {
+            free(e);
+            if (dead)
+                dead[ndead++] = strdup(it.key);
+        }
+    }
+
+    if (!dead) {
+        /* Out of memory: values are already freed, so drop the map. */
+        kelp_map_free(dns_cache.map);
+        dns_cache.map = NULL;
+        return;
+    }
+    for (size_t i = 0; i < ndead; i++) {
+        if (dead[i])
+            kelp_map_del(dns_cache.map, dead[i]);
+        free(dead[i]);
+    }
+    free(dead);
+}
+
+/** Copy a live cache entry for `host` into `out`. */
+static bool dns_cache_get(const char *host, dns_entry_t *out)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&dns_cache.lock);
+    dns_entry_t *e = dns_cache.map ? kelp_map_get(dns_cache.map, host) : NULL;
+    if (e && e->expires > mono_sec()) {
+        *out = *e;
+        found = true;
+        dns_cache.hits++;
+        if (e->naddr == 0)
+            dns_cache.negative_hits++;
+    } else {
+        dns_cache.misses++;
+    }
+    pthread_mutex_unlock(&dns_cache.lock);
+    return found;
+}
+
+static void dns_cache_put(const char *host, const dns_entry_t *in)
+{
+    pthread_mutex_lock(&dns_cache.lock);
+
+    unsigned ttl = in->naddr ? dns_cache.ttl : dns_cache.neg_ttl;
+    if (ttl == 0)
+        goto out;
+
+    uint64_t now = mono_sec();
+    if (!dns_cache.map && !(dns_cache.map = kelp_map_new()))
+        goto out;
+
+    if (kelp_map_size(dns_cache.map) >= DNS_CACHE_MAX) {
+        dns_cache_prune_locked(false, now);
+        if (dns_cache.map && kelp_map_size(dns_cache.map) >= DNS_CACHE_MAX)
+            dns_cache_prune_locked(true, now);
+        if (!dns_cache.map && !(dns_cache.map = kelp_map_new()))
+            goto out;
+    }
+
+    dns_entry_t *e = kelp_map_get(dns_cache.map, host);
+    if (!e) {
+        e = malloc(sizeof(*e));
+        if (!e)
+            goto out;
+        if (kelp_map_set(dns_cache.map, host, e) != 0) {
+            free(e);
+            goto out;
+        }
+    }
+    *e = *in;
+    e->expires = now + ttl;
+
+out:
+    pthread_mutex_unlock(&dns_cache.lock);
 }
 
 /**
- * Check whether an IPv6 address is in a private/reserved range.
- *
- * Blocked:
- *   ::1/128   - loopback
- *   fc00::/7  - unique local addresses
- *   fe80::/10 - link-local
- *   ::ffff:0:0/96 - IPv4-mapped (checked via mapped IPv4)
- *   ::/128    - unspecified
- *   ::ffff:0:0:0/96 - IPv4-translated
+ * Resolve a hostname through the cache.  `host` must already be
+ * lower-cased.  Returns false if it does not resolve.
  */
-static bool is_private_ipv6(const struct in6_addr *addr)
+static bool dns_resolve(const char *host, dns_entry_t *out)
 {
-    const uint8_t *b = addr->s6_addr;
+    if (dns_cache_get(host, out))
+        return out->naddr > 0;
 
-    /* ::1 -- loopback */
-    static const uint8_t loopback[16] = {
-        0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,1
+    struct addrinfo hints = {
+        .ai_family   = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM
     };
-    if (memcmp(b, loopback, 16) == 0)
-        return true;
+    struct addrinfo *res = NULL;
 
-    /* :: -- unspecified */
-    static const uint8_t unspec[16] = {0};
-    if (memcmp(b, unspec, 16) == 0)
-        return true;
+    memset(out, 0, sizeof(*out));
+    int rc = getaddrinfo(host, NULL, &hints, &res);
+    if (rc != 0) {
+        KELP_WARN("SSRF: getaddrinfo(%s) failed: %s",
+                   host, gai_strerror(rc));
+    } else {
+        for (struct addrinfo *ai = res; ai && out->naddr < DNS_MAX_ADDRS;
+             ai = ai->ai_next) {
+            ssrf_key_t k;
+            if (ai->ai_family == AF_INET)
+                key_from_v4(&k, &((struct sockaddr_in *)ai->ai_addr)->sin_addr);
+            else if (ai->ai_family == AF_INET6)
+                key_from_v6(&k, &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr);
+            else
+                continue;
+
+            bool dup = false;
+            for (int i = 0; i < out->naddr; i++)
+                dup = dup || memcmp(&out->addr[i], &k, sizeof(k)) == 0;
+            if (!dup)
+                out->addr[out->naddr++] = k;
+        }
+        freeaddrinfo(res);
+    }
 
-    /* fc00::/7 -- unique local */
-    if ((b[0] & 0xFE) == 0xFC)
-        return true;
+    dns_cache_put(host, out);
+    return out->naddr > 0;
+}
 
-    /* fe80::/10 -- link-local */
-    if (b[0] == 0xFE && (b[1] & 0xC0) == 0x80)
-        return true;
+void kelp_ssrf_dns_cache_set_ttl(unsigned ttl_sec, unsigned negative_ttl_sec)
+{
+    pthread_mutex_lock(&dns_cache.lock);
+    dns_cache.ttl     = ttl_sec;
+    dns_cache.neg_ttl = negative_ttl_sec;
+    pthread_mutex_unlock(&dns_cache.lock);
+}
 
-    /* ::ffff:x.x.x.x -- IPv4-mapped, check the embedded IPv4 */
-    if (b[0] == 0 && b[1] == 0 && b[2] == 0 && b[3] == 0 &&
-        b[4] == 0 && b[5] == 0 && b[6] == 0 && b[7] == 0 &&
-        b[8] == 0 && b[9] == 0 && b[10] == 0xFF && b[11] == 0xFF) {
-        struct in_addr v4;
-        memcpy(&v4.s_addr, &b[12], 4);
-        return is_private_ipv4(&v4);
-    }
+void kelp_ssrf_dns_cache_clear(void)
+{
+    pthread_mutex_lock(&dns_cache.lock);
+    dns_cache_prune_locked(true, 0);
+    pthread_mutex_unlock(&dns_cache.lock);
+}
 
-    return false;
+void kelp_ssrf_dns_cache_stats(kelp_ssrf_dns_stats_t *out)
+{
+    if (!out)
+        return;
+    pthread_mutex_lock(&dns_cache.lock);
+    out->hits          = dns_cache.hits;
+    out->misses        = dns_cache.misses;
+    out->negative_hits = dns_cache.negative_hits;
+    out->entries       = dns_cache.map ? kelp_map_size(dns_cache.map) : 0;
+    pthread_mutex_unlock(&dns_cache.lock);
 }
 
 /* ---- URL parsing -------------------------------------------------------- */
 
 /**
- * Extract the hostname from a URL.
- * Returns a malloc'd string (caller frees), or NULL on failure.
+ * Split a URL into its host and port.  The port is the explicit one, or
+ * the scheme default for http/https/ws/wss, or 0 if unknown.
  *
  * Handles: http://host:port/path, https://host/path, http://[ipv6]:port/path
  */
-static char *extract_host(const char *url)
+static bool parse_url(const char *url, char *host, size_t host_len, int *port)
 {
     if (!url)
-        return NULL;
+        return false;
 
     /* Skip scheme */
     const char *p = strstr(url, "://");
     if (!p)
-        return NULL;
+        return false;
+
+    size_t scheme_len = (size_t)(p - url);
+    *port = 0;
+    if (scheme_len == 4 && strncasecmp(url, "http", 4) == 0)
+        *port = 80;
+    else if (scheme_len == 5 && strncasecmp(url, "https", 5) == 0)
+        *port = 443;
+    else if (scheme_len == 2 && strncasecmp(url, "ws", 2) == 0)
+        *port = 80;
+    else if (scheme_len == 3 && strncasecmp(url, "wss", 3) == 0)
+        *port = 443;
     p += 3;
 
     /* Skip userinfo@ if present */
@@ -256,35 +713,36 @@ static char *extract_host(const char *url)
     if (at && (!slash || at < slash))
         p = at + 1;
 
+    const char *start = p, *end;
+
     /* Handle IPv6 literal [::1] */
     if (*p == '[') {
-        const char *end = strchr(p, ']');
+        start = p + 1;
+        end = strchr(start, ']');
         if (!end)
-            return NULL;
-        size_t len = (size_t)(end - p - 1);
-        char *host = malloc(len + 1);
-        if (!host)
-            return NULL;
-        memcpy(host, p + 1, len);
-        host[len] = '\0';
-        return host;
+            return false;
+        p = end + 1;
+    } else {
+        /* Find end of host (port or path) */
+        end = p;
+        while (*end && *end != ':' && *end != '/' && *end != '?' && *end != '#')
+            end++;
+        p = end;
     }
 
-    /* Find end of host (port or path) */
-    const char *end = p;
-    while (*end && *end != ':' && *end != '/' && *end != '?' && *end != '#')
-        end++;
-
-    size_t len = (size_t)(end - p);
-    if (len == 0)
-        return NULL;
-
-    char *host = malloc(len + 1);
-    if (!host)
-        return NULL;
-    memcpy(host, p, len);
+    size_t len = (size_t)(end - start);
+    if (len == 0 || len >= host_len)
+        return false;
+    memcpy(host, start, len);
     host[len] = '\0';
-    return host;
+
+    if (*p == ':' && isdigit((unsigned char)p[1])) {
+        long v = strtol(p + 1, NULL, 10);
+        if (v <= 0 || v > 65535)
+            return false;
+        *port = (int)v;
+    }
+    return true;
 }
 
 /* ---- Public API --------------------------------------------------------- */
@@ -294,86 +752,106 @@ bool kelp_ssrf_is_private_ip(const char *host)
     if (!host)
         return true; /* null host is treated as private for safety */
 
-    /* Try direct parse as IPv4 */
-    struct in_addr addr4;
-    if (inet_pton(AF_INET, host, &addr4) == 1)
-        return is_private_ipv4(&addr4);
-
-    /* Try direct parse as IPv6 */
-    struct in6_addr addr6;
-    if (inet_pton(AF_INET6, host, &addr6) == 1)
-        return is_private_ipv6(&addr6);
+    ssrf_key_t key;
+    if (key_parse(host, &key))
+        return (range_flags(&key) & RANGE_PRIVATE) != 0;
 
     /* It is a hostname -- resolve it and check all resulting addresses */
-    struct addrinfo hints = {
-        .ai_family   = AF_UNSPEC,
-        .ai_socktype = SOCK_STREAM
-    };
-    struct addrinfo *res = NULL;
-
-    int rc = getaddrinfo(host, NULL, &hints, &res);
-    if (rc != 0) {
-        KELP_WARN("SSRF: getaddrinfo(%s) failed: %s",
-                   host, gai_strerror(rc));
+    char folded[256];
+    dns_entry_t e;
+    if (!host_fold(host, folded, sizeof(folded)) || !dns_resolve(folded, &e))
         return true; /* unresolvable hosts are treated as blocked */
-    }
 
-    bool is_private = false;
-    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
-        if (ai->ai_family == AF_INET) {
-            struct sockaddr_in *sa = (struct sockaddr_in *)ai->ai_addr;
-            if (is_private_ipv4(&sa->sin_addr)) {
-                is_private = true;
-                break;
-            }
-        } else if (ai->ai_family == AF_INET6) {
-            struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *)ai->ai_addr;
-            if (is_private_ipv6(&sa6->sin6_addr)) {
-                is_private = true;
-                break;
-            }
-        }
+    for (int i = 0; i < e.naddr; i++) {
+        if (range_flags(&e.addr[i]) & RANGE_PRIVATE)
+            return true;
     }
+    return false;
+}
+
+int kelp_ssrf_check_addr(const struct sockaddr *sa)
+{
+    ssrf_key_t key;
+
+    if (!sa)
+        return -1;
+    if (sa->sa_family == AF_INET)
+        key_from_v4(&key, &((const struct sockaddr_in *)sa)->sin_addr);
+    else if (sa->sa_family == AF_INET6)
+        key_from_v6(&key, &((const struct sockaddr_in6 *)sa)->sin6_addr);
+    else
+        return -1;
 
-    freeaddrinfo(res);
-    return is_private;
+    return addr_blocked(&key, false) ? -1 : 0;
 }
 
-int kelp_ssrf_check(const char *url)
+int kelp_ssrf_resolve(const char *url, kelp_ssrf_target_t *out)
 {
+    kelp_ssrf_target_t t;
+    memset(&t, 0, sizeof(t));
+
     if (!url) {
         KELP_WARN("SSRF: NULL URL blocked");
         return -1;
     }
 
-    char *host = extract_host(url);
-    if (!host) {
+    if (!parse_url(url, t.host, sizeof(t.host), &t.port)) {
         KELP_WARN("SSRF: failed to extract host from URL: %s", url);
         return -1;
     }
 
     /* Check explicit block list first (always wins) */
-    if (is_in_block_list(host)) {
-        KELP_WARN("SSRF: host '%s' is in block list", host);
-        free(host);
+    enum host_list listed = host_lookup(t.host);
+    if (listed == HOST_BLOCKED) {
+        KELP_WARN("SSRF: host '%s' is in block list", t.host);
         return -1;
     }
 
-    /* Check explicit allow list (bypasses private IP check) */
-    if (is_in_allow_list(host)) {
-        KELP_DEBUG("SSRF: host '%s' is in allow list", host);
-        free(host);
-        return 0;
-    }
+    /* Allow-listed hosts bypass the private-range check (not block CIDRs) */
+    t.allow_listed = (listed == HOST_ALLOWED);
 
-    /* Resolve and check all addresses against private ranges */
-    if (kelp_ssrf_is_private_ip(host)) {
-        KELP_WARN("SSRF: blocked request to private host '%s'", host);
-        free(host);
-        return -1;
+    ssrf_key_t key;
+    if (key_parse(t.host, &key)) {
+        t.literal = true;
+        if (addr_blocked(&key, t.allow_listed)) {
+            KELP_WARN("SSRF: blocked request to private host '%s'", t.host);
+            return -1;
+        }
+    } else {
+        char folded[256];
+        dns_entry_t e;
+        if (!host_fold(t.host, folded, sizeof(folded)) ||
+            !dns_resolve(folded, &e)) {
+            if (t.allow_listed) {
+                /* Nothing to pin; curl resolves (and fails) on its own. */
+                if (out)
+                    *out = t;
+                return 0;
+            }
+            KELP_WARN("SSRF: blocked request to unresolvable host '%s'",
+                      t.host);
+            return -1;
+        }
+        for (int i = 0; i < e.naddr; i++) {
+            if (addr_blocked(&e.addr[i], t.allow_listed)) {
+                KELP_WARN("SSRF: blocked request to private host '%s'",
+                          t.host);
+                return -1;
+            }
+        }
+        key = e.addr[0];
     }
 
-    KELP_DEBUG("SSRF: host '%s' passed validation", host);
-    free(host);
+    t.family = key_is_v4(&key) ? AF_INET : AF_INET6;
+    key_format(&key, t.addr, sizeof(t.addr));
+
+    KELP_DEBUG("SSRF: host '%s' passed validation (%s)", t.host, t.addr);
+    if (out)
+        *out = t;
     return 0;
 }
+
+int kelp_ssrf_check(const char *url)
+{
+    return kelp_ssrf_resolve(url, NULL);
+}
@@ -2,7 +2,9 @@
  * kelp-linux :: libkelp-net
  * test_net.c - Unit tests for the networking library
  *
- * Tests SSRF prevention, URL encoding, header management, and SSE parsing.
+ * Tests SSRF prevention, URL encoding, header management, SSE parsing and
+ * the gateway client (against a mock gateway on a Unix socket) and live
+ * replies (against a fake chat platform).
  * All tests run offline -- no network access required.
  *
  * SPDX-License-Identifier: MIT
@@ -13,12 +15,26 @@
 #include <kelp/heartbeat.h>
 #include <kelp/tls.h>
 #include <kelp/mdns.h>
+#include <kelp/gateway.h>
+#include <kelp/live_reply.h>
+#include <kelp/json.h>
+#include <kelp/str.h>
+#include <kelp/err.h>
 
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 static int tests_run    = 0;
 static int tests_passed = 0;
@@ -63,8 +79,9 @@ static int tests_passed = 0;
 #define ASSERT_EQ_STR(a, b) \
     do { \
         if (strcmp((a), (b)) != 0) { \
-            char _buf[256]; \
-            snprintf(_buf, sizeof(_buf), "%s == \"%s\", expected \"%s\"", \
+            char _buf[512]; \
+            snprintf(_buf, sizeof(_buf), \
+                     "%s == \"%.200s\", expected \"%.200s\"", \
                      #a, (a), (b)); \
             FAIL(_buf); return; \
         } \
@@ -274,6 +291,169 @@ static void test_ssrf_cgnat(void)
     PASS();
 }
 
+static void test_ssrf_ipv4_mapped(void)
+{
+    TEST(ssrf_ipv4_mapped);
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("::ffff:127.0.0.1"));
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("::ffff:169.254.169.254"));
+    ASSERT_FALSE(kelp_ssrf_is_private_ip("::ffff:8.8.8.8"));
+    ASSERT_EQ_INT(kelp_ssrf_check("http://[::ffff:10.0.0.1]/"), -1);
+    PASS();
+}
+
+static void test_ssrf_cidr_lists(void)
+{
+    TEST(ssrf_cidr_lists);
+    kelp_ssrf_lists_reset();
+
+    ASSERT_EQ_INT(kelp_ssrf_allow_cidr_add("10.1.0.0/16"), 0);
+    ASSERT_EQ_INT(kelp_ssrf_block_cidr_add("10.1.2.0/24"), 0);
+    ASSERT_EQ_INT(kelp_ssrf_block_cidr_add("2001:db8::/32"), 0);
+    ASSERT_EQ_INT(kelp_ssrf_block_cidr_add("93.184.216.34"), 0);
+
+    /* Allowed range overrides the built-in private range... */
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.1.9.9/"), 0);
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.2.0.1/"), -1);
+    /* ...but a more specific block inside it still wins */
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.1.2.3/"), -1);
+    /* Blocked public ranges and single addresses */
+    ASSERT_EQ_INT(kelp_ssrf_check("http://[2001:db8::1]/"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_check("http://93.184.216.34/"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_check("http://93.184.216.35/"), 0);
+    /* Block CIDRs win over allow-listed hosts */
+    kelp_ssrf_allow_list_add("10.1.2.3");
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.1.2.3/"), -1);
+
+    struct sockaddr_in sin = { .sin_family = AF_INET };
+    inet_pton(AF_INET, "10.1.9.9", &sin.sin_addr);
+    ASSERT_EQ_INT(kelp_ssrf_check_addr((struct sockaddr *)&sin), 0);
+    inet_pton(AF_INET, "127.0.0.1", &sin.sin_addr);
+    ASSERT_EQ_INT(kelp_ssrf_check_addr((struct sockaddr *)&sin), -1);
+
+    ASSERT_EQ_INT(kelp_ssrf_allow_cidr_add("10.0.0.0/33"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_allow_cidr_add("not-an-ip/8"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_block_cidr_add("fe80::/129"), -1);
+
+    /* Reset drops user ranges but keeps the built-in ones */
+    kelp_ssrf_lists_reset();
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.1.9.9/"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_check("http://93.184.216.34/"), 0);
+    PASS();
+}
+
+static void test_ssrf_host_lists_case(void)
+{
+    TEST(ssrf_host_lists_case);
+    kelp_ssrf_lists_reset();
+    kelp_ssrf_block_list_add("Evil.Example.COM");
+    ASSERT_EQ_INT(kelp_ssrf_check("https://evil.example.com/x"), -1);
+    ASSERT_EQ_INT(kelp_ssrf_check("https://EVIL.example.com:8443/"), -1);
+
+    /* No fixed capacity */
+    char host[64];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(host, sizeof(host), "10.9.%d.%d", i / 256, i % 256);
+        kelp_ssrf_allow_list_add(host);
+    }
+    ASSERT_EQ_INT(kelp_ssrf_check("http://10.9.3.231/"), 0);
+    kelp_ssrf_lists_reset();
+    PASS();
+}
+
+static void test_ssrf_resolve_target(void)
+{
+    TEST(ssrf_resolve_target);
+    kelp_ssrf_lists_reset();
+
+    kelp_ssrf_target_t t;
+    ASSERT_EQ_INT(kelp_ssrf_resolve("https://8.8.8.8/dns", &t), 0);
+    ASSERT_EQ_STR(t.host, "8.8.8.8");
+    ASSERT_EQ_STR(t.addr, "8.8.8.8");
+    ASSERT_EQ_INT(t.port, 443);
+    ASSERT_TRUE(t.literal);
+
+    ASSERT_EQ_INT(kelp_ssrf_resolve("http://[2606:4700:4700::1111]:8080/", &t), 0);
+    ASSERT_EQ_STR(t.addr, "2606:4700:4700::1111");
+    ASSERT_EQ_INT(t.port, 8080);
+    ASSERT_EQ_INT(t.family, AF_INET6);
+
+    /* localhost resolves to loopback: blocked unless allow-listed, and
+     * then pinned to the loopback address it was checked at */
+    ASSERT_EQ_INT(kelp_ssrf_resolve("http://localhost/", &t), -1);
+    kelp_ssrf_allow_list_add("localhost");
+    ASSERT_EQ_INT(kelp_ssrf_resolve("http://localhost:9/", &t), 0);
+    ASSERT_TRUE(t.allow_listed);
+    ASSERT_FALSE(t.literal);
+    ASSERT_EQ_INT(t.port, 9);
+    ASSERT_TRUE(strcmp(t.addr, "127.0.0.1") == 0 || strcmp(t.addr, "::1") == 0);
+
+    kelp_ssrf_lists_reset();
+    PASS();
+}
+
+static void test_ssrf_dns_cache(void)
+{
+    TEST(ssrf_dns_cache);
+    kelp_ssrf_dns_cache_clear();
+
+    kelp_ssrf_dns_stats_t a, b;
+    kelp_ssrf_dns_cache_stats(&a);
+    ASSERT_EQ_INT((int)a.entries, 0);
+
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("localhost"));
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("LOCALHOST"));
+    ASSERT_EQ_INT(kelp_ssrf_check("http://localhost/"), -1);
+    kelp_ssrf_dns_cache_stats(&b);
+    ASSERT_EQ_INT((int)(b.misses - a.misses), 1);
+    ASSERT_EQ_INT((int)(b.hits - a.hits), 2);
+    ASSERT_EQ_INT((int)b.entries, 1);
+
+    /* Failed lookups are cached too (briefly) */
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("no-such-host.invalid"));
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("no-such-host.invalid"));
+    kelp_ssrf_dns_cache_stats(&a);
+    ASSERT_EQ_INT((int)(a.negative_hits - b.negative_hits), 1);
+
+    /* TTL 0 disables caching */
+    kelp_ssrf_dns_cache_clear();
+    kelp_ssrf_dns_cache_set_ttl(0, 0);
+    ASSERT_TRUE(kelp_ssrf_is_private_ip("localhost"));
+    kelp_ssrf_dns_cache_stats(&a);
+    ASSERT_EQ_INT((int)a.entries, 0);
+    kelp_ssrf_dns_cache_set_ttl(60, 5);
+    PASS();
+}
+
+static void test_http_ssrf_protect(void)
+{
+    TEST(http_ssrf_protect);
+    kelp_ssrf_lists_reset();
+
+    kelp_http_request_t req = {0};
+    kelp_http_response_t resp;
+    req.method       = "GET";
+    req.timeout_ms   = 2000;
+    req.ssrf_protect = true;
+
+    /* Refused before any connection is attempted */
+    req.url = "http://169.254.169.254/latest/meta-data";
+    ASSERT_EQ_INT(kelp_http_request(&req, &resp), KELP_ERR_INVALID);
+    req.url = "http://localhost:1/";
+    ASSERT_EQ_INT(kelp_http_request(&req, &resp), KELP_ERR_INVALID);
+    req.url = "file:///etc/passwd";
+    ASSERT_EQ_INT(kelp_http_request(&req, &resp), KELP_ERR_INVALID);
+
+    /* Allow-listed: curl connects to the pinned loopback address (nothing
+     * listens on port 1, so this is a plain network error, not a refusal) */
+    kelp_ssrf_allow_list_add("localhost");
+    ASSERT_EQ_INT(kelp_http_request(&req, &resp), KELP_ERR_INVALID);
+    req.url = "http://localhost:1/";
+    ASSERT_EQ_INT(kelp_http_request(&req, &resp), KELP_ERR_NET);
+
+    kelp_ssrf_lists_reset();
+    PASS();
+}
+
 /* ======================================================================== */
 /* URL Encoding Tests                                                       */
 /* ======================================================================== */
@@ -406,6 +586,21 @@ static void test_header_free_null(void)
     PASS();
 }
 
+static void test_header_get(void)
+{
+    TEST(header_get);
+    kelp_http_header_t *list = NULL;
+    ASSERT_EQ_INT(kelp_http_header_add(&list, "Retry-After", "3"), 0);
+    ASSERT_EQ_INT(kelp_http_header_add(&list, "Content-Type", "text/plain"), 0);
+    ASSERT_EQ_STR(kelp_http_header_get(list, "retry-after"), "3");
+    ASSERT_EQ_STR(kelp_http_header_get(list, "Content-Type"), "text/plain");
+    ASSERT_NULL(kelp_http_header_get(list, "X-Missing"));
+    ASSERT_NULL(kelp_http_header_get(NULL, "Retry-After"));
+    ASSERT_NULL(kelp_http_header_get(list, NULL));
+    kelp_http_header_free(list);
+    PASS();
+}
+
 /* ======================================================================== */
 /* SSE Parsing Tests                                                        */
 /* ======================================================================== */
@@ -864,6 +1059,600 @@ static void test_heartbeat_stop_null(void)
     PASS();
 }
 
+/* ======================================================================== */
+/* Gateway Client Tests                                                     */
+/* ======================================================================== */
+
+/*
+ * A stand-in for kelp-gateway's Unix socket: answers chat.send with the
+ * message as content (sent in two chat.delta halves first when asked to
+ * stream) and "fail" with an error.  With hold > 1 it collects that many
+ * requests and answers them last-first; with oneshot it hangs up after
+ * every response.
+ */
+typedef struct {
+    char       path[108];
+    int        lfd;
+    pthread_t  tid;
+    int        hold;
+    bool       oneshot;
+    atomic_int accepted;
+} mock_gw_t;
+
+static void mock_gw_reply(int fd, const cJSON *req)
+{
+    int id = kelp_json_get_int(req, "id", 0);
+    const char *method = kelp_json_get_string(req, "method");
+    cJSON *params = kelp_json_get_object(req, "params");
+    const char *msg = kelp_json_get_string(params, "message");
+
+    if (method && strcmp(method, "fail") == 0) {
+        dprintf(fd, "{\"jsonrpc\":\"2.0\",\"id\":%d,\"error\":"
+                    "{\"code\":-32000,\"message\":\"mock failure\"}}\n", id);
+        return;
+    }
+    if (!msg)
+        msg = "";
+    if (kelp_json_get_bool(params, "stream", false)) {
+        int half = (int)strlen(msg) / 2;
+        dprintf(fd, "{\"jsonrpc\":\"2.0\",\"method\":\"chat.delta\","
+                    "\"params\":{\"id\":%d,\"text\":\"%.*s\"}}\n",
+                id, half, msg);
+        dprintf(fd, "{\"jsonrpc\":\"2.0\",\"method\":\"chat.delta\","
+                    "\"params\":{\"id\":%d,\"text\":\"%s\"}}\n",
+                id, msg + half);
+    }
+    dprintf(fd, "{\"jsonrpc\":\"2.0\",\"id\":%d,\"result\":"
+                "{\"content\":\"%s\"}}\n", id, msg);
+}
+
+static void *mock_gw_thread(void *arg)
+{
+    mock_gw_t *m = arg;
+    int cfd;
+
+    while ((cfd = accept(m->lfd, NULL, NULL)) >= 0) {
+        atomic_fetch_add(&m->accepted, 1);
+        FILE *in = fdopen(dup(cfd), "r");
+        cJSON *held[8];
+        int nheld = 0;
+        char *line = NULL;
+        size_t cap = 0;
+
+        while (in && getline(&line, &cap, in) > 0) {
+            cJSON *req = cJSON_Parse(line);
+            if (!req)
+                continue;
+            if (m->hold > 1) {
+                held[nheld++] = req;
+                if (nheld < m->hold)
+                    continue;
+                while (nheld > 0) {
+                    nheld--;
+                    mock_gw_reply(cfd, held[nheld]);
+                    cJSON_Delete(held[nheld]);
+                }
+                continue;
+            }
+            mock_gw_reply(cfd, req);
+            cJSON_Delete(req);
+            if (m->oneshot)
+                break;
+        }
+        while (nheld > 0)
+            cJSON_Delete(held[--nheld]);
+        free(line);
+        if (in)
+            fclose(in);
+        close(cfd);
+    }
+    return NULL;
+}
+
+static int mock_gw_start(mock_gw_t *m, int hold, bool oneshot)
+{
+    static int seq;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    memset(m, 0, sizeof(*m));
+    m->hold = hold;
+    m->oneshot = oneshot;
+    snprintf(m->path, sizeof(m->path), "/tmp/kelp-test-gw-%d-%d.sock",
+             (int)getpid(), seq++);
+    unlink(m->path);
+    memcpy(addr.sun_path, m->path, sizeof(m->path));
+
+    m->lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m->lfd < 0 ||
+        bind(m->lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(m->lfd, 8) != 0 ||
+        pthread_create(&m->tid, NULL, mock_gw_thread, m) != 0)
+        return -1;
+    return 0;
+}
+
+static void mock_gw_stop(mock_gw_t *m)
+{
+    shutdown(m->lfd, SHUT_RDWR);
+    pthread_join(m->tid, NULL);
+    close(m->lfd);
+    unlink(m->path);
+}
+
+typedef struct {
+    kelp_gateway_t *gw;
+    const char     *message;
+    char           *reply;
+} gw_chat_arg_t;
+
+static void *gw_chat_thread(void *arg)
+{
+    gw_chat_arg_t *a = arg;
+    a->reply = kelp_gateway_chat(a->gw, a->message, "c", "u", NULL, NULL);
+    return NULL;
+}
+
+static void test_gateway_new_null(void)
+{
+    TEST(gateway_new_null);
+    ASSERT_NULL(kelp_gateway_new(NULL));
+    kelp_gateway_free(NULL);
+    PASS();
+}
+
+static void test_gateway_chat(void)
+{
+    TEST(gateway_chat);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 1, false), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    char *a = kelp_gateway_chat(gw, "first", "c", "u", NULL, NULL);
+    char *b = kelp_gateway_chat(gw, "second", "c", "u", NULL, NULL);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+    ASSERT_EQ_STR(a, "first");
+    ASSERT_EQ_STR(b, "second");
+    free(a);
+    free(b);
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    /* Both calls share one connection */
+    ASSERT_EQ_INT(atomic_load(&m.accepted), 1);
+    PASS();
+}
+
+static void test_gateway_multiplex(void)
+{
+    TEST(gateway_multiplex_out_of_order);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 2, false), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    /* The mock answers only once both are in, second one first. */
+    gw_chat_arg_t args[2] = { { gw, "alpha", NULL }, { gw, "beta", NULL } };
+    pthread_t tids[2];
+    for (int i = 0; i < 2; i++)
+        pthread_create(&tids[i], NULL, gw_chat_thread, &args[i]);
+    for (int i = 0; i < 2; i++)
+        pthread_join(tids[i], NULL);
+
+    ASSERT_NOT_NULL(args[0].reply);
+    ASSERT_NOT_NULL(args[1].reply);
+    ASSERT_EQ_STR(args[0].reply, "alpha");
+    ASSERT_EQ_STR(args[1].reply, "beta");
+    free(args[0].reply);
+    free(args[1].reply);
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    ASSERT_EQ_INT(atomic_load(&m.accepted), 1);
+    PASS();
+}
+
+static int collect_partial(const char *text, void *userdata)
+{
+    kelp_str_append_cstr(userdata, text);
+    return 0;
+}
+
+static void test_gateway_partials(void)
+{
+    TEST(gateway_partials);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 1, false), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    kelp_str_t seen = kelp_str_new();
+    char *reply = kelp_gateway_chat(gw, "streamed reply", "c", "u",
+                                    collect_partial, &seen);
+    ASSERT_NOT_NULL(reply);
+    ASSERT_EQ_STR(reply, "streamed reply");
+    ASSERT_EQ_STR(seen.data, "streamed reply");
+    free(reply);
+    kelp_str_free(&seen);
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    PASS();
+}
+
+static void test_gateway_error_response(void)
+{
+    TEST(gateway_error_response);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 1, false), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    cJSON *result = NULL;
+    errno = 0;
+    ASSERT_EQ_INT(kelp_gateway_call(gw, "fail", NULL, NULL, NULL, 0,
+                                    &result), -1);
+    ASSERT_EQ_INT(errno, EREMOTEIO);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQ_STR(kelp_json_get_string(result, "message"), "mock failure");
+    cJSON_Delete(result);
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    PASS();
+}
+
+static void test_gateway_reconnect(void)
+{
+    TEST(gateway_reconnect);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 1, true), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    /* The mock hangs up after each reply; every call still succeeds. */
+    for (int i = 0; i < 3; i++) {
+        char *reply = kelp_gateway_chat(gw, "again", "c", "u", NULL, NULL);
+        ASSERT_NOT_NULL(reply);
+        ASSERT_EQ_STR(reply, "again");
+        free(reply);
+        /* Let the reader notice the hang-up before the next call. */
+        usleep(20000);
+    }
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    ASSERT_EQ_INT(atomic_load(&m.accepted), 3);
+    PASS();
+}
+
+static void test_gateway_timeout(void)
+{
+    TEST(gateway_timeout);
+    mock_gw_t m;
+    ASSERT_EQ_INT(mock_gw_start(&m, 2, false), 0);
+    kelp_gateway_t *gw = kelp_gateway_new(m.path);
+    ASSERT_NOT_NULL(gw);
+
+    /* The mock waits for a second request that never comes. */
+    cJSON *result = NULL;
+    errno = 0;
+    ASSERT_EQ_INT(kelp_gateway_call(gw, "chat.send", NULL, NULL, NULL, 100,
+                                    &result), -1);
+    ASSERT_EQ_INT(errno, ETIMEDOUT);
+    ASSERT_NULL(result);
+
+    kelp_gateway_free(gw);
+    mock_gw_stop(&m);
+    PASS();
+}
+
+static void test_gateway_unreachable(void)
+{
+    TEST(gateway_unreachable);
+    kelp_gateway_t *gw = kelp_gateway_new("/nonexistent/kelp-gateway.sock");
+    ASSERT_NOT_NULL(gw);
+
+    /* Backs off between attempts, then gives up at the deadline. */
+    cJSON *result = NULL;
+    errno = 0;
+    ASSERT_EQ_INT(kelp_gateway_call(gw, "health", NULL, NULL, NULL, 300,
+                                    &result), -1);
+    ASSERT_EQ_INT(errno, ENOENT);
+
+    kelp_gateway_free(gw);
+    PASS();
+}
+
+/* ======================================================================== */
+/* Live Reply Tests                                                         */
+/* ======================================================================== */
+
+/*
+ * A fake chat platform: keeps every posted message and applies edits to
+ * it.  It can refuse the next N edits with a retry-after, or fail the
+ * next N posts.
+ */
+#define FAKE_MAX_MSGS 16
+
+typedef struct {
+    char *msgs[FAKE_MAX_MSGS];
+    int   nmsgs;
+    int   edit_calls;
+    int   edits;            /* successful */
+    int   refuse_edits;
+    int   retry_after_ms;
+    int   fail_posts;
+} fake_chat_t;
+
+static char *fake_post(void *userdata, const char *text)
+{
+    fake_chat_t *c = userdata;
+    char id[16];
+
+    if (c->fail_posts > 0) {
+        c->fail_posts--;
+        return NULL;
+    }
+    if (c->nmsgs == FAKE_MAX_MSGS)
+        return NULL;
+    c->msgs[c->nmsgs] = strdup(text);
+    snprintf(id, sizeof(id), "%d", c->nmsgs++);
+    return strdup(id);
+}
+
+static int fake_edit(void *userdata, const char *id, const char *text,
+                     int *retry_after_ms)
+{
+    fake_chat_t *c = userdata;
+    int i = atoi(id);
+
+    c->edit_calls++;
+    if (c->refuse_edits > 0) {
+        c->refuse_edits--;
+        *retry_after_ms = c->retry_after_ms;
+        return -1;
+    }
+    free(c->msgs[i]);
+    c->msgs[i] = strdup(text);
+    c->edits++;
+    return 0;
+}
+
+static void fake_chat_free(fake_chat_t *c)
+{
+    for (int i = 0; i < c->nmsgs; i++)
+        free(c->msgs[i]);
+}
+
+static kelp_live_reply_t *fake_live_reply(fake_chat_t *c, size_t max_len,
+                                          int min_ms, int max_ms)
+{
+    kelp_live_reply_opts_t opts = {
+        .post            = fake_post,
+        .edit            = fake_edit,
+        .userdata        = c,
+        .max_len         = max_len,
+        .min_interval_ms = min_ms,
+        .max_interval_ms = max_ms,
+    };
+    memset(c, 0, sizeof(*c));
+    return kelp_live_reply_new(&opts);
+}
+
+static long mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000L;
+}
+
+static void test_live_reply_new_invalid(void)
+{
+    TEST(live_reply_new_invalid);
+    kelp_live_reply_opts_t opts = {
+        .post = fake_post, .max_len = 100,
+        .min_interval_ms = 10, .max_interval_ms = 100,
+    };
+    ASSERT_NULL(kelp_live_reply_new(NULL));
+    ASSERT_NULL(kelp_live_reply_new(&opts));        /* no edit hook */
+    opts.edit = fake_edit;
+    opts.max_interval_ms = 5;
+    ASSERT_NULL(kelp_live_reply_new(&opts));        /* max < min */
+    ASSERT_FALSE(kelp_live_reply_started(NULL));
+    kelp_live_reply_free(NULL);
+    PASS();
+}
+
+static void test_live_reply_streams(void)
+{
+    TEST(live_reply_streams);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 50, 1000);
+    ASSERT_NOT_NULL(lr);
+
+    /* Whitespace alone is not worth a message. */
+    ASSERT_EQ_INT(kelp_live_reply_feed("  ", lr), 0);
+    ASSERT_EQ_INT(c.nmsgs, 0);
+
+    /* First text goes out at once, the next waits for the limiter. */
+    ASSERT_EQ_INT(kelp_live_reply_feed("Hel", lr), 0);
+    ASSERT_EQ_INT(c.nmsgs, 1);
+    ASSERT_EQ_STR(c.msgs[0], "  Hel");
+    ASSERT_TRUE(kelp_live_reply_started(lr));
+    ASSERT_EQ_INT(kelp_live_reply_feed("lo", lr), 0);
+    ASSERT_EQ_INT(c.edit_calls, 0);
+
+    usleep(60000);
+    ASSERT_EQ_INT(kelp_live_reply_feed(" wor", lr), 0);
+    ASSERT_EQ_INT(c.edits, 1);
+    ASSERT_EQ_STR(c.msgs[0], "  Hello wor");
+
+    /* Nothing new, no edit. */
+    usleep(60000);
+    ASSERT_EQ_INT(kelp_live_reply_feed("", lr), 0);
+    ASSERT_EQ_INT(c.edit_calls, 1);
+
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "  Hello world"), 0);
+    ASSERT_EQ_INT(c.nmsgs, 1);
+    ASSERT_EQ_INT(c.edits, 2);
+    ASSERT_EQ_STR(c.msgs[0], "  Hello world");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_retry_after(void)
+{
+    TEST(live_reply_retry_after);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 20, 1000);
+    ASSERT_NOT_NULL(lr);
+
+    ASSERT_EQ_INT(kelp_live_reply_feed("a", lr), 0);
+    usleep(30000);
+    c.refuse_edits   = 1;
+    c.retry_after_ms = 150;
+    ASSERT_EQ_INT(kelp_live_reply_feed("b", lr), 0);
+    long refused_at = mono_ms();
+    ASSERT_EQ_INT(c.edit_calls, 1);
+    ASSERT_EQ_INT(c.edits, 0);
+
+    /* Past the old interval but inside the retry-after: no attempt. */
+    usleep(50000);
+    ASSERT_EQ_INT(kelp_live_reply_feed("c", lr), 0);
+    ASSERT_EQ_INT(c.edit_calls, 1);
+
+    /* finish() waits it out. */
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "abcd"), 0);
+    ASSERT_TRUE(mono_ms() - refused_at >= 150);
+    ASSERT_EQ_INT(c.edit_calls, 2);
+    ASSERT_EQ_STR(c.msgs[0], "abcd");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_overflow(void)
+{
+    TEST(live_reply_overflow);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 8, 1, 10);
+    ASSERT_NOT_NULL(lr);
+
+    const char *parts[] = { "0123", "4567", "89ab", "cdef", "gh" };
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        usleep(2000);
+        ASSERT_EQ_INT(kelp_live_reply_feed(parts[i], lr), 0);
+    }
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "0123456789abcdefgh"), 0);
+    ASSERT_EQ_INT(c.nmsgs, 3);
+    ASSERT_EQ_STR(c.msgs[0], "01234567");
+    ASSERT_EQ_STR(c.msgs[1], "89abcdef");
+    ASSERT_EQ_STR(c.msgs[2], "gh");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_utf8(void)
+{
+    TEST(live_reply_utf8);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 6, 1, 10);
+    ASSERT_NOT_NULL(lr);
+
+    /* Half a euro sign is held back, and never split across messages. */
+    ASSERT_EQ_INT(kelp_live_reply_feed("abc\xe2\x82", lr), 0);
+    ASSERT_EQ_STR(c.msgs[0], "abc");
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "abcd\xe2\x82\xac" "ef"), 0);
+    ASSERT_EQ_INT(c.nmsgs, 2);
+    ASSERT_EQ_STR(c.msgs[0], "abcd");
+    ASSERT_EQ_STR(c.msgs[1], "\xe2\x82\xac" "ef");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_rewrite(void)
+{
+    TEST(live_reply_rewrite);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 1, 10);
+    ASSERT_NOT_NULL(lr);
+
+    /* A final text that is not a continuation replaces the stream. */
+    ASSERT_EQ_INT(kelp_live_reply_feed("Thinking about", lr), 0);
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "Error: boom"), 0);
+    ASSERT_EQ_INT(c.nmsgs, 1);
+    ASSERT_EQ_STR(c.msgs[0], "Error: boom");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_unstreamed(void)
+{
+    TEST(live_reply_unstreamed);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 1, 10);
+    ASSERT_NOT_NULL(lr);
+
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "whole reply"), 0);
+    ASSERT_EQ_INT(c.nmsgs, 1);
+    ASSERT_EQ_INT(c.edit_calls, 0);
+    ASSERT_EQ_STR(c.msgs[0], "whole reply");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_post_fails(void)
+{
+    TEST(live_reply_post_fails);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 1, 4);
+    ASSERT_NOT_NULL(lr);
+
+    c.fail_posts = 100;
+    ASSERT_TRUE(kelp_live_reply_feed("hello", lr) != 0);
+    ASSERT_FALSE(kelp_live_reply_started(lr));
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "hello"), -1);
+    ASSERT_EQ_INT(c.nmsgs, 0);
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
+static void test_live_reply_edit_fallback(void)
+{
+    TEST(live_reply_edit_fallback);
+    fake_chat_t c;
+    kelp_live_reply_t *lr = fake_live_reply(&c, 100, 1, 4);
+    ASSERT_NOT_NULL(lr);
+
+    /* An uneditable message keeps its text; the rest follows it. */
+    ASSERT_EQ_INT(kelp_live_reply_feed("abc", lr), 0);
+    c.refuse_edits = 1000;
+    ASSERT_EQ_INT(kelp_live_reply_finish(lr, "abcdef"), 0);
+    ASSERT_EQ_INT(c.edit_calls, KELP_LIVE_REPLY_RETRIES);
+    ASSERT_EQ_INT(c.nmsgs, 2);
+    ASSERT_EQ_STR(c.msgs[0], "abc");
+    ASSERT_EQ_STR(c.msgs[1], "def");
+
+    kelp_live_reply_free(lr);
+    fake_chat_free(&c);
+    PASS();
+}
+
 /* ======================================================================== */
 /* Main                                                                     */
 /* ======================================================================== */
@@ -894,6 +1683,12 @@ int main(void)
     test_ssrf_block_overrides_allow();
     test_ssrf_ipv6_url();
     test_ssrf_cgnat();
+    test_ssrf_ipv4_mapped();
+    test_ssrf_cidr_lists();
+    test_ssrf_host_lists_case();
+    test_ssrf_resolve_target();
+    test_ssrf_dns_cache();
+    test_http_ssrf_protect();
 
     printf("\n[URL Encoding]\n");
     test_url_encode_basic();
@@ -909,6 +1704,7 @@ int main(void)
     test_header_add_multiple();
     test_header_add_null_args();
     test_header_free_null();
+    test_header_get();
 
     printf("\n[SSE Parsing]\n");
     test_sse_simple_data();
@@ -932,6 +1728,27 @@ int main(void)
     test_heartbeat_is_alive_null();
     test_heartbeat_stop_null();
 
+    printf("\n[Gateway Client]\n");
+    test_gateway_new_null();
+    test_gateway_chat();
+    test_gateway_multiplex();
+    test_gateway_partials();
+    test_gateway_error_response();
+    test_gateway_reconnect();
+    test_gateway_timeout();
+    test_gateway_unreachable();
+
+    printf("\n[Live Reply]\n");
+    test_live_reply_new_invalid();
+    test_live_reply_streams();
+    test_live_reply_retry_after();
+    test_live_reply_overflow();
+    test_live_reply_utf8();
+    test_live_reply_rewrite();
+    test_live_reply_unstreamed();
+    test_live_reply_post_fails();
+    test_live_reply_edit_fallback();
+
     printf("\n--------------------------------------------------\n");
     printf("Results: %d/%d passed\n", tests_passed, tests_run);
 
@@ -5,6 +5,11 @@
  * Thread-safe audit logging with multiple sink support.  Events are written
  * as JSON Lines to a file and optionally dispatched to registered callbacks.
  *
+ * kelp_audit_init() writes synchronously from the calling thread.
+ * kelp_audit_init_async() instead hands events to a background writer
+ * through a lock-free queue, batching writes and running sinks off the
+ * caller's path.
+ *
  * SPDX-License-Identifier: MIT
  */
 
@@ -13,6 +18,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 #ifdef __cplusplus
@@ -64,10 +70,84 @@ typedef void (*kelp_audit_sink_t)(const kelp_audit_event_t *event,
  */
 int kelp_audit_init(const char *log_path);
 
+/** fsync policy for the asynchronous writer. */
+typedef enum {
+    KELP_AUDIT_FSYNC_NONE     = 0,  /* leave it to the kernel               */
+    KELP_AUDIT_FSYNC_INTERVAL = 1,  /* at most every fsync_interval_ms       */
+    KELP_AUDIT_FSYNC_EVERY_N  = 2   /* after every fsync_every_n events      */
+} kelp_audit_fsync_t;
+
+/** What kelp_audit_log() does when the async queue is full. */
+typedef enum {
+    KELP_AUDIT_FULL_DROP  = 0,      /* discard the event, count it          */
+    KELP_AUDIT_FULL_BLOCK = 1       /* wait for the writer to make room     */
+} kelp_audit_overflow_t;
+
+/** On-disk format for the asynchronous writer. */
+typedef enum {
+    KELP_AUDIT_FORMAT_JSONL   = 0,  /* JSON Lines                           */
+    KELP_AUDIT_FORMAT_SEGMENT = 1   /* binary segments, see audit_segment.h */
+} kelp_audit_format_t;
+
+/** Options for kelp_audit_init_async().  Zeroed fields take defaults. */
+typedef struct {
+    size_t                 ring_size;         /* queued events (4096)       */
+    size_t                 batch_max;         /* events per writev() (64)   */
+    kelp_audit_fsync_t     fsync_policy;      /* NONE                       */
+    unsigned               fsync_interval_ms; /* INTERVAL period (1000)     */
+    unsigned               fsync_every_n;     /* EVERY_N count (1)          */
+    size_t                 rotate_bytes;      /* rotate above this, 0 = off */
+    unsigned               rotate_keep;       /* path.1 .. path.N kept (1)  */
+    kelp_audit_overflow_t  on_full;           /* DROP                       */
+    kelp_audit_format_t    format;            /* JSONL                      */
+} kelp_audit_async_opts_t;
+
+/** Audit pipeline counters (cumulative since the last init). */
+typedef struct {
+    uint64_t enqueued;      /* events accepted by the async queue          */
+    uint64_t written;       /* events written to the log file              */
+    uint64_t dropped;       /* events lost to a full queue                 */
+    uint64_t blocked;       /* kelp_audit_log() calls that had to wait     */
+    uint64_t batches;       /* writev() batches issued                     */
+    uint64_t fsyncs;        /* fdatasync() calls                           */
+    uint64_t rotations;     /* log rotations                               */
+    uint64_t write_errors;  /* failed writes, plus events lost while the
+                               log could not be opened                   */
+} kelp_audit_stats_t;
+
+/**
+ * Initialise the audit subsystem in asynchronous mode.
+ *
+ * Like kelp_audit_init(), but kelp_audit_log() only copies the event into a
+ * bounded queue; a background thread formats and writes events in batches
+ * and runs the sinks.  Sinks are therefore called from the writer thread,
+ * shortly after the event is logged.
+ *
+ * @param log_path  Path to the JSON-Lines audit log file.
+ * @param opts      Tuning options, or NULL for defaults.
+ * @return 0 on success, -1 on error.
+ */
+int kelp_audit_init_async(const char *log_path,
+                          const kelp_audit_async_opts_t *opts);
+
+/**
+ * Wait until every event logged before this call has been written and
+ * passed to the sinks.  In synchronous mode this just flushes the file.
+ */
+void kelp_audit_flush(void);
+
+/**
+ * Read the pipeline counters.
+ *
+ * @param out  Receives the counters.
+ */
+void kelp_audit_get_stats(kelp_audit_stats_t *out);
+
 /**
  * Shut down the audit subsystem.
  *
- * Flushes and closes the log file, clears all registered sinks.
+ * Drains any queued events, flushes and closes the log file, and clears all
+ * registered sinks.
  */
 void kelp_audit_shutdown(void);
 
@@ -0,0 +1,175 @@
+/*
+ * kelp-linux :: libkelp-security
+ * audit_segment.h - Compact binary audit log segments
+ *
+ * An alternative to the JSON Lines audit log for large deployments.  A
+ * segment is a single file:
+ *
+ *   header   magic "KAUDSEG1", version, base timestamp
+ *   records  length-prefixed; either a string definition (interning a
+ *            category/action name under a small id) or an event whose
+ *            fields are varints and length-prefixed strings
+ *   footer   (written on close) the string table, a time index of record
+ *            blocks with their min/max timestamps, and a trailer
+ *
+ * Segments are read through mmap.  Queries use the time index to skip
+ * whole blocks and reject records on their timestamp, flags, interned
+ * category or subject bytes before decoding anything else.  A segment
+ * whose writer died before closing it has no footer; it is still readable
+ * by a linear scan.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_AUDIT_SEGMENT_H
+#define KELP_AUDIT_SEGMENT_H
+
+#include <kelp/audit.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---- writing ------------------------------------------------------------ */
+
+typedef struct kelp_audit_segment_writer kelp_audit_segment_writer_t;
+
+/**
+ * Create (or truncate) a segment file and write its header.
+ *
+ * @param path  Segment file path.
+ * @return A writer, or NULL on error.
+ */
+kelp_audit_segment_writer_t *kelp_audit_segment_create(const char *path);
+
+/**
+ * Open a segment to append to it, creating it if it does not exist or is
+ * empty.  The footer of a closed segment is dropped (close writes a new
+ * one) and a final record torn by a crash is cut off.  A segment with a
+ * bad record before its end is never truncated: it is renamed to
+ * `path.damaged.N` and a new segment is started at `path`.
+ *
+ * @param path  Segment file path.
+ * @return A writer, or NULL on error (errno EINVAL if the file exists
+ *         but is not a segment; it is left untouched).
+ */
+kelp_audit_segment_writer_t *kelp_audit_segment_reopen(const char *path);
+
+/**
+ * Encode an event into the writer's pending buffer.  Nothing reaches the
+ * file until kelp_audit_segment_flush() or kelp_audit_segment_close().
+ *
+ * @return 0 on success, -1 on error.
+ */
+int kelp_audit_segment_append(kelp_audit_segment_writer_t *w,
+                              const kelp_audit_event_t *event);
+
+/**
+ * Write the pending records to the file.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+int kelp_audit_segment_flush(kelp_audit_segment_writer_t *w);
+
+/** File size so far, including pending records. */
+size_t kelp_audit_segment_size(const kelp_audit_segment_writer_t *w);
+
+/** Return the writer's file descriptor (for fsync). */
+int kelp_audit_segment_fd(const kelp_audit_segment_writer_t *w);
+
+/**
+ * Flush, write the footer (string table and time index) and close.
+ *
+ * @return 0 on success, -1 if anything could not be written.
+ */
+int kelp_audit_segment_close(kelp_audit_segment_writer_t *w);
+
+/* ---- reading ------------------------------------------------------------ */
+
+typedef struct kelp_audit_segment kelp_audit_segment_t;
+
+/** Record filter for kelp_audit_segment_query().  Zero = match all. */
+typedef struct {
+    time_t              since;       /* timestamp >= since (0 = open)       */
+    time_t              until;       /* timestamp <= until (0 = open)       */
+    const char         *subject;     /* exact subject, or NULL              */
+    const char         *category;    /* exact category, or NULL             */
+    int                 allowed;     /* 1 allowed, 0 denied, -1 either      */
+    kelp_audit_level_t  min_level;   /* events at or above this level       */
+} kelp_audit_query_t;
+
+/**
+ * Query callback.  The event's strings are only valid during the call.
+ *
+ * @return 0 to continue, non-zero to stop the query.
+ */
+typedef int (*kelp_audit_query_cb)(const kelp_audit_event_t *event,
+                                   void *userdata);
+
+/** Segment summary. */
+typedef struct {
+    uint64_t events;       /* events in the segment                     */
+    time_t   min_time;     /* earliest event timestamp                  */
+    time_t   max_time;     /* latest event timestamp                    */
+    size_t   strings;      /* interned category/action strings          */
+    size_t   blocks;       /* time index blocks                         */
+    bool     indexed;      /* footer present (false: crash-truncated)   */
+} kelp_audit_segment_info_t;
+
+/**
+ * Map a segment file read-only.
+ *
+ * @return The segment, or NULL if it cannot be opened or is not a segment.
+ */
+kelp_audit_segment_t *kelp_audit_segment_open(const char *path);
+
+/** Unmap a segment (may be NULL). */
+void kelp_audit_segment_free(kelp_audit_segment_t *seg);
+
+/** Fill `out` with the segment summary. */
+void kelp_audit_segment_info(const kelp_audit_segment_t *seg,
+                             kelp_audit_segment_info_t *out);
+
+/**
+ * Call `cb` for every event matching `q`, in file order.
+ *
+ * @return Number of matching events delivered, or -1 on a corrupt segment.
+ */
+long kelp_audit_segment_query(kelp_audit_segment_t *seg,
+                              const kelp_audit_query_t *q,
+                              kelp_audit_query_cb cb, void *userdata);
+
+/* ---- conversion --------------------------------------------------------- */
+
+/**
+ * Convert a JSON Lines audit log into a segment.  Lines that are not
+ * valid audit records are skipped and counted.
+ *
+ * @param jsonl_path    Existing JSONL audit log.
+ * @param segment_path  Segment to create.
+ * @param converted     If non-NULL, receives the number of events written.
+ * @param skipped       If non-NULL, receives the number of lines skipped.
+ * @return 0 on success, -1 on I/O error.
+ */
+int kelp_audit_jsonl_to_segment(const char *jsonl_path,
+                                const char *segment_path,
+                                size_t *converted, size_t *skipped);
+
+/**
+ * Parse an audit timestamp ("2024-01-31T12:00:00Z", as written to the log)
+ * or a plain number of seconds since the epoch.
+ *
+ * @return 0 on success, -1 if `text` is neither.
+ */
+int kelp_audit_parse_time(const char *text, time_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KELP_AUDIT_SEGMENT_H */
@@ -0,0 +1,39 @@
+/*
+ * kelp-linux :: libkelp-security
+ * decision_cache.h - Decision cache statistics
+ *
+ * The policy engine and the path scanner can memoise their answers in a
+ * bounded, lock-free-read cache (see kelp_policy_enable_cache() and
+ * kelp_path_scanner_enable_cache()).  This header defines the counters
+ * both caches report.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_DECISION_CACHE_H
+#define KELP_DECISION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Snapshot of a decision cache's counters. */
+typedef struct {
+    size_t   capacity;       /* number of slots (0 = cache disabled)      */
+    uint64_t hits;           /* lookups answered from the cache           */
+    uint64_t misses;         /* lookups that had to evaluate the rules    */
+    uint64_t bypassed;       /* keys too long to cache                    */
+    uint64_t invalidations;  /* rule changes that retired every entry     */
+    uint64_t miss_ns;        /* total time spent evaluating on misses     */
+    uint64_t saved_ns;       /* estimate: hits x average miss cost        */
+    double   hit_ratio;      /* hits / (hits + misses), 0 when idle       */
+} kelp_decision_cache_stats_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KELP_DECISION_CACHE_H */
@@ -13,6 +13,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -78,8 +79,9 @@ bool kelp_fs_check_ownership(const char *path, uid_t expected_uid);
  * Recursively scan @p dir for permission issues.
  *
  * Issues detected include world-writable files/directories, setuid/setgid
- * binaries, and files not owned by the current user.  Each issue is logged
- * via the kelp logging subsystem.
+ * binaries, and symlinks resolving outside @p dir.  Each issue is logged
+ * via the kelp logging subsystem.  Runs kelp_fs_scan() with one worker
+ * per online CPU.
  *
  * @param dir        Directory to scan.
  * @param max_depth  Maximum recursion depth (0 = scan only @p dir itself).
@@ -87,6 +89,69 @@ bool kelp_fs_check_ownership(const char *path, uid_t expected_uid);
  */
 int kelp_fs_scan_permissions(const char *dir, int max_depth);
 
+/* ---- parallel / incremental scanning ------------------------------------ */
+
+/** Permission issue kinds reported by kelp_fs_scan(). */
+typedef enum {
+    KELP_FS_ISSUE_WORLD_WRITABLE = 1,   /* o+w file or directory          */
+    KELP_FS_ISSUE_SETUID,               /* setuid regular file            */
+    KELP_FS_ISSUE_SETGID,               /* setgid regular file            */
+    KELP_FS_ISSUE_SYMLINK_ESCAPE        /* symlink resolving outside root */
+} kelp_fs_issue_t;
+
+/**
+ * Issue callback.  Calls are serialised, but come from worker threads.
+ *
+ * @param path   Full path of the offending entry.
+ * @param issue  What is wrong with it.
+ * @param mode   The entry's st_mode.
+ */
+typedef void (*kelp_fs_issue_cb)(const char *path, kelp_fs_issue_t issue,
+                                 unsigned mode, void *userdata);
+
+typedef struct {
+    int         max_depth;    /* as kelp_fs_scan_permissions(); <0 = no limit */
+    unsigned    threads;      /* worker threads, 0 = one per online CPU       */
+    const char *state_path;   /* incremental state file, or NULL              */
+    bool        incremental;  /* reuse unchanged directories from state_path  */
+} kelp_fs_scan_opts_t;
+
+typedef struct {
+    uint64_t dirs;            /* directories scanned                       */
+    uint64_t dirs_reused;     /* of which unchanged, listed from the state */
+    uint64_t entries;         /* directory entries examined                */
+    uint64_t statx_calls;     /* statx(2) calls made                       */
+    uint64_t issues;          /* issues reported                           */
+    double   elapsed_sec;
+} kelp_fs_scan_stats_t;
+
+/**
+ * Scan @p dir for permission issues with a pool of worker threads.
+ *
+ * Directories are distributed over per-worker queues; idle workers steal
+ * from busy ones.  Entries are read with getdents64(2) and examined with
+ * a single statx(2) each, without following symlinks.
+ *
+ * If @p opts->state_path is set, the (inode, mtime, mode) of every entry
+ * is saved there after the scan.  With @p opts->incremental, a directory
+ * whose inode and mtime match the saved state is not re-read: its
+ * non-directory entries are judged from the saved modes and only its
+ * subdirectories are statx'd and descended into.  A directory's mtime
+ * only changes when entries are added, removed or renamed, so a chmod of
+ * an existing file in an otherwise unchanged directory is not seen by an
+ * incremental scan; run a full scan periodically.
+ *
+ * @param dir       Root directory.
+ * @param opts      Options (NULL = defaults: no depth limit, no state).
+ * @param cb        Issue callback (may be NULL).
+ * @param userdata  Passed to @p cb.
+ * @param stats     If non-NULL, receives scan counters.
+ * @return Number of issues found, or -1 if @p dir cannot be scanned.
+ */
+int kelp_fs_scan(const char *dir, const kelp_fs_scan_opts_t *opts,
+                 kelp_fs_issue_cb cb, void *userdata,
+                 kelp_fs_scan_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
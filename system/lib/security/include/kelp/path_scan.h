@@ -11,7 +11,10 @@
 #ifndef KELP_PATH_SCAN_H
 #define KELP_PATH_SCAN_H
 
+#include <kelp/decision_cache.h>
+
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +63,29 @@ void kelp_path_scanner_add_pattern(kelp_path_scanner_t *s,
  */
 bool kelp_path_scanner_check(const kelp_path_scanner_t *s, const char *path);
 
+/**
+ * Enable (or resize) the decision cache.
+ *
+ * Once enabled, kelp_path_scanner_check() memoises its answer per path.
+ * Lookups are lock-free; adding patterns retires every cached decision
+ * atomically.  Call before the scanner is shared between threads.
+ *
+ * @param s        Scanner handle.
+ * @param entries  Cache size in slots (rounded up to a power of two);
+ *                 0 disables the cache.
+ * @return 0 on success, -1 on error.
+ */
+int kelp_path_scanner_enable_cache(kelp_path_scanner_t *s, size_t entries);
+
+/**
+ * Read the decision cache counters (hit ratio, estimated time saved).
+ *
+ * @param s    Scanner handle (may be NULL).
+ * @param out  Receives the snapshot; all zero if no cache is enabled.
+ */
+void kelp_path_scanner_get_cache_stats(const kelp_path_scanner_t *s,
+                                       kelp_decision_cache_stats_t *out);
+
 /**
  * Add a set of sensible default deny patterns.
  *
@@ -6,13 +6,20 @@
  * web_fetch, etc.) are allowed, denied, audited, or require user confirmation.
  * Rules are matched in order; the first matching rule wins.
  *
+ * Large rule sets should be compiled with kelp_policy_compile(), which
+ * buckets rules by tool and indexes literal, prefix ("name*") and suffix
+ * ("*.ext") patterns so a check no longer scans every rule.
+ *
  * SPDX-License-Identifier: MIT
  */
 
 #ifndef KELP_POLICY_H
 #define KELP_POLICY_H
 
+#include <kelp/decision_cache.h>
+
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,7 +71,8 @@ void kelp_policy_free(kelp_policy_t *p);
  * "tool", "pattern", "action" (allow|deny|ask|audit), and optionally
  * "reason".
  *
- * Loaded rules are appended after any existing rules.
+ * Loaded rules are appended after any existing rules, and the policy is
+ * recompiled afterwards (see kelp_policy_compile()).
  *
  * @param p     Policy handle.
  * @param path  Path to the JSON policy file.
@@ -76,7 +84,9 @@ int kelp_policy_load(kelp_policy_t *p, const char *path);
  * Append a rule to the policy.
  *
  * Rules are evaluated in the order they were added.  The first matching
- * rule determines the action.
+ * rule determines the action.  Adding a rule discards any compiled index;
+ * checks fall back to a linear scan until kelp_policy_compile() is called
+ * again.
  *
  * @param p     Policy handle.
  * @param rule  The rule to add.
@@ -84,12 +94,34 @@ int kelp_policy_load(kelp_policy_t *p, const char *path);
  */
 int kelp_policy_add_rule(kelp_policy_t *p, const kelp_policy_rule_t *rule);
 
+/**
+ * Compile the current rule list into a lookup index.
+ *
+ * Rules are bucketed by tool name ("*" rules join every bucket).  Patterns
+ * without glob metacharacters go into a hash set, "literal*" and
+ * "*literal" patterns into prefix/suffix tries, and anything else is kept
+ * for fnmatch(3) -- tried only while it could still beat the best indexed
+ * match.  Results are identical to the uncompiled scan.
+ *
+ * @param p  Policy handle.
+ * @return 0 on success, -1 on error (the policy stays usable, uncompiled).
+ */
+int kelp_policy_compile(kelp_policy_t *p);
+
+/**
+ * Return true if the policy currently has a compiled index.
+ *
+ * @param p  Policy handle (may be NULL).
+ */
+bool kelp_policy_is_compiled(const kelp_policy_t *p);
+
 /**
  * Check a tool invocation against the policy.
  *
- * Iterates through rules in order.  If the tool name matches and the
- * argument matches the glob pattern, returns that rule's action.  If no
- * rule matches, KELP_POLICY_ALLOW is returned (open by default).
+ * Finds the first rule (in insertion order) whose tool name matches and
+ * whose glob pattern matches the argument, and returns that rule's action.
+ * If no rule matches, KELP_POLICY_ALLOW is returned (open by default).
+ * Uses the compiled index when one is present.
  *
  * @param p     Policy handle.
  * @param tool  Tool name (e.g. "bash").
@@ -100,6 +132,30 @@ kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
                                          const char *tool,
                                          const char *arg);
 
+/**
+ * Enable (or resize) the decision cache.
+ *
+ * Once enabled, kelp_policy_check() memoises its answer per (tool, arg).
+ * Lookups are lock-free; adding or loading rules retires every cached
+ * decision atomically.  Arguments longer than ~200 bytes are not cached.
+ * Call before the policy is shared between threads.
+ *
+ * @param p        Policy handle.
+ * @param entries  Cache size in slots (rounded up to a power of two);
+ *                 0 disables the cache.
+ * @return 0 on success, -1 on error.
+ */
+int kelp_policy_enable_cache(kelp_policy_t *p, size_t entries);
+
+/**
+ * Read the decision cache counters (hit ratio, estimated time saved).
+ *
+ * @param p    Policy handle (may be NULL).
+ * @param out  Receives the snapshot; all zero if no cache is enabled.
+ */
+void kelp_policy_get_cache_stats(const kelp_policy_t *p,
+                                 kelp_decision_cache_stats_t *out);
+
 /**
  * Add a set of sensible default rules to the policy.
  *
@@ -109,7 +165,8 @@ kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
  *   - Audit bash  "*"
  *   - Deny  *     accessing *.env, *.pem, *.key, .ssh/*
  *
- * Existing rules are preserved; defaults are appended.
+ * Existing rules are preserved; defaults are appended and the policy is
+ * recompiled.
  *
  * @param p  Policy handle.
  */
@@ -5,22 +5,59 @@
  * Thread-safe audit logging.  Events are serialised as JSON Lines and written
  * to a log file.  Additional callback sinks may be registered.
  *
+ * Two modes:
+ *
+ *   sync   (kelp_audit_init)        -- the caller formats, writes and runs
+ *                                      the sinks under a global mutex.
+ *   async  (kelp_audit_init_async)  -- the caller copies the event into a
+ *                                      single allocation and pushes it onto
+ *                                      a bounded lock-free MPSC ring.  A
+ *                                      writer thread drains the ring in
+ *                                      batches, formats, writev()s, applies
+ *                                      the fsync and rotation policies and
+ *                                      runs the sinks.  The writer emits
+ *                                      JSON Lines or, on request, binary
+ *                                      segments (audit_segment.c).
+ *
+ * The ring is the bounded queue from Dmitry Vyukov's MPMC design: each cell
+ * carries a sequence number telling producers and the consumer whose turn
+ * it is, so neither side takes a lock.  The writer sleeps on a condition
+ * variable only when the ring is empty; producers touch the mutex just to
+ * wake it up.
+ *
  * SPDX-License-Identifier: MIT
  */
 
 #include <kelp/audit.h>
+#include <kelp/audit_segment.h>
+#include <kelp/buf.h>
 #include <kelp/log.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
 /* ---- limits ------------------------------------------------------------- */
 
-#define AUDIT_MAX_SINKS 16
+#define AUDIT_MAX_SINKS           16
+#define AUDIT_DEFAULT_RING        4096
+#define AUDIT_DEFAULT_BATCH       64
+#define AUDIT_MAX_BATCH           IOV_MAX
+#define AUDIT_DEFAULT_FSYNC_MS    1000
+#define AUDIT_IDLE_WAIT_MS        200
+#define AUDIT_BACKPRESSURE_US     100
 
 /* ---- internal types ----------------------------------------------------- */
 
@@ -29,21 +66,76 @@ typedef struct {
     void              *userdata;
 } sink_entry_t;
 
+typedef enum {
+    AUDIT_MODE_OFF = 0,
+    AUDIT_MODE_SYNC,
+    AUDIT_MODE_ASYNC
+} audit_mode_t;
+
+/**
+ * Queued event.  The strings live in the same allocation, right after the
+ * struct, so a record is one malloc and one free.
+ */
+typedef struct {
+    kelp_audit_event_t ev;
+    char               strings[];
+} audit_rec_t;
+
+typedef struct {
+    _Atomic size_t  seq;
+    audit_rec_t    *rec;
+} ring_cell_t;
+
 /* ---- module state ------------------------------------------------------- */
 
 static struct {
     pthread_mutex_t     mutex;
     FILE               *fp;
     int                 initialised;
-    kelp_audit_level_t min_level;
+    _Atomic int         min_level;
     sink_entry_t        sinks[AUDIT_MAX_SINKS];
     int                 sink_count;
+
+    /* async pipeline */
+    _Atomic int         mode;
+    _Atomic int         producers;    /* kelp_audit_log() calls in flight */
+    kelp_audit_async_opts_t opts;
+    char               *path;
+    int                 fd;
+    off_t               file_bytes;
+    kelp_audit_segment_writer_t *seg;  /* KELP_AUDIT_FORMAT_SEGMENT */
+    ring_cell_t        *ring;
+    size_t              ring_mask;
+    _Atomic size_t      tail;         /* producers                        */
+    size_t              head;         /* writer thread only               */
+    pthread_t           writer;
+    pthread_mutex_t     wake_mutex;
+    pthread_cond_t      wake_cond;
+    pthread_cond_t      idle_cond;
+    _Atomic int         writer_sleeping;
+    _Atomic int         stopping;
+    uint64_t            flush_req;    /* under wake_mutex */
+    uint64_t            flush_done;   /* under wake_mutex */
+
+    /* counters */
+    _Atomic uint64_t    enqueued;
+    _Atomic uint64_t    written;
+    _Atomic uint64_t    dropped;
+    _Atomic uint64_t    blocked;
+    _Atomic uint64_t    batches;
+    _Atomic uint64_t    fsyncs;
+    _Atomic uint64_t    rotations;
+    _Atomic uint64_t    write_errors;
 } g_audit = {
     .mutex       = PTHREAD_MUTEX_INITIALIZER,
     .fp          = NULL,
     .initialised = 0,
     .min_level   = KELP_AUDIT_INFO,
     .sink_count  = 0,
+    .fd          = -1,
+    .wake_mutex  = PTHREAD_MUTEX_INITIALIZER,
+    .wake_cond   = PTHREAD_COND_INITIALIZER,
+    .idle_cond   = PTHREAD_COND_INITIALIZER,
 };
 
 /* ---- helpers ------------------------------------------------------------ */
@@ -60,46 +152,40 @@ static const char *level_string(kelp_audit_level_t level)
 }
 
 /**
- * Escape a string for inclusion in a JSON value.
- *
- * Writes the escaped string (without surrounding quotes) into @p out.
- * Returns the number of characters written (excluding NUL), or -1 if
- * the buffer is too small.
+ * Append @p src to @p out as the body of a JSON string (no quotes).
+ * Grows the buffer as needed, so long values are never truncated.
  */
-static int json_escape(const char *src, char *out, size_t out_len)
+static void json_escape(kelp_buf_t *out, const char *src)
 {
-    if (!src) {
-        if (out_len > 0) out[0] = '\0';
-        return 0;
-    }
+    if (!src)
+        return;
 
-    size_t pos = 0;
+    const char *run = src;
     for (const char *p = src; *p; p++) {
-        char esc = 0;
-        switch (*p) {
-        case '"':  esc = '"';  break;
-        case '\\': esc = '\\'; break;
-        case '\b': esc = 'b';  break;
-        case '\f': esc = 'f';  break;
-        case '\n': esc = 'n';  break;
-        case '\r': esc = 'r';  break;
-        case '\t': esc = 't';  break;
-        default:   break;
+        unsigned char c = (unsigned char)*p;
+        char esc[8];
+        size_t esc_len = 2;
+
+        switch (c) {
+        case '"':  memcpy(esc, "\\\"", 2); break;
+        case '\\': memcpy(esc, "\\\\", 2); break;
+        case '\b': memcpy(esc, "\\b", 2);  break;
+        case '\f': memcpy(esc, "\\f", 2);  break;
+        case '\n': memcpy(esc, "\\n", 2);  break;
+        case '\r': memcpy(esc, "\\r", 2);  break;
+        case '\t': memcpy(esc, "\\t", 2);  break;
+        default:
+            if (c >= 0x20)
+                continue;
+            esc_len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c);
+            break;
         }
 
-        if (esc) {
-            if (pos + 2 >= out_len) return -1;
-            out[pos++] = '\\';
-            out[pos++] = esc;
-        } else {
-            if (pos + 1 >= out_len) return -1;
-            out[pos++] = *p;
-        }
+        kelp_buf_write(out, run, (size_t)(p - run));
+        kelp_buf_write(out, esc, esc_len);
+        run = p + 1;
     }
-
-    if (pos >= out_len) return -1;
-    out[pos] = '\0';
-    return (int)pos;
+    kelp_buf_write(out, run, strlen(run));
 }
 
 static void format_timestamp(time_t t, char *buf, size_t cap)
@@ -109,22 +195,515 @@ static void format_timestamp(time_t t, char *buf, size_t cap)
     strftime(buf, cap, "%Y-%m-%dT%H:%M:%SZ", &tm);
 }
 
-/* ---- public API --------------------------------------------------------- */
+static void buf_puts(kelp_buf_t *b, const char *s)
+{
+    kelp_buf_write(b, s, strlen(s));
+}
 
-int kelp_audit_init(const char *log_path)
+/** Append one JSON line (including the trailing newline) to @p out. */
+static void format_event(kelp_buf_t *out, const kelp_audit_event_t *event)
 {
-    if (!log_path)
+    char ts[64];
+    format_timestamp(event->timestamp ? event->timestamp : time(NULL),
+                     ts, sizeof(ts));
+
+    buf_puts(out, "{\"timestamp\":\"");
+    buf_puts(out, ts);
+    buf_puts(out, "\",\"level\":\"");
+    buf_puts(out, level_string(event->level));
+    buf_puts(out, "\",\"category\":\"");
+    json_escape(out, event->category);
+    buf_puts(out, "\",\"action\":\"");
+    json_escape(out, event->action);
+    buf_puts(out, "\",\"subject\":\"");
+    json_escape(out, event->subject);
+    buf_puts(out, "\",\"object\":\"");
+    json_escape(out, event->object);
+    buf_puts(out, "\",\"detail\":\"");
+    json_escape(out, event->detail);
+    buf_puts(out, "\",\"allowed\":");
+    buf_puts(out, event->allowed ? "true}\n" : "false}\n");
+}
+
+static void run_sinks(const kelp_audit_event_t *event)
+{
+    for (int i = 0; i < g_audit.sink_count; i++) {
+        if (g_audit.sinks[i].fn) {
+            g_audit.sinks[i].fn(event, g_audit.sinks[i].userdata);
+        }
+    }
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/* ---- async: records ----------------------------------------------------- */
+
+static size_t str_size(const char *s)
+{
+    return s ? strlen(s) + 1 : 0;
+}
+
+static const char *str_copy(char **dst, const char *s)
+{
+    if (!s)
+        return NULL;
+
+    size_t n = strlen(s) + 1;
+    memcpy(*dst, s, n);
+    const char *ret = *dst;
+    *dst += n;
+    return ret;
+}
+
+/** Deep-copy an event into one allocation. */
+static audit_rec_t *rec_new(const kelp_audit_event_t *event)
+{
+    size_t n = str_size(event->category) + str_size(event->action) +
+               str_size(event->subject)  + str_size(event->object) +
+               str_size(event->detail);
+
+    audit_rec_t *rec = malloc(sizeof(*rec) + n);
+    if (!rec)
+        return NULL;
+
+    char *p = rec->strings;
+    rec->ev           = *event;
+    rec->ev.timestamp = event->timestamp ? event->timestamp : time(NULL);
+    rec->ev.category  = str_copy(&p, event->category);
+    rec->ev.action    = str_copy(&p, event->action);
+    rec->ev.subject   = str_copy(&p, event->subject);
+    rec->ev.object    = str_copy(&p, event->object);
+    rec->ev.detail    = str_copy(&p, event->detail);
+    return rec;
+}
+
+/* ---- async: ring -------------------------------------------------------- */
+
+static bool ring_push(audit_rec_t *rec)
+{
+    size_t pos = atomic_load_explicit(&g_audit.tail, memory_order_relaxed);
+
+    for (;;) {
+        ring_cell_t *cell = &g_audit.ring[pos & g_audit.ring_mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_audit.tail, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                cell->rec = rec;
+                atomic_store_explicit(&cell->seq, pos + 1,
+                                      memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;   /* full */
+        } else {
+            pos = atomic_load_explicit(&g_audit.tail, memory_order_relaxed);
+        }
+    }
+}
+
+/** Writer thread only. */
+static audit_rec_t *ring_pop(void)
+{
+    ring_cell_t *cell = &g_audit.ring[g_audit.head & g_audit.ring_mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+    if (seq != g_audit.head + 1)
+        return NULL;
+
+    audit_rec_t *rec = cell->rec;
+    atomic_store_explicit(&cell->seq, g_audit.head + g_audit.ring_mask + 1,
+                          memory_order_release);
+    g_audit.head++;
+    return rec;
+}
+
+static bool ring_empty(void)
+{
+    ring_cell_t *cell = &g_audit.ring[g_audit.head & g_audit.ring_mask];
+    return atomic_load_explicit(&cell->seq, memory_order_acquire) !=
+           g_audit.head + 1;
+}
+
+static void wake_writer(void)
+{
+    /* Pairs with the fence in writer_main(): either we see it asleep or it
+     * sees our push before it sleeps. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&g_audit.writer_sleeping)) {
+        pthread_mutex_lock(&g_audit.wake_mutex);
+        pthread_cond_signal(&g_audit.wake_cond);
+        pthread_mutex_unlock(&g_audit.wake_mutex);
+    }
+}
+
+/* ---- async: file handling (writer thread) ------------------------------- */
+
+/** Shift path.N-1 -> path.N ... path -> path.1. */
+static void shift_files(void)
+{
+    char from[PATH_MAX], to[PATH_MAX];
+    unsigned keep = g_audit.opts.rotate_keep ? g_audit.opts.rotate_keep : 1;
+
+    for (unsigned i = keep; i > 1; i--) {
+        snprintf(from, sizeof(from), "%s.%u", g_audit.path, i - 1);
+        snprintf(to,   sizeof(to),   "%s.%u", g_audit.path, i);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", g_audit.path);
+    rename(g_audit.path, to);
+}
+
+static int open_log(void)
+{
+    if (g_audit.opts.format == KELP_AUDIT_FORMAT_SEGMENT) {
+        /* Carry on with the current segment; only size rotates it. */
+        g_audit.seg = kelp_audit_segment_reopen(g_audit.path);
+        if (!g_audit.seg)
+            return -1;
+        g_audit.fd = kelp_audit_segment_fd(g_audit.seg);
+        g_audit.file_bytes = (off_t)kelp_audit_segment_size(g_audit.seg);
+        return 0;
+    }
+
+    g_audit.fd = open(g_audit.path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                      0600);
+    if (g_audit.fd < 0)
         return -1;
 
+    struct stat st;
+    g_audit.file_bytes = fstat(g_audit.fd, &st) == 0 ? st.st_size : 0;
+    return 0;
+}
+
+static void close_log(void)
+{
+    if (g_audit.seg) {
+        /* Writes the segment's string table and time index. */
+        if (kelp_audit_segment_close(g_audit.seg) != 0)
+            atomic_fetch_add_explicit(&g_audit.write_errors, 1,
+                                      memory_order_relaxed);
+        g_audit.seg = NULL;
+    } else if (g_audit.fd >= 0) {
+        close(g_audit.fd);
+    }
+    g_audit.fd = -1;
+}
+
+static void rotate_log(void)
+{
+    if (!g_audit.seg && g_audit.fd >= 0)
+        fsync(g_audit.fd);
+    close_log();
+    shift_files();
+
+    if (open_log() != 0)
+        KELP_ERROR("audit: cannot reopen log after rotation: %s",
+                   g_audit.path);
+
+    atomic_fetch_add_explicit(&g_audit.rotations, 1, memory_order_relaxed);
+}
+
+static void write_all(struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0 && g_audit.fd >= 0) {
+        ssize_t n = writev(g_audit.fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            atomic_fetch_add_explicit(&g_audit.write_errors, 1,
+                                      memory_order_relaxed);
+            return;
+        }
+
+        g_audit.file_bytes += n;
+
+        /* Skip fully written vectors, trim a partial one. */
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+/* ---- async: writer thread ----------------------------------------------- */
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+
+    size_t batch_max = g_audit.opts.batch_max;
+    audit_rec_t **recs = calloc(batch_max, sizeof(*recs));
+    kelp_buf_t   *lines = calloc(batch_max, sizeof(*lines));
+    struct iovec *iov = calloc(batch_max, sizeof(*iov));
+    if (!recs || !lines || !iov) {
+        KELP_ERROR("audit: writer allocation failed");
+        free(recs);
+        free(lines);
+        free(iov);
+        return NULL;
+    }
+
+    uint64_t since_fsync = 0;
+    uint64_t last_fsync  = now_ms();
+
+    for (;;) {
+        /* ---- collect a batch ---- */
+        size_t n = 0;
+        while (n < batch_max && (recs[n] = ring_pop()) != NULL)
+            n++;
+
+        /* A failed reopen left the log closed: retry once per batch. */
+        if (n > 0 && g_audit.fd < 0) {
+            if (open_log() == 0)
+                KELP_INFO("audit: reopened %s", g_audit.path);
+        }
+
+        bool wrote = false;
+        if (n > 0 && g_audit.fd < 0) {
+            atomic_fetch_add_explicit(&g_audit.write_errors, n,
+                                      memory_order_relaxed);
+        } else if (n > 0 && g_audit.seg) {
+            for (size_t i = 0; i < n; i++)
+                kelp_audit_segment_append(g_audit.seg, &recs[i]->ev);
+            if (kelp_audit_segment_flush(g_audit.seg) != 0)
+                atomic_fetch_add_explicit(&g_audit.write_errors, 1,
+                                          memory_order_relaxed);
+            g_audit.file_bytes = (off_t)kelp_audit_segment_size(g_audit.seg);
+            wrote = true;
+
+            /* Segments only grow by whole batches; rotate once past. */
+            if (g_audit.opts.rotate_bytes &&
+                (size_t)g_audit.file_bytes >= g_audit.opts.rotate_bytes)
+                rotate_log();
+        } else if (n > 0) {
+            size_t bytes = 0;
+            for (size_t i = 0; i < n; i++) {
+                kelp_buf_reset(&lines[i]);
+                format_event(&lines[i], &recs[i]->ev);
+                iov[i].iov_base = lines[i].data;
+                iov[i].iov_len  = lines[i].len;
+                bytes += lines[i].len;
+            }
+
+            if (g_audit.opts.rotate_bytes && g_audit.file_bytes > 0 &&
+                (size_t)g_audit.file_bytes + bytes > g_audit.opts.rotate_bytes)
+                rotate_log();
+
+            if (g_audit.fd < 0) {
+                atomic_fetch_add_explicit(&g_audit.write_errors, n,
+                                          memory_order_relaxed);
+            } else {
+                write_all(iov, (int)n);
+                wrote = true;
+            }
+        }
+
+        if (wrote) {
+            atomic_fetch_add_explicit(&g_audit.written, n,
+                                      memory_order_relaxed);
+            atomic_fetch_add_explicit(&g_audit.batches, 1,
+                                      memory_order_relaxed);
+        }
+        if (n > 0) {
+            since_fsync += n;
+
+            /* Sinks run here, off the callers' hot path. */
+            pthread_mutex_lock(&g_audit.mutex);
+            for (size_t i = 0; i < n; i++)
+                run_sinks(&recs[i]->ev);
+            pthread_mutex_unlock(&g_audit.mutex);
+
+            for (size_t i = 0; i < n; i++)
+                free(recs[i]);
+        }
+
+        /* ---- fsync policy ---- */
+        bool do_fsync = false;
+        switch (g_audit.opts.fsync_policy) {
+        case KELP_AUDIT_FSYNC_NONE:
+            break;
+        case KELP_AUDIT_FSYNC_INTERVAL:
+            do_fsync = since_fsync > 0 &&
+                       now_ms() - last_fsync >= g_audit.opts.fsync_interval_ms;
+            break;
+        case KELP_AUDIT_FSYNC_EVERY_N:
+            do_fsync = since_fsync >= g_audit.opts.fsync_every_n;
+            break;
+        }
+        if (do_fsync && g_audit.fd >= 0) {
+            fdatasync(g_audit.fd);
+            atomic_fetch_add_explicit(&g_audit.fsyncs, 1, memory_order_relaxed);
+            since_fsync = 0;
+            last_fsync  = now_ms();
+        }
+
+        if (n == batch_max)
+            continue;   /* probably more waiting */
+
+        /* ---- idle: report flushes, exit or sleep ---- */
+        pthread_mutex_lock(&g_audit.wake_mutex);
+
+        atomic_store(&g_audit.writer_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ring_empty()) {
+            if (g_audit.flush_done != g_audit.flush_req) {
+                g_audit.flush_done = g_audit.flush_req;
+                pthread_cond_broadcast(&g_audit.idle_cond);
+            }
+
+            if (atomic_load(&g_audit.stopping)) {
+                atomic_store(&g_audit.writer_sleeping, 0);
+                pthread_mutex_unlock(&g_audit.wake_mutex);
+                break;
+            }
+
+            uint64_t wait_ms = AUDIT_IDLE_WAIT_MS;
+            if (g_audit.opts.fsync_policy == KELP_AUDIT_FSYNC_INTERVAL &&
+                since_fsync > 0)
+                wait_ms = g_audit.opts.fsync_interval_ms;
+
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec  += (time_t)(wait_ms / 1000);
+            ts.tv_nsec += (long)(wait_ms % 1000) * 1000000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&g_audit.wake_cond, &g_audit.wake_mutex,
+                                   &ts);
+        }
+        atomic_store(&g_audit.writer_sleeping, 0);
+
+        pthread_mutex_unlock(&g_audit.wake_mutex);
+    }
+
+    if (g_audit.fd >= 0 &&
+        g_audit.opts.fsync_policy != KELP_AUDIT_FSYNC_NONE)
+        fdatasync(g_audit.fd);
+
+    for (size_t i = 0; i < batch_max; i++)
+        kelp_buf_free(&lines[i]);
+    free(lines);
+    free(recs);
+    free(iov);
+    return NULL;
+}
+
+static void async_log(const kelp_audit_event_t *event)
+{
+    audit_rec_t *rec = rec_new(event);
+    if (!rec) {
+        atomic_fetch_add_explicit(&g_audit.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (!ring_push(rec)) {
+        if (g_audit.opts.on_full == KELP_AUDIT_FULL_DROP) {
+            atomic_fetch_add_explicit(&g_audit.dropped, 1,
+                                      memory_order_relaxed);
+            free(rec);
+            wake_writer();
+            return;
+        }
+
+        /* Backpressure: wait for the writer to make room. */
+        atomic_fetch_add_explicit(&g_audit.blocked, 1, memory_order_relaxed);
+        do {
+            wake_writer();
+            struct timespec ts = { 0, AUDIT_BACKPRESSURE_US * 1000L };
+            nanosleep(&ts, NULL);
+        } while (!ring_push(rec));
+    }
+
+    atomic_fetch_add_explicit(&g_audit.enqueued, 1, memory_order_relaxed);
+    wake_writer();
+}
+
+/** Stop the writer thread, draining the ring.  Caller holds g_audit.mutex. */
+static void async_stop(void)
+{
+    /* New callers now bail out; wait for the ones already inside. */
+    atomic_store(&g_audit.mode, AUDIT_MODE_OFF);
+    while (atomic_load(&g_audit.producers) > 0)
+        sched_yield();
+
+    /* The writer takes g_audit.mutex to run sinks; let it. */
+    pthread_mutex_unlock(&g_audit.mutex);
+
+    pthread_mutex_lock(&g_audit.wake_mutex);
+    atomic_store(&g_audit.stopping, 1);
+    pthread_cond_signal(&g_audit.wake_cond);
+    pthread_mutex_unlock(&g_audit.wake_mutex);
+    pthread_join(g_audit.writer, NULL);
+
     pthread_mutex_lock(&g_audit.mutex);
 
-    if (g_audit.initialised && g_audit.fp) {
+    close_log();
+
+    free(g_audit.ring);
+    g_audit.ring = NULL;
+    free(g_audit.path);
+    g_audit.path = NULL;
+    atomic_store(&g_audit.stopping, 0);
+}
+
+static void reset_counters(void)
+{
+    atomic_store(&g_audit.enqueued, 0);
+    atomic_store(&g_audit.written, 0);
+    atomic_store(&g_audit.dropped, 0);
+    atomic_store(&g_audit.blocked, 0);
+    atomic_store(&g_audit.batches, 0);
+    atomic_store(&g_audit.fsyncs, 0);
+    atomic_store(&g_audit.rotations, 0);
+    atomic_store(&g_audit.write_errors, 0);
+}
+
+/** Tear down whichever mode is active.  Caller holds g_audit.mutex. */
+static void close_current(void)
+{
+    if (atomic_load(&g_audit.mode) == AUDIT_MODE_ASYNC)
+        async_stop();
+
+    atomic_store(&g_audit.mode, AUDIT_MODE_OFF);
+
+    if (g_audit.fp) {
+        fflush(g_audit.fp);
         fclose(g_audit.fp);
         g_audit.fp = NULL;
     }
+}
+
+/* ---- public API --------------------------------------------------------- */
+
+int kelp_audit_init(const char *log_path)
+{
+    if (!log_path)
+        return -1;
+
+    pthread_mutex_lock(&g_audit.mutex);
+
+    close_current();
 
     g_audit.fp = fopen(log_path, "a");
     if (!g_audit.fp) {
+        g_audit.initialised = 0;
         pthread_mutex_unlock(&g_audit.mutex);
         KELP_ERROR("audit: cannot open log file: %s", log_path);
         return -1;
@@ -133,6 +712,8 @@ int kelp_audit_init(const char *log_path)
     g_audit.initialised = 1;
     g_audit.min_level   = KELP_AUDIT_INFO;
     g_audit.sink_count  = 0;
+    reset_counters();
+    atomic_store(&g_audit.mode, AUDIT_MODE_SYNC);
 
     pthread_mutex_unlock(&g_audit.mutex);
 
@@ -140,16 +721,89 @@ int kelp_audit_init(const char *log_path)
     return 0;
 }
 
-void kelp_audit_shutdown(void)
+int kelp_audit_init_async(const char *log_path,
+                          const kelp_audit_async_opts_t *opts)
 {
+    if (!log_path)
+        return -1;
+
+    kelp_audit_async_opts_t o = {0};
+    if (opts)
+        o = *opts;
+
+    if (o.ring_size == 0)
+        o.ring_size = AUDIT_DEFAULT_RING;
+    if (o.batch_max == 0)
+        o.batch_max = AUDIT_DEFAULT_BATCH;
+    if (o.batch_max > AUDIT_MAX_BATCH)
+        o.batch_max = AUDIT_MAX_BATCH;
+    if (o.fsync_policy == KELP_AUDIT_FSYNC_INTERVAL &&
+        o.fsync_interval_ms == 0)
+        o.fsync_interval_ms = AUDIT_DEFAULT_FSYNC_MS;
+    if (o.fsync_policy == KELP_AUDIT_FSYNC_EVERY_N && o.fsync_every_n == 0)
+        o.fsync_every_n = 1;
+
+    size_t cap = 2;
+    while (cap < o.ring_size)
+        cap <<= 1;
+    o.ring_size = cap;
+
     pthread_mutex_lock(&g_audit.mutex);
 
-    if (g_audit.fp) {
-        fflush(g_audit.fp);
-        fclose(g_audit.fp);
-        g_audit.fp = NULL;
+    close_current();
+    g_audit.initialised = 0;
+
+    g_audit.opts = o;
+    g_audit.path = strdup(log_path);
+    g_audit.ring = calloc(cap, sizeof(ring_cell_t));
+    if (!g_audit.path || !g_audit.ring || open_log() != 0) {
+        KELP_ERROR("audit: cannot open log file: %s", log_path);
+        free(g_audit.path);
+        free(g_audit.ring);
+        g_audit.path = NULL;
+        g_audit.ring = NULL;
+        pthread_mutex_unlock(&g_audit.mutex);
+        return -1;
     }
 
+    for (size_t i = 0; i < cap; i++)
+        atomic_init(&g_audit.ring[i].seq, i);
+    g_audit.ring_mask = cap - 1;
+    atomic_store(&g_audit.tail, 0);
+    g_audit.head       = 0;
+    g_audit.flush_req  = 0;
+    g_audit.flush_done = 0;
+    g_audit.min_level  = KELP_AUDIT_INFO;
+    g_audit.sink_count = 0;
+    reset_counters();
+
+    if (pthread_create(&g_audit.writer, NULL, writer_main, NULL) != 0) {
+        KELP_ERROR("audit: cannot start writer thread");
+        close_log();
+        free(g_audit.path);
+        free(g_audit.ring);
+        g_audit.path = NULL;
+        g_audit.ring = NULL;
+        pthread_mutex_unlock(&g_audit.mutex);
+        return -1;
+    }
+
+    g_audit.initialised = 1;
+    atomic_store(&g_audit.mode, AUDIT_MODE_ASYNC);
+
+    pthread_mutex_unlock(&g_audit.mutex);
+
+    KELP_INFO("audit: initialised (async, ring=%zu), log_path=%s",
+              cap, log_path);
+    return 0;
+}
+
+void kelp_audit_shutdown(void)
+{
+    pthread_mutex_lock(&g_audit.mutex);
+
+    close_current();
+
     g_audit.initialised = 0;
     g_audit.sink_count  = 0;
 
@@ -163,70 +817,80 @@ void kelp_audit_log(const kelp_audit_event_t *event)
     if (!event)
         return;
 
-    pthread_mutex_lock(&g_audit.mutex);
-
-    if (!g_audit.initialised) {
-        pthread_mutex_unlock(&g_audit.mutex);
+    /* Filter by minimum level before touching anything shared. */
+    if ((int)event->level < atomic_load_explicit(&g_audit.min_level,
+                                                 memory_order_relaxed))
         return;
-    }
 
-    /* Filter by minimum level. */
-    if ((int)event->level < (int)g_audit.min_level) {
-        pthread_mutex_unlock(&g_audit.mutex);
+    /* ---- async: no locks on this path ---- */
+
+    atomic_fetch_add(&g_audit.producers, 1);
+    if (atomic_load(&g_audit.mode) == AUDIT_MODE_ASYNC) {
+        async_log(event);
+        atomic_fetch_sub(&g_audit.producers, 1);
         return;
     }
+    atomic_fetch_sub(&g_audit.producers, 1);
 
-    /* ---- Format JSON line ---- */
+    /* ---- sync ---- */
 
-    char ts[64];
-    format_timestamp(event->timestamp ? event->timestamp : time(NULL),
-                     ts, sizeof(ts));
-
-    /* Escape string fields. */
-    char cat_esc[256]     = "";
-    char action_esc[256]  = "";
-    char subject_esc[512] = "";
-    char object_esc[1024] = "";
-    char detail_esc[2048] = "";
+    pthread_mutex_lock(&g_audit.mutex);
 
-    json_escape(event->category, cat_esc,     sizeof(cat_esc));
-    json_escape(event->action,   action_esc,  sizeof(action_esc));
-    json_escape(event->subject,  subject_esc, sizeof(subject_esc));
-    json_escape(event->object,   object_esc,  sizeof(object_esc));
-    json_escape(event->detail,   detail_esc,  sizeof(detail_esc));
+    if (!g_audit.initialised || atomic_load(&g_audit.mode) != AUDIT_MODE_SYNC) {
+        pthread_mutex_unlock(&g_audit.mutex);
+        return;
+    }
 
     if (g_audit.fp) {
-        fprintf(g_audit.fp,
-                "{\"timestamp\":\"%s\","
-                "\"level\":\"%s\","
-                "\"category\":\"%s\","
-                "\"action\":\"%s\","
-                "\"subject\":\"%s\","
-                "\"object\":\"%s\","
-                "\"detail\":\"%s\","
-                "\"allowed\":%s}\n",
-                ts,
-                level_string(event->level),
-                cat_esc,
-                action_esc,
-                subject_esc,
-                object_esc,
-                detail_esc,
-                event->allowed ? "true" : "false");
+        kelp_buf_t line = kelp_buf_new(512);
+        format_event(&line, event);
+        fwrite(line.data, 1, line.len, g_audit.fp);
         fflush(g_audit.fp);
+        kelp_buf_free(&line);
+        atomic_fetch_add_explicit(&g_audit.written, 1, memory_order_relaxed);
     }
 
     /* ---- Dispatch to registered sinks ---- */
 
-    for (int i = 0; i < g_audit.sink_count; i++) {
-        if (g_audit.sinks[i].fn) {
-            g_audit.sinks[i].fn(event, g_audit.sinks[i].userdata);
-        }
-    }
+    run_sinks(event);
 
     pthread_mutex_unlock(&g_audit.mutex);
 }
 
+void kelp_audit_flush(void)
+{
+    if (atomic_load(&g_audit.mode) != AUDIT_MODE_ASYNC) {
+        pthread_mutex_lock(&g_audit.mutex);
+        if (g_audit.fp)
+            fflush(g_audit.fp);
+        pthread_mutex_unlock(&g_audit.mutex);
+        return;
+    }
+
+    pthread_mutex_lock(&g_audit.wake_mutex);
+    uint64_t ticket = ++g_audit.flush_req;
+    pthread_cond_signal(&g_audit.wake_cond);
+    while (g_audit.flush_done < ticket &&
+           atomic_load(&g_audit.mode) == AUDIT_MODE_ASYNC)
+        pthread_cond_wait(&g_audit.idle_cond, &g_audit.wake_mutex);
+    pthread_mutex_unlock(&g_audit.wake_mutex);
+}
+
+void kelp_audit_get_stats(kelp_audit_stats_t *out)
+{
+    if (!out)
+        return;
+
+    out->enqueued     = atomic_load_explicit(&g_audit.enqueued, memory_order_relaxed);
+    out->written      = atomic_load_explicit(&g_audit.written, memory_order_relaxed);
+    out->dropped      = atomic_load_explicit(&g_audit.dropped, memory_order_relaxed);
+    out->blocked      = atomic_load_explicit(&g_audit.blocked, memory_order_relaxed);
+    out->batches      = atomic_load_explicit(&g_audit.batches, memory_order_relaxed);
+    out->fsyncs       = atomic_load_explicit(&g_audit.fsyncs, memory_order_relaxed);
+    out->rotations    = atomic_load_explicit(&g_audit.rotations, memory_order_relaxed);
+    out->write_errors = atomic_load_explicit(&g_audit.write_errors, memory_order_relaxed);
+}
+
 int kelp_audit_add_sink(kelp_audit_sink_t sink, void *userdata)
 {
     if (!sink)
@@ -251,7 +915,6 @@ int kelp_audit_add_sink(kelp_audit_sink_t sink, void *userdata)
 
 void kelp_audit_set_min_level(kelp_audit_level_t level)
 {
-    pthread_mutex_lock(&g_audit.mutex);
-    g_audit.min_level = level;
-    pthread_mutex_unlock(&g_audit.mutex);
+    atomic_store_explicit(&g_audit.min_level, (int)level,
+                          memory_order_relaxed);
 }
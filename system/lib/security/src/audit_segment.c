@@ -0,0 +1,1103 @@
+/*
+ * kelp-linux :: libkelp-security
+ * audit_segment.c - Compact binary audit log segments
+ *
+ * On-disk layout (all fixed-width integers little-endian):
+ *
+ *   header   0  "KAUDSEG1"
+ *            8  u32 version
+ *           12  u32 flags (0)
+ *           16  i64 base time; event timestamps are stored relative to it
+ *           24  u64 reserved
+ *
+ *   record   varint body length, then the body:
+ *              'S' varint id, string bytes           (interned string)
+ *              'E' varint zigzag(ts - base)          (event)
+ *                  u8     level | allowed << 3 | has_detail << 4
+ *                  varint category id, varint action id  (0 = none)
+ *                  varint len + subject, varint len + object
+ *                  [varint len + detail]
+ *
+ *   footer   string table  varint len + bytes, for ids 1..n
+ *            time index    32-byte entries: i64 min ts, i64 max ts,
+ *                          u64 offset of the block's first record,
+ *                          u32 events, u32 reserved
+ *            trailer       u64 string table offset, u64 index offset,
+ *                          u64 events, u32 strings, u32 index entries,
+ *                          u64 reserved, "KAUDIDX1"
+ *
+ * Every string is defined by an 'S' record before its first use, so a
+ * segment without a footer can still be decoded front to back.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/audit_segment.h>
+#include <kelp/buf.h>
+#include <kelp/log.h>
+#include <kelp/map.h>
+
+#include <cjson/cJSON.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ---- format constants --------------------------------------------------- */
+
+#define SEG_MAGIC           "KAUDSEG1"
+#define SEG_INDEX_MAGIC     "KAUDIDX1"
+#define SEG_VERSION         1
+#define SEG_HEADER_SIZE     32
+#define SEG_TRAILER_SIZE    48
+#define SEG_INDEX_ENTRY     32
+#define SEG_BLOCK_EVENTS    256
+
+#define REC_STRING          'S'
+#define REC_EVENT           'E'
+
+#define FLAG_LEVEL_MASK     0x07
+#define FLAG_ALLOWED        0x08
+#define FLAG_HAS_DETAIL     0x10
+
+/* ---- internal types ----------------------------------------------------- */
+
+typedef struct {
+    int64_t  min_ts;
+    int64_t  max_ts;
+    uint64_t offset;
+    uint32_t count;
+} seg_block_t;
+
+struct kelp_audit_segment_writer {
+    int          fd;
+    size_t       file_bytes;     /* bytes already written to fd */
+    kelp_buf_t   pending;        /* encoded, not yet written    */
+    kelp_buf_t   body;           /* scratch for one record      */
+    int64_t      base_time;
+
+    kelp_map_t  *ids;            /* string -> id                */
+    char       **strings;        /* id - 1 -> string            */
+    size_t       nstrings;
+    size_t       cap_strings;
+
+    seg_block_t *blocks;
+    size_t       nblocks;
+    size_t       cap_blocks;
+    seg_block_t  cur;
+
+    uint64_t     events;
+    bool         failed;
+};
+
+typedef struct {
+    const uint8_t *ptr;
+    size_t         len;
+} seg_str_t;
+
+struct kelp_audit_segment {
+    const uint8_t *base;
+    size_t         size;
+    int64_t        base_time;
+    size_t         records_end;
+    bool           indexed;
+    bool           damaged;      /* a bad record before the end of file */
+
+    seg_str_t     *strings;      /* id - 1 -> bytes in the mapping */
+    size_t         nstrings;
+
+    seg_block_t   *blocks;
+    size_t         nblocks;
+
+    uint64_t       events;
+    int64_t        min_ts;
+    int64_t        max_ts;
+};
+
+/* ---- encoding helpers --------------------------------------------------- */
+
+static void put_varint(kelp_buf_t *b, uint64_t v)
+{
+    uint8_t tmp[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        tmp[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    tmp[n++] = (uint8_t)v;
+    kelp_buf_write(b, tmp, n);
+}
+
+static void put_u32(kelp_buf_t *b, uint32_t v)
+{
+    uint8_t tmp[4];
+    for (int i = 0; i < 4; i++)
+        tmp[i] = (uint8_t)(v >> (8 * i));
+    kelp_buf_write(b, tmp, 4);
+}
+
+static void put_u64(kelp_buf_t *b, uint64_t v)
+{
+    uint8_t tmp[8];
+    for (int i = 0; i < 8; i++)
+        tmp[i] = (uint8_t)(v >> (8 * i));
+    kelp_buf_write(b, tmp, 8);
+}
+
+static void put_str(kelp_buf_t *b, const char *s)
+{
+    size_t n = s ? strlen(s) : 0;
+    put_varint(b, n);
+    kelp_buf_write(b, s, n);
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* ---- decoding helpers --------------------------------------------------- */
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *out)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*p >= end)
+            return false;
+        uint8_t byte = *(*p)++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_bytes(const uint8_t **p, const uint8_t *end,
+                      const uint8_t **ptr, size_t *len)
+{
+    uint64_t n;
+    if (!get_varint(p, end, &n) || n > (uint64_t)(end - *p))
+        return false;
+    *ptr = *p;
+    *len = (size_t)n;
+    *p += n;
+    return true;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+/* ---- writer ------------------------------------------------------------- */
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/** Emit the body as a record: varint length + bytes. */
+static void emit_body(kelp_audit_segment_writer_t *w)
+{
+    put_varint(&w->pending, w->body.len);
+    kelp_buf_write(&w->pending, w->body.data, w->body.len);
+    kelp_buf_reset(&w->body);
+}
+
+/** Return the id for `s`, defining it first if new.  NULL -> 0. */
+static uint64_t intern(kelp_audit_segment_writer_t *w, const char *s)
+{
+    if (!s)
+        return 0;
+
+    void *found = kelp_map_get(w->ids, s);
+    if (found)
+        return (uint64_t)(uintptr_t)found;
+
+    if (w->nstrings == w->cap_strings) {
+        size_t cap = w->cap_strings ? w->cap_strings * 2 : 16;
+        char **tmp = realloc(w->strings, cap * sizeof(*tmp));
+        if (!tmp)
+            return 0;
+        w->strings     = tmp;
+        w->cap_strings = cap;
+    }
+
+    char *copy = strdup(s);
+    if (!copy)
+        return 0;
+
+    uint64_t id = w->nstrings + 1;
+    if (kelp_map_set(w->ids, s, (void *)(uintptr_t)id) != 0) {
+        free(copy);
+        return 0;
+    }
+    w->strings[w->nstrings++] = copy;
+
+    uint8_t type = REC_STRING;
+    kelp_buf_write(&w->body, &type, 1);
+    put_varint(&w->body, id);
+    kelp_buf_write(&w->body, s, strlen(s));
+    emit_body(w);
+
+    return id;
+}
+
+static int push_block(kelp_audit_segment_writer_t *w)
+{
+    if (w->cur.count == 0)
+        return 0;
+
+    if (w->nblocks == w->cap_blocks) {
+        size_t cap = w->cap_blocks ? w->cap_blocks * 2 : 16;
+        seg_block_t *tmp = realloc(w->blocks, cap * sizeof(*tmp));
+        if (!tmp)
+            return -1;
+        w->blocks     = tmp;
+        w->cap_blocks = cap;
+    }
+    w->blocks[w->nblocks++] = w->cur;
+    memset(&w->cur, 0, sizeof(w->cur));
+    return 0;
+}
+
+kelp_audit_segment_writer_t *kelp_audit_segment_create(const char *path)
+{
+    if (!path)
+        return NULL;
+
+    kelp_audit_segment_writer_t *w = calloc(1, sizeof(*w));
+    if (!w)
+        return NULL;
+
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    w->ids = kelp_map_new();
+    w->pending = kelp_buf_new(64 * 1024);
+    w->body = kelp_buf_new(512);
+    w->base_time = (int64_t)time(NULL);
+
+    if (w->fd < 0 || !w->ids) {
+        KELP_ERROR("audit: cannot create segment %s: %s", path,
+                   strerror(errno));
+        if (w->fd >= 0)
+            close(w->fd);
+        kelp_map_free(w->ids);
+        kelp_buf_free(&w->pending);
+        kelp_buf_free(&w->body);
+        free(w);
+        return NULL;
+    }
+
+    kelp_buf_write(&w->pending, SEG_MAGIC, 8);
+    put_u32(&w->pending, SEG_VERSION);
+    put_u32(&w->pending, 0);
+    put_u64(&w->pending, (uint64_t)w->base_time);
+    put_u64(&w->pending, 0);
+
+    return w;
+}
+
+int kelp_audit_segment_append(kelp_audit_segment_writer_t *w,
+                              const kelp_audit_event_t *event)
+{
+    if (!w || !event)
+        return -1;
+
+    int64_t ts = event->timestamp ? (int64_t)event->timestamp
+                                  : (int64_t)time(NULL);
+
+    if (w->cur.count == 0) {
+        w->cur.offset = kelp_audit_segment_size(w);
+        w->cur.min_ts = ts;
+        w->cur.max_ts = ts;
+    }
+
+    uint64_t cat = intern(w, event->category);
+    uint64_t act = intern(w, event->action);
+
+    uint8_t flags = (uint8_t)(event->level & FLAG_LEVEL_MASK);
+    if (event->allowed)
+        flags |= FLAG_ALLOWED;
+    if (event->detail)
+        flags |= FLAG_HAS_DETAIL;
+
+    uint8_t type = REC_EVENT;
+    kelp_buf_write(&w->body, &type, 1);
+    put_varint(&w->body, zigzag(ts - w->base_time));
+    kelp_buf_write(&w->body, &flags, 1);
+    put_varint(&w->body, cat);
+    put_varint(&w->body, act);
+    put_str(&w->body, event->subject);
+    put_str(&w->body, event->object);
+    if (event->detail)
+        put_str(&w->body, event->detail);
+    emit_body(w);
+
+    if (ts < w->cur.min_ts)
+        w->cur.min_ts = ts;
+    if (ts > w->cur.max_ts)
+        w->cur.max_ts = ts;
+    w->cur.count++;
+    w->events++;
+
+    if (w->cur.count == SEG_BLOCK_EVENTS && push_block(w) != 0)
+        w->failed = true;
+
+    return 0;
+}
+
+int kelp_audit_segment_flush(kelp_audit_segment_writer_t *w)
+{
+    if (!w)
+        return -1;
+    if (w->pending.len == 0)
+        return 0;
+
+    if (write_all(w->fd, w->pending.data, w->pending.len) != 0) {
+        w->failed = true;
+        return -1;
+    }
+    w->file_bytes += w->pending.len;
+    kelp_buf_reset(&w->pending);
+    return 0;
+}
+
+size_t kelp_audit_segment_size(const kelp_audit_segment_writer_t *w)
+{
+    return w ? w->file_bytes + w->pending.len : 0;
+}
+
+int kelp_audit_segment_fd(const kelp_audit_segment_writer_t *w)
+{
+    return w ? w->fd : -1;
+}
+
+int kelp_audit_segment_close(kelp_audit_segment_writer_t *w)
+{
+    if (!w)
+        return -1;
+
+    if (push_block(w) != 0)
+        w->failed = true;
+
+    /* ---- string table ---- */
+
+    uint64_t strtab_off = kelp_audit_segment_size(w);
+    for (size_t i = 0; i < w->nstrings; i++)
+        put_str(&w->pending, w->strings[i]);
+
+    /* ---- time index ---- */
+
+    uint64_t index_off = kelp_audit_segment_size(w);
+    for (size_t i = 0; i < w->nblocks; i++) {
+        put_u64(&w->pending, (uint64_t)w->blocks[i].min_ts);
+        put_u64(&w->pending, (uint64_t)w->blocks[i].max_ts);
+        put_u64(&w->pending, w->blocks[i].offset);
+        put_u32(&w->pending, w->blocks[i].count);
+        put_u32(&w->pending, 0);
+    }
+
+    /* ---- trailer ---- */
+
+    put_u64(&w->pending, strtab_off);
+    put_u64(&w->pending, index_off);
+    put_u64(&w->pending, w->events);
+    put_u32(&w->pending, (uint32_t)w->nstrings);
+    put_u32(&w->pending, (uint32_t)w->nblocks);
+    put_u64(&w->pending, 0);
+    kelp_buf_write(&w->pending, SEG_INDEX_MAGIC, 8);
+
+    int rc = kelp_audit_segment_flush(w);
+    if (fsync(w->fd) != 0)
+        rc = -1;
+    if (close(w->fd) != 0)
+        rc = -1;
+    if (w->failed)
+        rc = -1;
+
+    for (size_t i = 0; i < w->nstrings; i++)
+        free(w->strings[i]);
+    free(w->strings);
+    free(w->blocks);
+    kelp_map_free(w->ids);
+    kelp_buf_free(&w->pending);
+    kelp_buf_free(&w->body);
+    free(w);
+    return rc;
+}
+
+/* ---- reader ------------------------------------------------------------- */
+
+static int add_string(kelp_audit_segment_t *seg, size_t *cap, uint64_t id,
+                      const uint8_t *ptr, size_t len)
+{
+    /* Ids are assigned densely; anything else means corruption. */
+    if (id != seg->nstrings + 1)
+        return -1;
+
+    if (seg->nstrings == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 16;
+        seg_str_t *tmp = realloc(seg->strings, ncap * sizeof(*tmp));
+        if (!tmp)
+            return -1;
+        seg->strings = tmp;
+        *cap = ncap;
+    }
+    seg->strings[seg->nstrings].ptr = ptr;
+    seg->strings[seg->nstrings].len = len;
+    seg->nstrings++;
+    return 0;
+}
+
+/** Load the footer.  Returns false if there is none or it is inconsistent. */
+static bool load_footer(kelp_audit_segment_t *seg)
+{
+    if (seg->size < SEG_HEADER_SIZE + SEG_TRAILER_SIZE)
+        return false;
+
+    const uint8_t *t = seg->base + seg->size - SEG_TRAILER_SIZE;
+    if (memcmp(t + 40, SEG_INDEX_MAGIC, 8) != 0)
+        return false;
+
+    uint64_t strtab_off = get_u64(t);
+    uint64_t index_off  = get_u64(t + 8);
+    uint64_t events     = get_u64(t + 16);
+    uint32_t nstrings   = get_u32(t + 24);
+    uint32_t nblocks    = get_u32(t + 28);
+
+    if (strtab_off < SEG_HEADER_SIZE || strtab_off > index_off ||
+        index_off + (uint64_t)nblocks * SEG_INDEX_ENTRY !=
+            seg->size - SEG_TRAILER_SIZE)
+        return false;
+
+    size_t cap = 0;
+    const uint8_t *p   = seg->base + strtab_off;
+    const uint8_t *end = seg->base + index_off;
+    for (uint32_t i = 0; i < nstrings; i++) {
+        const uint8_t *s;
+        size_t len;
+        if (!get_bytes(&p, end, &s, &len) ||
+            add_string(seg, &cap, i + 1, s, len) != 0)
+            goto bad;
+    }
+
+    seg->blocks = calloc(nblocks ? nblocks : 1, sizeof(seg_block_t));
+    if (!seg->blocks)
+        goto bad;
+
+    seg->min_ts = INT64_MAX;
+    seg->max_ts = INT64_MIN;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint8_t *e = seg->base + index_off + (size_t)i * SEG_INDEX_ENTRY;
+        seg_block_t *b = &seg->blocks[i];
+        b->min_ts = (int64_t)get_u64(e);
+        b->max_ts = (int64_t)get_u64(e + 8);
+        b->offset = get_u64(e + 16);
+        b->count  = get_u32(e + 24);
+        if (b->offset < SEG_HEADER_SIZE || b->offset > strtab_off ||
+            (i > 0 && b->offset < seg->blocks[i - 1].offset))
+            goto bad;
+        if (b->min_ts < seg->min_ts)
+            seg->min_ts = b->min_ts;
+        if (b->max_ts > seg->max_ts)
+            seg->max_ts = b->max_ts;
+    }
+
+    seg->nblocks     = nblocks;
+    seg->events      = events;
+    seg->records_end = (size_t)strtab_off;
+    seg->indexed     = true;
+    return true;
+
+bad:
+    free(seg->strings);
+    free(seg->blocks);
+    seg->strings  = NULL;
+    seg->blocks   = NULL;
+    seg->nstrings = 0;
+    return false;
+}
+
+/**
+ * Could the bad record at `p` be the last one, cut short by a crash?  Its
+ * length or body must run past EOF, or the rest be the zero fill some
+ * filesystems leave behind.
+ */
+static bool tail_is_torn(const uint8_t *p, const uint8_t *end)
+{
+    const uint8_t *q = p;
+    uint64_t n;
+    if (!get_varint(&q, end, &n))
+        return q >= end;
+    if (n > (uint64_t)(end - q))
+        return true;
+    for (; p < end; p++) {
+        if (*p)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * No footer: walk the records, collecting strings and totals.  Stops
+ * quietly at the first bad record, flagging the segment as damaged unless
+ * that record is a torn tail.
+ */
+static void scan_unindexed(kelp_audit_segment_t *seg)
+{
+    size_t cap = 0;
+    const uint8_t *p   = seg->base + SEG_HEADER_SIZE;
+    const uint8_t *end = seg->base + seg->size;
+
+    seg->min_ts = INT64_MAX;
+    seg->max_ts = INT64_MIN;
+
+    while (p < end) {
+        const uint8_t *rec_start = p;
+        const uint8_t *body;
+        size_t len;
+        if (!get_bytes(&p, end, &body, &len) || len == 0) {
+            p = rec_start;
+            break;
+        }
+
+        const uint8_t *q = body + 1, *qend = body + len;
+        uint64_t v;
+        if (body[0] == REC_STRING) {
+            if (!get_varint(&q, qend, &v) ||
+                add_string(seg, &cap, v, q, (size_t)(qend - q)) != 0) {
+                p = rec_start;
+                break;
+            }
+        } else if (body[0] == REC_EVENT) {
+            if (!get_varint(&q, qend, &v)) {
+                p = rec_start;
+                break;
+            }
+            int64_t ts = seg->base_time + unzigzag(v);
+            if (ts < seg->min_ts)
+                seg->min_ts = ts;
+            if (ts > seg->max_ts)
+                seg->max_ts = ts;
+            seg->events++;
+        }
+    }
+
+    seg->records_end = (size_t)(p - seg->base);
+    seg->damaged     = p < end && !tail_is_torn(p, end);
+
+    /* The whole file is one block. */
+    seg->blocks = calloc(1, sizeof(seg_block_t));
+    if (seg->blocks) {
+        seg->blocks[0].min_ts = seg->min_ts;
+        seg->blocks[0].max_ts = seg->max_ts;
+        seg->blocks[0].offset = SEG_HEADER_SIZE;
+        seg->blocks[0].count  = (uint32_t)seg->events;
+        seg->nblocks = seg->events ? 1 : 0;
+    }
+}
+
+kelp_audit_segment_t *kelp_audit_segment_open(const char *path)
+{
+    if (!path)
+        return NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SEG_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    const uint8_t *base = map;
+    if (memcmp(base, SEG_MAGIC, 8) != 0 || get_u32(base + 8) != SEG_VERSION) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    kelp_audit_segment_t *seg = calloc(1, sizeof(*seg));
+    if (!seg) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    seg->base      = base;
+    seg->size      = (size_t)st.st_size;
+    seg->base_time = (int64_t)get_u64(base + 16);
+
+    /* Records are read front to back, blocks in order. */
+    madvise(map, seg->size, MADV_SEQUENTIAL);
+
+    if (!load_footer(seg))
+        scan_unindexed(seg);
+
+    return seg;
+}
+
+void kelp_audit_segment_free(kelp_audit_segment_t *seg)
+{
+    if (!seg)
+        return;
+    munmap((void *)seg->base, seg->size);
+    free(seg->strings);
+    free(seg->blocks);
+    free(seg);
+}
+
+void kelp_audit_segment_info(const kelp_audit_segment_t *seg,
+                             kelp_audit_segment_info_t *out)
+{
+    if (!out)
+        return;
+    memset(out, 0, sizeof(*out));
+    if (!seg)
+        return;
+
+    out->events  = seg->events;
+    out->strings = seg->nstrings;
+    out->blocks  = seg->nblocks;
+    out->indexed = seg->indexed;
+    if (seg->events) {
+        out->min_time = (time_t)seg->min_ts;
+        out->max_time = (time_t)seg->max_ts;
+    }
+}
+
+/** Find the id of an interned string; 0 if the segment never uses it. */
+static uint64_t find_string(const kelp_audit_segment_t *seg, const char *s)
+{
+    size_t n = strlen(s);
+    for (size_t i = 0; i < seg->nstrings; i++) {
+        if (seg->strings[i].len == n &&
+            memcmp(seg->strings[i].ptr, s, n) == 0)
+            return i + 1;
+    }
+    return 0;
+}
+
+/** Append `len` bytes plus a NUL to `b`; returns the offset. */
+static size_t scratch_put(kelp_buf_t *b, const uint8_t *ptr, size_t len)
+{
+    size_t off = b->len;
+    kelp_buf_write(b, ptr, len);
+    kelp_buf_write(b, "", 1);
+    return off;
+}
+
+static size_t scratch_id(kelp_buf_t *b, const kelp_audit_segment_t *seg,
+                         uint64_t id)
+{
+    if (id == 0 || id > seg->nstrings)
+        return SIZE_MAX;
+    return scratch_put(b, seg->strings[id - 1].ptr, seg->strings[id - 1].len);
+}
+
+long kelp_audit_segment_query(kelp_audit_segment_t *seg,
+                              const kelp_audit_query_t *q,
+                              kelp_audit_query_cb cb, void *userdata)
+{
+    if (!seg)
+        return -1;
+
+    kelp_audit_query_t all = { .allowed = -1 };
+    if (!q)
+        q = &all;
+
+    uint64_t cat_id = 0;
+    if (q->category) {
+        cat_id = find_string(seg, q->category);
+        if (cat_id == 0)
+            return 0;
+    }
+
+    size_t subj_len = q->subject ? strlen(q->subject) : 0;
+    int64_t since = q->since ? (int64_t)q->since : INT64_MIN;
+    int64_t until = q->until ? (int64_t)q->until : INT64_MAX;
+
+    kelp_buf_t scratch = kelp_buf_new(1024);
+    long matched = 0;
+    bool stop = false;
+
+    for (size_t bi = 0; bi < seg->nblocks && !stop; bi++) {
+        const seg_block_t *blk = &seg->blocks[bi];
+        if (blk->max_ts < since || blk->min_ts > until)
+            continue;
+
+        const uint8_t *p   = seg->base + blk->offset;
+        const uint8_t *end = seg->base + (bi + 1 < seg->nblocks
+                                          ? seg->blocks[bi + 1].offset
+                                          : seg->records_end);
+
+        while (p < end && !stop) {
+            const uint8_t *body;
+            size_t len;
+            if (!get_bytes(&p, end, &body, &len) || len == 0) {
+                kelp_buf_free(&scratch);
+                return -1;
+            }
+            if (body[0] != REC_EVENT)
+                continue;
+
+            const uint8_t *r = body + 1, *rend = body + len;
+            uint64_t zz, cat, act;
+
+            /* Cheapest rejections first; `continue` skips the rest. */
+            if (!get_varint(&r, rend, &zz))
+                goto corrupt;
+            int64_t ts = seg->base_time + unzigzag(zz);
+            if (ts < since || ts > until)
+                continue;
+
+            if (r >= rend)
+                goto corrupt;
+            uint8_t flags = *r++;
+            int level = flags & FLAG_LEVEL_MASK;
+            bool allowed = (flags & FLAG_ALLOWED) != 0;
+            if (level < (int)q->min_level)
+                continue;
+            if (q->allowed >= 0 && allowed != (q->allowed != 0))
+                continue;
+
+            if (!get_varint(&r, rend, &cat))
+                goto corrupt;
+            if (cat_id && cat != cat_id)
+                continue;
+            if (!get_varint(&r, rend, &act))
+                goto corrupt;
+
+            const uint8_t *subj, *obj, *det = NULL;
+            size_t subj_n, obj_n, det_n = 0;
+            if (!get_bytes(&r, rend, &subj, &subj_n))
+                goto corrupt;
+            if (q->subject &&
+                (subj_n != subj_len || memcmp(subj, q->subject, subj_n) != 0))
+                continue;
+            if (!get_bytes(&r, rend, &obj, &obj_n))
+                goto corrupt;
+            if ((flags & FLAG_HAS_DETAIL) &&
+                !get_bytes(&r, rend, &det, &det_n))
+                goto corrupt;
+
+            matched++;
+            if (!cb)
+                continue;
+
+            kelp_buf_reset(&scratch);
+            size_t o_cat  = scratch_id(&scratch, seg, cat);
+            size_t o_act  = scratch_id(&scratch, seg, act);
+            size_t o_subj = scratch_put(&scratch, subj, subj_n);
+            size_t o_obj  = scratch_put(&scratch, obj, obj_n);
+            size_t o_det  = det ? scratch_put(&scratch, det, det_n) : SIZE_MAX;
+
+            const char *s = (const char *)scratch.data;
+            kelp_audit_event_t ev = {
+                .level     = (kelp_audit_level_t)level,
+                .timestamp = (time_t)ts,
+                .category  = o_cat  == SIZE_MAX ? NULL : s + o_cat,
+                .action    = o_act  == SIZE_MAX ? NULL : s + o_act,
+                .subject   = s + o_subj,
+                .object    = s + o_obj,
+                .detail    = o_det  == SIZE_MAX ? NULL : s + o_det,
+                .allowed   = allowed,
+            };
+            if (cb(&ev, userdata) != 0)
+                stop = true;
+        }
+    }
+
+    kelp_buf_free(&scratch);
+    return matched;
+
+corrupt:
+    kelp_buf_free(&scratch);
+    return -1;
+}
+
+/* ---- reopening ---------------------------------------------------------- */
+
+/** Adopt an interned string of an existing segment, without a record. */
+static int adopt_string(kelp_audit_segment_writer_t *w, const seg_str_t *str)
+{
+    if (w->nstrings == w->cap_strings) {
+        size_t cap = w->cap_strings ? w->cap_strings * 2 : 16;
+        char **tmp = realloc(w->strings, cap * sizeof(*tmp));
+        if (!tmp)
+            return -1;
+        w->strings     = tmp;
+        w->cap_strings = cap;
+    }
+
+    char *copy = strndup((const char *)str->ptr, str->len);
+    if (!copy)
+        return -1;
+    if (kelp_map_set(w->ids, copy,
+                     (void *)(uintptr_t)(w->nstrings + 1)) != 0) {
+        free(copy);
+        return -1;
+    }
+    w->strings[w->nstrings++] = copy;
+    return 0;
+}
+
+/**
+ * Move a damaged segment out of the way, to `path.damaged.N`, never
+ * replacing an earlier one.
+ */
+static int set_aside(const char *path)
+{
+    char aside[PATH_MAX];
+    for (unsigned i = 1; i < 1000; i++) {
+        snprintf(aside, sizeof(aside), "%s.damaged.%u", path, i);
+        if (link(path, aside) == 0) {
+            KELP_WARN("audit: %s is damaged mid-file, kept as %s",
+                      path, aside);
+            return unlink(path);
+        }
+        if (errno != EEXIST)
+            return -1;
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+kelp_audit_segment_writer_t *kelp_audit_segment_reopen(const char *path)
+{
+    if (!path)
+        return NULL;
+
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size == 0)
+        return kelp_audit_segment_create(path);
+
+    kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+    if (!seg) {
+        KELP_ERROR("audit: %s exists but is not a segment", path);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* Records after the damage may still be good: keep them all. */
+    if (seg->damaged) {
+        kelp_audit_segment_free(seg);
+        if (set_aside(path) != 0) {
+            KELP_ERROR("audit: cannot set damaged segment %s aside: %s",
+                       path, strerror(errno));
+            return NULL;
+        }
+        return kelp_audit_segment_create(path);
+    }
+
+    kelp_audit_segment_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        kelp_audit_segment_free(seg);
+        return NULL;
+    }
+
+    w->fd = open(path, O_WRONLY | O_CLOEXEC);
+    w->ids = kelp_map_new();
+    w->pending = kelp_buf_new(64 * 1024);
+    w->body = kelp_buf_new(512);
+    w->base_time  = seg->base_time;
+    w->file_bytes = seg->records_end;
+    w->events     = seg->events;
+
+    bool ok = w->fd >= 0 && w->ids;
+    for (size_t i = 0; ok && i < seg->nstrings; i++)
+        ok = adopt_string(w, &seg->strings[i]) == 0;
+    if (ok && seg->nblocks) {
+        w->blocks = malloc(seg->nblocks * sizeof(*w->blocks));
+        ok = w->blocks != NULL;
+        if (ok) {
+            memcpy(w->blocks, seg->blocks, seg->nblocks * sizeof(*w->blocks));
+            w->nblocks = w->cap_blocks = seg->nblocks;
+        }
+    }
+
+    /* New records go where the footer (or a torn record) started. */
+    ok = ok && ftruncate(w->fd, (off_t)seg->records_end) == 0 &&
+         lseek(w->fd, 0, SEEK_END) == (off_t)seg->records_end;
+    kelp_audit_segment_free(seg);
+
+    if (!ok) {
+        KELP_ERROR("audit: cannot reopen segment %s: %s", path,
+                   strerror(errno));
+        if (w->fd >= 0)
+            close(w->fd);
+        for (size_t i = 0; i < w->nstrings; i++)
+            free(w->strings[i]);
+        free(w->strings);
+        free(w->blocks);
+        kelp_map_free(w->ids);
+        kelp_buf_free(&w->pending);
+        kelp_buf_free(&w->body);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+/* ---- conversion --------------------------------------------------------- */
+
+int kelp_audit_parse_time(const char *text, time_t *out)
+{
+    if (!text || !*text || !out)
+        return -1;
+
+    char *end;
+    errno = 0;
+    long long secs = strtoll(text, &end, 10);
+    if (errno == 0 && *end == '\0') {
+        *out = (time_t)secs;
+        return 0;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *rest = strptime(text, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (!rest) {
+        memset(&tm, 0, sizeof(tm));
+        rest = strptime(text, "%Y-%m-%d", &tm);
+    }
+    if (!rest || (*rest != '\0' && strcmp(rest, "Z") != 0))
+        return -1;
+
+    *out = timegm(&tm);
+    return 0;
+}
+
+static kelp_audit_level_t parse_level(const char *s)
+{
+    if (s) {
+        if (strcmp(s, "warn") == 0)      return KELP_AUDIT_WARN;
+        if (strcmp(s, "alert") == 0)     return KELP_AUDIT_ALERT;
+        if (strcmp(s, "violation") == 0) return KELP_AUDIT_VIOLATION;
+    }
+    return KELP_AUDIT_INFO;
+}
+
+static const char *json_str(const cJSON *obj, const char *key)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+int kelp_audit_jsonl_to_segment(const char *jsonl_path,
+                                const char *segment_path,
+                                size_t *converted, size_t *skipped)
+{
+    if (!jsonl_path || !segment_path)
+        return -1;
+
+    FILE *in = fopen(jsonl_path, "r");
+    if (!in) {
+        KELP_ERROR("audit: cannot open %s: %s", jsonl_path, strerror(errno));
+        return -1;
+    }
+
+    kelp_audit_segment_writer_t *w = kelp_audit_segment_create(segment_path);
+    if (!w) {
+        fclose(in);
+        return -1;
+    }
+
+    size_t n_ok = 0, n_bad = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int rc = 0;
+
+    while ((len = getline(&line, &cap, in)) > 0) {
+        cJSON *obj = cJSON_Parse(line);
+        const char *ts_str = obj ? json_str(obj, "timestamp") : NULL;
+        time_t ts;
+
+        if (!cJSON_IsObject(obj) || !ts_str ||
+            kelp_audit_parse_time(ts_str, &ts) != 0) {
+            n_bad++;
+            cJSON_Delete(obj);
+            continue;
+        }
+
+        /* The JSONL writer emits "" for absent details. */
+        const char *detail = json_str(obj, "detail");
+        if (detail && !*detail)
+            detail = NULL;
+
+        kelp_audit_event_t ev = {
+            .level     = parse_level(json_str(obj, "level")),
+            .timestamp = ts,
+            .category  = json_str(obj, "category"),
+            .action    = json_str(obj, "action"),
+            .subject   = json_str(obj, "subject"),
+            .object    = json_str(obj, "object"),
+            .detail    = detail,
+            .allowed   = cJSON_IsTrue(
+                cJSON_GetObjectItemCaseSensitive(obj, "allowed")),
+        };
+        kelp_audit_segment_append(w, &ev);
+        n_ok++;
+        cJSON_Delete(obj);
+
+        /* Keep memory flat on multi-gigabyte logs. */
+        if (kelp_audit_segment_size(w) - w->file_bytes > 1024 * 1024 &&
+            kelp_audit_segment_flush(w) != 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(in);
+
+    if (kelp_audit_segment_close(w) != 0)
+        rc = -1;
+
+    if (converted)
+        *converted = n_ok;
+    if (skipped)
+        *skipped = n_bad;
+    return rc;
+}
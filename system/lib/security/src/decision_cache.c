@@ -0,0 +1,223 @@
+/*
+ * kelp-linux :: libkelp-security
+ * decision_cache.c - Memoisation of policy / path-scan decisions
+ *
+ * Direct-mapped table of fixed-size slots.  Each slot carries a sequence
+ * counter used as a per-slot seqlock: writers make it odd, fill the slot
+ * and make it even again; readers copy what they need and then check that
+ * the counter did not move, treating any change as a miss.  A writer that
+ * finds the slot busy just drops its update, so neither side ever blocks.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "decision_cache_internal.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ---- constants ---------------------------------------------------------- */
+
+#define DCACHE_MIN_ENTRIES  64
+#define DCACHE_KEY_MAX      200   /* tool + '\0' + arg; longer keys bypass */
+
+/* ---- internal types ----------------------------------------------------- */
+
+typedef struct {
+    _Atomic uint32_t seq;      /* odd while a writer owns the slot       */
+    uint32_t         key_len;  /* 0 = empty                              */
+    uint64_t         hash;
+    uint64_t         gen;
+    int              value;
+    char             key[DCACHE_KEY_MAX];
+} __attribute__((aligned(64))) dcache_slot_t;
+
+struct dcache {
+    dcache_slot_t    *slots;
+    size_t            mask;
+
+    _Atomic uint64_t  hits;
+    _Atomic uint64_t  misses;
+    _Atomic uint64_t  bypassed;
+    _Atomic uint64_t  invalidations;
+    _Atomic uint64_t  miss_ns;
+};
+
+/* ---- helpers ------------------------------------------------------------ */
+
+/** FNV-1a over tool, a NUL separator and arg; also reports the key length. */
+static uint64_t key_hash(const char *tool, const char *arg, size_t *len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    size_t n = 0;
+
+    if (tool) {
+        for (const unsigned char *p = (const unsigned char *)tool; *p; p++) {
+            h ^= *p;
+            h *= 1099511628211ULL;
+            n++;
+        }
+    }
+    h *= 1099511628211ULL;   /* the '\0' separator */
+    n++;
+
+    for (const unsigned char *p = (const unsigned char *)arg; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+        n++;
+    }
+
+    *len = n;
+    return h;
+}
+
+static bool key_equal(const dcache_slot_t *s, const char *tool,
+                      const char *arg, size_t len)
+{
+    size_t tool_len = tool ? strlen(tool) : 0;
+
+    if (s->key_len != len)
+        return false;
+    if (tool_len && memcmp(s->key, tool, tool_len) != 0)
+        return false;
+    if (s->key[tool_len] != '\0')
+        return false;
+    return memcmp(s->key + tool_len + 1, arg, len - tool_len - 1) == 0;
+}
+
+/* ---- API ---------------------------------------------------------------- */
+
+dcache_t *dcache_new(size_t entries)
+{
+    size_t cap = DCACHE_MIN_ENTRIES;
+    while (cap < entries)
+        cap <<= 1;
+
+    dcache_t *c = calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+
+    c->slots = aligned_alloc(64, cap * sizeof(dcache_slot_t));
+    if (!c->slots) {
+        free(c);
+        return NULL;
+    }
+    memset(c->slots, 0, cap * sizeof(dcache_slot_t));
+    c->mask = cap - 1;
+    return c;
+}
+
+void dcache_free(dcache_t *c)
+{
+    if (!c)
+        return;
+    free(c->slots);
+    free(c);
+}
+
+bool dcache_lookup(dcache_t *c, uint64_t gen, const char *tool,
+                   const char *arg, int *value)
+{
+    size_t len;
+    uint64_t h = key_hash(tool, arg, &len);
+
+    if (len > DCACHE_KEY_MAX) {
+        atomic_fetch_add_explicit(&c->bypassed, 1, memory_order_relaxed);
+        return false;
+    }
+
+    dcache_slot_t *s = &c->slots[h & c->mask];
+
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    bool hit = !(seq & 1) && s->hash == h && s->gen == gen &&
+               key_equal(s, tool, arg, len);
+    int v = s->value;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&s->seq, memory_order_relaxed) != seq)
+        hit = false;
+
+    if (hit) {
+        atomic_fetch_add_explicit(&c->hits, 1, memory_order_relaxed);
+        *value = v;
+        return true;
+    }
+
+    atomic_fetch_add_explicit(&c->misses, 1, memory_order_relaxed);
+    return false;
+}
+
+void dcache_store(dcache_t *c, uint64_t gen, const char *tool,
+                  const char *arg, int value, uint64_t cost_ns)
+{
+    size_t len;
+    uint64_t h = key_hash(tool, arg, &len);
+    if (len > DCACHE_KEY_MAX)
+        return;
+
+    atomic_fetch_add_explicit(&c->miss_ns, cost_ns, memory_order_relaxed);
+
+    dcache_slot_t *s = &c->slots[h & c->mask];
+
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    if (seq & 1)
+        return;
+    if (!atomic_compare_exchange_strong_explicit(&s->seq, &seq, seq + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed))
+        return;
+    atomic_thread_fence(memory_order_release);
+
+    size_t tool_len = tool ? strlen(tool) : 0;
+    if (tool_len)
+        memcpy(s->key, tool, tool_len);
+    s->key[tool_len] = '\0';
+    memcpy(s->key + tool_len + 1, arg, len - tool_len - 1);
+    s->key_len = (uint32_t)len;
+    s->hash    = h;
+    s->gen     = gen;
+    s->value   = value;
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+void dcache_note_invalidation(dcache_t *c)
+{
+    if (c)
+        atomic_fetch_add_explicit(&c->invalidations, 1, memory_order_relaxed);
+}
+
+void dcache_stats(const dcache_t *c, kelp_decision_cache_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!c)
+        return;
+
+    /* Counters are only ever incremented; relaxed loads are fine. */
+    dcache_t *m = (dcache_t *)c;
+
+    out->capacity      = c->mask + 1;
+    out->hits          = atomic_load_explicit(&m->hits, memory_order_relaxed);
+    out->misses        = atomic_load_explicit(&m->misses, memory_order_relaxed);
+    out->bypassed      = atomic_load_explicit(&m->bypassed, memory_order_relaxed);
+    out->invalidations = atomic_load_explicit(&m->invalidations,
+                                              memory_order_relaxed);
+    out->miss_ns       = atomic_load_explicit(&m->miss_ns, memory_order_relaxed);
+
+    uint64_t lookups = out->hits + out->misses;
+    if (lookups)
+        out->hit_ratio = (double)out->hits / (double)lookups;
+    if (out->misses)
+        out->saved_ns = (uint64_t)((double)out->hits *
+                                   ((double)out->miss_ns /
+                                    (double)out->misses));
+}
+
+uint64_t dcache_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
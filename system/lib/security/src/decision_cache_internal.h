@@ -0,0 +1,65 @@
+/*
+ * kelp-linux :: libkelp-security
+ * decision_cache_internal.h - Memoisation of policy / path-scan decisions
+ *
+ * This header is NOT part of the public API.  It is shared between
+ * decision_cache.c, policy.c and path_scan.c.
+ *
+ * The cache is a fixed, direct-mapped table.  Each slot is protected by
+ * its own sequence counter, so lookups never take a lock: a reader that
+ * races a writer simply sees a miss.  Keys are (tool, argument) stored
+ * verbatim -- hashes alone are not trusted for security decisions -- and
+ * every entry is tagged with the owner's rule generation.  Bumping the
+ * generation therefore retires all entries at once.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_DECISION_CACHE_INTERNAL_H
+#define KELP_DECISION_CACHE_INTERNAL_H
+
+#include <kelp/decision_cache.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct dcache dcache_t;
+
+/**
+ * Create a cache with at least `entries` slots (rounded up to a power of
+ * two).
+ *
+ * @return The cache, or NULL on allocation failure.
+ */
+dcache_t *dcache_new(size_t entries);
+
+/** Free a cache (may be NULL). */
+void dcache_free(dcache_t *c);
+
+/**
+ * Look up (tool, arg) at generation `gen`.  `tool` may be NULL.
+ *
+ * @return true and sets *value on a hit.
+ */
+bool dcache_lookup(dcache_t *c, uint64_t gen, const char *tool,
+                   const char *arg, int *value);
+
+/**
+ * Record the decision computed for (tool, arg) at generation `gen`, and
+ * how long it took.  Silently skips keys that do not fit in a slot and
+ * slots another thread is writing.
+ */
+void dcache_store(dcache_t *c, uint64_t gen, const char *tool,
+                  const char *arg, int value, uint64_t cost_ns);
+
+/** Count a generation bump. */
+void dcache_note_invalidation(dcache_t *c);
+
+/** Fill `out` from the cache counters (zeroes it if `c` is NULL). */
+void dcache_stats(const dcache_t *c, kelp_decision_cache_stats_t *out);
+
+/** Monotonic clock in nanoseconds, for timing misses. */
+uint64_t dcache_now_ns(void);
+
+#endif /* KELP_DECISION_CACHE_INTERNAL_H */
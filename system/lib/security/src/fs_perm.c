@@ -8,7 +8,6 @@
 #include <kelp/fs_perm.h>
 #include <kelp/log.h>
 
-#include <dirent.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdio.h>
@@ -203,84 +202,37 @@ bool kelp_fs_check_ownership(const char *path, uid_t expected_uid)
     return st.st_uid == expected_uid;
 }
 
-int kelp_fs_scan_permissions(const char *dir, int max_depth)
+/** Log an issue the way the single-threaded scanner used to. */
+static void log_issue(const char *path, kelp_fs_issue_t issue,
+                      unsigned mode, void *userdata)
 {
-    if (!dir)
-        return -1;
-
-    DIR *dp = opendir(dir);
-    if (!dp) {
-        KELP_WARN("fs_perm: cannot open directory: %s (%s)",
-                   dir, strerror(errno));
-        return -1;
+    (void)userdata;
+    unsigned perm = mode & 07777;
+
+    switch (issue) {
+    case KELP_FS_ISSUE_WORLD_WRITABLE:
+        KELP_WARN("fs_perm: world-writable: %s (mode %04o)", path, perm);
+        break;
+    case KELP_FS_ISSUE_SETUID:
+        KELP_WARN("fs_perm: setuid binary: %s (mode %04o)", path, perm);
+        break;
+    case KELP_FS_ISSUE_SETGID:
+        KELP_WARN("fs_perm: setgid binary: %s (mode %04o)", path, perm);
+        break;
+    case KELP_FS_ISSUE_SYMLINK_ESCAPE: {
+        char target[PATH_MAX];
+        ssize_t tlen = readlink(path, target, sizeof(target) - 1);
+        target[tlen > 0 ? tlen : 0] = '\0';
+        KELP_WARN("fs_perm: symlink escapes base: %s -> %s", path, target);
+        break;
     }
-
-    int issues = 0;
-    struct dirent *entry;
-
-    while ((entry = readdir(dp)) != NULL) {
-        /* Skip . and .. */
-        if (strcmp(entry->d_name, ".") == 0 ||
-            strcmp(entry->d_name, "..") == 0)
-            continue;
-
-        char fullpath[PATH_MAX];
-        int n = snprintf(fullpath, sizeof(fullpath), "%s/%s",
-                         dir, entry->d_name);
-        if (n < 0 || (size_t)n >= sizeof(fullpath))
-            continue;
-
-        struct stat st;
-        if (lstat(fullpath, &st) != 0)
-            continue;
-
-        /* Check for world-writable files/directories. */
-        if (st.st_mode & S_IWOTH) {
-            KELP_WARN("fs_perm: world-writable: %s (mode %04o)",
-                       fullpath, (unsigned)(st.st_mode & 07777));
-            issues++;
-        }
-
-        /* Check for setuid/setgid binaries. */
-        if (S_ISREG(st.st_mode)) {
-            if (st.st_mode & S_ISUID) {
-                KELP_WARN("fs_perm: setuid binary: %s (mode %04o)",
-                           fullpath, (unsigned)(st.st_mode & 07777));
-                issues++;
-            }
-            if (st.st_mode & S_ISGID) {
-                KELP_WARN("fs_perm: setgid binary: %s (mode %04o)",
-                           fullpath, (unsigned)(st.st_mode & 07777));
-                issues++;
-            }
-        }
-
-        /* Check for symlinks pointing outside the scanned tree. */
-        if (S_ISLNK(st.st_mode)) {
-            char target[PATH_MAX];
-            ssize_t tlen = readlink(fullpath, target, sizeof(target) - 1);
-            if (tlen > 0) {
-                target[tlen] = '\0';
-                /* Resolve and check if it escapes the base dir. */
-                char resolved[PATH_MAX];
-                if (realpath(fullpath, resolved)) {
-                    if (strncmp(resolved, dir, strlen(dir)) != 0) {
-                        KELP_WARN("fs_perm: symlink escapes base: %s -> %s",
-                                   fullpath, target);
-                        issues++;
-                    }
-                }
-            }
-        }
-
-        /* Recurse into subdirectories. */
-        if (S_ISDIR(st.st_mode) && max_depth > 0) {
-            int sub = kelp_fs_scan_permissions(fullpath, max_depth - 1);
-            if (sub > 0)
-                issues += sub;
-        }
     }
+}
 
-    closedir(dp);
-    return issues;
+int kelp_fs_scan_permissions(const char *dir, int max_depth)
+{
+    kelp_fs_scan_opts_t opts = {
+        .max_depth = max_depth < 0 ? 0 : max_depth,
+    };
+    return kelp_fs_scan(dir, &opts, log_issue, NULL, NULL);
 }
@@ -0,0 +1,778 @@
+/*
+ * kelp-linux :: libkelp-security
+ * fs_scan.c - Parallel, incremental permission scanner
+ *
+ * Directories are tasks.  Each worker owns a deque: it pushes the
+ * subdirectories it discovers onto the bottom and pops from the bottom
+ * (depth-first, so paths stay hot in the dentry cache), while idle
+ * workers steal from the top of someone else's deque (breadth, so a
+ * stolen task tends to be a large subtree).  A shared `pending` count of
+ * queued plus in-progress directories tells the workers when the walk is
+ * finished.
+ *
+ * Each directory is opened once; its entries are read with getdents64
+ * and examined with statx relative to the directory fd, so the kernel
+ * never re-walks the full path.
+ *
+ * State file (native byte order, rewritten atomically after each scan):
+ *
+ *   "KFSSCAN1" u32 version, u32 root_len, root bytes, u64 ndirs
+ *   per dir:   u32 path_len, path, u64 ino, i64 mtime_sec, u32 mtime_nsec,
+ *              u32 nentries
+ *   per entry: u16 name_len, name, u64 ino, i64 mtime_sec, u32 mtime_nsec,
+ *              u32 mode, u8 flags
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/fs_perm.h>
+#include <kelp/log.h>
+#include <kelp/map.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STATE_MAGIC     "KFSSCAN1"
+#define STATE_VERSION   1
+#define DENTS_BUF       (64 * 1024)
+#define MAX_WORKERS     64
+
+#define STATX_MASK      (STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME)
+#define STATX_FLAGS     (AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | \
+                         AT_STATX_DONT_SYNC)
+
+/* ---- scan state --------------------------------------------------------- */
+
+enum {
+    ENT_SYMLINK_ESCAPE = 1 << 0
+};
+
+typedef struct {
+    char    *name;
+    uint64_t ino;
+    int64_t  mtime_sec;
+    uint32_t mtime_nsec;
+    uint32_t mode;
+    uint8_t  flags;
+} scan_entry_t;
+
+typedef struct {
+    char         *path;
+    uint64_t      ino;
+    int64_t       mtime_sec;
+    uint32_t      mtime_nsec;
+    scan_entry_t *ents;
+    size_t        n;
+    size_t        cap;
+} scan_dir_t;
+
+static scan_dir_t *dir_new(const char *path, uint64_t ino,
+                           int64_t mtime_sec, uint32_t mtime_nsec)
+{
+    scan_dir_t *d = calloc(1, sizeof(*d));
+    if (!d)
+        return NULL;
+    d->path = strdup(path);
+    if (!d->path) {
+        free(d);
+        return NULL;
+    }
+    d->ino        = ino;
+    d->mtime_sec  = mtime_sec;
+    d->mtime_nsec = mtime_nsec;
+    return d;
+}
+
+static void dir_free(scan_dir_t *d)
+{
+    if (!d)
+        return;
+    for (size_t i = 0; i < d->n; i++)
+        free(d->ents[i].name);
+    free(d->ents);
+    free(d->path);
+    free(d);
+}
+
+/** Append a copy of `e` (name duplicated).  Returns -1 on OOM. */
+static int dir_add(scan_dir_t *d, const scan_entry_t *e, const char *name)
+{
+    if (d->n == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : 16;
+        scan_entry_t *p = realloc(d->ents, cap * sizeof(*p));
+        if (!p)
+            return -1;
+        d->ents = p;
+        d->cap  = cap;
+    }
+    char *copy = strdup(name);
+    if (!copy)
+        return -1;
+    d->ents[d->n] = *e;
+    d->ents[d->n].name = copy;
+    d->n++;
+    return 0;
+}
+
+/* ---- state file --------------------------------------------------------- */
+
+static bool rd(FILE *f, void *p, size_t n)
+{
+    return fread(p, 1, n, f) == n;
+}
+
+static bool wr(FILE *f, const void *p, size_t n)
+{
+    return fwrite(p, 1, n, f) == n;
+}
+
+static char *rd_str(FILE *f, size_t len)
+{
+    if (len == 0 || len >= PATH_MAX)
+        return NULL;
+    char *s = malloc(len + 1);
+    if (!s)
+        return NULL;
+    if (!rd(f, s, len) || memchr(s, '\0', len)) {
+        free(s);
+        return NULL;
+    }
+    s[len] = '\0';
+    return s;
+}
+
+static void state_free(kelp_map_t *state)
+{
+    if (!state)
+        return;
+    kelp_map_iter_t it = {0};
+    while (kelp_map_iter(state, &it))
+        dir_free(it.value);
+    kelp_map_free(state);
+}
+
+/**
+ * Load a state file written for `root`.  Returns NULL if it is missing,
+ * corrupt or belongs to another root; the scan then reads everything.
+ */
+static kelp_map_t *state_load(const char *path, const char *root)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    kelp_map_t *state = NULL;
+    char magic[8];
+    uint32_t version, root_len;
+    uint64_t ndirs;
+    char *r = NULL;
+
+    if (!rd(f, magic, 8) || memcmp(magic, STATE_MAGIC, 8) != 0 ||
+        !rd(f, &version, 4) || version != STATE_VERSION ||
+        !rd(f, &root_len, 4) || !(r = rd_str(f, root_len)) ||
+        strcmp(r, root) != 0 || !rd(f, &ndirs, 8))
+        goto bad;
+
+    state = kelp_map_new();
+    if (!state)
+        goto bad;
+
+    for (uint64_t i = 0; i < ndirs; i++) {
+        uint32_t plen, nents;
+        uint64_t ino;
+        int64_t  msec;
+        uint32_t mnsec;
+        char *p;
+
+        if (!rd(f, &plen, 4) || !(p = rd_str(f, plen)))
+            goto bad;
+        if (!rd(f, &ino, 8) || !rd(f, &msec, 8) || !rd(f, &mnsec, 4) ||
+            !rd(f, &nents, 4)) {
+            free(p);
+            goto bad;
+        }
+        scan_dir_t *d = dir_new(p, ino, msec, mnsec);
+        free(p);
+        if (!d)
+            goto bad;
+        if (kelp_map_set(state, d->path, d) != 0) {
+            dir_free(d);
+            goto bad;
+        }
+
+        for (uint32_t j = 0; j < nents; j++) {
+            uint16_t nlen;
+            scan_entry_t e = {0};
+            char *name;
+            if (!rd(f, &nlen, 2) || !(name = rd_str(f, nlen)))
+                goto bad;
+            bool ok = rd(f, &e.ino, 8) && rd(f, &e.mtime_sec, 8) &&
+                      rd(f, &e.mtime_nsec, 4) && rd(f, &e.mode, 4) &&
+                      rd(f, &e.flags, 1) && dir_add(d, &e, name) == 0;
+            free(name);
+            if (!ok)
+                goto bad;
+        }
+    }
+
+    free(r);
+    fclose(f);
+    return state;
+
+bad:
+    KELP_WARN("fs_scan: ignoring unusable state file %s", path);
+    free(r);
+    state_free(state);
+    fclose(f);
+    return NULL;
+}
+
+static bool state_write_dir(FILE *f, const scan_dir_t *d)
+{
+    uint32_t plen  = (uint32_t)strlen(d->path);
+    uint32_t nents = (uint32_t)d->n;
+
+    if (!wr(f, &plen, 4) || !wr(f, d->path, plen) ||
+        !wr(f, &d->ino, 8) || !wr(f, &d->mtime_sec, 8) ||
+        !wr(f, &d->mtime_nsec, 4) || !wr(f, &nents, 4))
+        return false;
+
+    for (size_t i = 0; i < d->n; i++) {
+        const scan_entry_t *e = &d->ents[i];
+        uint16_t nlen = (uint16_t)strlen(e->name);
+        if (!wr(f, &nlen, 2) || !wr(f, e->name, nlen) ||
+            !wr(f, &e->ino, 8) || !wr(f, &e->mtime_sec, 8) ||
+            !wr(f, &e->mtime_nsec, 4) || !wr(f, &e->mode, 4) ||
+            !wr(f, &e->flags, 1))
+            return false;
+    }
+    return true;
+}
+
+/* ---- work-stealing deques ----------------------------------------------- */
+
+typedef struct {
+    char    *path;
+    int      depth;
+    uint64_t ino;
+    int64_t  mtime_sec;
+    uint32_t mtime_nsec;
+} scan_task_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    scan_task_t    *items;
+    size_t          head;       /* steal end */
+    size_t          tail;       /* owner end */
+    size_t          cap;
+} task_deque_t;
+
+typedef struct scan_ctx scan_ctx_t;
+
+typedef struct {
+    scan_ctx_t   *ctx;
+    unsigned      id;
+    pthread_t     thread;
+    scan_dir_t  **dirs;         /* new state produced by this worker */
+    size_t        ndirs;
+    size_t        cap_dirs;
+    char         *dents;        /* getdents64 buffer */
+} scan_worker_t;
+
+struct scan_ctx {
+    int                 max_depth;
+    char                root[PATH_MAX];         /* as given, no trailing / */
+    char                root_real[PATH_MAX];
+    size_t              root_real_len;
+    kelp_map_t         *old_state;      /* read-only during the scan */
+    bool                keep_state;
+
+    unsigned            nworkers;
+    scan_worker_t      *workers;
+    task_deque_t       *queues;
+
+    _Atomic size_t      pending;        /* queued + in-progress dirs */
+    _Atomic size_t      queued;
+    _Atomic unsigned    idle;
+    pthread_mutex_t     idle_lock;
+    pthread_cond_t      idle_cond;
+
+    pthread_mutex_t     cb_lock;
+    kelp_fs_issue_cb    cb;
+    void               *userdata;
+
+    _Atomic uint64_t    dirs;
+    _Atomic uint64_t    dirs_reused;
+    _Atomic uint64_t    entries;
+    _Atomic uint64_t    statx_calls;
+    _Atomic uint64_t    issues;
+};
+
+static void wake_idle(scan_ctx_t *ctx)
+{
+    pthread_mutex_lock(&ctx->idle_lock);
+    pthread_cond_broadcast(&ctx->idle_cond);
+    pthread_mutex_unlock(&ctx->idle_lock);
+}
+
+static void push_task(scan_worker_t *w, const scan_task_t *t)
+{
+    scan_ctx_t   *ctx = w->ctx;
+    task_deque_t *q   = &ctx->queues[w->id];
+
+    pthread_mutex_lock(&q->lock);
+    if (q->tail == q->cap) {
+        if (q->head > 0) {
+            memmove(q->items, q->items + q->head,
+                    (q->tail - q->head) * sizeof(*q->items));
+            q->tail -= q->head;
+            q->head  = 0;
+        }
+        if (q->tail == q->cap) {
+            size_t cap = q->cap ? q->cap * 2 : 64;
+            scan_task_t *p = realloc(q->items, cap * sizeof(*p));
+            if (!p) {
+                pthread_mutex_unlock(&q->lock);
+                KELP_WARN("fs_scan: out of memory, skipping %s", t->path);
+                free(t->path);
+                return;
+            }
+            q->items = p;
+            q->cap   = cap;
+        }
+    }
+    q->items[q->tail++] = *t;
+    pthread_mutex_unlock(&q->lock);
+
+    atomic_fetch_add(&ctx->pending, 1);
+    atomic_fetch_add(&ctx->queued, 1);
+    if (atomic_load(&ctx->idle) > 0)
+        wake_idle(ctx);
+}
+
+static bool take_task(scan_ctx_t *ctx, unsigned qi, bool own, scan_task_t *out)
+{
+    task_deque_t *q = &ctx->queues[qi];
+    bool got = false;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head) {
+        *out = own ? q->items[--q->tail] : q->items[q->head++];
+        if (q->head == q->tail)
+            q->head = q->tail = 0;
+        got = true;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    if (got)
+        atomic_fetch_sub(&ctx->queued, 1);
+    return got;
+}
+
+static bool next_task(scan_worker_t *w, scan_task_t *out)
+{
+    scan_ctx_t *ctx = w->ctx;
+
+    if (take_task(ctx, w->id, true, out))
+        return true;
+    for (unsigned i = 1; i < ctx->nworkers; i++) {
+        if (take_task(ctx, (w->id + i) % ctx->nworkers, false, out))
+            return true;
+    }
+    return false;
+}
+
+/* ---- examining entries -------------------------------------------------- */
+
+static void report(scan_ctx_t *ctx, const char *path, kelp_fs_issue_t issue,
+                   unsigned mode)
+{
+    atomic_fetch_add(&ctx->issues, 1);
+    if (!ctx->cb)
+        return;
+    pthread_mutex_lock(&ctx->cb_lock);
+    ctx->cb(path, issue, mode, ctx->userdata);
+    pthread_mutex_unlock(&ctx->cb_lock);
+}
+
+/** Does the symlink at `path` resolve to somewhere outside the root? */
+static bool symlink_escapes(const scan_ctx_t *ctx, const char *path)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(path, resolved))
+        return false;       /* dangling: points nowhere */
+    if (strncmp(resolved, ctx->root_real, ctx->root_real_len) != 0)
+        return true;
+    char c = resolved[ctx->root_real_len];
+    return c != '\0' && c != '/' && ctx->root_real_len > 1;
+}
+
+static void save_dir(scan_worker_t *w, scan_dir_t *d)
+{
+    if (!w->ctx->keep_state) {
+        dir_free(d);
+        return;
+    }
+    if (w->ndirs == w->cap_dirs) {
+        size_t cap = w->cap_dirs ? w->cap_dirs * 2 : 256;
+        scan_dir_t **p = realloc(w->dirs, cap * sizeof(*p));
+        if (!p) {
+            dir_free(d);
+            return;
+        }
+        w->dirs     = p;
+        w->cap_dirs = cap;
+    }
+    w->dirs[w->ndirs++] = d;
+}
+
+/**
+ * Examine one entry of the directory open at `dfd`.  `cached` is the
+ * entry's saved state when the directory is unchanged; non-directories
+ * are then judged from it without a statx.
+ */
+static void examine(scan_worker_t *w, const scan_task_t *t, int dfd,
+                    scan_dir_t *nd, const char *name,
+                    const scan_entry_t *cached)
+{
+    scan_ctx_t  *ctx = w->ctx;
+    scan_entry_t e   = {0};
+    bool fresh = true;
+
+    if (cached && !S_ISDIR(cached->mode)) {
+        e     = *cached;
+        fresh = false;
+    } else {
+        struct statx stx;
+        atomic_fetch_add(&ctx->statx_calls, 1);
+        if (statx(dfd, name, STATX_FLAGS, STATX_MASK, &stx) != 0)
+            return;     /* raced with an unlink */
+        e.ino        = stx.stx_ino;
+        e.mode       = stx.stx_mode;
+        e.mtime_sec  = stx.stx_mtime.tv_sec;
+        e.mtime_nsec = stx.stx_mtime.tv_nsec;
+    }
+    atomic_fetch_add(&ctx->entries, 1);
+
+    char path[PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s",
+                     strcmp(t->path, "/") == 0 ? "" : t->path, name);
+    if (n < 0 || (size_t)n >= sizeof(path))
+        return;
+
+    unsigned perm = e.mode & 07777;
+
+    if (S_ISLNK(e.mode)) {
+        if (fresh && symlink_escapes(ctx, path))
+            e.flags |= ENT_SYMLINK_ESCAPE;
+        if (e.flags & ENT_SYMLINK_ESCAPE)
+            report(ctx, path, KELP_FS_ISSUE_SYMLINK_ESCAPE, e.mode);
+    } else if (perm & S_IWOTH) {
+        report(ctx, path, KELP_FS_ISSUE_WORLD_WRITABLE, e.mode);
+    }
+
+    if (S_ISREG(e.mode)) {
+        if (perm & S_ISUID)
+            report(ctx, path, KELP_FS_ISSUE_SETUID, e.mode);
+        if (perm & S_ISGID)
+            report(ctx, path, KELP_FS_ISSUE_SETGID, e.mode);
+    }
+
+    if (nd && dir_add(nd, &e, name) != 0) {
+        /* Incomplete listing: do not let a later scan trust it. */
+        nd->mtime_sec = -1;
+    }
+
+    if (S_ISDIR(e.mode) && (ctx->max_depth < 0 || t->depth < ctx->max_depth)) {
+        scan_task_t sub = {
+            .path       = strdup(path),
+            .depth      = t->depth + 1,
+            .ino        = e.ino,
+            .mtime_sec  = e.mtime_sec,
+            .mtime_nsec = e.mtime_nsec,
+        };
+        if (sub.path)
+            push_task(w, &sub);
+    }
+}
+
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+static void scan_dir(scan_worker_t *w, const scan_task_t *t)
+{
+    scan_ctx_t *ctx = w->ctx;
+
+    int dfd = open(t->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+                            (t->depth > 0 ? O_NOFOLLOW : 0));
+    if (dfd < 0) {
+        KELP_DEBUG("fs_scan: cannot open %s: %s", t->path, strerror(errno));
+        return;
+    }
+    atomic_fetch_add(&ctx->dirs, 1);
+
+    const scan_dir_t *old = ctx->old_state
+        ? kelp_map_get(ctx->old_state, t->path) : NULL;
+    if (old && (old->ino != t->ino || old->mtime_sec != t->mtime_sec ||
+                old->mtime_nsec != t->mtime_nsec))
+        old = NULL;
+
+    scan_dir_t *nd = ctx->keep_state
+        ? dir_new(t->path, t->ino, t->mtime_sec, t->mtime_nsec) : NULL;
+
+    if (old) {
+        atomic_fetch_add(&ctx->dirs_reused, 1);
+        for (size_t i = 0; i < old->n; i++)
+            examine(w, t, dfd, nd, old->ents[i].name, &old->ents[i]);
+    } else {
+        for (;;) {
+            ssize_t len = getdents64(dfd, w->dents, DENTS_BUF);
+            if (len <= 0) {
+                if (len < 0 && nd)
+                    nd->mtime_sec = -1;
+                break;
+            }
+            for (ssize_t off = 0; off < len; ) {
+                struct linux_dirent64 *de =
+                    (struct linux_dirent64 *)(w->dents + off);
+                off += de->d_reclen;
+                const char *nm = de->d_name;
+                if (nm[0] == '.' && (nm[1] == '\0' ||
+                                     (nm[1] == '.' && nm[2] == '\0')))
+                    continue;
+                examine(w, t, dfd, nd, nm, NULL);
+            }
+        }
+    }
+
+    close(dfd);
+    if (nd)
+        save_dir(w, nd);
+}
+
+static void *worker_main(void *arg)
+{
+    scan_worker_t *w   = arg;
+    scan_ctx_t    *ctx = w->ctx;
+    scan_task_t    t;
+
+    for (;;) {
+        if (next_task(w, &t)) {
+            scan_dir(w, &t);
+            free(t.path);
+            if (atomic_fetch_sub(&ctx->pending, 1) == 1)
+                wake_idle(ctx);
+            continue;
+        }
+
+        if (atomic_load(&ctx->pending) == 0)
+            break;
+
+        pthread_mutex_lock(&ctx->idle_lock);
+        atomic_fetch_add(&ctx->idle, 1);
+        while (atomic_load(&ctx->queued) == 0 &&
+               atomic_load(&ctx->pending) > 0)
+            pthread_cond_wait(&ctx->idle_cond, &ctx->idle_lock);
+        atomic_fetch_sub(&ctx->idle, 1);
+        pthread_mutex_unlock(&ctx->idle_lock);
+    }
+    return NULL;
+}
+
+/* ---- public API --------------------------------------------------------- */
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void state_save(scan_ctx_t *ctx, const char *path)
+{
+    char tmp[PATH_MAX];
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp))
+        return;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        KELP_WARN("fs_scan: cannot write state %s: %s", tmp, strerror(errno));
+        return;
+    }
+
+    uint64_t ndirs = 0;
+    for (unsigned i = 0; i < ctx->nworkers; i++) {
+        for (size_t j = 0; j < ctx->workers[i].ndirs; j++)
+            ndirs += ctx->workers[i].dirs[j]->mtime_sec >= 0;
+    }
+
+    uint32_t version  = STATE_VERSION;
+    uint32_t root_len = (uint32_t)strlen(ctx->root);
+    bool ok = wr(f, STATE_MAGIC, 8) && wr(f, &version, 4) &&
+              wr(f, &root_len, 4) && wr(f, ctx->root, root_len) &&
+              wr(f, &ndirs, 8);
+
+    for (unsigned i = 0; ok && i < ctx->nworkers; i++) {
+        for (size_t j = 0; ok && j < ctx->workers[i].ndirs; j++) {
+            const scan_dir_t *d = ctx->workers[i].dirs[j];
+            if (d->mtime_sec >= 0)
+                ok = state_write_dir(f, d);
+        }
+    }
+
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok || rename(tmp, path) != 0) {
+        KELP_WARN("fs_scan: failed to write state %s", path);
+        unlink(tmp);
+    }
+}
+
+int kelp_fs_scan(const char *dir, const kelp_fs_scan_opts_t *opts,
+                 kelp_fs_issue_cb cb, void *userdata,
+                 kelp_fs_scan_stats_t *stats)
+{
+    static const kelp_fs_scan_opts_t defaults = { .max_depth = -1 };
+
+    if (!dir)
+        return -1;
+    if (!opts)
+        opts = &defaults;
+
+    double t0 = now_sec();
+
+    struct statx root_stx;
+    if (statx(AT_FDCWD, dir, AT_STATX_DONT_SYNC, STATX_MASK, &root_stx) != 0) {
+        KELP_WARN("fs_perm: cannot open directory: %s (%s)",
+                   dir, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(root_stx.stx_mode)) {
+        KELP_WARN("fs_perm: not a directory: %s", dir);
+        return -1;
+    }
+
+    scan_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx)
+        return -1;
+
+    if (!realpath(dir, ctx->root_real)) {
+        free(ctx);
+        return -1;
+    }
+    ctx->root_real_len = strlen(ctx->root_real);
+    ctx->max_depth     = opts->max_depth;
+    ctx->keep_state    = opts->state_path != NULL;
+    ctx->cb            = cb;
+    ctx->userdata      = userdata;
+    unsigned nw = opts->threads;
+    if (nw == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nw = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+    if (nw > MAX_WORKERS)
+        nw = MAX_WORKERS;
+    ctx->nworkers = nw;
+
+    pthread_mutex_init(&ctx->idle_lock, NULL);
+    pthread_cond_init(&ctx->idle_cond, NULL);
+    pthread_mutex_init(&ctx->cb_lock, NULL);
+
+    int rc = -1;
+    ctx->workers = calloc(nw, sizeof(*ctx->workers));
+    ctx->queues  = calloc(nw, sizeof(*ctx->queues));
+    if (!ctx->workers || !ctx->queues)
+        goto out;
+    for (unsigned i = 0; i < nw; i++) {
+        pthread_mutex_init(&ctx->queues[i].lock, NULL);
+        ctx->workers[i].ctx   = ctx;
+        ctx->workers[i].id    = i;
+        ctx->workers[i].dents = malloc(DENTS_BUF);
+        if (!ctx->workers[i].dents)
+            goto out;
+    }
+
+    /* Scan from the path as given so reported paths match the caller's. */
+    scan_task_t root = {
+        .path       = strdup(dir),
+        .depth      = 0,
+        .ino        = root_stx.stx_ino,
+        .mtime_sec  = root_stx.stx_mtime.tv_sec,
+        .mtime_nsec = root_stx.stx_mtime.tv_nsec,
+    };
+    if (!root.path)
+        goto out;
+    size_t rl = strlen(root.path);
+    while (rl > 1 && root.path[rl - 1] == '/')
+        root.path[--rl] = '\0';
+    if (rl >= sizeof(ctx->root)) {
+        free(root.path);
+        goto out;
+    }
+    memcpy(ctx->root, root.path, rl + 1);
+    if (opts->state_path && opts->incremental)
+        ctx->old_state = state_load(opts->state_path, ctx->root);
+    push_task(&ctx->workers[0], &root);
+
+    unsigned started = 1;
+    for (unsigned i = 1; i < nw; i++) {
+        if (pthread_create(&ctx->workers[i].thread, NULL, worker_main,
+                           &ctx->workers[i]) != 0)
+            break;
+        started++;
+    }
+    worker_main(&ctx->workers[0]);
+    for (unsigned i = 1; i < started; i++)
+        pthread_join(ctx->workers[i].thread, NULL);
+
+    if (opts->state_path)
+        state_save(ctx, opts->state_path);
+
+    rc = (int)atomic_load(&ctx->issues);
+
+    if (stats) {
+        stats->dirs        = atomic_load(&ctx->dirs);
+        stats->dirs_reused = atomic_load(&ctx->dirs_reused);
+        stats->entries     = atomic_load(&ctx->entries);
+        stats->statx_calls = atomic_load(&ctx->statx_calls);
+        stats->issues      = atomic_load(&ctx->issues);
+        stats->elapsed_sec = now_sec() - t0;
+    }
+
+out:
+    for (unsigned i = 0; ctx->workers && i < nw; i++) {
+        for (size_t j = 0; j < ctx->workers[i].ndirs; j++)
+            dir_free(ctx->workers[i].dirs[j]);
+        free(ctx->workers[i].dirs);
+        free(ctx->workers[i].dents);
+    }
+    for (unsigned i = 0; ctx->queues && i < nw; i++) {
+        pthread_mutex_destroy(&ctx->queues[i].lock);
+        free(ctx->queues[i].items);
+    }
+    free(ctx->workers);
+    free(ctx->queues);
+    state_free(ctx->old_state);
+    pthread_mutex_destroy(&ctx->idle_lock);
+    pthread_cond_destroy(&ctx->idle_cond);
+    pthread_mutex_destroy(&ctx->cb_lock);
+    free(ctx);
+    return rc;
+}
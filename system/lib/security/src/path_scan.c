@@ -4,6 +4,8 @@
  *
  * Pattern-based path filter using fnmatch(3) glob matching.
  * Patterns are evaluated in insertion order; the first match wins.
+ * Answers can be memoised in a decision cache keyed by path and pattern
+ * generation (see decision_cache.c).
  *
  * SPDX-License-Identifier: MIT
  */
@@ -11,7 +13,10 @@
 #include <kelp/path_scan.h>
 #include <kelp/log.h>
 
+#include "decision_cache_internal.h"
+
 #include <fnmatch.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +32,9 @@ struct kelp_path_scanner {
     scan_rule_t *rules;
     size_t       count;
     size_t       cap;
+
+    _Atomic uint64_t generation;  /* bumped on every pattern change */
+    dcache_t        *cache;       /* NULL unless enabled            */
 };
 
 /* ---- helpers ------------------------------------------------------------ */
@@ -42,33 +50,16 @@ static int scanner_grow(kelp_path_scanner_t *s)
     return 0;
 }
 
-/* ---- public API --------------------------------------------------------- */
-
-kelp_path_scanner_t *kelp_path_scanner_new(void)
+static void scanner_patterns_changed(kelp_path_scanner_t *s)
 {
-    kelp_path_scanner_t *s = calloc(1, sizeof(*s));
-    return s;
+    atomic_fetch_add_explicit(&s->generation, 1, memory_order_release);
+    dcache_note_invalidation(s->cache);
 }
 
-void kelp_path_scanner_free(kelp_path_scanner_t *s)
-{
-    if (!s)
-        return;
-
-    for (size_t i = 0; i < s->count; i++)
-        free(s->rules[i].pattern);
-
-    free(s->rules);
-    free(s);
-}
-
-void kelp_path_scanner_add_pattern(kelp_path_scanner_t *s,
-                                    const char *glob_pattern,
-                                    bool deny)
+/** Append a pattern without touching the generation. */
+static void scanner_append(kelp_path_scanner_t *s, const char *glob_pattern,
+                           bool deny)
 {
-    if (!s || !glob_pattern)
-        return;
-
     if (s->count >= s->cap) {
         if (scanner_grow(s) != 0) {
             KELP_ERROR("path_scan: allocation failure adding pattern");
@@ -86,11 +77,8 @@ void kelp_path_scanner_add_pattern(kelp_path_scanner_t *s,
     s->count++;
 }
 
-bool kelp_path_scanner_check(const kelp_path_scanner_t *s, const char *path)
+static bool scanner_evaluate(const kelp_path_scanner_t *s, const char *path)
 {
-    if (!s || !path)
-        return false;
-
     /* Extract the basename for pattern matching against simple globs. */
     const char *basename = strrchr(path, '/');
     basename = basename ? basename + 1 : path;
@@ -119,53 +107,133 @@ bool kelp_path_scanner_check(const kelp_path_scanner_t *s, const char *path)
     return true;
 }
 
+/* ---- public API --------------------------------------------------------- */
+
+kelp_path_scanner_t *kelp_path_scanner_new(void)
+{
+    kelp_path_scanner_t *s = calloc(1, sizeof(*s));
+    return s;
+}
+
+void kelp_path_scanner_free(kelp_path_scanner_t *s)
+{
+    if (!s)
+        return;
+
+    for (size_t i = 0; i < s->count; i++)
+        free(s->rules[i].pattern);
+
+    dcache_free(s->cache);
+    free(s->rules);
+    free(s);
+}
+
+void kelp_path_scanner_add_pattern(kelp_path_scanner_t *s,
+                                    const char *glob_pattern,
+                                    bool deny)
+{
+    if (!s || !glob_pattern)
+        return;
+
+    scanner_append(s, glob_pattern, deny);
+    scanner_patterns_changed(s);
+}
+
+bool kelp_path_scanner_check(const kelp_path_scanner_t *s, const char *path)
+{
+    if (!s || !path)
+        return false;
+
+    if (!s->cache)
+        return scanner_evaluate(s, path);
+
+    uint64_t gen = atomic_load_explicit(&s->generation, memory_order_acquire);
+    int cached;
+    if (dcache_lookup(s->cache, gen, NULL, path, &cached))
+        return cached != 0;
+
+    uint64_t t0 = dcache_now_ns();
+    bool allowed = scanner_evaluate(s, path);
+    dcache_store(s->cache, gen, NULL, path, allowed, dcache_now_ns() - t0);
+    return allowed;
+}
+
+int kelp_path_scanner_enable_cache(kelp_path_scanner_t *s, size_t entries)
+{
+    if (!s)
+        return -1;
+
+    dcache_free(s->cache);
+    s->cache = NULL;
+
+    if (entries == 0)
+        return 0;
+
+    s->cache = dcache_new(entries);
+    if (!s->cache) {
+        KELP_ERROR("path_scan: failed to allocate decision cache");
+        return -1;
+    }
+    return 0;
+}
+
+void kelp_path_scanner_get_cache_stats(const kelp_path_scanner_t *s,
+                                       kelp_decision_cache_stats_t *out)
+{
+    if (!out)
+        return;
+    dcache_stats(s ? s->cache : NULL, out);
+}
+
 void kelp_path_scanner_add_defaults(kelp_path_scanner_t *s)
 {
     if (!s)
         return;
 
     /* Environment / secret files. */
-    kelp_path_scanner_add_pattern(s, "*.env",         true);
-    kelp_path_scanner_add_pattern(s, ".env",          true);
-    kelp_path_scanner_add_pattern(s, ".env.*",        true);
+    scanner_append(s, "*.env",         true);
+    scanner_append(s, ".env",          true);
+    scanner_append(s, ".env.*",        true);
 
     /* SSH keys and config. */
-    kelp_path_scanner_add_pattern(s, ".ssh/*",        true);
-    kelp_path_scanner_add_pattern(s, "*/.ssh/*",      true);
+    scanner_append(s, ".ssh/*",        true);
+    scanner_append(s, "*/.ssh/*",      true);
 
     /* Certificates and private keys. */
-    kelp_path_scanner_add_pattern(s, "*.pem",         true);
-    kelp_path_scanner_add_pattern(s, "*.key",         true);
-    kelp_path_scanner_add_pattern(s, "*.p12",         true);
-    kelp_path_scanner_add_pattern(s, "*.pfx",         true);
+    scanner_append(s, "*.pem",         true);
+    scanner_append(s, "*.key",         true);
+    scanner_append(s, "*.p12",         true);
+    scanner_append(s, "*.pfx",         true);
 
     /* Credential files. */
-    kelp_path_scanner_add_pattern(s, "credentials*",  true);
-    kelp_path_scanner_add_pattern(s, "*credentials*", true);
+    scanner_append(s, "credentials*",  true);
+    scanner_append(s, "*credentials*", true);
 
     /* Secret files. */
-    kelp_path_scanner_add_pattern(s, "*secret*",      true);
+    scanner_append(s, "*secret*",      true);
 
     /* Token / password files. */
-    kelp_path_scanner_add_pattern(s, "*.token",       true);
-    kelp_path_scanner_add_pattern(s, "*password*",    true);
+    scanner_append(s, "*.token",       true);
+    scanner_append(s, "*password*",    true);
 
     /* System pseudo-filesystems. */
-    kelp_path_scanner_add_pattern(s, "/proc/*",       true);
-    kelp_path_scanner_add_pattern(s, "/sys/*",        true);
+    scanner_append(s, "/proc/*",       true);
+    scanner_append(s, "/sys/*",        true);
 
     /* Docker / container secrets. */
-    kelp_path_scanner_add_pattern(s, "*.dockercfg",   true);
-    kelp_path_scanner_add_pattern(s, ".docker/config.json", true);
+    scanner_append(s, "*.dockercfg",   true);
+    scanner_append(s, ".docker/config.json", true);
 
     /* AWS / cloud credentials. */
-    kelp_path_scanner_add_pattern(s, ".aws/*",        true);
-    kelp_path_scanner_add_pattern(s, "*/.aws/*",      true);
-    kelp_path_scanner_add_pattern(s, ".gcloud/*",     true);
+    scanner_append(s, ".aws/*",        true);
+    scanner_append(s, "*/.aws/*",      true);
+    scanner_append(s, ".gcloud/*",     true);
 
     /* GPG private keys. */
-    kelp_path_scanner_add_pattern(s, "*.gpg",         true);
-    kelp_path_scanner_add_pattern(s, "*.asc",         true);
+    scanner_append(s, "*.gpg",         true);
+    scanner_append(s, "*.asc",         true);
+
+    scanner_patterns_changed(s);
 
     KELP_INFO("path_scan: added default deny patterns");
 }
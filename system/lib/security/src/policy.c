@@ -3,34 +3,40 @@
  * policy.c - Tool policy enforcement
  *
  * Stores an ordered list of rules.  On each check the first matching rule
- * wins.  Glob matching uses fnmatch(3).
+ * wins.  Glob matching uses fnmatch(3).  kelp_policy_compile() builds an
+ * index (policy_index.c) that answers the same question without a linear
+ * scan; it is dropped whenever the rule list changes.
+ *
+ * An optional decision cache (decision_cache.c) memoises answers per
+ * (tool, argument).  Entries are tagged with the rule generation, which is
+ * bumped whenever rules are added or loaded, so stale decisions are never
+ * served.
  *
  * SPDX-License-Identifier: MIT
  */
 
-#include <kelp/policy.h>
+#include "policy_internal.h"
+#include "decision_cache_internal.h"
+
 #include <kelp/log.h>
 #include <kelp/json.h>
 
 #include <fnmatch.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* ---- internal types ----------------------------------------------------- */
 
-/** Internal copy of a rule (owns its strings). */
-typedef struct {
-    char                  *tool_name;
-    char                  *pattern;
-    kelp_policy_action_t  action;
-    char                  *reason;
-} rule_t;
-
 struct kelp_policy {
-    rule_t *rules;
-    size_t  count;
-    size_t  cap;
+    rule_t         *rules;
+    size_t          count;
+    size_t          cap;
+    policy_index_t *index;   /* NULL until kelp_policy_compile() */
+
+    _Atomic uint64_t generation;  /* bumped on every rule-list change */
+    dcache_t        *cache;       /* NULL unless enabled              */
 };
 
 /* ---- helpers ------------------------------------------------------------ */
@@ -74,6 +80,65 @@ static kelp_policy_action_t action_from_string(const char *s)
     return KELP_POLICY_ALLOW;
 }
 
+static void policy_invalidate(kelp_policy_t *p)
+{
+    policy_index_free(p->index);
+    p->index = NULL;
+}
+
+/** Retire every cached decision after the rule list changed. */
+static void policy_rules_changed(kelp_policy_t *p)
+{
+    atomic_fetch_add_explicit(&p->generation, 1, memory_order_release);
+    dcache_note_invalidation(p->cache);
+}
+
+/** Append a copy of `rule` without touching the generation. */
+static int policy_append(kelp_policy_t *p, const kelp_policy_rule_t *rule)
+{
+    /* The index borrows rule strings and indices; rebuild on next compile. */
+    policy_invalidate(p);
+
+    if (p->count >= p->cap) {
+        if (policy_grow(p) != 0)
+            return -1;
+    }
+
+    rule_t *r = &p->rules[p->count];
+    r->tool_name = safe_strdup(rule->tool_name);
+    r->pattern   = safe_strdup(rule->pattern);
+    r->action    = rule->action;
+    r->reason    = safe_strdup(rule->reason);
+
+    /* If any critical allocation failed, roll back. */
+    if ((rule->tool_name && !r->tool_name) ||
+        (rule->pattern   && !r->pattern)) {
+        rule_free(r);
+        return -1;
+    }
+
+    p->count++;
+    return 0;
+}
+
+/* ---- matching ----------------------------------------------------------- */
+
+bool policy_pattern_match(const char *pattern, const char *arg)
+{
+    if (!pattern || strcmp(pattern, "*") == 0)
+        return true;
+
+    if (fnmatch(pattern, arg, FNM_PATHNAME) == 0)
+        return true;
+
+    /* Also try matching just the basename for file paths. */
+    const char *basename = strrchr(arg, '/');
+    if (basename && fnmatch(pattern, basename + 1, 0) == 0)
+        return true;
+
+    return false;
+}
+
 /* ---- public API --------------------------------------------------------- */
 
 kelp_policy_t *kelp_policy_new(void)
@@ -87,6 +152,9 @@ void kelp_policy_free(kelp_policy_t *p)
     if (!p)
         return;
 
+    policy_invalidate(p);
+    dcache_free(p->cache);
+
     for (size_t i = 0; i < p->count; i++)
         rule_free(&p->rules[i]);
 
@@ -134,13 +202,20 @@ int kelp_policy_load(kelp_policy_t *p, const char *path)
             .reason    = reason,
         };
 
-        if (kelp_policy_add_rule(p, &rule) == 0)
+        if (policy_append(p, &rule) == 0)
             loaded++;
     }
 
     cJSON_Delete(root);
 
+    if (loaded > 0)
+        policy_rules_changed(p);
+
     KELP_INFO("policy: loaded %d rules from %s", loaded, path);
+
+    if (kelp_policy_compile(p) != 0)
+        KELP_WARN("policy: compile failed, falling back to linear matching");
+
     return 0;
 }
 
@@ -149,36 +224,70 @@ int kelp_policy_add_rule(kelp_policy_t *p, const kelp_policy_rule_t *rule)
     if (!p || !rule)
         return -1;
 
-    if (p->count >= p->cap) {
-        if (policy_grow(p) != 0)
-            return -1;
-    }
+    if (policy_append(p, rule) != 0)
+        return -1;
 
-    rule_t *r = &p->rules[p->count];
-    r->tool_name = safe_strdup(rule->tool_name);
-    r->pattern   = safe_strdup(rule->pattern);
-    r->action    = rule->action;
-    r->reason    = safe_strdup(rule->reason);
+    policy_rules_changed(p);
+    return 0;
+}
 
-    /* If any critical allocation failed, roll back. */
-    if ((rule->tool_name && !r->tool_name) ||
-        (rule->pattern   && !r->pattern)) {
-        rule_free(r);
+int kelp_policy_compile(kelp_policy_t *p)
+{
+    if (!p)
+        return -1;
+
+    policy_invalidate(p);
+
+    p->index = policy_index_build(p->rules, p->count);
+    if (!p->index) {
+        KELP_ERROR("policy: failed to compile %zu rules", p->count);
         return -1;
     }
 
-    p->count++;
+    KELP_DEBUG("policy: compiled %zu rules", p->count);
     return 0;
 }
 
-kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
-                                         const char *tool,
-                                         const char *arg)
+bool kelp_policy_is_compiled(const kelp_policy_t *p)
 {
-    if (!p || !tool)
-        return KELP_POLICY_ALLOW;
+    return p && p->index;
+}
 
-    const char *check_arg = arg ? arg : "";
+int kelp_policy_enable_cache(kelp_policy_t *p, size_t entries)
+{
+    if (!p)
+        return -1;
+
+    dcache_free(p->cache);
+    p->cache = NULL;
+
+    if (entries == 0)
+        return 0;
+
+    p->cache = dcache_new(entries);
+    if (!p->cache) {
+        KELP_ERROR("policy: failed to allocate decision cache");
+        return -1;
+    }
+    return 0;
+}
+
+void kelp_policy_get_cache_stats(const kelp_policy_t *p,
+                                 kelp_decision_cache_stats_t *out)
+{
+    if (!out)
+        return;
+    dcache_stats(p ? p->cache : NULL, out);
+}
+
+static kelp_policy_action_t policy_evaluate(const kelp_policy_t *p,
+                                            const char *tool,
+                                            const char *check_arg)
+{
+    if (p->index) {
+        size_t i = policy_index_lookup(p->index, tool, check_arg);
+        return i == POLICY_NO_MATCH ? KELP_POLICY_ALLOW : p->rules[i].action;
+    }
 
     for (size_t i = 0; i < p->count; i++) {
         const rule_t *r = &p->rules[i];
@@ -196,22 +305,7 @@ kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
             continue;
 
         /* Match argument against glob pattern. */
-        bool arg_match = false;
-        if (!r->pattern || strcmp(r->pattern, "*") == 0) {
-            arg_match = true;
-        } else {
-            if (fnmatch(r->pattern, check_arg, FNM_PATHNAME) == 0)
-                arg_match = true;
-            /* Also try matching just the basename for file paths. */
-            const char *basename = strrchr(check_arg, '/');
-            if (basename) {
-                basename++;
-                if (fnmatch(r->pattern, basename, 0) == 0)
-                    arg_match = true;
-            }
-        }
-
-        if (arg_match)
+        if (policy_pattern_match(r->pattern, check_arg))
             return r->action;
     }
 
@@ -219,6 +313,31 @@ kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
     return KELP_POLICY_ALLOW;
 }
 
+kelp_policy_action_t kelp_policy_check(const kelp_policy_t *p,
+                                         const char *tool,
+                                         const char *arg)
+{
+    if (!p || !tool)
+        return KELP_POLICY_ALLOW;
+
+    const char *check_arg = arg ? arg : "";
+
+    if (!p->cache)
+        return policy_evaluate(p, tool, check_arg);
+
+    /* Read the generation first so a concurrent reload tags our entry stale. */
+    uint64_t gen = atomic_load_explicit(&p->generation, memory_order_acquire);
+    int cached;
+    if (dcache_lookup(p->cache, gen, tool, check_arg, &cached))
+        return (kelp_policy_action_t)cached;
+
+    uint64_t t0 = dcache_now_ns();
+    kelp_policy_action_t action = policy_evaluate(p, tool, check_arg);
+    dcache_store(p->cache, gen, tool, check_arg, (int)action,
+                 dcache_now_ns() - t0);
+    return action;
+}
+
 void kelp_policy_add_default_rules(kelp_policy_t *p)
 {
     if (!p)
@@ -280,8 +399,12 @@ void kelp_policy_add_default_rules(kelp_policy_t *p)
 
     size_t n = sizeof(defaults) / sizeof(defaults[0]);
     for (size_t i = 0; i < n; i++) {
-        kelp_policy_add_rule(p, &defaults[i]);
+        policy_append(p, &defaults[i]);
     }
+    policy_rules_changed(p);
 
     KELP_INFO("policy: added %zu default rules", n);
+
+    if (kelp_policy_compile(p) != 0)
+        KELP_WARN("policy: compile failed, falling back to linear matching");
 }
@@ -0,0 +1,566 @@
+/*
+ * kelp-linux :: libkelp-security
+ * policy_index.c - Compiled policy lookup
+ *
+ * kelp_policy_compile() turns the ordered rule list into a structure that
+ * answers "which rule matches first?" without walking every rule:
+ *
+ *   - Rules are bucketed by tool name in a kelp_map.  Rules for the "*"
+ *     tool are copied into every bucket (and into a wildcard bucket used
+ *     for tools that have no rules of their own).
+ *   - Within a bucket each pattern is classified:
+ *       any      "*" or no pattern
+ *       exact    no glob metacharacters         -> hash set
+ *       prefix   "literal*"                     -> trie
+ *       suffix   "*literal"                     -> reversed trie
+ *       glob     everything else                -> fnmatch(3) fallback
+ *   - A lookup probes every structure, keeping the lowest matching rule
+ *     index.  Glob rules are only tried while their index is below the
+ *     best match found so far, so first-match-wins is preserved.  Globs
+ *     are keyed by their longest literal run ("/tmp/?/key[0-9]" -> "/key")
+ *     in a substring trie, so only globs whose literal actually occurs in
+ *     the argument ever reach fnmatch.
+ *
+ * Matching reproduces policy_pattern_match() exactly: the whole argument
+ * is matched with FNM_PATHNAME (so '*' does not cross '/'), and arguments
+ * containing '/' are additionally matched on their basename.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "policy_internal.h"
+
+#include <kelp/map.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- internal types ----------------------------------------------------- */
+
+#define NO_RULE  UINT32_MAX
+
+/** Trie node; children form a singly linked sibling list.  Node 0 = root. */
+typedef struct {
+    uint32_t      child;    /* first child, 0 if none                     */
+    uint32_t      sibling;  /* next sibling, 0 if none                    */
+    uint32_t      rule;     /* lowest rule ending here, NO_RULE if none   */
+    unsigned char ch;
+} trie_node_t;
+
+typedef struct {
+    trie_node_t *nodes;
+    uint32_t     count;
+    uint32_t     cap;
+} trie_t;
+
+/** fnmatch fallback entry, chained per literal run. */
+typedef struct {
+    uint32_t rule;
+    uint32_t next;          /* next entry in the chain, NO_RULE at end   */
+} glob_rule_t;
+
+typedef struct {
+    uint32_t     any_rule;   /* lowest "*" rule, NO_RULE if none         */
+    kelp_map_t  *exact;      /* literal -> (rule index + 1)              */
+    trie_t       prefix;     /* "literal*"                               */
+    trie_t       suffix;     /* "*literal", stored reversed              */
+    trie_t       needles;    /* glob literal runs; node rule = chain head */
+    uint32_t     loose;      /* chain of globs with no literal run       */
+    glob_rule_t *globs;
+    uint32_t     nglobs;
+    uint32_t     globs_cap;
+} bucket_t;
+
+struct policy_index {
+    const rule_t *rules;
+    kelp_map_t   *by_tool;   /* tool name -> bucket_t*                   */
+    bucket_t      wildcard;  /* "*" rules only                           */
+};
+
+typedef enum {
+    PAT_ANY,
+    PAT_EXACT,
+    PAT_PREFIX,
+    PAT_SUFFIX,
+    PAT_GLOB
+} pattern_kind_t;
+
+/* ---- pattern classification --------------------------------------------- */
+
+static bool has_glob_meta(const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '*' || s[i] == '?' || s[i] == '[' || s[i] == '\\')
+            return true;
+    }
+    return false;
+}
+
+static pattern_kind_t classify(const char *pat, const char **lit,
+                               size_t *lit_len)
+{
+    if (!pat || strcmp(pat, "*") == 0)
+        return PAT_ANY;
+
+    size_t len = strlen(pat);
+
+    if (!has_glob_meta(pat, len)) {
+        *lit = pat;
+        *lit_len = len;
+        return PAT_EXACT;
+    }
+    if (pat[len - 1] == '*' && !has_glob_meta(pat, len - 1)) {
+        *lit = pat;
+        *lit_len = len - 1;
+        return PAT_PREFIX;
+    }
+    if (pat[0] == '*' && !has_glob_meta(pat + 1, len - 1)) {
+        *lit = pat + 1;
+        *lit_len = len - 1;
+        return PAT_SUFFIX;
+    }
+    return PAT_GLOB;
+}
+
+/**
+ * Past the bracket expression opening at `s`, or NULL if it is not closed.
+ * A `]` right after the opening (or after `!`/`^`) is a member, and so is
+ * everything inside `[:class:]`, `[=c=]` and `[.c.]`.
+ */
+static const char *bracket_end(const char *s)
+{
+    const char *e = s + 1;
+    if (*e == '!' || *e == '^')
+        e++;
+    if (*e == ']')
+        e++;
+    while (*e && *e != ']') {
+        if (*e == '[' && (e[1] == ':' || e[1] == '=' || e[1] == '.')) {
+            char delim = e[1];
+            const char *c = e + 2;
+            while (*c && !(c[0] == delim && c[1] == ']'))
+                c++;
+            if (!*c)
+                return NULL;
+            e = c + 2;
+            continue;
+        }
+        e++;
+    }
+    return *e ? e + 1 : NULL;
+}
+
+/**
+ * Find the longest run of literal characters outside bracket expressions.
+ * Any string the glob matches must contain it, with or without
+ * FNM_PATHNAME.  Escapes simply end the current run.
+ */
+static void longest_literal(const char *pat, const char **out, size_t *out_len)
+{
+    const char *run = pat;
+    *out     = pat;
+    *out_len = 0;
+
+    const char *s = pat;
+    while (*s) {
+        if (*s == '*' || *s == '?' || *s == '[' || *s == '\\') {
+            if ((size_t)(s - run) > *out_len) {
+                *out     = run;
+                *out_len = (size_t)(s - run);
+            }
+
+            if (*s == '[') {
+                const char *e = bracket_end(s);
+                if (!e)
+                    return;   /* unterminated: stop at what is certain */
+                s = e;
+            } else if (*s == '\\') {
+                s += s[1] ? 2 : 1;
+            } else {
+                s++;
+            }
+            run = s;
+            continue;
+        }
+        s++;
+    }
+
+    if ((size_t)(s - run) > *out_len) {
+        *out     = run;
+        *out_len = (size_t)(s - run);
+    }
+}
+
+/* ---- trie --------------------------------------------------------------- */
+
+static int trie_init(trie_t *t)
+{
+    t->nodes = calloc(16, sizeof(trie_node_t));
+    if (!t->nodes)
+        return -1;
+    t->cap   = 16;
+    t->count = 1;
+    t->nodes[0].rule = NO_RULE;
+    return 0;
+}
+
+static uint32_t trie_find_child(const trie_t *t, uint32_t node,
+                                unsigned char ch)
+{
+    for (uint32_t c = t->nodes[node].child; c; c = t->nodes[c].sibling) {
+        if (t->nodes[c].ch == ch)
+            return c;
+    }
+    return 0;
+}
+
+static uint32_t trie_add_child(trie_t *t, uint32_t node, unsigned char ch)
+{
+    if (t->count >= t->cap) {
+        uint32_t new_cap = t->cap * 2;
+        trie_node_t *tmp = realloc(t->nodes, new_cap * sizeof(trie_node_t));
+        if (!tmp)
+            return 0;
+        t->nodes = tmp;
+        t->cap   = new_cap;
+    }
+
+    uint32_t n = t->count++;
+    t->nodes[n].child   = 0;
+    t->nodes[n].sibling = t->nodes[node].child;
+    t->nodes[n].rule    = NO_RULE;
+    t->nodes[n].ch      = ch;
+    t->nodes[node].child = n;
+    return n;
+}
+
+/**
+ * Insert `lit[0 .. len)` (reversed when `reverse` is set).  Rules arrive in
+ * ascending order, so the first rule to claim a node is the one that wins.
+ */
+static int trie_insert(trie_t *t, const char *lit, size_t len, bool reverse,
+                       uint32_t rule)
+{
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)(reverse ? lit[len - 1 - i]
+                                                   : lit[i]);
+        uint32_t next = trie_find_child(t, node, ch);
+        if (!next) {
+            next = trie_add_child(t, node, ch);
+            if (!next)
+                return -1;
+        }
+        node = next;
+    }
+    if (t->nodes[node].rule == NO_RULE)
+        t->nodes[node].rule = rule;
+    return 0;
+}
+
+/**
+ * Walk `s` forwards.  A literal of length k ending at a node matches when
+ * k >= min_len.
+ */
+static void trie_walk_prefix(const trie_t *t, const char *s, size_t n,
+                             size_t min_len, uint32_t *best)
+{
+    uint32_t node = 0;
+    for (size_t k = 0; ; k++) {
+        const trie_node_t *nd = &t->nodes[node];
+        if (nd->rule < *best && k >= min_len)
+            *best = nd->rule;
+        if (k == n)
+            break;
+        node = trie_find_child(t, node, (unsigned char)s[k]);
+        if (!node)
+            break;
+    }
+}
+
+/** Walk `s` backwards, same acceptance rule as trie_walk_prefix(). */
+static void trie_walk_suffix(const trie_t *t, const char *s, size_t n,
+                             size_t min_len, uint32_t *best)
+{
+    uint32_t node = 0;
+    for (size_t k = 0; ; k++) {
+        const trie_node_t *nd = &t->nodes[node];
+        if (nd->rule < *best && k >= min_len)
+            *best = nd->rule;
+        if (k == n)
+            break;
+        node = trie_find_child(t, node, (unsigned char)s[n - 1 - k]);
+        if (!node)
+            break;
+    }
+}
+
+/** Find or create the node for `lit[0 .. len)` (NULL on failure). */
+static trie_node_t *trie_node_for(trie_t *t, const char *lit, size_t len)
+{
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t next = trie_find_child(t, node, (unsigned char)lit[i]);
+        if (!next) {
+            next = trie_add_child(t, node, (unsigned char)lit[i]);
+            if (!next)
+                return NULL;
+        }
+        node = next;
+    }
+    return &t->nodes[node];
+}
+
+/* ---- buckets ------------------------------------------------------------ */
+
+static void bucket_clear(bucket_t *b)
+{
+    kelp_map_free(b->exact);
+    free(b->prefix.nodes);
+    free(b->suffix.nodes);
+    free(b->needles.nodes);
+    free(b->globs);
+}
+
+static int bucket_init(bucket_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->any_rule = NO_RULE;
+    b->loose    = NO_RULE;
+    b->exact    = kelp_map_new();
+    if (!b->exact || trie_init(&b->prefix) != 0 ||
+        trie_init(&b->suffix) != 0 || trie_init(&b->needles) != 0) {
+        bucket_clear(b);
+        return -1;
+    }
+    return 0;
+}
+
+static bucket_t *bucket_new(void)
+{
+    bucket_t *b = malloc(sizeof(*b));
+    if (!b)
+        return NULL;
+    if (bucket_init(b) != 0) {
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+static int bucket_add(bucket_t *b, const rule_t *r, uint32_t idx)
+{
+    const char *lit = NULL;
+    size_t lit_len  = 0;
+
+    switch (classify(r->pattern, &lit, &lit_len)) {
+    case PAT_ANY:
+        if (b->any_rule == NO_RULE)
+            b->any_rule = idx;
+        return 0;
+
+    case PAT_EXACT:
+        if (kelp_map_has(b->exact, lit))
+            return 0;
+        return kelp_map_set(b->exact, lit, (void *)(uintptr_t)(idx + 1));
+
+    case PAT_PREFIX:
+        return trie_insert(&b->prefix, lit, lit_len, false, idx);
+
+    case PAT_SUFFIX:
+        return trie_insert(&b->suffix, lit, lit_len, true, idx);
+
+    case PAT_GLOB:
+        break;
+    }
+
+    if (b->nglobs >= b->globs_cap) {
+        uint32_t new_cap = b->globs_cap ? b->globs_cap * 2 : 16;
+        glob_rule_t *tmp = realloc(b->globs, new_cap * sizeof(glob_rule_t));
+        if (!tmp)
+            return -1;
+        b->globs     = tmp;
+        b->globs_cap = new_cap;
+    }
+
+    longest_literal(r->pattern, &lit, &lit_len);
+
+    uint32_t *head = &b->loose;
+    if (lit_len) {
+        trie_node_t *nd = trie_node_for(&b->needles, lit, lit_len);
+        if (!nd)
+            return -1;
+        head = &nd->rule;
+    }
+
+    uint32_t g = b->nglobs++;
+    b->globs[g].rule = idx;
+    b->globs[g].next = *head;
+    *head = g;
+    return 0;
+}
+
+static void exact_probe(const bucket_t *b, const char *s, uint32_t *best)
+{
+    void *v = kelp_map_get(b->exact, s);
+    if (v) {
+        uint32_t idx = (uint32_t)((uintptr_t)v - 1);
+        if (idx < *best)
+            *best = idx;
+    }
+}
+
+/** Try every glob on a chain that could still beat `*best`. */
+static void glob_chain(const bucket_t *b, uint32_t g, const rule_t *rules,
+                       const char *arg, uint32_t *best)
+{
+    for (; g != NO_RULE; g = b->globs[g].next) {
+        uint32_t rule = b->globs[g].rule;
+        if (rule < *best && policy_pattern_match(rules[rule].pattern, arg))
+            *best = rule;
+    }
+}
+
+static uint32_t bucket_lookup(const bucket_t *b, const rule_t *rules,
+                              const char *arg)
+{
+    uint32_t best = b->any_rule;
+
+    size_t n = strlen(arg);
+    const char *first_slash = memchr(arg, '/', n);
+    const char *last_slash  = strrchr(arg, '/');
+
+    /*
+     * With FNM_PATHNAME the '*' of "lit*" may not swallow a '/', so the
+     * literal has to reach past the last slash; likewise "*lit" has to
+     * start at or before the first slash.
+     */
+    size_t prefix_min = last_slash ? (size_t)(last_slash - arg) + 1 : 0;
+    size_t suffix_min = first_slash ? n - (size_t)(first_slash - arg) : 0;
+
+    exact_probe(b, arg, &best);
+    trie_walk_prefix(&b->prefix, arg, n, prefix_min, &best);
+    trie_walk_suffix(&b->suffix, arg, n, suffix_min, &best);
+
+    if (last_slash) {
+        const char *base = last_slash + 1;
+        size_t base_len  = n - (size_t)(base - arg);
+
+        exact_probe(b, base, &best);
+        trie_walk_prefix(&b->prefix, base, base_len, 0, &best);
+        trie_walk_suffix(&b->suffix, base, base_len, 0, &best);
+    }
+
+    if (!b->nglobs)
+        return best;
+
+    /* Every literal run occurring anywhere in arg names candidate globs. */
+    const trie_t *t = &b->needles;
+    for (size_t start = 0; start < n; start++) {
+        uint32_t node = 0;
+        for (size_t k = start; k < n; k++) {
+            node = trie_find_child(t, node, (unsigned char)arg[k]);
+            if (!node)
+                break;
+            glob_chain(b, t->nodes[node].rule, rules, arg, &best);
+        }
+    }
+    glob_chain(b, b->loose, rules, arg, &best);
+
+    return best;
+}
+
+/* ---- public (library-internal) API -------------------------------------- */
+
+policy_index_t *policy_index_build(const rule_t *rules, size_t count)
+{
+    if (count >= NO_RULE)
+        return NULL;
+
+    policy_index_t *idx = calloc(1, sizeof(*idx));
+    if (!idx)
+        return NULL;
+
+    idx->rules   = rules;
+    idx->by_tool = kelp_map_new();
+    if (!idx->by_tool || bucket_init(&idx->wildcard) != 0) {
+        kelp_map_free(idx->by_tool);
+        free(idx);
+        return NULL;
+    }
+
+    /* Pass 1: one bucket per named tool. */
+    for (size_t i = 0; i < count; i++) {
+        const char *tool = rules[i].tool_name;
+        if (!tool || strcmp(tool, "*") == 0 || kelp_map_has(idx->by_tool, tool))
+            continue;
+
+        bucket_t *b = bucket_new();
+        if (!b)
+            goto fail;
+        if (kelp_map_set(idx->by_tool, tool, b) != 0) {
+            bucket_clear(b);
+            free(b);
+            goto fail;
+        }
+    }
+
+    /* Pass 2: distribute rules in order. */
+    for (size_t i = 0; i < count; i++) {
+        const rule_t *r = &rules[i];
+        if (!r->tool_name)
+            continue;   /* never matches any tool */
+
+        if (strcmp(r->tool_name, "*") != 0) {
+            bucket_t *b = kelp_map_get(idx->by_tool, r->tool_name);
+            if (bucket_add(b, r, (uint32_t)i) != 0)
+                goto fail;
+            continue;
+        }
+
+        if (bucket_add(&idx->wildcard, r, (uint32_t)i) != 0)
+            goto fail;
+
+        kelp_map_iter_t it = {0};
+        while (kelp_map_iter(idx->by_tool, &it)) {
+            if (bucket_add(it.value, r, (uint32_t)i) != 0)
+                goto fail;
+        }
+    }
+
+    return idx;
+
+fail:
+    policy_index_free(idx);
+    return NULL;
+}
+
+void policy_index_free(policy_index_t *idx)
+{
+    if (!idx)
+        return;
+
+    if (idx->by_tool) {
+        kelp_map_iter_t it = {0};
+        while (kelp_map_iter(idx->by_tool, &it)) {
+            bucket_clear(it.value);
+            free(it.value);
+        }
+        kelp_map_free(idx->by_tool);
+    }
+
+    bucket_clear(&idx->wildcard);
+    free(idx);
+}
+
+size_t policy_index_lookup(const policy_index_t *idx,
+                           const char *tool, const char *arg)
+{
+    const bucket_t *b = kelp_map_get(idx->by_tool, tool);
+    if (!b)
+        b = &idx->wildcard;
+
+    uint32_t best = bucket_lookup(b, idx->rules, arg);
+    return best == NO_RULE ? POLICY_NO_MATCH : (size_t)best;
+}
@@ -0,0 +1,63 @@
+/*
+ * kelp-linux :: libkelp-security
+ * policy_internal.h - Internal types shared across the policy engine
+ *
+ * This header is NOT part of the public API. It is shared between
+ * policy.c (rule storage, linear matching) and policy_index.c (the
+ * compiled lookup structure built by kelp_policy_compile()).
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KELP_POLICY_INTERNAL_H
+#define KELP_POLICY_INTERNAL_H
+
+#include <kelp/policy.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Internal copy of a rule (owns its strings). */
+typedef struct {
+    char                  *tool_name;
+    char                  *pattern;
+    kelp_policy_action_t  action;
+    char                  *reason;
+} rule_t;
+
+/** Compiled, read-only view of a rule list. */
+typedef struct policy_index policy_index_t;
+
+/** Returned by policy_index_lookup() when no rule matches. */
+#define POLICY_NO_MATCH ((size_t)-1)
+
+/**
+ * Match `arg` against a single rule pattern using the engine's glob
+ * semantics: the whole argument with FNM_PATHNAME, or -- for arguments
+ * containing a '/' -- just the basename without flags.  A NULL pattern or
+ * "*" matches everything.
+ */
+bool policy_pattern_match(const char *pattern, const char *arg);
+
+/**
+ * Build an index over `rules[0 .. count)`.
+ *
+ * The index borrows the rule strings; it must be freed before the rule
+ * array is modified or released.
+ *
+ * @return The index, or NULL on allocation failure.
+ */
+policy_index_t *policy_index_build(const rule_t *rules, size_t count);
+
+/** Free an index (may be NULL). */
+void policy_index_free(policy_index_t *idx);
+
+/**
+ * Find the first rule (lowest index) matching the tool invocation.
+ *
+ * @return The rule index, or POLICY_NO_MATCH.
+ */
+size_t policy_index_lookup(const policy_index_t *idx,
+                           const char *tool, const char *arg);
+
+#endif /* KELP_POLICY_INTERNAL_H */
@@ -0,0 +1,145 @@
+/*
+ * kelp-linux :: libkelp-security
+ * bench_policy.c - kelp_policy_check throughput, linear vs. compiled
+ *
+ * Builds a synthetic policy (10k rules by default) mixing exact paths,
+ * directory prefixes, extension suffixes and general globs across a few
+ * tools, then times the same probe set before and after
+ * kelp_policy_compile(), and again with a warm decision cache.  Every
+ * probe result is cross-checked.
+ *
+ * Usage: bench_policy [rules] [probes]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/policy.h>
+#include <kelp/log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STR_LEN 64
+
+static const char *tools[] = { "bash", "file_read", "file_write", "web_fetch" };
+#define NTOOLS (sizeof(tools) / sizeof(tools[0]))
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void make_pattern(char *out, size_t i)
+{
+    switch (i % 5) {
+    case 0:  snprintf(out, STR_LEN, "/srv/data/file%zu.bin", i);   break;
+    case 1:  snprintf(out, STR_LEN, "/srv/proj%zu/*", i);           break;
+    case 2:  snprintf(out, STR_LEN, "*.ext%zu", i);                 break;
+    case 3:  snprintf(out, STR_LEN, "cmd%zu *", i);                 break;
+    default: snprintf(out, STR_LEN, "/tmp/*/secret%zu?", i);        break;
+    }
+}
+
+static void make_probe(char *out, size_t i, size_t nrules)
+{
+    size_t r = (i * 7919) % (nrules * 2);   /* half the probes miss */
+    switch (i % 6) {
+    case 0:  snprintf(out, STR_LEN, "/srv/data/file%zu.bin", r);    break;
+    case 1:  snprintf(out, STR_LEN, "/srv/proj%zu/main.c", r);      break;
+    case 2:  snprintf(out, STR_LEN, "/home/u/a.ext%zu", r);         break;
+    case 3:  snprintf(out, STR_LEN, "cmd%zu --flag", r);            break;
+    case 4:  snprintf(out, STR_LEN, "/tmp/x/secret%zuz", r);        break;
+    default: snprintf(out, STR_LEN, "/usr/share/doc/readme%zu", r); break;
+    }
+}
+
+static double run(const kelp_policy_t *p, char (*args)[STR_LEN],
+                  size_t nprobes, kelp_policy_action_t *out)
+{
+    double t0 = now_sec();
+    for (size_t i = 0; i < nprobes; i++)
+        out[i] = kelp_policy_check(p, tools[i % NTOOLS], args[i]);
+    return now_sec() - t0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t nrules  = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t nprobes = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+
+    kelp_log_init("bench_policy", KELP_LOG_WARN);
+
+    kelp_policy_t *p = kelp_policy_new();
+    char (*args)[STR_LEN] = calloc(nprobes, STR_LEN);
+    kelp_policy_action_t *linear   = calloc(nprobes, sizeof(*linear));
+    kelp_policy_action_t *compiled = calloc(nprobes, sizeof(*compiled));
+    kelp_policy_action_t *cached   = calloc(nprobes, sizeof(*cached));
+    if (!p || !args || !linear || !compiled || !cached) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < nrules; i++) {
+        char pat[STR_LEN];
+        make_pattern(pat, i);
+        kelp_policy_rule_t rule = {
+            .tool_name = (i % 10 == 0) ? "*" : tools[i % NTOOLS],
+            .pattern   = pat,
+            .action    = (kelp_policy_action_t)(1 + i % 3),
+        };
+        kelp_policy_add_rule(p, &rule);
+    }
+
+    for (size_t i = 0; i < nprobes; i++)
+        make_probe(args[i], i, nrules);
+
+    double t_linear = run(p, args, nprobes, linear);
+
+    double t0 = now_sec();
+    if (kelp_policy_compile(p) != 0) {
+        fprintf(stderr, "compile failed\n");
+        return 1;
+    }
+    double t_compile = now_sec() - t0;
+
+    double t_compiled = run(p, args, nprobes, compiled);
+
+    kelp_policy_enable_cache(p, nprobes * 4);
+    run(p, args, nprobes, cached);                       /* warm up */
+    kelp_decision_cache_stats_t warm, st;
+    kelp_policy_get_cache_stats(p, &warm);
+    double t_cached = run(p, args, nprobes, cached);
+    kelp_policy_get_cache_stats(p, &st);
+    double hit_ratio = (double)(st.hits - warm.hits) / (double)nprobes;
+
+    size_t mismatches = 0, hits = 0;
+    for (size_t i = 0; i < nprobes; i++) {
+        if (compiled[i] != linear[i] || cached[i] != linear[i])
+            mismatches++;
+        if (compiled[i] != KELP_POLICY_ALLOW)
+            hits++;
+    }
+
+    printf("rules:      %zu\n", nrules);
+    printf("probes:     %zu (%zu matched a rule)\n", nprobes, hits);
+    printf("compile:    %.2f ms\n", t_compile * 1e3);
+    printf("linear:     %.0f ns/check\n", t_linear * 1e9 / (double)nprobes);
+    printf("compiled:   %.0f ns/check\n", t_compiled * 1e9 / (double)nprobes);
+    printf("cached:     %.0f ns/check (hit ratio %.2f)\n",
+           t_cached * 1e9 / (double)nprobes, hit_ratio);
+    printf("speedup:    %.1fx compiled, %.1fx cached\n",
+           t_linear / t_compiled, t_linear / t_cached);
+    printf("mismatches: %zu\n", mismatches);
+
+    kelp_policy_free(p);
+    free(args);
+    free(linear);
+    free(compiled);
+    free(cached);
+
+    return mismatches ? 1 : 0;
+}
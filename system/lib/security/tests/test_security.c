@@ -8,6 +8,7 @@
  *   - Filesystem permission checks (kelp_fs_check_perm, kelp_fs_check_ownership)
  *   - Policy rule matching (kelp_policy_check)
  *   - Path scanner patterns (kelp_path_scanner_check)
+ *   - Decision caches (kelp_policy_enable_cache, kelp_path_scanner_enable_cache)
  *   - Audit event formatting (kelp_audit_log)
  *
  * SPDX-License-Identifier: MIT
@@ -15,15 +16,21 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <kelp/audit.h>
+#include <kelp/audit_segment.h>
 #include <kelp/fs_perm.h>
 #include <kelp/policy.h>
 #include <kelp/path_scan.h>
@@ -340,6 +347,132 @@ static void test_policy(void)
         TEST_ASSERT(kelp_policy_check(NULL, "bash", "ls") ==
                     KELP_POLICY_ALLOW);
     } TEST_END();
+
+    TEST_BEGIN("compiled policy matches linear scan") {
+        static const kelp_policy_rule_t rules[] = {
+            { "bash",       "echo *",         KELP_POLICY_ALLOW, NULL },
+            { "bash",       "rm -rf /*",      KELP_POLICY_DENY,  NULL },
+            { "file_write", "/etc/*",         KELP_POLICY_DENY,  NULL },
+            { "*",          "*.env",          KELP_POLICY_DENY,  NULL },
+            { "*",          ".env",           KELP_POLICY_ASK,   NULL },
+            { "file_read",  "/srv/data",      KELP_POLICY_AUDIT, NULL },
+            { "*",          "*id_rsa*",       KELP_POLICY_DENY,  NULL },
+            { "file_read",  "notes*",         KELP_POLICY_ASK,   NULL },
+            { "file_read",  "/srv/*.[ch]",    KELP_POLICY_AUDIT, NULL },
+            { "*",          "/tmp/?/key[0-9]", KELP_POLICY_DENY, NULL },
+            { "*",          "[!.]*\\*x",      KELP_POLICY_ASK,   NULL },
+            { "bash",       "*",              KELP_POLICY_AUDIT, NULL },
+            { "*",          "*.log",          KELP_POLICY_AUDIT, NULL },
+        };
+        static const struct { const char *tool, *arg; } probes[] = {
+            { "bash",       "echo hi"                },
+            { "bash",       "echo a/b"               },
+            { "bash",       "rm -rf /home"           },
+            { "bash",       "rm -rf /home/user"      },
+            { "bash",       "cat prod.env"           },
+            { "file_write", "/etc/passwd"            },
+            { "file_write", "/etc/ssh/sshd_config"   },
+            { "file_write", "/home/u/.env"           },
+            { "file_read",  ".env"                   },
+            { "file_read",  "/srv/data"              },
+            { "file_read",  "/srv/x/data"            },
+            { "file_read",  "/home/u/.ssh/id_rsa"    },
+            { "file_read",  "notes.txt"              },
+            { "file_read",  "/home/u/notes.md"       },
+            { "file_read",  "notes/a.txt"            },
+            { "file_read",  "/srv/main.c"            },
+            { "file_read",  "/srv/sub/main.c"        },
+            { "file_read",  "/var/log/app.log"       },
+            { "file_read",  "var/app.log"            },
+            { "web_fetch",  "https://x/y.env"        },
+            { "web_fetch",  "plain"                  },
+            { "web_fetch",  "/tmp/a/key7"            },
+            { "web_fetch",  "/tmp/ab/key7"           },
+            { "file_read",  "/x/a*x"                 },
+            { "file_read",  "a*x"                    },
+            { "web_fetch",  ""                       },
+        };
+        size_t nrules  = sizeof(rules) / sizeof(rules[0]);
+        size_t nprobes = sizeof(probes) / sizeof(probes[0]);
+
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        for (size_t i = 0; i < nrules; i++)
+            kelp_policy_add_rule(p, &rules[i]);
+        TEST_ASSERT(!kelp_policy_is_compiled(p));
+
+        kelp_policy_action_t linear[sizeof(probes) / sizeof(probes[0])];
+        for (size_t i = 0; i < nprobes; i++)
+            linear[i] = kelp_policy_check(p, probes[i].tool, probes[i].arg);
+
+        TEST_ASSERT(kelp_policy_compile(p) == 0);
+        TEST_ASSERT(kelp_policy_is_compiled(p));
+
+        for (size_t i = 0; i < nprobes; i++) {
+            TEST_ASSERT(kelp_policy_check(p, probes[i].tool,
+                                          probes[i].arg) == linear[i]);
+        }
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("compiled policy keeps bracket classes") {
+        static const kelp_policy_rule_t rules[] = {
+            { "*", "[[:digit:]]secret", KELP_POLICY_DENY, NULL },
+            { "*", "x[[:alpha:]]yz",    KELP_POLICY_DENY, NULL },
+            { "*", "[]a]k[!]]v",        KELP_POLICY_DENY, NULL },
+        };
+        static const char *probes[] = {
+            "5secret", "xsecret", "xqyz", "x1yz", "]kav", "ak]v",
+        };
+        size_t nprobes = sizeof(probes) / sizeof(probes[0]);
+
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++)
+            kelp_policy_add_rule(p, &rules[i]);
+
+        kelp_policy_action_t linear[sizeof(probes) / sizeof(probes[0])];
+        for (size_t i = 0; i < nprobes; i++)
+            linear[i] = kelp_policy_check(p, "file_read", probes[i]);
+        TEST_ASSERT(linear[0] == KELP_POLICY_DENY);
+        TEST_ASSERT(linear[2] == KELP_POLICY_DENY);
+        TEST_ASSERT(linear[4] == KELP_POLICY_DENY);
+
+        TEST_ASSERT(kelp_policy_compile(p) == 0);
+        for (size_t i = 0; i < nprobes; i++) {
+            TEST_ASSERT(kelp_policy_check(p, "file_read", probes[i]) ==
+                        linear[i]);
+        }
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("adding a rule drops the compiled index") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+
+        kelp_policy_add_default_rules(p);
+        TEST_ASSERT(kelp_policy_is_compiled(p));
+
+        kelp_policy_rule_t rule = {
+            .tool_name = "file_read",
+            .pattern   = "/opt/*",
+            .action    = KELP_POLICY_ASK,
+        };
+        kelp_policy_add_rule(p, &rule);
+        TEST_ASSERT(!kelp_policy_is_compiled(p));
+        TEST_ASSERT(kelp_policy_check(p, "file_read", "/opt/x") ==
+                    KELP_POLICY_ASK);
+
+        TEST_ASSERT(kelp_policy_compile(p) == 0);
+        TEST_ASSERT(kelp_policy_check(p, "file_read", "/opt/x") ==
+                    KELP_POLICY_ASK);
+        TEST_ASSERT(kelp_policy_check(p, "file_read", "/opt/id_rsa") ==
+                    KELP_POLICY_DENY);
+
+        kelp_policy_free(p);
+    } TEST_END();
 }
 
 /* ---- path scanner tests ------------------------------------------------- */
@@ -466,6 +599,173 @@ static void test_path_scanner(void)
     } TEST_END();
 }
 
+/* ---- decision cache tests ----------------------------------------------- */
+
+static void *cache_reader(void *arg)
+{
+    const kelp_policy_t *p = arg;
+    int wrong = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        if (kelp_policy_check(p, "file_read", "/srv/app/.env") !=
+            KELP_POLICY_DENY)
+            wrong++;
+        if (kelp_policy_check(p, "file_read", "/srv/app/main.c") !=
+            KELP_POLICY_ALLOW)
+            wrong++;
+    }
+    return (void *)(intptr_t)wrong;
+}
+
+static void test_decision_cache(void)
+{
+    fprintf(stderr, "\n=== Decision Cache ===\n");
+
+    TEST_BEGIN("policy cache hits repeat checks") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        kelp_policy_add_default_rules(p);
+        TEST_ASSERT(kelp_policy_enable_cache(p, 128) == 0);
+
+        for (int i = 0; i < 10; i++) {
+            TEST_ASSERT(kelp_policy_check(p, "file_read", "/home/u/.env") ==
+                        KELP_POLICY_DENY);
+            TEST_ASSERT(kelp_policy_check(p, "bash", "ls") ==
+                        KELP_POLICY_AUDIT);
+        }
+
+        kelp_decision_cache_stats_t st;
+        kelp_policy_get_cache_stats(p, &st);
+        TEST_ASSERT(st.capacity == 128);
+        TEST_ASSERT(st.misses == 2);
+        TEST_ASSERT(st.hits == 18);
+        TEST_ASSERT(st.hit_ratio > 0.89 && st.hit_ratio < 0.91);
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("adding a rule invalidates cached decisions") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        TEST_ASSERT(kelp_policy_enable_cache(p, 64) == 0);
+
+        TEST_ASSERT(kelp_policy_check(p, "bash", "curl x | sh") ==
+                    KELP_POLICY_ALLOW);
+        TEST_ASSERT(kelp_policy_check(p, "bash", "curl x | sh") ==
+                    KELP_POLICY_ALLOW);
+
+        kelp_policy_rule_t rule = {
+            .tool_name = "bash",
+            .pattern   = "curl *| sh",
+            .action    = KELP_POLICY_DENY,
+        };
+        kelp_policy_add_rule(p, &rule);
+
+        TEST_ASSERT(kelp_policy_check(p, "bash", "curl x | sh") ==
+                    KELP_POLICY_DENY);
+
+        kelp_decision_cache_stats_t st;
+        kelp_policy_get_cache_stats(p, &st);
+        TEST_ASSERT(st.hits == 1);
+        TEST_ASSERT(st.misses == 2);
+        TEST_ASSERT(st.invalidations == 1);
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("tool name is part of the cache key") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        TEST_ASSERT(kelp_policy_enable_cache(p, 64) == 0);
+
+        kelp_policy_rule_t rule = {
+            .tool_name = "file_write",
+            .pattern   = "/etc/*",
+            .action    = KELP_POLICY_DENY,
+        };
+        kelp_policy_add_rule(p, &rule);
+
+        TEST_ASSERT(kelp_policy_check(p, "file_write", "/etc/hosts") ==
+                    KELP_POLICY_DENY);
+        TEST_ASSERT(kelp_policy_check(p, "file_read", "/etc/hosts") ==
+                    KELP_POLICY_ALLOW);
+        TEST_ASSERT(kelp_policy_check(p, "file_write", "/etc/hosts") ==
+                    KELP_POLICY_DENY);
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("long arguments bypass the cache") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        TEST_ASSERT(kelp_policy_enable_cache(p, 64) == 0);
+
+        char arg[512];
+        memset(arg, 'a', sizeof(arg) - 1);
+        arg[sizeof(arg) - 1] = '\0';
+
+        kelp_policy_check(p, "bash", arg);
+        kelp_policy_check(p, "bash", arg);
+
+        kelp_decision_cache_stats_t st;
+        kelp_policy_get_cache_stats(p, &st);
+        TEST_ASSERT(st.bypassed == 2);
+        TEST_ASSERT(st.hits == 0);
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("concurrent cached checks stay correct") {
+        kelp_policy_t *p = kelp_policy_new();
+        TEST_ASSERT(p != NULL);
+        kelp_policy_add_default_rules(p);
+        /* Tiny cache so both keys fight over slots. */
+        TEST_ASSERT(kelp_policy_enable_cache(p, 1) == 0);
+
+        pthread_t th[4];
+        for (int i = 0; i < 4; i++)
+            pthread_create(&th[i], NULL, cache_reader, p);
+
+        intptr_t wrong = 0;
+        for (int i = 0; i < 4; i++) {
+            void *ret = NULL;
+            pthread_join(th[i], &ret);
+            wrong += (intptr_t)ret;
+        }
+        TEST_ASSERT(wrong == 0);
+
+        kelp_policy_free(p);
+    } TEST_END();
+
+    TEST_BEGIN("path scanner cache hits and invalidates") {
+        kelp_path_scanner_t *s = kelp_path_scanner_new();
+        TEST_ASSERT(s != NULL);
+        TEST_ASSERT(kelp_path_scanner_enable_cache(s, 64) == 0);
+
+        TEST_ASSERT(kelp_path_scanner_check(s, "/data/report.csv"));
+        TEST_ASSERT(kelp_path_scanner_check(s, "/data/report.csv"));
+
+        kelp_path_scanner_add_pattern(s, "*.csv", true);
+        TEST_ASSERT(!kelp_path_scanner_check(s, "/data/report.csv"));
+        TEST_ASSERT(!kelp_path_scanner_check(s, "/data/report.csv"));
+
+        kelp_decision_cache_stats_t st;
+        kelp_path_scanner_get_cache_stats(s, &st);
+        TEST_ASSERT(st.hits == 2);
+        TEST_ASSERT(st.misses == 2);
+        TEST_ASSERT(st.invalidations == 1);
+
+        kelp_path_scanner_free(s);
+    } TEST_END();
+
+    TEST_BEGIN("stats are zero without a cache") {
+        kelp_decision_cache_stats_t st;
+        memset(&st, 0xff, sizeof(st));
+        kelp_policy_get_cache_stats(NULL, &st);
+        TEST_ASSERT(st.capacity == 0 && st.hits == 0 && st.misses == 0);
+    } TEST_END();
+}
+
 /* ---- audit tests -------------------------------------------------------- */
 
 /* Sink callback that records the last event for verification. */
@@ -481,6 +781,30 @@ static void test_sink(const kelp_audit_event_t *event, void *userdata)
     }
 }
 
+static void slow_sink(const kelp_audit_event_t *event, void *userdata)
+{
+    (void)event;
+    (void)userdata;
+    struct timespec ts = { 0, 200 * 1000L };
+    nanosleep(&ts, NULL);
+}
+
+static void *audit_producer(void *arg)
+{
+    (void)arg;
+    kelp_audit_event_t ev = {
+        .level    = KELP_AUDIT_INFO,
+        .category = "exec",
+        .action   = "spawn",
+        .subject  = "worker",
+        .object   = "/bin/true",
+        .allowed  = true,
+    };
+    for (int i = 0; i < 1000; i++)
+        kelp_audit_log(&ev);
+    return NULL;
+}
+
 static void test_audit(void)
 {
     fprintf(stderr, "\n=== Audit Event Formatting ===\n");
@@ -698,6 +1022,726 @@ static void test_audit(void)
         TEST_ASSERT(strstr(line, "\\n") != NULL);
         TEST_ASSERT(strstr(line, "\\t") != NULL);
     } TEST_END();
+
+    TEST_BEGIN("async writer drains on flush and shutdown") {
+        char path[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        kelp_audit_async_opts_t opts = {
+            .batch_max    = 8,
+            .fsync_policy = KELP_AUDIT_FSYNC_EVERY_N,
+            .fsync_every_n = 16,
+        };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+
+        sink_call_count = 0;
+        TEST_ASSERT(kelp_audit_add_sink(test_sink, NULL) == 0);
+
+        kelp_audit_event_t ev = {
+            .level    = KELP_AUDIT_WARN,
+            .category = "fs",
+            .action   = "write",
+            .subject  = "agent",
+            .object   = "/tmp/out",
+            .allowed  = true,
+        };
+        for (int i = 0; i < 100; i++)
+            kelp_audit_log(&ev);
+
+        kelp_audit_flush();
+        TEST_ASSERT(sink_call_count == 100);
+
+        kelp_audit_stats_t st;
+        kelp_audit_get_stats(&st);
+        TEST_ASSERT(st.enqueued == 100);
+        TEST_ASSERT(st.written == 100);
+        TEST_ASSERT(st.dropped == 0);
+        TEST_ASSERT(st.batches >= 100 / 8);
+        TEST_ASSERT(st.fsyncs >= 1);
+
+        kelp_audit_shutdown();
+
+        FILE *fp = fopen(path, "r");
+        TEST_ASSERT(fp != NULL);
+        char line[4096];
+        int lines = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            if (strstr(line, "\"object\":\"/tmp/out\""))
+                lines++;
+        }
+        fclose(fp);
+        unlink(path);
+        TEST_ASSERT(lines == 100);
+    } TEST_END();
+
+    TEST_BEGIN("async writer does not truncate long fields") {
+        char path[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        TEST_ASSERT(kelp_audit_init_async(path, NULL) == 0);
+
+        char detail[6000];
+        memset(detail, 'd', sizeof(detail) - 1);
+        detail[sizeof(detail) - 1] = '\0';
+        kelp_audit_event_t ev = {
+            .level    = KELP_AUDIT_INFO,
+            .category = "tool",
+            .action   = "exec",
+            .subject  = "agent",
+            .object   = "bash",
+            .detail   = detail,
+            .allowed  = true,
+        };
+        kelp_audit_log(&ev);
+        detail[0] = 'X';   /* the queued copy must not see this */
+        kelp_audit_shutdown();
+
+        FILE *fp = fopen(path, "r");
+        TEST_ASSERT(fp != NULL);
+        static char line[8192];
+        char *got = fgets(line, sizeof(line), fp);
+        fclose(fp);
+        unlink(path);
+
+        TEST_ASSERT(got != NULL);
+        TEST_ASSERT(strstr(line, "\"detail\":\"ddd") != NULL);
+        TEST_ASSERT(strlen(line) > sizeof(detail));
+        TEST_ASSERT(strstr(line, "\"allowed\":true}") != NULL);
+    } TEST_END();
+
+    TEST_BEGIN("async writer rotates by size") {
+        char path[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        kelp_audit_async_opts_t opts = {
+            .batch_max    = 1,
+            .rotate_bytes = 1024,
+            .rotate_keep  = 2,
+        };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+
+        kelp_audit_event_t ev = {
+            .level    = KELP_AUDIT_INFO,
+            .category = "net",
+            .action   = "connect",
+            .subject  = "agent",
+            .object   = "https://example.com/",
+            .allowed  = true,
+        };
+        for (int i = 0; i < 50; i++)
+            kelp_audit_log(&ev);
+        kelp_audit_flush();
+
+        kelp_audit_stats_t st;
+        kelp_audit_get_stats(&st);
+        kelp_audit_shutdown();
+
+        char rotated[sizeof(path) + 8];
+        struct stat sb;
+        snprintf(rotated, sizeof(rotated), "%s.1", path);
+        TEST_ASSERT(st.rotations >= 2);
+        TEST_ASSERT(stat(rotated, &sb) == 0);
+        TEST_ASSERT(sb.st_size <= 1024);
+        TEST_ASSERT(stat(path, &sb) == 0 && sb.st_size <= 1024);
+        unlink(rotated);
+        snprintf(rotated, sizeof(rotated), "%s.2", path);
+        TEST_ASSERT(stat(rotated, &sb) == 0);
+        unlink(rotated);
+        snprintf(rotated, sizeof(rotated), "%s.3", path);
+        TEST_ASSERT(stat(rotated, &sb) != 0);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("async writer reopens a log it could not rotate into") {
+        char dir[] = "/tmp/kelp_test_auditdir_XXXXXX";
+        TEST_ASSERT(mkdtemp(dir) != NULL);
+        char path[sizeof(dir) + 16], rotated[sizeof(dir) + 16];
+        snprintf(path, sizeof(path), "%s/audit.jsonl", dir);
+        snprintf(rotated, sizeof(rotated), "%s.1", path);
+
+        kelp_audit_async_opts_t opts = {
+            .batch_max    = 1,
+            .rotate_bytes = 256,
+        };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+
+        kelp_audit_event_t ev = {
+            .level    = KELP_AUDIT_INFO,
+            .category = "net",
+            .action   = "connect",
+            .subject  = "agent",
+            .object   = "https://example.com/",
+            .allowed  = true,
+        };
+        kelp_audit_log(&ev);
+        kelp_audit_flush();
+
+        /* With the directory gone, rotation cannot open a new log. */
+        unlink(path);
+        TEST_ASSERT(rmdir(dir) == 0);
+        for (int i = 0; i < 10; i++)
+            kelp_audit_log(&ev);
+        kelp_audit_flush();
+
+        kelp_audit_stats_t st;
+        kelp_audit_get_stats(&st);
+        TEST_ASSERT(st.write_errors >= 8);
+        uint64_t errors = st.write_errors;
+
+        /* Once it can, the next batch reopens the log and lands in it. */
+        TEST_ASSERT(mkdir(dir, 0700) == 0);
+        kelp_audit_log(&ev);
+        kelp_audit_flush();
+        kelp_audit_get_stats(&st);
+        kelp_audit_shutdown();
+
+        struct stat sb;
+        TEST_ASSERT(st.write_errors == errors);
+        TEST_ASSERT(stat(path, &sb) == 0 && sb.st_size > 0);
+        unlink(path);
+        unlink(rotated);
+        rmdir(dir);
+    } TEST_END();
+
+    TEST_BEGIN("async queue drops or blocks when full") {
+        char path[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        kelp_audit_event_t ev = {
+            .level    = KELP_AUDIT_INFO,
+            .category = "fs",
+            .action   = "read",
+            .subject  = "agent",
+            .object   = "/etc/hostname",
+            .allowed  = true,
+        };
+
+        /* A slow sink keeps the writer busy so the 2-slot ring fills. */
+        kelp_audit_async_opts_t opts = { .ring_size = 2, .batch_max = 1 };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+        TEST_ASSERT(kelp_audit_add_sink(slow_sink, NULL) == 0);
+        for (int i = 0; i < 50; i++)
+            kelp_audit_log(&ev);
+        kelp_audit_flush();
+
+        kelp_audit_stats_t st;
+        kelp_audit_get_stats(&st);
+        TEST_ASSERT(st.dropped > 0);
+        TEST_ASSERT(st.enqueued + st.dropped == 50);
+        TEST_ASSERT(st.written == st.enqueued);
+        kelp_audit_shutdown();
+
+        opts.on_full = KELP_AUDIT_FULL_BLOCK;
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+        TEST_ASSERT(kelp_audit_add_sink(slow_sink, NULL) == 0);
+        for (int i = 0; i < 50; i++)
+            kelp_audit_log(&ev);
+        kelp_audit_flush();
+
+        kelp_audit_get_stats(&st);
+        TEST_ASSERT(st.dropped == 0);
+        TEST_ASSERT(st.blocked > 0);
+        TEST_ASSERT(st.written == 50);
+        kelp_audit_shutdown();
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("async producers from many threads") {
+        char path[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        kelp_audit_async_opts_t opts = {
+            .ring_size = 64,
+            .on_full   = KELP_AUDIT_FULL_BLOCK,
+        };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+
+        pthread_t th[4];
+        for (int i = 0; i < 4; i++)
+            pthread_create(&th[i], NULL, audit_producer, NULL);
+        for (int i = 0; i < 4; i++)
+            pthread_join(th[i], NULL);
+
+        kelp_audit_shutdown();
+
+        FILE *fp = fopen(path, "r");
+        TEST_ASSERT(fp != NULL);
+        char line[4096];
+        int lines = 0, bad = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            lines++;
+            if (line[0] != '{' || !strstr(line, "}\n"))
+                bad++;
+        }
+        fclose(fp);
+        unlink(path);
+        TEST_ASSERT(lines == 4 * 1000);
+        TEST_ASSERT(bad == 0);
+    } TEST_END();
+}
+
+/* ---- audit segment tests ------------------------------------------------ */
+
+static int count_cb(const kelp_audit_event_t *event, void *userdata)
+{
+    (void)event;
+    (*(int *)userdata)++;
+    return 0;
+}
+
+static kelp_audit_event_t seg_last;
+static char seg_last_object[8192];
+
+static int keep_cb(const kelp_audit_event_t *event, void *userdata)
+{
+    (void)userdata;
+    seg_last = *event;
+    snprintf(seg_last_object, sizeof(seg_last_object), "%s",
+             event->object ? event->object : "");
+    return 0;
+}
+
+/* 1000 events, one per second from t0, over 3 subjects and 2 categories. */
+static void write_sample_segment(const char *path, time_t t0, bool close_it)
+{
+    static const char *subjects[] = { "alice", "bob", "carol" };
+    kelp_audit_segment_writer_t *w = kelp_audit_segment_create(path);
+    char obj[64];
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(obj, sizeof(obj), "/srv/file%d", i);
+        kelp_audit_event_t ev = {
+            .level     = (i % 10 == 0) ? KELP_AUDIT_VIOLATION : KELP_AUDIT_INFO,
+            .timestamp = t0 + i,
+            .category  = (i % 2) ? "net" : "fs",
+            .action    = (i % 2) ? "connect" : "read",
+            .subject   = subjects[i % 3],
+            .object    = obj,
+            .detail    = (i % 10 == 0) ? "blocked by policy" : NULL,
+            .allowed   = i % 10 != 0,
+        };
+        kelp_audit_segment_append(w, &ev);
+        if (i % 100 == 99)
+            kelp_audit_segment_flush(w);
+    }
+
+    if (close_it)
+        kelp_audit_segment_close(w);
+    else
+        kelp_audit_segment_flush(w);   /* caller exits without a footer */
+}
+
+static void test_audit_segment(void)
+{
+    fprintf(stderr, "\n=== Audit Segments ===\n");
+
+    const time_t t0 = 1700000000;
+
+    TEST_BEGIN("segment round trip and summary") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        write_sample_segment(path, t0, true);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+
+        kelp_audit_segment_info_t info;
+        kelp_audit_segment_info(seg, &info);
+        TEST_ASSERT(info.indexed);
+        TEST_ASSERT(info.events == 1000);
+        TEST_ASSERT(info.min_time == t0);
+        TEST_ASSERT(info.max_time == t0 + 999);
+        TEST_ASSERT(info.strings == 4);
+        TEST_ASSERT(info.blocks >= 3);
+
+        int n = 0;
+        TEST_ASSERT(kelp_audit_segment_query(seg, NULL, count_cb, &n) == 1000);
+        TEST_ASSERT(n == 1000);
+
+        /* The last event decodes intact. */
+        kelp_audit_segment_query(seg, NULL, keep_cb, NULL);
+        TEST_ASSERT(strcmp(seg_last_object, "/srv/file999") == 0);
+
+        kelp_audit_segment_free(seg);
+
+        struct stat st;
+        stat(path, &st);
+        /* Well under the ~170 bytes per event of the JSONL form. */
+        TEST_ASSERT(st.st_size < 1000 * 40);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("segment query filters") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        write_sample_segment(path, t0, true);
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+
+        kelp_audit_query_t q = { .allowed = -1 };
+        q.since = t0 + 100;
+        q.until = t0 + 199;
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 100);
+
+        q = (kelp_audit_query_t){ .allowed = -1, .subject = "bob" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 333);
+
+        q = (kelp_audit_query_t){ .allowed = -1, .category = "net" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 500);
+
+        q = (kelp_audit_query_t){ .allowed = -1, .category = "exec" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 0);
+
+        q = (kelp_audit_query_t){ .allowed = 0 };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 100);
+
+        q = (kelp_audit_query_t){ .allowed = -1,
+                                  .min_level = KELP_AUDIT_ALERT };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 100);
+
+        /* Combined: denied fs events for alice in the first 300 seconds. */
+        q = (kelp_audit_query_t){ .allowed = 0, .subject = "alice",
+                                  .category = "fs", .until = t0 + 299 };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, keep_cb, NULL) == 10);
+        TEST_ASSERT(seg_last.timestamp == t0 + 270);
+        TEST_ASSERT(strcmp(seg_last.detail, "blocked by policy") == 0);
+        TEST_ASSERT(seg_last.level == KELP_AUDIT_VIOLATION);
+        TEST_ASSERT(!seg_last.allowed);
+
+        kelp_audit_segment_free(seg);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("segment without footer is still readable") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        /* The child dies mid-segment: records on disk, no footer. */
+        pid_t pid = fork();
+        TEST_ASSERT(pid >= 0);
+        if (pid == 0) {
+            write_sample_segment(path, t0, false);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+
+        /* Tear the last record in half as well. */
+        struct stat st;
+        stat(path, &st);
+        TEST_ASSERT(truncate(path, st.st_size - 3) == 0);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+
+        kelp_audit_segment_info_t info;
+        kelp_audit_segment_info(seg, &info);
+        TEST_ASSERT(!info.indexed);
+        TEST_ASSERT(info.events == 999);
+
+        kelp_audit_query_t q = { .allowed = -1, .subject = "carol" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 333);
+
+        kelp_audit_segment_free(seg);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("reopened segment keeps appending") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        /* One closed run, then one that dies with a torn tail. */
+        write_sample_segment(path, t0, true);
+
+        pid_t pid = fork();
+        TEST_ASSERT(pid >= 0);
+        if (pid == 0) {
+            kelp_audit_segment_writer_t *w = kelp_audit_segment_reopen(path);
+            if (!w)
+                _exit(1);
+            kelp_audit_event_t ev = {
+                .level = KELP_AUDIT_INFO, .timestamp = t0 + 2000,
+                .category = "fs", .action = "read",
+                .subject = "alice", .object = "/srv/late", .allowed = true,
+            };
+            kelp_audit_segment_append(w, &ev);
+            kelp_audit_segment_append(w, &ev);
+            kelp_audit_segment_flush(w);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        struct stat st;
+        stat(path, &st);
+        TEST_ASSERT(truncate(path, st.st_size - 3) == 0);
+
+        /* Third run: old strings stay interned, new ones get added. */
+        kelp_audit_segment_writer_t *w = kelp_audit_segment_reopen(path);
+        TEST_ASSERT(w != NULL);
+        kelp_audit_event_t ev = {
+            .level = KELP_AUDIT_ALERT, .timestamp = t0 + 3000,
+            .category = "exec", .action = "spawn",
+            .subject = "bob", .object = "/bin/sh", .allowed = false,
+        };
+        TEST_ASSERT(kelp_audit_segment_append(w, &ev) == 0);
+        kelp_audit_segment_close(w);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+        kelp_audit_segment_info_t info;
+        kelp_audit_segment_info(seg, &info);
+        TEST_ASSERT(info.indexed);
+        TEST_ASSERT(info.events == 1002);
+
+        kelp_audit_query_t q = { .allowed = -1, .subject = "bob" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, keep_cb, NULL) == 334);
+        TEST_ASSERT(seg_last.timestamp == t0 + 3000);
+        TEST_ASSERT(strcmp(seg_last_object, "/bin/sh") == 0);
+        q = (kelp_audit_query_t){ .allowed = -1, .subject = "alice" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, NULL, NULL) == 335);
+
+        kelp_audit_segment_free(seg);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("reopen sets a damaged segment aside") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+        write_sample_segment(path, t0, false);
+
+        /* Zero the first record's length: everything after it is intact. */
+        struct stat before;
+        stat(path, &before);
+        fd = open(path, O_WRONLY);
+        TEST_ASSERT(fd >= 0);
+        TEST_ASSERT(pwrite(fd, "", 1, 32) == 1);
+        close(fd);
+
+        kelp_audit_segment_writer_t *w = kelp_audit_segment_reopen(path);
+        TEST_ASSERT(w != NULL);
+        kelp_audit_event_t ev = {
+            .level = KELP_AUDIT_INFO, .timestamp = t0 + 5000,
+            .category = "fs", .action = "read",
+            .subject = "dave", .object = "/srv/new", .allowed = true,
+        };
+        TEST_ASSERT(kelp_audit_segment_append(w, &ev) == 0);
+        TEST_ASSERT(kelp_audit_segment_close(w) == 0);
+
+        char aside[sizeof(path) + 16];
+        snprintf(aside, sizeof(aside), "%s.damaged.1", path);
+        struct stat st;
+        TEST_ASSERT(stat(aside, &st) == 0);
+        TEST_ASSERT(st.st_size == before.st_size);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+        kelp_audit_segment_info_t info;
+        kelp_audit_segment_info(seg, &info);
+        TEST_ASSERT(info.events == 1);
+        kelp_audit_segment_free(seg);
+
+        unlink(aside);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("reopen leaves non-segment files alone") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        TEST_ASSERT(write(fd, "{\"not\":\"a segment\"}\n", 20) == 20);
+        close(fd);
+
+        errno = 0;
+        TEST_ASSERT(kelp_audit_segment_reopen(path) == NULL);
+        TEST_ASSERT(errno == EINVAL);
+        struct stat st;
+        stat(path, &st);
+        TEST_ASSERT(st.st_size == 20);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("non-segment files are rejected") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        TEST_ASSERT(write(fd, "{\"not\":\"a segment\"}\n{}\n{}\n", 26) == 26);
+        close(fd);
+
+        TEST_ASSERT(kelp_audit_segment_open(path) == NULL);
+        TEST_ASSERT(kelp_audit_segment_open("/nonexistent/seg") == NULL);
+        unlink(path);
+    } TEST_END();
+
+    TEST_BEGIN("JSONL log converts to a segment") {
+        char jsonl[] = "/tmp/kelp_test_audit_XXXXXX";
+        int fd = mkstemp(jsonl);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+
+        TEST_ASSERT(kelp_audit_init(jsonl) == 0);
+        static char big[5000];
+        memset(big, 'x', sizeof(big) - 1);
+        for (int i = 0; i < 50; i++) {
+            kelp_audit_event_t ev = {
+                .level     = (i == 7) ? KELP_AUDIT_ALERT : KELP_AUDIT_INFO,
+                .timestamp = t0 + i,
+                .category  = "exec",
+                .action    = "spawn",
+                .subject   = "agent \"q\"",
+                .object    = (i == 7) ? big : "/bin/ls",
+                .allowed   = i != 7,
+            };
+            kelp_audit_log(&ev);
+        }
+        kelp_audit_shutdown();
+
+        /* A garbage line is skipped, not fatal. */
+        FILE *fp = fopen(jsonl, "a");
+        fputs("not json\n", fp);
+        fclose(fp);
+
+        char seg_path[sizeof(jsonl) + 8];
+        snprintf(seg_path, sizeof(seg_path), "%s.seg", jsonl);
+        size_t converted = 0, skipped = 0;
+        TEST_ASSERT(kelp_audit_jsonl_to_segment(jsonl, seg_path,
+                                                &converted, &skipped) == 0);
+        TEST_ASSERT(converted == 50);
+        TEST_ASSERT(skipped == 1);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(seg_path);
+        TEST_ASSERT(seg != NULL);
+        kelp_audit_query_t q = { .allowed = 0, .subject = "agent \"q\"" };
+        TEST_ASSERT(kelp_audit_segment_query(seg, &q, keep_cb, NULL) == 1);
+        TEST_ASSERT(seg_last.timestamp == t0 + 7);
+        TEST_ASSERT(seg_last.level == KELP_AUDIT_ALERT);
+        TEST_ASSERT(strlen(seg_last_object) == sizeof(big) - 1);
+        TEST_ASSERT(seg_last.detail == NULL);
+        kelp_audit_segment_free(seg);
+
+        unlink(seg_path);
+        unlink(jsonl);
+    } TEST_END();
+
+    TEST_BEGIN("async writer emits rotated segments") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+        unlink(path);
+
+        kelp_audit_async_opts_t opts = {
+            .format       = KELP_AUDIT_FORMAT_SEGMENT,
+            .batch_max    = 16,
+            .rotate_bytes = 4096,
+            .rotate_keep  = 8,
+        };
+        TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+        for (int i = 0; i < 300; i++) {
+            kelp_audit_event_t ev = {
+                .level     = KELP_AUDIT_INFO,
+                .timestamp = t0 + i,
+                .category  = "fs",
+                .action    = "write",
+                .subject   = "agent",
+                .object    = "/var/lib/kelp/state.db",
+                .allowed   = true,
+            };
+            kelp_audit_log(&ev);
+            if (i % 50 == 49)
+                kelp_audit_flush();
+        }
+        kelp_audit_shutdown();
+
+        /* Every event lands in exactly one closed, indexed segment. */
+        uint64_t total = 0;
+        int files = 0;
+        for (int i = 0; i <= 8; i++) {
+            char p[sizeof(path) + 8];
+            if (i == 0)
+                snprintf(p, sizeof(p), "%s", path);
+            else
+                snprintf(p, sizeof(p), "%s.%d", path, i);
+            kelp_audit_segment_t *seg = kelp_audit_segment_open(p);
+            if (!seg)
+                continue;
+            kelp_audit_segment_info_t info;
+            kelp_audit_segment_info(seg, &info);
+            TEST_ASSERT(info.indexed);
+            total += info.events;
+            files++;
+            kelp_audit_segment_free(seg);
+            unlink(p);
+        }
+        TEST_ASSERT(files >= 2);
+        TEST_ASSERT(total == 300);
+    } TEST_END();
+
+    TEST_BEGIN("restarting the async writer keeps the segment") {
+        char path[] = "/tmp/kelp_test_seg_XXXXXX";
+        int fd = mkstemp(path);
+        TEST_ASSERT(fd >= 0);
+        close(fd);
+        unlink(path);
+
+        kelp_audit_async_opts_t opts = {
+            .format       = KELP_AUDIT_FORMAT_SEGMENT,
+            .rotate_bytes = 1 << 20,
+            .rotate_keep  = 2,
+        };
+        for (int run = 0; run < 3; run++) {
+            TEST_ASSERT(kelp_audit_init_async(path, &opts) == 0);
+            for (int i = 0; i < 10; i++) {
+                kelp_audit_event_t ev = {
+                    .level     = KELP_AUDIT_INFO,
+                    .timestamp = t0 + run * 10 + i,
+                    .category  = "fs",
+                    .action    = "write",
+                    .subject   = "agent",
+                    .object    = "/var/lib/kelp/state.db",
+                    .allowed   = true,
+                };
+                kelp_audit_log(&ev);
+            }
+            kelp_audit_shutdown();
+        }
+
+        char old[sizeof(path) + 8];
+        snprintf(old, sizeof(old), "%s.1", path);
+        TEST_ASSERT(access(old, F_OK) != 0);
+
+        kelp_audit_segment_t *seg = kelp_audit_segment_open(path);
+        TEST_ASSERT(seg != NULL);
+        kelp_audit_segment_info_t info;
+        kelp_audit_segment_info(seg, &info);
+        TEST_ASSERT(info.indexed);
+        TEST_ASSERT(info.events == 30);
+        kelp_audit_segment_free(seg);
+        unlink(path);
+    } TEST_END();
 }
 
 /* ---- scan permissions test ---------------------------------------------- */
@@ -725,6 +1769,150 @@ static void test_scan_permissions(void)
     } TEST_END();
 }
 
+typedef struct {
+    int counts[KELP_FS_ISSUE_SYMLINK_ESCAPE + 1];
+} issue_counts_t;
+
+static void count_issue(const char *path, kelp_fs_issue_t issue,
+                        unsigned mode, void *userdata)
+{
+    (void)path;
+    (void)mode;
+    ((issue_counts_t *)userdata)->counts[issue]++;
+}
+
+static void make_file(const char *dir, const char *name, mode_t mode)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    if (f)
+        fclose(f);
+    chmod(path, mode);
+}
+
+/*
+ * root/
+ *   ww.txt (0666)  suid (04755)  sgid (02755)  out -> /etc  in -> sub
+ *   sub/   d<i>/   f<j> x 10 each, one 0666 file per d<i>
+ */
+static void build_scan_tree(const char *root, int ndirs)
+{
+    char path[PATH_MAX];
+
+    make_file(root, "ww.txt", 0666);
+    make_file(root, "suid", 04755);
+    make_file(root, "sgid", 02755);
+    snprintf(path, sizeof(path), "%s/sub", root);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/out", root);
+    symlink("/etc", path);
+    snprintf(path, sizeof(path), "%s/in", root);
+    symlink("sub", path);
+
+    for (int i = 0; i < ndirs; i++) {
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s/sub/d%d", root, i);
+        mkdir(dir, 0755);
+        for (int j = 0; j < 10; j++) {
+            char name[32];
+            snprintf(name, sizeof(name), "f%d", j);
+            make_file(dir, name, j == 0 ? 0666 : 0644);
+        }
+    }
+}
+
+static void test_parallel_scan(void)
+{
+    fprintf(stderr, "\n=== Parallel / Incremental Scanning ===\n");
+
+    char root[] = "/tmp/kelp_test_scan_XXXXXX";
+    char state[PATH_MAX + 16];
+    if (!mkdtemp(root))
+        return;
+    snprintf(state, sizeof(state), "%s.state", root);
+    build_scan_tree(root, 40);
+
+    TEST_BEGIN("parallel scan finds every issue kind") {
+        issue_counts_t ic = {0};
+        kelp_fs_scan_stats_t st;
+        kelp_fs_scan_opts_t opts = { .max_depth = -1, .threads = 4 };
+        int n = kelp_fs_scan(root, &opts, count_issue, &ic, &st);
+        TEST_ASSERT(n == 44);
+        TEST_ASSERT(ic.counts[KELP_FS_ISSUE_WORLD_WRITABLE] == 41);
+        TEST_ASSERT(ic.counts[KELP_FS_ISSUE_SETUID] == 1);
+        TEST_ASSERT(ic.counts[KELP_FS_ISSUE_SETGID] == 1);
+        TEST_ASSERT(ic.counts[KELP_FS_ISSUE_SYMLINK_ESCAPE] == 1);
+        TEST_ASSERT(st.dirs == 42);
+        TEST_ASSERT(st.entries == 6 + 40 + 400);
+        TEST_ASSERT(st.statx_calls == st.entries);
+    } TEST_END();
+
+    TEST_BEGIN("single worker matches parallel result") {
+        kelp_fs_scan_opts_t opts = { .max_depth = -1, .threads = 1 };
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, NULL) == 44);
+    } TEST_END();
+
+    TEST_BEGIN("depth limit") {
+        kelp_fs_scan_opts_t opts = { .max_depth = 0, .threads = 2 };
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, NULL) == 4);
+        TEST_ASSERT(kelp_fs_scan_permissions(root, 0) == 4);
+        TEST_ASSERT(kelp_fs_scan_permissions(root, 2) == 44);
+    } TEST_END();
+
+    TEST_BEGIN("incremental rescan reuses unchanged directories") {
+        kelp_fs_scan_stats_t st;
+        kelp_fs_scan_opts_t opts = {
+            .max_depth = -1, .threads = 4,
+            .state_path = state, .incremental = true,
+        };
+        unlink(state);
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, &st) == 44);
+        TEST_ASSERT(st.dirs_reused == 0);
+
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, &st) == 44);
+        TEST_ASSERT(st.dirs_reused == 42);
+        /* only subdirectories are statx'd: sub + d0..d39 */
+        TEST_ASSERT(st.statx_calls == 41);
+
+        /* A new file changes its directory's mtime: only that one is re-read */
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s/sub/d7", root);
+        make_file(dir, "new", 0777);
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, &st) == 45);
+        TEST_ASSERT(st.dirs_reused == 41);
+        TEST_ASSERT(st.statx_calls == 41 + 11);
+    } TEST_END();
+
+    TEST_BEGIN("corrupt state file is ignored") {
+        FILE *f = fopen(state, "r+");
+        if (f) {
+            fseek(f, 40, SEEK_SET);
+            fputs("garbage", f);
+            fclose(f);
+        }
+        kelp_fs_scan_stats_t st;
+        kelp_fs_scan_opts_t opts = {
+            .max_depth = -1, .threads = 2,
+            .state_path = state, .incremental = true,
+        };
+        TEST_ASSERT(kelp_fs_scan(root, &opts, NULL, NULL, &st) == 45);
+        TEST_ASSERT(st.dirs_reused < 42);
+    } TEST_END();
+
+    TEST_BEGIN("scan a file is an error") {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/ww.txt", root);
+        TEST_ASSERT(kelp_fs_scan(path, NULL, NULL, NULL, NULL) == -1);
+    } TEST_END();
+
+    unlink(state);
+    char cmd[PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    if (system(cmd) != 0)
+        fprintf(stderr, "  (could not remove %s)\n", root);
+}
+
 
 /* ---- timing-safe comparison tests --------------------------------------- */
 
@@ -817,8 +2005,11 @@ int main(void)
     test_fs_permissions();
     test_policy();
     test_path_scanner();
+    test_decision_cache();
     test_audit();
+    test_audit_segment();
     test_scan_permissions();
+    test_parallel_scan();
     test_timing_safe_cmp();
 
     fprintf(stderr, "\n============================\n");
@@ -0,0 +1,804 @@
+/*
+ * kelp-linux :: integration tests
+ * load_telegram.c - Load test for kelp-channel-telegram
+ *
+ * Runs the real bridge binary against two local mocks:
+ *
+ *   - a Telegram Bot API server on 127.0.0.1 (getMe, getUpdates,
+ *     sendChatAction, sendMessage, editMessageText) holding N messages spread over M
+ *     chats.  Its first getUpdates fails, so the bridge has to back off
+ *     and retry.
+ *   - a kelp-gateway Unix socket that answers every chat.send after a
+ *     fixed delay, like a model call, and counts concurrent requests.
+ *
+ * The bridge runs once with one worker (the old sequential behaviour)
+ * and once with a pool.  Each run must deliver every reply, in order
+ * within each chat.  The pool run must also overlap gateway calls and
+ * poll getUpdates while calls are in flight.  Elapsed time for both
+ * runs is printed.
+ *
+ * A third run streams: the gateway sends each reply as chat.delta pieces
+ * over a couple of seconds and the Bot API refuses some editMessageText
+ * calls with a 429.  Every reply must be posted while it is still being
+ * generated, grown in place, and end up complete in a single message.
+ *
+ * A last run sends SIGTERM as soon as the bridge has fetched every update,
+ * long before it can have answered them.  The bridge must still answer
+ * all of them before it exits.
+ *
+ * Usage: load_telegram <kelp-channel-telegram> [messages] [chats] [delay_ms]
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kelp/json.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CHATS        64
+#define MAX_MESSAGES     4096
+#define UPDATES_PER_POLL 20
+#define CHAT_ID_BASE     5000000000LL   /* above 32 bits on purpose */
+#define RUN_TIMEOUT_SEC  60
+
+#define STREAM_MESSAGES  16
+#define STREAM_CHATS     8
+#define STREAM_MS        2400           /* time to generate one reply */
+#define STREAM_DELTAS    6
+#define STREAM_TAIL      " the quick brown fox jumps over the lazy dog"
+#define REFUSE_EVERY     4              /* edits answered with a 429 */
+
+#define DRAIN_MESSAGES   32
+#define DRAIN_CHATS      4
+#define DRAIN_MS         400            /* 8 per chat outlast the 2 s poll hold */
+
+typedef struct {
+    /* Parameters */
+    int              messages;
+    int              chats;
+    int              delay_ms;
+    bool             stream;            /* reply in chat.delta pieces */
+    bool             stop_early;        /* SIGTERM once all are fetched */
+
+    /* Telegram mock */
+    int              http_fd;
+    int              http_port;
+    pthread_t        http_tid;
+    atomic_int       http_active;       /* open HTTP connections */
+    atomic_int       polls;
+    atomic_int       polls_during_work; /* getUpdates with calls in flight */
+    atomic_bool      failed_once;
+    atomic_int       fetched;           /* updates handed out so far */
+
+    /* Gateway mock */
+    char             sock_path[108];
+    int              gw_fd;
+    pthread_t        gw_tid;
+    atomic_int       inflight;
+    atomic_int       max_inflight;
+
+    /* Replies seen by sendMessage */
+    pthread_mutex_t  lock;
+    int              replies;
+    int              next_seq[MAX_CHATS];
+    int              out_of_order;
+    int              replies_at_stop;   /* when SIGTERM was sent */
+    atomic_bool      done;
+
+    /* Messages as the chat shows them, by message_id - 1 (under lock) */
+    char            *texts[MAX_MESSAGES];
+    int              text_seq[MAX_MESSAGES];
+    bool             streaming[MAX_CHATS];  /* gateway still generating */
+    double           stream_start[MAX_CHATS];
+    int              early_posts;       /* posted before the reply ended */
+    double           first_post_sum;    /* seconds from call to post */
+    int              edit_calls;
+    int              edits_during_stream;
+    int              rate_limited;
+} load_state_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        data += n;
+        len  -= (size_t)n;
+    }
+}
+
+/* The complete reply to message `seq`. */
+static void reply_text(char *buf, size_t size, int seq)
+{
+    snprintf(buf, size, "re:m%d" STREAM_TAIL, seq);
+}
+
+/* ---- Gateway mock ------------------------------------------------------- */
+
+typedef struct {
+    load_state_t    *st;
+    int              fd;
+    pthread_mutex_t *wlock;
+    cJSON           *req;
+} gw_request_t;
+
+/* Write one newline-delimited message and free it. */
+static void gw_send(gw_request_t *r, cJSON *msg)
+{
+    char *line = cJSON_PrintUnformatted(msg);
+    cJSON_Delete(msg);
+    if (!line)
+        return;
+
+    size_t len = strlen(line);
+    line[len] = '\n';           /* replaces the NUL; length passed below */
+    pthread_mutex_lock(r->wlock);
+    write_all(r->fd, line, len + 1);
+    pthread_mutex_unlock(r->wlock);
+    free(line);
+}
+
+/* Send `content` as chat.delta pieces spread over the reply time. */
+static void gw_stream(gw_request_t *r, int chat, const char *content)
+{
+    load_state_t *st = r->st;
+    size_t len = strlen(content);
+    size_t piece = (len + STREAM_DELTAS - 1) / STREAM_DELTAS;
+
+    pthread_mutex_lock(&st->lock);
+    st->streaming[chat]    = true;
+    st->stream_start[chat] = now_sec();
+    pthread_mutex_unlock(&st->lock);
+
+    for (size_t off = 0; off < len; off += piece) {
+        char text[128];
+        snprintf(text, sizeof(text), "%.*s",
+                 (int)(len - off < piece ? len - off : piece), content + off);
+        sleep_ms(st->delay_ms / STREAM_DELTAS);
+
+        cJSON *note = cJSON_CreateObject();
+        cJSON_AddStringToObject(note, "jsonrpc", "2.0");
+        cJSON_AddStringToObject(note, "method", "chat.delta");
+        cJSON *params = cJSON_AddObjectToObject(note, "params");
+        cJSON_AddNumberToObject(params, "id",
+                                kelp_json_get_int(r->req, "id", 0));
+        cJSON_AddStringToObject(params, "text", text);
+        gw_send(r, note);
+    }
+
+    pthread_mutex_lock(&st->lock);
+    st->streaming[chat] = false;
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void *gw_request_thread(void *arg)
+{
+    gw_request_t *r = arg;
+    load_state_t *st = r->st;
+
+    int now = atomic_fetch_add(&st->inflight, 1) + 1;
+    int max = atomic_load(&st->max_inflight);
+    while (now > max && !atomic_compare_exchange_weak(&st->max_inflight,
+                                                      &max, now))
+        ;
+
+    cJSON *params = kelp_json_get_object(r->req, "params");
+    const char *msg = kelp_json_get_string(params, "message");
+    const char *channel = kelp_json_get_string(params, "channel_id");
+    int chat = channel ? (int)(strtoll(channel, NULL, 10) - CHAT_ID_BASE) : -1;
+    int seq = -1;
+    char content[256];
+
+    if (st->stream) {
+        if (msg)
+            sscanf(msg, "m%d", &seq);
+        reply_text(content, sizeof(content), seq);
+    } else {
+        snprintf(content, sizeof(content), "re:%s", msg ? msg : "");
+    }
+
+    if (st->stream && kelp_json_get_bool(params, "stream", false) &&
+        chat >= 0 && chat < st->chats)
+        gw_stream(r, chat, content);
+    else
+        sleep_ms(st->delay_ms);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "jsonrpc", "2.0");
+    cJSON_AddNumberToObject(resp, "id", kelp_json_get_int(r->req, "id", 0));
+    cJSON *result = cJSON_AddObjectToObject(resp, "result");
+    cJSON_AddStringToObject(result, "content", content);
+
+    atomic_fetch_sub(&st->inflight, 1);
+    gw_send(r, resp);
+    cJSON_Delete(r->req);
+    free(r);
+    return NULL;
+}
+
+typedef struct {
+    load_state_t *st;
+    int           fd;
+} gw_conn_t;
+
+static void *gw_conn_thread(void *arg)
+{
+    gw_conn_t *conn = arg;
+    pthread_mutex_t wlock = PTHREAD_MUTEX_INITIALIZER;
+    FILE *in = fdopen(dup(conn->fd), "r");
+    char *line = NULL;
+    size_t cap = 0;
+
+    while (in && getline(&line, &cap, in) > 0) {
+        gw_request_t *r = calloc(1, sizeof(*r));
+        pthread_t tid;
+
+        if (!r)
+            break;
+        *r = (gw_request_t){ conn->st, conn->fd, &wlock, cJSON_Parse(line) };
+        if (!r->req || pthread_create(&tid, NULL, gw_request_thread, r) != 0) {
+            cJSON_Delete(r->req);
+            free(r);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+
+    /* Answers still being written hold wlock and the fd. */
+    while (atomic_load(&conn->st->inflight) > 0)
+        sleep_ms(10);
+    pthread_mutex_lock(&wlock);
+    pthread_mutex_unlock(&wlock);
+    free(line);
+    if (in)
+        fclose(in);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+static void *gw_accept_thread(void *arg)
+{
+    load_state_t *st = arg;
+    int fd;
+
+    while ((fd = accept(st->gw_fd, NULL, NULL)) >= 0) {
+        gw_conn_t *conn = malloc(sizeof(*conn));
+        pthread_t tid;
+
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->st = st;
+        conn->fd = fd;
+        if (pthread_create(&tid, NULL, gw_conn_thread, conn) == 0) {
+            pthread_detach(tid);
+        } else {
+            close(fd);
+            free(conn);
+        }
+    }
+    return NULL;
+}
+
+/* ---- Telegram Bot API mock ---------------------------------------------- */
+
+static void http_reply(int fd, int status, const char *body)
+{
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     status, status == 200 ? "OK" :
+                             status == 429 ? "Too Many Requests" :
+                             status == 400 ? "Bad Request" : "Bad Gateway",
+                     strlen(body));
+    write_all(fd, head, (size_t)n);
+    write_all(fd, body, strlen(body));
+}
+
+static void http_reply_json(int fd, cJSON *result)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "ok", true);
+    cJSON_AddItemToObject(root, "result", result);
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    http_reply(fd, 200, body ? body : "{}");
+    free(body);
+}
+
+static cJSON *make_update(const load_state_t *st, int i)
+{
+    int chat = i % st->chats;
+    cJSON *u = cJSON_CreateObject();
+    cJSON_AddNumberToObject(u, "update_id", 1000 + i);
+    cJSON *msg = cJSON_AddObjectToObject(u, "message");
+    cJSON_AddNumberToObject(msg, "message_id", i + 1);
+    cJSON *c = cJSON_AddObjectToObject(msg, "chat");
+    cJSON_AddNumberToObject(c, "id", (double)(CHAT_ID_BASE + chat));
+    cJSON_AddStringToObject(c, "type", "private");
+    cJSON *from = cJSON_AddObjectToObject(msg, "from");
+    cJSON_AddNumberToObject(from, "id", (double)(CHAT_ID_BASE + chat));
+    cJSON_AddBoolToObject(from, "is_bot", false);
+    cJSON_AddStringToObject(from, "first_name", "load");
+    char text[32];
+    snprintf(text, sizeof(text), "m%d", i / st->chats);
+    cJSON_AddStringToObject(msg, "text", text);
+    return u;
+}
+
+static void handle_get_updates(load_state_t *st, int fd, const cJSON *body)
+{
+    if (!atomic_exchange(&st->failed_once, true)) {
+        http_reply(fd, 502, "{\"ok\":false,\"description\":\"mock outage\"}");
+        return;
+    }
+
+    atomic_fetch_add(&st->polls, 1);
+    if (atomic_load(&st->inflight) > 0)
+        atomic_fetch_add(&st->polls_during_work, 1);
+
+    int first = kelp_json_get_int(body, "offset", 0) - 1000;
+    if (first < 0)
+        first = 0;
+
+    /* Long-poll: nothing left, so hold the request until the run ends. */
+    if (first >= st->messages) {
+        for (int waited = 0; waited < 2000 && !atomic_load(&st->done);
+             waited += 20)
+            sleep_ms(20);
+        http_reply_json(fd, cJSON_CreateArray());
+        return;
+    }
+
+    cJSON *arr = cJSON_CreateArray();
+    int i;
+    for (i = first; i < st->messages && i < first + UPDATES_PER_POLL; i++)
+        cJSON_AddItemToArray(arr, make_update(st, i));
+    http_reply_json(fd, arr);
+    if (i > atomic_load(&st->fetched))
+        atomic_store(&st->fetched, i);
+}
+
+static void handle_send_message(load_state_t *st, int fd, const cJSON *body)
+{
+    const cJSON *id = cJSON_GetObjectItemCaseSensitive(body, "chat_id");
+    const char *text = kelp_json_get_string(body, "text");
+    int chat = cJSON_IsNumber(id)
+             ? (int)((int64_t)id->valuedouble - CHAT_ID_BASE) : -1;
+    int seq = -1;
+
+    if (text)
+        sscanf(text, "re:m%d", &seq);
+
+    pthread_mutex_lock(&st->lock);
+    if (chat < 0 || chat >= st->chats || seq != st->next_seq[chat]) {
+        fprintf(stderr, "  unexpected reply to chat %d: %s\n", chat,
+                text ? text : "(null)");
+        st->out_of_order++;
+    } else {
+        st->next_seq[chat]++;
+        if (st->streaming[chat]) {
+            st->early_posts++;
+            st->first_post_sum += now_sec() - st->stream_start[chat];
+        }
+    }
+    int message_id = ++st->replies;
+    if (message_id <= MAX_MESSAGES) {
+        st->texts[message_id - 1]    = strdup(text ? text : "");
+        st->text_seq[message_id - 1] = seq;
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddNumberToObject(msg, "message_id", message_id);
+    http_reply_json(fd, msg);
+}
+
+static void handle_edit_message(load_state_t *st, int fd, const cJSON *body)
+{
+    const cJSON *id = cJSON_GetObjectItemCaseSensitive(body, "chat_id");
+    const char *text = kelp_json_get_string(body, "text");
+    int message_id = kelp_json_get_int(body, "message_id", 0);
+    int chat = cJSON_IsNumber(id)
+             ? (int)((int64_t)id->valuedouble - CHAT_ID_BASE) : -1;
+
+    pthread_mutex_lock(&st->lock);
+    bool known = text && message_id >= 1 && message_id <= st->replies &&
+                 message_id <= MAX_MESSAGES && chat >= 0 && chat < st->chats;
+    bool refuse = known && ++st->edit_calls % REFUSE_EVERY == 1;
+    if (known && st->streaming[chat])
+        st->edits_during_stream++;
+    if (refuse) {
+        st->rate_limited++;
+    } else if (known) {
+        free(st->texts[message_id - 1]);
+        st->texts[message_id - 1] = strdup(text);
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    if (!known)
+        http_reply(fd, 400, "{\"ok\":false,\"error_code\":400,"
+                            "\"description\":\"Bad Request: message to edit "
+                            "not found\"}");
+    else if (refuse)
+        http_reply(fd, 429, "{\"ok\":false,\"error_code\":429,"
+                            "\"description\":\"Too Many Requests: retry "
+                            "after 1\",\"parameters\":{\"retry_after\":1}}");
+    else
+        http_reply_json(fd, cJSON_CreateTrue());
+}
+
+/* Messages that show their complete reply (call with lock held). */
+static int complete_messages(const load_state_t *st)
+{
+    char want[256];
+    int n = 0;
+
+    for (int i = 0; i < st->replies && i < MAX_MESSAGES; i++) {
+        reply_text(want, sizeof(want), st->text_seq[i]);
+        if (st->texts[i] && strcmp(st->texts[i], want) == 0)
+            n++;
+    }
+    return n;
+}
+
+typedef struct {
+    load_state_t *st;
+    int           fd;
+} http_conn_t;
+
+static void *http_conn_thread(void *arg)
+{
+    http_conn_t *conn = arg;
+    load_state_t *st = conn->st;
+    char buf[65536];
+    size_t len = 0;
+    char *body = NULL;
+    size_t content_len = 0;
+
+    /* Headers, then Content-Length bytes of body. */
+    for (;;) {
+        ssize_t n = recv(conn->fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0)
+            goto out;
+        len += (size_t)n;
+        buf[len] = '\0';
+
+        char *end = strstr(buf, "\r\n\r\n");
+        if (!end) {
+            if (len == sizeof(buf) - 1)
+                goto out;
+            continue;
+        }
+        char *cl = strcasestr(buf, "Content-Length:");
+        content_len = cl && cl < end ? strtoul(cl + 15, NULL, 10) : 0;
+        body = end + 4;
+        if ((size_t)(buf + len - body) >= content_len)
+            break;
+        if (len == sizeof(buf) - 1)
+            goto out;
+    }
+    body[content_len] = '\0';
+
+    char method[16], path[512];
+    if (sscanf(buf, "%15s %511s", method, path) != 2)
+        goto out;
+    cJSON *json = cJSON_Parse(body);
+    const char *slash = strrchr(path, '/');
+    const char *api = slash ? slash + 1 : path;
+
+    if (strcmp(api, "getMe") == 0) {
+        cJSON *me = cJSON_CreateObject();
+        cJSON_AddNumberToObject(me, "id", 1);
+        cJSON_AddBoolToObject(me, "is_bot", true);
+        cJSON_AddStringToObject(me, "first_name", "Kelp");
+        cJSON_AddStringToObject(me, "username", "kelp_load_bot");
+        http_reply_json(conn->fd, me);
+    } else if (strcmp(api, "getUpdates") == 0) {
+        handle_get_updates(st, conn->fd, json);
+    } else if (strcmp(api, "sendMessage") == 0) {
+        handle_send_message(st, conn->fd, json);
+    } else if (strcmp(api, "editMessageText") == 0) {
+        handle_edit_message(st, conn->fd, json);
+    } else {
+        http_reply_json(conn->fd, cJSON_CreateTrue());
+    }
+    cJSON_Delete(json);
+
+out:
+    close(conn->fd);
+    atomic_fetch_sub(&st->http_active, 1);
+    free(conn);
+    return NULL;
+}
+
+static void *http_accept_thread(void *arg)
+{
+    load_state_t *st = arg;
+    int fd;
+
+    while ((fd = accept(st->http_fd, NULL, NULL)) >= 0) {
+        http_conn_t *conn = malloc(sizeof(*conn));
+        pthread_t tid;
+
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->st = st;
+        conn->fd = fd;
+        atomic_fetch_add(&st->http_active, 1);
+        if (pthread_create(&tid, NULL, http_conn_thread, conn) == 0) {
+            pthread_detach(tid);
+        } else {
+            atomic_fetch_sub(&st->http_active, 1);
+            close(fd);
+            free(conn);
+        }
+    }
+    return NULL;
+}
+
+/* ---- Harness ------------------------------------------------------------ */
+
+static int mocks_start(load_state_t *st)
+{
+    struct sockaddr_in sin = { .sin_family = AF_INET };
+    socklen_t slen = sizeof(sin);
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    st->http_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (st->http_fd < 0 ||
+        bind(st->http_fd, (struct sockaddr *)&sin, sizeof(sin)) != 0 ||
+        listen(st->http_fd, 128) != 0 ||
+        getsockname(st->http_fd, (struct sockaddr *)&sin, &slen) != 0) {
+        perror("mock Telegram API");
+        return -1;
+    }
+    st->http_port = ntohs(sin.sin_port);
+
+    snprintf(st->sock_path, sizeof(st->sock_path),
+             "/tmp/kelp-load-telegram-%d.sock", (int)getpid());
+    unlink(st->sock_path);
+    memcpy(sun.sun_path, st->sock_path, sizeof(st->sock_path));
+    st->gw_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (st->gw_fd < 0 ||
+        bind(st->gw_fd, (struct sockaddr *)&sun, sizeof(sun)) != 0 ||
+        listen(st->gw_fd, 16) != 0) {
+        perror("mock gateway");
+        return -1;
+    }
+
+    pthread_create(&st->http_tid, NULL, http_accept_thread, st);
+    pthread_create(&st->gw_tid, NULL, gw_accept_thread, st);
+    return 0;
+}
+
+static void mocks_stop(load_state_t *st)
+{
+    atomic_store(&st->done, true);
+    shutdown(st->http_fd, SHUT_RDWR);
+    shutdown(st->gw_fd, SHUT_RDWR);
+    pthread_join(st->http_tid, NULL);
+    pthread_join(st->gw_tid, NULL);
+    close(st->http_fd);
+    close(st->gw_fd);
+    unlink(st->sock_path);
+
+    /* Detached connection threads still read the state. */
+    while (atomic_load(&st->http_active) > 0 ||
+           atomic_load(&st->inflight) > 0)
+        sleep_ms(10);
+}
+
+static pid_t bridge_start(const char *bridge, const load_state_t *st,
+                          int workers)
+{
+    char api[128], nworkers[16];
+    snprintf(api, sizeof(api), "http://127.0.0.1:%d/bot", st->http_port);
+    snprintf(nworkers, sizeof(nworkers), "%d", workers);
+
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    setenv("NO_PROXY", "127.0.0.1", 1);
+    setenv("no_proxy", "127.0.0.1", 1);
+    if (!getenv("LOAD_TELEGRAM_VERBOSE")) {
+        FILE *null = freopen("/dev/null", "w", stderr);
+        (void)null;
+    }
+    execl(bridge, bridge, "--token", "000:load", "--socket", st->sock_path,
+          "--api-base", api, "--workers", nworkers, (char *)NULL);
+    perror(bridge);
+    _exit(127);
+}
+
+/* One run; returns elapsed seconds, or a negative value on failure. */
+static double run(const char *bridge, load_state_t *st, int workers)
+{
+    pthread_mutex_init(&st->lock, NULL);
+    if (mocks_start(st) != 0)
+        return -1;
+
+    double t0 = now_sec();
+    pid_t pid = bridge_start(bridge, st, workers);
+    if (pid < 0) {
+        mocks_stop(st);
+        return -1;
+    }
+
+    bool complete = false, signalled = false;
+    while (now_sec() - t0 < RUN_TIMEOUT_SEC) {
+        pthread_mutex_lock(&st->lock);
+        complete = st->replies >= st->messages &&
+                   (!st->stream || complete_messages(st) >= st->messages);
+        if (st->stop_early && !signalled &&
+            atomic_load(&st->fetched) >= st->messages) {
+            st->replies_at_stop = st->replies;
+            kill(pid, SIGTERM);
+            signalled = true;
+        }
+        pthread_mutex_unlock(&st->lock);
+        if (complete || waitpid(pid, NULL, WNOHANG) == pid)
+            break;
+        sleep_ms(5);
+    }
+    double elapsed = now_sec() - t0;
+
+    atomic_store(&st->done, true);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    mocks_stop(st);
+    pthread_mutex_destroy(&st->lock);
+
+    printf("  %2d worker(s): %3d/%d replies in %6.3f s  (%6.1f msg/s)  "
+           "max concurrent %d  polls %d (%d during calls)\n",
+           workers, st->replies, st->messages, elapsed,
+           st->replies / elapsed, atomic_load(&st->max_inflight),
+           atomic_load(&st->polls), atomic_load(&st->polls_during_work));
+    if (st->stream)
+        printf("      streaming: %d/%d complete, %d posted early (first post "
+               "after %.0f ms of %d), %d edits (%d while streaming, "
+               "%d rate-limited)\n",
+               complete_messages(st), st->messages, st->early_posts,
+               st->early_posts ? st->first_post_sum * 1000 / st->early_posts
+                               : 0.0,
+               st->delay_ms, st->edit_calls, st->edits_during_stream,
+               st->rate_limited);
+    for (int i = 0; i < MAX_MESSAGES; i++)
+        free(st->texts[i]);
+
+    if (!complete) {
+        fprintf(stderr, "  FAIL: missing replies\n");
+        return -1;
+    }
+    if (st->out_of_order > 0) {
+        fprintf(stderr, "  FAIL: %d replies out of order\n", st->out_of_order);
+        return -1;
+    }
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <kelp-channel-telegram> "
+                        "[messages] [chats] [delay_ms]\n", argv[0]);
+        return 2;
+    }
+
+    static load_state_t seq, par, str, drn;
+    int messages = argc > 2 ? atoi(argv[2]) : 64;
+    int chats    = argc > 3 ? atoi(argv[3]) : 8;
+    int delay    = argc > 4 ? atoi(argv[4]) : 40;
+    int workers  = chats < 8 ? chats : 8;
+
+    if (messages < 1 || messages > MAX_MESSAGES ||
+        chats < 1 || chats > MAX_CHATS || delay < 0) {
+        fprintf(stderr, "messages 1..%d, chats 1..%d, delay >= 0\n",
+                MAX_MESSAGES, MAX_CHATS);
+        return 2;
+    }
+
+    printf("Telegram bridge load test: %d messages, %d chats, %d ms per "
+           "gateway call\n", messages, chats, delay);
+
+    seq = (load_state_t){ .messages = messages, .chats = chats,
+                          .delay_ms = delay };
+    par = seq;
+
+    double t_seq = run(argv[1], &seq, 1);
+    double t_par = run(argv[1], &par, workers);
+    if (t_seq < 0 || t_par < 0)
+        return 1;
+
+    if (workers > 1 && atomic_load(&par.max_inflight) < 2) {
+        fprintf(stderr, "  FAIL: chats were not answered concurrently\n");
+        return 1;
+    }
+    if (atomic_load(&seq.max_inflight) > 1) {
+        fprintf(stderr, "  FAIL: one worker ran calls concurrently\n");
+        return 1;
+    }
+    if (messages > UPDATES_PER_POLL && atomic_load(&par.polls_during_work) < 1) {
+        fprintf(stderr, "  FAIL: getUpdates was not pipelined\n");
+        return 1;
+    }
+
+    printf("  speedup: %.1fx\n", t_seq / t_par);
+
+    printf("Streaming: %d messages, %d chats, %d ms per reply in %d pieces\n",
+           STREAM_MESSAGES, STREAM_CHATS, STREAM_MS, STREAM_DELTAS);
+    str = (load_state_t){ .messages = STREAM_MESSAGES, .chats = STREAM_CHATS,
+                          .delay_ms = STREAM_MS, .stream = true };
+    if (run(argv[1], &str, STREAM_CHATS) < 0)
+        return 1;
+    if (str.replies != STREAM_MESSAGES) {
+        fprintf(stderr, "  FAIL: %d messages posted, expected one per "
+                        "reply\n", str.replies);
+        return 1;
+    }
+    if (str.early_posts != STREAM_MESSAGES) {
+        fprintf(stderr, "  FAIL: only %d replies posted while streaming\n",
+                str.early_posts);
+        return 1;
+    }
+    if (str.edits_during_stream < 1 || str.rate_limited < 1) {
+        fprintf(stderr, "  FAIL: replies were not edited in place\n");
+        return 1;
+    }
+
+    printf("Shutdown: %d messages, %d chats, SIGTERM once all are fetched\n",
+           DRAIN_MESSAGES, DRAIN_CHATS);
+    drn = (load_state_t){ .messages = DRAIN_MESSAGES, .chats = DRAIN_CHATS,
+                          .delay_ms = DRAIN_MS, .stop_early = true };
+    if (run(argv[1], &drn, DRAIN_CHATS) < 0)
+        return 1;
+    printf("      %d/%d answered when SIGTERM was sent\n",
+           drn.replies_at_stop, DRAIN_MESSAGES);
+    if (drn.replies_at_stop >= DRAIN_MESSAGES) {
+        fprintf(stderr, "  FAIL: SIGTERM came after every reply\n");
+        return 1;
+    }
+
+    printf("  PASSED\n");
+    return 0;
+}